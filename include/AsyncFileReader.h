@@ -0,0 +1,57 @@
+// AsyncFileReader.h - batched asynchronous file reads with a bounded queue depth: io_uring on
+// Linux, overlapped I/O on a completion port on Windows, and reader threads everywhere else
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct AsyncReadRequest {
+    std::filesystem::path path;
+    uint64_t offset = 0;
+    uint32_t length = 0;             // clamped to MaxReadBytes(); shorter at the end of the file
+    size_t tag = 0;                  // handed back in the result
+};
+
+struct AsyncReadResult {
+    size_t tag = 0;
+    int error = 0;                   // 0, or the errno (GetLastError() on Windows) of the open or read
+    const uint8_t* data = nullptr;   // only valid during the completion callback
+    uint32_t size = 0;               // bytes read
+};
+
+enum class AsyncIoBackend { Auto, IoUring, Overlapped, Threads };
+
+const char* AsyncIoBackendName(AsyncIoBackend backend);
+
+// Up to QueueDepth() files are opened and read at once, which hides the per-request latency of
+// network shares and lets local drives reorder. Every slot owns one buffer of MaxReadBytes(),
+// allocated once (and registered with the kernel for io_uring), so reads allocate nothing.
+// Completions are delivered on the thread that called ReadAll, in the order they finish.
+class AsyncFileReader {
+public:
+    using Completion = std::function<void(const AsyncReadResult&)>;
+    class Engine;
+
+    // A backend this system cannot run (not built for it, or refused by the kernel) falls back to
+    // reader threads; Backend() tells which one is used
+    explicit AsyncFileReader(unsigned queueDepth = 32, uint32_t maxReadBytes = 256 * 1024, AsyncIoBackend backend = AsyncIoBackend::Auto);
+    ~AsyncFileReader();
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    AsyncIoBackend Backend() const;
+    unsigned QueueDepth() const { return queueDepth_; }
+    uint32_t MaxReadBytes() const { return maxReadBytes_; }
+
+    // Reads every request and returns once all completions were delivered
+    void ReadAll(const std::vector<AsyncReadRequest>& requests, const Completion& onComplete);
+
+private:
+    unsigned queueDepth_;
+    uint32_t maxReadBytes_;
+    std::unique_ptr<Engine> engine_;
+};
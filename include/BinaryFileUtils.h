@@ -0,0 +1,107 @@
+// BinaryFileUtils.h - the encoding shared by the small binary files in AppCacheFolder() (session
+// snapshot, input trace, show history) and how they are replaced on disk
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ImageFileUtils.h"
+
+/**
+ * Appends an unsigned LEB128 varint: 7 bits per byte, low bits first
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+static inline void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * Reads a varint written by PutVarint
+ * @param p Read position, advanced past the varint
+ * @param end End of the data
+ * @param value Decoded value
+ * @return False if the data ends first or the varint is longer than 64 bits
+ */
+static inline bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * Appends a string as its UTF-8 length and bytes, as the catalog index stores them
+ * @param out Buffer to append to
+ * @param text Text to encode
+ */
+static inline void PutString(std::vector<uint8_t>& out, const std::wstring& text)
+{
+    const std::u8string utf8 = std::filesystem::path(text).u8string();
+    PutVarint(out, utf8.size());
+    out.insert(out.end(), utf8.begin(), utf8.end());
+}
+
+/**
+ * Reads a string written by PutString
+ * @param p Read position, advanced past the string
+ * @param end End of the data
+ * @param text Decoded text
+ * @return False if the length runs past the end of the data or the text is not UTF-8
+ */
+static inline bool GetString(const uint8_t*& p, const uint8_t* end, std::wstring& text)
+{
+    uint64_t size = 0;
+    if (!GetVarint(p, end, size) || size > static_cast<uint64_t>(end - p)) return false;
+    if (!WideFromUtf8(std::string_view(reinterpret_cast<const char*>(p), static_cast<size_t>(size)), text)) return false;
+    p += size;
+    return true;
+}
+
+/**
+ * Writes a file next to `path` and renames it over `path` once complete, so a reader (or the
+ * next session after a crash) sees either the old file or the new one, never a part
+ * @param path File to replace; missing parent folders are created
+ * @param write Writes the content; returning false abandons the file
+ * @return True if the file was written and replaced
+ */
+static inline bool WriteFileAtomically(const std::filesystem::path& path, const std::function<bool(std::ofstream&)>& write)
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    {
+        std::ofstream file(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file || !write(file)) return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+/**
+ * WriteFileAtomically for content already in memory
+ * @param path File to replace
+ * @param bytes Complete file content
+ * @return True if the file was written and replaced
+ */
+static inline bool WriteFileAtomically(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+{
+    return WriteFileAtomically(path, [&bytes](std::ofstream& file) {
+        return static_cast<bool>(file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+    });
+}
@@ -0,0 +1,67 @@
+// CatalogIndex.h - a saved library scan (written by tools/hdrscan) that lets the screen saver
+// start without walking the library folder
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileIdentity.h"
+#include "ImageCatalog.h"
+#include "ImageProbe.h"
+
+struct CatalogIndexEntry {
+    std::wstring path;
+    uint64_t fileSize = 0;
+    int64_t modified = 0;
+    ImageContainer container = ImageContainer::Unknown;
+    int width = 0;
+    int height = 0;
+    bool gainMap = false;
+    float hdrCapacityMax = 0.0f;     // log2 headroom (ProbeHeadroom), 0 for SDR images
+    Renderability renderability = Renderability::Broken;
+    ContentHash content;             // FingerprintFile; empty if it was not computed
+};
+
+class CatalogIndex {
+public:
+    // catalog-index.tsv in AppCacheFolder()
+    static std::filesystem::path DefaultPath();
+
+    void SetRoot(const std::wstring& root, bool includeSubfolders);
+    void SetFolders(std::vector<FolderStamp> folders) { folders_ = std::move(folders); }
+    void Add(CatalogIndexEntry entry) {
+        byPath_[entry.path] = entries_.size();
+        entries_.push_back(std::move(entry));
+    }
+
+    const std::wstring& Root() const { return root_; }
+    bool IncludeSubfolders() const { return includeSubfolders_; }
+    const std::vector<FolderStamp>& Folders() const { return folders_; }
+    const std::vector<CatalogIndexEntry>& Entries() const { return entries_; }
+
+    // Returns false if the file is missing, not an index or damaged (a path that is not UTF-8)
+    bool Load(const std::filesystem::path& path);
+    // Writes atomically (temp file + rename)
+    bool Save(const std::filesystem::path& path) const;
+
+    // True if the index was built for this folder and subfolder setting
+    bool Matches(const std::wstring& root, bool includeSubfolders) const;
+    // True if no scanned folder changed since the scan. Adding, removing or renaming a file
+    // updates its folder's time; rewriting a file in place does not, but the loader copes with that.
+    bool IsCurrent() const;
+
+    // The indexed images as a catalog, optionally only those predicted to display
+    ImageCatalog ToCatalog(bool displayableOnly) const;
+    // Fingerprint recorded for a file, if its size and modification time still match
+    const ContentHash* FindContent(const std::wstring& path, uint64_t fileSize, int64_t modified) const;
+
+private:
+    std::wstring root_;
+    bool includeSubfolders_ = false;
+    std::vector<FolderStamp> folders_;
+    std::vector<CatalogIndexEntry> entries_;
+    std::unordered_map<std::wstring, size_t> byPath_;    // index into entries_
+};
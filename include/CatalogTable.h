@@ -0,0 +1,92 @@
+// CatalogTable.h - column-oriented image metadata and the playlist query language
+//
+// A query is a list of space separated terms, all of which must match:
+//   hdr | sdr                       with / without a gain map or a PQ / HLG transfer
+//   headroom>=2                     gain map HDRCapacityMax or PQ / HLG peak in stops; also >, <, <=, =
+//   date:2023  date>=2023-06        file date by year, month or day; from..to for ranges
+//   size>20MB  width>=3840  height<2000
+//   format:jpeg,png                 container, see ImageContainerName
+//   folder:Trips/2023               subfolder of the library (several folder: terms match any)
+//   sort:date  sort:-size           date, size, pixels, headroom, name; '-' sorts descending
+// Example: hdr headroom>=2 date:2023 folder:Trips folder:Family sort:date
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CatalogIndex.h"
+#include "ImageCatalog.h"
+
+enum CatalogFlags : uint8_t {
+    kCatalogHdr = 1,             // has a gain map or a PQ / HLG transfer
+    kCatalogDisplays = 2,        // predicted to display (hdr or displays)
+    kCatalogProbed = 4,          // container, dimensions and headroom come from a probe
+};
+
+enum class CatalogSortKey : uint8_t { None, Date, Size, Pixels, Headroom, Name };
+
+struct CatalogQuery {
+    // Closed ranges; the defaults match everything
+    float headroomMin = -1e30f, headroomMax = 1e30f;
+    int32_t dateMin = INT32_MIN, dateMax = INT32_MAX;     // days since 1970-01-01
+    uint64_t sizeMin = 0, sizeMax = UINT64_MAX;
+    uint32_t widthMin = 0, widthMax = UINT32_MAX;
+    uint32_t heightMin = 0, heightMax = UINT32_MAX;
+    uint8_t flagsMask = 0, flagsValue = 0;                // rows match when (flags & mask) == value
+    uint32_t formats = 0;                                 // bit per ImageContainer, 0 = any
+    std::vector<std::wstring> folders;                    // lower case, '/' separated, no trailing '/'
+    CatalogSortKey sort = CatalogSortKey::None;
+    bool descending = false;
+
+    // Parses the query syntax above. On failure returns false and describes the bad term.
+    static bool Parse(const std::wstring& text, CatalogQuery& query, std::wstring* error = nullptr);
+};
+
+class CatalogTable {
+public:
+    static CatalogTable FromIndex(const CatalogIndex& index);
+    // Without probe data the container comes from the extension and headroom is 0
+    static CatalogTable FromCatalog(const ImageCatalog& catalog, const std::wstring& root);
+
+    explicit CatalogTable(std::wstring root = std::wstring());
+
+    void Reserve(size_t rows);
+    void Add(const CatalogIndexEntry& entry, bool probed = true);
+
+    size_t Size() const { return paths_.size(); }
+    const std::wstring& Path(size_t row) const { return paths_[row]; }
+    // Folder of a row relative to the root, lower case with '/' separators
+    const std::wstring& Folder(size_t row) const { return folderNames_[folder_[row]]; }
+    int32_t Date(size_t row) const { return date_[row]; }
+    float Headroom(size_t row) const { return headroom_[row]; }
+
+    // Rows that match the query, in query sort order (table order if unsorted)
+    std::vector<uint32_t> Select(const CatalogQuery& query) const;
+    ImageCatalog ToCatalog(const std::vector<uint32_t>& rows) const;
+
+    // Days since 1970-01-01 of a CatalogEntry::modified value
+    static int32_t DaysFromFileTime(int64_t modified);
+
+private:
+    uint32_t FolderId(const std::wstring& path);
+
+    std::wstring root_;
+    std::vector<std::wstring> folderNames_;
+    std::unordered_map<std::wstring, uint32_t> folderIds_;
+    std::wstring lastParent_;                 // rows arrive grouped by folder, so this saves most lookups
+    uint32_t lastFolder_ = UINT32_MAX;
+    // One entry per row
+    std::vector<std::wstring> paths_;
+    std::vector<uint64_t> size_;
+    std::vector<int64_t> modified_;
+    std::vector<uint32_t> folder_;
+    std::vector<int32_t> date_;
+    std::vector<uint32_t> width_;
+    std::vector<uint32_t> height_;
+    std::vector<float> headroom_;
+    std::vector<uint8_t> format_;
+    std::vector<uint8_t> flags_;
+};
@@ -0,0 +1,75 @@
+// CompletionChannel.h - lock-free hand-off of results and input events from worker threads and
+// hooks to the thread that runs the UI loop
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <utility>
+
+// Any number of threads Post messages, one thread Drains them. Posting pushes onto a lock-free
+// stack; draining takes the whole stack in one exchange and runs it oldest first, so there is
+// no ABA problem and no lock on either side. `wake` runs on the posting thread when a message
+// lands in an empty channel (on Windows, PostThreadMessageW of a single WM_APP message), so a
+// burst of posts costs the UI loop one wake-up. A consumer that drains after every wake-up never
+// misses a message.
+template<typename T>
+class CompletionChannel {
+public:
+    explicit CompletionChannel(std::function<void()> wake = {}) : wake_(std::move(wake)) {}
+    ~CompletionChannel() { Free(head_.exchange(nullptr, std::memory_order_acquire)); }
+    CompletionChannel(const CompletionChannel&) = delete;
+    CompletionChannel& operator=(const CompletionChannel&) = delete;
+
+    void Post(T message) {
+        Node* node = new Node{ std::move(message), nullptr };
+        // The node may be drained the moment it is published, so only the local copy of the old
+        // head is read afterwards
+        Node* head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        if (!head && wake_) wake_();
+    }
+
+    // Consumer thread only. Calls consume(T&) for every message posted so far, in the order they
+    // were posted; returns how many there were.
+    template<typename F>
+    size_t Drain(F&& consume) {
+        Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+        Node* oldest = nullptr;
+        while (node) {
+            Node* next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+        }
+        size_t count = 0;
+        while (oldest) {
+            Node* next = oldest->next;
+            consume(oldest->message);
+            delete oldest;
+            oldest = next;
+            ++count;
+        }
+        return count;
+    }
+
+    bool Empty() const { return head_.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    struct Node {
+        T message;
+        Node* next;
+    };
+
+    static void Free(Node* node) {
+        while (node) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    std::atomic<Node*> head_{ nullptr };
+    std::function<void()> wake_;
+};
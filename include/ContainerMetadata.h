@@ -0,0 +1,74 @@
+// ContainerMetadata.h - header parsing of AVIF / HEIF (ISOBMFF), JPEG XL and PNG files: size,
+// color signaling and gain map presence, read in place from the file head without decoding pixels
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ITU-T H.273 (CICP) code points, as carried by an AVIF / HEIF nclx colr box and a PNG cICP
+// chunk; JPEG XL enum values are mapped onto them
+struct ColorSignal {
+    bool present = false;
+    uint8_t primaries = 2;        // 1 BT.709, 9 BT.2020, 12 Display P3; 2 = unspecified
+    uint8_t transfer = 2;         // 13 sRGB, 16 PQ, 18 HLG, 8 linear
+    uint8_t matrix = 2;
+    bool fullRange = true;
+    uint32_t maxCll = 0;          // content light level or intensity target in cd/m2, 0 = unknown
+};
+
+constexpr uint8_t kCicpTransferPq = 16;
+constexpr uint8_t kCicpTransferHlg = 18;
+
+inline bool IsHdrTransfer(uint8_t transfer) { return transfer == kCicpTransferPq || transfer == kCicpTransferHlg; }
+// "srgb", "pq", "hlg", ... or the number
+std::string CicpTransferName(uint8_t transfer);
+std::string CicpPrimariesName(uint8_t primaries);
+
+// Part of the file; offsets are absolute, so a range past the parsed head can be read separately
+struct FileSpan {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    bool Empty() const { return size == 0; }
+    bool Within(size_t headSize) const { return offset + size <= headSize; }
+};
+
+struct ContainerInfo {
+    int width = 0;                // after rotation (AVIF irot, JPEG XL orientation)
+    int height = 0;
+    int components = 0;           // color channels plus alpha / extra channels
+    int bitDepth = 0;
+    bool animated = false;        // image sequence, animated JPEG XL, APNG
+    ColorSignal color;
+    FileSpan icc;                 // uncompressed ICC profile (AVIF / HEIF colr prof)
+    bool hasIcc = false;          // an ICC profile is present, possibly compressed
+    std::string iccName;          // PNG iCCP profile name; the profile itself is deflated
+    bool gainMap = false;         // AVIF tmap item, JPEG XL jhgm box
+    FileSpan gainMapMetadata;     // ISO 21496-1 metadata of the gain map
+    // Set when the parse ran out of data: the head must reach this many bytes (meta box after
+    // mdat, headers split at an unlucky place)
+    uint64_t needBytes = 0;
+    // JPEG XL: first top-level box that starts past the head, 0 if the head reached the end of the
+    // file; a jhgm box after a large codestream box is found by reading the box headers from there
+    uint64_t unreadBoxOffset = 0;
+};
+
+// Largest width or height the parsers accept, JPEG XL's limit; a larger one (a damaged header)
+// makes the header invalid
+constexpr uint32_t kMaxImageDimension = 1u << 30;
+
+// Top-level box header at `offset` of an ISOBMFF or JPEG XL container, for walks past the head.
+// Returns false if `data` (the bytes at offset, at least 8) is not a valid header.
+bool ReadBoxHeader(const uint8_t* data, size_t size, uint64_t offset, uint64_t fileSize, uint32_t& type, FileSpan& payload);
+
+constexpr uint32_t BoxType(const char (&name)[5])
+{
+    return (uint32_t(uint8_t(name[0])) << 24) | (uint32_t(uint8_t(name[1])) << 16) | (uint32_t(uint8_t(name[2])) << 8) | uint8_t(name[3]);
+}
+
+// Each parser takes the first `size` bytes of a file of `fileSize` bytes and returns false if the
+// headers are invalid or, with info.needBytes set, incomplete. The data is never copied.
+bool ParseIsobmffInfo(const uint8_t* data, size_t size, uint64_t fileSize, ContainerInfo& info);
+bool ParseJxlInfo(const uint8_t* data, size_t size, uint64_t fileSize, ContainerInfo& info);
+bool ParsePngInfo(const uint8_t* data, size_t size, ContainerInfo& info);
@@ -0,0 +1,51 @@
+// FileIdentity.h - what a file is rather than where it is: a 128-bit hash of its size, head and
+// samples spread over the body. Caches keyed on it survive renaming and moving folders; path,
+// size and modification time stay the cheap check of whether a stored fingerprint still holds.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ContainerMetadata.h"
+#include "ImageProbe.h"
+
+struct ContentHash {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool Empty() const { return lo == 0 && hi == 0; }
+    bool operator==(const ContentHash&) const = default;
+    // 32 lowercase hex digits, hi first
+    std::string ToHex() const;
+    // Returns false (and leaves `hash` empty) unless `hex` is 32 hex digits
+    static bool FromHex(const std::string& hex, ContentHash& hash);
+};
+
+struct ContentHashHasher {
+    size_t operator()(const ContentHash& hash) const { return static_cast<size_t>(hash.lo); }
+};
+
+// 128-bit non-cryptographic hash in the xxHash3 mould: 64-byte stripes over eight 64-bit lanes
+// (SSE2 where available), keyed by a secret derived from `seed`. Stable across platforms and
+// builds, so it can be stored.
+ContentHash HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Fingerprint layout: the first 64 KB (JPEG / ISOBMFF headers, EXIF, XMP, ICC), eight 4 KB
+// samples spread evenly over the rest and the last 4 KB. Files up to about 100 KB are hashed whole.
+constexpr size_t kFingerprintHeadBytes = 64 * 1024;
+constexpr size_t kFingerprintSampleBytes = 4 * 1024;
+constexpr int kFingerprintSamples = 8;
+
+// The parts of a file of `fileSize` bytes the fingerprint reads, ascending and non-overlapping
+std::vector<FileSpan> FingerprintSpans(uint64_t fileSize);
+
+// Fingerprint from parts of the file read ahead (e.g. the probe head plus FingerprintSpans reads).
+// Returns false if a span is not covered by the ranges.
+bool FingerprintRanges(uint64_t fileSize, const std::vector<ProbeRange>& ranges, ContentHash& hash);
+// Fingerprint of a whole file in memory
+ContentHash FingerprintData(const uint8_t* data, size_t size);
+// Reads the spans of a file on disk; returns false if it is shorter than `fileSize` or unreadable
+bool FingerprintFile(const std::filesystem::path& path, uint64_t fileSize, ContentHash& hash);
@@ -0,0 +1,84 @@
+// HdrRender.h - CPU reference rendering of JPEG and Ultra HDR (JPEG + gain map) files: decode,
+// color conversion to linear light and gain map application at a chosen display headroom, with
+// PFM, OpenEXR and PQ PNG output. What WebView2 shows on an HDR monitor, computed headless.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PixelBufferPool.h"
+
+class WorkerPool;
+
+// Linear light, interleaved RGB in BT.2020 primaries; 1.0 is SDR white
+struct HdrImage {
+    int width = 0;
+    int height = 0;
+    std::vector<float, PixelAllocator<float>> rgb;
+
+    void Allocate(int w, int h) {
+        width = w;
+        height = h;
+        rgb.resize(static_cast<size_t>(w) * h * 3);
+    }
+};
+
+enum class RenderPrimaries : uint8_t { Bt709, DisplayP3, Bt2020 };
+
+const char* RenderPrimariesName(RenderPrimaries primaries);
+
+struct HdrRenderOptions {
+    // Display headroom in stops (log2 of HDR peak over SDR white); negative renders the full HDR
+    // rendition the gain map describes, 0 the SDR base image
+    float headroom = -1.0f;
+    // Threads decoding each JPEG (JpegDecodeOptions::threads), for rendering a few large images;
+    // the shares beyond the calling thread's run on `pool`
+    int decodeThreads = 1;
+    // Runs the stages as a TaskGraph on this pool and the calling thread: the gain map decodes
+    // while the base image does, and color conversion plus gain map run in bands of rows. Null
+    // runs them one after the other on the calling thread, and each decode on it alone.
+    WorkerPool* pool = nullptr;
+    // Set from another thread when the image is no longer wanted (the viewer skipped ahead); the
+    // render stops at the next MCU row or band of rows and fails with "cancelled"
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+struct HdrRenderTimings {
+    double parseMs = 0;           // container, MPF directory and gain map metadata
+    double decodeMs = 0;          // primary image and gain map
+    double colorMs = 0;           // YCbCr to linear BT.2020
+    double gainMapMs = 0;         // upsampling and applying the gain map
+    // Longest chain of dependent stages: the latency with a core for every stage that can run.
+    // The stage times above add up to the latency of running them one after the other.
+    double criticalPathMs = 0;
+    double totalMs = 0;           // start to finish
+};
+
+struct HdrRenderInfo {
+    bool gainMap = false;         // a gain map was applied
+    float weight = 0;             // share of the gain map applied at the requested headroom
+    float headroom = 0;           // headroom the rendition was made for, in stops
+    RenderPrimaries primaries = RenderPrimaries::Bt709;    // of the base image, from its ICC profile name
+    HdrRenderTimings timings;
+};
+
+// Renders a baseline JPEG, with its gain map if it has one (hdrgm XMP or ISO 21496-1
+// metadata). Formats the JPEG decoder rejects fail with an error. Stage times are CPU time,
+// summed over the threads that ran them.
+bool RenderHdrImage(const uint8_t* data, size_t size, const HdrRenderOptions& options, HdrImage& image, HdrRenderInfo* info = nullptr,
+                    std::string* error = nullptr);
+
+// Portable float map: 32-bit float RGB, linear BT.2020, bottom row first
+void EncodePfm(const HdrImage& image, std::vector<uint8_t>& out);
+bool DecodePfm(const uint8_t* data, size_t size, HdrImage& image);
+// Uncompressed scanline OpenEXR, 32-bit float R, G, B with BT.2020 chromaticities
+void EncodeExr(const HdrImage& image, std::vector<uint8_t>& out);
+// 16-bit PNG, BT.2020 PQ with a cICP chunk (and cLLi), SDR white mapped to `sdrWhiteNits`. The
+// pixel data is stored, not deflated: the point is an exact, viewer-readable reference.
+void EncodePqPng(const HdrImage& image, float sdrWhiteNits, std::vector<uint8_t>& out);
+
+// SMPTE ST 2084 code value (0..1) of an absolute luminance in cd/m2
+float PqEncode(float nits);
@@ -0,0 +1,62 @@
+// ImageCache.h - byte-budgeted LRU cache of loaded images, shared by all slideshow outputs
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct ImageData {
+    std::vector<uint8_t> bytes;   // encoded file contents as served to the renderer
+    bool gainMapOmitted = false;  // an Ultra HDR file read without its gain map, for a display that would not use it
+};
+
+class Counter;
+class Gauge;
+
+class ImageCache {
+public:
+    explicit ImageCache(uint64_t budgetBytes);
+
+    // Returns the cached image (and marks it most recently used) or nullptr. Counts hits and misses.
+    std::shared_ptr<const ImageData> Get(uint64_t key);
+    // Same as Get without touching LRU order or hit statistics
+    bool Contains(uint64_t key) const;
+    void Put(uint64_t key, std::shared_ptr<const ImageData> data);
+    // Drops the images `stale` returns true for, pinned ones too (pins stay), and returns their
+    // keys. Holds the cache lock while calling `stale`.
+    std::vector<uint64_t> EraseIf(const std::function<bool(const ImageData&)>& stale);
+
+    // Pinned keys are never evicted, even when the cache is over budget. Pins are counted and may
+    // be taken before the image is loaded (an output pins the slides it is about to show).
+    void Pin(uint64_t key);
+    void Unpin(uint64_t key);
+
+    void SetBudget(uint64_t budgetBytes);
+    uint64_t Budget() const;
+    uint64_t BytesUsed() const;
+    size_t Count() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const ImageData> data;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    void EvictLocked();
+
+    mutable std::mutex mutex_;
+    std::list<uint64_t> lru_;   // front = most recently used
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::unordered_map<uint64_t, int> pins_;
+    uint64_t budget_ = 0;
+    uint64_t bytes_ = 0;
+
+    Counter& hits_;
+    Counter& misses_;
+    Counter& evictions_;
+    Gauge& bytesGauge_;
+};
@@ -0,0 +1,52 @@
+// ImageCatalog.h - the set of images a slideshow draws from, shared by all outputs
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CatalogEntry {
+    std::wstring path;
+    uint64_t fileSize = 0;
+    int64_t modified = 0;        // last write time in std::filesystem::file_time_type ticks, 0 = unknown
+};
+
+// A scanned folder and its modification time, used to tell whether a saved scan is still current
+struct FolderStamp {
+    std::wstring path;
+    int64_t modified = 0;
+};
+
+class ImageCatalog {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    ImageCatalog() = default;
+    explicit ImageCatalog(const std::vector<std::wstring>& paths);
+
+    /**
+     * Scan a folder for supported images (see IsImagePath). File sizes and times come from
+     * the directory listing, so no extra file is opened.
+     * @param folder Path to the folder to search
+     * @param includeSubfolders Whether to search subdirectories recursively
+     * @param folders If set, receives the folder itself and every scanned subfolder
+     */
+    static ImageCatalog FromFolder(const std::wstring& folder, bool includeSubfolders, std::vector<FolderStamp>* folders = nullptr);
+
+    void Add(CatalogEntry entry) { entries_.push_back(std::move(entry)); }
+
+    size_t Size() const { return entries_.size(); }
+    bool Empty() const { return entries_.empty(); }
+    const CatalogEntry& operator[](size_t index) const { return entries_[index]; }
+    const std::vector<CatalogEntry>& Entries() const { return entries_; }
+
+    // Index of the entry referring to the same file as path (see NormalizedPathKey), or npos
+    size_t Find(const std::wstring& path) const;
+    // Makes entry first the first one; the order stays the same when going round
+    void RotateTo(size_t first);
+    // Heap bytes held by the entries, paths included
+    size_t MemoryBytes() const;
+
+private:
+    std::vector<CatalogEntry> entries_;
+};
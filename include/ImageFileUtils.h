@@ -2,9 +2,12 @@
 
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 
 static inline bool IsImagePath(const std::filesystem::path& path)
 {
@@ -17,6 +20,148 @@ static inline bool IsImagePath(const std::filesystem::path& path)
     return supportedFormats.count( ext );
 }
 
+/**
+ * MIME type for an image path or URI, based on its extension
+ * @param path File path or URI ending in the file name
+ * @return Content type, "application/octet-stream" if unknown
+ */
+static inline const wchar_t* ContentTypeForPath(const std::filesystem::path& path)
+{
+    auto ext = path.extension().wstring();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+    if (ext == L".jpg" || ext == L".jpeg") return L"image/jpeg";
+    if (ext == L".png") return L"image/png";
+    if (ext == L".gif") return L"image/gif";
+    if (ext == L".bmp") return L"image/bmp";
+    if (ext == L".webp") return L"image/webp";
+    if (ext == L".svg") return L"image/svg+xml";
+    if (ext == L".avif") return L"image/avif";
+    if (ext == L".jxl") return L"image/jxl";
+    if (ext == L".tif" || ext == L".tiff") return L"image/tiff";
+    return L"application/octet-stream";
+}
+
+/**
+ * UTF-8 form of a path with '/' separators, for text files shared between Windows and Linux
+ * @param path File or folder path
+ * @return UTF-8 encoded generic path
+ */
+static inline std::string Utf8FromPath(const std::filesystem::path& path)
+{
+    const std::u8string s = path.generic_u8string();
+    return std::string(s.begin(), s.end());
+}
+
+/**
+ * Decodes UTF-8 read from a cache file, rejecting malformed text (overlong forms, surrogates,
+ * code points past U+10FFFF) that std::filesystem::path would throw on. Needs no locale.
+ * @param utf8 Bytes read from a file
+ * @param text UTF-16 (Windows) or UTF-32 text
+ * @return False if utf8 is not well-formed
+ */
+static inline bool WideFromUtf8(std::string_view utf8, std::wstring& text)
+{
+    text.clear();
+    text.reserve(utf8.size());
+    const auto* p = reinterpret_cast<const unsigned char*>(utf8.data());
+    const auto* end = p + utf8.size();
+    while (p < end) {
+        const unsigned char lead = *p++;
+        if (lead < 0x80) {
+            text.push_back(static_cast<wchar_t>(lead));
+            continue;
+        }
+        int more;
+        uint32_t code;
+        unsigned char low = 0x80, high = 0xBF;    // range of the first continuation byte
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            more = 1;
+            code = lead & 0x1F;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            more = 2;
+            code = lead & 0x0F;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            more = 3;
+            code = lead & 0x07;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        } else {
+            return false;
+        }
+        if (end - p < more || *p < low || *p > high) return false;
+        for (; more > 0; ++p, --more) {
+            if ((*p & 0xC0) != 0x80) return false;
+            code = (code << 6) | (*p & 0x3F);
+        }
+        if (sizeof(wchar_t) == 2 && code >= 0x10000) {
+            text.push_back(static_cast<wchar_t>(0xD800 + ((code - 0x10000) >> 10)));
+            text.push_back(static_cast<wchar_t>(0xDC00 + (code & 0x3FF)));
+        } else {
+            text.push_back(static_cast<wchar_t>(code));
+        }
+    }
+    return true;
+}
+
+/**
+ * Inverse of Utf8FromPath
+ * @param utf8 UTF-8 encoded path
+ * @return Path in the native format
+ */
+static inline std::filesystem::path PathFromUtf8(const std::string& utf8)
+{
+    return std::filesystem::path(std::u8string(utf8.begin(), utf8.end())).make_preferred();
+}
+
+/**
+ * PathFromUtf8 for a path read from a cache file, which may be damaged
+ * @param utf8 UTF-8 encoded path
+ * @param path Path in the native format
+ * @return False (instead of the exception std::filesystem would throw) if utf8 is not UTF-8
+ */
+static inline bool PathFromUtf8(std::string_view utf8, std::wstring& path)
+{
+    if (!WideFromUtf8(utf8, path)) return false;
+#ifdef _WIN32
+    std::replace(path.begin(), path.end(), L'/', L'\\');
+#endif
+    return true;
+}
+
+/**
+ * Comparison key for file paths: absolute, lexically normalized, lower case, '/' separators.
+ * Opens no file, so it is cheap enough to compare against every entry of a large folder.
+ * Links and short names are not resolved.
+ * @param path File path as given on the command line or by a directory listing
+ * @return The same key for spellings of a path that differ in case, separators or "." / ".." parts
+ */
+static inline std::wstring NormalizedPathKey(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    const std::filesystem::path full = path.is_absolute() ? path : std::filesystem::absolute(path, ec);
+    std::wstring key = full.lexically_normal().generic_wstring();
+    std::transform(key.begin(), key.end(), key.begin(), ::towlower);
+    return key;
+}
+
+/**
+ * Per-user folder for caches the screensaver and its tools share (scan index, show history)
+ * @return %LOCALAPPDATA%\HDRScreenSaver on Windows, $XDG_CACHE_HOME/hdrscreensaver (or ~/.cache/hdrscreensaver) elsewhere
+ */
+static inline std::filesystem::path AppCacheFolder()
+{
+#ifdef _WIN32
+    const wchar_t* localAppData = _wgetenv(L"LOCALAPPDATA");
+    return std::filesystem::path(localAppData && *localAppData ? localAppData : L".") / L"HDRScreenSaver";
+#else
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) return std::filesystem::path(cache) / "hdrscreensaver";
+    const char* home = std::getenv("HOME");
+    return std::filesystem::path(home && *home ? home : ".") / ".cache" / "hdrscreensaver";
+#endif
+}
+
 /**
  * Get all image files in a folder (case-insensitive) matching supported extensions
  * @param folder Path to the folder to search
@@ -0,0 +1,101 @@
+// ImageProbe.h - header-only inspection of image files: container, size, gain map, color profile
+// and whether the renderer can be expected to display them
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ContainerMetadata.h"
+
+enum class ImageContainer : uint8_t { Unknown, Jpeg, Png, Gif, Bmp, WebP, Avif, Heif, Jxl, Tiff, Svg };
+
+// Predicted outcome of showing the file in the WebView2 slideshow
+enum class Renderability : uint8_t {
+    Hdr,            // displays, with HDR from a gain map or a PQ / HLG transfer
+    Displays,       // displays
+    Unsupported,    // a format WebView2 cannot decode (HEIF, JPEG XL, TIFF, unknown)
+    Broken,         // recognized but the headers are invalid or the file is empty
+};
+
+const char* ImageContainerName(ImageContainer container);
+const char* RenderabilityName(Renderability renderability);
+
+// Adobe gain map (hdrgm) XMP values, or the same values from ISO 21496-1 metadata. Channel
+// triples are reduced to the first channel.
+struct GainMapMetadata {
+    std::string version;
+    float gainMapMin = 0.0f;         // log2
+    float gainMapMax = 1.0f;         // log2
+    float gamma = 1.0f;
+    float offsetSdr = 1.0f / 64;
+    float offsetHdr = 1.0f / 64;
+    float hdrCapacityMin = 0.0f;     // log2 headroom where the gain map starts to apply
+    float hdrCapacityMax = 1.0f;     // log2 headroom at which it applies fully
+    bool baseRenditionIsHdr = false;
+};
+
+struct ImageProbe {
+    ImageContainer container = ImageContainer::Unknown;
+    uint64_t fileSize = 0;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    int bitDepth = 0;
+    bool progressive = false;
+    bool animated = false;
+    int mpfImages = 0;               // images listed in the MPF directory, 0 = no MPF
+    bool gainMap = false;            // a gain map image was found
+    bool isoGainMap = false;         // the gain map carries ISO 21496-1 metadata
+    bool hasHdrgm = false;           // hdrgm values below were read from XMP or ISO 21496-1 metadata
+    GainMapMetadata hdrgm;
+    ColorSignal color;               // CICP signaling of AVIF, HEIF, JPEG XL and PNG files
+    std::string iccDescription;      // UTF-8 'desc' of the embedded ICC profile (PNG: iCCP name)
+    Renderability renderability = Renderability::Broken;
+    std::string problem;             // why the file is Broken / Unsupported, or a warning
+};
+
+// Bytes of the file head a probe reads up front; covers EXIF, XMP and ICC segments of
+// practically every JPEG
+constexpr size_t kProbeHeadBytes = 256 * 1024;
+
+// Part of a file that was read ahead, e.g. by AsyncFileReader
+struct ProbeRange {
+    uint64_t offset = 0;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Bytes of a gain map image's head that hold its metadata segments
+constexpr size_t kGainMapHeadBytes = 64 * 1024;
+
+// Probes a file by reading its first bytes, plus the headers of MPF secondary images and the
+// last two bytes (to spot truncated JPEGs). Pixel data is never decoded.
+bool ProbeImageFile(const std::filesystem::path& path, ImageProbe& probe);
+// Same as ProbeImageFile for a file whose head (the first kProbeHeadBytes, or all of a smaller
+// file) was read ahead, e.g. by AsyncFileReader. Reads inside the head or one of the extra ranges
+// (normally the last two bytes) are served from memory; only the rest opens the file.
+void ProbeImageHead(const std::filesystem::path& path, uint64_t fileSize, std::vector<uint8_t> head, const std::vector<ProbeRange>& extra,
+                    ImageProbe& probe);
+
+// Probes a complete file held in memory
+void ProbeImageData(const uint8_t* data, size_t size, ImageProbe& probe);
+
+// Reads ISO 21496-1 gain map metadata (from minimum_version on) into hdrgm terms. Returns false
+// if the data is too short or of a newer version.
+bool ParseIsoGainMapMetadata(const uint8_t* data, size_t size, GainMapMetadata& metadata);
+
+// Gain map metadata from the headers of a gain map image: hdrgm XMP, or else ISO 21496-1.
+// Returns false if they carry neither.
+bool ReadGainMapImageMetadata(const uint8_t* data, size_t size, GainMapMetadata& metadata);
+
+// Share of the gain map a display with `headroom` stops gets (Adobe gain map spec, ISO 21496-1):
+// 0 at or below HDRCapacityMin, where the gain map need not be read at all, 1 from
+// HDRCapacityMax on; reversed for an HDR base rendition
+float GainMapWeight(const GainMapMetadata& metadata, float headroom);
+
+// Headroom in stops the image can use: HDRCapacityMax of a gain map, or for PQ and HLG the
+// content peak over the 203 cd/m2 reference white (BT.2408). 0 for SDR images.
+float ProbeHeadroom(const ImageProbe& probe);
@@ -0,0 +1,58 @@
+// ImageResize.h - downscaling of planar 8-bit images and resampling of linear HDR images
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "HdrRender.h"
+#include "JpegCodec.h"
+
+// Largest size with the same aspect ratio that fits in maxWidth x maxHeight; never upscales.
+// A zero limit means unconstrained in that direction.
+void FitWithin(int width, int height, int maxWidth, int maxHeight, int& outWidth, int& outHeight);
+
+// Area-average (box) resampling of one plane; every source pixel contributes in proportion to
+// the part of it each destination pixel covers
+void ResizePlaneArea(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight);
+
+void ResizeImageArea(const PlanarImage& src, int width, int height, PlanarImage& dst);
+
+enum class ResampleFilter : uint8_t {
+    Lanczos3,        // sharpest; rings slightly at hard edges
+    Mitchell,        // Mitchell-Netravali B = C = 1/3: softer, barely rings
+    Bilinear,        // triangle: for smooth data such as gain maps
+};
+
+const char* ResampleFilterName(ResampleFilter filter);
+bool ParseResampleFilter(const std::string& name, ResampleFilter& filter);
+
+struct ResampleOptions {
+    ResampleFilter filter = ResampleFilter::Lanczos3;
+    int threads = 1;                 // strips of output rows; 0 picks one per core
+    WorkerPool* pool = nullptr;      // runs the strips of the other threads; null: calling thread only
+    bool simd = true;                // false runs the scalar reference kernels
+};
+
+// Separable resampling of a linear light image to any size, down or up. The filter widens with
+// the downscaling factor so every source pixel contributes; edges are clamped. Negative values
+// from the filter's lobes are clipped to zero. Uses AVX2 / AVX-512 kernels when the CPU has them.
+void ResampleHdrImage(const HdrImage& src, int width, int height, const ResampleOptions& options, HdrImage& dst);
+
+// The instruction set the resampler picked on this CPU: "avx512", "avx2" or "scalar"
+const char* ResampleKernelName();
+
+// Sample positions of a bilinear resize with pixel centers aligned: output o blends in[i0[o]]
+// and in[i1[o]] by f[o]. Edges are clamped.
+struct LinearTaps {
+    std::vector<int> i0, i1;
+    std::vector<float> f;
+};
+
+LinearTaps BuildLinearTaps(int inSize, int outSize);
+
+// Fast path for the gain map, a low resolution image of log2 boosts: one row of it upsampled
+// to image resolution and raised to multipliers, out[o] = 2^(in[i0] + (in[i1] - in[i0]) * f).
+// The AVX2 kernel gathers and evaluates a polynomial exp2 eight outputs at a time, within
+// 2e-7 relative of std::exp2; `simd` false runs the std::exp2 reference.
+void UpsampleExp2Row(const LinearTaps& taps, const float* in, float* out, bool simd = true);
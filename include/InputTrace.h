@@ -0,0 +1,94 @@
+// InputTrace.h - recorded navigation of a slideshow session and its headless replay, to turn
+// "it lagged when I held the right arrow" into a repeatable measurement
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "FileIdentity.h"
+#include "Slideshow.h"
+
+// One call into the slideshow that changed what an output shows
+enum class TraceEventKind : uint8_t {
+    Advance,         // automatic advance (or first slide) reported by Tick
+    Next,            // right arrow
+    Previous,        // left arrow
+    SkipNext,        // an output skipped a slide it could not display, going forward
+    SkipPrevious,    // ... or backward
+    Extend,          // the catalog grew (folder of an opened file listed); index is the new size
+};
+constexpr size_t kTraceEventKinds = 6;
+const char* TraceEventKindName(TraceEventKind kind);
+
+struct TraceEvent {
+    std::chrono::microseconds time{ 0 };    // since the trace started
+    TraceEventKind kind = TraceEventKind::Advance;
+    uint32_t output = 0;
+    uint64_t index = 0;                      // catalog index shown afterwards
+};
+
+// Everything needed to rebuild the session: where the catalog came from, the outputs with their
+// random order seeds, and the events. Paths are stored relative to the root, so a trace recorded
+// on one machine replays against a copy of the folder on another. Files are a few bytes per
+// event (delta-coded times, varints).
+class InputTrace {
+public:
+    std::wstring root;                 // image folder, or the opened file
+    bool openedFile = false;           // root is a file whose folder was listed in the background
+    bool includeSubfolders = true;
+    std::wstring playlistQuery;
+    bool weighted = false;             // random order drew from history weights, which replay cannot reproduce
+    uint64_t cacheBytes = 0;
+    uint64_t catalogSize = 0;          // images when the session started
+    ContentHash catalogHash;
+    std::vector<SlideOutputConfig> outputs;
+    std::vector<TraceEvent> events;
+
+    // Hash of the first `count` paths of a catalog, relative to `root` (a folder)
+    static ContentHash CatalogHash(const ImageCatalog& catalog, size_t count, const std::wstring& root);
+    // Folder the catalog paths are relative to
+    std::wstring CatalogRoot() const;
+
+    void Start(Slideshow::Clock::time_point now) { start_ = now; }
+    void Record(TraceEventKind kind, size_t output, size_t index, Slideshow::Clock::time_point now);
+
+    // Returns false if the file is missing or damaged; the trace is empty then
+    bool Load(const std::filesystem::path& path);
+    // Returns false if the trace could not be written; an existing file is left as it was
+    bool Save(const std::filesystem::path& path) const;
+
+private:
+    Slideshow::Clock::time_point start_{};
+};
+
+struct ReplayOptions {
+    // Recorded seconds per real second. 0 replays in virtual time: every event is dispatched as
+    // soon as the previous step finished, so prefetching gets no idle time between inputs and
+    // the latencies are an upper bound. 1 keeps the recorded pacing.
+    double speed = 0;
+    // Longest a step waits for its slide before it counts as diverged
+    std::chrono::milliseconds stepTimeout{ Slideshow::kMaxWait };
+};
+
+struct ReplayResult {
+    // Per event kind, sorted: from dispatching the event until the slideshow call returned and
+    // the image of the new slide was in memory, as the renderer would fetch it
+    std::array<std::vector<std::chrono::microseconds>, kTraceEventKinds> latencies;
+    uint64_t steps = 0;
+    uint64_t divergences = 0;          // steps that showed a different slide than recorded, or none
+    uint64_t late = 0;                 // automatic advances the slideshow itself reported late
+    double seconds = 0;                // real time of the whole replay
+
+    std::chrono::microseconds Percentile(TraceEventKind kind, double q) const;
+};
+
+// Drives a fresh slideshow through the trace's events, with the slideshow clock at the recorded
+// times. `catalog` is the catalog at its largest (after all Extend events); the session starts
+// with its first trace.catalogSize entries. Returns false with `error` set if the trace does not
+// fit the catalog.
+bool ReplayInputTrace(const InputTrace& trace, const ImageCatalog& catalog, ImageCache& cache, WorkerPool& pool,
+                      Slideshow::LoadFunction load, const ReplayOptions& options, ReplayResult& result, std::string* error = nullptr);
@@ -0,0 +1,115 @@
+// JpegCodec.h - baseline JPEG decoder and encoder working on planar YCbCr / gray images
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PixelBufferPool.h"
+
+class WorkerPool;
+
+// 8-bit planar image. Three channels are Y, Cb, Cr (as stored in JFIF files), one channel is gray.
+// Planes of full size images come from PixelBufferPool, so decoding one slide after another
+// reuses the same pages.
+struct PlanarImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    PixelPlane planes[3];              // width * height bytes each
+
+    // Sizes the planes; their contents are unspecified until written
+    void Allocate(int w, int h, int c) {
+        width = w;
+        height = h;
+        channels = c;
+        for (int i = 0; i < 3; ++i) {
+            const size_t size = i < c ? static_cast<size_t>(w) * h : 0;
+            if (planes[i].size() != size) PixelPlane(size).swap(planes[i]);
+        }
+    }
+};
+
+struct JpegInfo {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    bool progressive = false;
+    bool arithmetic = false;
+    int precision = 8;
+    int restartInterval = 0;
+};
+
+// Reads the frame header without decoding. Returns false if the data is not a JPEG stream.
+bool ReadJpegInfo(const uint8_t* data, size_t size, JpegInfo& info);
+
+struct JpegDecodeOptions {
+    // Threads decoding one image, the calling one and jobs on `pool`; 0 picks one per core.
+    // Only files with restart markers (DRI) split their entropy-coded data: each interval starts
+    // with reset DC predictors at a byte-aligned RSTn, so intervals are Huffman decoded and
+    // transformed independently. Other files decode on the calling thread and only share out
+    // the chroma upsampling.
+    int threads = 1;
+    // Runs the shares of the other threads (WorkerPool::RunShared), also from inside a pool job.
+    // Null decodes on the calling thread alone.
+    WorkerPool* pool = nullptr;
+    // Checked once per MCU row (per restart interval when split); once set the decode fails
+    // with "cancelled", for work that is no longer wanted
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+// Decodes a baseline (sequential Huffman, 8-bit) JPEG with 1 or 3 components. Chroma is
+// upsampled to full resolution. Progressive, arithmetic, 12-bit and CMYK files are rejected.
+bool DecodeJpeg(const uint8_t* data, size_t size, PlanarImage& image, std::string* error = nullptr);
+bool DecodeJpeg(const uint8_t* data, size_t size, const JpegDecodeOptions& options, PlanarImage& image, std::string* error = nullptr);
+
+// Decodes parts of a large baseline JPEG without decoding the rest, for zoom and pan over
+// panoramas. Open() indexes the entropy-coded data: at the restart markers if the file has
+// them, otherwise with one entropy decoding pass (no IDCT, no pixels) that records where every
+// kIndexStride-th MCU of each MCU row starts. Files whose components are coded in separate
+// scans are rejected; DecodeJpeg handles those. DecodeRegion is safe to call from several
+// threads at once.
+class JpegRegionDecoder {
+public:
+    static constexpr int kIndexStride = 32;
+    static constexpr int kMaxScaleLog2 = 3;
+
+    JpegRegionDecoder();
+    ~JpegRegionDecoder();
+    JpegRegionDecoder(JpegRegionDecoder&&) noexcept;
+    JpegRegionDecoder& operator=(JpegRegionDecoder&&) noexcept;
+
+    // The data must stay valid and unchanged while the decoder is used
+    bool Open(const uint8_t* data, size_t size, std::string* error = nullptr);
+    bool IsOpen() const { return impl_ != nullptr; }
+
+    int Width() const;
+    int Height() const;
+    int Channels() const;
+    // Size of a dimension at 1 / 2^scaleLog2 scale
+    static int ScaledSize(int size, int scaleLog2) { return (size + (1 << scaleLog2) - 1) >> scaleLog2; }
+
+    // Decodes [x, x + width) x [y, y + height) of the image scaled by 1 / 2^scaleLog2 (0..3),
+    // in scaled pixels; the region is clipped to the image. Scale 1/8 decodes DC values only.
+    bool DecodeRegion(int x, int y, int width, int height, int scaleLog2, PlanarImage& image, std::string* error = nullptr) const;
+
+    size_t IndexEntries() const;
+    size_t IndexBytes() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+struct JpegEncodeOptions {
+    int quality = 90;                             // 1..100, libjpeg scale of the Annex K tables
+    bool subsampleChroma = true;                  // 4:2:0 instead of 4:4:4
+    int restartInterval = 0;                      // MCUs between RSTn markers, 0 for none
+    std::vector<std::vector<uint8_t>> segments;   // complete marker segments written right after SOI
+};
+
+// Encodes a baseline JPEG with the standard Huffman tables
+bool EncodeJpeg(const PlanarImage& image, const JpegEncodeOptions& options, std::vector<uint8_t>& out);
@@ -0,0 +1,56 @@
+// JpegFile.h - marker-level access to JPEG files: header segments, the MPF image directory and
+// the XMP / ISO 21496-1 metadata that marks an Ultra HDR gain map
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct JpegSegment {
+    uint8_t marker = 0;
+    size_t offset = 0;           // position of the 0xFF marker byte
+    size_t length = 0;           // whole segment including marker and length field
+
+    size_t PayloadOffset() const { return offset + 4; }
+    size_t PayloadSize() const { return length - 4; }
+};
+
+// Segments from SOI up to (not including) the first SOS. Returns false if data is not a JPEG stream.
+bool ReadJpegSegments(const uint8_t* data, size_t size, std::vector<JpegSegment>& segments);
+
+// One image of a Multi-Picture Format (CIPA DC-007) file, offsets are absolute in the file
+struct MpfImage {
+    uint32_t attribute = 0;
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+// Reads the MP Entry list from the APP2 "MPF" segment of the first image. Returns false if the
+// file has no valid MPF directory. When data holds only the head of the file, pass the full
+// file size as fileSize so that images past the head are accepted.
+bool ReadMpfImages(const uint8_t* data, size_t size, std::vector<MpfImage>& images, size_t fileSize = 0);
+
+// APP2 MPF segment describing a primary image followed by one gain map image. The segment size
+// does not depend on the values, so it can be written first and overwritten in place once the
+// primary image size is known.
+std::vector<uint8_t> BuildMpfSegment(uint32_t primarySize, uint32_t gainMapSize, uint32_t gainMapOffset);
+// Offset of the TIFF header inside a segment from BuildMpfSegment; MP offsets are relative to it
+constexpr size_t kMpfTiffHeaderOffset = 8;
+
+bool IsMpfSegment(const uint8_t* data, const JpegSegment& segment);
+bool IsXmpSegment(const uint8_t* data, const JpegSegment& segment);
+// XMP with hdrgm (Adobe gain map) properties or an ISO 21496-1 gain map segment
+bool IsGainMapMetadataSegment(const uint8_t* data, const JpegSegment& segment);
+
+// XMP packet text of an XMP segment
+std::string XmpPacket(const uint8_t* data, const JpegSegment& segment);
+std::vector<uint8_t> BuildXmpSegment(const std::string& packet);
+
+// Value of a simple XMP property, written either as an attribute (name="value") or as an element
+// (<name>value</name>, the first rdf:li for per-channel sequences)
+bool XmpProperty(const std::string& packet, const std::string& name, std::string& value);
+
+// Rewrites Item:Length of the GContainer directory item with the given Item:Semantic. Returns
+// false if the packet has no such item.
+bool SetXmpItemLength(std::string& packet, const std::string& semantic, size_t length);
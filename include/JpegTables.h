@@ -0,0 +1,25 @@
+// JpegTables.h - tables and 8x8 transforms shared by the JPEG decoder and encoder
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// kJpegNaturalOrder[k] is the row-major position of the k-th coefficient in zigzag order
+extern const uint8_t kJpegNaturalOrder[64];
+
+// ITU T.81 Annex K example tables (quantization in natural order)
+extern const uint8_t kJpegLumaQuant[64];
+extern const uint8_t kJpegChromaQuant[64];
+extern const uint8_t kJpegDcLumaCounts[16];
+extern const uint8_t kJpegDcLumaValues[12];
+extern const uint8_t kJpegDcChromaCounts[16];
+extern const uint8_t kJpegDcChromaValues[12];
+extern const uint8_t kJpegAcLumaCounts[16];
+extern const uint8_t kJpegAcLumaValues[162];
+extern const uint8_t kJpegAcChromaCounts[16];
+extern const uint8_t kJpegAcChromaValues[162];
+
+// Dequantized coefficients (natural order) -> 8x8 samples with level shift and clamping
+void JpegInverseDct(const int32_t* coefficients, uint8_t* out, size_t stride);
+// 8x8 samples -> unquantized coefficients (natural order, level shifted)
+void JpegForwardDct(const uint8_t* in, size_t stride, float* coefficients);
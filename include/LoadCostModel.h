@@ -0,0 +1,62 @@
+// LoadCostModel.h - running estimates of how long an image takes to get on screen, per format
+// and size class, learned from the reads and renders of the session
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "ImageCatalog.h"
+
+enum class LoadStage : uint8_t {
+    Read,       // the file read into the cache
+    Render,     // from handing the bytes to the renderer until the image is shown (decode and paint)
+};
+constexpr size_t kLoadStages = 2;
+
+const char* LoadStageName(LoadStage stage);
+
+// Every (format, size class, stage) keeps a moving average of its durations and of their
+// deviation from it, as TCP does for round trip times; an estimate is the average plus two
+// deviations, so it covers most loads without waiting for the slowest. Classes without samples
+// scale the format's time per MB, or the time per MB of all formats, by the file size; before
+// any read is measured, reads are assumed to run at 50 MB/s (a network share or a disk that is
+// busy), renders at no cost. Thread-safe.
+class LoadCostModel {
+public:
+    using Duration = std::chrono::microseconds;
+
+    // Size classes double from 64 KB: class 0 is below 64 KB, class 1 below 128 KB, ...
+    static constexpr size_t kSizeClasses = 16;
+    static size_t SizeClass(uint64_t bytes);
+    // Lowercase extension without the dot ("jpg"), the format an entry is counted under
+    static std::string FormatOf(const std::wstring& path);
+
+    void Record(const CatalogEntry& entry, LoadStage stage, Duration duration);
+    Duration Estimate(const CatalogEntry& entry, LoadStage stage) const;
+    // All stages
+    Duration Estimate(const CatalogEntry& entry) const;
+    uint64_t Samples(LoadStage stage) const;
+
+private:
+    struct Average {
+        double mean = 0;
+        double deviation = 0;
+        uint64_t samples = 0;
+
+        void Add(double value);
+        double Estimate() const { return mean + 2 * deviation; }
+    };
+    struct Format {
+        std::array<std::array<Average, kSizeClasses>, kLoadStages> classes;
+        std::array<Average, kLoadStages> perMegabyte;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Format> formats_;
+    std::array<Average, kLoadStages> perMegabyte_;
+};
@@ -1,8 +1,149 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Severity levels, from most to least verbose.
+enum class LogLevel : uint8_t { Trace = 0, Debug = 1, Info = 2, Warn = 3, Error = 4, Off = 5 };
+
+// Message categories. Each category can be switched off separately at compile time and at runtime.
+enum class LogCategory : uint8_t { General = 0, Navigation = 1, WebView = 2, Input = 3, Settings = 4, Metrics = 5, Count };
+
+// Compile-time filter. Call sites below HDR_LOG_MIN_LEVEL or whose category bit is not set in
+// HDR_LOG_CATEGORIES are removed entirely, arguments included.
+// Example: -DHDR_LOG_MIN_LEVEL=2 drops all Trace and Debug messages from the binary.
+#ifndef HDR_LOG_MIN_LEVEL
+#define HDR_LOG_MIN_LEVEL 0
+#endif
+#ifndef HDR_LOG_CATEGORIES
+#define HDR_LOG_CATEGORIES 0xFFFFFFFFu
+#endif
+
+constexpr int kLogMinLevel = HDR_LOG_MIN_LEVEL;
+constexpr uint32_t kLogCategories = HDR_LOG_CATEGORIES;
+
+constexpr bool LogCompiledIn(LogLevel level, LogCategory category) {
+    return static_cast<int>(level) >= kLogMinLevel && level != LogLevel::Off &&
+           ((kLogCategories >> static_cast<int>(category)) & 1u) != 0;
+}
+
+inline const wchar_t* LogLevelName(LogLevel level) {
+    static const wchar_t* names[] = { L"TRACE", L"DEBUG", L"INFO", L"WARN", L"ERROR", L"OFF" };
+    return static_cast<size_t>(level) < std::size(names) ? names[static_cast<size_t>(level)] : L"?";
+}
+
+inline const wchar_t* LogCategoryName(LogCategory category) {
+    static const wchar_t* names[] = { L"General", L"Navigation", L"WebView", L"Input", L"Settings", L"Metrics" };
+    return static_cast<size_t>(category) < std::size(names) ? names[static_cast<size_t>(category)] : L"?";
+}
+
+// Compact binary log file layout (all integers little endian):
+//   header:     magic "HDRLOG1\0", u16 version, u8 sizeof(wchar_t), u8 reserved, i64 start time (unix us)
+//   FormatDef:  u8 type, u16 id, u8 level, u8 category, u32 line, u16 n + file (UTF-8), u32 n + format (UTF-8)
+//   Message:    u8 type, u16 id, u64 time since start (us), u32 thread, u8 argc, argc x (u8 ArgType + payload)
+//   Text:       u8 type, u8 level, u8 category, u64 time since start (us), u32 thread, WString payload
+// Payloads: Int i64, UInt u64, Double f64, String u32 n + bytes, WString u32 n + n raw wchar_t.
+// Format definitions are written once per call site, so a file can be decoded without the binary
+// that produced it (see tools/hdrlogdecode.cpp).
+namespace LogBinary {
+    constexpr char kMagic[8] = { 'H', 'D', 'R', 'L', 'O', 'G', '1', '\0' };
+    constexpr uint16_t kVersion = 1;
+    enum RecordType : uint8_t { FormatDef = 1, Message = 2, Text = 3 };
+    enum ArgType : uint8_t { Int = 1, UInt = 2, Double = 3, String = 4, WString = 5 };
+}
+
+// Serializes log arguments into the binary record layout above.
+class LogRecordBuffer {
+public:
+    std::vector<uint8_t> bytes;
+
+    void Put(const void* data, size_t size) {
+        const size_t offset = bytes.size();
+        bytes.resize(offset + size);
+        if (size) std::memcpy(bytes.data() + offset, data, size);
+    }
+    template<typename T> void PutValue(T value) { Put(&value, sizeof(value)); }
+
+    template<typename T>
+    void PutArg(const T& value) {
+        if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            PutValue<uint8_t>(LogBinary::Int); PutValue<int64_t>(value);
+        } else if constexpr (std::is_integral_v<T>) {
+            PutValue<uint8_t>(LogBinary::UInt); PutValue<uint64_t>(value);
+        } else if constexpr (std::is_enum_v<T>) {
+            PutValue<uint8_t>(LogBinary::Int); PutValue<int64_t>(static_cast<int64_t>(value));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            PutValue<uint8_t>(LogBinary::Double); PutValue<double>(value);
+        } else if constexpr (std::is_convertible_v<const T&, std::wstring_view>) {
+            std::wstring_view s = value;
+            PutValue<uint8_t>(LogBinary::WString); PutValue<uint32_t>(static_cast<uint32_t>(s.size()));
+            Put(s.data(), s.size() * sizeof(wchar_t));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            std::string_view s = value;
+            PutValue<uint8_t>(LogBinary::String); PutValue<uint32_t>(static_cast<uint32_t>(s.size()));
+            Put(s.data(), s.size());
+        } else {
+            static_assert(sizeof(T) == 0, "Unsupported LOG_FMT argument type");
+        }
+    }
+};
+
+// Appends one LOG_FMT argument to a text message.
+template<typename T>
+void AppendLogArg(std::wstring& out, const T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+        out += value ? L"true" : L"false";
+    } else if constexpr (std::is_integral_v<T>) {
+        out += std::to_wstring(value);
+    } else if constexpr (std::is_enum_v<T>) {
+        out += std::to_wstring(static_cast<int64_t>(value));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        wchar_t buf[32];
+        swprintf(buf, 32, L"%g", static_cast<double>(value));
+        out += buf;
+    } else if constexpr (std::is_convertible_v<const T&, std::wstring_view>) {
+        out += std::wstring_view(value);
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        std::string_view s = value;
+        out.append(s.begin(), s.end());
+    } else {
+        static_assert(sizeof(T) == 0, "Unsupported LOG_FMT argument type");
+    }
+}
+
+// Replaces each "{}" in format with the next argument. Surplus arguments are appended separated by spaces.
+template<typename... Args>
+std::wstring FormatLogText(std::wstring_view format, const Args&... args) {
+    std::wstring out;
+    out.reserve(format.size() + 16 * sizeof...(Args));
+    size_t pos = 0;
+    auto appendNext = [&](const auto& arg) {
+        size_t p = format.find(L"{}", pos);
+        if (p == std::wstring_view::npos) {
+            out.append(format.substr(pos));
+            pos = format.size();
+            out += L' ';
+        } else {
+            out.append(format.substr(pos, p - pos));
+            pos = p + 2;
+        }
+        AppendLogArg(out, arg);
+    };
+    (appendNext(args), ...);
+    out.append(format.substr(pos));
+    return out;
+}
 
 class Logger {
 public:
@@ -11,66 +152,154 @@ public:
         return instance;
     }
 
+    // Runtime filter. Checked before any message argument is evaluated (see LOG_AT/LOG_FMT).
+    bool IsEnabled(LogLevel level, LogCategory category) const {
+        return static_cast<uint8_t>(level) >= minLevel_.load(std::memory_order_relaxed) &&
+               ((categoryMask_.load(std::memory_order_relaxed) >> static_cast<int>(category)) & 1u) != 0 &&
+               sinks_.load(std::memory_order_relaxed) != 0;
+    }
+
+    void SetLevel(LogLevel level) { minLevel_.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+    LogLevel GetLevel() const { return static_cast<LogLevel>(minLevel_.load(std::memory_order_relaxed)); }
+    void SetCategoryMask(uint32_t mask) { categoryMask_.store(mask, std::memory_order_relaxed); }
+
+    // Console output is on by default. Disable it when no console is attached (GUI subsystem),
+    // otherwise messages are formatted just to be thrown away.
+    void SetConsoleEnabled(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        consoleEnabled_ = enabled;
+        UpdateSinks();
+    }
+
     template<typename T>
     void Log(const T& msg) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::wcout << msg << std::endl;
-        if (logFileEnabled_ && logfile_.is_open()) {
-            logfile_ << msg << std::endl;
-        }
+        LogAt(LogLevel::Info, LogCategory::General, msg);
     }
 
     // Overload for wide strings
     void Log(const wchar_t* msg) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::wcout << msg << std::endl;
-        if (logFileEnabled_ && logfile_.is_open()) {
-            logfile_ << msg << std::endl;
-        }
+        WriteText(LogLevel::Info, LogCategory::General, msg);
     }
 
     // Overload for std::wstring
     void Log(const std::wstring& msg) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::wcout << msg << std::endl;
-        if (logFileEnabled_ && logfile_.is_open()) {
-            logfile_ << msg << std::endl;
-        }
+        WriteText(LogLevel::Info, LogCategory::General, msg);
     }
 
     // For stream-style logging
     template<typename... Args>
     void LogMany(const Args&... args) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        (log_stream(args), ...);
-        log_stream_end();
+        LogAt(LogLevel::Info, LogCategory::General, args...);
     }
 
-    void Configure(bool enableLogFile, const std::wstring& path) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (logfile_.is_open()) logfile_.close();
-        logFileEnabled_ = enableLogFile;
-        if (logFileEnabled_ && !path.empty()) {
-            logfile_.open(path, std::ios::out | std::ios::app);
-            if (!logfile_.is_open()) {
-                std::wcout << L"[Logger] Failed to open log file: " << path << std::endl;
-            }
+    template<typename... Args>
+    void LogAt(LogLevel level, LogCategory category, const Args&... args) {
+        std::wostringstream stream;
+        (stream << ... << args);
+        WriteText(level, category, stream.str());
+    }
+
+    // Registers the static format string of a LOG_FMT call site. Called once per call site.
+    uint16_t RegisterFormat(LogLevel level, LogCategory category, const char* file, int line, const wchar_t* format);
+
+    // Writes a LOG_FMT message: a binary record (format id + raw arguments) when the binary
+    // sink is active, formatted text for the console and text log file. The category is not
+    // repeated per message; the decoder takes it from the format's registration.
+    template<typename... Args>
+    void LogFormat(uint16_t id, LogLevel level, const wchar_t* format, const Args&... args) {
+        const int sinks = sinks_.load(std::memory_order_relaxed);
+        if (sinks & kBinarySink) {
+            LogRecordBuffer record;
+            record.bytes.reserve(32 + 16 * sizeof...(Args));
+            record.PutValue<uint8_t>(LogBinary::Message);
+            record.PutValue<uint16_t>(id);
+            record.PutValue<uint64_t>(MicrosSinceStart());
+            record.PutValue<uint32_t>(ThreadIndex());
+            record.PutValue<uint8_t>(static_cast<uint8_t>(sizeof...(Args)));
+            (record.PutArg(args), ...);
+            WriteBinary(record, level);
+        }
+        if (sinks & (kConsoleSink | kTextFileSink)) {
+            WriteTextOnly(FormatLogText(format, args...));
         }
     }
 
+    // Enables the log file. With binaryFormat the file receives compact binary records instead of
+    // text; its extension is replaced by ".hdrlog".
+    void Configure(bool enableLogFile, const std::wstring& path, bool binaryFormat = false);
+
+    // Writes buffered binary records to disk.
+    void Flush();
+
 private:
     Logger() = default;
-    ~Logger() { if (logfile_.is_open()) logfile_.close(); }
+    ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
+    static constexpr int kConsoleSink = 1;
+    static constexpr int kTextFileSink = 2;
+    static constexpr int kBinarySink = 4;
+
+    void UpdateSinks();
+    void WriteText(LogLevel level, LogCategory category, const std::wstring& msg);
+    void WriteTextOnly(const std::wstring& msg);
+    void WriteBinary(const LogRecordBuffer& record, LogLevel level);
+    void WriteFormatDef(size_t index);
+    void FlushBinaryLocked();
+    uint64_t MicrosSinceStart() const;
+    static uint32_t ThreadIndex();
+
+    struct FormatDef {
+        LogLevel level;
+        LogCategory category;
+        std::string file;
+        int line;
+        std::wstring format;
+    };
+
+    std::atomic<uint8_t> minLevel_{ static_cast<uint8_t>(LogLevel::Info) };
+    std::atomic<uint32_t> categoryMask_{ 0xFFFFFFFFu };
+    std::atomic<int> sinks_{ kConsoleSink };
+
+    bool consoleEnabled_ = true;
     bool logFileEnabled_ = false;
     std::wofstream logfile_;
+    std::ofstream binfile_;
+    std::vector<uint8_t> binbuf_;
+    std::vector<FormatDef> formats_;
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    const std::chrono::system_clock::time_point startWall_ = std::chrono::system_clock::now();
+    std::chrono::steady_clock::time_point lastFlush_ = start_;
     std::mutex mutex_;
-
-    template<typename T>
-    void log_stream(const T& val) { std::wcout << val; if (logFileEnabled_ && logfile_.is_open()) logfile_ << val; }
-    void log_stream_end() { std::wcout << std::endl; if (logFileEnabled_ && logfile_.is_open()) logfile_ << std::endl; }
 };
 
-#define LOG_MSG(...) Logger::Instance().LogMany(__VA_ARGS__)
+// Helpers to pick the format string out of LOG_FMT's variadic arguments (the extra expansion step
+// keeps MSVC's traditional preprocessor from passing __VA_ARGS__ on as a single argument).
+#define HDR_LOG_EXPAND(x) x
+#define HDR_LOG_FIRST(first, ...) first
+
+// Leveled stream-style logging: LOG_AT(LogLevel::Debug, LogCategory::Navigation, L"Index ", i).
+// Arguments are only evaluated when the message passes the compile-time and runtime filters.
+#define LOG_AT(level, category, ...) \
+    do { \
+        if constexpr (LogCompiledIn(level, category)) { \
+            if (Logger::Instance().IsEnabled(level, category)) \
+                Logger::Instance().LogAt(level, category, __VA_ARGS__); \
+        } \
+    } while (0)
+
+// Leveled logging with a static format string: LOG_FMT(LogLevel::Debug, LogCategory::WebView, L"w={} h={}", w, h).
+// In binary mode only the format id and the raw arguments are written.
+#define LOG_FMT(level, category, ...) \
+    do { \
+        if constexpr (LogCompiledIn(level, category)) { \
+            if (Logger::Instance().IsEnabled(level, category)) { \
+                static const uint16_t hdrLogFormatId = Logger::Instance().RegisterFormat( \
+                    level, category, __FILE__, __LINE__, HDR_LOG_EXPAND(HDR_LOG_FIRST(__VA_ARGS__, 0))); \
+                Logger::Instance().LogFormat(hdrLogFormatId, level, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#define LOG_MSG(...) LOG_AT(LogLevel::Info, LogCategory::General, __VA_ARGS__)
@@ -0,0 +1,121 @@
+// MemoryGovernor.h - one memory budget shared by the caches and pools of a slideshow
+#pragma once
+
+#include "Logger.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Gauge;
+
+// Which memory gives way first: lower priorities lose their budget before higher ones
+enum class MemoryPriority : uint8_t {
+    Idle,           // kept only for reuse (idle pixel buffers)
+    Prefetch,       // ahead of what is shown (encoded images of the next slides, tiles ahead of a pan)
+    Working,        // needed for what is on screen
+};
+
+enum class MemoryPressure : uint8_t {
+    None,
+    Moderate,       // the system is reclaiming memory: elastic consumers get half their share
+    Critical,       // tasks are stalled on memory: elastic consumers are cut to their minimum
+};
+
+const char* MemoryPriorityName(MemoryPriority priority);
+const char* MemoryPressureName(MemoryPressure pressure);
+
+// A consumer reports its usage; one with setBudget is elastic and keeps itself within the budget
+// it is given (evicting when it shrinks), one without is fixed and only counted against the total.
+// The callbacks run on the thread calling the governor and must not call back into it.
+struct MemoryConsumer {
+    std::string name;
+    MemoryPriority priority = MemoryPriority::Prefetch;
+    double refillCost = 1.0;                      // ms to get one MB back after eviction; orders consumers of one priority
+    uint64_t minBytes = 0;                        // never cut below this
+    uint64_t maxBytes = UINT64_MAX;               // never given more than this
+    std::function<uint64_t()> usage;
+    std::function<void(uint64_t)> setBudget;
+};
+
+struct MemoryAccount {
+    std::string name;
+    MemoryPriority priority = MemoryPriority::Prefetch;
+    bool elastic = false;
+    uint64_t usage = 0;
+    uint64_t budget = 0;                          // fixed consumers: their usage
+};
+
+// The budget is split in one pass: fixed usage first, then every elastic consumer's minimum,
+// then the rest in priority order, the costliest to refill first within a priority, each up to
+// its maximum. A consumer that loses budget evicts down to it, so under a shrinking budget or
+// memory pressure the least valuable memory goes first. Poll() re-reads usage and pressure at
+// most every PollInterval(); Rebalance() splits at once.
+class MemoryGovernor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MemoryGovernor(uint64_t budgetBytes);
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+    // Returns an id for Unregister. Rebalances.
+    size_t Register(MemoryConsumer consumer);
+    void Unregister(size_t id);
+
+    void SetBudget(uint64_t budgetBytes);
+    uint64_t Budget() const;
+
+    void Rebalance();
+    // Rebalances if the pressure changed or fixed usage moved by more than 1/64 of the budget
+    void Poll(Clock::time_point now);
+    void SetPollInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds PollInterval() const;
+
+    // Where pressure is read from; SystemMemoryPressure by default
+    void SetPressureSource(std::function<MemoryPressure()> source);
+    MemoryPressure Pressure() const;
+
+    // Usage as of the last rebalance or poll
+    std::vector<MemoryAccount> Accounting() const;
+    uint64_t UsedBytes() const;
+    // One line for the total and one per consumer
+    void LogAccounting(LogLevel level = LogLevel::Info) const;
+
+    // Linux: /proc/pressure/memory (PSI), Windows: the system memory load
+    static MemoryPressure SystemMemoryPressure();
+    // Pressure from a PSI file ("some avg10=... " / "full avg10=..."): Moderate from 10% of time
+    // with some task stalled over the last 10 s, Critical from 10% with all tasks stalled.
+    // None if the file is missing or unreadable.
+    static MemoryPressure ReadPsi(const std::filesystem::path& path);
+    static MemoryPressure ParsePsi(const std::string& text);
+
+private:
+    struct Slot {
+        size_t id;
+        MemoryConsumer consumer;
+        uint64_t usage = 0;
+        uint64_t budget = 0;
+        bool assigned = false;
+        Gauge* usageGauge = nullptr;
+        Gauge* budgetGauge = nullptr;
+    };
+
+    void RebalanceLocked();
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    size_t nextId_ = 1;
+    uint64_t budget_;
+    uint64_t lastFixed_ = 0;
+    MemoryPressure pressure_ = MemoryPressure::None;
+    std::function<MemoryPressure()> pressureSource_;
+    std::chrono::milliseconds pollInterval_{ 1000 };
+    Clock::time_point nextPoll_{};
+    Gauge& budgetGauge_;
+    Gauge& pressureGauge_;
+};
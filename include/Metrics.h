@@ -0,0 +1,168 @@
+// Metrics.h - low-overhead runtime counters, gauges and latency histograms
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Counters and histograms are sharded per thread so hot paths never contend on one cache line.
+constexpr uint32_t kMetricShards = 16;
+
+inline uint32_t MetricShardIndex() {
+    static std::atomic<uint32_t> nextIndex{ 0 };
+    thread_local uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return index;
+}
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// Monotonically increasing count (images shown, bytes read, ...).
+class Counter {
+public:
+    void Add(uint64_t n = 1) { shards_[MetricShardIndex()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Value() const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+private:
+    struct alignas(64) Shard { std::atomic<uint64_t> value{ 0 }; };
+    std::array<Shard, kMetricShards> shards_;
+};
+
+// Current value of something that goes up and down (queue depth, cache bytes, ...).
+class Gauge {
+public:
+    void Set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void Add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<int64_t> value_{ 0 };
+};
+
+// Merged view of a Histogram.
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets;
+    // Value at quantile q (0..1), accurate to the bucket width (about 6 %)
+    uint64_t Percentile(double q) const;
+};
+
+// HDR-style log-linear histogram for latencies in microseconds. Values below 32 get exact buckets;
+// above that every power of two is split into 16 sub-buckets, up to 2^41 (larger values are clamped).
+class Histogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxBit = 40;
+    static constexpr int kBucketCount = (kMaxBit - kSubBucketBits + 2) * kSubBuckets;
+
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketLowerBound(int index);
+    static uint64_t BucketUpperBound(int index) { return BucketLowerBound(index + 1) - 1; }
+
+    void Record(uint64_t value);
+    HistogramSnapshot Snapshot() const;
+
+private:
+    static constexpr uint32_t kShards = 4;
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> sum{ 0 };
+        std::atomic<uint64_t> max{ 0 };
+        std::array<std::atomic<uint64_t>, kBucketCount> buckets{};
+    };
+    std::array<Shard, kShards> shards_;
+};
+
+// Records the lifetime of the object (in microseconds) into a histogram.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& h) : histogram_(h), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.Record(ElapsedMicros()); }
+    uint64_t ElapsedMicros() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count());
+    }
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+enum class MetricsFormat { Json = 0, Prometheus = 1 };
+
+struct MetricsExportConfig {
+    // File path, or "unix:<socket path>" to send each snapshot to a local collector
+    std::wstring target;
+    MetricsFormat format = MetricsFormat::Json;
+    int intervalSeconds = 60;
+};
+
+// Process-wide metrics registry. Modules register their metrics on first use and keep the returned
+// reference, e.g.
+//   static Counter& shown = Metrics::Instance().GetCounter("hdr_images_shown_total", "Images shown");
+//   shown.Add();
+// The same name + labels always returns the same object.
+class Metrics {
+public:
+    static Metrics& Instance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    Counter& GetCounter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Gauge& GetGauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Histogram& GetHistogram(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    // Gauge whose value is computed when a snapshot is taken (for sizes owned by other modules)
+    void RegisterGaugeCallback(const std::string& name, const std::string& help, std::function<int64_t()> callback,
+                               const MetricLabels& labels = {});
+
+    std::string SnapshotJson() const;
+    std::string SnapshotPrometheus() const;
+
+    // Starts a background thread writing a snapshot every intervalSeconds (and once more on stop).
+    void StartExporter(const MetricsExportConfig& config);
+    void StopExporter();
+
+private:
+    Metrics() = default;
+    ~Metrics() { StopExporter(); }
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    enum class Kind { Counter, Gauge, GaugeCallback, Histogram };
+    struct Entry {
+        Kind kind;
+        std::string name;
+        std::string help;
+        MetricLabels labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<int64_t()> callback;
+    };
+
+    Entry& FindOrAdd(Kind kind, const std::string& name, const std::string& help, const MetricLabels& labels);
+    bool WriteSnapshot(const MetricsExportConfig& config) const;
+    void ExporterLoop(MetricsExportConfig config);
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+    std::thread exporter_;
+    std::mutex exporterMutex_;
+    std::condition_variable exporterCv_;
+    bool exporterStop_ = false;
+};
@@ -0,0 +1,131 @@
+// PixelBufferPool.h - recycled, pre-faulted buffers for decoded frames and the planes behind them
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Counter;
+class Gauge;
+
+struct PixelPoolStats {
+    uint64_t mappedBytes = 0;     // held from the system: in use plus idle
+    uint64_t inUseBytes = 0;      // class size of the buffers handed out
+    uint64_t idleBytes = 0;       // released buffers kept for reuse
+    uint64_t peakMappedBytes = 0;
+    uint64_t maps = 0;            // buffers taken from the system (and pre-faulted)
+    uint64_t reuses = 0;          // requests served from an idle buffer
+    uint64_t unmaps = 0;          // idle buffers given back by trimming
+};
+
+// A decoded 24 MP image is several 24 MB planes, and a bake or gain-map pipeline needs a few of
+// those per slide. Taking them from the heap per slide maps fresh pages every time (glibc and
+// the Windows heap hand allocations this large straight to the OS), so every slide pays a page
+// fault per 4 KB page. The pool keeps such buffers after release and hands them out again.
+//
+// Requests of kMinPooledBytes or more are rounded up to a size class (2 MB granules, four
+// classes per doubling, so at most 25% slack) and served from an idle buffer of that class, or
+// mapped 2 MB aligned, advised for transparent huge pages (large pages on Windows when the
+// process may lock memory) and pre-faulted. Smaller requests use the heap. Idle buffers are
+// given back after IdleTimeout() without reuse and whenever the idle bytes exceed IdleBudget().
+class PixelBufferPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kMinPooledBytes = 1024 * 1024;
+    static constexpr size_t kGranuleBytes = 2 * 1024 * 1024;
+
+    static PixelBufferPool& Instance() {
+        static PixelBufferPool pool;
+        return pool;
+    }
+
+    PixelBufferPool(const PixelBufferPool&) = delete;
+    PixelBufferPool& operator=(const PixelBufferPool&) = delete;
+
+    // Returns at least `bytes` bytes, aligned to 64 bytes (2 MB for pooled buffers). Throws
+    // std::bad_alloc like operator new.
+    void* Acquire(size_t bytes);
+    // `bytes` must be the size passed to Acquire
+    void Release(void* data, size_t bytes) noexcept;
+
+    // Gives back idle buffers unused for IdleTimeout(); cheap, called on every Release and by
+    // owners that go idle (between slides, after a bake run)
+    void TrimIdle();
+    // Gives back every idle buffer
+    void Trim();
+
+    void SetIdleTimeout(std::chrono::milliseconds timeout);
+    void SetIdleBudget(uint64_t bytes);
+    std::chrono::milliseconds IdleTimeout() const;
+    uint64_t IdleBudget() const;
+
+    // With pooling disabled every request goes to the heap, as without the pool; buffers
+    // acquired before are still recognized on release. For measurements.
+    void SetEnabled(bool enabled);
+    bool Enabled() const;
+
+    PixelPoolStats Stats() const;
+
+    // Class size a pooled request is rounded up to
+    static size_t ClassBytes(size_t bytes);
+
+private:
+    struct Block {
+        void* data;
+        size_t bytes;
+        Clock::time_point idleSince;
+    };
+
+    PixelBufferPool();
+    ~PixelBufferPool();
+
+    void TrimLocked(Clock::time_point now, bool all);
+    void UnmapLocked(const Block& block);
+    void PublishLocked();
+
+    mutable std::mutex mutex_;
+    bool enabled_ = true;
+    std::chrono::milliseconds idleTimeout_{ 30000 };
+    uint64_t idleBudget_ = 1024ull * 1024 * 1024;
+    std::vector<Block> idle_;                         // most recently released last
+    std::unordered_map<void*, size_t> inUse_;         // pooled buffers handed out -> class bytes
+    PixelPoolStats stats_;
+
+    Gauge& mappedGauge_;
+    Gauge& idleGauge_;
+    Counter& mapsCounter_;
+    Counter& reusesCounter_;
+};
+
+// Allocator for pixel planes: large planes come from the pool, elements are default-initialized
+// (left uninitialized for bytes), so sizing a plane does not write it.
+template<typename T>
+struct PixelAllocator {
+    using value_type = T;
+
+    PixelAllocator() noexcept = default;
+    template<typename U>
+    PixelAllocator(const PixelAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(PixelBufferPool::Instance().Acquire(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) noexcept { PixelBufferPool::Instance().Release(p, n * sizeof(T)); }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) ::new (static_cast<void*>(p)) U;
+        else ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    bool operator==(const PixelAllocator<U>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const PixelAllocator<U>&) const noexcept { return false; }
+};
+
+using PixelPlane = std::vector<uint8_t, PixelAllocator<uint8_t>>;
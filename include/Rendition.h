@@ -0,0 +1,111 @@
+// Rendition.h - display-resolution renditions of library images, baked offline by tools/hdrbake
+// into a mirror of the library folder and preferred by the slideshow loader when current
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileIdentity.h"
+#include "Slideshow.h"
+
+enum class RenditionStatus {
+    Baked,          // a rendition exists in the mirror folder
+    Original,       // the source already fits the display size and is used as is
+    Unsupported,    // not a format the baker handles (PNG, progressive JPEG, ...); the source is used
+    Failed,         // read, decode or write error; retried on the next run
+};
+
+const char* RenditionStatusName(RenditionStatus status);
+
+struct BakeOptions {
+    int maxWidth = 3840;
+    int maxHeight = 2160;
+    int quality = 90;
+    int gainMapQuality = 85;
+};
+
+struct BakeResult {
+    RenditionStatus status = RenditionStatus::Failed;
+    int width = 0;                // rendition size (source size for Original)
+    int height = 0;
+    bool gainMap = false;         // the rendition carries a gain map
+    std::string error;
+};
+
+// Downscales a JPEG (or a JPEG + gain map MPF / Ultra HDR file) to fit the display size. The
+// gain map is scaled by the same factor and written back as an Ultra HDR JPEG: the primary image
+// with its EXIF / ICC / XMP segments, a new MPF directory and the gain map image with its own
+// hdrgm or ISO 21496-1 metadata. `out` is only filled for RenditionStatus::Baked.
+BakeResult BakeRendition(const uint8_t* data, size_t size, const BakeOptions& options, std::vector<uint8_t>& out);
+
+// Size and modification time of a source file; a rendition is current while both match
+struct SourceIdentity {
+    uint64_t size = 0;
+    int64_t modified = 0;
+
+    bool operator==(const SourceIdentity&) const = default;
+    static bool Of(const std::filesystem::path& path, SourceIdentity& identity);
+};
+
+struct RenditionRecord {
+    RenditionStatus status = RenditionStatus::Failed;
+    SourceIdentity source;
+    ContentHash content;          // fingerprint of the source, empty in manifests of older bakes
+    uint64_t renditionSize = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// The manifest of a mirror folder: which library files have a rendition and for which source
+// identity. Lookups are safe from several threads as long as nothing modifies the store.
+class RenditionStore {
+public:
+    static constexpr const wchar_t* kManifestName = L"manifest.tsv";
+
+    RenditionStore(std::filesystem::path libraryRoot, std::filesystem::path mirrorRoot);
+
+    // Reads the manifest. Returns false if there is none or it cannot be parsed.
+    bool Load();
+    // Writes the manifest atomically (temp file + rename)
+    bool Save() const;
+
+    const std::filesystem::path& LibraryRoot() const { return libraryRoot_; }
+    const std::filesystem::path& MirrorRoot() const { return mirrorRoot_; }
+    const BakeOptions& Options() const { return options_; }
+    void SetOptions(const BakeOptions& options) { options_ = options; }
+
+    // Mirror path of a library file, empty if the file is outside the library folder
+    std::filesystem::path RenditionPath(const std::filesystem::path& source) const;
+
+    const RenditionRecord* Find(const std::filesystem::path& source) const;
+    void Set(const std::filesystem::path& source, const RenditionRecord& record);
+    // Drops records whose source is not in `keep` and deletes their renditions; returns the count
+    size_t Prune(const std::vector<std::filesystem::path>& keep);
+    // Moves the records (and renditions) of sources that are no longer in `keep` to the files in
+    // `sources` with the same fingerprint, so renamed or moved photos are not baked again. The
+    // sources are files without a record, with their current identity and fingerprint. Returns
+    // the number of records moved.
+    size_t Relink(const std::vector<std::filesystem::path>& keep,
+                  const std::vector<std::pair<std::filesystem::path, RenditionRecord>>& sources);
+    size_t Size() const { return records_.size(); }
+    void Clear() { records_.clear(); }
+
+    // The file the slideshow should read: the rendition if it is current, otherwise the source
+    CatalogEntry Resolve(const CatalogEntry& entry) const;
+    // Slideshow loader that reads Resolve(entry) and falls back to the source if that fails.
+    // With `headroom` (stops, read at every load) it reads like Slideshow::LoadImageFileForHeadroom.
+    // The store and the headroom must outlive the loader.
+    Slideshow::LoadFunction Loader(const std::atomic<float>* headroom = nullptr) const;
+
+private:
+    std::wstring Key(const std::filesystem::path& source) const;
+
+    std::filesystem::path libraryRoot_;
+    std::filesystem::path mirrorRoot_;
+    BakeOptions options_;
+    std::unordered_map<std::wstring, RenditionRecord> records_;   // keyed by generic relative path
+};
@@ -0,0 +1,63 @@
+// SessionSnapshot.h - where the slideshow left off and the bytes of the slides it would have
+// shown next, so the next activation puts an image on screen before the library is listed
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+
+class Slideshow;
+
+struct SnapshotSlide {
+    size_t output = 0;
+    CatalogEntry entry;                       // library file, with the size and time it had when loaded
+    std::shared_ptr<const ImageData> data;    // bytes as the slideshow loaded them (rendition or file), null if not stored
+};
+
+// Written on exit and every few minutes of a session; holds each output's upcoming slides in
+// order. Bytes are stored for as many of them as fit the budget, first slides first, so a
+// typical snapshot holds the next image of every output. A slide whose file has changed or gone
+// since is dropped on restore, which costs one stat per slide and no read of the library.
+class SessionSnapshot {
+public:
+    static constexpr uint64_t kMaxBytes = uint64_t(32) << 20;
+
+    // What the session showed; a snapshot of different settings is not restored
+    std::wstring folder;
+    bool includeSubfolders = true;
+    std::wstring playlistQuery;
+    bool randomOrder = false;
+    std::vector<SnapshotSlide> slides;
+
+    // session-snapshot.bin in AppCacheFolder()
+    static std::filesystem::path DefaultPath();
+
+    // The upcoming slides of every output, with the bytes the cache holds for them (whole files
+    // only, not those loaded without their gain map)
+    static SessionSnapshot Capture(const Slideshow& slideshow, ImageCache& cache, uint64_t maxBytes = kMaxBytes);
+
+    bool Matches(const std::wstring& folder, bool includeSubfolders, const std::wstring& playlistQuery, bool randomOrder) const;
+
+    // The slides that are still current, as a catalog in snapshot order; data[i] holds the
+    // stored bytes of entry i (or null) and first[o] the index of output o's first slide (npos
+    // if it has none)
+    ImageCatalog Restore(std::vector<std::shared_ptr<const ImageData>>& data, std::vector<size_t>& first) const;
+
+    // The catalog a restored session switches to once the library is listed: the restored
+    // entries at their indices, then the whole listing. positions[i] receives the index of the
+    // listed entry for restored entry i (npos if it is not listed any more).
+    static ImageCatalog Extend(const ImageCatalog& restored, const ImageCatalog& listing, std::vector<size_t>& positions);
+    // Puts the cached images of restored entries at their listed positions too, so outputs
+    // resumed there read nothing twice
+    static void CopyRestored(ImageCache& cache, const std::vector<size_t>& positions);
+
+    // Returns false if the file is missing or damaged; the snapshot is empty then
+    bool Load(const std::filesystem::path& path);
+    // Streams the slides to a temp file that replaces `path` once complete
+    bool Save(const std::filesystem::path& path) const;
+};
@@ -8,9 +8,20 @@ struct ScreenSaverSettings {
     int maxCacheMB;
     bool logEnabled;
     std::wstring logPath;
+    int logLevel;      // minimum LogLevel written (0 = Trace ... 4 = Error), registry only
+    bool logBinary;    // write compact binary records (.hdrlog) instead of text, registry only
+    std::wstring metricsTarget;   // metrics snapshot file or "unix:<socket>", empty = off, registry only
+    int metricsFormat;            // 0 = JSON, 1 = Prometheus text, registry only
+    int metricsIntervalSeconds;   // registry only
     bool enableCaching;
+    std::wstring renditionFolder; // mirror folder written by hdrbake, empty = off, registry only
+    std::wstring playlistQuery;   // CatalogTable query selecting and ordering the images, empty = all, registry only
     bool includeSubfolders;
     bool randomizeOrder;
+    int selectionWeighting;       // random order bias: 0 = uniform, 1 = least recently shown, 2 = least often shown, registry only
+    std::wstring selectionBoost;  // CatalogTable query of images drawn more often in random order, empty = none, registry only
+    int selectionBoostFactor;     // weight multiplier for images matching selectionBoost, registry only
+    std::wstring tracePath;       // navigation trace written on exit for hdrreplay, empty = off, registry only
 };
 
 // Shows the settings dialog. Returns true if settings were changed and saved.
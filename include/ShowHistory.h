@@ -0,0 +1,46 @@
+// ShowHistory.h - how often and when each image was last shown, kept across sessions, and the
+// random order weights derived from it
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+struct ShowRecord {
+    uint32_t count = 0;
+    uint32_t lastShown = 0;      // minutes since 1970-01-01 UTC
+};
+
+// Records are keyed by a hash of the lower-cased path, so the history survives catalog order
+// changes and library rescans. The file stores records sorted by key with delta and varint
+// coding, roughly 10 bytes per image.
+class ShowHistory {
+public:
+    // show-history.bin in AppCacheFolder()
+    static std::filesystem::path DefaultPath();
+    static uint64_t KeyOf(const std::wstring& path);
+    static uint32_t MinutesNow();
+
+    // Returns false if the file is missing or damaged; the history is empty then
+    bool Load(const std::filesystem::path& path);
+    // Returns false if the history could not be written; the previous file is kept then
+    bool Save(const std::filesystem::path& path) const;
+
+    const ShowRecord* Find(uint64_t key) const;
+    void RecordShow(uint64_t key, uint32_t minute);
+    size_t Size() const { return records_.size(); }
+
+private:
+    std::unordered_map<uint64_t, ShowRecord> records_;
+};
+
+enum class SelectionWeighting : int {
+    Uniform,         // every image equally likely
+    LeastRecent,     // weight grows with the time since the image was last shown
+    LeastOften,      // weight falls with the number of times it was shown
+};
+
+// Random order weight of an image with the given history (null = never shown), before any
+// user-defined boost. Never-shown images get the largest weight.
+double SelectionWeight(const ShowRecord* record, uint32_t nowMinute, SelectionWeighting weighting);
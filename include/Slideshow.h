@@ -0,0 +1,212 @@
+// Slideshow.h - drives N independent slideshow outputs from one catalog, cache and worker pool
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "LoadCostModel.h"
+#include "WorkerPool.h"
+
+class Counter;
+class Histogram;
+class WeightedSampler;
+
+enum class SlideOrder { Sequential, Random };
+
+struct SlideOutputConfig {
+    std::wstring name;           // monitor device name, or a label for virtual outputs
+    int width = 0;               // output resolution in pixels
+    int height = 0;
+    float headroom = 1.0f;       // peak / SDR white luminance, 1 = SDR display
+    std::chrono::milliseconds interval{ 15000 };
+    bool autoAdvance = true;
+    SlideOrder order = SlideOrder::Sequential;
+    uint64_t seed = 0;           // random order seed, 0 = nondeterministic
+    size_t startIndex = 0;
+};
+
+// One slide change the renderer of an output has to perform
+struct SlideChange {
+    size_t output = 0;
+    size_t index = 0;
+    bool late = false;           // shown later than scheduled because it was not loaded in time
+};
+
+struct SlideOutputStats {
+    uint64_t shown = 0;
+    uint64_t late = 0;
+    uint64_t missed = 0;         // slides not loaded by the time they had to go on screen
+    std::chrono::microseconds worstLateness{ 0 };
+};
+
+// Every output has its own timeline, order and history. Loads for all outputs go through one
+// worker pool, and an image shown on several outputs is loaded only once. Each load has a latest
+// start, planned backwards from the slides due last: the time its slide is due on screen, or
+// the latest start of the load after it on the same worker if that is sooner, less the read and
+// render time the cost model expects for its format and size. Loads past their latest start go
+// to the display lane in that order, so a large file due later can go before a small one due
+// sooner and the small one still fits before its deadline. The others run ahead
+// one at a time on the background lane, which yields to display work, and are moved to the
+// display lane when their latest start comes. An automatic advance is reported ahead of its time
+// by the render time expected for the slide, so it is on screen when due.
+//
+// The slideshow has no clock of its own: the caller passes "now" to every call, which lets the
+// same scheduling run headless (see tools/hdrplay.cpp) with a scaled or simulated clock.
+// All methods except Acquire and Cached must be called from one thread. The worker pool must outlive the
+// slideshow.
+class Slideshow {
+public:
+    using Clock = std::chrono::steady_clock;
+    using LoadFunction = std::function<std::shared_ptr<const ImageData>(const CatalogEntry&)>;
+    using ShowFunction = std::function<void(size_t index)>;
+
+    // Slides each output keeps loaded ahead of the one on screen
+    static constexpr size_t kPrefetchDepth = 2;
+    // A slide shown later than this after its scheduled time counts as late
+    static constexpr std::chrono::milliseconds kLateTolerance{ 100 };
+    // Longest an output holds its current slide waiting for the next one to load
+    static constexpr std::chrono::milliseconds kMaxWait{ 5000 };
+    // Headroom added to the expected load time when working out a latest start (real time)
+    static constexpr std::chrono::milliseconds kStartMargin{ 100 };
+    // Loads running on the background lane ahead of their latest start
+    static constexpr size_t kMaxEarlyLoads = 1;
+    // Longest an automatic advance is reported ahead of its time (real time; also at most a
+    // quarter interval)
+    static constexpr std::chrono::milliseconds kMaxRenderLead{ 1000 };
+
+    Slideshow(const ImageCatalog& catalog, ImageCache& cache, WorkerPool& pool, LoadFunction load = LoadImageFile);
+    ~Slideshow();
+    Slideshow(const Slideshow&) = delete;
+    Slideshow& operator=(const Slideshow&) = delete;
+
+    // Adds an output; its first slide is reported by the next Tick()
+    size_t AddOutput(const SlideOutputConfig& config);
+    size_t OutputCount() const { return outputs_.size(); }
+    const SlideOutputConfig& OutputConfig(size_t output) const { return outputs_[output].config; }
+
+    // Advances every output whose slide is due and returns the changes to render
+    std::vector<SlideChange> Tick(Clock::time_point now);
+    // Manual navigation (arrow keys); restarts the output's display interval
+    SlideChange Next(size_t output, Clock::time_point now);
+    SlideChange Previous(size_t output, Clock::time_point now);
+
+    // Random order draws from the sampler (one weight per catalog entry) instead of uniformly.
+    // Weights may change between calls, e.g. from the show callback. Must outlive the slideshow.
+    void SetSampler(const WeightedSampler* sampler) { sampler_ = sampler; }
+    // Called with the catalog index of every slide that goes on screen, on any output
+    void SetShowCallback(ShowFunction onShow) { onShow_ = std::move(onShow); }
+    // Read times are measured by the slideshow; the renderer records render times. Thread-safe.
+    LoadCostModel& CostModel() { return costModel_; }
+    // Slideshow time per real time, for a caller whose clock runs faster than the loads (hdrplay)
+    void SetClockRate(double rate) { clockRate_ = rate; }
+
+    // Switches to a larger catalog that starts with all entries of the current one, at the same
+    // indices, and replans the upcoming slides. Both catalogs must outlive the slideshow.
+    void ExtendCatalog(const ImageCatalog& catalog, Clock::time_point now);
+    const ImageCatalog& Catalog() const { return *catalog_.load(); }
+
+    size_t CurrentIndex(size_t output) const { return outputs_[output].current; }
+    // The slides an output has planned next, soonest first
+    std::vector<size_t> Upcoming(size_t output) const;
+    // Moves an output to another entry for the image it shows (after ExtendCatalog appended a
+    // listing that contains it again), so sequential order continues from that entry. What is on
+    // screen and when it changes stay the same.
+    void Resume(size_t output, size_t index, Clock::time_point now);
+    const SlideOutputStats& Stats(size_t output) const { return outputs_[output].stats; }
+
+    // Returns the image for a catalog index, waiting for an in-flight load or loading it on the
+    // calling thread if needed. Returns nullptr if the file cannot be read. Thread-safe.
+    std::shared_ptr<const ImageData> Acquire(size_t index);
+    // The image for a catalog index if it is cached, without loading it. Thread-safe.
+    std::shared_ptr<const ImageData> Cached(size_t index) { return cache_.Get(index); }
+    // Acquire in a job on the display lane, for a caller that must not block; `done` is called on
+    // the worker with the result. The slideshow waits for these jobs when destroyed.
+    void AcquireAsync(size_t index, std::function<void(std::shared_ptr<const ImageData>)> done);
+
+    // Drops the cached images `stale` returns true for and loads the slides on screen and planned
+    // next again, after the loader changed what it reads (a switch to HDR needs the gain maps a
+    // load for SDR left out). Waits for loads already running with the old setting.
+    void Reload(const std::function<bool(const ImageData&)>& stale, Clock::time_point now);
+
+    // Default loader: reads the whole file
+    static std::shared_ptr<const ImageData> LoadImageFile(const CatalogEntry& entry);
+    // Loader for a display with `headroom` stops over SDR white (negative: unknown). A JPEG whose
+    // gain map gets no weight at that headroom (GainMapWeight) is read only up to the end of its
+    // primary image and served without the MPF directory, so the gain map is never read, cached
+    // or decoded by the renderer. Other files are read whole.
+    static std::shared_ptr<const ImageData> LoadImageFileForHeadroom(const CatalogEntry& entry, float headroom);
+
+private:
+    struct OutputState {
+        SlideOutputConfig config;
+        size_t current = 0;
+        bool started = false;
+        std::deque<size_t> upcoming;          // planned next slides, all pinned in the cache
+        std::vector<size_t> history;          // random order only: previously shown slides
+        size_t historyPosition = 0;
+        std::mt19937_64 rng;
+        Clock::time_point switchAt{};         // when the next slide is due
+        bool missed = false;                  // the next slide was counted as missing its deadline
+        SlideOutputStats stats;
+    };
+    struct PendingLoad {
+        Clock::time_point deadline{};
+        Clock::time_point start{};            // latest start that still meets the deadline
+        Clock::duration cost{};               // expected load time with kStartMargin (slideshow time)
+        bool loading = false;
+        bool early = false;                   // queued on the background lane ahead of its start
+    };
+
+    SlideChange Advance(size_t output, Clock::time_point now, bool scheduled);
+    void PlanUpcoming(OutputState& out);
+    size_t PickRandom(OutputState& out, size_t previous);
+    void Shown(OutputState& out);
+    void ClearUpcoming(OutputState& out);
+    void RequestLoads(OutputState& out, Clock::time_point now);
+    void Request(size_t index, Clock::time_point deadline, Clock::time_point now);
+    void SubmitLocked(size_t index, WorkerLane lane, Clock::time_point start);
+    void PlanStartsLocked();
+    void ReleaseLocked(Clock::time_point now);
+    void ReleaseEarlyLocked();
+    void RunLoad(size_t index, bool early);
+    std::shared_ptr<const ImageData> Load(size_t index);
+    bool IsReady(size_t index);
+    Clock::duration SlideshowTime(LoadCostModel::Duration duration) const;
+
+    std::atomic<const ImageCatalog*> catalog_;
+    ImageCache& cache_;
+    WorkerPool& pool_;
+    LoadFunction load_;
+    const WeightedSampler* sampler_ = nullptr;
+    ShowFunction onShow_;
+    std::deque<OutputState> outputs_;
+
+    std::mutex mutex_;                        // guards pending_, deferred_, failed_, outstanding_ and earlyLoads_
+    std::condition_variable loaded_;
+    std::unordered_map<size_t, PendingLoad> pending_;
+    std::multimap<Clock::time_point, size_t> deferred_;    // pending loads not yet started, by latest start
+    std::unordered_set<size_t> failed_;
+    size_t outstanding_ = 0;                  // jobs submitted to the pool and not yet finished
+    size_t earlyLoads_ = 0;                   // early jobs queued or running
+    LoadCostModel costModel_;
+    double clockRate_ = 1.0;
+
+    Counter& lateSlides_;
+    Counter& missedSlides_;
+    Histogram& lateness_;
+    Histogram& loadTime_;
+};
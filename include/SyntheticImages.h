@@ -0,0 +1,107 @@
+// SyntheticImages.h - deterministic test images and whole image library trees: Ultra HDR JPEGs
+// (MPF directory, gain map, hdrgm XMP, ICC profile, optional restart markers), the other formats
+// the slideshow lists, and damaged, unsupported and non-image files as photo libraries have them
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+enum class SyntheticKind : uint8_t {
+    UltraHdr,       // JPEG with a gain map JPEG in an MPF file; hdrgm XMP on both, GContainer directory
+    Jpeg,           // baseline JPEG, no gain map
+    Png,            // 8-bit RGB, stored (uncompressed) deflate
+    PqPng,          // 16-bit BT.2020 PQ with cICP, as hdrrender writes it
+    Gif,            // 256 gray levels, LZW at 9 bits
+    Bmp,            // 24-bit bottom-up
+    WebP,           // lossless (VP8L) with two values per channel
+    Svg,
+    Avif,           // valid ISOBMFF headers (ispe, pixi, nclx colr, av1C); the AV1 payload is filler
+    Jxl,            // container with a codestream header; WebView2 does not show JPEG XL
+    Tiff,           // uncompressed RGB strip; WebView2 does not show TIFF
+    Truncated,      // Ultra HDR JPEG cut in the primary image's scan: no EOI, no gain map
+    BadHeader,      // .jpg whose frame header is damaged
+    Empty,          // .jpg of zero bytes
+    Misnamed,       // PNG data in a .jpg file
+    Sidecar,        // .xmp metadata next to the images; not listed by the slideshow
+};
+
+constexpr size_t kSyntheticKinds = 16;
+
+const char* SyntheticKindName(SyntheticKind kind);
+// Extension the kind is written with, including the dot
+const char* SyntheticKindExtension(SyntheticKind kind);
+// Accepts the names SyntheticKindName returns
+bool ParseSyntheticKind(const std::string& name, SyntheticKind& kind);
+
+struct SyntheticImageOptions {
+    int width = 1024;
+    int height = 683;
+    int quality = 85;                 // JPEG quality of the primary image; the gain map uses the same
+    int gainMapScale = 4;             // gain map of width / scale x height / scale pixels
+    int restartInterval = 0;          // MCUs between RSTn markers in the primary image, 0 for none
+    bool icc = true;                  // Display P3 ICC profile in JPEG (APP2) and PNG (iCCP)
+    float gainMapMax = 2.0f;          // hdrgm:GainMapMax, log2
+    float hdrCapacityMax = 2.0f;      // hdrgm:HDRCapacityMax, log2
+    uint64_t seed = 1;                // pixel content
+};
+
+// One built file. `stamp` points at kStampDigits bytes that carry a per-file number, so copies
+// of one image written as different files differ in content (file fingerprints, deduplication);
+// for PNG the chunk CRC over [crcStart, crcEnd) is written at crcEnd after stamping.
+struct SyntheticImage {
+    static constexpr size_t kStampDigits = 16;
+
+    std::vector<uint8_t> bytes;
+    size_t stamp = 0;
+    size_t crcStart = 0;
+    size_t crcEnd = 0;                // 0 = no CRC to update
+    bool stamped = false;             // has a stamp (not for Empty)
+};
+
+// Builds one file; the same kind and options give the same bytes on every platform
+bool BuildSyntheticImage(SyntheticKind kind, const SyntheticImageOptions& options, SyntheticImage& image, std::string* error = nullptr);
+// Writes `number` into the stamp as hex digits and updates the CRC it is covered by
+void StampSyntheticImage(SyntheticImage& image, uint64_t number);
+
+struct SyntheticCorpusOptions {
+    size_t files = 1000;
+    size_t filesPerFolder = 100;
+    size_t fanOut = 10;               // subfolders per folder; the tree is as deep as the folder count needs
+    uint64_t seed = 1;                // kind, variant and date of every file
+    size_t variants = 4;              // images built per kind; files are stamped copies of them
+    int years = 10;                   // modification times spread over this many years before 2025
+    std::array<double, kSyntheticKinds> mix = DefaultMix();    // relative share of each kind
+    SyntheticImageOptions image;      // variants alternate landscape / portrait and vary the seed
+
+    // About what a camera and phone library holds: mostly JPEG, a third of it Ultra HDR, a few
+    // percent damaged or unsupported files and some sidecars
+    static std::array<double, kSyntheticKinds> DefaultMix();
+};
+
+struct SyntheticCorpusResult {
+    size_t files = 0;
+    size_t folders = 0;
+    uint64_t bytes = 0;
+    std::array<size_t, kSyntheticKinds> kinds{};
+};
+
+// File `index` of a corpus, decided from the seed and the index alone without writing anything
+struct SyntheticFile {
+    std::string path;                 // relative, '/' separated: folder-03/folder-07/IMG_0001234.jpg
+    SyntheticKind kind = SyntheticKind::Jpeg;
+    size_t variant = 0;
+    int64_t modified = 0;             // seconds since 1970
+};
+
+SyntheticFile SyntheticCorpusFile(const SyntheticCorpusOptions& options, size_t index);
+
+// Writes the tree below `root` (created if needed; existing files are overwritten). Folders are
+// written as jobs on `pool` if one is given. Returns false on the first write error.
+bool WriteSyntheticCorpus(const std::filesystem::path& root, const SyntheticCorpusOptions& options, SyntheticCorpusResult& result,
+                          WorkerPool* pool = nullptr, std::string* error = nullptr);
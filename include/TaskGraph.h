@@ -0,0 +1,53 @@
+// TaskGraph.h - the stages of one piece of work (a slide's render) as tasks with dependencies,
+// run on a WorkerPool so that independent stages overlap
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "WorkerPool.h"
+
+// Tasks are added in dependency order (a task can only wait for tasks added before it) and the
+// graph runs once. Run submits every task that becomes ready to the pool and runs ready tasks on
+// the calling thread as well, so a graph finishes even when the pool is busy or the caller is
+// one of its workers; without a pool the calling thread runs them all. A task that returns
+// false, or a cancel flag set during the run, skips every task not started yet; running tasks
+// finish, or watch the flag themselves.
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    struct TaskTiming {
+        std::string name;
+        double startMs = 0;              // from the start of Run
+        double endMs = 0;
+        bool ran = false;
+    };
+
+    TaskGraph();
+    ~TaskGraph();
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskId Add(std::string name, std::function<bool()> run, std::initializer_list<TaskId> after = {});
+
+    // Returns true if every task ran and succeeded. Tasks go to the pool with `deadline`.
+    bool Run(WorkerPool* pool = nullptr, WorkerPool::Clock::time_point deadline = {}, const std::atomic<bool>* cancel = nullptr);
+    bool Cancelled() const;
+
+    // After Run: per task, in the order added
+    std::vector<TaskTiming> Timings() const;
+    // Sum of the task durations: the latency of running them one after the other
+    double SerialMs() const;
+    // Longest chain of dependent tasks, by duration: the latency with a core for every task
+    double CriticalPathMs() const;
+
+private:
+    struct Shared;
+    std::shared_ptr<Shared> shared_;
+};
@@ -0,0 +1,113 @@
+// TiledImage.h - zoom and pan over very large JPEG and Ultra HDR files: only the tiles of the
+// primary image and of its gain map that cover the viewport are decoded, at the scale the zoom
+// needs, and kept in a byte-budgeted LRU; tiles ahead in the pan direction are decoded early
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "JpegCodec.h"
+
+class WorkerPool;
+
+enum class TileLayer { Image = 0, GainMap = 1 };
+
+struct ImageTile {
+    TileLayer layer = TileLayer::Image;
+    int scaleLog2 = 0;            // the tile is in pixels of the layer scaled by 1 / 2^scaleLog2
+    int column = 0, row = 0;
+    int x = 0, y = 0;             // top left corner in those pixels
+    PlanarImage pixels;           // kTileSize square, smaller at the right and bottom edges
+};
+
+// Visible part of the primary image, in its pixels, and how many screen pixels one of them takes
+struct Viewport {
+    double x = 0, y = 0;
+    double width = 0, height = 0;
+    double zoom = 1;
+};
+
+struct TiledImageStats {
+    uint64_t decoded = 0;         // tiles decoded on the caller's thread because they were missing
+    uint64_t prefetched = 0;      // tiles decoded ahead on the worker pool
+    uint64_t hits = 0;            // tiles found in the cache
+    uint64_t bytes = 0;           // pixels held by the cache
+    uint64_t peakBytes = 0;
+};
+
+class TiledImage {
+public:
+    static constexpr int kTileSize = 512;
+
+    // Prefetching needs a pool; without one Prefetch does nothing
+    explicit TiledImage(uint64_t budgetBytes, WorkerPool* pool = nullptr);
+    ~TiledImage();
+    TiledImage(const TiledImage&) = delete;
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    // Indexes the primary image and, for an Ultra HDR / MPF file, the gain map. The file is
+    // shared with the decode jobs, so it may be dropped by the caller.
+    bool Open(std::shared_ptr<const std::vector<uint8_t>> file, std::string* error = nullptr);
+
+    int Width() const { return image_.Width(); }
+    int Height() const { return image_.Height(); }
+    bool HasGainMap() const { return gainMap_.IsOpen(); }
+    // Memory of the MCU indexes of both layers
+    size_t IndexBytes() const { return image_.IndexBytes() + gainMap_.IndexBytes(); }
+
+    // Coarsest scale that still has at least one layer pixel per screen pixel
+    static int ScaleFor(double zoom);
+
+    // The tiles of both layers that cover the viewport. Missing tiles are decoded on this thread.
+    std::vector<std::shared_ptr<const ImageTile>> Visible(const Viewport& viewport);
+    // Decodes on the pool the tiles one tile beyond the viewport in the direction it moved
+    // (dx, dy in image pixels since the last frame), so the next pan step finds them cached
+    void Prefetch(const Viewport& viewport, double dx, double dy);
+    // Waits for queued prefetches
+    void WaitPrefetch();
+
+    void SetBudget(uint64_t budgetBytes);
+    TiledImageStats Stats() const;
+
+private:
+    struct TileRange {
+        TileLayer layer;
+        int scaleLog2;
+        int column0, row0, column1, row1;     // inclusive
+    };
+
+    const JpegRegionDecoder& Decoder(TileLayer layer) const { return layer == TileLayer::Image ? image_ : gainMap_; }
+    // Tiles of a layer that cover the viewport, at the layer's scale for the zoom
+    bool RangeFor(TileLayer layer, const Viewport& viewport, TileRange& range) const;
+    static uint64_t Key(TileLayer layer, int scaleLog2, int column, int row);
+    std::shared_ptr<const ImageTile> Decode(TileLayer layer, int scaleLog2, int column, int row) const;
+    std::shared_ptr<const ImageTile> Find(uint64_t key, bool countHit);
+    void Insert(uint64_t key, std::shared_ptr<const ImageTile> tile);
+    void EvictLocked();
+
+    std::shared_ptr<const std::vector<uint8_t>> file_;
+    JpegRegionDecoder image_;
+    JpegRegionDecoder gainMap_;
+    double gainMapScaleX_ = 1;    // gain map pixels per primary image pixel
+    double gainMapScaleY_ = 1;
+    WorkerPool* pool_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable prefetchDone_;
+    struct Entry {
+        std::shared_ptr<const ImageTile> tile;
+        std::list<uint64_t>::iterator lru;
+    };
+    std::list<uint64_t> lru_;     // front = most recently used
+    std::unordered_map<uint64_t, Entry> tiles_;
+    std::unordered_set<uint64_t> pending_;
+    uint64_t budget_;
+    TiledImageStats stats_;
+};
@@ -0,0 +1,56 @@
+// WeightedSampler.h - random draws proportional to per-item weights, with O(1) weight updates
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Items are grouped by the power of two their weight falls into. A draw picks a group in
+// proportion to its total weight (at most kLevels groups, skipped via a bitmask), then an item of
+// the group uniformly and accepts it with probability weight / group ceiling, which is at least
+// 1/2. So draws take expected constant time, and changing a weight moves one item between groups
+// instead of rebuilding an alias table. Weights are kept in fixed point, so totals never drift.
+class WeightedSampler {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    WeightedSampler() = default;
+    explicit WeightedSampler(const std::vector<double>& weights) { Assign(weights); }
+
+    // Replaces all items; O(n)
+    void Assign(const std::vector<double>& weights);
+    // Changes one weight; 0 excludes the item from draws. O(1).
+    void Set(size_t item, double weight);
+    double Weight(size_t item) const;
+
+    size_t Size() const { return weights_.size(); }
+    // True if no item has a positive weight
+    bool Empty() const { return total_ == 0; }
+
+    // An item with probability weight / total, or npos if Empty()
+    size_t Draw(std::mt19937_64& rng) const;
+
+private:
+    static constexpr int kLevels = 40;                         // weights up to 2^24 at 1/2^16 resolution
+    static constexpr double kUnit = double(1 << 16);          // fixed point scale of weight 1.0
+    static constexpr uint64_t kMaxFixed = (uint64_t(1) << kLevels) - 1;
+
+    static uint64_t ToFixed(double weight);
+    void Insert(uint32_t item, uint64_t fixed);
+    void Remove(uint32_t item);
+
+    // Buckets carry a copy of the weight so a try touches one cache line, not two
+    struct Slot {
+        uint64_t fixed;
+        uint32_t item;
+    };
+
+    std::vector<uint64_t> weights_;                            // fixed point
+    std::vector<uint32_t> slots_;                              // position in its level's bucket
+    std::array<std::vector<Slot>, kLevels> buckets_;
+    std::array<uint64_t, kLevels> levelTotals_{};
+    uint64_t levelMask_ = 0;                                   // bit per non-empty level
+    uint64_t total_ = 0;
+};
@@ -0,0 +1,110 @@
+// WorkerPool.h - the shared worker threads for all background work: per-worker deques with work
+// stealing, a display lane ahead of a background lane, earliest deadline first within a lane
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class Counter;
+class Gauge;
+
+// Work the display is waiting for (the next slide, visible tiles, a render) goes to the display
+// lane; cataloging, indexing and folder scans go to the background lane and run only when no
+// display job is queued anywhere in the pool.
+enum class WorkerLane : uint8_t {
+    Display,
+    Background,
+};
+
+// Jobs wait in one queue per lane and run in deadline order, equal deadlines in submission order.
+// The exception is a job without a deadline (kNoDeadline) submitted by a running job: it goes to
+// the deque of its worker, which runs its own newest job first (its data is still in cache) while
+// idle workers steal the oldest. A worker looks for work in this order: own display deque, display queue,
+// other workers' display deques, then the same three for the background lane.
+class WorkerPool {
+public:
+    using Clock = std::chrono::steady_clock;
+    // For jobs a running job splits its work into; see the class comment
+    static constexpr Clock::time_point kNoDeadline = Clock::time_point::max();
+
+    // threadCount 0 picks one thread per core (at least 2, since loads mostly wait on IO)
+    explicit WorkerPool(unsigned threadCount = 0);
+    // Jobs still queued are dropped; running ones finish first
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queues a display job
+    void Submit(Clock::time_point deadline, std::function<void()> job);
+    // Queues a job on `lane`. A job whose cancel flag is set by the time a worker takes it is
+    // dropped without running; a running job watches the flag itself to stop early.
+    void Submit(WorkerLane lane, Clock::time_point deadline, std::function<void()> job, const std::atomic<bool>* cancel = nullptr);
+    // Runs `work` on the calling thread and in up to `helpers` display jobs, for work that shares
+    // itself out (every call takes items until none are left). From a worker the jobs have no
+    // deadline and stay on its deque. Returns when the calling thread's call and every job that
+    // started before it ended have returned; a job that starts later does nothing, so a caller
+    // that is itself a pool job never waits for jobs queued behind it.
+    void RunShared(unsigned helpers, const std::function<void()>& work);
+    // Blocks until every queue is empty and no job is running
+    void WaitIdle();
+
+    size_t QueueDepth() const;
+    unsigned ThreadCount() const { return static_cast<unsigned>(threads_.size()); }
+    // Jobs taken from another worker's deque, and jobs dropped because they were cancelled
+    uint64_t Steals() const;
+    uint64_t CancelledJobs() const;
+
+private:
+    struct Job {
+        Clock::time_point deadline;
+        uint64_t sequence = 0;
+        std::function<void()> run;
+        const std::atomic<bool>* cancel = nullptr;
+    };
+    struct LaterFirst {
+        bool operator()(const Job& a, const Job& b) const {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+    static constexpr size_t kLanes = 2;
+    struct Lane {
+        std::mutex mutex;
+        std::priority_queue<Job, std::vector<Job>, LaterFirst> queue;
+    };
+    // One per worker thread, on its own cache line: the owner pushes and pops at the back,
+    // thieves take from the front. The lock is only contended while a steal is under way.
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs[kLanes];
+    };
+
+    void WorkerLoop(size_t index);
+    bool TakeJob(size_t index, Job& job);
+    void Finish();
+
+    Lane lanes_[kLanes];
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<uint64_t> nextSequence_{ 0 };
+    std::atomic<size_t> queued_{ 0 };        // jobs in any queue or deque
+    std::atomic<size_t> unfinished_{ 0 };    // queued plus running
+    std::atomic<unsigned> sleeping_{ 0 };
+    std::atomic<bool> stop_{ false };
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::atomic<uint64_t> steals_{ 0 };
+    std::atomic<uint64_t> cancelledJobs_{ 0 };
+    std::vector<std::thread> threads_;
+    Gauge& queueDepth_;
+    Counter& stealsTotal_;
+    Counter& cancelledTotal_;
+};
@@ -0,0 +1,590 @@
+// AsyncFileReader.cpp - io_uring, overlapped I/O and reader thread backends
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "AsyncFileReader.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <thread>
+
+class AsyncFileReader::Engine {
+public:
+    virtual ~Engine() = default;
+    virtual AsyncIoBackend Backend() const = 0;
+    virtual void ReadAll(const std::vector<AsyncReadRequest>& requests, const Completion& onComplete) = 0;
+};
+
+namespace {
+
+// One page aligned block holding the buffers of all slots
+class SlotBuffers {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    SlotBuffers(unsigned slots, uint32_t slotBytes)
+        : slotBytes_((static_cast<size_t>(slotBytes) + kAlignment - 1) / kAlignment * kAlignment), size_(slotBytes_ * slots),
+          data_(static_cast<uint8_t*>(::operator new(size_, std::align_val_t(kAlignment))))
+    {
+    }
+    ~SlotBuffers() { ::operator delete(data_, std::align_val_t(kAlignment)); }
+    SlotBuffers(const SlotBuffers&) = delete;
+    SlotBuffers& operator=(const SlotBuffers&) = delete;
+
+    uint8_t* Slot(size_t slot) const { return data_ + slot * slotBytes_; }
+    size_t SlotBytes() const { return slotBytes_; }
+
+private:
+    size_t slotBytes_;
+    size_t size_;
+    uint8_t* data_;
+};
+
+uint32_t ClampedLength(const AsyncReadRequest& request, uint32_t maxReadBytes)
+{
+    return std::min(request.length, maxReadBytes);
+}
+
+// ---------------------------------------------------------------------
+// Reader threads: one per slot, each opening and reading its files synchronously
+// ---------------------------------------------------------------------
+class ThreadEngine final : public AsyncFileReader::Engine {
+public:
+    ThreadEngine(unsigned queueDepth, uint32_t maxReadBytes)
+        : queueDepth_(queueDepth), maxReadBytes_(maxReadBytes), buffers_(queueDepth, maxReadBytes)
+    {
+    }
+
+    AsyncIoBackend Backend() const override { return AsyncIoBackend::Threads; }
+
+    void ReadAll(const std::vector<AsyncReadRequest>& requests, const AsyncFileReader::Completion& onComplete) override
+    {
+        struct Done {
+            size_t slot;
+            AsyncReadResult result;
+        };
+        std::mutex mutex;
+        std::condition_variable doneReady;
+        std::condition_variable slotFree;
+        std::deque<Done> done;
+        std::vector<bool> consumed(queueDepth_, true);
+        std::atomic<size_t> next{ 0 };
+
+        auto worker = [&](size_t slot) {
+            for (size_t i = next++; i < requests.size(); i = next++) {
+                AsyncReadResult result = Read(requests[i], buffers_.Slot(slot));
+                std::unique_lock<std::mutex> lock(mutex);
+                consumed[slot] = false;
+                done.push_back({ slot, result });
+                doneReady.notify_one();
+                // The buffer is the caller's until its callback returned
+                slotFree.wait(lock, [&] { return consumed[slot]; });
+            }
+        };
+        const size_t threadCount = std::min<size_t>(queueDepth_, requests.size());
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for (size_t t = 0; t < threadCount; ++t) threads.emplace_back(worker, t);
+
+        for (size_t completed = 0; completed < requests.size(); ++completed) {
+            std::unique_lock<std::mutex> lock(mutex);
+            doneReady.wait(lock, [&] { return !done.empty(); });
+            const Done item = done.front();
+            done.pop_front();
+            lock.unlock();
+            onComplete(item.result);
+            lock.lock();
+            consumed[item.slot] = true;
+            slotFree.notify_all();
+        }
+        for (std::thread& t : threads) t.join();
+    }
+
+private:
+    AsyncReadResult Read(const AsyncReadRequest& request, uint8_t* buffer) const
+    {
+        AsyncReadResult result;
+        result.tag = request.tag;
+        result.data = buffer;
+        errno = 0;
+        std::ifstream in(request.path, std::ios::in | std::ios::binary);
+        if (!in) {
+            result.error = errno != 0 ? errno : ENOENT;
+            return result;
+        }
+        in.seekg(static_cast<std::streamoff>(request.offset), std::ios::beg);
+        in.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(ClampedLength(request, maxReadBytes_)));
+        // A read past the end sets eof and fail, which is not an error here
+        if (in.bad()) result.error = errno != 0 ? errno : EIO;
+        result.size = static_cast<uint32_t>(std::max<std::streamsize>(in.gcount(), 0));
+        return result;
+    }
+
+    unsigned queueDepth_;
+    uint32_t maxReadBytes_;
+    SlotBuffers buffers_;
+};
+
+#ifdef __linux__
+// ---------------------------------------------------------------------
+// io_uring: every slot runs openat, then read (into its registered buffer) until the requested
+// length or the end of the file. All ready submissions go to the kernel in one io_uring_enter,
+// which also waits for the next completion.
+// ---------------------------------------------------------------------
+class UringEngine final : public AsyncFileReader::Engine {
+public:
+    // Returns nullptr if io_uring is missing, disabled or lacks the operations used here
+    static std::unique_ptr<UringEngine> Create(unsigned queueDepth, uint32_t maxReadBytes)
+    {
+        std::unique_ptr<UringEngine> engine(new UringEngine(queueDepth, maxReadBytes));
+        return engine->Setup() ? std::move(engine) : nullptr;
+    }
+
+    ~UringEngine() override
+    {
+        if (sqes_) munmap(sqes_, sqesBytes_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingBytes_);
+        if (sqRing_) munmap(sqRing_, sqRingBytes_);
+        if (ring_ >= 0) close(ring_);
+    }
+
+    AsyncIoBackend Backend() const override { return AsyncIoBackend::IoUring; }
+
+    void ReadAll(const std::vector<AsyncReadRequest>& requests, const AsyncFileReader::Completion& onComplete) override
+    {
+        size_t next = 0;
+        size_t completed = 0;
+        std::vector<uint32_t> freeSlots;
+        for (uint32_t s = queueDepth_; s-- > 0;) freeSlots.push_back(s);
+
+        auto finish = [&](uint32_t s, int error) {
+            Slot& slot = slots_[s];
+            AsyncReadResult result;
+            result.tag = requests[slot.request].tag;
+            result.error = error;
+            result.data = buffers_.Slot(s);
+            result.size = error ? 0 : slot.done;
+            onComplete(result);
+            if (slot.fd >= 0) close(slot.fd);
+            slot.fd = -1;
+            freeSlots.push_back(s);
+            ++completed;
+        };
+
+        while (completed < requests.size()) {
+            while (next < requests.size() && !freeSlots.empty()) {
+                const uint32_t s = freeSlots.back();
+                freeSlots.pop_back();
+                slots_[s] = Slot();
+                slots_[s].request = next;
+                slots_[s].length = ClampedLength(requests[next], maxReadBytes_);
+                QueueOpen(s, requests[next].path.c_str());
+                ++next;
+            }
+            const int error = Enter();
+            if (error != 0) {
+                // The ring is unusable; fail what is left rather than hang
+                LOG_FMT(LogLevel::Error, LogCategory::General, L"AsyncFileReader: io_uring_enter failed ({})", error);
+                for (uint32_t s = 0; s < queueDepth_; ++s) {
+                    if (std::find(freeSlots.begin(), freeSlots.end(), s) == freeSlots.end()) finish(s, error);
+                }
+                for (; next < requests.size(); ++next) {
+                    AsyncReadResult result;
+                    result.tag = requests[next].tag;
+                    result.error = error;
+                    onComplete(result);
+                    ++completed;
+                }
+                return;
+            }
+            ReapCompletions([&](uint64_t userData, int res) {
+                const uint32_t s = static_cast<uint32_t>(userData >> 1);
+                Slot& slot = slots_[s];
+                if (res < 0) {
+                    finish(s, -res);
+                } else if ((userData & 1) == kOpenPhase) {
+                    slot.fd = res;
+                    if (slot.length == 0) finish(s, 0);
+                    else QueueRead(s, requests[slot.request].offset);
+                } else {
+                    slot.done += static_cast<uint32_t>(res);
+                    // Short reads before the end of the file continue where they stopped
+                    if (res > 0 && slot.done < slot.length) QueueRead(s, requests[slot.request].offset);
+                    else finish(s, 0);
+                }
+            });
+        }
+    }
+
+private:
+    static constexpr uint64_t kOpenPhase = 0;
+    static constexpr uint64_t kReadPhase = 1;
+
+    struct Slot {
+        size_t request = 0;
+        int fd = -1;
+        uint32_t length = 0;
+        uint32_t done = 0;
+    };
+
+    UringEngine(unsigned queueDepth, uint32_t maxReadBytes)
+        : queueDepth_(queueDepth), maxReadBytes_(maxReadBytes), buffers_(queueDepth, maxReadBytes), slots_(queueDepth)
+    {
+    }
+
+    bool Setup()
+    {
+        io_uring_params params{};
+        ring_ = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth_, &params));
+        if (ring_ < 0) {
+            LOG_FMT(LogLevel::Debug, LogCategory::General, L"AsyncFileReader: io_uring unavailable ({})", errno);
+            return false;
+        }
+        sqRingBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) sqRingBytes_ = cqRingBytes_ = std::max(sqRingBytes_, cqRingBytes_);
+        sqRing_ = Map(sqRingBytes_, IORING_OFF_SQ_RING);
+        if (!sqRing_) return false;
+        cqRing_ = singleMmap ? sqRing_ : Map(cqRingBytes_, IORING_OFF_CQ_RING);
+        if (!cqRing_) return false;
+        sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(Map(sqesBytes_, IORING_OFF_SQES));
+        if (!sqes_) return false;
+
+        uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        sqLocalTail_ = *sqTail_;
+
+        // openat and read need kernel 5.6; ask instead of failing on the first request
+        std::vector<uint8_t> probeBytes(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBytes.data());
+        if (syscall(__NR_io_uring_register, ring_, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        auto supported = [probe](unsigned op) { return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED); };
+        if (!supported(IORING_OP_OPENAT) || !supported(IORING_OP_READ)) return false;
+
+        // Fixed buffers save the kernel mapping the pages on every read. Pinning them counts
+        // against RLIMIT_MEMLOCK, so plain reads are the fallback when that is too low.
+        std::vector<iovec> iovecs(queueDepth_);
+        for (unsigned s = 0; s < queueDepth_; ++s) iovecs[s] = { buffers_.Slot(s), buffers_.SlotBytes() };
+        registered_ = supported(IORING_OP_READ_FIXED) &&
+                      syscall(__NR_io_uring_register, ring_, IORING_REGISTER_BUFFERS, iovecs.data(), queueDepth_) == 0;
+        if (!registered_) LOG_AT(LogLevel::Debug, LogCategory::General, L"AsyncFileReader: io_uring without registered buffers");
+        return true;
+    }
+
+    void* Map(size_t bytes, off_t offset) const
+    {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    io_uring_sqe* NextSqe()
+    {
+        // At most one operation per slot is in flight and the ring has at least one entry per
+        // slot, so there is always room
+        const unsigned index = sqLocalTail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        ++sqLocalTail_;
+        ++toSubmit_;
+        return sqe;
+    }
+
+    void QueueOpen(uint32_t s, const char* path)
+    {
+        io_uring_sqe* sqe = NextSqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(path);
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = (uint64_t(s) << 1) | kOpenPhase;
+    }
+
+    void QueueRead(uint32_t s, uint64_t offset)
+    {
+        Slot& slot = slots_[s];
+        io_uring_sqe* sqe = NextSqe();
+        sqe->opcode = registered_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(buffers_.Slot(s) + slot.done);
+        sqe->len = slot.length - slot.done;
+        sqe->off = offset + slot.done;
+        sqe->buf_index = static_cast<uint16_t>(registered_ ? s : 0);
+        sqe->user_data = (uint64_t(s) << 1) | kReadPhase;
+    }
+
+    // Submits everything queued and waits for at least one completion; returns an errno or 0
+    int Enter()
+    {
+        __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+        for (;;) {
+            const long n = syscall(__NR_io_uring_enter, ring_, toSubmit_, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n >= 0) {
+                toSubmit_ -= std::min<unsigned>(toSubmit_, static_cast<unsigned>(n));
+                return 0;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return errno;
+        }
+    }
+
+    template<typename Handler>
+    void ReapCompletions(Handler&& handle)
+    {
+        unsigned head = *cqHead_;
+        const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            const uint64_t userData = cqe.user_data;
+            const int res = cqe.res;
+            // Release the entry before handling it; the handler may queue new submissions
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+            handle(userData, res);
+        }
+    }
+
+    unsigned queueDepth_;
+    uint32_t maxReadBytes_;
+    SlotBuffers buffers_;
+    std::vector<Slot> slots_;
+    bool registered_ = false;
+
+    int ring_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingBytes_ = 0;
+    size_t cqRingBytes_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesBytes_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqLocalTail_ = 0;
+    unsigned toSubmit_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+#endif // __linux__
+
+#ifdef _WIN32
+// ---------------------------------------------------------------------
+// Overlapped I/O: files are opened synchronously (Win32 has no asynchronous open) and associated
+// with one completion port; reads of all slots are in flight together and completions are
+// collected in batches with GetQueuedCompletionStatusEx.
+// ---------------------------------------------------------------------
+class OverlappedEngine final : public AsyncFileReader::Engine {
+public:
+    static std::unique_ptr<OverlappedEngine> Create(unsigned queueDepth, uint32_t maxReadBytes)
+    {
+        std::unique_ptr<OverlappedEngine> engine(new OverlappedEngine(queueDepth, maxReadBytes));
+        engine->port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        return engine->port_ ? std::move(engine) : nullptr;
+    }
+
+    ~OverlappedEngine() override
+    {
+        if (port_) CloseHandle(port_);
+    }
+
+    AsyncIoBackend Backend() const override { return AsyncIoBackend::Overlapped; }
+
+    void ReadAll(const std::vector<AsyncReadRequest>& requests, const AsyncFileReader::Completion& onComplete) override
+    {
+        if (!port_) {
+            FailRemaining(requests, 0, ERROR_INVALID_HANDLE, onComplete);
+            return;
+        }
+        size_t next = 0;
+        size_t completed = 0;
+        unsigned inFlight = 0;
+        std::vector<uint32_t> freeSlots;
+        for (uint32_t s = queueDepth_; s-- > 0;) freeSlots.push_back(s);
+
+        auto finish = [&](uint32_t s, DWORD error, bool pending) {
+            Slot& slot = slots_[s];
+            AsyncReadResult result;
+            result.tag = requests[slot.request].tag;
+            result.error = static_cast<int>(error);
+            result.data = buffers_.Slot(s);
+            result.size = error ? 0 : slot.done;
+            onComplete(result);
+            if (slot.file != INVALID_HANDLE_VALUE) CloseHandle(slot.file);
+            slot.file = INVALID_HANDLE_VALUE;
+            freeSlots.push_back(s);
+            if (pending) --inFlight;
+            ++completed;
+        };
+        // ERROR_SUCCESS if a completion packet will arrive, else why the read ended right away
+        auto startRead = [&](uint32_t s) -> DWORD {
+            Slot& slot = slots_[s];
+            const uint64_t offset = requests[slot.request].offset + slot.done;
+            std::memset(&slot.overlapped, 0, sizeof(slot.overlapped));
+            slot.overlapped.Offset = static_cast<DWORD>(offset);
+            slot.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            if (ReadFile(slot.file, buffers_.Slot(s) + slot.done, slot.length - slot.done, nullptr, &slot.overlapped)) return ERROR_SUCCESS;
+            const DWORD error = GetLastError();
+            return error == ERROR_IO_PENDING ? ERROR_SUCCESS : error;
+        };
+
+        while (completed < requests.size()) {
+            while (next < requests.size() && !freeSlots.empty()) {
+                const uint32_t s = freeSlots.back();
+                freeSlots.pop_back();
+                Slot& slot = slots_[s];
+                slot.request = next;
+                slot.length = ClampedLength(requests[next], maxReadBytes_);
+                slot.done = 0;
+                ++next;
+                slot.file = CreateFileW(requests[slot.request].path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+                if (slot.file == INVALID_HANDLE_VALUE) { finish(s, GetLastError(), false); continue; }
+                if (!CreateIoCompletionPort(slot.file, port_, s, 0)) { finish(s, GetLastError(), false); continue; }
+                if (slot.length == 0) { finish(s, ERROR_SUCCESS, false); continue; }
+                const DWORD error = startRead(s);
+                if (error == ERROR_HANDLE_EOF) finish(s, ERROR_SUCCESS, false);
+                else if (error != ERROR_SUCCESS) finish(s, error, false);
+                else ++inFlight;
+            }
+            if (inFlight == 0) continue;
+
+            OVERLAPPED_ENTRY entries[64];
+            ULONG removed = 0;
+            if (!GetQueuedCompletionStatusEx(port_, entries, static_cast<ULONG>(std::size(entries)), &removed, INFINITE, FALSE)) {
+                // The port is unusable; end the reads in flight before their buffers are reused and
+                // fail what is left rather than hang
+                const DWORD error = GetLastError();
+                LOG_FMT(LogLevel::Error, LogCategory::General, L"AsyncFileReader: GetQueuedCompletionStatusEx failed ({})", error);
+                for (uint32_t s = 0; s < queueDepth_; ++s) {
+                    if (std::find(freeSlots.begin(), freeSlots.end(), s) != freeSlots.end()) continue;
+                    Slot& slot = slots_[s];
+                    DWORD bytes = 0;
+                    CancelIoEx(slot.file, &slot.overlapped);
+                    GetOverlappedResult(slot.file, &slot.overlapped, &bytes, TRUE);
+                    finish(s, error, true);
+                }
+                FailRemaining(requests, next, error, onComplete);
+                // Their completion packets went to this port; the next batch starts on a new one
+                CloseHandle(port_);
+                port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+                return;
+            }
+            for (ULONG i = 0; i < removed; ++i) {
+                const uint32_t s = static_cast<uint32_t>(entries[i].lpCompletionKey);
+                Slot& slot = slots_[s];
+                DWORD bytes = 0;
+                if (!GetOverlappedResult(slot.file, &slot.overlapped, &bytes, FALSE)) {
+                    const DWORD error = GetLastError();
+                    finish(s, error == ERROR_HANDLE_EOF ? ERROR_SUCCESS : error, true);
+                    continue;
+                }
+                slot.done += bytes;
+                if (bytes == 0 || slot.done >= slot.length) { finish(s, ERROR_SUCCESS, true); continue; }
+                // Short read before the end of the file: continue where it stopped
+                const DWORD error = startRead(s);
+                if (error == ERROR_HANDLE_EOF) finish(s, ERROR_SUCCESS, true);
+                else if (error != ERROR_SUCCESS) finish(s, error, true);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        OVERLAPPED overlapped{};
+        HANDLE file = INVALID_HANDLE_VALUE;
+        size_t request = 0;
+        uint32_t length = 0;
+        uint32_t done = 0;
+    };
+
+    OverlappedEngine(unsigned queueDepth, uint32_t maxReadBytes)
+        : queueDepth_(queueDepth), maxReadBytes_(maxReadBytes), buffers_(queueDepth, maxReadBytes), slots_(queueDepth)
+    {
+    }
+
+    static void FailRemaining(const std::vector<AsyncReadRequest>& requests, size_t next, DWORD error, const AsyncFileReader::Completion& onComplete)
+    {
+        for (; next < requests.size(); ++next) {
+            AsyncReadResult result;
+            result.tag = requests[next].tag;
+            result.error = static_cast<int>(error);
+            onComplete(result);
+        }
+    }
+
+    unsigned queueDepth_;
+    uint32_t maxReadBytes_;
+    SlotBuffers buffers_;
+    std::vector<Slot> slots_;
+    HANDLE port_ = nullptr;
+};
+#endif // _WIN32
+
+} // namespace
+
+const char* AsyncIoBackendName(AsyncIoBackend backend)
+{
+    switch (backend) {
+    case AsyncIoBackend::Auto: return "auto";
+    case AsyncIoBackend::IoUring: return "io_uring";
+    case AsyncIoBackend::Overlapped: return "overlapped";
+    case AsyncIoBackend::Threads: return "threads";
+    }
+    return "?";
+}
+
+AsyncFileReader::AsyncFileReader(unsigned queueDepth, uint32_t maxReadBytes, AsyncIoBackend backend)
+    : queueDepth_(std::max(1u, queueDepth)), maxReadBytes_(maxReadBytes)
+{
+#ifdef __linux__
+    if (backend == AsyncIoBackend::Auto || backend == AsyncIoBackend::IoUring) engine_ = UringEngine::Create(queueDepth_, maxReadBytes_);
+#endif
+#ifdef _WIN32
+    if (backend == AsyncIoBackend::Auto || backend == AsyncIoBackend::Overlapped) engine_ = OverlappedEngine::Create(queueDepth_, maxReadBytes_);
+#endif
+    if (!engine_) engine_ = std::make_unique<ThreadEngine>(queueDepth_, maxReadBytes_);
+    if (backend != AsyncIoBackend::Auto && engine_->Backend() != backend) {
+        LOG_FMT(LogLevel::Info, LogCategory::General, L"AsyncFileReader: {} not available, using {}", AsyncIoBackendName(backend),
+                AsyncIoBackendName(engine_->Backend()));
+    }
+}
+
+AsyncFileReader::~AsyncFileReader() = default;
+
+AsyncIoBackend AsyncFileReader::Backend() const
+{
+    return engine_->Backend();
+}
+
+void AsyncFileReader::ReadAll(const std::vector<AsyncReadRequest>& requests, const Completion& onComplete)
+{
+    engine_->ReadAll(requests, onComplete);
+}
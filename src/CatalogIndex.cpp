@@ -0,0 +1,181 @@
+// CatalogIndex.cpp - saved library scans
+#include "CatalogIndex.h"
+#include "ImageFileUtils.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+const char kIndexMagic[] = "hdrscan-index";
+const int kIndexVersion = 2;    // 2 added the content fingerprint
+
+// Splits a line into exactly `count` tab separated fields; the last one may contain tabs
+bool SplitFields(const std::string& line, std::string* fields, int count)
+{
+    size_t start = 0;
+    for (int n = 0; n < count - 1; ++n) {
+        const size_t tab = line.find('\t', start);
+        if (tab == std::string::npos) return false;
+        fields[n] = line.substr(start, tab - start);
+        start = tab + 1;
+    }
+    fields[count - 1] = line.substr(start);
+    return true;
+}
+
+ImageContainer ParseContainer(const std::string& name)
+{
+    for (int i = 0; i <= static_cast<int>(ImageContainer::Svg); ++i) {
+        if (name == ImageContainerName(static_cast<ImageContainer>(i))) return static_cast<ImageContainer>(i);
+    }
+    return ImageContainer::Unknown;
+}
+
+Renderability ParseRenderability(const std::string& name)
+{
+    for (Renderability r : { Renderability::Hdr, Renderability::Displays, Renderability::Unsupported, Renderability::Broken }) {
+        if (name == RenderabilityName(r)) return r;
+    }
+    return Renderability::Broken;
+}
+
+int64_t FolderTime(const std::filesystem::path& path, bool& ok)
+{
+    std::error_code ec;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    ok = !ec;
+    return ok ? static_cast<int64_t>(modified.time_since_epoch().count()) : 0;
+}
+
+} // namespace
+
+std::filesystem::path CatalogIndex::DefaultPath()
+{
+    return AppCacheFolder() / L"catalog-index.tsv";
+}
+
+void CatalogIndex::SetRoot(const std::wstring& root, bool includeSubfolders)
+{
+    root_ = root;
+    includeSubfolders_ = includeSubfolders;
+}
+
+bool CatalogIndex::Load(const std::filesystem::path& path)
+{
+    root_.clear();
+    folders_.clear();
+    entries_.clear();
+    byPath_.clear();
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    std::string line;
+    if (!std::getline(in, line)) return false;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    const bool version1 = line == std::string(kIndexMagic) + " 1";
+    if (!version1 && line != std::string(kIndexMagic) + ' ' + std::to_string(kIndexVersion)) return false;
+
+    // root     include subfolders, path
+    // folder   time, path
+    // image    size, time, container, width, height, gain map, HDR capacity, renderability,
+    //          content (not in version 1), path
+    const int imageFields = version1 ? 10 : 11;
+    // A damaged path is not UTF-8; the index is rebuilt then
+    auto fail = [this] {
+        root_.clear();
+        folders_.clear();
+        entries_.clear();
+        byPath_.clear();
+        return false;
+    };
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::string fields[11];
+        if (line.compare(0, 5, "root\t") == 0 && SplitFields(line, fields, 3)) {
+            includeSubfolders_ = fields[1] == "1";
+            if (!PathFromUtf8(fields[2], root_)) return fail();
+        } else if (line.compare(0, 7, "folder\t") == 0 && SplitFields(line, fields, 3)) {
+            FolderStamp folder;
+            if (!PathFromUtf8(fields[2], folder.path)) return fail();
+            folder.modified = std::strtoll(fields[1].c_str(), nullptr, 10);
+            folders_.push_back(std::move(folder));
+        } else if (line.compare(0, 6, "image\t") == 0 && SplitFields(line, fields, imageFields) && !fields[imageFields - 1].empty()) {
+            CatalogIndexEntry entry;
+            entry.fileSize = std::strtoull(fields[1].c_str(), nullptr, 10);
+            entry.modified = std::strtoll(fields[2].c_str(), nullptr, 10);
+            entry.container = ParseContainer(fields[3]);
+            entry.width = std::atoi(fields[4].c_str());
+            entry.height = std::atoi(fields[5].c_str());
+            entry.gainMap = fields[6] == "1";
+            entry.hdrCapacityMax = std::strtof(fields[7].c_str(), nullptr);
+            entry.renderability = ParseRenderability(fields[8]);
+            if (!version1) ContentHash::FromHex(fields[9], entry.content);
+            if (!PathFromUtf8(fields[imageFields - 1], entry.path)) return fail();
+            Add(std::move(entry));
+        }
+    }
+    return !root_.empty();
+}
+
+bool CatalogIndex::Save(const std::filesystem::path& path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out << kIndexMagic << ' ' << kIndexVersion << '\n';
+        out << "root\t" << (includeSubfolders_ ? 1 : 0) << '\t' << Utf8FromPath(root_) << '\n';
+        for (const FolderStamp& folder : folders_) {
+            out << "folder\t" << folder.modified << '\t' << Utf8FromPath(folder.path) << '\n';
+        }
+        for (const CatalogIndexEntry& e : entries_) {
+            out << "image\t" << e.fileSize << '\t' << e.modified << '\t' << ImageContainerName(e.container) << '\t' << e.width << '\t'
+                << e.height << '\t' << (e.gainMap ? 1 : 0) << '\t' << e.hdrCapacityMax << '\t' << RenderabilityName(e.renderability)
+                << '\t' << (e.content.Empty() ? "-" : e.content.ToHex()) << '\t' << Utf8FromPath(e.path) << '\n';
+        }
+        if (!out.flush()) return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+bool CatalogIndex::Matches(const std::wstring& root, bool includeSubfolders) const
+{
+    if (root_.empty() || includeSubfolders != includeSubfolders_) return false;
+    if (std::filesystem::path(root).lexically_normal() == std::filesystem::path(root_).lexically_normal()) return true;
+    std::error_code ec;
+    return std::filesystem::equivalent(root, root_, ec);
+}
+
+bool CatalogIndex::IsCurrent() const
+{
+    if (folders_.empty()) return false;
+    for (const FolderStamp& folder : folders_) {
+        bool ok = false;
+        if (FolderTime(folder.path, ok) != folder.modified || !ok) return false;
+    }
+    return true;
+}
+
+ImageCatalog CatalogIndex::ToCatalog(bool displayableOnly) const
+{
+    ImageCatalog catalog;
+    for (const CatalogIndexEntry& e : entries_) {
+        if (displayableOnly && e.renderability != Renderability::Hdr && e.renderability != Renderability::Displays) continue;
+        catalog.Add({ e.path, e.fileSize, e.modified });
+    }
+    return catalog;
+}
+
+const ContentHash* CatalogIndex::FindContent(const std::wstring& path, uint64_t fileSize, int64_t modified) const
+{
+    auto it = byPath_.find(path);
+    if (it == byPath_.end()) return nullptr;
+    const CatalogIndexEntry& e = entries_[it->second];
+    if (e.content.Empty() || e.fileSize != fileSize || e.modified != modified) return nullptr;
+    return &e.content;
+}
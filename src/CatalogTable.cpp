@@ -0,0 +1,439 @@
+// CatalogTable.cpp - playlist queries over column-oriented catalog metadata
+#include "CatalogTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+std::wstring Lower(std::wstring s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+    return s;
+}
+
+// Lower case, '/' separated, without leading or trailing separators
+std::wstring NormalizeFolder(std::wstring folder)
+{
+    folder = Lower(std::move(folder));
+    std::replace(folder.begin(), folder.end(), L'\\', L'/');
+    const size_t first = folder.find_first_not_of(L'/');
+    if (first == std::wstring::npos) return std::wstring();
+    const size_t last = folder.find_last_not_of(L'/');
+    return folder.substr(first, last - first + 1);
+}
+
+ImageContainer ContainerFromExtension(const std::wstring& path)
+{
+    const std::wstring ext = Lower(std::filesystem::path(path).extension().wstring());
+    if (ext == L".jpg" || ext == L".jpeg") return ImageContainer::Jpeg;
+    if (ext == L".png") return ImageContainer::Png;
+    if (ext == L".gif") return ImageContainer::Gif;
+    if (ext == L".bmp") return ImageContainer::Bmp;
+    if (ext == L".webp") return ImageContainer::WebP;
+    if (ext == L".avif") return ImageContainer::Avif;
+    if (ext == L".jxl") return ImageContainer::Jxl;
+    if (ext == L".tif" || ext == L".tiff") return ImageContainer::Tiff;
+    if (ext == L".svg") return ImageContainer::Svg;
+    return ImageContainer::Unknown;
+}
+
+// Splits on whitespace; double quotes group words and are dropped
+std::vector<std::wstring> Terms(const std::wstring& text)
+{
+    std::vector<std::wstring> terms;
+    std::wstring term;
+    bool quoted = false, any = false;
+    for (wchar_t c : text) {
+        if (c == L'"') { quoted = !quoted; any = true; continue; }
+        if (!quoted && std::iswspace(c)) {
+            if (any) terms.push_back(term);
+            term.clear();
+            any = false;
+            continue;
+        }
+        term += c;
+        any = true;
+    }
+    if (any) terms.push_back(term);
+    return terms;
+}
+
+bool ParseNumber(const std::wstring& s, double& value)
+{
+    if (s.empty()) return false;
+    wchar_t* end = nullptr;
+    value = std::wcstod(s.c_str(), &end);
+    return end == s.c_str() + s.size() && std::isfinite(value);
+}
+
+// Largest value of a numeric query field that converts to its column type (8 EB for sizes)
+double FieldLimit(const std::wstring& field)
+{
+    if (field == L"headroom") return std::numeric_limits<float>::max();
+    if (field == L"size") return std::ldexp(1.0, 63);
+    return std::numeric_limits<uint32_t>::max();
+}
+
+// "20MB", "512k", "1.5GB", "1000"
+bool ParseSize(const std::wstring& s, double& bytes)
+{
+    const std::wstring lower = Lower(s);
+    size_t digits = lower.find_first_not_of(L"0123456789.");
+    if (digits == std::wstring::npos) digits = lower.size();
+    std::wstring unit = lower.substr(digits);
+    if (!unit.empty() && unit.back() == L'b') unit.pop_back();
+    double scale = 1;
+    if (unit == L"k") scale = 1024.0;
+    else if (unit == L"m") scale = 1024.0 * 1024;
+    else if (unit == L"g") scale = 1024.0 * 1024 * 1024;
+    else if (!unit.empty()) return false;
+    if (!ParseNumber(lower.substr(0, digits), bytes)) return false;
+    bytes *= scale;
+    return true;
+}
+
+// YYYY, YYYY-MM or YYYY-MM-DD as the first and last day of that period
+bool ParseDate(const std::wstring& s, int32_t& firstDay, int32_t& lastDay)
+{
+    using namespace std::chrono;
+    if (s.find_first_not_of(L"0123456789-") != std::wstring::npos) return false;
+    int y = 0, m = 0, d = 0;
+    wchar_t extra = 0;
+    const int n = std::swscanf(s.c_str(), L"%d-%d-%d%lc", &y, &m, &d, &extra);
+    if (n < 1 || n > 3 || y < 1601 || y > 9999) return false;
+    year_month_day from{ year{ y }, month{ n >= 2 ? static_cast<unsigned>(m) : 1u }, day{ n >= 3 ? static_cast<unsigned>(d) : 1u } };
+    if (!from.ok()) return false;
+    year_month_day to = from;
+    if (n == 1) to = year{ y } / December / 31;
+    else if (n == 2) to = year_month_day{ year{ y } / month{ static_cast<unsigned>(m) } / last };
+    firstDay = static_cast<int32_t>(sys_days(from).time_since_epoch().count());
+    lastDay = static_cast<int32_t>(sys_days(to).time_since_epoch().count());
+    return true;
+}
+
+// Narrows [lo, hi] by `op` applied to a value that covers [valueLo, valueHi]
+template<typename T>
+void Constrain(const std::wstring& op, T valueLo, T valueHi, T& lo, T& hi)
+{
+    T newLo = std::numeric_limits<T>::lowest(), newHi = std::numeric_limits<T>::max();
+    if (op == L":" || op == L"=") { newLo = valueLo; newHi = valueHi; }
+    else if (op == L">=") newLo = valueLo;
+    else if (op == L"<=") newHi = valueHi;
+    else if (op == L">") {
+        if constexpr (std::is_floating_point_v<T>) newLo = std::nextafter(valueHi, newHi);
+        else newLo = valueHi == newHi ? valueHi : valueHi + 1;
+    } else if (op == L"<") {
+        if constexpr (std::is_floating_point_v<T>) newHi = std::nextafter(valueLo, newLo);
+        else newHi = valueLo == newLo ? valueLo : valueLo - 1;
+    }
+    lo = std::max(lo, newLo);
+    hi = std::min(hi, newHi);
+}
+
+// Splits "a..b" for range values given with ':' or '='
+bool SplitRange(const std::wstring& op, const std::wstring& value, std::wstring& from, std::wstring& to)
+{
+    const size_t dots = value.find(L"..");
+    if (dots == std::wstring::npos) { from = to = value; return true; }
+    if (op != L":" && op != L"=") return false;
+    from = value.substr(0, dots);
+    to = value.substr(dots + 2);
+    return true;
+}
+
+// Narrows keep[] to rows whose value lies in [lo, hi]. Branch free, so compilers vectorize it.
+template<typename T>
+void NarrowRange(const T* column, size_t n, T lo, T hi, uint8_t* keep)
+{
+    for (size_t i = 0; i < n; ++i) keep[i] &= static_cast<uint8_t>((column[i] >= lo) & (column[i] <= hi));
+}
+
+// Stable LSD radix sort of rows by 64-bit keys; byte positions where all keys agree are skipped
+void RadixSort(std::vector<uint32_t>& rows, std::vector<uint64_t>& keys)
+{
+    const size_t n = rows.size();
+    if (n < 2) return;
+    uint64_t differing = 0;
+    for (uint64_t key : keys) differing |= key ^ keys[0];
+    std::vector<uint64_t> keyTemp(n);
+    std::vector<uint32_t> rowTemp(n);
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((differing >> shift) & 0xFF) == 0) continue;
+        uint32_t count[256] = {};
+        for (uint64_t key : keys) ++count[(key >> shift) & 0xFF];
+        uint32_t offset = 0;
+        for (uint32_t& c : count) {
+            const uint32_t bucket = c;
+            c = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t slot = count[(keys[i] >> shift) & 0xFF]++;
+            keyTemp[slot] = keys[i];
+            rowTemp[slot] = rows[i];
+        }
+        keys.swap(keyTemp);
+        rows.swap(rowTemp);
+    }
+}
+
+// Maps a float to an unsigned integer with the same ordering
+uint32_t OrderedBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+} // namespace
+
+bool CatalogQuery::Parse(const std::wstring& text, CatalogQuery& query, std::wstring* error)
+{
+    query = CatalogQuery();
+    auto fail = [error](const std::wstring& term, const wchar_t* why) {
+        if (error) *error = L"'" + term + L"': " + why;
+        return false;
+    };
+    for (const std::wstring& term : Terms(text)) {
+        const std::wstring lower = Lower(term);
+        if (lower == L"hdr" || lower == L"sdr") {
+            query.flagsMask |= kCatalogHdr;
+            query.flagsValue = lower == L"hdr" ? (query.flagsValue | kCatalogHdr) : static_cast<uint8_t>(query.flagsValue & ~kCatalogHdr);
+            continue;
+        }
+        const size_t opStart = lower.find_first_of(L":<>=");
+        if (opStart == std::wstring::npos || opStart == 0) return fail(term, L"expected field:value, field>=value, hdr or sdr");
+        const std::wstring field = lower.substr(0, opStart);
+        size_t opEnd = opStart + 1;
+        if ((lower[opStart] == L'<' || lower[opStart] == L'>') && opEnd < lower.size() && lower[opEnd] == L'=') ++opEnd;
+        const std::wstring op = lower.substr(opStart, opEnd - opStart);
+        const std::wstring value = term.substr(opEnd);
+        const bool equality = op == L":" || op == L"=";
+        if (value.empty()) return fail(term, L"missing value");
+
+        std::wstring from, to;
+        if (field == L"headroom" || field == L"width" || field == L"height" || field == L"size") {
+            if (!SplitRange(op, value, from, to)) return fail(term, L"ranges need ':'");
+            double a = 0, b = 0;
+            const bool ok = field == L"size" ? ParseSize(from, a) && ParseSize(to, b) : ParseNumber(from, a) && ParseNumber(to, b);
+            if (!ok || a < 0 || b < a || b > FieldLimit(field)) return fail(term, L"bad number");
+            if (field == L"headroom") Constrain(op, static_cast<float>(a), static_cast<float>(b), query.headroomMin, query.headroomMax);
+            else if (field == L"size") Constrain(op, static_cast<uint64_t>(a), static_cast<uint64_t>(b), query.sizeMin, query.sizeMax);
+            else Constrain(op, static_cast<uint32_t>(a), static_cast<uint32_t>(b), field == L"width" ? query.widthMin : query.heightMin,
+                           field == L"width" ? query.widthMax : query.heightMax);
+        } else if (field == L"date") {
+            if (!SplitRange(op, value, from, to)) return fail(term, L"ranges need ':'");
+            int32_t fromFirst = 0, fromLast = 0, toFirst = 0, toLast = 0;
+            if (!ParseDate(from, fromFirst, fromLast) || !ParseDate(to, toFirst, toLast) || toLast < fromFirst) {
+                return fail(term, L"expected YYYY, YYYY-MM or YYYY-MM-DD");
+            }
+            Constrain(op, fromFirst, toLast, query.dateMin, query.dateMax);
+        } else if (field == L"format") {
+            if (!equality) return fail(term, L"use format:name");
+            std::wstring names = Lower(value) + L",";
+            for (size_t start = 0, comma; (comma = names.find(L',', start)) != std::wstring::npos; start = comma + 1) {
+                std::wstring name = names.substr(start, comma - start);
+                if (name == L"jpg") name = L"jpeg";
+                bool known = false;
+                for (int c = 1; c <= static_cast<int>(ImageContainer::Svg); ++c) {
+                    const char* n = ImageContainerName(static_cast<ImageContainer>(c));
+                    if (name == std::wstring(n, n + std::strlen(n))) { query.formats |= 1u << c; known = true; }
+                }
+                if (!known) return fail(term, L"unknown format");
+            }
+        } else if (field == L"folder") {
+            if (!equality) return fail(term, L"use folder:path");
+            query.folders.push_back(NormalizeFolder(value));
+        } else if (field == L"sort") {
+            if (!equality) return fail(term, L"use sort:key");
+            std::wstring key = Lower(value);
+            query.descending = key[0] == L'-';
+            if (query.descending) key.erase(0, 1);
+            if (key == L"date") query.sort = CatalogSortKey::Date;
+            else if (key == L"size") query.sort = CatalogSortKey::Size;
+            else if (key == L"pixels") query.sort = CatalogSortKey::Pixels;
+            else if (key == L"headroom") query.sort = CatalogSortKey::Headroom;
+            else if (key == L"name") query.sort = CatalogSortKey::Name;
+            else return fail(term, L"sort by date, size, pixels, headroom or name");
+        } else {
+            return fail(term, L"unknown field");
+        }
+    }
+    return true;
+}
+
+int32_t CatalogTable::DaysFromFileTime(int64_t modified)
+{
+    if (modified == 0) return INT32_MIN;
+    using namespace std::chrono;
+    const std::filesystem::file_time_type time{ std::filesystem::file_time_type::duration(modified) };
+    return static_cast<int32_t>(floor<days>(file_clock::to_sys(time)).time_since_epoch().count());
+}
+
+CatalogTable::CatalogTable(std::wstring root) : root_(std::move(root))
+{
+}
+
+CatalogTable CatalogTable::FromIndex(const CatalogIndex& index)
+{
+    CatalogTable table(index.Root());
+    table.Reserve(index.Entries().size());
+    for (const CatalogIndexEntry& entry : index.Entries()) table.Add(entry);
+    return table;
+}
+
+CatalogTable CatalogTable::FromCatalog(const ImageCatalog& catalog, const std::wstring& root)
+{
+    CatalogTable table(root);
+    table.Reserve(catalog.Size());
+    for (const CatalogEntry& source : catalog.Entries()) {
+        CatalogIndexEntry entry;
+        entry.path = source.path;
+        entry.fileSize = source.fileSize;
+        entry.modified = source.modified;
+        entry.container = ContainerFromExtension(source.path);
+        entry.renderability = Renderability::Displays;
+        table.Add(entry, false);
+    }
+    return table;
+}
+
+void CatalogTable::Reserve(size_t rows)
+{
+    paths_.reserve(rows);
+    size_.reserve(rows);
+    modified_.reserve(rows);
+    folder_.reserve(rows);
+    date_.reserve(rows);
+    width_.reserve(rows);
+    height_.reserve(rows);
+    headroom_.reserve(rows);
+    format_.reserve(rows);
+    flags_.reserve(rows);
+}
+
+uint32_t CatalogTable::FolderId(const std::wstring& path)
+{
+    const size_t slash = path.find_last_of(L"\\/");
+    const std::wstring parent = slash == std::wstring::npos ? std::wstring() : path.substr(0, slash);
+    if (lastFolder_ != UINT32_MAX && parent == lastParent_) return lastFolder_;
+
+    std::wstring relative;
+    if (parent.size() >= root_.size() && parent.compare(0, root_.size(), root_) == 0) {
+        relative = parent.substr(root_.size());
+    } else {
+        relative = std::filesystem::path(parent).lexically_relative(root_).wstring();
+        if (relative == L".") relative.clear();
+    }
+    relative = NormalizeFolder(relative);
+    auto [it, added] = folderIds_.emplace(relative, static_cast<uint32_t>(folderNames_.size()));
+    if (added) folderNames_.push_back(relative);
+    lastParent_ = parent;
+    lastFolder_ = it->second;
+    return lastFolder_;
+}
+
+void CatalogTable::Add(const CatalogIndexEntry& entry, bool probed)
+{
+    folder_.push_back(FolderId(entry.path));
+    paths_.push_back(entry.path);
+    size_.push_back(entry.fileSize);
+    modified_.push_back(entry.modified);
+    date_.push_back(DaysFromFileTime(entry.modified));
+    width_.push_back(static_cast<uint32_t>(std::max(entry.width, 0)));
+    height_.push_back(static_cast<uint32_t>(std::max(entry.height, 0)));
+    headroom_.push_back(entry.hdrCapacityMax);
+    format_.push_back(static_cast<uint8_t>(entry.container));
+    uint8_t flags = probed ? kCatalogProbed : 0;
+    if (entry.gainMap || entry.renderability == Renderability::Hdr) flags |= kCatalogHdr;
+    if (entry.renderability == Renderability::Hdr || entry.renderability == Renderability::Displays) flags |= kCatalogDisplays;
+    flags_.push_back(flags);
+}
+
+std::vector<uint32_t> CatalogTable::Select(const CatalogQuery& query) const
+{
+    const size_t n = Size();
+    std::vector<uint8_t> keep(n, 1);
+    uint8_t* k = keep.data();
+
+    // One pass per constrained column; unconstrained columns are not touched
+    const CatalogQuery all;
+    if (query.headroomMin != all.headroomMin || query.headroomMax != all.headroomMax) {
+        NarrowRange(headroom_.data(), n, query.headroomMin, query.headroomMax, k);
+    }
+    if (query.dateMin != all.dateMin || query.dateMax != all.dateMax) NarrowRange(date_.data(), n, query.dateMin, query.dateMax, k);
+    if (query.sizeMin != all.sizeMin || query.sizeMax != all.sizeMax) NarrowRange(size_.data(), n, query.sizeMin, query.sizeMax, k);
+    if (query.widthMin != all.widthMin || query.widthMax != all.widthMax) NarrowRange(width_.data(), n, query.widthMin, query.widthMax, k);
+    if (query.heightMin != all.heightMin || query.heightMax != all.heightMax) NarrowRange(height_.data(), n, query.heightMin, query.heightMax, k);
+    if (query.flagsMask) {
+        const uint8_t* flags = flags_.data();
+        for (size_t i = 0; i < n; ++i) k[i] &= static_cast<uint8_t>((flags[i] & query.flagsMask) == query.flagsValue);
+    }
+    if (query.formats) {
+        const uint8_t* format = format_.data();
+        for (size_t i = 0; i < n; ++i) k[i] &= static_cast<uint8_t>((query.formats >> format[i]) & 1u);
+    }
+    if (!query.folders.empty()) {
+        // Resolve the folder terms once per folder, then it is a table lookup per row
+        std::vector<uint8_t> match(folderNames_.size(), 0);
+        for (size_t f = 0; f < folderNames_.size(); ++f) {
+            const std::wstring& name = folderNames_[f];
+            for (const std::wstring& prefix : query.folders) {
+                if (prefix.empty() || name == prefix || (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 && name[prefix.size()] == L'/')) {
+                    match[f] = 1;
+                    break;
+                }
+            }
+        }
+        const uint32_t* folder = folder_.data();
+        for (size_t i = 0; i < n; ++i) k[i] &= match[folder[i]];
+    }
+
+    // Branch free compaction: always write, advance only for kept rows
+    std::vector<uint32_t> rows(n);
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        rows[count] = static_cast<uint32_t>(i);
+        count += k[i];
+    }
+    rows.resize(count);
+
+    if (query.sort == CatalogSortKey::Name) {
+        auto less = [this](uint32_t a, uint32_t b) {
+            return std::lexicographical_compare(paths_[a].begin(), paths_[a].end(), paths_[b].begin(), paths_[b].end(),
+                                                [](wchar_t x, wchar_t y) { return std::towlower(x) < std::towlower(y); });
+        };
+        if (query.descending) std::stable_sort(rows.begin(), rows.end(), [&less](uint32_t a, uint32_t b) { return less(b, a); });
+        else std::stable_sort(rows.begin(), rows.end(), less);
+    } else if (query.sort != CatalogSortKey::None) {
+        std::vector<uint64_t> keys(rows.size());
+        const uint64_t invert = query.descending ? ~uint64_t(0) : 0;
+        auto fill = [&](auto key) {
+            for (size_t i = 0; i < rows.size(); ++i) keys[i] = key(rows[i]) ^ invert;
+        };
+        switch (query.sort) {
+        case CatalogSortKey::Date: fill([this](uint32_t r) { return uint64_t(static_cast<uint32_t>(date_[r]) ^ 0x80000000u); }); break;
+        case CatalogSortKey::Size: fill([this](uint32_t r) { return size_[r]; }); break;
+        case CatalogSortKey::Pixels: fill([this](uint32_t r) { return static_cast<uint64_t>(width_[r]) * height_[r]; }); break;
+        case CatalogSortKey::Headroom: fill([this](uint32_t r) { return uint64_t(OrderedBits(headroom_[r])); }); break;
+        default: break;
+        }
+        RadixSort(rows, keys);
+    }
+    return rows;
+}
+
+ImageCatalog CatalogTable::ToCatalog(const std::vector<uint32_t>& rows) const
+{
+    ImageCatalog catalog;
+    for (uint32_t r : rows) catalog.Add({ paths_[r], size_[r], modified_[r] });
+    return catalog;
+}
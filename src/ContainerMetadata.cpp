@@ -0,0 +1,662 @@
+// ContainerMetadata.cpp - ISOBMFF box, JPEG XL codestream header and PNG chunk parsing
+#include "ContainerMetadata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Big-endian reads over an absolute file range [pos, end); a read past the end clears ok
+// instead of failing at once, so a box parses straight through and is checked once
+struct ByteReader {
+    const uint8_t* data;
+    uint64_t pos;
+    uint64_t end;
+    bool ok = true;
+
+    ByteReader(const uint8_t* d, uint64_t begin, uint64_t limit) : data(d), pos(begin), end(limit) {}
+
+    bool Has(uint64_t n) const { return ok && pos + n <= end; }
+    uint64_t Uint(int bytes) {
+        if (!Has(static_cast<uint64_t>(bytes))) { ok = false; pos = end; return 0; }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = (v << 8) | data[pos + i];
+        pos += static_cast<uint64_t>(bytes);
+        return v;
+    }
+    uint8_t U8() { return static_cast<uint8_t>(Uint(1)); }
+    uint16_t U16() { return static_cast<uint16_t>(Uint(2)); }
+    uint32_t U32() { return static_cast<uint32_t>(Uint(4)); }
+    void Skip(uint64_t n) {
+        if (!Has(n)) { ok = false; pos = end; return; }
+        pos += n;
+    }
+};
+
+struct Box {
+    uint32_t type = 0;
+    uint64_t offset = 0;          // box start
+    uint64_t payload = 0;         // after the header
+    uint64_t end = 0;             // may lie past the parsed data
+};
+
+// Box header at `pos` inside a parent ending at `parentEnd`. With a clamped `limit` (the parsed
+// data) the header itself must fit; its payload need not.
+bool NextBox(const uint8_t* data, uint64_t pos, uint64_t parentEnd, uint64_t limit, Box& box)
+{
+    ByteReader r(data, pos, std::min(parentEnd, limit));
+    uint64_t size = r.U32();
+    box.type = r.U32();
+    if (size == 1) size = r.Uint(8);
+    else if (size == 0) size = parentEnd - pos;       // extends to the end of the parent
+    if (!r.ok || size < r.pos - pos || size > parentEnd - pos) return false;
+    box.offset = pos;
+    box.payload = r.pos;
+    box.end = pos + size;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// ISOBMFF (AVIF, HEIF)
+
+struct HeifItem {
+    uint32_t id = 0;
+    uint32_t type = 0;
+    std::vector<uint16_t> properties;     // 1-based ipco indexes
+};
+
+HeifItem* FindItem(std::vector<HeifItem>& items, uint32_t id)
+{
+    for (HeifItem& item : items) {
+        if (item.id == id) return &item;
+    }
+    return nullptr;
+}
+
+bool ParseIinf(const uint8_t* data, const Box& iinf, std::vector<HeifItem>& items)
+{
+    ByteReader r(data, iinf.payload, iinf.end);
+    const uint8_t version = r.U8();
+    r.Skip(3);
+    const uint32_t count = version == 0 ? r.U16() : r.U32();
+    uint64_t pos = r.pos;
+    for (uint32_t i = 0; i < count && r.ok; ++i) {
+        Box infe;
+        if (!NextBox(data, pos, iinf.end, iinf.end, infe)) return false;
+        pos = infe.end;
+        if (infe.type != BoxType("infe")) continue;
+        ByteReader e(data, infe.payload, infe.end);
+        const uint8_t infeVersion = e.U8();
+        e.Skip(3);
+        if (infeVersion < 2) continue;                 // no item type before version 2
+        HeifItem item;
+        item.id = infeVersion == 2 ? e.U16() : e.U32();
+        e.Skip(2);                                     // protection index
+        item.type = e.U32();
+        if (e.ok) items.push_back(item);
+    }
+    return r.ok;
+}
+
+bool ParseIpma(const uint8_t* data, const Box& ipma, std::vector<HeifItem>& items)
+{
+    ByteReader r(data, ipma.payload, ipma.end);
+    const uint8_t version = r.U8();
+    const uint32_t flags = static_cast<uint32_t>(r.Uint(3));
+    const uint32_t count = r.U32();
+    for (uint32_t i = 0; i < count && r.ok; ++i) {
+        const uint32_t id = version < 1 ? r.U16() : r.U32();
+        const uint8_t associations = r.U8();
+        HeifItem* item = FindItem(items, id);
+        for (uint8_t a = 0; a < associations && r.ok; ++a) {
+            const uint16_t index = (flags & 1) ? static_cast<uint16_t>(r.U16() & 0x7FFF) : static_cast<uint16_t>(r.U8() & 0x7F);
+            if (item && index > 0) item->properties.push_back(index);
+        }
+    }
+    return r.ok;
+}
+
+// Location of an item's data from iloc; only single-extent items are needed here
+bool FindItemLocation(const uint8_t* data, const Box& iloc, const Box* idat, uint32_t id, FileSpan& span)
+{
+    ByteReader r(data, iloc.payload, iloc.end);
+    const uint8_t version = r.U8();
+    r.Skip(3);
+    const uint8_t sizes = r.U8();
+    const int offsetSize = sizes >> 4, lengthSize = sizes & 15;
+    const uint8_t sizes2 = r.U8();
+    const int baseOffsetSize = sizes2 >> 4, indexSize = version >= 1 ? sizes2 & 15 : 0;
+    const uint32_t count = version < 2 ? r.U16() : r.U32();
+    for (uint32_t i = 0; i < count && r.ok; ++i) {
+        const uint32_t itemId = version < 2 ? r.U16() : r.U32();
+        const int construction = version >= 1 ? r.U16() & 15 : 0;
+        r.Skip(2);                                     // data reference index
+        const uint64_t base = r.Uint(baseOffsetSize);
+        const uint16_t extents = r.U16();
+        uint64_t offset = 0, length = 0;
+        for (uint16_t e = 0; e < extents && r.ok; ++e) {
+            r.Skip(static_cast<uint64_t>(indexSize));
+            const uint64_t extentOffset = r.Uint(offsetSize);
+            const uint64_t extentLength = r.Uint(lengthSize);
+            if (e == 0) { offset = extentOffset; length = extentLength; }
+        }
+        if (!r.ok || itemId != id) continue;
+        if (extents != 1 || length == 0) return false;
+        if (construction == 0) span.offset = base + offset;
+        else if (construction == 1 && idat) span.offset = idat->payload + base + offset;
+        else return false;
+        span.size = length;
+        return true;
+    }
+    return false;
+}
+
+uint32_t ReferenceTarget(const uint8_t* data, const Box& iref, uint32_t referenceType, uint32_t fromId)
+{
+    ByteReader r(data, iref.payload, iref.end);
+    const uint8_t version = r.U8();
+    r.Skip(3);
+    uint64_t pos = r.pos;
+    Box reference;
+    while (pos < iref.end && NextBox(data, pos, iref.end, iref.end, reference)) {
+        pos = reference.end;
+        if (reference.type != referenceType) continue;
+        ByteReader e(data, reference.payload, reference.end);
+        const uint32_t from = version == 0 ? e.U16() : e.U32();
+        const uint16_t count = e.U16();
+        if (from != fromId || count == 0) continue;
+        const uint32_t to = version == 0 ? e.U16() : e.U32();
+        if (e.ok) return to;
+    }
+    return 0;
+}
+
+void ApplyProperty(const uint8_t* data, const Box& property, ContainerInfo& info, int& rotation)
+{
+    ByteReader r(data, property.payload, property.end);
+    switch (property.type) {
+    case BoxType("ispe"): {
+        r.Skip(4);
+        const uint32_t width = r.U32(), height = r.U32();
+        const bool valid = r.ok && width <= kMaxImageDimension && height <= kMaxImageDimension;
+        info.width = valid ? static_cast<int>(width) : 0;
+        info.height = valid ? static_cast<int>(height) : 0;
+        break;
+    }
+    case BoxType("colr"): {
+        const uint32_t colourType = r.U32();
+        if (colourType == BoxType("nclx") && r.Has(7)) {
+            info.color.present = true;
+            info.color.primaries = static_cast<uint8_t>(r.U16());
+            info.color.transfer = static_cast<uint8_t>(r.U16());
+            info.color.matrix = static_cast<uint8_t>(r.U16());
+            info.color.fullRange = (r.U8() & 0x80) != 0;
+        } else if (colourType == BoxType("prof") || colourType == BoxType("rICC")) {
+            info.hasIcc = true;
+            info.icc = { r.pos, property.end - r.pos };
+        }
+        break;
+    }
+    case BoxType("pixi"): {
+        r.Skip(4);
+        const uint8_t channels = r.U8();
+        const uint8_t bits = r.U8();
+        if (r.ok) { info.components = channels; info.bitDepth = bits; }
+        break;
+    }
+    case BoxType("av1C"): {
+        // marker/version, profile/level, then high_bitdepth, twelve_bit, monochrome
+        r.Skip(2);
+        const uint8_t flags = r.U8();
+        if (!r.ok) break;
+        if (info.bitDepth == 0) info.bitDepth = (flags & 0x40) ? ((flags & 0x20) ? 12 : 10) : 8;
+        if (info.components == 0) info.components = (flags & 0x10) ? 1 : 3;
+        break;
+    }
+    case BoxType("irot"):
+        rotation = r.U8() & 3;
+        break;
+    case BoxType("clli"):
+        info.color.maxCll = r.U16();
+        break;
+    default:
+        break;
+    }
+}
+
+// True if the item is an alpha plane (auxC with the MPEG alpha URN)
+bool IsAlphaItem(const uint8_t* data, const HeifItem& item, const std::vector<Box>& properties)
+{
+    static const char kAlphaUrn[] = "urn:mpeg:mpegB:cicp:systems:auxiliary:alpha";
+    for (uint16_t index : item.properties) {
+        if (index > properties.size() || properties[index - 1].type != BoxType("auxC")) continue;
+        const Box& auxC = properties[index - 1];
+        const uint64_t begin = auxC.payload + 4;
+        if (auxC.end >= begin + sizeof(kAlphaUrn) - 1 && std::memcmp(data + begin, kAlphaUrn, sizeof(kAlphaUrn) - 1) == 0) return true;
+    }
+    return false;
+}
+
+bool ParseMeta(const uint8_t* data, const Box& meta, ContainerInfo& info)
+{
+    Box hdlr, pitm, iinf, iloc, ipco, ipma, iref, idat;
+    bool has[8] = {};
+    Box* slots[8] = { &hdlr, &pitm, &iinf, &iloc, &ipco, &ipma, &iref, &idat };
+    const uint32_t types[8] = { BoxType("hdlr"), BoxType("pitm"), BoxType("iinf"), BoxType("iloc"),
+                                BoxType("ipco"), BoxType("ipma"), BoxType("iref"), BoxType("idat") };
+    uint64_t pos = meta.payload + 4;                   // full box
+    Box child;
+    while (pos < meta.end && NextBox(data, pos, meta.end, meta.end, child)) {
+        pos = child.end;
+        if (child.type == BoxType("iprp")) {
+            // ipco and ipma live in iprp
+            uint64_t p = child.payload;
+            Box grandchild;
+            while (p < child.end && NextBox(data, p, child.end, child.end, grandchild)) {
+                p = grandchild.end;
+                for (int i = 4; i < 6; ++i) {
+                    if (grandchild.type == types[i] && !has[i]) { *slots[i] = grandchild; has[i] = true; }
+                }
+            }
+            continue;
+        }
+        for (int i = 0; i < 8; ++i) {
+            if (child.type == types[i] && !has[i]) { *slots[i] = child; has[i] = true; }
+        }
+    }
+    if (!has[0] || !has[1] || !has[2] || !has[4] || !has[5]) return false;
+    ByteReader handler(data, hdlr.payload, hdlr.end);
+    handler.Skip(8);
+    if (handler.U32() != BoxType("pict")) return false;
+
+    ByteReader primaryReader(data, pitm.payload, pitm.end);
+    const uint8_t pitmVersion = primaryReader.U8();
+    primaryReader.Skip(3);
+    const uint32_t primaryId = pitmVersion == 0 ? primaryReader.U16() : primaryReader.U32();
+    if (!primaryReader.ok) return false;
+
+    std::vector<HeifItem> items;
+    if (!ParseIinf(data, iinf, items) || !ParseIpma(data, ipma, items)) return false;
+    std::vector<Box> properties;
+    for (uint64_t p = ipco.payload; p < ipco.end;) {
+        Box property;
+        if (!NextBox(data, p, ipco.end, ipco.end, property)) return false;
+        properties.push_back(property);
+        p = property.end;
+    }
+
+    const HeifItem* primary = FindItem(items, primaryId);
+    if (!primary) return false;
+    int rotation = 0;
+    for (uint16_t index : primary->properties) {
+        if (index <= properties.size()) ApplyProperty(data, properties[index - 1], info, rotation);
+    }
+    if (info.width <= 0 || info.height <= 0) return false;
+    if (rotation & 1) std::swap(info.width, info.height);
+    if (info.components == 0) info.components = 3;
+
+    for (const HeifItem& item : items) {
+        if (item.type == BoxType("tmap")) {
+            info.gainMap = true;
+            if (has[3]) FindItemLocation(data, iloc, has[7] ? &idat : nullptr, item.id, info.gainMapMetadata);
+        } else if (has[6] && IsAlphaItem(data, item, properties) && ReferenceTarget(data, iref, BoxType("auxl"), item.id) == primaryId) {
+            ++info.components;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// JPEG XL codestream header (ISO/IEC 18181-1 SizeHeader and ImageMetadata)
+
+// Least significant bit first, as the codestream is written
+struct BitReader {
+    const uint8_t* data;
+    size_t size;
+    size_t bit = 0;
+    bool ok = true;
+
+    uint32_t Bits(int n) {
+        uint32_t v = 0;
+        for (int i = 0; i < n; ++i) {
+            if ((bit >> 3) >= size) { ok = false; return 0; }
+            v |= static_cast<uint32_t>((data[bit >> 3] >> (bit & 7)) & 1) << i;
+            ++bit;
+        }
+        return v;
+    }
+    bool Bool() { return Bits(1) != 0; }
+
+    // U32(d0, d1, d2, d3): a 2-bit selector picks a distribution, each being a constant
+    // (bits == 0) or `bits` bits plus an offset
+    struct Dist { int bits; uint32_t offset; };
+    uint32_t U32(Dist d0, Dist d1, Dist d2, Dist d3) {
+        const Dist d[4] = { d0, d1, d2, d3 };
+        const Dist& chosen = d[Bits(2)];
+        return Bits(chosen.bits) + chosen.offset;
+    }
+    uint32_t Enum() { return U32({ 0, 0 }, { 0, 1 }, { 4, 2 }, { 6, 18 }); }
+    float F16() {
+        const uint32_t v = Bits(16);
+        const int exponent = static_cast<int>((v >> 10) & 31);
+        const int mantissa = static_cast<int>(v & 1023);
+        const float magnitude = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24)
+                                              : std::ldexp(static_cast<float>(1024 + mantissa), exponent - 25);
+        return (v & 0x8000) ? -magnitude : magnitude;
+    }
+};
+
+uint64_t RatioWidth(uint32_t ratio, uint64_t height)
+{
+    static const uint32_t kNum[8] = { 0, 1, 12, 4, 3, 16, 5, 2 };
+    static const uint32_t kDen[8] = { 1, 1, 10, 3, 2, 9, 4, 1 };
+    return height * kNum[ratio] / kDen[ratio];
+}
+
+void ReadSizeHeader(BitReader& b, uint64_t& width, uint64_t& height)
+{
+    const BitReader::Dist d0{ 9, 1 }, d1{ 13, 1 }, d2{ 18, 1 }, d3{ 30, 1 };
+    const bool small = b.Bool();
+    height = small ? (b.Bits(5) + 1) * 8ull : b.U32(d0, d1, d2, d3);
+    const uint32_t ratio = b.Bits(3);
+    if (ratio != 0) width = RatioWidth(ratio, height);
+    else width = small ? (b.Bits(5) + 1) * 8ull : b.U32(d0, d1, d2, d3);
+}
+
+void SkipPreviewHeader(BitReader& b)
+{
+    const bool div8 = b.Bool();
+    const BitReader::Dist e0{ 0, 16 }, e1{ 0, 32 }, e2{ 5, 1 }, e3{ 9, 33 };
+    const BitReader::Dist p0{ 6, 1 }, p1{ 8, 65 }, p2{ 10, 321 }, p3{ 12, 1345 };
+    if (div8) b.U32(e0, e1, e2, e3); else b.U32(p0, p1, p2, p3);
+    if (b.Bits(3) == 0) {
+        if (div8) b.U32(e0, e1, e2, e3); else b.U32(p0, p1, p2, p3);
+    }
+}
+
+void SkipAnimationHeader(BitReader& b)
+{
+    b.U32({ 0, 100 }, { 0, 1000 }, { 10, 1 }, { 30, 1 });
+    b.U32({ 0, 1 }, { 0, 1001 }, { 8, 1 }, { 10, 1 });
+    b.U32({ 0, 0 }, { 3, 0 }, { 16, 0 }, { 32, 0 });
+    b.Bool();
+}
+
+int ReadBitDepth(BitReader& b)
+{
+    if (!b.Bool()) return static_cast<int>(b.U32({ 0, 8 }, { 0, 10 }, { 0, 12 }, { 6, 1 }));
+    const int bits = static_cast<int>(b.U32({ 0, 32 }, { 0, 16 }, { 0, 24 }, { 6, 1 }));
+    b.Bits(4);
+    return bits;
+}
+
+void SkipCustomXy(BitReader& b)
+{
+    for (int i = 0; i < 2; ++i) b.U32({ 19, 0 }, { 19, 524288 }, { 20, 1048576 }, { 21, 2097152 });
+}
+
+bool ParseJxlCodestream(const uint8_t* data, size_t size, ContainerInfo& info)
+{
+    if (size < 2 || data[0] != 0xFF || data[1] != 0x0A) return false;
+    BitReader b{ data + 2, size - 2 };
+    uint64_t width = 0, height = 0;
+    ReadSizeHeader(b, width, height);
+
+    // ImageMetadata; an all-default header means 8-bit sRGB
+    int orientation = 1;
+    info.bitDepth = 8;
+    info.components = 3;
+    info.color.present = true;
+    info.color.primaries = 1;
+    info.color.transfer = 13;
+    info.color.matrix = 0;
+    if (!b.Bool()) {
+        const bool extraFields = b.Bool();
+        if (extraFields) {
+            orientation = static_cast<int>(b.Bits(3)) + 1;
+            if (b.Bool()) { uint64_t w, h; ReadSizeHeader(b, w, h); }       // intrinsic size
+            if (b.Bool()) SkipPreviewHeader(b);
+            if (b.Bool()) { info.animated = true; SkipAnimationHeader(b); }
+        }
+        info.bitDepth = ReadBitDepth(b);
+        b.Bool();                                      // modular_16_bit_buffers
+        const uint32_t extraChannels = b.U32({ 0, 0 }, { 0, 1 }, { 4, 2 }, { 12, 1 });
+        for (uint32_t i = 0; i < extraChannels && b.ok; ++i) {
+            if (b.Bool()) continue;                    // default alpha channel
+            const uint32_t type = b.Enum();
+            ReadBitDepth(b);
+            b.U32({ 0, 0 }, { 0, 3 }, { 0, 4 }, { 3, 1 });
+            const uint32_t nameLength = b.U32({ 0, 0 }, { 4, 0 }, { 5, 16 }, { 10, 48 });
+            for (uint32_t c = 0; c < nameLength && b.ok; ++c) b.Bits(8);
+            if (type == 0) b.Bool();                   // alpha_associated
+            else if (type == 2) for (int c = 0; c < 4; ++c) b.F16();      // spot colour
+            else if (type == 5) b.U32({ 0, 1 }, { 2, 0 }, { 4, 3 }, { 8, 19 });
+        }
+        b.Bool();                                      // xyb_encoded
+
+        // ColourEncoding; the enum values of transfer functions are the CICP ones
+        if (!b.Bool()) {
+            const bool wantIcc = b.Bool();
+            const uint32_t colourSpace = b.Enum();     // 0 RGB, 1 grey, 2 XYB
+            uint32_t whitePoint = 1;
+            if (colourSpace == 1) info.components = 1;
+            info.hasIcc = wantIcc;
+            if (wantIcc) {
+                info.color.present = false;
+            } else {
+                if (colourSpace != 2) {
+                    whitePoint = b.Enum();
+                    if (whitePoint == 2) SkipCustomXy(b);
+                }
+                uint32_t primaries = 1;
+                if (colourSpace != 1 && colourSpace != 2) {
+                    primaries = b.Enum();
+                    if (primaries == 2) { SkipCustomXy(b); SkipCustomXy(b); SkipCustomXy(b); }
+                }
+                uint32_t transfer = 2;
+                if (b.Bool()) b.Bits(24);              // gamma exponent, not a CICP value
+                else transfer = b.Enum();
+                b.Enum();                              // rendering intent
+                info.color.primaries = static_cast<uint8_t>(primaries == 11 && whitePoint == 1 ? 12 : primaries);
+                info.color.transfer = static_cast<uint8_t>(std::min<uint32_t>(transfer, 255));
+            }
+        }
+        info.components += static_cast<int>(std::min<uint32_t>(extraChannels, 256));
+        if (extraFields && !b.Bool()) {                // ToneMapping
+            const float intensityTarget = b.F16();
+            if (intensityTarget > 0 && intensityTarget < 100000) info.color.maxCll = static_cast<uint32_t>(intensityTarget + 0.5f);
+        }
+    }
+    if (!b.ok || width == 0 || height == 0 || width > kMaxImageDimension || height > kMaxImageDimension) {
+        info.needBytes = b.ok ? 0 : size + 4096;
+        return false;
+    }
+    if (orientation > 4) std::swap(width, height);
+    info.width = static_cast<int>(width);
+    info.height = static_cast<int>(height);
+    return true;
+}
+
+} // namespace
+
+std::string CicpTransferName(uint8_t transfer)
+{
+    switch (transfer) {
+    case 1: case 6: case 14: case 15: return "bt709";
+    case 4: return "gamma2.2";
+    case 8: return "linear";
+    case 13: return "srgb";
+    case kCicpTransferPq: return "pq";
+    case 17: return "dci";
+    case kCicpTransferHlg: return "hlg";
+    default: return std::to_string(transfer);
+    }
+}
+
+std::string CicpPrimariesName(uint8_t primaries)
+{
+    switch (primaries) {
+    case 1: return "bt709";
+    case 9: return "bt2020";
+    case 11: return "dci-p3";
+    case 12: return "display-p3";
+    default: return std::to_string(primaries);
+    }
+}
+
+bool ReadBoxHeader(const uint8_t* data, size_t size, uint64_t offset, uint64_t fileSize, uint32_t& type, FileSpan& payload)
+{
+    if (offset >= fileSize) return false;
+    Box box;
+    // Relative to data; the box may extend to the end of the file
+    if (!NextBox(data, 0, fileSize - offset, size, box)) return false;
+    type = box.type;
+    payload = { offset + box.payload, box.end - box.payload };
+    return true;
+}
+
+bool ParseIsobmffInfo(const uint8_t* data, size_t size, uint64_t fileSize, ContainerInfo& info)
+{
+    info = ContainerInfo();
+    fileSize = std::max<uint64_t>(fileSize, size);
+    Box box;
+    for (uint64_t pos = 0; pos < fileSize; pos = box.end) {
+        if (size < fileSize && pos + 16 > size) {
+            // Box header past the head (meta after mdat): the head has to reach past it
+            info.needBytes = std::min<uint64_t>(fileSize, pos + 64 * 1024);
+            return false;
+        }
+        if (!NextBox(data, pos, fileSize, size, box)) return false;
+        if (pos == 0 && box.type != BoxType("ftyp")) return false;
+        if (box.type == BoxType("ftyp")) {
+            for (uint64_t p = box.payload; p + 4 <= std::min<uint64_t>(box.end, size); p += (p == box.payload ? 8 : 4)) {
+                if (std::memcmp(data + p, "avis", 4) == 0 || std::memcmp(data + p, "msf1", 4) == 0) info.animated = true;
+            }
+        } else if (box.type == BoxType("moov")) {
+            info.animated = true;
+        } else if (box.type == BoxType("meta")) {
+            if (box.end > size) { info.needBytes = box.end; return false; }
+            return ParseMeta(data, box, info);
+        }
+    }
+    return false;
+}
+
+bool ParseJxlInfo(const uint8_t* data, size_t size, uint64_t fileSize, ContainerInfo& info)
+{
+    info = ContainerInfo();
+    fileSize = std::max<uint64_t>(fileSize, size);
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0x0A) return ParseJxlCodestream(data, size, info);
+    static const uint8_t kSignature[12] = { 0, 0, 0, 12, 'J', 'X', 'L', ' ', 0x0D, 0x0A, 0x87, 0x0A };
+    if (size < sizeof(kSignature) || std::memcmp(data, kSignature, sizeof(kSignature)) != 0) return false;
+
+    bool parsed = false;
+    Box box;
+    for (uint64_t pos = sizeof(kSignature); pos < fileSize; pos = box.end) {
+        if (size < fileSize && pos + 16 > size) { info.unreadBoxOffset = pos; break; }
+        if (!NextBox(data, pos, fileSize, size, box)) return false;
+        if (box.type == BoxType("jhgm")) {
+            info.gainMap = true;
+            ByteReader r(data, box.payload, std::min<uint64_t>(box.end, size));
+            r.Skip(1);                                 // jhgm version
+            const uint16_t metadataSize = r.U16();
+            if (r.ok && box.payload + 3 + metadataSize <= box.end) info.gainMapMetadata = { box.payload + 3, metadataSize };
+        } else if (!parsed && (box.type == BoxType("jxlc") || box.type == BoxType("jxlp"))) {
+            // A partial codestream box starts with its sequence number
+            const uint64_t start = box.payload + (box.type == BoxType("jxlp") ? 4 : 0);
+            if (start >= size) { info.needBytes = start + 4096; return false; }
+            ContainerInfo codestream;
+            if (!ParseJxlCodestream(data + start, static_cast<size_t>(std::min<uint64_t>(box.end, size) - start), codestream)) {
+                if (codestream.needBytes != 0 && box.end > size) { info.needBytes = start + codestream.needBytes; return false; }
+                return false;
+            }
+            const bool gainMap = info.gainMap;
+            const FileSpan metadata = info.gainMapMetadata;
+            info = codestream;
+            info.gainMap = gainMap;
+            info.gainMapMetadata = metadata;
+            parsed = true;
+        }
+    }
+    return parsed;
+}
+
+bool ParsePngInfo(const uint8_t* data, size_t size, ContainerInfo& info)
+{
+    info = ContainerInfo();
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    if (size < 33 || std::memcmp(data, kSignature, sizeof(kSignature)) != 0) return false;
+    bool transparency = false, srgb = false;
+    int colourType = 0;
+    for (uint64_t pos = 8; pos + 8 <= size;) {
+        ByteReader r(data, pos, size);
+        const uint32_t length = r.U32();
+        const uint32_t type = r.U32();
+        const uint64_t payload = r.pos, end = payload + length + 4;      // CRC follows the data
+        if (pos == 8 && (type != BoxType("IHDR") || length < 13)) return false;
+        if (type == BoxType("IDAT") || type == BoxType("IEND")) break;
+        if (end > size) {
+            // Color chunks come before IDAT; a large text or EXIF chunk pushed them past the head
+            info.needBytes = end + 8;
+            break;
+        }
+        ByteReader c(data, payload, payload + length);
+        switch (type) {
+        case BoxType("IHDR"): {
+            const uint32_t width = c.U32(), height = c.U32();
+            if (width > kMaxImageDimension || height > kMaxImageDimension) return false;
+            info.width = static_cast<int>(width);
+            info.height = static_cast<int>(height);
+            info.bitDepth = c.U8();
+            colourType = c.U8();
+            break;
+        }
+        case BoxType("cICP"):
+            if (length >= 4) {
+                info.color.present = true;
+                info.color.primaries = c.U8();
+                info.color.transfer = c.U8();
+                info.color.matrix = c.U8();
+                info.color.fullRange = c.U8() != 0;
+            }
+            break;
+        case BoxType("iCCP"): {
+            info.hasIcc = true;
+            const uint8_t* name = data + payload;
+            const size_t nameLength = static_cast<size_t>(std::find(name, name + std::min<uint32_t>(length, 80), 0) - name);
+            info.iccName.assign(reinterpret_cast<const char*>(name), nameLength);
+            break;
+        }
+        case BoxType("sRGB"):
+            srgb = true;
+            break;
+        case BoxType("cLLi"):
+            if (length >= 8) info.color.maxCll = c.U32() / 10000;          // 0.0001 cd/m2 units
+            break;
+        case BoxType("acTL"):
+            info.animated = true;
+            break;
+        case BoxType("tRNS"):
+            transparency = true;
+            break;
+        default:
+            break;
+        }
+        pos = end;
+    }
+    if (info.width <= 0 || info.height <= 0) return false;
+    static const int kComponents[7] = { 1, 0, 3, 3, 2, 0, 4 };
+    info.components = colourType < 7 ? kComponents[colourType] : 0;
+    if (info.components == 0) return false;
+    if (transparency && (colourType == 0 || colourType == 2 || colourType == 3)) ++info.components;
+    // cICP takes precedence over sRGB, iCCP and gAMA
+    if (!info.color.present && srgb && !info.hasIcc) {
+        info.color.present = true;
+        info.color.primaries = 1;
+        info.color.transfer = 13;
+        info.color.matrix = 0;
+    }
+    return true;
+}
@@ -0,0 +1,276 @@
+// FileIdentity.cpp - content hashing and sampled file fingerprints
+#include "FileIdentity.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_HASH_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr uint64_t kPrime32_1 = 0x9E3779B1u;
+constexpr uint64_t kPrime32_2 = 0x85EBCA77u;
+constexpr uint64_t kPrime32_3 = 0xC2B2AE3Du;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
+
+constexpr size_t kLanes = 8;
+constexpr size_t kStripeBytes = kLanes * 8;
+constexpr size_t kStripesPerBlock = 16;
+constexpr size_t kBlockBytes = kStripeBytes * kStripesPerBlock;
+
+// Key words: stripe s of a block uses words s..s+7, the block scramble 24..31, the last stripe
+// 9..16 and the final mix 32..39
+struct Secret {
+    uint64_t words[40];
+
+    explicit Secret(uint64_t seed) {
+        uint64_t state = seed ^ kPrime64_3;
+        for (uint64_t& w : words) {
+            // SplitMix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            w = z ^ (z >> 31);
+        }
+    }
+};
+
+// Little-endian loads; every target of this code base is little-endian
+inline uint64_t Load64(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t Mul128Fold64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    const uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    const uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32, bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    const uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    const uint64_t cross = (ll >> 32) + (lh & 0xFFFFFFFF) + hl;
+    const uint64_t low = (cross << 32) | (ll & 0xFFFFFFFF);
+    const uint64_t high = hh + (lh >> 32) + (cross >> 32);
+    return low ^ high;
+#endif
+}
+
+inline uint64_t Avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    return h ^ (h >> 32);
+}
+
+// Lane i takes the 32x32-bit product of the key-mixed word i plus the raw neighbouring word,
+// so a word that cancels out of the product still reaches the state
+struct Accumulator {
+#ifdef HDR_HASH_SSE2
+    __m128i acc[kLanes / 2];
+
+    void Init(const uint64_t* init) {
+        for (size_t j = 0; j < kLanes / 2; ++j) acc[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(init + 2 * j));
+    }
+    void Stripe(const uint8_t* p, const uint64_t* key) {
+        for (size_t j = 0; j < kLanes / 2; ++j) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * j));
+            const __m128i mixed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 2 * j)));
+            const __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[j] = _mm_add_epi64(acc[j], _mm_add_epi64(product, swapped));
+        }
+    }
+    void Scramble(const uint64_t* key) {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+        for (size_t j = 0; j < kLanes / 2; ++j) {
+            __m128i a = _mm_xor_si128(acc[j], _mm_srli_epi64(acc[j], 47));
+            a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 2 * j)));
+            const __m128i low = _mm_mul_epu32(a, prime);
+            const __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+            acc[j] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+    void Store(uint64_t* out) const {
+        for (size_t j = 0; j < kLanes / 2; ++j) _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * j), acc[j]);
+    }
+#else
+    uint64_t acc[kLanes];
+
+    void Init(const uint64_t* init) { std::memcpy(acc, init, sizeof(acc)); }
+    void Stripe(const uint8_t* p, const uint64_t* key) {
+        for (size_t i = 0; i < kLanes; ++i) {
+            const uint64_t data = Load64(p + 8 * i);
+            const uint64_t mixed = data ^ key[i];
+            acc[i ^ 1] += data;
+            acc[i] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+        }
+    }
+    void Scramble(const uint64_t* key) {
+        for (size_t i = 0; i < kLanes; ++i) acc[i] = (acc[i] ^ (acc[i] >> 47) ^ key[i]) * kPrime32_1;
+    }
+    void Store(uint64_t* out) const { std::memcpy(out, acc, sizeof(acc)); }
+#endif
+};
+
+const Secret& DefaultSecret()
+{
+    static const Secret secret(0);
+    return secret;
+}
+
+ContentHash HashWithKey(const uint8_t* data, size_t size, const uint64_t* key)
+{
+    const uint8_t* p = data;
+    static const uint64_t init[kLanes] = { kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1 };
+    Accumulator acc;
+    acc.Init(init);
+    if (size <= kStripeBytes) {
+        // Zero padded; the length in the final mix tells trailing zeros apart
+        uint8_t stripe[kStripeBytes] = {};
+        if (size > 0) std::memcpy(stripe, p, size);
+        acc.Stripe(stripe, key);
+    } else {
+        const size_t blocks = (size - 1) / kBlockBytes;
+        for (size_t b = 0; b < blocks; ++b, p += kBlockBytes) {
+            for (size_t s = 0; s < kStripesPerBlock; ++s) acc.Stripe(p + s * kStripeBytes, key + s);
+            acc.Scramble(key + 24);
+        }
+        // 1..1024 bytes remain: whole stripes, then the last 64 bytes of the input (overlapping)
+        const size_t stripes = (size - blocks * kBlockBytes - 1) / kStripeBytes;
+        for (size_t s = 0; s < stripes; ++s) acc.Stripe(p + s * kStripeBytes, key + s);
+        acc.Stripe(data + size - kStripeBytes, key + 9);
+    }
+
+    uint64_t lanes[kLanes];
+    acc.Store(lanes);
+    uint64_t lo = size * kPrime64_1, hi = ~(size * kPrime64_2);
+    for (size_t j = 0; j < kLanes / 2; ++j) {
+        lo += Mul128Fold64(lanes[2 * j] ^ key[32 + j], lanes[2 * j + 1] ^ key[36 + j]);
+        hi += Mul128Fold64(lanes[2 * j] ^ key[36 + (j + 1) % 4], lanes[2 * j + 1] ^ key[32 + (j + 3) % 4]);
+    }
+    return { Avalanche(lo), Avalanche(hi ^ (lo >> 29)) };
+}
+
+// Hashes the size followed by the bytes of every span, which `read` copies into place
+template<typename Read>
+bool Fingerprint(uint64_t fileSize, Read read, ContentHash& hash)
+{
+    const std::vector<FileSpan> spans = FingerprintSpans(fileSize);
+    size_t total = 8;
+    for (const FileSpan& span : spans) total += static_cast<size_t>(span.size);
+    std::vector<uint8_t> buffer(total);
+    for (int i = 0; i < 8; ++i) buffer[i] = static_cast<uint8_t>(fileSize >> (8 * i));
+    size_t pos = 8;
+    for (const FileSpan& span : spans) {
+        // An empty file has one empty span; its data pointer may be null
+        if (span.Empty()) continue;
+        if (!read(span, buffer.data() + pos)) return false;
+        pos += static_cast<size_t>(span.size);
+    }
+    hash = HashBytes(buffer.data(), buffer.size());
+    return true;
+}
+
+} // namespace
+
+std::string ContentHash::ToHex() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        hex[15 - i] = digits[(hi >> (4 * i)) & 0xF];
+        hex[31 - i] = digits[(lo >> (4 * i)) & 0xF];
+    }
+    return hex;
+}
+
+bool ContentHash::FromHex(const std::string& hex, ContentHash& hash)
+{
+    hash = ContentHash();
+    if (hex.size() != 32) return false;
+    ContentHash parsed;
+    for (size_t i = 0; i < 32; ++i) {
+        const char c = hex[i];
+        const int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) return false;
+        uint64_t& half = i < 16 ? parsed.hi : parsed.lo;
+        half = (half << 4) | static_cast<uint64_t>(digit);
+    }
+    hash = parsed;
+    return true;
+}
+
+ContentHash HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    if (seed == 0) return HashWithKey(static_cast<const uint8_t*>(data), size, DefaultSecret().words);
+    const Secret secret(seed);
+    return HashWithKey(static_cast<const uint8_t*>(data), size, secret.words);
+}
+
+std::vector<FileSpan> FingerprintSpans(uint64_t fileSize)
+{
+    // Below this the samples would overlap
+    const uint64_t whole = kFingerprintHeadBytes + (kFingerprintSamples + 3) * kFingerprintSampleBytes;
+    if (fileSize <= whole) return { { 0, fileSize } };
+    std::vector<FileSpan> spans;
+    spans.push_back({ 0, kFingerprintHeadBytes });
+    // Sample k starts k/(n+1) of the way through the body between head and tail
+    const uint64_t bodyStart = kFingerprintHeadBytes;
+    const uint64_t bodyRange = fileSize - kFingerprintSampleBytes - bodyStart - kFingerprintSampleBytes;
+    for (int k = 1; k <= kFingerprintSamples; ++k) {
+        spans.push_back({ bodyStart + bodyRange * k / (kFingerprintSamples + 1), kFingerprintSampleBytes });
+    }
+    spans.push_back({ fileSize - kFingerprintSampleBytes, kFingerprintSampleBytes });
+    return spans;
+}
+
+bool FingerprintRanges(uint64_t fileSize, const std::vector<ProbeRange>& ranges, ContentHash& hash)
+{
+    return Fingerprint(fileSize, [&](const FileSpan& span, uint8_t* out) {
+        for (const ProbeRange& range : ranges) {
+            if (span.offset >= range.offset && span.offset + span.size <= range.offset + range.size) {
+                std::memcpy(out, range.data + (span.offset - range.offset), static_cast<size_t>(span.size));
+                return true;
+            }
+        }
+        return false;
+    }, hash);
+}
+
+ContentHash FingerprintData(const uint8_t* data, size_t size)
+{
+    ContentHash hash;
+    Fingerprint(size, [&](const FileSpan& span, uint8_t* out) {
+        std::memcpy(out, data + span.offset, static_cast<size_t>(span.size));
+        return true;
+    }, hash);
+    return hash;
+}
+
+bool FingerprintFile(const std::filesystem::path& path, uint64_t fileSize, ContentHash& hash)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    return Fingerprint(fileSize, [&](const FileSpan& span, uint8_t* out) {
+        in.seekg(static_cast<std::streamoff>(span.offset));
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(span.size)));
+    }, hash);
+}
@@ -0,0 +1,579 @@
+// HdrRender.cpp - gain map rendering on the CPU and HDR image file writers
+#include "HdrRender.h"
+#include "ImageProbe.h"
+#include "ImageResize.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Linear BT.709 and Display P3 to linear BT.2020 (ITU-R BT.2087 and its P3 equivalent)
+const float kBt709ToBt2020[9] = { 0.6274039f, 0.3292830f, 0.0433131f, 0.0690973f, 0.9195404f, 0.0113623f, 0.0163914f, 0.0880133f, 0.8955953f };
+const float kP3ToBt2020[9] = { 0.7538330f, 0.1985974f, 0.0475696f, 0.0457438f, 0.9417772f, 0.0124790f, -0.0012103f, 0.0176017f, 0.9836086f };
+
+// The sRGB curve, which Display P3 shares; BT.2020 SDR files in practice use it as well
+struct SrgbToLinear {
+    float table[256];
+    SrgbToLinear() {
+        for (int i = 0; i < 256; ++i) {
+            const double v = i / 255.0;
+            table[i] = static_cast<float>(v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+        }
+    }
+};
+
+// JFIF YCbCr to RGB in 16.16 fixed point, as libjpeg does it
+struct YCbCrTables {
+    int crR[256], cbB[256], crG[256], cbG[256];
+    YCbCrTables() {
+        for (int i = 0; i < 256; ++i) {
+            const int c = i - 128;
+            crR[i] = static_cast<int>(std::lround(1.402 * 65536) * c + 32768) >> 16;
+            cbB[i] = static_cast<int>(std::lround(1.772 * 65536) * c + 32768) >> 16;
+            crG[i] = -static_cast<int>(std::lround(0.714136 * 65536)) * c;
+            cbG[i] = -static_cast<int>(std::lround(0.344136 * 65536)) * c + 32768;
+        }
+    }
+};
+
+const YCbCrTables& YCbCr()
+{
+    static const YCbCrTables tables;
+    return tables;
+}
+
+inline uint8_t Clamp8(int v)
+{
+    return static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+inline void ToRgb(const YCbCrTables& t, int y, int cb, int cr, uint8_t rgb[3])
+{
+    rgb[0] = Clamp8(y + t.crR[cr]);
+    rgb[1] = Clamp8(y + ((t.cbG[cb] + t.crG[cr]) >> 16));
+    rgb[2] = Clamp8(y + t.cbB[cb]);
+}
+
+RenderPrimaries PrimariesFromIcc(const std::string& description)
+{
+    if (description.find("P3") != std::string::npos) return RenderPrimaries::DisplayP3;
+    if (description.find("2020") != std::string::npos || description.find("2100") != std::string::npos) return RenderPrimaries::Bt2020;
+    return RenderPrimaries::Bt709;
+}
+
+// The first MPF secondary image with gain map metadata, as BakeRendition finds it
+bool FindGainMapImage(const uint8_t* data, size_t size, const uint8_t*& gainMap, size_t& gainMapSize)
+{
+    std::vector<MpfImage> images;
+    if (!ReadMpfImages(data, size, images)) return false;
+    std::vector<JpegSegment> segments;
+    for (size_t i = 1; i < images.size(); ++i) {
+        const uint8_t* image = data + images[i].offset;
+        if (!ReadJpegSegments(image, images[i].size, segments)) continue;
+        for (const JpegSegment& segment : segments) {
+            if (!IsGainMapMetadataSegment(image, segment)) continue;
+            gainMap = image;
+            gainMapSize = images[i].size;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Converts rows [y0, y1)
+void ConvertToLinear(const PlanarImage& source, RenderPrimaries primaries, int y0, int y1, HdrImage& image)
+{
+    static const SrgbToLinear linear;
+    const YCbCrTables& t = YCbCr();
+    const float* m = primaries == RenderPrimaries::DisplayP3 ? kP3ToBt2020 : primaries == RenderPrimaries::Bt709 ? kBt709ToBt2020 : nullptr;
+    const size_t end = static_cast<size_t>(y1) * source.width;
+    float* out = image.rgb.data() + static_cast<size_t>(y0) * source.width * 3;
+    for (size_t i = static_cast<size_t>(y0) * source.width; i < end; ++i, out += 3) {
+        uint8_t rgb[3];
+        if (source.channels == 3) ToRgb(t, source.planes[0][i], source.planes[1][i], source.planes[2][i], rgb);
+        else rgb[0] = rgb[1] = rgb[2] = source.planes[0][i];
+        const float r = linear.table[rgb[0]], g = linear.table[rgb[1]], b = linear.table[rgb[2]];
+        if (m) {
+            out[0] = m[0] * r + m[1] * g + m[2] * b;
+            out[1] = m[3] * r + m[4] * g + m[5] * b;
+            out[2] = m[6] * r + m[7] * g + m[8] * b;
+        } else {
+            out[0] = r;
+            out[1] = g;
+            out[2] = b;
+        }
+    }
+}
+
+// A decoded gain map ready to apply to any rows of the image: the log boost of every code value
+// at the render's weight and, for RGB maps (stored as YCbCr like any JPEG), RGB planes
+struct GainMapLayers {
+    float logBoost[256];
+    int channels = 1;
+    int width = 0, height = 0;
+    const uint8_t* planes[3] = {};
+    float offsetSdr = 0, offsetHdr = 0;
+    std::vector<uint8_t, PixelAllocator<uint8_t>> rgb;
+
+    void Prepare(const PlanarImage& map, const GainMapMetadata& m, float weight) {
+        const float gamma = m.gamma > 0 ? m.gamma : 1.0f;
+        for (int i = 0; i < 256; ++i) {
+            const float g = std::pow(i / 255.0f, 1.0f / gamma);
+            logBoost[i] = weight * (m.gainMapMin + (m.gainMapMax - m.gainMapMin) * g);
+        }
+        channels = map.channels == 3 ? 3 : 1;
+        width = map.width;
+        height = map.height;
+        offsetSdr = m.offsetSdr;
+        offsetHdr = m.offsetHdr;
+        planes[0] = planes[1] = planes[2] = map.planes[0].data();
+        if (channels == 3) {
+            const size_t pixels = static_cast<size_t>(map.width) * map.height;
+            rgb.resize(pixels * 3);
+            const YCbCrTables& t = YCbCr();
+            for (size_t i = 0; i < pixels; ++i) {
+                uint8_t px[3];
+                ToRgb(t, map.planes[0][i], map.planes[1][i], map.planes[2][i], px);
+                rgb[i] = px[0];
+                rgb[pixels + i] = px[1];
+                rgb[2 * pixels + i] = px[2];
+            }
+            for (int c = 0; c < 3; ++c) planes[c] = rgb.data() + c * pixels;
+        }
+    }
+};
+
+// HDR = (base + offsetSdr) * 2^(weight * log boost) - offsetHdr for rows [y0, y1). The gain map
+// is upsampled bilinearly in the log domain; its RGB samples give one boost per channel, gray
+// one for all. The offsets commute with the conversion to BT.2020 because its rows sum to one.
+void ApplyGainMap(const GainMapLayers& map, const LinearTaps& columns, const LinearTaps& rows, int y0, int y1, HdrImage& image)
+{
+    const float offsetSdr = map.offsetSdr, offsetHdr = map.offsetHdr;
+    std::vector<float> top(static_cast<size_t>(map.width)), boost(static_cast<size_t>(image.width));
+    for (int y = y0; y < y1; ++y) {
+        const int i0 = rows.i0[static_cast<size_t>(y)], i1 = rows.i1[static_cast<size_t>(y)];
+        const float f = rows.f[static_cast<size_t>(y)];
+        float* out = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+        for (int c = 0; c < map.channels; ++c) {
+            const uint8_t* r0 = map.planes[c] + static_cast<size_t>(i0) * map.width;
+            const uint8_t* r1 = map.planes[c] + static_cast<size_t>(i1) * map.width;
+            // Vertical pass once per map row pair, then the row upsampled and exponentiated
+            for (int x = 0; x < map.width; ++x) top[x] = map.logBoost[r0[x]] + (map.logBoost[r1[x]] - map.logBoost[r0[x]]) * f;
+            UpsampleExp2Row(columns, top.data(), boost.data());
+            if (map.channels == 3) {
+                for (int x = 0; x < image.width; ++x) out[x * 3 + c] = (out[x * 3 + c] + offsetSdr) * boost[x] - offsetHdr;
+            } else {
+                for (int x = 0; x < image.width; ++x) {
+                    float* px = out + static_cast<size_t>(x) * 3;
+                    px[0] = (px[0] + offsetSdr) * boost[x] - offsetHdr;
+                    px[1] = (px[1] + offsetSdr) * boost[x] - offsetHdr;
+                    px[2] = (px[2] + offsetSdr) * boost[x] - offsetHdr;
+                }
+            }
+        }
+    }
+}
+
+void Put32LE(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+void PutFloatLE(std::vector<uint8_t>& out, float f)
+{
+    uint32_t v;
+    std::memcpy(&v, &f, 4);
+    Put32LE(out, v);
+}
+
+void Put32BE(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 3; i >= 0; --i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+void PutExrAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+{
+    out.insert(out.end(), name, name + std::strlen(name) + 1);
+    out.insert(out.end(), type, type + std::strlen(type) + 1);
+    Put32LE(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// CRC-32 of PNG chunks, eight bytes per step (slicing-by-8); PQ PNGs run to hundreds of MB
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+    static const auto tables = [] {
+        std::vector<uint32_t> t(8 * 256);
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        for (uint32_t n = 0; n < 256; ++n) {
+            for (int k = 1; k < 8; ++k) t[k * 256 + n] = (t[(k - 1) * 256 + n] >> 8) ^ t[t[(k - 1) * 256 + n] & 0xFF];
+        }
+        return t;
+    }();
+    const uint32_t* t = tables.data();
+    uint32_t crc = ~0u;
+    for (; size >= 8; data += 8, size -= 8) {
+        const uint32_t lo = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+        crc = t[7 * 256 + (lo & 0xFF)] ^ t[6 * 256 + ((lo >> 8) & 0xFF)] ^ t[5 * 256 + ((lo >> 16) & 0xFF)] ^ t[4 * 256 + (lo >> 24)] ^
+              t[3 * 256 + data[4]] ^ t[2 * 256 + data[5]] ^ t[256 + data[6]] ^ t[data[7]];
+    }
+    for (; size > 0; ++data, --size) crc = t[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void PutPngChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    Put32BE(out, static_cast<uint32_t>(size));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    Put32BE(out, Crc32(out.data() + start, out.size() - start));
+}
+
+// zlib stream of stored (uncompressed) deflate blocks for `total` bytes written in pieces
+class StoredDeflate {
+public:
+    StoredDeflate(std::vector<uint8_t>& out, size_t total) : out_(out), left_(total) {
+        out_.reserve(out_.size() + total + (total / 65535 + 1) * 5 + 6);
+        out_.push_back(0x78);
+        out_.push_back(0x01);
+        if (total == 0) StartBlock();
+    }
+
+    void Write(const uint8_t* data, size_t size) {
+        while (size > 0) {
+            if (blockLeft_ == 0) StartBlock();
+            const size_t n = std::min(size, blockLeft_);
+            out_.insert(out_.end(), data, data + n);
+            // At most 65535 bytes between reductions, so b cannot overflow 64 bits
+            uint64_t b = b_;
+            for (size_t i = 0; i < n; ++i) {
+                a_ += data[i];
+                b += a_;
+            }
+            a_ %= 65521;
+            b_ = static_cast<uint32_t>(b % 65521);
+            data += n;
+            size -= n;
+            blockLeft_ -= n;
+        }
+    }
+
+    void Finish() { Put32BE(out_, (b_ << 16) | a_); }
+
+private:
+    void StartBlock() {
+        const size_t length = std::min<size_t>(left_, 65535);
+        left_ -= length;
+        blockLeft_ = length;
+        out_.push_back(left_ == 0 ? 1 : 0);
+        out_.push_back(static_cast<uint8_t>(length));
+        out_.push_back(static_cast<uint8_t>(length >> 8));
+        out_.push_back(static_cast<uint8_t>(~length));
+        out_.push_back(static_cast<uint8_t>(~length >> 8));
+    }
+
+    std::vector<uint8_t>& out_;
+    size_t left_;               // bytes not yet assigned to a block
+    size_t blockLeft_ = 0;      // bytes the current block still takes
+    uint32_t a_ = 1, b_ = 0;    // Adler-32
+};
+
+// PQ code values (0..65535) over linear luminance 2^-24..1 of the 10000 cd/m2 range, indexed by
+// the exponent and the top 10 mantissa bits of the float and interpolated between entries
+struct PqTable {
+    static constexpr uint32_t kLowBits = 0x33800000u >> 13;    // 2^-24
+    static constexpr uint32_t kHighBits = 0x3F800000u >> 13;   // 1.0
+    std::vector<float> codes;
+    PqTable() : codes(kHighBits - kLowBits + 2) {
+        for (uint32_t i = 0; i < codes.size(); ++i) {
+            const uint32_t bits = (kLowBits + i) << 13;
+            float y;
+            std::memcpy(&y, &bits, 4);
+            codes[i] = PqEncode(std::min(y, 1.0f) * 10000.0f) * 65535.0f;
+        }
+    }
+    uint16_t Encode(float y) const {
+        if (!(y > 0x1p-24f)) return y > 0 ? static_cast<uint16_t>(PqEncode(y * 10000.0f) * 65535.0f + 0.5f) : 0;
+        if (y >= 1.0f) return 65535;
+        uint32_t bits;
+        std::memcpy(&bits, &y, 4);
+        const uint32_t i = (bits >> 13) - kLowBits;
+        const float f = static_cast<float>(bits & 0x1FFF) * (1.0f / 8192.0f);
+        return static_cast<uint16_t>(codes[i] + (codes[i + 1] - codes[i]) * f + 0.5f);
+    }
+};
+
+} // namespace
+
+const char* RenderPrimariesName(RenderPrimaries primaries)
+{
+    switch (primaries) {
+    case RenderPrimaries::Bt709: return "bt709";
+    case RenderPrimaries::DisplayP3: return "display-p3";
+    case RenderPrimaries::Bt2020: return "bt2020";
+    }
+    return "bt709";
+}
+
+bool RenderHdrImage(const uint8_t* data, size_t size, const HdrRenderOptions& options, HdrImage& image, HdrRenderInfo* info, std::string* error)
+{
+    HdrRenderInfo local;
+    HdrRenderInfo& result = info ? *info : local;
+    result = HdrRenderInfo();
+    const auto start = Clock::now();
+
+    ImageProbe probe;
+    const uint8_t* gainMapData = nullptr;
+    size_t gainMapSize = 0;
+    float weight = 0;
+    PlanarImage base, map;
+    GainMapLayers layers;
+    std::string parseError, baseError, mapError;
+    JpegDecodeOptions decode;
+    decode.threads = options.decodeThreads;
+    decode.pool = options.pool;
+    decode.cancel = options.cancel;
+    auto cancelled = [&] { return options.cancel && options.cancel->load(std::memory_order_relaxed); };
+
+    // The base image decodes from the start; the gain map waits for the metadata that says
+    // whether it is needed at this headroom. Color conversion and the gain map are fused per
+    // band of rows, so the map pass finds the converted rows in cache.
+    TaskGraph graph;
+    const TaskGraph::TaskId parse = graph.Add("parse", [&] {
+        ProbeImageData(data, size, probe);
+        if (probe.container != ImageContainer::Jpeg) {
+            parseError = std::string(ImageContainerName(probe.container)) + " is not rendered on the CPU";
+            return false;
+        }
+        result.primaries = PrimariesFromIcc(probe.iccDescription);
+        const bool hasGainMap = probe.hasHdrgm && FindGainMapImage(data, size, gainMapData, gainMapSize);
+        result.headroom = options.headroom < 0 ? (hasGainMap ? probe.hdrgm.hdrCapacityMax : 0.0f) : options.headroom;
+        weight = hasGainMap ? GainMapWeight(probe.hdrgm, result.headroom) : 0.0f;
+        return true;
+    });
+    const TaskGraph::TaskId decodeBase = graph.Add("decode base", [&] {
+        if (!DecodeJpeg(data, size, decode, base, &baseError)) return false;
+        image.Allocate(base.width, base.height);
+        return true;
+    });
+    const TaskGraph::TaskId decodeMap = graph.Add("decode gain map", [&] {
+        if (weight <= 0) return true;
+        if (!DecodeJpeg(gainMapData, gainMapSize, decode, map, &mapError)) return false;
+        layers.Prepare(map, probe.hdrgm, weight);
+        return true;
+    }, { parse });
+    // Bands also split a serial render, which then measures the critical path a pool would get
+    const int bands = std::max(8, options.pool ? static_cast<int>(options.pool->ThreadCount()) + 1 : 0);
+    std::vector<double> colorMs(static_cast<size_t>(bands)), gainMapMs(static_cast<size_t>(bands));
+    for (int b = 0; b < bands; ++b) {
+        graph.Add("color + gain map", [&, b] {
+            const int y0 = static_cast<int>(static_cast<int64_t>(image.height) * b / bands);
+            const int y1 = static_cast<int>(static_cast<int64_t>(image.height) * (b + 1) / bands);
+            LinearTaps columns, rows;
+            if (weight > 0) {
+                columns = BuildLinearTaps(layers.width, image.width);
+                rows = BuildLinearTaps(layers.height, image.height);
+            }
+            const int kRows = 16;
+            for (int y = y0; y < y1; y += kRows) {
+                if (cancelled()) return false;
+                const int end = std::min(y1, y + kRows);
+                auto stageStart = Clock::now();
+                ConvertToLinear(base, result.primaries, y, end, image);
+                colorMs[b] += MsSince(stageStart);
+                if (weight > 0) {
+                    stageStart = Clock::now();
+                    ApplyGainMap(layers, columns, rows, y, end, image);
+                    gainMapMs[b] += MsSince(stageStart);
+                }
+            }
+            return true;
+        }, { parse, decodeBase, decodeMap });
+    }
+
+    const bool ok = graph.Run(options.pool, WorkerPool::Clock::now(), options.cancel);
+    const std::vector<TaskGraph::TaskTiming> timings = graph.Timings();
+    auto taskMs = [&](TaskGraph::TaskId id) { return timings[id].endMs - timings[id].startMs; };
+    result.timings.parseMs = taskMs(parse);
+    result.timings.decodeMs = taskMs(decodeBase) + taskMs(decodeMap);
+    for (int b = 0; b < bands; ++b) {
+        result.timings.colorMs += colorMs[b];
+        result.timings.gainMapMs += gainMapMs[b];
+    }
+    result.timings.criticalPathMs = graph.CriticalPathMs();
+    result.timings.totalMs = MsSince(start);
+    if (!ok) {
+        if (error) *error = cancelled() ? "cancelled" : !parseError.empty() ? parseError : !baseError.empty() ? baseError : mapError;
+        return false;
+    }
+    result.gainMap = weight > 0;
+    result.weight = weight;
+    return true;
+}
+
+float PqEncode(float nits)
+{
+    const double m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128, c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+    const double y = std::pow(std::clamp(nits / 10000.0, 0.0, 1.0), m1);
+    return static_cast<float>(std::pow((c1 + c2 * y) / (1 + c3 * y), m2));
+}
+
+void EncodePfm(const HdrImage& image, std::vector<uint8_t>& out)
+{
+    char header[64];
+    const int length = std::snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", image.width, image.height);
+    out.assign(header, header + length);
+    out.reserve(out.size() + image.rgb.size() * 4);
+    for (int y = image.height - 1; y >= 0; --y) {
+        const float* row = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+        for (int i = 0; i < image.width * 3; ++i) PutFloatLE(out, row[i]);
+    }
+}
+
+bool DecodePfm(const uint8_t* data, size_t size, HdrImage& image)
+{
+    // "PF", width and height, scale (negative for little endian), each followed by white space
+    std::string header(reinterpret_cast<const char*>(data), std::min<size_t>(size, 128));
+    int width = 0, height = 0, consumed = 0;
+    float scale = 0;
+    if (std::sscanf(header.c_str(), "PF %d %d %f%n", &width, &height, &scale, &consumed) != 3 || width <= 0 || height <= 0) return false;
+    const size_t offset = static_cast<size_t>(consumed) + 1;
+    const size_t bytes = static_cast<size_t>(width) * height * 12;
+    if (offset + bytes > size || scale == 0) return false;
+    image.Allocate(width, height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* src = data + offset + static_cast<size_t>(height - 1 - y) * width * 12;
+        float* row = image.rgb.data() + static_cast<size_t>(y) * width * 3;
+        for (int i = 0; i < width * 3; ++i) {
+            uint8_t b[4];
+            std::memcpy(b, src + i * 4, 4);
+            if (scale > 0) { std::swap(b[0], b[3]); std::swap(b[1], b[2]); }
+            std::memcpy(&row[i], b, 4);
+        }
+    }
+    return true;
+}
+
+void EncodeExr(const HdrImage& image, std::vector<uint8_t>& out)
+{
+    out.clear();
+    Put32LE(out, 20000630);                                    // magic
+    Put32LE(out, 2);                                           // version 2, single part scanline
+    std::vector<uint8_t> channels;
+    for (const char* name : { "B", "G", "R" }) {               // channels are listed alphabetically
+        channels.insert(channels.end(), name, name + 2);
+        Put32LE(channels, 2);                                  // FLOAT
+        Put32LE(channels, 0);                                  // pLinear, reserved
+        Put32LE(channels, 1);                                  // x sampling
+        Put32LE(channels, 1);                                  // y sampling
+    }
+    channels.push_back(0);
+    PutExrAttribute(out, "channels", "chlist", channels);
+    std::vector<uint8_t> chromaticities;
+    for (float v : { 0.708f, 0.292f, 0.170f, 0.797f, 0.131f, 0.046f, 0.3127f, 0.3290f }) PutFloatLE(chromaticities, v);
+    PutExrAttribute(out, "chromaticities", "chromaticities", chromaticities);
+    PutExrAttribute(out, "compression", "compression", { 0 });
+    std::vector<uint8_t> window;
+    for (int v : { 0, 0, image.width - 1, image.height - 1 }) Put32LE(window, static_cast<uint32_t>(v));
+    PutExrAttribute(out, "dataWindow", "box2i", window);
+    PutExrAttribute(out, "displayWindow", "box2i", window);
+    PutExrAttribute(out, "lineOrder", "lineOrder", { 0 });
+    std::vector<uint8_t> one, center;
+    PutFloatLE(one, 1.0f);
+    PutFloatLE(center, 0.0f);
+    PutFloatLE(center, 0.0f);
+    PutExrAttribute(out, "pixelAspectRatio", "float", one);
+    PutExrAttribute(out, "screenWindowCenter", "v2f", center);
+    PutExrAttribute(out, "screenWindowWidth", "float", one);
+    out.push_back(0);                                          // end of header
+
+    // Offset table, then one block per scanline: y, byte count, the B, G and R rows
+    const uint64_t lineBytes = static_cast<uint64_t>(image.width) * 12;
+    const uint64_t tableEnd = out.size() + static_cast<uint64_t>(image.height) * 8;
+    for (int y = 0; y < image.height; ++y) {
+        const uint64_t offset = tableEnd + static_cast<uint64_t>(y) * (8 + lineBytes);
+        Put32LE(out, static_cast<uint32_t>(offset));
+        Put32LE(out, static_cast<uint32_t>(offset >> 32));
+    }
+    out.reserve(out.size() + static_cast<size_t>(image.height) * (8 + lineBytes));
+    for (int y = 0; y < image.height; ++y) {
+        Put32LE(out, static_cast<uint32_t>(y));
+        Put32LE(out, static_cast<uint32_t>(lineBytes));
+        const float* row = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+        for (int c = 2; c >= 0; --c) {
+            for (int x = 0; x < image.width; ++x) PutFloatLE(out, row[x * 3 + c]);
+        }
+    }
+}
+
+void EncodePqPng(const HdrImage& image, float sdrWhiteNits, std::vector<uint8_t>& out)
+{
+    static const PqTable pq;
+    const float scale = sdrWhiteNits / 10000.0f;
+
+    // Filter type 0 rows of 16-bit big-endian RGB, wrapped in stored deflate blocks row by row
+    const size_t rowBytes = 1 + static_cast<size_t>(image.width) * 6;
+    std::vector<uint8_t> raw(rowBytes);
+    std::vector<uint8_t> zlib;
+    StoredDeflate deflate(zlib, rowBytes * image.height);
+    double maxCll = 0, frameAverageSum = 0;
+    for (int y = 0; y < image.height; ++y) {
+        const float* row = image.rgb.data() + static_cast<size_t>(y) * image.width * 3;
+        uint8_t* dst = raw.data();
+        *dst++ = 0;
+        float rowMax = 0;
+        double rowSum = 0;
+        for (int i = 0; i < image.width * 3; i += 3) {
+            const float pixelMax = std::max(row[i], std::max(row[i + 1], row[i + 2]));
+            rowMax = std::max(rowMax, pixelMax);
+            rowSum += std::max(pixelMax, 0.0f);
+            for (int c = 0; c < 3; ++c) {
+                const uint16_t code = pq.Encode(row[i + c] * scale);
+                *dst++ = static_cast<uint8_t>(code >> 8);
+                *dst++ = static_cast<uint8_t>(code);
+            }
+        }
+        maxCll = std::max(maxCll, static_cast<double>(rowMax));
+        frameAverageSum += rowSum;
+        deflate.Write(raw.data(), raw.size());
+    }
+    deflate.Finish();
+
+    out.assign({ 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A });
+    std::vector<uint8_t> ihdr;
+    Put32BE(ihdr, static_cast<uint32_t>(image.width));
+    Put32BE(ihdr, static_cast<uint32_t>(image.height));
+    ihdr.insert(ihdr.end(), { 16, 2, 0, 0, 0 });
+    PutPngChunk(out, "IHDR", ihdr.data(), ihdr.size());
+    const uint8_t cicp[4] = { 9, 16, 0, 1 };
+    PutPngChunk(out, "cICP", cicp, sizeof(cicp));
+    std::vector<uint8_t> clli;
+    const double pixels = std::max(1.0, static_cast<double>(image.width) * image.height);
+    Put32BE(clli, static_cast<uint32_t>(std::min(maxCll * sdrWhiteNits, 10000.0) * 10000));
+    Put32BE(clli, static_cast<uint32_t>(std::min(frameAverageSum / pixels * sdrWhiteNits, 10000.0) * 10000));
+    PutPngChunk(out, "cLLi", clli.data(), clli.size());
+    out.reserve(out.size() + zlib.size() + zlib.size() / (1 << 20) * 12 + 24);
+    for (size_t pos = 0; pos < zlib.size(); pos += 1 << 20) {
+        PutPngChunk(out, "IDAT", zlib.data() + pos, std::min<size_t>(zlib.size() - pos, 1 << 20));
+    }
+    PutPngChunk(out, "IEND", nullptr, 0);
+}
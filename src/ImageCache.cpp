@@ -0,0 +1,128 @@
+// ImageCache.cpp - byte-budgeted LRU image cache
+
+#include "ImageCache.h"
+#include "Metrics.h"
+
+ImageCache::ImageCache(uint64_t budgetBytes)
+    : budget_(budgetBytes),
+      hits_(Metrics::Instance().GetCounter("hdr_cache_hits_total", "Image cache lookups that found the image")),
+      misses_(Metrics::Instance().GetCounter("hdr_cache_misses_total", "Image cache lookups that missed")),
+      evictions_(Metrics::Instance().GetCounter("hdr_cache_evictions_total", "Images evicted to stay within the cache budget")),
+      bytesGauge_(Metrics::Instance().GetGauge("hdr_cache_bytes", "Bytes held by the image cache"))
+{
+}
+
+std::shared_ptr<const ImageData> ImageCache::Get(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        misses_.Add();
+        return nullptr;
+    }
+    hits_.Add();
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return it->second.data;
+}
+
+bool ImageCache::Contains(uint64_t key) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(key) != 0;
+}
+
+void ImageCache::Put(uint64_t key, std::shared_ptr<const ImageData> data)
+{
+    if (!data) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        bytes_ -= it->second.data->bytes.size();
+        it->second.data = std::move(data);
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        bytes_ += it->second.data->bytes.size();
+    } else {
+        // Without budget only pinned images are worth keeping
+        if (budget_ == 0 && pins_.count(key) == 0) return;
+        lru_.push_front(key);
+        bytes_ += data->bytes.size();
+        entries_.emplace(key, Entry{ std::move(data), lru_.begin() });
+    }
+    EvictLocked();
+}
+
+std::vector<uint64_t> ImageCache::EraseIf(const std::function<bool(const ImageData&)>& stale)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint64_t> erased;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (!stale(*it->second.data)) {
+            ++it;
+            continue;
+        }
+        erased.push_back(it->first);
+        bytes_ -= it->second.data->bytes.size();
+        lru_.erase(it->second.lru);
+        it = entries_.erase(it);
+    }
+    bytesGauge_.Set(static_cast<int64_t>(bytes_));
+    return erased;
+}
+
+void ImageCache::Pin(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pins_[key];
+}
+
+void ImageCache::Unpin(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pins_.find(key);
+    if (it == pins_.end()) return;
+    if (--it->second == 0) {
+        pins_.erase(it);
+        EvictLocked();
+    }
+}
+
+void ImageCache::SetBudget(uint64_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budgetBytes;
+    EvictLocked();
+}
+
+uint64_t ImageCache::Budget() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+uint64_t ImageCache::BytesUsed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t ImageCache::Count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void ImageCache::EvictLocked()
+{
+    // Walk from the least recently used end, skipping pinned images
+    auto it = lru_.end();
+    while (bytes_ > budget_ && it != lru_.begin()) {
+        --it;
+        if (pins_.count(*it)) continue;
+        auto entry = entries_.find(*it);
+        bytes_ -= entry->second.data->bytes.size();
+        entries_.erase(entry);
+        it = lru_.erase(it);
+        evictions_.Add();
+    }
+    bytesGauge_.Set(static_cast<int64_t>(bytes_));
+}
@@ -0,0 +1,81 @@
+// ImageCatalog.cpp - image catalog construction
+
+#include "ImageCatalog.h"
+#include "ImageFileUtils.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+ImageCatalog::ImageCatalog(const std::vector<std::wstring>& paths)
+{
+    entries_.reserve(paths.size());
+    for (const std::wstring& path : paths) {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec) size = 0;
+        const auto modified = std::filesystem::last_write_time(path, ec);
+        entries_.push_back({ path, size, ec ? 0 : static_cast<int64_t>(modified.time_since_epoch().count()) });
+    }
+}
+
+ImageCatalog ImageCatalog::FromFolder(const std::wstring& folder, bool includeSubfolders, std::vector<FolderStamp>* folders)
+{
+    ImageCatalog catalog;
+    auto stamp = [folders](const std::filesystem::path& path) {
+        if (!folders) return;
+        std::error_code ec;
+        const auto modified = std::filesystem::last_write_time(path, ec);
+        folders->push_back({ path.wstring(), ec ? 0 : static_cast<int64_t>(modified.time_since_epoch().count()) });
+    };
+    stamp(folder);
+    auto add = [&catalog, &stamp, includeSubfolders](const std::filesystem::directory_entry& entry) {
+        std::error_code ec;
+        if (includeSubfolders && entry.is_directory(ec)) {
+            stamp(entry.path());
+            return;
+        }
+        if (!entry.is_regular_file(ec) || !IsImagePath(entry.path())) return;
+        uint64_t size = entry.file_size(ec);
+        if (ec) size = 0;
+        const auto modified = entry.last_write_time(ec);
+        catalog.entries_.push_back({ entry.path().wstring(), size, ec ? 0 : static_cast<int64_t>(modified.time_since_epoch().count()) });
+    };
+    const auto options = std::filesystem::directory_options::skip_permission_denied;
+    if (includeSubfolders) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(folder, options)) add(entry);
+    } else {
+        for (const auto& entry : std::filesystem::directory_iterator(folder, options)) add(entry);
+    }
+    return catalog;
+}
+
+size_t ImageCatalog::Find(const std::wstring& path) const
+{
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].path == path) return i;
+    }
+    // Same file under a different spelling (case, separators, relative path). Comparing
+    // normalized paths opens no file, unlike std::filesystem::equivalent on every entry.
+    const std::wstring key = NormalizedPathKey(path);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (NormalizedPathKey(entries_[i].path) == key) return i;
+    }
+    return npos;
+}
+
+void ImageCatalog::RotateTo(size_t first)
+{
+    if (first < entries_.size()) std::rotate(entries_.begin(), entries_.begin() + first, entries_.end());
+}
+
+size_t ImageCatalog::MemoryBytes() const
+{
+    // Paths up to the short string capacity live inside the entry
+    const size_t inlineCapacity = std::wstring().capacity();
+    size_t bytes = entries_.capacity() * sizeof(CatalogEntry);
+    for (const CatalogEntry& entry : entries_) {
+        if (entry.path.capacity() > inlineCapacity) bytes += (entry.path.capacity() + 1) * sizeof(wchar_t);
+    }
+    return bytes;
+}
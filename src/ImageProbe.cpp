@@ -0,0 +1,551 @@
+// ImageProbe.cpp - container sniffing and header parsing without pixel decoding
+#include "ImageProbe.h"
+#include "ImageFileUtils.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+namespace {
+
+const size_t kHeadBytes = kProbeHeadBytes;
+// Largest head an AVIF / HEIF / JPEG XL / PNG probe grows to when the headers lie further in
+const uint64_t kMaxHeaderBytes = 16 * 1024 * 1024;
+// Namespace, with its NUL, in front of ISO 21496-1 metadata in a JPEG APP2 segment
+const char kIsoGainMapNamespace[] = "urn:iso:std:iso:ts:21496:-1";
+
+using ReadAt = std::function<bool(uint64_t offset, size_t length, std::vector<uint8_t>& out)>;
+
+uint32_t BigEndian32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint32_t LittleEndian32(const uint8_t* p)
+{
+    return (uint32_t(p[3]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[1]) << 8) | p[0];
+}
+
+ImageContainer Sniff(const uint8_t* d, size_t n)
+{
+    if (n >= 3 && d[0] == 0xFF && d[1] == 0xD8 && d[2] == 0xFF) return ImageContainer::Jpeg;
+    if (n >= 8 && std::memcmp(d, "\x89PNG\r\n\x1a\n", 8) == 0) return ImageContainer::Png;
+    if (n >= 6 && (std::memcmp(d, "GIF87a", 6) == 0 || std::memcmp(d, "GIF89a", 6) == 0)) return ImageContainer::Gif;
+    if (n >= 2 && d[0] == 'B' && d[1] == 'M') return ImageContainer::Bmp;
+    if (n >= 12 && std::memcmp(d, "RIFF", 4) == 0 && std::memcmp(d + 8, "WEBP", 4) == 0) return ImageContainer::WebP;
+    if (n >= 2 && d[0] == 0xFF && d[1] == 0x0A) return ImageContainer::Jxl;                 // bare codestream
+    if (n >= 12 && std::memcmp(d, "\0\0\0\x0CJXL \r\n\x87\n", 12) == 0) return ImageContainer::Jxl;
+    if (n >= 4 && (std::memcmp(d, "II*\0", 4) == 0 || std::memcmp(d, "MM\0*", 4) == 0)) return ImageContainer::Tiff;
+    if (n >= 12 && std::memcmp(d + 4, "ftyp", 4) == 0) {
+        // Major brand first, then the compatible brands
+        const size_t boxSize = std::min<size_t>(BigEndian32(d), n);
+        bool heif = false;
+        for (size_t p = 8; p + 4 <= boxSize; p += (p == 8 ? 8 : 4)) {
+            if (std::memcmp(d + p, "avif", 4) == 0 || std::memcmp(d + p, "avis", 4) == 0) return ImageContainer::Avif;
+            static const char* const kHeifBrands[] = { "mif1", "msf1", "heic", "heix", "heim", "heis", "hevc", "hevx", "mif2" };
+            for (const char* brand : kHeifBrands) heif = heif || std::memcmp(d + p, brand, 4) == 0;
+        }
+        // Other ISOBMFF files (MP4, QuickTime, CR3 raw) are not still images
+        return heif ? ImageContainer::Heif : ImageContainer::Unknown;
+    }
+    // SVG is text: skip a BOM and whitespace, then expect markup
+    size_t p = n >= 3 && std::memcmp(d, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    while (p < n && (d[p] == ' ' || d[p] == '\t' || d[p] == '\r' || d[p] == '\n')) ++p;
+    if (p + 5 <= n && (std::memcmp(d + p, "<?xml", 5) == 0 || std::memcmp(d + p, "<svg", 4) == 0)) return ImageContainer::Svg;
+    return ImageContainer::Unknown;
+}
+
+// Decodes a UTF-16BE string to UTF-8
+std::string Utf8FromUtf16BE(const uint8_t* p, size_t units)
+{
+    std::string out;
+    for (size_t i = 0; i < units; ++i) {
+        uint32_t c = (uint32_t(p[i * 2]) << 8) | p[i * 2 + 1];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < units) {
+            const uint32_t low = (uint32_t(p[i * 2 + 2]) << 8) | p[i * 2 + 3];
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+            ++i;
+        }
+        if (c == 0) break;
+        if (c < 0x80) out += static_cast<char>(c);
+        else if (c < 0x800) { out += static_cast<char>(0xC0 | (c >> 6)); out += static_cast<char>(0x80 | (c & 0x3F)); }
+        else if (c < 0x10000) { out += static_cast<char>(0xE0 | (c >> 12)); out += static_cast<char>(0x80 | ((c >> 6) & 0x3F)); out += static_cast<char>(0x80 | (c & 0x3F)); }
+        else { out += static_cast<char>(0xF0 | (c >> 18)); out += static_cast<char>(0x80 | ((c >> 12) & 0x3F)); out += static_cast<char>(0x80 | ((c >> 6) & 0x3F)); out += static_cast<char>(0x80 | (c & 0x3F)); }
+    }
+    return out;
+}
+
+// The 'desc' tag of an ICC profile: textDescriptionType (v2) or multiLocalizedUnicodeType (v4)
+std::string IccDescription(const uint8_t* icc, size_t iccSize)
+{
+    if (iccSize < 132) return std::string();
+    const uint32_t tags = BigEndian32(icc + 128);
+    for (uint32_t i = 0; i < tags && 132 + (i + 1) * static_cast<size_t>(12) <= iccSize; ++i) {
+        const uint8_t* tag = icc + 132 + i * 12;
+        if (std::memcmp(tag, "desc", 4) != 0) continue;
+        const uint32_t offset = BigEndian32(tag + 4);
+        const uint32_t size = BigEndian32(tag + 8);
+        if (offset + static_cast<size_t>(size) > iccSize || size < 12) return std::string();
+        const uint8_t* t = icc + offset;
+        if (std::memcmp(t, "desc", 4) == 0) {
+            const uint32_t count = std::min<uint32_t>(BigEndian32(t + 8), size - 12);
+            std::string text(reinterpret_cast<const char*>(t + 12), count);
+            text.erase(std::find(text.begin(), text.end(), '\0'), text.end());
+            return text;
+        }
+        if (std::memcmp(t, "mluc", 4) == 0 && size >= 28) {
+            const uint32_t length = BigEndian32(t + 20);
+            const uint32_t stringOffset = BigEndian32(t + 24);
+            if (stringOffset + static_cast<size_t>(length) > size) return std::string();
+            return Utf8FromUtf16BE(t + stringOffset, length / 2);
+        }
+        return std::string();
+    }
+    return std::string();
+}
+
+float ParseFloat(const std::string& s, float fallback)
+{
+    char* end = nullptr;
+    const float v = std::strtof(s.c_str(), &end);
+    return end != s.c_str() ? v : fallback;
+}
+
+void ReadHdrgm(const std::string& xmp, ImageProbe& probe)
+{
+    // The primary image XMP only carries hdrgm:Version; GainMapMax is required in the gain map's
+    std::string value;
+    if (!XmpProperty(xmp, "hdrgm:GainMapMax", value)) return;
+    GainMapMetadata& m = probe.hdrgm;
+    m = GainMapMetadata();
+    probe.hasHdrgm = true;
+    XmpProperty(xmp, "hdrgm:Version", m.version);
+    if (XmpProperty(xmp, "hdrgm:GainMapMin", value)) m.gainMapMin = ParseFloat(value, m.gainMapMin);
+    if (XmpProperty(xmp, "hdrgm:GainMapMax", value)) m.gainMapMax = ParseFloat(value, m.gainMapMax);
+    if (XmpProperty(xmp, "hdrgm:Gamma", value)) m.gamma = ParseFloat(value, m.gamma);
+    if (XmpProperty(xmp, "hdrgm:OffsetSDR", value)) m.offsetSdr = ParseFloat(value, m.offsetSdr);
+    if (XmpProperty(xmp, "hdrgm:OffsetHDR", value)) m.offsetHdr = ParseFloat(value, m.offsetHdr);
+    if (XmpProperty(xmp, "hdrgm:HDRCapacityMin", value)) m.hdrCapacityMin = ParseFloat(value, m.hdrCapacityMin);
+    if (XmpProperty(xmp, "hdrgm:HDRCapacityMax", value)) m.hdrCapacityMax = ParseFloat(value, m.hdrCapacityMax);
+    if (XmpProperty(xmp, "hdrgm:BaseRenditionIsHDR", value)) m.baseRenditionIsHdr = value == "True" || value == "true";
+}
+
+// Gain map metadata segments in the headers of an MPF secondary image
+void ReadGainMapHeaders(const uint8_t* secondary, size_t size, ImageProbe& probe)
+{
+    std::vector<JpegSegment> segments;
+    ReadJpegSegments(secondary, size, segments);
+    for (const JpegSegment& segment : segments) {
+        if (!IsGainMapMetadataSegment(secondary, segment)) continue;
+        probe.gainMap = true;
+        if (segment.marker == 0xE2) {
+            probe.isoGainMap = true;
+            // hdrgm XMP, when both are present, is read either way and wins
+            const size_t skip = sizeof(kIsoGainMapNamespace);
+            if (!probe.hasHdrgm && segment.PayloadSize() > skip &&
+                ParseIsoGainMapMetadata(secondary + segment.PayloadOffset() + skip, segment.PayloadSize() - skip, probe.hdrgm)) {
+                probe.hasHdrgm = true;
+            }
+        } else {
+            ReadHdrgm(XmpPacket(secondary, segment), probe);
+        }
+    }
+}
+
+void ProbeJpeg(std::vector<uint8_t>& head, uint64_t fileSize, const ReadAt& readAt, ImageProbe& probe)
+{
+    std::vector<JpegSegment> segments;
+    if (!ReadJpegSegments(head.data(), head.size(), segments) && head.size() < fileSize) {
+        // Headers larger than the head read: fall back to the whole file
+        if (!readAt(0, static_cast<size_t>(fileSize), head)) { probe.problem = "read error"; return; }
+        ReadJpegSegments(head.data(), head.size(), segments);
+    }
+    JpegInfo info;
+    if (!ReadJpegInfo(head.data(), head.size(), info) || info.width == 0 || info.height == 0) {
+        probe.problem = "no valid frame header";
+        return;
+    }
+    probe.width = info.width;
+    probe.height = info.height;
+    probe.components = info.components;
+    probe.bitDepth = info.precision;
+    probe.progressive = info.progressive;
+
+    // ICC profiles are split over APP2 chunks numbered 1..n
+    std::vector<std::pair<int, std::vector<uint8_t>>> chunks;
+    for (const JpegSegment& segment : segments) {
+        const uint8_t* payload = head.data() + segment.PayloadOffset();
+        if (segment.marker == 0xE2 && segment.PayloadSize() > 14 && std::memcmp(payload, "ICC_PROFILE\0", 12) == 0) {
+            chunks.emplace_back(payload[12], std::vector<uint8_t>(payload + 14, payload + segment.PayloadSize()));
+        } else if (IsXmpSegment(head.data(), segment)) {
+            ReadHdrgm(XmpPacket(head.data(), segment), probe);
+        }
+    }
+    if (!chunks.empty()) {
+        std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<uint8_t> icc;
+        for (const auto& chunk : chunks) icc.insert(icc.end(), chunk.second.begin(), chunk.second.end());
+        probe.iccDescription = IccDescription(icc.data(), icc.size());
+    }
+
+    std::vector<MpfImage> images;
+    if (ReadMpfImages(head.data(), head.size(), images, static_cast<size_t>(fileSize))) {
+        probe.mpfImages = static_cast<int>(images.size());
+        std::vector<uint8_t> secondary;
+        for (size_t i = 1; i < images.size() && !probe.gainMap; ++i) {
+            if (readAt(images[i].offset, std::min(images[i].size, kGainMapHeadBytes), secondary)) ReadGainMapHeaders(secondary.data(), secondary.size(), probe);
+        }
+    }
+
+    std::vector<uint8_t> tail;
+    if (fileSize >= 2 && readAt(fileSize - 2, 2, tail) && !(tail[0] == 0xFF && tail[1] == 0xD9)) {
+        probe.problem = "no EOI marker, file may be truncated";
+    }
+    probe.renderability = probe.gainMap ? Renderability::Hdr : Renderability::Displays;
+}
+
+void ProbeDimensions(const uint8_t* d, size_t n, ImageProbe& probe)
+{
+    switch (probe.container) {
+    case ImageContainer::Gif:
+        if (n >= 10) {
+            probe.width = d[6] | (d[7] << 8);
+            probe.height = d[8] | (d[9] << 8);
+        }
+        break;
+    case ImageContainer::Bmp:
+        if (n >= 26) {
+            probe.width = static_cast<int>(LittleEndian32(d + 18));
+            probe.height = std::abs(static_cast<int32_t>(LittleEndian32(d + 22)));
+        }
+        break;
+    case ImageContainer::WebP:
+        if (n >= 30 && std::memcmp(d + 12, "VP8 ", 4) == 0) {
+            probe.width = (d[26] | (d[27] << 8)) & 0x3FFF;
+            probe.height = (d[28] | (d[29] << 8)) & 0x3FFF;
+        } else if (n >= 25 && std::memcmp(d + 12, "VP8L", 4) == 0) {
+            const uint32_t bits = LittleEndian32(d + 21);
+            probe.width = static_cast<int>((bits & 0x3FFF) + 1);
+            probe.height = static_cast<int>(((bits >> 14) & 0x3FFF) + 1);
+        } else if (n >= 30 && std::memcmp(d + 12, "VP8X", 4) == 0) {
+            probe.width = static_cast<int>((d[24] | (d[25] << 8) | (d[26] << 16)) + 1);
+            probe.height = static_cast<int>((d[27] | (d[28] << 8) | (d[29] << 16)) + 1);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Gain map metadata that lies outside the head (AVIF tmap item data in mdat) takes one more read
+void ReadContainerGainMap(const std::vector<uint8_t>& head, const ContainerInfo& info, size_t skip, const ReadAt& readAt, ImageProbe& probe)
+{
+    const FileSpan& span = info.gainMapMetadata;
+    if (span.size <= skip || span.size > 4096) return;
+    const uint8_t* data = nullptr;
+    std::vector<uint8_t> read;
+    if (span.Within(head.size())) {
+        data = head.data() + span.offset;
+    } else {
+        if (!readAt(span.offset, static_cast<size_t>(span.size), read) || read.size() != span.size) return;
+        data = read.data();
+    }
+    probe.hasHdrgm = ParseIsoGainMapMetadata(data + skip, static_cast<size_t>(span.size - skip), probe.hdrgm);
+}
+
+// A jhgm box after the codestream: walks the remaining top-level box headers, a short read each
+void FindJxlGainMap(uint64_t offset, uint64_t fileSize, const ReadAt& readAt, ContainerInfo& info)
+{
+    std::vector<uint8_t> header;
+    for (int boxes = 0; boxes < 64 && offset < fileSize; ++boxes) {
+        uint32_t type = 0;
+        FileSpan payload;
+        if (!readAt(offset, 19, header) || !ReadBoxHeader(header.data(), header.size(), offset, fileSize, type, payload)) return;
+        if (type == BoxType("jhgm")) {
+            info.gainMap = true;
+            const size_t inHeader = static_cast<size_t>(payload.offset - offset);
+            if (header.size() >= inHeader + 3) {
+                const uint64_t size = (uint64_t(header[inHeader + 1]) << 8) | header[inHeader + 2];
+                if (3 + size <= payload.size) info.gainMapMetadata = { payload.offset + 3, size };
+            }
+            return;
+        }
+        offset = payload.offset + payload.size;
+    }
+}
+
+// AVIF, HEIF, JPEG XL and PNG: size, color signaling and gain map from the container headers
+void ProbeContainer(std::vector<uint8_t>& head, uint64_t fileSize, const ReadAt& readAt, ImageProbe& probe)
+{
+    ContainerInfo info;
+    const auto parse = [&] {
+        switch (probe.container) {
+        case ImageContainer::Png: return ParsePngInfo(head.data(), head.size(), info);
+        case ImageContainer::Jxl: return ParseJxlInfo(head.data(), head.size(), fileSize, info);
+        default: return ParseIsobmffInfo(head.data(), head.size(), fileSize, info);
+        }
+    };
+    bool parsed = parse();
+    if (info.needBytes > head.size() && head.size() < fileSize) {
+        // Headers past the head: read on, within reason, and parse again
+        const uint64_t need = std::min<uint64_t>({ info.needBytes, fileSize, kMaxHeaderBytes });
+        if (need > head.size() && readAt(0, static_cast<size_t>(need), head)) parsed = parse();
+    }
+    if (!parsed) {
+        probe.problem = info.needBytes > head.size() ? "headers too far into the file" : "invalid header";
+        return;
+    }
+    if (probe.container == ImageContainer::Jxl && !info.gainMap && info.unreadBoxOffset != 0) {
+        FindJxlGainMap(info.unreadBoxOffset, fileSize, readAt, info);
+    }
+
+    probe.width = info.width;
+    probe.height = info.height;
+    probe.components = info.components;
+    probe.bitDepth = info.bitDepth;
+    probe.animated = info.animated;
+    probe.color = info.color;
+    if (!info.iccName.empty()) probe.iccDescription = info.iccName;
+    else if (!info.icc.Empty() && info.icc.Within(head.size())) {
+        probe.iccDescription = IccDescription(head.data() + info.icc.offset, static_cast<size_t>(info.icc.size));
+    }
+    if (info.gainMap) {
+        probe.gainMap = true;
+        probe.isoGainMap = true;
+        // The tmap item data starts with its own version byte
+        ReadContainerGainMap(head, info, probe.container == ImageContainer::Jxl ? 0 : 1, readAt, probe);
+    }
+    if (probe.container == ImageContainer::Heif || probe.container == ImageContainer::Jxl) {
+        probe.renderability = Renderability::Unsupported;
+        probe.problem = std::string(ImageContainerName(probe.container)) + " is not supported by WebView2";
+        return;
+    }
+    probe.renderability = probe.gainMap || (probe.color.present && IsHdrTransfer(probe.color.transfer)) ? Renderability::Hdr : Renderability::Displays;
+}
+
+void Probe(std::vector<uint8_t>& head, uint64_t fileSize, const ReadAt& readAt, ImageProbe& probe)
+{
+    probe = ImageProbe();
+    probe.fileSize = fileSize;
+    if (fileSize == 0) {
+        probe.problem = "empty file";
+        return;
+    }
+    probe.container = Sniff(head.data(), head.size());
+    switch (probe.container) {
+    case ImageContainer::Unknown:
+        probe.renderability = Renderability::Unsupported;
+        probe.problem = "unrecognized format";
+        return;
+    case ImageContainer::Tiff:
+        probe.renderability = Renderability::Unsupported;
+        probe.problem = std::string(ImageContainerName(probe.container)) + " is not supported by WebView2";
+        return;
+    case ImageContainer::Jpeg:
+        ProbeJpeg(head, fileSize, readAt, probe);
+        return;
+    case ImageContainer::Png:
+    case ImageContainer::Avif:
+    case ImageContainer::Heif:
+    case ImageContainer::Jxl:
+        ProbeContainer(head, fileSize, readAt, probe);
+        return;
+    case ImageContainer::Svg:
+        probe.renderability = Renderability::Displays;
+        return;
+    default:
+        ProbeDimensions(head.data(), head.size(), probe);
+        if (probe.width <= 0 || probe.height <= 0) {
+            probe.problem = "invalid header";
+            return;
+        }
+        probe.renderability = Renderability::Displays;
+        return;
+    }
+}
+
+} // namespace
+
+const char* ImageContainerName(ImageContainer container)
+{
+    switch (container) {
+    case ImageContainer::Jpeg: return "jpeg";
+    case ImageContainer::Png: return "png";
+    case ImageContainer::Gif: return "gif";
+    case ImageContainer::Bmp: return "bmp";
+    case ImageContainer::WebP: return "webp";
+    case ImageContainer::Avif: return "avif";
+    case ImageContainer::Heif: return "heif";
+    case ImageContainer::Jxl: return "jxl";
+    case ImageContainer::Tiff: return "tiff";
+    case ImageContainer::Svg: return "svg";
+    case ImageContainer::Unknown: break;
+    }
+    return "unknown";
+}
+
+const char* RenderabilityName(Renderability renderability)
+{
+    switch (renderability) {
+    case Renderability::Hdr: return "hdr";
+    case Renderability::Displays: return "displays";
+    case Renderability::Unsupported: return "unsupported";
+    case Renderability::Broken: return "broken";
+    }
+    return "broken";
+}
+
+// WebView2 sniffs image content, so a wrong extension still displays, but it is worth a note
+static void CheckExtension(const std::filesystem::path& path, ImageProbe& probe)
+{
+    const std::wstring expected = ContentTypeForPath(path);
+    const std::string actual = std::string("image/") + ImageContainerName(probe.container);
+    if (probe.container != ImageContainer::Unknown && probe.container != ImageContainer::Svg && probe.problem.empty() &&
+        std::wstring(actual.begin(), actual.end()) != expected) {
+        probe.problem = "content is " + std::string(ImageContainerName(probe.container)) + " but the extension says otherwise";
+    }
+}
+
+bool ProbeImageFile(const std::filesystem::path& path, ImageProbe& probe)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) {
+        probe = ImageProbe();
+        probe.problem = "cannot open file";
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    if (size < 0) {
+        probe = ImageProbe();
+        probe.problem = "cannot read file";
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(size);
+    const ReadAt readAt = [&in, fileSize](uint64_t offset, size_t length, std::vector<uint8_t>& out) {
+        if (offset >= fileSize) return false;
+        length = static_cast<size_t>(std::min<uint64_t>(length, fileSize - offset));
+        out.resize(length);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(length)));
+    };
+    std::vector<uint8_t> head;
+    if (fileSize > 0 && !readAt(0, kHeadBytes, head)) {
+        probe = ImageProbe();
+        probe.problem = "cannot read file";
+        return false;
+    }
+    Probe(head, fileSize, readAt, probe);
+    CheckExtension(path, probe);
+    return true;
+}
+
+void ProbeImageHead(const std::filesystem::path& path, uint64_t fileSize, std::vector<uint8_t> head, const std::vector<ProbeRange>& extra,
+                    ImageProbe& probe)
+{
+    std::ifstream in;
+    const ReadAt readAt = [&](uint64_t offset, size_t length, std::vector<uint8_t>& out) {
+        if (offset >= fileSize) return false;
+        length = static_cast<size_t>(std::min<uint64_t>(length, fileSize - offset));
+        // The head is looked up on every call because the whole-file fallback replaces it
+        if (offset + length <= head.size()) {
+            if (&out == &head) head.resize(static_cast<size_t>(offset + length));
+            else out.assign(head.begin() + static_cast<ptrdiff_t>(offset), head.begin() + static_cast<ptrdiff_t>(offset + length));
+            return true;
+        }
+        for (const ProbeRange& range : extra) {
+            if (offset >= range.offset && offset + length <= range.offset + range.size) {
+                const uint8_t* p = range.data + (offset - range.offset);
+                out.assign(p, p + length);
+                return true;
+            }
+        }
+        if (!in.is_open()) in.open(path, std::ios::in | std::ios::binary);
+        if (!in) return false;
+        out.resize(length);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(length)));
+    };
+    if (head.size() > fileSize) head.resize(static_cast<size_t>(fileSize));
+    Probe(head, fileSize, readAt, probe);
+    CheckExtension(path, probe);
+}
+
+void ProbeImageData(const uint8_t* data, size_t size, ImageProbe& probe)
+{
+    const ReadAt readAt = [data, size](uint64_t offset, size_t length, std::vector<uint8_t>& out) {
+        if (offset >= size) return false;
+        length = std::min<size_t>(length, size - static_cast<size_t>(offset));
+        out.assign(data + offset, data + offset + length);
+        return true;
+    };
+    std::vector<uint8_t> head(data, data + std::min(size, kHeadBytes));
+    Probe(head, size, readAt, probe);
+}
+
+bool ParseIsoGainMapMetadata(const uint8_t* data, size_t size, GainMapMetadata& metadata)
+{
+    // minimum_version u16, writer_version u16, flags (is_multichannel, use_base_colour_space),
+    // base and alternate HDR headroom, then per channel gain map min, max, gamma, base offset and
+    // alternate offset; every value a 32-bit numerator (signed where it can be negative) over a
+    // 32-bit denominator
+    if (size < 5 + 16 + 40 || (static_cast<uint32_t>(data[0] << 8) | data[1]) != 0) return false;
+    const uint8_t* p = data + 5;
+    const auto fraction = [&p](bool isSigned) {
+        const uint32_t n = BigEndian32(p), d = BigEndian32(p + 4);
+        p += 8;
+        if (d == 0) return 0.0f;
+        return (isSigned ? static_cast<float>(static_cast<int32_t>(n)) : static_cast<float>(n)) / static_cast<float>(d);
+    };
+    const float baseHeadroom = fraction(false);
+    const float alternateHeadroom = fraction(false);
+    GainMapMetadata m;
+    m.version = "1.0";
+    m.gainMapMin = fraction(true);
+    m.gainMapMax = fraction(true);
+    m.gamma = fraction(false);
+    const float baseOffset = fraction(true);
+    const float alternateOffset = fraction(true);
+    m.baseRenditionIsHdr = alternateHeadroom < baseHeadroom;
+    m.hdrCapacityMin = std::min(baseHeadroom, alternateHeadroom);
+    m.hdrCapacityMax = std::max(baseHeadroom, alternateHeadroom);
+    m.offsetSdr = m.baseRenditionIsHdr ? alternateOffset : baseOffset;
+    m.offsetHdr = m.baseRenditionIsHdr ? baseOffset : alternateOffset;
+    if (m.gamma <= 0) return false;
+    metadata = m;
+    return true;
+}
+
+bool ReadGainMapImageMetadata(const uint8_t* data, size_t size, GainMapMetadata& metadata)
+{
+    ImageProbe probe;
+    ReadGainMapHeaders(data, size, probe);
+    if (!probe.hasHdrgm) return false;
+    metadata = probe.hdrgm;
+    return true;
+}
+
+float GainMapWeight(const GainMapMetadata& metadata, float headroom)
+{
+    float weight;
+    if (metadata.hdrCapacityMax <= metadata.hdrCapacityMin) weight = headroom >= metadata.hdrCapacityMax ? 1.0f : 0.0f;
+    else weight = std::clamp((headroom - metadata.hdrCapacityMin) / (metadata.hdrCapacityMax - metadata.hdrCapacityMin), 0.0f, 1.0f);
+    return metadata.baseRenditionIsHdr ? 1.0f - weight : weight;
+}
+
+float ProbeHeadroom(const ImageProbe& probe)
+{
+    if (probe.hasHdrgm) return probe.hdrgm.hdrCapacityMax;
+    if (!probe.color.present || !IsHdrTransfer(probe.color.transfer)) return 0.0f;
+    // Without a content light level, PQ is assumed mastered to 1000 cd/m2, the HLG nominal peak
+    const float peak = probe.color.maxCll > 0 ? static_cast<float>(probe.color.maxCll) : 1000.0f;
+    return std::max(0.0f, std::log2(peak / 203.0f));
+}
@@ -0,0 +1,473 @@
+// ImageResize.cpp - separable area-average resampling of 8-bit planes and filtered resampling
+// of linear float images
+#include "ImageResize.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HDR_RESAMPLE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define HDR_TARGET_AVX2
+#define HDR_TARGET_AVX512
+#else
+#define HDR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define HDR_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+#endif
+
+namespace {
+
+// Source span and weights of one destination sample along one axis
+struct Taps {
+    int first = 0;
+    std::vector<float> weights;
+};
+
+std::vector<Taps> AreaTaps(int srcSize, int dstSize)
+{
+    std::vector<Taps> taps(static_cast<size_t>(dstSize));
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    for (int i = 0; i < dstSize; ++i) {
+        const double begin = i * scale;
+        const double end = std::min<double>((i + 1) * scale, srcSize);
+        Taps& t = taps[static_cast<size_t>(i)];
+        t.first = std::min(static_cast<int>(begin), srcSize - 1);
+        const int last = std::max(t.first, std::min(static_cast<int>(end - 1e-9), srcSize - 1));
+        double total = 0;
+        for (int s = t.first; s <= last; ++s) {
+            const double coverage = std::min<double>(s + 1, end) - std::max<double>(s, begin);
+            t.weights.push_back(static_cast<float>(std::max(coverage, 0.0)));
+            total += std::max(coverage, 0.0);
+        }
+        if (total <= 0) { t.weights.assign(1, 1.0f); continue; }
+        for (float& w : t.weights) w = static_cast<float>(w / total);
+    }
+    return taps;
+}
+
+// Filter weights along one axis: every output sample reads `taps` consecutive source samples
+// from first[i], zero padded where the filter is narrower, so the kernels have no edge cases
+struct FilterTable {
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<float> weights;          // taps per output sample
+};
+
+double FilterSupport(ResampleFilter filter)
+{
+    return filter == ResampleFilter::Lanczos3 ? 3.0 : filter == ResampleFilter::Mitchell ? 2.0 : 1.0;
+}
+
+double FilterValue(ResampleFilter filter, double x)
+{
+    x = std::fabs(x);
+    switch (filter) {
+    case ResampleFilter::Lanczos3: {
+        if (x >= 3.0) return 0.0;
+        if (x < 1e-9) return 1.0;
+        const double pi = 3.14159265358979323846;
+        return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+    }
+    case ResampleFilter::Mitchell:
+        if (x < 1.0) return (7.0 * x * x * x - 12.0 * x * x + 16.0 / 3.0) / 6.0;
+        if (x < 2.0) return (-7.0 / 3.0 * x * x * x + 12.0 * x * x - 20.0 * x + 32.0 / 3.0) / 6.0;
+        return 0.0;
+    case ResampleFilter::Bilinear:
+        return std::max(0.0, 1.0 - x);
+    }
+    return 0.0;
+}
+
+FilterTable BuildFilter(ResampleFilter filter, int srcSize, int dstSize)
+{
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    const double stretch = std::max(1.0, scale);         // downscaling widens the filter
+    const double support = FilterSupport(filter) * stretch;
+    FilterTable table;
+    table.taps = std::min(srcSize, static_cast<int>(std::ceil(support)) * 2 + 1);
+    table.first.resize(static_cast<size_t>(dstSize));
+    table.weights.assign(static_cast<size_t>(dstSize) * table.taps, 0.0f);
+    std::vector<double> w(static_cast<size_t>(table.taps));
+    for (int o = 0; o < dstSize; ++o) {
+        const double center = (o + 0.5) * scale;
+        const int begin = std::max(0, static_cast<int>(std::floor(center - support + 0.5)));
+        const int end = std::min(srcSize, static_cast<int>(std::floor(center + support + 0.5)));
+        const int first = std::clamp(begin, 0, srcSize - table.taps);
+        std::fill(w.begin(), w.end(), 0.0);
+        double total = 0;
+        for (int s = begin; s < std::min(end, first + table.taps); ++s) {
+            const double v = FilterValue(filter, (s + 0.5 - center) / stretch);
+            w[static_cast<size_t>(s - first)] = v;
+            total += v;
+        }
+        if (total == 0) {
+            // Narrower than a sample (tiny outputs of bilinear): nearest sample
+            const int nearest = std::clamp(static_cast<int>(center), first, first + table.taps - 1);
+            w[static_cast<size_t>(nearest - first)] = total = 1.0;
+        }
+        table.first[static_cast<size_t>(o)] = first;
+        for (int k = 0; k < table.taps; ++k) table.weights[static_cast<size_t>(o) * table.taps + k] = static_cast<float>(w[static_cast<size_t>(k)] / total);
+    }
+    return table;
+}
+
+// Horizontal pass: one RGB row to `outWidth` RGB pixels. The SIMD kernels read and write four
+// floats per pixel, so the input needs one float after its last pixel and so does the output.
+using HorizontalKernel = void (*)(const float* in, const FilterTable& columns, int outWidth, float* out);
+// Vertical pass: out[i] = sum of weights[k] * rows[k][i], clipped at zero
+using VerticalKernel = void (*)(const float* const* rows, const float* weights, int taps, size_t count, float* out);
+using UpsampleExp2Kernel = void (*)(const LinearTaps& taps, const float* in, float* out);
+
+void HorizontalScalar(const float* in, const FilterTable& columns, int outWidth, float* out)
+{
+    const int taps = columns.taps;
+    for (int x = 0; x < outWidth; ++x) {
+        const float* w = columns.weights.data() + static_cast<size_t>(x) * taps;
+        const float* p = in + static_cast<size_t>(columns.first[static_cast<size_t>(x)]) * 3;
+        float r = 0, g = 0, b = 0;
+        for (int k = 0; k < taps; ++k, p += 3) {
+            r += w[k] * p[0];
+            g += w[k] * p[1];
+            b += w[k] * p[2];
+        }
+        out[x * 3] = r;
+        out[x * 3 + 1] = g;
+        out[x * 3 + 2] = b;
+    }
+}
+
+void VerticalScalar(const float* const* rows, const float* weights, int taps, size_t count, float* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float sum = 0;
+        for (int k = 0; k < taps; ++k) sum += weights[k] * rows[k][i];
+        out[i] = std::max(sum, 0.0f);
+    }
+}
+
+void UpsampleExp2Scalar(const LinearTaps& taps, const float* in, float* out)
+{
+    const size_t count = taps.f.size();
+    for (size_t o = 0; o < count; ++o) {
+        const float a = in[taps.i0[o]], b = in[taps.i1[o]];
+        out[o] = std::exp2(a + (b - a) * taps.f[o]);
+    }
+}
+
+#ifdef HDR_RESAMPLE_X86
+// A pixel is a four-float vector (RGB plus the next pixel's R, which is ignored), times a
+// broadcast weight: one FMA per tap instead of three multiply-adds
+HDR_TARGET_AVX2 void HorizontalAvx2(const float* in, const FilterTable& columns, int outWidth, float* out)
+{
+    const int taps = columns.taps;
+    for (int x = 0; x < outWidth; ++x) {
+        const float* w = columns.weights.data() + static_cast<size_t>(x) * taps;
+        const float* p = in + static_cast<size_t>(columns.first[static_cast<size_t>(x)]) * 3;
+        __m128 a = _mm_setzero_ps();
+        __m128 b = _mm_setzero_ps();
+        int k = 0;
+        for (; k + 1 < taps; k += 2, p += 6) {
+            a = _mm_fmadd_ps(_mm_broadcast_ss(w + k), _mm_loadu_ps(p), a);
+            b = _mm_fmadd_ps(_mm_broadcast_ss(w + k + 1), _mm_loadu_ps(p + 3), b);
+        }
+        if (k < taps) a = _mm_fmadd_ps(_mm_broadcast_ss(w + k), _mm_loadu_ps(p), a);
+        _mm_storeu_ps(out + static_cast<size_t>(x) * 3, _mm_add_ps(a, b));
+    }
+}
+
+HDR_TARGET_AVX2 void VerticalAvx2(const float* const* rows, const float* weights, int taps, size_t count, float* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = zero, b = zero;
+        for (int k = 0; k < taps; ++k) {
+            const __m256 w = _mm256_broadcast_ss(weights + k);
+            a = _mm256_fmadd_ps(w, _mm256_loadu_ps(rows[k] + i), a);
+            b = _mm256_fmadd_ps(w, _mm256_loadu_ps(rows[k] + i + 8), b);
+        }
+        _mm256_storeu_ps(out + i, _mm256_max_ps(a, zero));
+        _mm256_storeu_ps(out + i + 8, _mm256_max_ps(b, zero));
+    }
+    for (; i < count; ++i) {
+        float sum = 0;
+        for (int k = 0; k < taps; ++k) sum += weights[k] * rows[k][i];
+        out[i] = std::max(sum, 0.0f);
+    }
+}
+
+HDR_TARGET_AVX512 void VerticalAvx512(const float* const* rows, const float* weights, int taps, size_t count, float* out)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512 a = zero, b = zero;
+        for (int k = 0; k < taps; ++k) {
+            const __m512 w = _mm512_set1_ps(weights[k]);
+            a = _mm512_fmadd_ps(w, _mm512_loadu_ps(rows[k] + i), a);
+            b = _mm512_fmadd_ps(w, _mm512_loadu_ps(rows[k] + i + 16), b);
+        }
+        // maskz: GCC 12 warns about the undefined source operand of the unmasked max
+        _mm512_storeu_ps(out + i, _mm512_maskz_max_ps(0xFFFF, a, zero));
+        _mm512_storeu_ps(out + i + 16, _mm512_maskz_max_ps(0xFFFF, b, zero));
+    }
+    for (; i < count; ++i) {
+        float sum = 0;
+        for (int k = 0; k < taps; ++k) sum += weights[k] * rows[k][i];
+        out[i] = std::max(sum, 0.0f);
+    }
+}
+
+// 2^x as 2^round(x) from the exponent bits times a degree 6 polynomial for 2^r, |r| <= 1/2
+// (the Cephes exp2f coefficients)
+HDR_TARGET_AVX2 inline __m256 Exp2Avx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(126.0f));
+    const __m256 n = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256 r = _mm256_sub_ps(x, n);
+    __m256 p = _mm256_set1_ps(1.535336188319500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.339887440266574e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(9.618437357674640e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.550332471162809e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(2.402264791363012e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(6.931472028550421e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f));
+    const __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+HDR_TARGET_AVX2 void UpsampleExp2Avx2(const LinearTaps& taps, const float* in, float* out)
+{
+    const size_t count = taps.f.size();
+    size_t o = 0;
+    for (; o + 8 <= count; o += 8) {
+        const __m256 a = _mm256_i32gather_ps(in, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.i0.data() + o)), 4);
+        const __m256 b = _mm256_i32gather_ps(in, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.i1.data() + o)), 4);
+        const __m256 f = _mm256_loadu_ps(taps.f.data() + o);
+        _mm256_storeu_ps(out + o, Exp2Avx2(_mm256_fmadd_ps(_mm256_sub_ps(b, a), f, a)));
+    }
+    for (; o < count; ++o) {
+        const float a = in[taps.i0[o]], b = in[taps.i1[o]];
+        out[o] = std::exp2(a + (b - a) * taps.f[o]);
+    }
+}
+#endif
+
+struct ResampleKernels {
+    const char* name = "scalar";
+    HorizontalKernel horizontal = HorizontalScalar;
+    VerticalKernel vertical = VerticalScalar;
+    UpsampleExp2Kernel upsampleExp2 = UpsampleExp2Scalar;
+};
+
+const ResampleKernels& DetectKernels()
+{
+    static const ResampleKernels kernels = [] {
+        ResampleKernels k;
+#ifdef HDR_RESAMPLE_X86
+        bool avx2 = false, avx512 = false;
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0, fma = (info[2] & (1 << 12)) != 0;
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        __cpuidex(info, 7, 0);
+        avx2 = fma && (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+        avx512 = avx2 && (info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6;
+#else
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        avx512 = avx2 && __builtin_cpu_supports("avx512f");
+#endif
+        if (avx2) {
+            k.name = "avx2";
+            k.horizontal = HorizontalAvx2;
+            k.vertical = VerticalAvx2;
+            k.upsampleExp2 = UpsampleExp2Avx2;
+        }
+        if (avx512) {
+            k.name = "avx512";
+            k.vertical = VerticalAvx512;
+        }
+#endif
+        return k;
+    }();
+    return kernels;
+}
+
+// Output rows [y0, y1). Source rows are filtered horizontally once each into a ring of as many
+// rows as the vertical filter has taps, which then makes every output row in one pass.
+void ResampleStrip(const HdrImage& src, const FilterTable& columns, const FilterTable& rows, const ResampleKernels& kernels, int y0, int y1,
+                   HdrImage& dst)
+{
+    const size_t rowFloats = static_cast<size_t>(dst.width) * 3;
+    const size_t stride = (rowFloats + 1 + 15) & ~static_cast<size_t>(15);
+    const int taps = rows.taps;
+    std::vector<float> ring(stride * taps);
+    std::vector<int> held(static_cast<size_t>(taps), -1);
+    std::vector<float> lastRow;          // the image's last row, with room for a four-float read
+    std::vector<const float*> window(static_cast<size_t>(taps));
+    for (int y = y0; y < y1; ++y) {
+        const int first = rows.first[static_cast<size_t>(y)];
+        for (int k = 0; k < taps; ++k) {
+            const int sy = first + k;
+            float* slot = ring.data() + static_cast<size_t>(sy % taps) * stride;
+            if (held[static_cast<size_t>(sy % taps)] != sy) {
+                const float* in = src.rgb.data() + static_cast<size_t>(sy) * src.width * 3;
+                if (sy == src.height - 1) {
+                    lastRow.assign(in, in + static_cast<size_t>(src.width) * 3);
+                    lastRow.push_back(0.0f);
+                    in = lastRow.data();
+                }
+                kernels.horizontal(in, columns, dst.width, slot);
+                held[static_cast<size_t>(sy % taps)] = sy;
+            }
+            window[static_cast<size_t>(k)] = slot;
+        }
+        kernels.vertical(window.data(), rows.weights.data() + static_cast<size_t>(y) * taps, taps, rowFloats,
+                         dst.rgb.data() + static_cast<size_t>(y) * rowFloats);
+    }
+}
+
+} // namespace
+
+void FitWithin(int width, int height, int maxWidth, int maxHeight, int& outWidth, int& outHeight)
+{
+    double scale = 1.0;
+    if (maxWidth > 0 && width > maxWidth) scale = std::min(scale, static_cast<double>(maxWidth) / width);
+    if (maxHeight > 0 && height > maxHeight) scale = std::min(scale, static_cast<double>(maxHeight) / height);
+    outWidth = std::max(1, static_cast<int>(width * scale + 0.5));
+    outHeight = std::max(1, static_cast<int>(height * scale + 0.5));
+    if (maxWidth > 0) outWidth = std::min(outWidth, maxWidth);
+    if (maxHeight > 0) outHeight = std::min(outHeight, maxHeight);
+}
+
+void ResizePlaneArea(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight)
+{
+    const std::vector<Taps> columns = AreaTaps(srcWidth, dstWidth);
+    const std::vector<Taps> rows = AreaTaps(srcHeight, dstHeight);
+
+    // Each destination row accumulates the horizontally resampled source rows it covers. Only the
+    // row shared by two destination rows is kept, so memory stays at two rows per plane.
+    std::vector<float> row(static_cast<size_t>(dstWidth)), shared(static_cast<size_t>(dstWidth));
+    std::vector<float> accumulator(static_cast<size_t>(dstWidth));
+    int sharedRow = -1;
+    auto resampleRow = [&](int y, std::vector<float>& out) {
+        const uint8_t* in = src + static_cast<size_t>(y) * srcWidth;
+        for (int x = 0; x < dstWidth; ++x) {
+            const Taps& t = columns[static_cast<size_t>(x)];
+            float sum = 0;
+            for (size_t k = 0; k < t.weights.size(); ++k) sum += in[t.first + static_cast<int>(k)] * t.weights[k];
+            out[static_cast<size_t>(x)] = sum;
+        }
+    };
+    for (int y = 0; y < dstHeight; ++y) {
+        const Taps& t = rows[static_cast<size_t>(y)];
+        std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+        for (size_t k = 0; k < t.weights.size(); ++k) {
+            const int sy = t.first + static_cast<int>(k);
+            const std::vector<float>* in = &shared;
+            if (sy != sharedRow) {
+                const bool last = k + 1 == t.weights.size();
+                resampleRow(sy, last ? shared : row);
+                if (last) sharedRow = sy;
+                else in = &row;
+            }
+            const float w = t.weights[k];
+            for (int x = 0; x < dstWidth; ++x) accumulator[static_cast<size_t>(x)] += (*in)[static_cast<size_t>(x)] * w;
+        }
+        uint8_t* out = dst + static_cast<size_t>(y) * dstWidth;
+        for (int x = 0; x < dstWidth; ++x) {
+            const int v = static_cast<int>(accumulator[static_cast<size_t>(x)] + 0.5f);
+            out[x] = static_cast<uint8_t>(std::clamp(v, 0, 255));
+        }
+    }
+}
+
+void ResizeImageArea(const PlanarImage& src, int width, int height, PlanarImage& dst)
+{
+    dst.Allocate(width, height, src.channels);
+    for (int c = 0; c < src.channels; ++c) {
+        ResizePlaneArea(src.planes[c].data(), src.width, src.height, dst.planes[c].data(), width, height);
+    }
+}
+
+const char* ResampleFilterName(ResampleFilter filter)
+{
+    switch (filter) {
+    case ResampleFilter::Lanczos3: return "lanczos3";
+    case ResampleFilter::Mitchell: return "mitchell";
+    case ResampleFilter::Bilinear: return "bilinear";
+    }
+    return "lanczos3";
+}
+
+bool ParseResampleFilter(const std::string& name, ResampleFilter& filter)
+{
+    for (ResampleFilter f : { ResampleFilter::Lanczos3, ResampleFilter::Mitchell, ResampleFilter::Bilinear }) {
+        if (name == ResampleFilterName(f)) {
+            filter = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResampleHdrImage(const HdrImage& src, int width, int height, const ResampleOptions& options, HdrImage& dst)
+{
+    dst.Allocate(width, height);
+    if (width <= 0 || height <= 0 || src.width <= 0 || src.height <= 0) return;
+    const FilterTable columns = BuildFilter(options.filter, src.width, width);
+    const FilterTable rows = BuildFilter(options.filter, src.height, height);
+    static const ResampleKernels scalar;
+    const ResampleKernels& kernels = options.simd ? DetectKernels() : scalar;
+
+    // Strips of at least 32 rows; each filters the source rows it needs itself, so neighbours
+    // repeat a few rows of horizontal work rather than wait on each other
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const int threads = options.pool ? std::clamp(options.threads > 0 ? options.threads : static_cast<int>(cores), 1, std::max(1, height / 32)) : 1;
+    std::atomic<int> next{ 0 };
+    auto work = [&] {
+        for (int t = next++; t < threads; t = next++) ResampleStrip(src, columns, rows, kernels, height * t / threads, height * (t + 1) / threads, dst);
+    };
+    if (threads > 1) options.pool->RunShared(static_cast<unsigned>(threads - 1), work);
+    else work();
+}
+
+const char* ResampleKernelName()
+{
+    return DetectKernels().name;
+}
+
+LinearTaps BuildLinearTaps(int inSize, int outSize)
+{
+    LinearTaps taps;
+    taps.i0.resize(static_cast<size_t>(std::max(outSize, 0)));
+    taps.i1.resize(taps.i0.size());
+    taps.f.resize(taps.i0.size());
+    const float scale = static_cast<float>(inSize) / outSize;
+    for (int o = 0; o < outSize; ++o) {
+        const float s = std::max(0.0f, (o + 0.5f) * scale - 0.5f);
+        const int i0 = std::min(static_cast<int>(s), inSize - 1);
+        taps.i0[static_cast<size_t>(o)] = i0;
+        taps.i1[static_cast<size_t>(o)] = std::min(i0 + 1, inSize - 1);
+        taps.f[static_cast<size_t>(o)] = s - i0;
+    }
+    return taps;
+}
+
+void UpsampleExp2Row(const LinearTaps& taps, const float* in, float* out, bool simd)
+{
+    if (simd) {
+        DetectKernels().upsampleExp2(taps, in, out);
+    } else {
+        UpsampleExp2Scalar(taps, in, out);
+    }
+}
@@ -0,0 +1,272 @@
+// InputTrace.cpp - navigation trace file and headless replay
+#include "InputTrace.h"
+#include "BinaryFileUtils.h"
+#include "ImageFileUtils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+const char kTraceMagic[8] = { 'H', 'D', 'R', 'T', 'R', 'A', 'C', 1 };
+// Far longer than any recorded session; a later event time is damage, and replay adds event
+// times to clock readings
+const int64_t kMaxTraceMicros = int64_t(366) * 24 * 3600 * 1000000;
+
+void PutFixed(std::vector<uint8_t>& out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+bool GetFixed(const uint8_t*& p, const uint8_t* end, uint64_t& value, int bytes)
+{
+    if (end - p < bytes) return false;
+    value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(*p++) << (8 * i);
+    return true;
+}
+
+} // namespace
+
+const char* TraceEventKindName(TraceEventKind kind)
+{
+    switch (kind) {
+    case TraceEventKind::Advance: return "advance";
+    case TraceEventKind::Next: return "next";
+    case TraceEventKind::Previous: return "previous";
+    case TraceEventKind::SkipNext: return "skip-next";
+    case TraceEventKind::SkipPrevious: return "skip-previous";
+    case TraceEventKind::Extend: return "extend";
+    }
+    return "unknown";
+}
+
+ContentHash InputTrace::CatalogHash(const ImageCatalog& catalog, size_t count, const std::wstring& root)
+{
+    std::string paths;
+    const std::filesystem::path base(root);
+    for (size_t i = 0; i < std::min(count, catalog.Size()); ++i) {
+        const std::filesystem::path path(catalog[i].path);
+        const std::filesystem::path relative = path.lexically_relative(base);
+        paths += Utf8FromPath(relative.empty() ? path : relative);
+        paths += '\n';
+    }
+    return HashBytes(paths.data(), paths.size());
+}
+
+std::wstring InputTrace::CatalogRoot() const
+{
+    return openedFile ? std::filesystem::path(root).parent_path().wstring() : root;
+}
+
+void InputTrace::Record(TraceEventKind kind, size_t output, size_t index, Slideshow::Clock::time_point now)
+{
+    TraceEvent event;
+    event.time = std::chrono::duration_cast<std::chrono::microseconds>(now - start_);
+    // Events arrive in order; a clock that went backwards must not make the deltas negative
+    if (!events.empty()) event.time = std::max(event.time, events.back().time);
+    event.kind = kind;
+    event.output = static_cast<uint32_t>(output);
+    event.index = index;
+    events.push_back(event);
+}
+
+bool InputTrace::Save(const std::filesystem::path& path) const
+{
+    std::vector<uint8_t> out(std::begin(kTraceMagic), std::end(kTraceMagic));
+    PutString(out, root);
+    out.push_back(static_cast<uint8_t>((openedFile ? 1 : 0) | (includeSubfolders ? 2 : 0) | (weighted ? 4 : 0)));
+    PutString(out, playlistQuery);
+    PutVarint(out, cacheBytes);
+    PutVarint(out, catalogSize);
+    PutFixed(out, catalogHash.lo, 8);
+    PutFixed(out, catalogHash.hi, 8);
+    PutVarint(out, outputs.size());
+    for (const SlideOutputConfig& config : outputs) {
+        PutString(out, config.name);
+        PutVarint(out, static_cast<uint64_t>(std::max(0, config.width)));
+        PutVarint(out, static_cast<uint64_t>(std::max(0, config.height)));
+        uint32_t headroom = 0;
+        std::memcpy(&headroom, &config.headroom, sizeof(headroom));
+        PutFixed(out, headroom, 4);
+        PutVarint(out, static_cast<uint64_t>(std::max<int64_t>(0, config.interval.count())));
+        out.push_back(static_cast<uint8_t>((config.autoAdvance ? 1 : 0) | (config.order == SlideOrder::Random ? 2 : 0)));
+        PutFixed(out, config.seed, 8);
+        PutVarint(out, config.startIndex);
+    }
+    // Held keys produce runs of events milliseconds apart, so time deltas are one or two bytes
+    PutVarint(out, events.size());
+    int64_t previous = 0;
+    for (const TraceEvent& event : events) {
+        out.push_back(static_cast<uint8_t>(event.kind));
+        PutVarint(out, event.output);
+        PutVarint(out, static_cast<uint64_t>(event.time.count() - previous));
+        PutVarint(out, event.index);
+        previous = event.time.count();
+    }
+    return WriteFileAtomically(path, out);
+}
+
+bool InputTrace::Load(const std::filesystem::path& path)
+{
+    *this = InputTrace();
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kTraceMagic) || std::memcmp(data.data(), kTraceMagic, sizeof(kTraceMagic)) != 0) return false;
+    const uint8_t* p = data.data() + sizeof(kTraceMagic);
+    const uint8_t* end = data.data() + data.size();
+    auto fail = [this] {
+        *this = InputTrace();
+        return false;
+    };
+
+    uint64_t flags = 0, count = 0;
+    if (!GetString(p, end, root) || !GetFixed(p, end, flags, 1) || !GetString(p, end, playlistQuery)) return fail();
+    openedFile = (flags & 1) != 0;
+    includeSubfolders = (flags & 2) != 0;
+    weighted = (flags & 4) != 0;
+    if (!GetVarint(p, end, cacheBytes) || !GetVarint(p, end, catalogSize) || !GetFixed(p, end, catalogHash.lo, 8) ||
+        !GetFixed(p, end, catalogHash.hi, 8) || !GetVarint(p, end, count) || count > data.size()) {
+        return fail();
+    }
+    outputs.resize(static_cast<size_t>(count));
+    for (SlideOutputConfig& config : outputs) {
+        uint64_t width = 0, height = 0, headroom = 0, interval = 0, options = 0, start = 0;
+        if (!GetString(p, end, config.name) || !GetVarint(p, end, width) || !GetVarint(p, end, height) || !GetFixed(p, end, headroom, 4) ||
+            !GetVarint(p, end, interval) || !GetFixed(p, end, options, 1) || !GetFixed(p, end, config.seed, 8) || !GetVarint(p, end, start)) {
+            return fail();
+        }
+        config.width = static_cast<int>(std::min<uint64_t>(width, INT32_MAX));
+        config.height = static_cast<int>(std::min<uint64_t>(height, INT32_MAX));
+        const uint32_t bits = static_cast<uint32_t>(headroom);
+        std::memcpy(&config.headroom, &bits, sizeof(bits));
+        config.interval = std::chrono::milliseconds(static_cast<int64_t>(std::min<uint64_t>(interval, INT32_MAX)));
+        config.autoAdvance = (options & 1) != 0;
+        config.order = (options & 2) ? SlideOrder::Random : SlideOrder::Sequential;
+        config.startIndex = static_cast<size_t>(start);
+    }
+    if (!GetVarint(p, end, count) || count > data.size()) return fail();
+    events.resize(static_cast<size_t>(count));
+    int64_t time = 0;
+    for (TraceEvent& event : events) {
+        uint64_t kind = 0, output = 0, delta = 0;
+        if (!GetFixed(p, end, kind, 1) || kind >= kTraceEventKinds || !GetVarint(p, end, output) || !GetVarint(p, end, delta) ||
+            !GetVarint(p, end, event.index) || delta > static_cast<uint64_t>(kMaxTraceMicros - time)) {
+            return fail();
+        }
+        time += static_cast<int64_t>(delta);
+        event.time = std::chrono::microseconds(time);
+        event.kind = static_cast<TraceEventKind>(kind);
+        event.output = static_cast<uint32_t>(std::min<uint64_t>(output, UINT32_MAX));
+    }
+    return true;
+}
+
+std::chrono::microseconds ReplayResult::Percentile(TraceEventKind kind, double q) const
+{
+    const auto& sorted = latencies[static_cast<size_t>(kind)];
+    if (sorted.empty()) return std::chrono::microseconds(0);
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())))];
+}
+
+bool ReplayInputTrace(const InputTrace& trace, const ImageCatalog& catalog, ImageCache& cache, WorkerPool& pool,
+                      Slideshow::LoadFunction load, const ReplayOptions& options, ReplayResult& result, std::string* error)
+{
+    using Clock = Slideshow::Clock;
+    result = ReplayResult();
+    auto fail = [error](const std::string& message) {
+        if (error) *error = message;
+        return false;
+    };
+    if (trace.outputs.empty()) return fail("the trace has no outputs");
+    if (trace.catalogSize == 0 || trace.catalogSize > catalog.Size()) {
+        return fail("the trace starts with " + std::to_string(trace.catalogSize) + " images, the catalog has " + std::to_string(catalog.Size()));
+    }
+    for (const TraceEvent& event : trace.events) {
+        if (event.kind == TraceEventKind::Extend && (event.index < trace.catalogSize || event.index > catalog.Size())) {
+            return fail("the trace extends the catalog to " + std::to_string(event.index) + " images, the catalog has " + std::to_string(catalog.Size()));
+        }
+    }
+
+    // The catalog as it was at each point of the session; every one must outlive the slideshow
+    std::deque<ImageCatalog> prefixes;
+    auto prefix = [&](uint64_t size) -> const ImageCatalog& {
+        if (size >= catalog.Size()) return catalog;
+        ImageCatalog& part = prefixes.emplace_back();
+        for (size_t i = 0; i < size; ++i) part.Add(catalog[i]);
+        return part;
+    };
+
+    Slideshow slideshow(prefix(trace.catalogSize), cache, pool, std::move(load));
+    for (const SlideOutputConfig& config : trace.outputs) slideshow.AddOutput(config);
+
+    // A Tick may advance outputs other than the one whose event is being replayed; their changes
+    // wait here for that output's own Advance event
+    const size_t none = static_cast<size_t>(-1);
+    std::vector<size_t> pending(trace.outputs.size(), none);
+    const auto start = Clock::now();
+    for (const TraceEvent& event : trace.events) {
+        // The slideshow clock runs at the recorded times; real time only sets how long loads get
+        // between inputs
+        const auto now = start + event.time;
+        auto dispatched = Clock::now();
+        if (options.speed > 0) {
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(event.time.count() / options.speed));
+            std::this_thread::sleep_until(due);
+            // An input that waited behind a slow step felt that wait too
+            dispatched = due;
+        }
+        if (event.kind == TraceEventKind::Extend) {
+            slideshow.ExtendCatalog(prefix(event.index), now);
+            continue;
+        }
+        if (event.output >= slideshow.OutputCount()) {
+            ++result.divergences;
+            continue;
+        }
+        const size_t output = event.output;
+        size_t shown = none;
+        if (event.kind == TraceEventKind::Advance) {
+            std::swap(shown, pending[output]);
+            while (shown == none) {
+                for (const SlideChange& change : slideshow.Tick(now)) {
+                    if (change.output == output && shown == none) shown = change.index;
+                    else pending[change.output] = change.index;
+                }
+                // The recorded advance waited for this slide to load; so does the replay
+                if (shown != none || Clock::now() - dispatched > options.stepTimeout) break;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        } else {
+            // An automatic advance the recording did not have
+            if (pending[output] != none) {
+                ++result.divergences;
+                pending[output] = none;
+            }
+            const bool forward = event.kind == TraceEventKind::Next || event.kind == TraceEventKind::SkipNext;
+            shown = (forward ? slideshow.Next(output, now) : slideshow.Previous(output, now)).index;
+        }
+        if (shown == none) {
+            ++result.divergences;
+            continue;
+        }
+        // The renderer fetches the image as soon as it is told to show it
+        slideshow.Acquire(shown);
+        result.latencies[static_cast<size_t>(event.kind)].push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - dispatched));
+        ++result.steps;
+        if (shown != event.index) ++result.divergences;
+    }
+    for (size_t index : pending) {
+        if (index != none) ++result.divergences;
+    }
+    pool.WaitIdle();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& latencies : result.latencies) std::sort(latencies.begin(), latencies.end());
+    return true;
+}
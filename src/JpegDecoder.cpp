@@ -0,0 +1,905 @@
+// JpegDecoder.cpp - baseline sequential Huffman JPEG decoder
+#include "JpegCodec.h"
+#include "JpegTables.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_JPEG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct HuffmanTable {
+    bool present = false;
+    // Codes up to kFastBits long are resolved with one table lookup
+    static constexpr int kFastBits = 9;
+    uint8_t fastLength[1 << kFastBits] = {};
+    uint8_t fastValue[1 << kFastBits] = {};
+    int32_t maxCode[18] = {};
+    int32_t valueOffset[18] = {};
+    uint8_t values[256] = {};
+
+    bool Build(const uint8_t counts[16], const uint8_t* symbols, int symbolCount) {
+        present = false;
+        std::memset(fastLength, 0, sizeof(fastLength));
+        std::memcpy(values, symbols, static_cast<size_t>(symbolCount));
+        int32_t code = 0;
+        int k = 0;
+        for (int length = 1; length <= 16; ++length) {
+            valueOffset[length] = k - code;
+            for (int i = 0; i < counts[length - 1]; ++i, ++code, ++k) {
+                // More codes than fit in `length` bits: a damaged table, and the fill below would
+                // run past the fast lookup
+                if (code >= (1 << length)) return false;
+                if (length <= kFastBits) {
+                    const int shift = kFastBits - length;
+                    for (int fill = 0; fill < (1 << shift); ++fill) {
+                        fastLength[(code << shift) | fill] = static_cast<uint8_t>(length);
+                        fastValue[(code << shift) | fill] = symbols[k];
+                    }
+                }
+            }
+            maxCode[length] = counts[length - 1] ? code - 1 : -1;
+            code <<= 1;
+        }
+        maxCode[17] = INT_MAX;
+        present = true;
+        return true;
+    }
+};
+
+struct Component {
+    int id = 0;
+    int h = 1, v = 1;
+    int quantTable = 0;
+    int dcTable = 0, acTable = 0;
+    int blocksW = 0, blocksH = 0;        // padded to whole MCUs
+    PixelPlane plane;                    // blocksW * 8 x blocksH * 8 samples
+};
+
+// Entropy-coded segment reader: removes byte stuffing and stops at the next marker, after which
+// it returns zero bits
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size, size_t pos) : data_(data), size_(size), pos_(pos) {}
+
+    uint32_t Peek(int n) {
+        if (count_ < n) Fill();
+        return static_cast<uint32_t>(buffer_ >> (64 - n));
+    }
+    void Skip(int n) {
+        buffer_ <<= n;
+        count_ -= n;
+    }
+    uint32_t Get(int n) {
+        const uint32_t v = Peek(n);
+        Skip(n);
+        return v;
+    }
+    // Reads an s-bit magnitude category value (F.2.2.1 EXTEND)
+    int Receive(int s) {
+        if (s == 0) return 0;
+        const int v = static_cast<int>(Get(s));
+        return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+    }
+    int Decode(const HuffmanTable& table) {
+        const uint32_t fast = Peek(HuffmanTable::kFastBits);
+        if (table.fastLength[fast]) {
+            Skip(table.fastLength[fast]);
+            return table.fastValue[fast];
+        }
+        const uint32_t bits = Peek(16);
+        for (int length = HuffmanTable::kFastBits + 1; length <= 16; ++length) {
+            const int32_t code = static_cast<int32_t>(bits >> (16 - length));
+            if (code <= table.maxCode[length]) {
+                Skip(length);
+                return table.values[(code + table.valueOffset[length]) & 0xFF];
+            }
+        }
+        corrupt_ = true;
+        Skip(16);
+        return 0;
+    }
+    // Drops buffered bits and consumes the RSTn marker that ends an interval
+    bool Restart() {
+        buffer_ = 0;
+        count_ = 0;
+        atMarker_ = false;
+        while (pos_ + 1 < size_ && !(data_[pos_] == 0xFF && data_[pos_ + 1] >= 0xD0 && data_[pos_ + 1] <= 0xD7)) {
+            if (data_[pos_] == 0xFF && data_[pos_ + 1] != 0x00 && data_[pos_ + 1] != 0xFF) return false;
+            ++pos_;
+        }
+        if (pos_ + 1 >= size_) return false;
+        pos_ += 2;
+        return true;
+    }
+    bool Corrupt() const { return corrupt_; }
+
+    // Everything needed to continue reading from here later, for the region index
+    struct State {
+        size_t pos = 0;
+        uint64_t buffer = 0;
+        int count = 0;
+        bool atMarker = false;
+    };
+    State Save() const { return { pos_, buffer_, count_, atMarker_ }; }
+    void Restore(const State& state) {
+        pos_ = state.pos;
+        buffer_ = state.buffer;
+        count_ = state.count;
+        atMarker_ = state.atMarker;
+        corrupt_ = false;
+    }
+
+    // Position of the marker that ends the segment. Bits still buffered are dropped: after a
+    // damaged table the scan can end short of the marker with the buffer full, and Fill alone
+    // would then never move on.
+    size_t MarkerPosition() {
+        while (!atMarker_ && pos_ < size_) {
+            buffer_ = 0;
+            count_ = 0;
+            Fill();
+        }
+        return pos_;
+    }
+
+private:
+    void Fill() {
+        while (count_ <= 56) {
+            uint64_t byte = 0;
+            if (!atMarker_ && pos_ < size_) {
+                byte = data_[pos_];
+                if (byte == 0xFF) {
+                    const uint8_t next = pos_ + 1 < size_ ? data_[pos_ + 1] : 0xD9;
+                    if (next == 0x00) pos_ += 2;
+                    else if (next == 0xFF) { ++pos_; continue; }   // fill byte
+                    else { atMarker_ = true; byte = 0; }
+                } else {
+                    ++pos_;
+                }
+            }
+            buffer_ |= byte << (56 - count_);
+            count_ += 8;
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    uint64_t buffer_ = 0;
+    int count_ = 0;
+    bool atMarker_ = false;
+    bool corrupt_ = false;
+};
+
+// Appends the offset just past each RSTn marker from `pos` on, up to `limit` markers or the end
+// of the scan (any other marker). Entropy-coded data holds an 0xFF byte about every 256 bytes,
+// nearly all of them stuffed (FF 00), so the SSE2 loop tests 16 bytes per step for an 0xFF that
+// is followed by anything but 00 or another FF and only leaves the vector loop at real markers.
+void FindRestartMarkers(const uint8_t* data, size_t size, size_t pos, size_t limit, std::vector<size_t>& starts)
+{
+    size_t found = 0;
+    // Returns false at the end of the scan or once `limit` markers are found
+    auto marker = [&](size_t p) {
+        if (data[p + 1] < 0xD0 || data[p + 1] > 0xD7) return false;
+        starts.push_back(p + 2);
+        return ++found < limit;
+    };
+    if (limit == 0) return;
+#ifdef HDR_JPEG_SSE2
+    const __m128i ones = _mm_set1_epi8(-1);
+    const __m128i zero = _mm_setzero_si128();
+    while (pos + 17 <= size) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + 1));
+        const __m128i padding = _mm_or_si128(_mm_cmpeq_epi8(next, zero), _mm_cmpeq_epi8(next, ones));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_andnot_si128(padding, _mm_cmpeq_epi8(bytes, ones))));
+        if (mask == 0) {
+            pos += 16;
+            continue;
+        }
+        pos += static_cast<size_t>(std::countr_zero(mask));
+        if (!marker(pos)) return;
+        pos += 2;
+    }
+#endif
+    while (pos + 1 < size) {
+        const void* ff = std::memchr(data + pos, 0xFF, size - pos - 1);
+        if (!ff) return;
+        pos = static_cast<size_t>(static_cast<const uint8_t*>(ff) - data);
+        if (data[pos + 1] == 0x00 || data[pos + 1] == 0xFF) { ++pos; continue; }   // stuffing or fill byte
+        if (!marker(pos)) return;
+        pos += 2;
+    }
+}
+
+class Decoder {
+public:
+    Decoder(const uint8_t* data, size_t size, unsigned threads = 1, WorkerPool* pool = nullptr, const std::atomic<bool>* cancel = nullptr)
+        : data_(data), size_(size), threads_(pool ? threads : 1), pool_(pool), cancel_(cancel) {}
+
+    bool Run(PlanarImage* image, JpegInfo& info, std::string& error) {
+        if (size_ < 4 || data_[0] != 0xFF || data_[1] != 0xD8) return Fail(error, "not a JPEG stream");
+        size_t pos = 2;
+        while (pos < size_) {
+            // Markers may be preceded by any number of fill bytes
+            if (data_[pos] != 0xFF) { ++pos; continue; }
+            while (pos < size_ && data_[pos] == 0xFF) ++pos;
+            if (pos >= size_) break;
+            const uint8_t marker = data_[pos++];
+            if (marker == 0xD9) break;                               // EOI
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+            if (pos + 2 > size_) return Fail(error, "truncated marker segment");
+            const size_t length = (static_cast<size_t>(data_[pos]) << 8) | data_[pos + 1];
+            if (length < 2 || pos + length > size_) return Fail(error, "truncated marker segment");
+            const uint8_t* seg = data_ + pos + 2;
+            const size_t segLength = length - 2;
+            pos += length;
+
+            switch (marker) {
+            case 0xC0: case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+            case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+                if (!ReadFrame(marker, seg, segLength, info, error)) return false;
+                if (!image && !opening_) return true;
+                if (info.progressive || info.arithmetic || (marker != 0xC0 && marker != 0xC1))
+                    return Fail(error, "only baseline and extended sequential Huffman JPEG is supported");
+                if (info.precision != 8) return Fail(error, "only 8-bit samples are supported");
+                if (info.components != 1 && info.components != 3) return Fail(error, "only gray and YCbCr images are supported");
+                break;
+            case 0xC4:
+                if (!ReadHuffmanTables(seg, segLength)) return Fail(error, "invalid Huffman table");
+                break;
+            case 0xDB:
+                if (!ReadQuantTables(seg, segLength)) return Fail(error, "invalid quantization table");
+                break;
+            case 0xDD:
+                if (segLength < 2) return Fail(error, "invalid restart interval");
+                restartInterval_ = (seg[0] << 8) | seg[1];
+                info.restartInterval = restartInterval_;
+                break;
+            case 0xEE:
+                // Adobe APP14: transform 0 means the three components are RGB, not YCbCr
+                if (segLength >= 12 && std::memcmp(seg, "Adobe", 5) == 0) adobeTransform_ = seg[11];
+                break;
+            case 0xDA:
+                if ((!image && !opening_) || components_.empty()) return Fail(error, "scan before frame header");
+                if (opening_) return OpenScan(seg, segLength, pos, error);
+                if (!DecodeScan(seg, segLength, pos, error)) return false;
+                break;
+            default:
+                break;                                               // APPn, COM, DNL, ...
+            }
+        }
+        if (opening_) return Fail(error, components_.empty() ? "no frame header" : "no image data");
+        if (!image) return Fail(error, "no frame header");
+        if (!scanned_) return Fail(error, "no image data");
+        if (info.components == 3 && adobeTransform_ == 0) return Fail(error, "RGB JPEG is not supported");
+        Output(*image);
+        return true;
+    }
+
+    // Region decoding enters the scan at checkpoints instead of at its start. A checkpoint holds
+    // the bit reader and the DC predictors (in scan order) in front of one unit: an MCU, or a
+    // block of a gray image.
+    struct Checkpoint {
+        uint64_t unit = 0;
+        BitReader::State bits;
+        int dc[4] = {};
+        int untilRestart = 0;
+    };
+
+    // Reads the headers up to the first scan, which must code all components
+    bool Open(JpegInfo& info, std::string& error) {
+        opening_ = true;
+        return Run(nullptr, info, error);
+    }
+
+    // One checkpoint per `stride` units of every unit row. With restart markers the checkpoints
+    // are the markers themselves; otherwise one entropy decoding pass records them.
+    bool BuildIndex(int stride, std::vector<Checkpoint>& index, std::string& error) const {
+        index.clear();
+        if (restartInterval_ > 0) return IndexRestartMarkers(stride, index);
+        BitReader bits(data_, size_, scanPos_);
+        Checkpoint state;
+        const uint64_t units = static_cast<uint64_t>(unitsX_) * unitsY_;
+        for (uint64_t u = 0; u < units; ++u) {
+            if ((u % unitsX_) % stride == 0) {
+                state.unit = u;
+                state.bits = bits.Save();
+                index.push_back(state);
+            }
+            for (size_t k = 0; k < scan_.size(); ++k) {
+                const Component& c = components_[scan_[k]];
+                for (int b = BlocksX(c) * BlocksY(c); b > 0; --b) {
+                    if (!SkipBlock(bits, c, state.dc[k])) return Fail(error, "corrupt entropy-coded data");
+                }
+            }
+        }
+        return true;
+    }
+
+    // Decodes [x, x + w) x [y, y + h) of the image downscaled by 2^shift. Only the unit rows of
+    // the region are entropy decoded, each from the last checkpoint in front of it; units left of
+    // the region are skipped without transforming them. At shift 3 every block is its DC value.
+    bool DecodeRegion(const std::vector<Checkpoint>& index, int x, int y, int w, int h, int shift, PlanarImage& out, std::string& error) const {
+        if (shift < 0 || shift > 3) return Fail(error, "invalid scale");
+        const int levelW = (width_ + (1 << shift) - 1) >> shift;
+        const int levelH = (height_ + (1 << shift) - 1) >> shift;
+        if (w <= 0 || h <= 0 || x < 0 || y < 0 || x >= levelW || y >= levelH) return Fail(error, "region outside the image");
+        if (index.empty()) return Fail(error, "no region index");
+        w = std::min(w, levelW - x);
+        h = std::min(h, levelH - y);
+        const int ux0 = (x << shift) / unitW_;
+        const int uy0 = (y << shift) / unitH_;
+        const int ux1 = std::min(unitsX_, (((x + w) << shift) + unitW_ - 1) / unitW_);
+        const int uy1 = std::min(unitsY_, (((y + h) << shift) + unitH_ - 1) / unitH_);
+
+        // Padded planes of the covered units, one per scan component. Subsampled components are
+        // scaled less, by what their subsampling already took off.
+        struct TilePlane {
+            PixelPlane samples;
+            size_t stride = 0;
+            int blocksX = 1, blocksY = 1;
+            int sx = 1, sy = 1;        // subsampling
+            int shift = 0;
+            int blockSize = 8;
+        };
+        TilePlane tiles[4];
+        for (size_t k = 0; k < scan_.size(); ++k) {
+            const Component& c = components_[scan_[k]];
+            TilePlane& t = tiles[k];
+            t.blocksX = BlocksX(c);
+            t.blocksY = BlocksY(c);
+            t.sx = scan_.size() > 1 ? hMax_ / c.h : 1;
+            t.sy = scan_.size() > 1 ? vMax_ / c.v : 1;
+            t.shift = shift;
+            while (t.shift > 0 && (2 << (shift - t.shift)) <= std::min(t.sx, t.sy)) --t.shift;
+            t.blockSize = 8 >> t.shift;
+            t.stride = static_cast<size_t>(ux1 - ux0) * t.blocksX * t.blockSize;
+            PixelPlane(t.stride * static_cast<size_t>(uy1 - uy0) * t.blocksY * t.blockSize).swap(t.samples);
+        }
+
+        const uint64_t units = static_cast<uint64_t>(unitsX_) * unitsY_;
+        int32_t coefficients[64];
+        uint8_t pixels[64];
+        for (int uy = uy0; uy < uy1; ++uy) {
+            const uint64_t first = static_cast<uint64_t>(uy) * unitsX_ + ux0;
+            const uint64_t last = static_cast<uint64_t>(uy) * unitsX_ + ux1 - 1;
+            auto cp = std::upper_bound(index.begin(), index.end(), first, [](uint64_t unit, const Checkpoint& c) { return unit < c.unit; });
+            if (cp == index.begin()) return Fail(error, "no region index");
+            --cp;
+            BitReader bits(data_, size_, 0);
+            bits.Restore(cp->bits);
+            int dc[4];
+            std::copy(std::begin(cp->dc), std::end(cp->dc), dc);
+            int untilRestart = cp->untilRestart;
+            for (uint64_t u = cp->unit; u <= last; ++u) {
+                const bool inside = u >= first;
+                const int tx = static_cast<int>(u % unitsX_) - ux0;
+                for (size_t k = 0; k < scan_.size(); ++k) {
+                    const Component& c = components_[scan_[k]];
+                    TilePlane& t = tiles[k];
+                    for (int by = 0; by < t.blocksY; ++by) {
+                        for (int bx = 0; bx < t.blocksX; ++bx) {
+                            if (!inside) {
+                                if (!SkipBlock(bits, c, dc[k])) return Fail(error, "corrupt entropy-coded data");
+                                continue;
+                            }
+                            uint8_t* dst = t.samples.data() + static_cast<size_t>((uy - uy0) * t.blocksY + by) * t.blockSize * t.stride +
+                                           static_cast<size_t>(tx * t.blocksX + bx) * t.blockSize;
+                            if (t.shift == 3) {
+                                if (!SkipBlock(bits, c, dc[k])) return Fail(error, "corrupt entropy-coded data");
+                                *dst = static_cast<uint8_t>(std::clamp((dc[k] * quant_[c.quantTable][0] + 1028) >> 3, 0, 255));
+                                continue;
+                            }
+                            if (!DecodeBlock(bits, c, dc[k], coefficients)) return Fail(error, "corrupt entropy-coded data");
+                            if (t.shift == 0) {
+                                JpegInverseDct(coefficients, dst, t.stride);
+                            } else {
+                                JpegInverseDct(coefficients, pixels, 8);
+                                AverageBlock(pixels, t.shift, dst, t.stride);
+                            }
+                        }
+                    }
+                }
+                if (restartInterval_ > 0 && u != units - 1 && --untilRestart == 0) {
+                    untilRestart = restartInterval_;
+                    std::fill(std::begin(dc), std::end(dc), 0);
+                    if (!bits.Restart()) return Fail(error, "missing restart marker");
+                }
+            }
+        }
+
+        // Crops to the region and replicates subsampled chroma, as Output does for whole images
+        out.Allocate(w, h, static_cast<int>(components_.size()));
+        // Output pixel (x, y) covers full resolution pixel (x << shift, y << shift), which is
+        // sample (x << shift) / sx of a component at full scale and that >> t.shift in its plane
+        const int originX = ux0 * unitW_;
+        const int originY = uy0 * unitH_;
+        for (size_t k = 0; k < scan_.size(); ++k) {
+            const TilePlane& t = tiles[k];
+            for (int row = 0; row < h; ++row) {
+                const int sourceRow = ((((y + row) << shift) - originY) / t.sy) >> t.shift;
+                const uint8_t* src = t.samples.data() + static_cast<size_t>(sourceRow) * t.stride;
+                uint8_t* dst = out.planes[scan_[k]].data() + static_cast<size_t>(row) * w;
+                if (t.sx == 1 && t.shift == shift) {
+                    std::memcpy(dst, src + (x - (originX >> shift)), static_cast<size_t>(w));
+                } else {
+                    for (int col = 0; col < w; ++col) dst[col] = src[((((x + col) << shift) - originX) / t.sx) >> t.shift];
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    bool Cancelled() const { return cancel_ && cancel_->load(std::memory_order_relaxed); }
+
+    static bool Fail(std::string& error, const char* message) {
+        error = message;
+        return false;
+    }
+
+    bool ReadFrame(uint8_t marker, const uint8_t* seg, size_t length, JpegInfo& info, std::string& error) {
+        if (length < 6) return Fail(error, "invalid frame header");
+        info.progressive = marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE;
+        info.arithmetic = marker >= 0xC9;
+        info.precision = seg[0];
+        info.height = (seg[1] << 8) | seg[2];
+        info.width = (seg[3] << 8) | seg[4];
+        info.components = seg[5];
+        if (info.width == 0 || info.height == 0) return Fail(error, "invalid image size");
+        if (length < 6 + static_cast<size_t>(info.components) * 3) return Fail(error, "invalid frame header");
+        width_ = info.width;
+        height_ = info.height;
+        components_.assign(static_cast<size_t>(info.components), Component());
+        for (int i = 0; i < info.components; ++i) {
+            Component& c = components_[static_cast<size_t>(i)];
+            c.id = seg[6 + i * 3];
+            c.h = seg[7 + i * 3] >> 4;
+            c.v = seg[7 + i * 3] & 15;
+            c.quantTable = seg[8 + i * 3] & 3;
+            if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4) return Fail(error, "invalid sampling factors");
+            hMax_ = std::max(hMax_, c.h);
+            vMax_ = std::max(vMax_, c.v);
+        }
+        mcusX_ = (width_ + 8 * hMax_ - 1) / (8 * hMax_);
+        mcusY_ = (height_ + 8 * vMax_ - 1) / (8 * vMax_);
+        for (Component& c : components_) {
+            if (hMax_ % c.h || vMax_ % c.v) return Fail(error, "fractional chroma subsampling is not supported");
+            c.blocksW = mcusX_ * c.h;
+            c.blocksH = mcusY_ * c.v;
+        }
+        return true;
+    }
+
+    bool ReadHuffmanTables(const uint8_t* seg, size_t length) {
+        size_t p = 0;
+        while (p + 17 <= length) {
+            const int tableClass = seg[p] >> 4;
+            const int id = seg[p] & 15;
+            if (tableClass > 1 || id > 3) return false;
+            const uint8_t* counts = seg + p + 1;
+            int total = 0;
+            for (int i = 0; i < 16; ++i) total += counts[i];
+            if (total > 256 || p + 17 + static_cast<size_t>(total) > length) return false;
+            HuffmanTable& table = tableClass == 0 ? dcTables_[id] : acTables_[id];
+            if (!table.Build(counts, seg + p + 17, total)) return false;
+            p += 17 + static_cast<size_t>(total);
+        }
+        return p == length;
+    }
+
+    bool ReadQuantTables(const uint8_t* seg, size_t length) {
+        size_t p = 0;
+        while (p < length) {
+            const int precision = seg[p] >> 4;
+            const int id = seg[p] & 15;
+            if (id > 3) return false;
+            const size_t bytes = precision ? 128 : 64;
+            if (p + 1 + bytes > length) return false;
+            for (int k = 0; k < 64; ++k) {
+                quant_[id][k] = precision ? static_cast<uint16_t>((seg[p + 1 + k * 2] << 8) | seg[p + 2 + k * 2]) : seg[p + 1 + k];
+            }
+            p += 1 + bytes;
+        }
+        return true;
+    }
+
+    // Reads which components the scan codes, in order, and their Huffman tables
+    bool ReadScanHeader(const uint8_t* seg, size_t length, std::vector<Component*>& scan, std::string& error) {
+        if (length < 1) return Fail(error, "invalid scan header");
+        const int count = seg[0];
+        if (count < 1 || count > 4 || length < 4 + static_cast<size_t>(count) * 2) return Fail(error, "invalid scan header");
+        for (int i = 0; i < count; ++i) {
+            const int id = seg[1 + i * 2];
+            auto it = std::find_if(components_.begin(), components_.end(), [id](const Component& c) { return c.id == id; });
+            if (it == components_.end()) return Fail(error, "scan references an unknown component");
+            it->dcTable = seg[2 + i * 2] >> 4;
+            it->acTable = seg[2 + i * 2] & 15;
+            if (it->dcTable > 3 || it->acTable > 3 || !dcTables_[it->dcTable].present || !acTables_[it->acTable].present)
+                return Fail(error, "scan references a missing Huffman table");
+            scan.push_back(&*it);
+        }
+        return true;
+    }
+
+    bool OpenScan(const uint8_t* seg, size_t length, size_t pos, std::string& error) {
+        std::vector<Component*> scan;
+        if (!ReadScanHeader(seg, length, scan, error)) return false;
+        if (scan.size() != components_.size()) return Fail(error, "region decoding needs all components in one scan");
+        if (components_.size() == 3 && adobeTransform_ == 0) return Fail(error, "RGB JPEG is not supported");
+        for (Component* c : scan) scan_.push_back(static_cast<size_t>(c - components_.data()));
+        if (scan.size() == 1) {
+            // Non-interleaved: a unit is one block of the (full resolution) gray plane
+            unitsX_ = (width_ + 7) / 8;
+            unitsY_ = (height_ + 7) / 8;
+            unitW_ = unitH_ = 8;
+        } else {
+            unitsX_ = mcusX_;
+            unitsY_ = mcusY_;
+            unitW_ = 8 * hMax_;
+            unitH_ = 8 * vMax_;
+        }
+        scanPos_ = pos;
+        return true;
+    }
+
+    int BlocksX(const Component& c) const { return scan_.size() > 1 ? c.h : 1; }
+    int BlocksY(const Component& c) const { return scan_.size() > 1 ? c.v : 1; }
+
+    // Every RSTn starts an interval with reset predictors, so the markers alone locate units
+    bool IndexRestartMarkers(int stride, std::vector<Checkpoint>& index) const {
+        const uint64_t units = static_cast<uint64_t>(unitsX_) * unitsY_;
+        const uint64_t bucketsPerRow = (static_cast<uint64_t>(unitsX_) + stride - 1) / stride;
+        uint64_t lastBucket = UINT64_MAX;
+        auto add = [&](uint64_t unit, size_t pos) {
+            const uint64_t bucket = unit / unitsX_ * bucketsPerRow + unit % unitsX_ / stride;
+            if (bucket == lastBucket) return;
+            lastBucket = bucket;
+            Checkpoint checkpoint;
+            checkpoint.unit = unit;
+            checkpoint.bits.pos = pos;
+            checkpoint.untilRestart = restartInterval_;
+            index.push_back(checkpoint);
+        };
+        std::vector<size_t> starts{ scanPos_ };
+        FindRestartMarkers(data_, size_, scanPos_, static_cast<size_t>((units - 1) / restartInterval_), starts);
+        for (size_t k = 0; k < starts.size(); ++k) add(k * static_cast<uint64_t>(restartInterval_), starts[k]);
+        return true;
+    }
+
+    // Entropy decodes a block without dequantizing or transforming it, keeping the DC predictor
+    bool SkipBlock(BitReader& bits, const Component& c, int& dcPredictor) const {
+        const int t = bits.Decode(dcTables_[c.dcTable]);
+        if (t > 11) return false;
+        dcPredictor += bits.Receive(t);
+        const HuffmanTable& ac = acTables_[c.acTable];
+        for (int k = 1; k < 64;) {
+            const int rs = bits.Decode(ac);
+            const int s = rs & 15;
+            if (s) {
+                k += (rs >> 4) + 1;
+                if (k > 64) return false;
+                bits.Get(s);
+            } else if (rs >> 4 == 15) {
+                k += 16;
+            } else {
+                break;
+            }
+        }
+        return !bits.Corrupt();
+    }
+
+    // Box averages an 8x8 block down to (8 >> shift) x (8 >> shift)
+    static void AverageBlock(const uint8_t* block, int shift, uint8_t* dst, size_t stride) {
+        const int size = 8 >> shift;
+        const int area = 1 << (2 * shift);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                int sum = 0;
+                for (int dy = 0; dy < (1 << shift); ++dy) {
+                    for (int dx = 0; dx < (1 << shift); ++dx) sum += block[((y << shift) + dy) * 8 + (x << shift) + dx];
+                }
+                dst[static_cast<size_t>(y) * stride + x] = static_cast<uint8_t>((sum + area / 2) / area);
+            }
+        }
+    }
+
+    bool DecodeScan(const uint8_t* seg, size_t length, size_t& pos, std::string& error) {
+        std::vector<Component*> scan;
+        if (!ReadScanHeader(seg, length, scan, error)) return false;
+        for (Component* c : scan) {
+            if (c->plane.empty()) c->plane.assign(static_cast<size_t>(c->blocksW) * c->blocksH * 64, 0);
+        }
+        // Interleaved scans code MCUs; non-interleaved ones one block per unit, covering only the
+        // component's real extent
+        int unitsX = mcusX_, unitsY = mcusY_;
+        if (scan.size() == 1) {
+            const Component& c = *scan[0];
+            unitsX = ((width_ * c.h + hMax_ - 1) / hMax_ + 7) / 8;
+            unitsY = ((height_ * c.v + vMax_ - 1) / vMax_ + 7) / 8;
+        }
+        const uint64_t units = static_cast<uint64_t>(unitsX) * unitsY;
+
+        if (threads_ > 1 && restartInterval_ > 0 && units > static_cast<uint64_t>(restartInterval_)) {
+            const uint64_t intervals = (units + restartInterval_ - 1) / restartInterval_;
+            std::vector<size_t> starts{ pos };
+            starts.reserve(intervals);
+            FindRestartMarkers(data_, size_, pos, intervals - 1, starts);
+            // With markers missing the serial decode below finds where and reports it
+            if (starts.size() == intervals) {
+                if (!DecodeIntervals(scan, unitsX, units, starts, pos)) return Fail(error, Cancelled() ? "cancelled" : "corrupt entropy-coded data");
+                scanned_ = true;
+                return true;
+            }
+        }
+
+        BitReader bits(data_, size_, pos);
+        int dc[4] = {};
+        int untilRestart = restartInterval_;
+        for (uint64_t u = 0; u < units; ++u) {
+            if (u % static_cast<uint64_t>(unitsX) == 0 && Cancelled()) return Fail(error, "cancelled");
+            if (!DecodeUnit(bits, scan, unitsX, u, dc)) return Fail(error, "corrupt entropy-coded data");
+            if (restartInterval_ > 0 && u != units - 1 && --untilRestart == 0) {
+                untilRestart = restartInterval_;
+                std::fill(std::begin(dc), std::end(dc), 0);
+                if (!bits.Restart()) return Fail(error, "missing restart marker");
+            }
+        }
+        pos = bits.MarkerPosition();
+        scanned_ = true;
+        return true;
+    }
+
+    // Decodes, dequantizes and transforms one unit of a scan into the component planes
+    bool DecodeUnit(BitReader& bits, const std::vector<Component*>& scan, int unitsX, uint64_t unit, int* dc) const {
+        int32_t coefficients[64];
+        const int ux = static_cast<int>(unit % static_cast<uint64_t>(unitsX));
+        const int uy = static_cast<int>(unit / static_cast<uint64_t>(unitsX));
+        if (scan.size() == 1) {
+            if (!DecodeBlock(bits, *scan[0], dc[0], coefficients)) return false;
+            StoreBlock(*scan[0], ux, uy, coefficients);
+            return true;
+        }
+        for (size_t k = 0; k < scan.size(); ++k) {
+            Component& c = *scan[k];
+            for (int y = 0; y < c.v; ++y) {
+                for (int x = 0; x < c.h; ++x) {
+                    if (!DecodeBlock(bits, c, dc[k], coefficients)) return false;
+                    StoreBlock(c, ux * c.h + x, uy * c.v + y, coefficients);
+                }
+            }
+        }
+        return true;
+    }
+
+    // Decodes the restart intervals starting at `starts` on up to threads_ threads, the calling
+    // one included. Intervals are handed out in small batches, so threads that drew the detailed
+    // parts of the image do not leave the others idle at the end. Every interval writes its own
+    // blocks of the planes. `pos` ends at the marker after the last interval.
+    bool DecodeIntervals(const std::vector<Component*>& scan, int unitsX, uint64_t units, const std::vector<size_t>& starts, size_t& pos) const {
+        const uint64_t intervals = starts.size();
+        const unsigned threads = static_cast<unsigned>(std::min<uint64_t>(threads_, intervals));
+        const uint64_t batch = std::max<uint64_t>(1, intervals / (static_cast<uint64_t>(threads) * 8));
+        std::atomic<uint64_t> next{ 0 };
+        std::atomic<bool> failed{ false };
+        size_t end = 0;
+        auto worker = [&] {
+            for (uint64_t first = next.fetch_add(batch); first < intervals && !failed; first = next.fetch_add(batch)) {
+                for (uint64_t k = first; k < std::min(first + batch, intervals); ++k) {
+                    if (Cancelled()) {
+                        failed = true;
+                        return;
+                    }
+                    BitReader bits(data_, size_, starts[k]);
+                    int dc[4] = {};
+                    const uint64_t last = std::min(units, (k + 1) * restartInterval_);
+                    for (uint64_t u = k * restartInterval_; u < last; ++u) {
+                        if (!DecodeUnit(bits, scan, unitsX, u, dc)) {
+                            failed = true;
+                            return;
+                        }
+                    }
+                    if (k == intervals - 1) end = bits.MarkerPosition();
+                }
+            }
+        };
+        RunOnThreads(threads, worker);
+        pos = end;
+        return !failed;
+    }
+
+    bool DecodeBlock(BitReader& bits, const Component& c, int& dcPredictor, int32_t* coefficients) const {
+        std::memset(coefficients, 0, 64 * sizeof(int32_t));
+        const uint16_t* q = quant_[c.quantTable];
+        const int t = bits.Decode(dcTables_[c.dcTable]);
+        if (t > 11) return false;
+        dcPredictor += bits.Receive(t);
+        coefficients[0] = dcPredictor * q[0];
+        const HuffmanTable& ac = acTables_[c.acTable];
+        for (int k = 1; k < 64;) {
+            const int rs = bits.Decode(ac);
+            const int run = rs >> 4;
+            const int s = rs & 15;
+            if (s) {
+                k += run;
+                if (k > 63) return false;
+                coefficients[kJpegNaturalOrder[k]] = bits.Receive(s) * q[k];
+                ++k;
+            } else if (run == 15) {
+                k += 16;
+            } else {
+                break;                                               // end of block
+            }
+        }
+        return !bits.Corrupt();
+    }
+
+    static void StoreBlock(Component& c, int bx, int by, const int32_t* coefficients) {
+        const size_t stride = static_cast<size_t>(c.blocksW) * 8;
+        JpegInverseDct(coefficients, c.plane.data() + static_cast<size_t>(by) * 8 * stride + static_cast<size_t>(bx) * 8, stride);
+    }
+
+    // Crops the padded planes and replicates subsampled chroma to full resolution. With several
+    // threads they take bands of rows: at about a tenth of a serial decode, this part would
+    // otherwise cap what splitting the scan gains.
+    void Output(PlanarImage& image) {
+        image.Allocate(width_, height_, static_cast<int>(components_.size()));
+        const int band = 64;
+        const int bands = (height_ + band - 1) / band;
+        std::atomic<int> next{ 0 };
+        RunOnThreads(std::min<unsigned>(threads_, static_cast<unsigned>(bands)), [&] {
+            for (int b = next++; b < bands; b = next++) OutputRows(image, b * band, std::min(height_, (b + 1) * band));
+        });
+    }
+
+    void OutputRows(PlanarImage& image, int y0, int y1) const {
+        for (size_t i = 0; i < components_.size(); ++i) {
+            const Component& c = components_[i];
+            const size_t stride = static_cast<size_t>(c.blocksW) * 8;
+            uint8_t* out = image.planes[i].data();
+            const int sx = hMax_ / c.h;
+            const int sy = vMax_ / c.v;
+            if (c.plane.empty()) {
+                std::memset(out + static_cast<size_t>(y0) * width_, 0, static_cast<size_t>(y1 - y0) * width_);
+                continue;
+            }
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* row = c.plane.data() + static_cast<size_t>(y / sy) * stride;
+                uint8_t* dst = out + static_cast<size_t>(y) * width_;
+                if (sx == 1) {
+                    std::memcpy(dst, row, static_cast<size_t>(width_));
+                } else if (sx == 2) {
+                    for (int x = 0; x + 1 < width_; x += 2) dst[x] = dst[x + 1] = row[x >> 1];
+                    if (width_ & 1) dst[width_ - 1] = row[width_ >> 1];
+                } else {
+                    for (int x = 0; x < width_; ++x) dst[x] = row[x / sx];
+                }
+            }
+        }
+    }
+
+    // Runs `work` on `threads` threads, the calling one and jobs on the pool, and returns when all
+    // are done
+    void RunOnThreads(unsigned threads, const std::function<void()>& work) const {
+        if (threads > 1) pool_->RunShared(threads - 1, work);
+        else work();
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    int width_ = 0, height_ = 0;
+    int hMax_ = 1, vMax_ = 1;
+    int mcusX_ = 0, mcusY_ = 0;
+    unsigned threads_;
+    WorkerPool* pool_;
+    const std::atomic<bool>* cancel_;
+    int restartInterval_ = 0;
+    int adobeTransform_ = -1;
+    bool scanned_ = false;
+    bool opening_ = false;
+    std::vector<Component> components_;
+    // Region decoding: components of the scan in coding order, where its data starts, the unit grid
+    std::vector<size_t> scan_;
+    size_t scanPos_ = 0;
+    int unitsX_ = 0, unitsY_ = 0;
+    int unitW_ = 8, unitH_ = 8;
+    HuffmanTable dcTables_[4];
+    HuffmanTable acTables_[4];
+    uint16_t quant_[4][64] = {};
+};
+
+} // namespace
+
+bool ReadJpegInfo(const uint8_t* data, size_t size, JpegInfo& info)
+{
+    std::string error;
+    info = JpegInfo();
+    Decoder decoder(data, size);
+    return decoder.Run(nullptr, info, error);
+}
+
+bool DecodeJpeg(const uint8_t* data, size_t size, PlanarImage& image, std::string* error)
+{
+    return DecodeJpeg(data, size, JpegDecodeOptions(), image, error);
+}
+
+bool DecodeJpeg(const uint8_t* data, size_t size, const JpegDecodeOptions& options, PlanarImage& image, std::string* error)
+{
+    std::string message;
+    JpegInfo info;
+    const unsigned threads = options.threads > 0 ? static_cast<unsigned>(options.threads) : std::max(1u, std::thread::hardware_concurrency());
+    Decoder decoder(data, size, threads, options.pool, options.cancel);
+    if (decoder.Run(&image, info, message)) return true;
+    if (error) *error = message;
+    return false;
+}
+
+struct JpegRegionDecoder::Impl {
+    Impl(const uint8_t* data, size_t size) : decoder(data, size) {}
+
+    Decoder decoder;
+    JpegInfo info;
+    std::vector<Decoder::Checkpoint> index;
+};
+
+JpegRegionDecoder::JpegRegionDecoder() = default;
+JpegRegionDecoder::~JpegRegionDecoder() = default;
+JpegRegionDecoder::JpegRegionDecoder(JpegRegionDecoder&&) noexcept = default;
+JpegRegionDecoder& JpegRegionDecoder::operator=(JpegRegionDecoder&&) noexcept = default;
+
+bool JpegRegionDecoder::Open(const uint8_t* data, size_t size, std::string* error)
+{
+    impl_.reset();
+    std::string message;
+    auto impl = std::make_unique<Impl>(data, size);
+    if (!impl->decoder.Open(impl->info, message) || !impl->decoder.BuildIndex(kIndexStride, impl->index, message)) {
+        if (error) *error = message;
+        return false;
+    }
+    impl_ = std::move(impl);
+    return true;
+}
+
+int JpegRegionDecoder::Width() const
+{
+    return impl_ ? impl_->info.width : 0;
+}
+
+int JpegRegionDecoder::Height() const
+{
+    return impl_ ? impl_->info.height : 0;
+}
+
+int JpegRegionDecoder::Channels() const
+{
+    return impl_ ? impl_->info.components : 0;
+}
+
+bool JpegRegionDecoder::DecodeRegion(int x, int y, int width, int height, int scaleLog2, PlanarImage& image, std::string* error) const
+{
+    std::string message = "not open";
+    if (impl_ && impl_->decoder.DecodeRegion(impl_->index, x, y, width, height, scaleLog2, image, message)) return true;
+    if (error) *error = message;
+    return false;
+}
+
+size_t JpegRegionDecoder::IndexEntries() const
+{
+    return impl_ ? impl_->index.size() : 0;
+}
+
+size_t JpegRegionDecoder::IndexBytes() const
+{
+    return impl_ ? impl_->index.capacity() * sizeof(Decoder::Checkpoint) : 0;
+}
@@ -0,0 +1,273 @@
+// JpegEncoder.cpp - baseline JPEG encoder with the standard Huffman tables
+#include "JpegCodec.h"
+#include "JpegTables.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct HuffmanCodes {
+    uint16_t code[256] = {};
+    uint8_t length[256] = {};
+
+    HuffmanCodes(const uint8_t counts[16], const uint8_t* values) {
+        uint16_t next = 0;
+        int k = 0;
+        for (int len = 1; len <= 16; ++len) {
+            for (int i = 0; i < counts[len - 1]; ++i, ++k) {
+                code[values[k]] = next++;
+                length[values[k]] = static_cast<uint8_t>(len);
+            }
+            next = static_cast<uint16_t>(next << 1);
+        }
+    }
+};
+
+const HuffmanCodes& DcLuma() { static const HuffmanCodes c(kJpegDcLumaCounts, kJpegDcLumaValues); return c; }
+const HuffmanCodes& AcLuma() { static const HuffmanCodes c(kJpegAcLumaCounts, kJpegAcLumaValues); return c; }
+const HuffmanCodes& DcChroma() { static const HuffmanCodes c(kJpegDcChromaCounts, kJpegDcChromaValues); return c; }
+const HuffmanCodes& AcChroma() { static const HuffmanCodes c(kJpegAcChromaCounts, kJpegAcChromaValues); return c; }
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void Put(uint32_t bits, int count) {
+        buffer_ = (buffer_ << count) | (bits & ((1u << count) - 1));
+        count_ += count;
+        while (count_ >= 8) {
+            const uint8_t byte = static_cast<uint8_t>(buffer_ >> (count_ - 8));
+            out_.push_back(byte);
+            if (byte == 0xFF) out_.push_back(0x00);                  // byte stuffing
+            count_ -= 8;
+        }
+    }
+    // Pads the last byte with 1 bits
+    void Flush() {
+        if (count_ > 0) Put(0x7F, 8 - count_);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t buffer_ = 0;
+    int count_ = 0;
+};
+
+struct Plane {
+    int width = 0, height = 0;           // padded to whole MCUs
+    PixelPlane samples;
+};
+
+// Copies a width x height plane into a padded plane, replicating the right and bottom edges
+Plane PadPlane(const uint8_t* src, int width, int height, int paddedW, int paddedH)
+{
+    Plane plane{ paddedW, paddedH, PixelPlane(static_cast<size_t>(paddedW) * paddedH) };
+    for (int y = 0; y < paddedH; ++y) {
+        const uint8_t* row = src + static_cast<size_t>(std::min(y, height - 1)) * width;
+        uint8_t* dst = plane.samples.data() + static_cast<size_t>(y) * paddedW;
+        std::copy(row, row + width, dst);
+        std::fill(dst + width, dst + paddedW, row[width - 1]);
+    }
+    return plane;
+}
+
+// 2x2 box average to a padded half resolution plane
+Plane HalvePlane(const uint8_t* src, int width, int height, int paddedW, int paddedH)
+{
+    Plane plane{ paddedW, paddedH, PixelPlane(static_cast<size_t>(paddedW) * paddedH) };
+    const int halfW = (width + 1) / 2;
+    const int halfH = (height + 1) / 2;
+    for (int y = 0; y < paddedH; ++y) {
+        const int sy = std::min(y, halfH - 1) * 2;
+        const uint8_t* r0 = src + static_cast<size_t>(sy) * width;
+        const uint8_t* r1 = src + static_cast<size_t>(std::min(sy + 1, height - 1)) * width;
+        uint8_t* dst = plane.samples.data() + static_cast<size_t>(y) * paddedW;
+        for (int x = 0; x < paddedW; ++x) {
+            const int sx = std::min(x, halfW - 1) * 2;
+            const int sx1 = std::min(sx + 1, width - 1);
+            dst[x] = static_cast<uint8_t>((r0[sx] + r0[sx1] + r1[sx] + r1[sx1] + 2) >> 2);
+        }
+    }
+    return plane;
+}
+
+void ScaleQuantTable(const uint8_t* base, int quality, uint8_t* out)
+{
+    quality = std::clamp(quality, 1, 100);
+    const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; ++i) out[i] = static_cast<uint8_t>(std::clamp((base[i] * scale + 50) / 100, 1, 255));
+}
+
+int Category(int value)
+{
+    int magnitude = value < 0 ? -value : value;
+    int bits = 0;
+    while (magnitude) { ++bits; magnitude >>= 1; }
+    return bits;
+}
+
+void EncodeBlock(BitWriter& bits, const uint8_t* samples, size_t stride, const uint8_t* quant, int& dcPredictor,
+                 const HuffmanCodes& dc, const HuffmanCodes& ac)
+{
+    float coefficients[64];
+    JpegForwardDct(samples, stride, coefficients);
+    int zigzag[64];
+    for (int k = 0; k < 64; ++k) {
+        const int natural = kJpegNaturalOrder[k];
+        zigzag[k] = static_cast<int>(std::lround(coefficients[natural] / static_cast<float>(quant[natural])));
+    }
+
+    const int diff = zigzag[0] - dcPredictor;
+    dcPredictor = zigzag[0];
+    const int dcBits = Category(diff);
+    bits.Put(dc.code[dcBits], dc.length[dcBits]);
+    if (dcBits) bits.Put(static_cast<uint32_t>(diff < 0 ? diff - 1 : diff), dcBits);
+
+    int run = 0;
+    for (int k = 1; k < 64; ++k) {
+        const int value = zigzag[k];
+        if (value == 0) { ++run; continue; }
+        while (run > 15) {
+            bits.Put(ac.code[0xF0], ac.length[0xF0]);                // ZRL
+            run -= 16;
+        }
+        const int size = Category(value);
+        const int symbol = (run << 4) | size;
+        bits.Put(ac.code[symbol], ac.length[symbol]);
+        bits.Put(static_cast<uint32_t>(value < 0 ? value - 1 : value), size);
+        run = 0;
+    }
+    if (run) bits.Put(ac.code[0x00], ac.length[0x00]);               // EOB
+}
+
+void PutMarker(std::vector<uint8_t>& out, uint8_t marker, size_t length)
+{
+    out.push_back(0xFF);
+    out.push_back(marker);
+    out.push_back(static_cast<uint8_t>((length + 2) >> 8));
+    out.push_back(static_cast<uint8_t>((length + 2) & 0xFF));
+}
+
+void PutHuffmanTable(std::vector<uint8_t>& out, uint8_t classAndId, const uint8_t* counts, const uint8_t* values, size_t valueCount)
+{
+    out.push_back(classAndId);
+    out.insert(out.end(), counts, counts + 16);
+    out.insert(out.end(), values, values + valueCount);
+}
+
+} // namespace
+
+bool EncodeJpeg(const PlanarImage& image, const JpegEncodeOptions& options, std::vector<uint8_t>& out)
+{
+    if (image.width <= 0 || image.height <= 0 || image.width > 65535 || image.height > 65535) return false;
+    if (image.channels != 1 && image.channels != 3) return false;
+    const bool color = image.channels == 3;
+    const bool subsample = color && options.subsampleChroma;
+    const int mcuSize = subsample ? 16 : 8;
+    const int mcusX = (image.width + mcuSize - 1) / mcuSize;
+    const int mcusY = (image.height + mcuSize - 1) / mcuSize;
+
+    uint8_t quant[2][64];
+    ScaleQuantTable(kJpegLumaQuant, options.quality, quant[0]);
+    ScaleQuantTable(kJpegChromaQuant, options.quality, quant[1]);
+
+    out.clear();
+    out.reserve(static_cast<size_t>(image.width) * image.height / 4 + 1024);
+    out.push_back(0xFF);
+    out.push_back(0xD8);
+    for (const auto& segment : options.segments) out.insert(out.end(), segment.begin(), segment.end());
+
+    // DQT (zigzag order)
+    const int tableCount = color ? 2 : 1;
+    PutMarker(out, 0xDB, static_cast<size_t>(tableCount) * 65);
+    for (int t = 0; t < tableCount; ++t) {
+        out.push_back(static_cast<uint8_t>(t));
+        for (int k = 0; k < 64; ++k) out.push_back(quant[t][kJpegNaturalOrder[k]]);
+    }
+
+    // SOF0
+    PutMarker(out, 0xC0, 6 + static_cast<size_t>(image.channels) * 3);
+    out.push_back(8);
+    out.push_back(static_cast<uint8_t>(image.height >> 8));
+    out.push_back(static_cast<uint8_t>(image.height & 0xFF));
+    out.push_back(static_cast<uint8_t>(image.width >> 8));
+    out.push_back(static_cast<uint8_t>(image.width & 0xFF));
+    out.push_back(static_cast<uint8_t>(image.channels));
+    for (int c = 0; c < image.channels; ++c) {
+        out.push_back(static_cast<uint8_t>(c + 1));
+        out.push_back(c == 0 && subsample ? 0x22 : 0x11);
+        out.push_back(c == 0 ? 0 : 1);
+    }
+
+    // DHT
+    size_t dhtLength = 2 * 17 + 12 + 162;
+    if (color) dhtLength *= 2;
+    PutMarker(out, 0xC4, dhtLength);
+    PutHuffmanTable(out, 0x00, kJpegDcLumaCounts, kJpegDcLumaValues, 12);
+    PutHuffmanTable(out, 0x10, kJpegAcLumaCounts, kJpegAcLumaValues, 162);
+    if (color) {
+        PutHuffmanTable(out, 0x01, kJpegDcChromaCounts, kJpegDcChromaValues, 12);
+        PutHuffmanTable(out, 0x11, kJpegAcChromaCounts, kJpegAcChromaValues, 162);
+    }
+
+    // DRI
+    const int restartInterval = std::clamp(options.restartInterval, 0, 65535);
+    if (restartInterval > 0) {
+        PutMarker(out, 0xDD, 2);
+        out.push_back(static_cast<uint8_t>(restartInterval >> 8));
+        out.push_back(static_cast<uint8_t>(restartInterval & 0xFF));
+    }
+
+    // SOS
+    PutMarker(out, 0xDA, 4 + static_cast<size_t>(image.channels) * 2);
+    out.push_back(static_cast<uint8_t>(image.channels));
+    for (int c = 0; c < image.channels; ++c) {
+        out.push_back(static_cast<uint8_t>(c + 1));
+        out.push_back(c == 0 ? 0x00 : 0x11);
+    }
+    out.push_back(0);
+    out.push_back(63);
+    out.push_back(0);
+
+    Plane planes[3];
+    planes[0] = PadPlane(image.planes[0].data(), image.width, image.height, mcusX * mcuSize, mcusY * mcuSize);
+    for (int c = 1; c < image.channels; ++c) {
+        planes[c] = subsample ? HalvePlane(image.planes[c].data(), image.width, image.height, mcusX * 8, mcusY * 8)
+                              : PadPlane(image.planes[c].data(), image.width, image.height, mcusX * 8, mcusY * 8);
+    }
+
+    BitWriter bits(out);
+    int dcPredictors[3] = {};
+    int untilRestart = restartInterval;
+    int restarts = 0;
+    for (int my = 0; my < mcusY; ++my) {
+        for (int mx = 0; mx < mcusX; ++mx) {
+            const Plane& y = planes[0];
+            const size_t yStride = static_cast<size_t>(y.width);
+            for (int by = 0; by < mcuSize; by += 8) {
+                for (int bx = 0; bx < mcuSize; bx += 8) {
+                    const uint8_t* block = y.samples.data() + static_cast<size_t>(my * mcuSize + by) * yStride + mx * mcuSize + bx;
+                    EncodeBlock(bits, block, yStride, quant[0], dcPredictors[0], DcLuma(), AcLuma());
+                }
+            }
+            for (int c = 1; c < image.channels; ++c) {
+                const Plane& p = planes[c];
+                const size_t stride = static_cast<size_t>(p.width);
+                const uint8_t* block = p.samples.data() + static_cast<size_t>(my * 8) * stride + mx * 8;
+                EncodeBlock(bits, block, stride, quant[1], dcPredictors[c], DcChroma(), AcChroma());
+            }
+            if (restartInterval > 0 && --untilRestart == 0 && (my != mcusY - 1 || mx != mcusX - 1)) {
+                bits.Flush();
+                out.push_back(0xFF);
+                out.push_back(static_cast<uint8_t>(0xD0 + (restarts++ & 7)));
+                std::fill(std::begin(dcPredictors), std::end(dcPredictors), 0);
+                untilRestart = restartInterval;
+            }
+        }
+    }
+    bits.Flush();
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+    return true;
+}
@@ -0,0 +1,213 @@
+// JpegFile.cpp - JPEG segment, MPF and XMP helpers
+#include "JpegFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kXmpSignature[] = "http://ns.adobe.com/xap/1.0/";          // followed by a NUL byte
+const char kIsoGainMapSignature[] = "urn:iso:std:iso:ts:21496:-1";    // followed by a NUL byte
+
+bool PayloadStartsWith(const uint8_t* data, const JpegSegment& segment, const char* signature, size_t length)
+{
+    return segment.PayloadSize() >= length && std::memcmp(data + segment.PayloadOffset(), signature, length) == 0;
+}
+
+uint32_t ReadTiff32(const uint8_t* p, bool bigEndian)
+{
+    return bigEndian ? (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]
+                     : (uint32_t(p[3]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[1]) << 8) | p[0];
+}
+
+uint16_t ReadTiff16(const uint8_t* p, bool bigEndian)
+{
+    return static_cast<uint16_t>(bigEndian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0]);
+}
+
+void Put16(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void Put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    Put16(out, v >> 16);
+    Put16(out, v & 0xFFFF);
+}
+
+} // namespace
+
+bool ReadJpegSegments(const uint8_t* data, size_t size, std::vector<JpegSegment>& segments)
+{
+    segments.clear();
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+    size_t pos = 2;
+    while (pos + 1 < size) {
+        if (data[pos] != 0xFF) return false;
+        while (pos < size && data[pos] == 0xFF) ++pos;                 // fill bytes
+        if (pos >= size) return false;
+        const uint8_t marker = data[pos++];
+        if (marker == 0xDA || marker == 0xD9) return true;
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+        if (pos + 2 > size) return false;
+        const size_t length = (static_cast<size_t>(data[pos]) << 8) | data[pos + 1];
+        if (length < 2 || pos + length > size) return false;
+        segments.push_back({ marker, pos - 2, length + 2 });
+        pos += length;
+    }
+    return false;
+}
+
+bool IsMpfSegment(const uint8_t* data, const JpegSegment& segment)
+{
+    return segment.marker == 0xE2 && PayloadStartsWith(data, segment, "MPF", 4);
+}
+
+bool IsXmpSegment(const uint8_t* data, const JpegSegment& segment)
+{
+    return segment.marker == 0xE1 && PayloadStartsWith(data, segment, kXmpSignature, sizeof(kXmpSignature));
+}
+
+bool IsGainMapMetadataSegment(const uint8_t* data, const JpegSegment& segment)
+{
+    if (segment.marker == 0xE2) return PayloadStartsWith(data, segment, kIsoGainMapSignature, sizeof(kIsoGainMapSignature));
+    if (!IsXmpSegment(data, segment)) return false;
+    return XmpPacket(data, segment).find("hdrgm:Version") != std::string::npos;
+}
+
+bool ReadMpfImages(const uint8_t* data, size_t size, std::vector<MpfImage>& images, size_t fileSize)
+{
+    images.clear();
+    if (fileSize < size) fileSize = size;
+    std::vector<JpegSegment> segments;
+    ReadJpegSegments(data, size, segments);
+    for (const JpegSegment& segment : segments) {
+        if (!IsMpfSegment(data, segment)) continue;
+        const uint8_t* tiff = data + segment.PayloadOffset() + 4;
+        const size_t tiffSize = segment.PayloadSize() - 4;
+        const size_t tiffStart = segment.PayloadOffset() + 4;
+        if (tiffSize < 8) return false;
+        bool bigEndian;
+        if (tiff[0] == 'M' && tiff[1] == 'M') bigEndian = true;
+        else if (tiff[0] == 'I' && tiff[1] == 'I') bigEndian = false;
+        else return false;
+        // Offsets are widened before adding, so one near 4 GB cannot wrap past the bounds check
+        const size_t ifd = ReadTiff32(tiff + 4, bigEndian);
+        if (ifd + 2 > tiffSize) return false;
+        const uint16_t count = ReadTiff16(tiff + ifd, bigEndian);
+        if (ifd + 2 + static_cast<size_t>(count) * 12 > tiffSize) return false;
+        for (uint16_t i = 0; i < count; ++i) {
+            const uint8_t* entry = tiff + ifd + 2 + i * 12;
+            if (ReadTiff16(entry, bigEndian) != 0xB002) continue;      // MPEntry
+            const uint32_t bytes = ReadTiff32(entry + 4, bigEndian);
+            const size_t offset = ReadTiff32(entry + 8, bigEndian);
+            if (bytes % 16 || bytes == 0 || offset + bytes > tiffSize) return false;
+            for (uint32_t e = 0; e < bytes / 16; ++e) {
+                const uint8_t* mp = tiff + offset + e * 16;
+                MpfImage image;
+                image.attribute = ReadTiff32(mp, bigEndian);
+                image.size = ReadTiff32(mp + 4, bigEndian);
+                const size_t imageOffset = ReadTiff32(mp + 8, bigEndian);
+                // The first image starts at SOI; the others are relative to the MPF TIFF header
+                image.offset = e == 0 ? 0 : tiffStart + imageOffset;
+                if (image.offset + image.size > fileSize || image.size == 0) return false;
+                images.push_back(image);
+            }
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+std::vector<uint8_t> BuildMpfSegment(uint32_t primarySize, uint32_t gainMapSize, uint32_t gainMapOffset)
+{
+    // Big-endian TIFF with one IFD of three entries, followed by two MP Entries
+    const uint32_t ifdOffset = 8;
+    const uint32_t entriesOffset = ifdOffset + 2 + 3 * 12 + 4;
+    std::vector<uint8_t> payload = { 'M', 'P', 'F', 0, 'M', 'M', 0x00, 0x2A };
+    Put32(payload, ifdOffset);
+    Put16(payload, 3);
+    Put16(payload, 0xB000); Put16(payload, 7); Put32(payload, 4);           // MPFVersion "0100"
+    payload.insert(payload.end(), { '0', '1', '0', '0' });
+    Put16(payload, 0xB001); Put16(payload, 4); Put32(payload, 1); Put32(payload, 2);   // NumberOfImages
+    Put16(payload, 0xB002); Put16(payload, 7); Put32(payload, 32); Put32(payload, entriesOffset);
+    Put32(payload, 0);                                                       // no next IFD
+    Put32(payload, 0x00030000);                                              // baseline primary image
+    Put32(payload, primarySize);
+    Put32(payload, 0);
+    Put32(payload, 0);
+    Put32(payload, 0);                                                       // gain map: undefined type
+    Put32(payload, gainMapSize);
+    Put32(payload, gainMapOffset);
+    Put32(payload, 0);
+
+    std::vector<uint8_t> segment = { 0xFF, 0xE2 };
+    Put16(segment, static_cast<uint32_t>(payload.size() + 2));
+    segment.insert(segment.end(), payload.begin(), payload.end());
+    return segment;
+}
+
+std::string XmpPacket(const uint8_t* data, const JpegSegment& segment)
+{
+    const size_t header = sizeof(kXmpSignature);
+    if (segment.PayloadSize() < header) return std::string();
+    return std::string(reinterpret_cast<const char*>(data + segment.PayloadOffset() + header), segment.PayloadSize() - header);
+}
+
+std::vector<uint8_t> BuildXmpSegment(const std::string& packet)
+{
+    std::vector<uint8_t> segment = { 0xFF, 0xE1 };
+    Put16(segment, static_cast<uint32_t>(2 + sizeof(kXmpSignature) + packet.size()));
+    segment.insert(segment.end(), kXmpSignature, kXmpSignature + sizeof(kXmpSignature));
+    segment.insert(segment.end(), packet.begin(), packet.end());
+    return segment;
+}
+
+bool XmpProperty(const std::string& packet, const std::string& name, std::string& value)
+{
+    const size_t attribute = packet.find(name + "=\"");
+    if (attribute != std::string::npos) {
+        const size_t start = attribute + name.size() + 2;
+        const size_t end = packet.find('"', start);
+        if (end == std::string::npos) return false;
+        value = packet.substr(start, end - start);
+        return true;
+    }
+    const size_t element = packet.find("<" + name + ">");
+    if (element == std::string::npos) return false;
+    size_t start = element + name.size() + 2;
+    const size_t close = packet.find("</" + name + ">", start);
+    if (close == std::string::npos) return false;
+    const size_t li = packet.find("<rdf:li>", start);
+    if (li != std::string::npos && li < close) start = li + 8;
+    const size_t end = packet.find('<', start);
+    value = packet.substr(start, std::min(end, close) - start);
+    const size_t first = value.find_first_not_of(" \t\r\n");
+    const size_t last = value.find_last_not_of(" \t\r\n");
+    value = first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+    return true;
+}
+
+bool SetXmpItemLength(std::string& packet, const std::string& semantic, size_t length)
+{
+    const std::string attribute = "Item:Semantic=\"" + semantic + "\"";
+    const size_t at = packet.find(attribute);
+    if (at == std::string::npos) return false;
+    const size_t elementStart = packet.rfind('<', at);
+    const size_t elementEnd = packet.find('>', at);
+    if (elementStart == std::string::npos || elementEnd == std::string::npos) return false;
+    const std::string value = std::to_string(length);
+    const size_t existing = packet.find("Item:Length=\"", elementStart);
+    if (existing != std::string::npos && existing < elementEnd) {
+        const size_t valueStart = existing + 13;
+        const size_t valueEnd = packet.find('"', valueStart);
+        if (valueEnd == std::string::npos || valueEnd > elementEnd) return false;
+        packet.replace(valueStart, valueEnd - valueStart, value);
+    } else {
+        packet.insert(at + attribute.size(), " Item:Length=\"" + value + "\"");
+    }
+    return true;
+}
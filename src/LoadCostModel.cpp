@@ -0,0 +1,101 @@
+// LoadCostModel.cpp - per format and size class load and render time estimates
+
+#include "LoadCostModel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+
+namespace {
+
+// Reads before the first one is measured: 50 MB/s
+const double kPriorReadMicrosPerMegabyte = 20000.0;
+
+double Megabytes(uint64_t bytes)
+{
+    // Every file costs at least what 64 KB does: opening it is not free
+    return std::max<uint64_t>(bytes, 64 * 1024) / 1048576.0;
+}
+
+} // namespace
+
+const char* LoadStageName(LoadStage stage)
+{
+    switch (stage) {
+    case LoadStage::Read: return "read";
+    case LoadStage::Render: return "render";
+    }
+    return "unknown";
+}
+
+void LoadCostModel::Average::Add(double value)
+{
+    if (samples++ == 0) {
+        mean = value;
+        deviation = value / 2;
+        return;
+    }
+    deviation += (std::abs(value - mean) - deviation) / 4;
+    mean += (value - mean) / 8;
+}
+
+size_t LoadCostModel::SizeClass(uint64_t bytes)
+{
+    size_t sizeClass = 0;
+    for (uint64_t limit = 64 * 1024; bytes >= limit && sizeClass + 1 < kSizeClasses; limit *= 2) ++sizeClass;
+    return sizeClass;
+}
+
+std::string LoadCostModel::FormatOf(const std::wstring& path)
+{
+    std::string format;
+    const std::wstring extension = std::filesystem::path(path).extension().wstring();
+    for (size_t i = extension.empty() ? 0 : 1; i < extension.size(); ++i) {
+        const wchar_t c = extension[i];
+        format += static_cast<char>(c < 0x80 ? std::tolower(static_cast<int>(c)) : '?');
+    }
+    return format;
+}
+
+void LoadCostModel::Record(const CatalogEntry& entry, LoadStage stage, Duration duration)
+{
+    const double micros = static_cast<double>(duration.count());
+    const size_t s = static_cast<size_t>(stage);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Format& format = formats_[FormatOf(entry.path)];
+    format.classes[s][SizeClass(entry.fileSize)].Add(micros);
+    format.perMegabyte[s].Add(micros / Megabytes(entry.fileSize));
+    perMegabyte_[s].Add(micros / Megabytes(entry.fileSize));
+}
+
+LoadCostModel::Duration LoadCostModel::Estimate(const CatalogEntry& entry, LoadStage stage) const
+{
+    const size_t s = static_cast<size_t>(stage);
+    double micros = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = formats_.find(FormatOf(entry.path));
+        if (it != formats_.end() && it->second.classes[s][SizeClass(entry.fileSize)].samples > 0) {
+            micros = it->second.classes[s][SizeClass(entry.fileSize)].Estimate();
+        } else if (it != formats_.end() && it->second.perMegabyte[s].samples > 0) {
+            micros = it->second.perMegabyte[s].Estimate() * Megabytes(entry.fileSize);
+        } else if (perMegabyte_[s].samples > 0) {
+            micros = perMegabyte_[s].Estimate() * Megabytes(entry.fileSize);
+        } else if (stage == LoadStage::Read) {
+            micros = kPriorReadMicrosPerMegabyte * Megabytes(entry.fileSize);
+        }
+    }
+    return Duration(static_cast<int64_t>(micros));
+}
+
+LoadCostModel::Duration LoadCostModel::Estimate(const CatalogEntry& entry) const
+{
+    return Estimate(entry, LoadStage::Read) + Estimate(entry, LoadStage::Render);
+}
+
+uint64_t LoadCostModel::Samples(LoadStage stage) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return perMegabyte_[static_cast<size_t>(stage)].samples;
+}
@@ -0,0 +1,191 @@
+// Logger.cpp - text and binary log sinks
+
+#include "Logger.h"
+
+#include <thread>
+
+// Converts a wide string to UTF-8 (wchar_t is UTF-16 on Windows and UTF-32 elsewhere).
+static std::string WideToUtf8(std::wstring_view s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        uint32_t c = static_cast<uint32_t>(s[i]);
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < s.size()) {
+            uint32_t lo = static_cast<uint32_t>(s[i + 1]);
+            if (lo >= 0xDC00 && lo < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                ++i;
+            }
+        }
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+Logger::~Logger()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FlushBinaryLocked();
+    if (binfile_.is_open()) binfile_.close();
+    if (logfile_.is_open()) logfile_.close();
+}
+
+void Logger::UpdateSinks()
+{
+    int sinks = 0;
+    if (consoleEnabled_) sinks |= kConsoleSink;
+    if (logFileEnabled_ && logfile_.is_open()) sinks |= kTextFileSink;
+    if (logFileEnabled_ && binfile_.is_open()) sinks |= kBinarySink;
+    sinks_.store(sinks, std::memory_order_relaxed);
+}
+
+void Logger::Configure(bool enableLogFile, const std::wstring& path, bool binaryFormat)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FlushBinaryLocked();
+    if (logfile_.is_open()) logfile_.close();
+    if (binfile_.is_open()) binfile_.close();
+    logFileEnabled_ = enableLogFile;
+    if (logFileEnabled_ && !path.empty()) {
+        if (binaryFormat) {
+            std::filesystem::path binPath(path);
+            binPath.replace_extension(L".hdrlog");
+            binfile_.open(binPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!binfile_.is_open()) {
+                std::wcout << L"[Logger] Failed to open binary log file: " << binPath.wstring() << std::endl;
+            } else {
+                LogRecordBuffer header;
+                header.bytes.reserve(24);
+                header.Put(LogBinary::kMagic, sizeof(LogBinary::kMagic));
+                header.PutValue<uint16_t>(LogBinary::kVersion);
+                header.PutValue<uint8_t>(static_cast<uint8_t>(sizeof(wchar_t)));
+                header.PutValue<uint8_t>(0);
+                header.PutValue<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(startWall_.time_since_epoch()).count());
+                binbuf_ = std::move(header.bytes);
+                // Call sites registered before the file was opened still need their definitions
+                for (size_t i = 0; i < formats_.size(); ++i) WriteFormatDef(i);
+            }
+        } else {
+            logfile_.open(std::filesystem::path(path), std::ios::out | std::ios::app);
+            if (!logfile_.is_open()) {
+                std::wcout << L"[Logger] Failed to open log file: " << path << std::endl;
+            }
+        }
+    }
+    UpdateSinks();
+}
+
+void Logger::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FlushBinaryLocked();
+}
+
+void Logger::FlushBinaryLocked()
+{
+    if (binfile_.is_open() && !binbuf_.empty()) {
+        binfile_.write(reinterpret_cast<const char*>(binbuf_.data()), static_cast<std::streamsize>(binbuf_.size()));
+        binfile_.flush();
+    }
+    binbuf_.clear();
+}
+
+uint64_t Logger::MicrosSinceStart() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count());
+}
+
+uint32_t Logger::ThreadIndex()
+{
+    static std::atomic<uint32_t> nextIndex{ 1 };
+    thread_local uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+uint16_t Logger::RegisterFormat(LogLevel level, LogCategory category, const char* file, int line, const wchar_t* format)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Id 0 is reserved; ids are 1-based indices into formats_
+    if (formats_.size() >= 0xFFFF) return 0;
+    std::string fileName = std::filesystem::path(file).filename().string();
+    formats_.push_back({ level, category, fileName, line, format });
+    WriteFormatDef(formats_.size() - 1);
+    return static_cast<uint16_t>(formats_.size());
+}
+
+void Logger::WriteFormatDef(size_t index)
+{
+    if (!binfile_.is_open()) return;
+    const FormatDef& def = formats_[index];
+    const std::string fmt = WideToUtf8(def.format);
+    LogRecordBuffer record;
+    record.bytes.reserve(16 + def.file.size() + fmt.size());
+    record.PutValue<uint8_t>(LogBinary::FormatDef);
+    record.PutValue<uint16_t>(static_cast<uint16_t>(index + 1));
+    record.PutValue<uint8_t>(static_cast<uint8_t>(def.level));
+    record.PutValue<uint8_t>(static_cast<uint8_t>(def.category));
+    record.PutValue<uint32_t>(static_cast<uint32_t>(def.line));
+    record.PutValue<uint16_t>(static_cast<uint16_t>(def.file.size()));
+    record.Put(def.file.data(), def.file.size());
+    record.PutValue<uint32_t>(static_cast<uint32_t>(fmt.size()));
+    record.Put(fmt.data(), fmt.size());
+    binbuf_.insert(binbuf_.end(), record.bytes.begin(), record.bytes.end());
+}
+
+void Logger::WriteBinary(const LogRecordBuffer& record, LogLevel level)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!binfile_.is_open()) return;
+    binbuf_.insert(binbuf_.end(), record.bytes.begin(), record.bytes.end());
+    // Warnings and errors are written through immediately so they survive a crash; everything
+    // else at least once per second
+    const auto now = std::chrono::steady_clock::now();
+    if (binbuf_.size() >= 64 * 1024 || level >= LogLevel::Warn || now - lastFlush_ >= std::chrono::seconds(1)) {
+        FlushBinaryLocked();
+        lastFlush_ = now;
+    }
+}
+
+void Logger::WriteText(LogLevel level, LogCategory category, const std::wstring& msg)
+{
+    const int sinks = sinks_.load(std::memory_order_relaxed);
+    if (sinks & kBinarySink) {
+        LogRecordBuffer record;
+        record.bytes.reserve(24 + msg.size() * sizeof(wchar_t));
+        record.PutValue<uint8_t>(LogBinary::Text);
+        record.PutValue<uint8_t>(static_cast<uint8_t>(level));
+        record.PutValue<uint8_t>(static_cast<uint8_t>(category));
+        record.PutValue<uint64_t>(MicrosSinceStart());
+        record.PutValue<uint32_t>(ThreadIndex());
+        record.PutValue<uint32_t>(static_cast<uint32_t>(msg.size()));
+        record.Put(msg.data(), msg.size() * sizeof(wchar_t));
+        WriteBinary(record, level);
+    }
+    if (sinks & (kConsoleSink | kTextFileSink)) {
+        WriteTextOnly(msg);
+    }
+}
+
+void Logger::WriteTextOnly(const std::wstring& msg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (consoleEnabled_) std::wcout << msg << std::endl;
+    if (logFileEnabled_ && logfile_.is_open()) {
+        logfile_ << msg << std::endl;
+    }
+}
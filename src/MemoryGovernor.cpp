@@ -0,0 +1,282 @@
+// MemoryGovernor.cpp - budget split across memory consumers and pressure polling
+
+#include "MemoryGovernor.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+
+double Megabytes(uint64_t bytes)
+{
+    return bytes / 1048576.0;
+}
+
+// Value of `key=` in a PSI line, or -1
+double PsiField(const std::string& line, const char* key)
+{
+    const size_t pos = line.find(key);
+    return pos == std::string::npos ? -1.0 : std::atof(line.c_str() + pos + std::strlen(key));
+}
+
+} // namespace
+
+const char* MemoryPriorityName(MemoryPriority priority)
+{
+    switch (priority) {
+    case MemoryPriority::Idle: return "idle";
+    case MemoryPriority::Prefetch: return "prefetch";
+    case MemoryPriority::Working: return "working";
+    }
+    return "unknown";
+}
+
+const char* MemoryPressureName(MemoryPressure pressure)
+{
+    switch (pressure) {
+    case MemoryPressure::None: return "none";
+    case MemoryPressure::Moderate: return "moderate";
+    case MemoryPressure::Critical: return "critical";
+    }
+    return "unknown";
+}
+
+MemoryGovernor::MemoryGovernor(uint64_t budgetBytes)
+    : budget_(budgetBytes),
+      pressureSource_(SystemMemoryPressure),
+      budgetGauge_(Metrics::Instance().GetGauge("hdr_memory_budget_bytes", "Memory budget shared by the caches and pools")),
+      pressureGauge_(Metrics::Instance().GetGauge("hdr_memory_pressure", "System memory pressure: 0 none, 1 moderate, 2 critical"))
+{
+    budgetGauge_.Set(static_cast<int64_t>(budget_));
+}
+
+size_t MemoryGovernor::Register(MemoryConsumer consumer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Slot slot{ nextId_++, std::move(consumer) };
+    const MetricLabels labels = { { "consumer", slot.consumer.name } };
+    slot.usageGauge = &Metrics::Instance().GetGauge("hdr_memory_consumer_bytes", "Memory used by a consumer of the memory budget", labels);
+    if (slot.consumer.setBudget) {
+        slot.budgetGauge = &Metrics::Instance().GetGauge("hdr_memory_consumer_budget_bytes", "Share of the memory budget given to a consumer", labels);
+    }
+    slots_.push_back(std::move(slot));
+    RebalanceLocked();
+    return slots_.back().id;
+}
+
+void MemoryGovernor::Unregister(size_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.erase(std::remove_if(slots_.begin(), slots_.end(), [id](const Slot& s) { return s.id == id; }), slots_.end());
+    RebalanceLocked();
+}
+
+void MemoryGovernor::SetBudget(uint64_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budgetBytes;
+    budgetGauge_.Set(static_cast<int64_t>(budget_));
+    RebalanceLocked();
+}
+
+uint64_t MemoryGovernor::Budget() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+void MemoryGovernor::Rebalance()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    RebalanceLocked();
+}
+
+void MemoryGovernor::Poll(Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now < nextPoll_) return;
+    nextPoll_ = now + pollInterval_;
+
+    const MemoryPressure pressure = pressureSource_ ? pressureSource_() : MemoryPressure::None;
+    if (pressure != pressure_) {
+        if (pressure > pressure_) {
+            LOG_FMT(LogLevel::Warn, LogCategory::General, L"MemoryGovernor: memory pressure {} -> {}", MemoryPressureName(pressure_), MemoryPressureName(pressure));
+        } else {
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"MemoryGovernor: memory pressure {} -> {}", MemoryPressureName(pressure_), MemoryPressureName(pressure));
+        }
+        pressure_ = pressure;
+        pressureGauge_.Set(static_cast<int64_t>(pressure_));
+        RebalanceLocked();
+        return;
+    }
+    uint64_t fixed = 0;
+    for (Slot& slot : slots_) {
+        slot.usage = slot.consumer.usage ? slot.consumer.usage() : 0;
+        slot.usageGauge->Set(static_cast<int64_t>(slot.usage));
+        if (!slot.consumer.setBudget) fixed += slot.usage;
+    }
+    const uint64_t moved = fixed > lastFixed_ ? fixed - lastFixed_ : lastFixed_ - fixed;
+    if (moved > budget_ / 64) RebalanceLocked();
+}
+
+void MemoryGovernor::SetPollInterval(std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pollInterval_ = interval;
+    nextPoll_ = Clock::time_point{};
+}
+
+std::chrono::milliseconds MemoryGovernor::PollInterval() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pollInterval_;
+}
+
+void MemoryGovernor::SetPressureSource(std::function<MemoryPressure()> source)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pressureSource_ = std::move(source);
+    nextPoll_ = Clock::time_point{};
+}
+
+MemoryPressure MemoryGovernor::Pressure() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pressure_;
+}
+
+std::vector<MemoryAccount> MemoryGovernor::Accounting() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<MemoryAccount> accounts;
+    accounts.reserve(slots_.size());
+    for (const Slot& slot : slots_) {
+        const bool elastic = static_cast<bool>(slot.consumer.setBudget);
+        accounts.push_back({ slot.consumer.name, slot.consumer.priority, elastic, slot.usage, elastic ? slot.budget : slot.usage });
+    }
+    return accounts;
+}
+
+uint64_t MemoryGovernor::UsedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t used = 0;
+    for (const Slot& slot : slots_) used += slot.usage;
+    return used;
+}
+
+void MemoryGovernor::LogAccounting(LogLevel level) const
+{
+    // The level is a parameter, so this goes past the LOG_AT macros to the logger
+    Logger& logger = Logger::Instance();
+    if (!logger.IsEnabled(level, LogCategory::General)) return;
+    const std::vector<MemoryAccount> accounts = Accounting();
+    uint64_t used = 0;
+    for (const MemoryAccount& account : accounts) used += account.usage;
+    logger.LogAt(level, LogCategory::General, L"MemoryGovernor: ", Megabytes(used), L" of ", Megabytes(Budget()), L" MB used, pressure ",
+                 MemoryPressureName(Pressure()));
+    for (const MemoryAccount& account : accounts) {
+        if (account.elastic) {
+            logger.LogAt(level, LogCategory::General, L"MemoryGovernor:   ", account.name.c_str(), L" (", MemoryPriorityName(account.priority), L"): ",
+                         Megabytes(account.usage), L" of ", Megabytes(account.budget), L" MB");
+        } else {
+            logger.LogAt(level, LogCategory::General, L"MemoryGovernor:   ", account.name.c_str(), L" (fixed): ", Megabytes(account.usage), L" MB");
+        }
+    }
+}
+
+void MemoryGovernor::RebalanceLocked()
+{
+    uint64_t fixed = 0;
+    std::vector<Slot*> elastic;
+    for (Slot& slot : slots_) {
+        slot.usage = slot.consumer.usage ? slot.consumer.usage() : 0;
+        slot.usageGauge->Set(static_cast<int64_t>(slot.usage));
+        if (slot.consumer.setBudget) elastic.push_back(&slot);
+        else fixed += slot.usage;
+    }
+    lastFixed_ = fixed;
+
+    uint64_t available = budget_ > fixed ? budget_ - fixed : 0;
+    if (pressure_ == MemoryPressure::Moderate) available /= 2;
+    else if (pressure_ == MemoryPressure::Critical) available = 0;
+
+    std::stable_sort(elastic.begin(), elastic.end(), [](const Slot* a, const Slot* b) {
+        if (a->consumer.priority != b->consumer.priority) return a->consumer.priority > b->consumer.priority;
+        return a->consumer.refillCost > b->consumer.refillCost;
+    });
+    std::vector<uint64_t> budgets(elastic.size());
+    for (size_t i = 0; i < elastic.size(); ++i) {
+        budgets[i] = std::min(elastic[i]->consumer.minBytes, elastic[i]->consumer.maxBytes);
+        available -= std::min(available, budgets[i]);
+    }
+    for (size_t i = 0; i < elastic.size(); ++i) {
+        const uint64_t extra = std::min(elastic[i]->consumer.maxBytes - budgets[i], available);
+        budgets[i] += extra;
+        available -= extra;
+    }
+
+    // Shrinking consumers go first, so a growing one does not briefly push the total over
+    for (int growing = 0; growing < 2; ++growing) {
+        for (size_t i = 0; i < elastic.size(); ++i) {
+            Slot& slot = *elastic[i];
+            if (slot.assigned && budgets[i] == slot.budget) continue;
+            if ((budgets[i] > slot.budget && slot.assigned) != (growing == 1)) continue;
+            if (slot.assigned) {
+                LOG_FMT(LogLevel::Debug, LogCategory::General, L"MemoryGovernor: {} budget {} -> {} MB", slot.consumer.name,
+                        Megabytes(slot.budget), Megabytes(budgets[i]));
+            }
+            slot.budget = budgets[i];
+            slot.assigned = true;
+            slot.consumer.setBudget(slot.budget);
+            slot.usage = slot.consumer.usage ? slot.consumer.usage() : 0;
+            slot.usageGauge->Set(static_cast<int64_t>(slot.usage));
+            slot.budgetGauge->Set(static_cast<int64_t>(slot.budget));
+        }
+    }
+}
+
+MemoryPressure MemoryGovernor::ParsePsi(const std::string& text)
+{
+    double some = -1, full = -1;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.rfind("some ", 0) == 0) some = PsiField(line, "avg10=");
+        else if (line.rfind("full ", 0) == 0) full = PsiField(line, "avg10=");
+    }
+    if (full >= 10.0) return MemoryPressure::Critical;
+    if (some >= 10.0) return MemoryPressure::Moderate;
+    return MemoryPressure::None;
+}
+
+MemoryPressure MemoryGovernor::ReadPsi(const std::filesystem::path& path)
+{
+    std::ifstream in(path);
+    if (!in) return MemoryPressure::None;
+    std::ostringstream text;
+    text << in.rdbuf();
+    return ParsePsi(text.str());
+}
+
+MemoryPressure MemoryGovernor::SystemMemoryPressure()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status{};
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return MemoryPressure::None;
+    if (status.dwMemoryLoad >= 95) return MemoryPressure::Critical;
+    if (status.dwMemoryLoad >= 85) return MemoryPressure::Moderate;
+    return MemoryPressure::None;
+#else
+    return ReadPsi("/proc/pressure/memory");
+#endif
+}
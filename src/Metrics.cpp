@@ -0,0 +1,334 @@
+// Metrics.cpp - metrics registry and snapshot export (JSON / Prometheus text)
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+int Histogram::BucketIndex(uint64_t value)
+{
+    const uint64_t maxValue = (uint64_t(1) << (kMaxBit + 1)) - 1;
+    if (value > maxValue) value = maxValue;
+    if (value < 2 * kSubBuckets) return static_cast<int>(value);
+    int msb = 63;
+    while (!(value >> msb)) --msb;
+    const int shift = msb - kSubBucketBits;
+    return shift * kSubBuckets + static_cast<int>(value >> shift);
+}
+
+uint64_t Histogram::BucketLowerBound(int index)
+{
+    if (index < 2 * kSubBuckets) return static_cast<uint64_t>(index);
+    const int shift = index / kSubBuckets - 1;
+    const uint64_t mantissa = static_cast<uint64_t>(index % kSubBuckets + kSubBuckets);
+    return mantissa << shift;
+}
+
+void Histogram::Record(uint64_t value)
+{
+    Shard& shard = shards_[MetricShardIndex() % kShards];
+    shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t prev = shard.max.load(std::memory_order_relaxed);
+    while (value > prev && !shard.max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+
+HistogramSnapshot Histogram::Snapshot() const
+{
+    HistogramSnapshot snap;
+    snap.buckets.assign(kBucketCount, 0);
+    for (const Shard& shard : shards_) {
+        snap.count += shard.count.load(std::memory_order_relaxed);
+        snap.sum += shard.sum.load(std::memory_order_relaxed);
+        snap.max = std::max(snap.max, shard.max.load(std::memory_order_relaxed));
+        for (int i = 0; i < kBucketCount; ++i) snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+uint64_t HistogramSnapshot::Percentile(double q) const
+{
+    if (count == 0 || buckets.empty()) return 0;
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return std::min(Histogram::BucketUpperBound(static_cast<int>(i)), max);
+    }
+    return max;
+}
+
+Metrics::Entry& Metrics::FindOrAdd(Kind kind, const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Entry& e : entries_) {
+        if (e.kind == kind && e.name == name && e.labels == labels) return e;
+    }
+    Entry& e = entries_.emplace_back();
+    e.kind = kind;
+    e.name = name;
+    e.help = help;
+    e.labels = labels;
+    switch (kind) {
+    case Kind::Counter: e.counter = std::make_unique<Counter>(); break;
+    case Kind::Gauge: e.gauge = std::make_unique<Gauge>(); break;
+    case Kind::Histogram: e.histogram = std::make_unique<Histogram>(); break;
+    case Kind::GaugeCallback: break;
+    }
+    return e;
+}
+
+Counter& Metrics::GetCounter(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *FindOrAdd(Kind::Counter, name, help, labels).counter;
+}
+
+Gauge& Metrics::GetGauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *FindOrAdd(Kind::Gauge, name, help, labels).gauge;
+}
+
+Histogram& Metrics::GetHistogram(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    return *FindOrAdd(Kind::Histogram, name, help, labels).histogram;
+}
+
+void Metrics::RegisterGaugeCallback(const std::string& name, const std::string& help, std::function<int64_t()> callback,
+                                    const MetricLabels& labels)
+{
+    Entry& e = FindOrAdd(Kind::GaugeCallback, name, help, labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+    e.callback = std::move(callback);
+}
+
+static std::string EscapeString(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+static const char* kQuantileNames[] = { "0.5", "0.9", "0.99", "0.999" };
+static const double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+std::string Metrics::SnapshotJson() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    const long long unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "{\n  \"timestamp_unix_ms\": %lld,\n  \"uptime_seconds\": %.3f,\n  \"metrics\": [", unixMs, uptime);
+    std::string out = buf;
+    bool first = true;
+    for (const Entry& e : entries_) {
+        out += first ? "\n    {" : ",\n    {";
+        first = false;
+        out += "\"name\": \"" + EscapeString(e.name) + "\", \"labels\": {";
+        for (size_t i = 0; i < e.labels.size(); ++i) {
+            if (i) out += ", ";
+            out += '"';
+            out += EscapeString(e.labels[i].first);
+            out += "\": \"";
+            out += EscapeString(e.labels[i].second);
+            out += '"';
+        }
+        out += "}, ";
+        switch (e.kind) {
+        case Kind::Counter:
+            out += "\"type\": \"counter\", \"value\": " + std::to_string(e.counter->Value());
+            break;
+        case Kind::Gauge:
+            out += "\"type\": \"gauge\", \"value\": " + std::to_string(e.gauge->Value());
+            break;
+        case Kind::GaugeCallback:
+            out += "\"type\": \"gauge\", \"value\": " + std::to_string(e.callback ? e.callback() : 0);
+            break;
+        case Kind::Histogram: {
+            HistogramSnapshot h = e.histogram->Snapshot();
+            out += "\"type\": \"histogram\", \"count\": " + std::to_string(h.count) + ", \"sum\": " + std::to_string(h.sum) +
+                   ", \"max\": " + std::to_string(h.max) + ", \"p50\": " + std::to_string(h.Percentile(0.5)) +
+                   ", \"p90\": " + std::to_string(h.Percentile(0.9)) + ", \"p99\": " + std::to_string(h.Percentile(0.99)) +
+                   ", \"p999\": " + std::to_string(h.Percentile(0.999));
+            break;
+        }
+        }
+        out += "}";
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+static std::string PrometheusLabels(const MetricLabels& labels, const char* quantile = nullptr)
+{
+    if (labels.empty() && !quantile) return "";
+    std::string out = "{";
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (i) out += ",";
+        out += labels[i].first + "=\"" + EscapeString(labels[i].second) + "\"";
+    }
+    if (quantile) {
+        if (!labels.empty()) out += ",";
+        out += std::string("quantile=\"") + quantile + "\"";
+    }
+    return out + "}";
+}
+
+std::string Metrics::SnapshotPrometheus() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Samples of one metric family must be adjacent, so group entries by name
+    std::vector<const Entry*> sorted;
+    for (const Entry& e : entries_) sorted.push_back(&e);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->name < b->name; });
+
+    std::string out;
+    const std::string* lastName = nullptr;
+    for (const Entry* e : sorted) {
+        if (!lastName || *lastName != e->name) {
+            const char* type = e->kind == Kind::Counter ? "counter" : e->kind == Kind::Histogram ? "summary" : "gauge";
+            out += "# HELP " + e->name + " " + e->help + "\n";
+            out += "# TYPE " + e->name + " " + type + "\n";
+            lastName = &e->name;
+        }
+        switch (e->kind) {
+        case Kind::Counter:
+            out += e->name + PrometheusLabels(e->labels) + " " + std::to_string(e->counter->Value()) + "\n";
+            break;
+        case Kind::Gauge:
+            out += e->name + PrometheusLabels(e->labels) + " " + std::to_string(e->gauge->Value()) + "\n";
+            break;
+        case Kind::GaugeCallback:
+            out += e->name + PrometheusLabels(e->labels) + " " + std::to_string(e->callback ? e->callback() : 0) + "\n";
+            break;
+        case Kind::Histogram: {
+            HistogramSnapshot h = e->histogram->Snapshot();
+            for (size_t q = 0; q < std::size(kQuantiles); ++q) {
+                out += e->name + PrometheusLabels(e->labels, kQuantileNames[q]) + " " + std::to_string(h.Percentile(kQuantiles[q])) + "\n";
+            }
+            out += e->name + "_sum" + PrometheusLabels(e->labels) + " " + std::to_string(h.sum) + "\n";
+            out += e->name + "_count" + PrometheusLabels(e->labels) + " " + std::to_string(h.count) + "\n";
+            break;
+        }
+        }
+    }
+    return out;
+}
+
+// Sends one snapshot over a Unix domain socket (a local collector reads until EOF).
+static bool SendToUnixSocket(const std::string& path, const std::string& payload)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+#ifdef _WIN32
+    static const bool wsaReady = [] { WSADATA wsa; return WSAStartup(MAKEWORD(2, 2), &wsa) == 0; }();
+    if (!wsaReady) return false;
+    SOCKET sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return false;
+    bool ok = connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    for (size_t sent = 0; ok && sent < payload.size();) {
+        int n = send(sock, payload.data() + sent, static_cast<int>(payload.size() - sent), 0);
+        if (n <= 0) ok = false; else sent += static_cast<size_t>(n);
+    }
+    closesocket(sock);
+#else
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) return false;
+    bool ok = connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    for (size_t sent = 0; ok && sent < payload.size();) {
+        ssize_t n = send(sock, payload.data() + sent, payload.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) ok = false; else sent += static_cast<size_t>(n);
+    }
+    close(sock);
+#endif
+    return ok;
+}
+
+bool Metrics::WriteSnapshot(const MetricsExportConfig& config) const
+{
+    const std::string payload = config.format == MetricsFormat::Prometheus ? SnapshotPrometheus() : SnapshotJson();
+    const std::wstring unixPrefix = L"unix:";
+    if (config.target.rfind(unixPrefix, 0) == 0) {
+        const std::u8string path = std::filesystem::path(config.target.substr(unixPrefix.size())).u8string();
+        return SendToUnixSocket(std::string(path.begin(), path.end()), payload);
+    }
+    // Write to a temporary file and rename so a collector never reads a half-written snapshot
+    std::filesystem::path target(config.target);
+    std::filesystem::path tmp = target;
+    tmp += L".tmp";
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    return !ec;
+}
+
+void Metrics::ExporterLoop(MetricsExportConfig config)
+{
+    bool lastOk = true;
+    std::unique_lock<std::mutex> lock(exporterMutex_);
+    while (true) {
+        exporterCv_.wait_for(lock, std::chrono::seconds(config.intervalSeconds), [this] { return exporterStop_; });
+        const bool stopping = exporterStop_;
+        lock.unlock();
+        const bool ok = WriteSnapshot(config);
+        if (ok != lastOk) {
+            if (ok) LOG_FMT(LogLevel::Info, LogCategory::Metrics, L"Metrics: export to {} working again", config.target);
+            else LOG_FMT(LogLevel::Warn, LogCategory::Metrics, L"Metrics: failed to write snapshot to {}", config.target);
+            lastOk = ok;
+        }
+        lock.lock();
+        if (stopping) break;
+    }
+}
+
+void Metrics::StartExporter(const MetricsExportConfig& config)
+{
+    StopExporter();
+    if (config.target.empty()) return;
+    MetricsExportConfig c = config;
+    c.intervalSeconds = std::max(1, c.intervalSeconds);
+    {
+        std::lock_guard<std::mutex> lock(exporterMutex_);
+        exporterStop_ = false;
+    }
+    LOG_FMT(LogLevel::Info, LogCategory::Metrics, L"Metrics: exporting {} snapshots to {} every {} s",
+            c.format == MetricsFormat::Prometheus ? L"Prometheus" : L"JSON", c.target, c.intervalSeconds);
+    exporter_ = std::thread([this, c] { ExporterLoop(c); });
+}
+
+void Metrics::StopExporter()
+{
+    if (!exporter_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(exporterMutex_);
+        exporterStop_ = true;
+    }
+    exporterCv_.notify_all();
+    exporter_.join();
+}
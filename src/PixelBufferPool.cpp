@@ -0,0 +1,274 @@
+// PixelBufferPool.cpp - size-classed pool of pre-faulted, huge page aligned pixel buffers
+
+#include "PixelBufferPool.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const std::align_val_t kHeapAlignment{ 64 };
+
+void* HeapAcquire(size_t bytes)
+{
+    return ::operator new(bytes, kHeapAlignment);
+}
+
+void HeapRelease(void* data) noexcept
+{
+    ::operator delete(data, kHeapAlignment);
+}
+
+// Writes one byte per page, for systems without a populate call
+void TouchPages(void* data, size_t bytes)
+{
+    volatile uint8_t* p = static_cast<uint8_t*>(data);
+    for (size_t offset = 0; offset < bytes; offset += 4096) p[offset] = 0;
+}
+
+#ifdef _WIN32
+
+// Large pages need SeLockMemoryPrivilege, which ordinary accounts lack; after the first refusal
+// the pool stays with normal pages
+std::atomic<bool> g_largePagesRefused{ false };
+
+void* MapBuffer(size_t bytes)
+{
+    const size_t largePage = GetLargePageMinimum();
+    if (!g_largePagesRefused && largePage != 0 && bytes % largePage == 0) {
+        void* data = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data) return data;   // large pages are locked and resident already
+        g_largePagesRefused = true;
+        LOG_FMT(LogLevel::Debug, LogCategory::General, L"PixelBufferPool: large pages unavailable ({})", GetLastError());
+    }
+    void* data = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (data) TouchPages(data, bytes);
+    return data;
+}
+
+void UnmapBuffer(void* data, size_t)
+{
+    VirtualFree(data, 0, MEM_RELEASE);
+}
+
+#else
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+// Maps one granule more than needed and cuts the ends, so the buffer starts on a 2 MB boundary
+// and transparent huge pages can back all of it
+void* MapBuffer(size_t bytes)
+{
+    const size_t alignment = PixelBufferPool::kGranuleBytes;
+    void* raw = mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (start + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    const size_t tail = start + alignment - aligned;
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    void* data = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+    // Linux 5.14+; older kernels reject the advice and the pages are touched instead
+    if (madvise(data, bytes, MADV_POPULATE_WRITE) != 0) TouchPages(data, bytes);
+    return data;
+}
+
+void UnmapBuffer(void* data, size_t bytes)
+{
+    munmap(data, bytes);
+}
+
+#endif
+
+} // namespace
+
+PixelBufferPool::PixelBufferPool()
+    : mappedGauge_(Metrics::Instance().GetGauge("hdr_pixel_pool_bytes", "Bytes the pixel buffer pool holds from the system")),
+      idleGauge_(Metrics::Instance().GetGauge("hdr_pixel_pool_idle_bytes", "Bytes of released pixel buffers kept for reuse")),
+      mapsCounter_(Metrics::Instance().GetCounter("hdr_pixel_pool_maps_total", "Pixel buffers mapped and pre-faulted")),
+      reusesCounter_(Metrics::Instance().GetCounter("hdr_pixel_pool_reuses_total", "Pixel buffer requests served from an idle buffer"))
+{
+}
+
+PixelBufferPool::~PixelBufferPool()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(Clock::now(), true);
+}
+
+size_t PixelBufferPool::ClassBytes(size_t bytes)
+{
+    size_t granules = (bytes + kGranuleBytes - 1) / kGranuleBytes;
+    if (granules <= 4) return std::max<size_t>(granules, 1) * kGranuleBytes;
+    // Keep the top three bits: 4, 5, 6, 7, 8, 10, 12, 14, 16, 20, ... granules
+    int shift = 0;
+    while ((granules >> shift) >= 8) ++shift;
+    const size_t step = size_t(1) << shift;
+    granules = (granules + step - 1) & ~(step - 1);
+    return granules * kGranuleBytes;
+}
+
+void* PixelBufferPool::Acquire(size_t bytes)
+{
+    if (bytes < kMinPooledBytes) return HeapAcquire(bytes);
+    const size_t classBytes = ClassBytes(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_) return HeapAcquire(bytes);
+        // The most recently released buffer of the class is the likeliest to still be in cache
+        for (size_t i = idle_.size(); i-- > 0;) {
+            if (idle_[i].bytes != classBytes) continue;
+            void* data = idle_[i].data;
+            idle_.erase(idle_.begin() + static_cast<std::ptrdiff_t>(i));
+            inUse_.emplace(data, classBytes);
+            stats_.idleBytes -= classBytes;
+            stats_.inUseBytes += classBytes;
+            ++stats_.reuses;
+            reusesCounter_.Add();
+            PublishLocked();
+            return data;
+        }
+    }
+
+    // Mapping and faulting in hundreds of MB takes a while; other threads keep using the pool
+    void* data = MapBuffer(classBytes);
+    if (!data) {
+        // Idle buffers of other classes may be what stands between us and the memory
+        std::lock_guard<std::mutex> lock(mutex_);
+        TrimLocked(Clock::now(), true);
+    }
+    if (!data) data = MapBuffer(classBytes);
+    if (!data) throw std::bad_alloc();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    inUse_.emplace(data, classBytes);
+    stats_.inUseBytes += classBytes;
+    stats_.mappedBytes += classBytes;
+    stats_.peakMappedBytes = std::max(stats_.peakMappedBytes, stats_.mappedBytes);
+    ++stats_.maps;
+    mapsCounter_.Add();
+    PublishLocked();
+    return data;
+}
+
+void PixelBufferPool::Release(void* data, size_t bytes) noexcept
+{
+    if (!data) return;
+    if (bytes < kMinPooledBytes) { HeapRelease(data); return; }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inUse_.find(data);
+    if (it == inUse_.end()) {
+        HeapRelease(data);   // acquired while pooling was disabled
+        return;
+    }
+    const size_t classBytes = it->second;
+    inUse_.erase(it);
+    const Clock::time_point now = Clock::now();
+    idle_.push_back({ data, classBytes, now });
+    stats_.inUseBytes -= classBytes;
+    stats_.idleBytes += classBytes;
+    TrimLocked(now, false);
+    PublishLocked();
+}
+
+void PixelBufferPool::TrimIdle()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(Clock::now(), false);
+    PublishLocked();
+}
+
+void PixelBufferPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(Clock::now(), true);
+    PublishLocked();
+}
+
+void PixelBufferPool::TrimLocked(Clock::time_point now, bool all)
+{
+    // idle_ is ordered by release time, so expired buffers and those over budget are at the front
+    size_t drop = 0;
+    uint64_t idleBytes = stats_.idleBytes;
+    while (drop < idle_.size() && (all || now - idle_[drop].idleSince >= idleTimeout_ || idleBytes > idleBudget_)) {
+        idleBytes -= idle_[drop].bytes;
+        ++drop;
+    }
+    if (drop == 0) return;
+    for (size_t i = 0; i < drop; ++i) UnmapLocked(idle_[i]);
+    idle_.erase(idle_.begin(), idle_.begin() + static_cast<std::ptrdiff_t>(drop));
+}
+
+void PixelBufferPool::UnmapLocked(const Block& block)
+{
+    UnmapBuffer(block.data, block.bytes);
+    stats_.idleBytes -= block.bytes;
+    stats_.mappedBytes -= block.bytes;
+    ++stats_.unmaps;
+}
+
+void PixelBufferPool::PublishLocked()
+{
+    mappedGauge_.Set(static_cast<int64_t>(stats_.mappedBytes));
+    idleGauge_.Set(static_cast<int64_t>(stats_.idleBytes));
+}
+
+void PixelBufferPool::SetIdleTimeout(std::chrono::milliseconds timeout)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleTimeout_ = timeout;
+}
+
+void PixelBufferPool::SetIdleBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleBudget_ = bytes;
+    TrimLocked(Clock::now(), false);
+    PublishLocked();
+}
+
+std::chrono::milliseconds PixelBufferPool::IdleTimeout() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idleTimeout_;
+}
+
+uint64_t PixelBufferPool::IdleBudget() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idleBudget_;
+}
+
+void PixelBufferPool::SetEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = enabled;
+    if (!enabled) TrimLocked(Clock::now(), true);
+    PublishLocked();
+}
+
+bool PixelBufferPool::Enabled() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enabled_;
+}
+
+PixelPoolStats PixelBufferPool::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
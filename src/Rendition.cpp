@@ -0,0 +1,361 @@
+// Rendition.cpp - Ultra HDR aware downscaling and the rendition manifest
+#include "Rendition.h"
+#include "ImageFileUtils.h"
+#include "ImageResize.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <unordered_set>
+
+namespace {
+
+bool IsAppSegment(uint8_t marker)
+{
+    return marker >= 0xE0 && marker <= 0xEF;
+}
+
+bool ParseStatus(const std::string& name, RenditionStatus& status)
+{
+    for (RenditionStatus s : { RenditionStatus::Baked, RenditionStatus::Original, RenditionStatus::Unsupported, RenditionStatus::Failed }) {
+        if (name == RenditionStatusName(s)) { status = s; return true; }
+    }
+    return false;
+}
+
+const char kManifestMagic[] = "hdrbake-manifest";
+const int kManifestVersion = 2;    // 2 added the source fingerprint
+
+} // namespace
+
+const char* RenditionStatusName(RenditionStatus status)
+{
+    switch (status) {
+    case RenditionStatus::Baked: return "baked";
+    case RenditionStatus::Original: return "original";
+    case RenditionStatus::Unsupported: return "unsupported";
+    case RenditionStatus::Failed: return "failed";
+    }
+    return "failed";
+}
+
+BakeResult BakeRendition(const uint8_t* data, size_t size, const BakeOptions& options, std::vector<uint8_t>& out)
+{
+    BakeResult result;
+    out.clear();
+    std::vector<JpegSegment> segments;
+    if (!ReadJpegSegments(data, size, segments)) {
+        result.status = RenditionStatus::Unsupported;
+        result.error = "not a JPEG file";
+        return result;
+    }
+
+    // Split an MPF file into the primary image and the secondary image carrying gain map metadata
+    size_t primarySize = size;
+    const uint8_t* gainMap = nullptr;
+    size_t gainMapSize = 0;
+    std::vector<JpegSegment> gainMapSegments;
+    std::vector<MpfImage> images;
+    if (ReadMpfImages(data, size, images)) {
+        primarySize = images[0].size;
+        for (size_t i = 1; i < images.size() && !gainMap; ++i) {
+            const uint8_t* image = data + images[i].offset;
+            if (!ReadJpegSegments(image, images[i].size, gainMapSegments)) continue;
+            for (const JpegSegment& segment : gainMapSegments) {
+                if (IsGainMapMetadataSegment(image, segment)) {
+                    gainMap = image;
+                    gainMapSize = images[i].size;
+                    break;
+                }
+            }
+        }
+    }
+
+    JpegInfo info;
+    if (!ReadJpegInfo(data, primarySize, info)) {
+        result.error = "no frame header";
+        return result;
+    }
+    FitWithin(info.width, info.height, options.maxWidth, options.maxHeight, result.width, result.height);
+    if (result.width == info.width && result.height == info.height) {
+        result.status = RenditionStatus::Original;
+        result.gainMap = gainMap != nullptr;
+        return result;
+    }
+    if (info.progressive || info.arithmetic || info.precision != 8 || (info.components != 1 && info.components != 3)) {
+        result.status = RenditionStatus::Unsupported;
+        result.error = info.progressive ? "progressive JPEG" : "unsupported JPEG coding";
+        return result;
+    }
+
+    PlanarImage scaled;
+    {
+        PlanarImage source;
+        if (!DecodeJpeg(data, primarySize, source, &result.error)) return result;
+        ResizeImageArea(source, result.width, result.height, scaled);
+    }
+
+    std::vector<uint8_t> gainMapJpeg;
+    if (gainMap) {
+        PlanarImage map, mapScaled;
+        std::string error;
+        if (!DecodeJpeg(gainMap, gainMapSize, map, &error)) {
+            // Dropping the gain map would turn an HDR photo into SDR; keep showing the source
+            result.status = RenditionStatus::Unsupported;
+            result.error = "gain map: " + error;
+            return result;
+        }
+        const double scale = static_cast<double>(result.width) / info.width;
+        const int mapWidth = std::max(1, static_cast<int>(std::lround(map.width * scale)));
+        const int mapHeight = std::max(1, static_cast<int>(std::lround(map.height * scale)));
+        ResizeImageArea(map, std::min(mapWidth, map.width), std::min(mapHeight, map.height), mapScaled);
+
+        JpegEncodeOptions mapOptions;
+        mapOptions.quality = options.gainMapQuality;
+        mapOptions.subsampleChroma = false;
+        for (const JpegSegment& segment : gainMapSegments) {
+            if (!IsAppSegment(segment.marker) || IsMpfSegment(gainMap, segment)) continue;
+            mapOptions.segments.emplace_back(gainMap + segment.offset, gainMap + segment.offset + segment.length);
+        }
+        if (!EncodeJpeg(mapScaled, mapOptions, gainMapJpeg)) {
+            result.error = "gain map encode failed";
+            return result;
+        }
+    }
+
+    // Primary metadata (EXIF, ICC, XMP, ...) is kept; the MPF directory is rebuilt for the new
+    // sizes and the XMP container directory gets the new gain map length
+    JpegEncodeOptions primaryOptions;
+    primaryOptions.quality = options.quality;
+    size_t mpfOffset = 2;
+    for (const JpegSegment& segment : segments) {
+        if (!IsAppSegment(segment.marker) || IsMpfSegment(data, segment)) continue;
+        std::string packet;
+        if (gainMap && IsXmpSegment(data, segment)) packet = XmpPacket(data, segment);
+        if (!packet.empty() && SetXmpItemLength(packet, "GainMap", gainMapJpeg.size())) {
+            primaryOptions.segments.push_back(BuildXmpSegment(packet));
+        } else {
+            primaryOptions.segments.emplace_back(data + segment.offset, data + segment.offset + segment.length);
+        }
+        mpfOffset += primaryOptions.segments.back().size();
+    }
+    if (gainMap) primaryOptions.segments.push_back(BuildMpfSegment(0, 0, 0));
+    if (!EncodeJpeg(scaled, primaryOptions, out)) {
+        out.clear();
+        result.error = "encode failed";
+        return result;
+    }
+    if (gainMap) {
+        const size_t primaryLength = out.size();
+        const std::vector<uint8_t> mpf = BuildMpfSegment(static_cast<uint32_t>(primaryLength), static_cast<uint32_t>(gainMapJpeg.size()),
+                                                         static_cast<uint32_t>(primaryLength - (mpfOffset + kMpfTiffHeaderOffset)));
+        std::copy(mpf.begin(), mpf.end(), out.begin() + static_cast<std::ptrdiff_t>(mpfOffset));
+        out.insert(out.end(), gainMapJpeg.begin(), gainMapJpeg.end());
+        result.gainMap = true;
+    }
+    result.status = RenditionStatus::Baked;
+    return result;
+}
+
+bool SourceIdentity::Of(const std::filesystem::path& path, SourceIdentity& identity)
+{
+    std::error_code ec;
+    identity.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    identity.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+    return true;
+}
+
+RenditionStore::RenditionStore(std::filesystem::path libraryRoot, std::filesystem::path mirrorRoot)
+    : libraryRoot_(std::move(libraryRoot)), mirrorRoot_(std::move(mirrorRoot))
+{
+}
+
+std::wstring RenditionStore::Key(const std::filesystem::path& source) const
+{
+    const std::filesystem::path relative = source.lexically_normal().lexically_relative(libraryRoot_.lexically_normal());
+    if (relative.empty() || *relative.begin() == "..") return std::wstring();
+    return relative.generic_wstring();
+}
+
+std::filesystem::path RenditionStore::RenditionPath(const std::filesystem::path& source) const
+{
+    const std::wstring key = Key(source);
+    return key.empty() ? std::filesystem::path() : mirrorRoot_ / std::filesystem::path(key);
+}
+
+const RenditionRecord* RenditionStore::Find(const std::filesystem::path& source) const
+{
+    auto it = records_.find(Key(source));
+    return it == records_.end() ? nullptr : &it->second;
+}
+
+void RenditionStore::Set(const std::filesystem::path& source, const RenditionRecord& record)
+{
+    const std::wstring key = Key(source);
+    if (!key.empty()) records_[key] = record;
+}
+
+size_t RenditionStore::Prune(const std::vector<std::filesystem::path>& keep)
+{
+    std::unordered_set<std::wstring> live;
+    for (const auto& path : keep) live.insert(Key(path));
+    size_t removed = 0;
+    for (auto it = records_.begin(); it != records_.end();) {
+        if (live.count(it->first)) { ++it; continue; }
+        if (it->second.status == RenditionStatus::Baked) {
+            std::error_code ec;
+            std::filesystem::remove(mirrorRoot_ / std::filesystem::path(it->first), ec);
+        }
+        it = records_.erase(it);
+        ++removed;
+    }
+    return removed;
+}
+
+size_t RenditionStore::Relink(const std::vector<std::filesystem::path>& keep,
+                              const std::vector<std::pair<std::filesystem::path, RenditionRecord>>& sources)
+{
+    std::unordered_set<std::wstring> live;
+    for (const auto& path : keep) live.insert(Key(path));
+    std::unordered_map<ContentHash, std::wstring, ContentHashHasher> orphans;
+    for (const auto& [key, record] : records_) {
+        if (!record.content.Empty() && !live.count(key)) orphans.emplace(record.content, key);
+    }
+    size_t moved = 0;
+    for (const auto& [source, current] : sources) {
+        const std::wstring key = Key(source);
+        auto orphan = orphans.find(current.content);
+        if (key.empty() || current.content.Empty() || orphan == orphans.end() || records_.count(key)) continue;
+        auto it = records_.find(orphan->second);
+        RenditionRecord record = it->second;
+        if (record.status == RenditionStatus::Baked) {
+            std::error_code ec;
+            const std::filesystem::path target = mirrorRoot_ / std::filesystem::path(key);
+            std::filesystem::create_directories(target.parent_path(), ec);
+            std::filesystem::rename(mirrorRoot_ / std::filesystem::path(it->first), target, ec);
+            if (ec) continue;
+        }
+        // Moving a file may change its modification time; the fingerprint says it is the same photo
+        record.source = current.source;
+        records_.erase(it);
+        records_[key] = record;
+        orphans.erase(orphan);
+        ++moved;
+    }
+    return moved;
+}
+
+bool RenditionStore::Load()
+{
+    records_.clear();
+    std::ifstream in(mirrorRoot_ / kManifestName, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    std::string line;
+    if (!std::getline(in, line)) return false;
+    int version = 0;
+    {
+        std::istringstream header(line);
+        std::string magic;
+        BakeOptions options;
+        if (!(header >> magic >> version >> options.maxWidth >> options.maxHeight >> options.quality >> options.gainMapQuality)) return false;
+        if (magic != kManifestMagic || version < 1 || version > kManifestVersion) return false;
+        options_ = options;
+    }
+    // status, source size, source time, rendition size, width, height, source fingerprint (from
+    // version 2 on), relative path
+    const int count = version >= 2 ? 8 : 7;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::string fields[8];
+        size_t start = 0;
+        int n = 0;
+        for (; n < count - 1; ++n) {
+            const size_t tab = line.find('\t', start);
+            if (tab == std::string::npos) break;
+            fields[n] = line.substr(start, tab - start);
+            start = tab + 1;
+        }
+        if (n != count - 1) continue;
+        fields[count - 1] = line.substr(start);
+        RenditionRecord record;
+        if (!ParseStatus(fields[0], record.status) || fields[count - 1].empty()) continue;
+        record.source.size = std::strtoull(fields[1].c_str(), nullptr, 10);
+        record.source.modified = std::strtoll(fields[2].c_str(), nullptr, 10);
+        record.renditionSize = std::strtoull(fields[3].c_str(), nullptr, 10);
+        record.width = std::atoi(fields[4].c_str());
+        record.height = std::atoi(fields[5].c_str());
+        if (count == 8) ContentHash::FromHex(fields[6], record.content);
+        // Keys keep the manifest's '/' separators
+        std::wstring key;
+        if (!WideFromUtf8(fields[count - 1], key)) {
+            records_.clear();
+            return false;
+        }
+        records_[key] = record;
+    }
+    return true;
+}
+
+bool RenditionStore::Save() const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(mirrorRoot_, ec);
+    const std::filesystem::path path = mirrorRoot_ / kManifestName;
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out << kManifestMagic << ' ' << kManifestVersion << ' ' << options_.maxWidth << ' ' << options_.maxHeight << ' '
+            << options_.quality << ' ' << options_.gainMapQuality << '\n';
+        // Sorted, so the manifest diffs cleanly between runs
+        std::vector<const std::pair<const std::wstring, RenditionRecord>*> sorted;
+        for (const auto& entry : records_) sorted.push_back(&entry);
+        std::sort(sorted.begin(), sorted.end(), [](auto* a, auto* b) { return a->first < b->first; });
+        for (const auto* entry : sorted) {
+            const RenditionRecord& r = entry->second;
+            out << RenditionStatusName(r.status) << '\t' << r.source.size << '\t' << r.source.modified << '\t' << r.renditionSize << '\t'
+                << r.width << '\t' << r.height << '\t' << (r.content.Empty() ? "-" : r.content.ToHex()) << '\t' << Utf8FromPath(entry->first)
+                << '\n';
+        }
+        if (!out.flush()) return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+CatalogEntry RenditionStore::Resolve(const CatalogEntry& entry) const
+{
+    const RenditionRecord* record = Find(entry.path);
+    if (!record || record->status != RenditionStatus::Baked) return entry;
+    SourceIdentity current;
+    if (!SourceIdentity::Of(entry.path, current) || !(current == record->source)) return entry;
+    return { RenditionPath(entry.path).wstring(), record->renditionSize };
+}
+
+Slideshow::LoadFunction RenditionStore::Loader(const std::atomic<float>* headroom) const
+{
+    static Counter& loads = Metrics::Instance().GetCounter("hdr_rendition_loads_total", "Slides loaded from a baked rendition instead of the source");
+    static Counter& saved = Metrics::Instance().GetCounter("hdr_rendition_bytes_saved_total", "Source bytes not read because a rendition was used");
+    return [this, headroom](const CatalogEntry& entry) {
+        const float stops = headroom ? headroom->load(std::memory_order_relaxed) : -1.0f;
+        const CatalogEntry resolved = Resolve(entry);
+        if (resolved.path != entry.path) {
+            if (auto data = Slideshow::LoadImageFileForHeadroom(resolved, stops)) {
+                loads.Add();
+                if (entry.fileSize > data->bytes.size()) saved.Add(entry.fileSize - data->bytes.size());
+                return data;
+            }
+        }
+        return Slideshow::LoadImageFileForHeadroom(entry, stops);
+    };
+}
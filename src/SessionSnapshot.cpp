@@ -0,0 +1,178 @@
+// SessionSnapshot.cpp - warm start of the next activation from the last session's upcoming slides
+#include "SessionSnapshot.h"
+#include "BinaryFileUtils.h"
+#include "ImageFileUtils.h"
+#include "Slideshow.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <unordered_map>
+
+namespace {
+
+const char kSnapshotMagic[8] = { 'H', 'D', 'R', 'S', 'N', 'A', 'P', 1 };
+
+// True if the file still has the size and time it had when the snapshot was taken
+bool Unchanged(const CatalogEntry& entry)
+{
+    std::error_code ec;
+    const std::filesystem::path path(entry.path);
+    const uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec || size != entry.fileSize) return false;
+    if (entry.modified == 0) return true;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    return !ec && static_cast<int64_t>(modified.time_since_epoch().count()) == entry.modified;
+}
+
+} // namespace
+
+std::filesystem::path SessionSnapshot::DefaultPath()
+{
+    return AppCacheFolder() / L"session-snapshot.bin";
+}
+
+SessionSnapshot SessionSnapshot::Capture(const Slideshow& slideshow, ImageCache& cache, uint64_t maxBytes)
+{
+    SessionSnapshot snapshot;
+    std::vector<std::vector<size_t>> upcoming(slideshow.OutputCount());
+    size_t depth = 0;
+    for (size_t o = 0; o < upcoming.size(); ++o) {
+        upcoming[o] = slideshow.Upcoming(o);
+        depth = std::max(depth, upcoming[o].size());
+    }
+    for (size_t o = 0; o < upcoming.size(); ++o) {
+        for (size_t index : upcoming[o]) snapshot.slides.push_back({ o, slideshow.Catalog()[index], nullptr });
+    }
+    // Every output's next slide gets its bytes before any output's second one
+    uint64_t bytes = 0;
+    for (size_t k = 0; k < depth; ++k) {
+        size_t slide = 0;
+        for (size_t o = 0; o < upcoming.size(); ++o) {
+            if (k < upcoming[o].size() && cache.Contains(upcoming[o][k])) {
+                std::shared_ptr<const ImageData> data = cache.Get(upcoming[o][k]);
+                // Bytes loaded without a gain map would show the next session without HDR
+                if (data && !data->gainMapOmitted && bytes + data->bytes.size() <= maxBytes) {
+                    bytes += data->bytes.size();
+                    snapshot.slides[slide + k].data = std::move(data);
+                }
+            }
+            slide += upcoming[o].size();
+        }
+    }
+    return snapshot;
+}
+
+bool SessionSnapshot::Matches(const std::wstring& folder, bool includeSubfolders, const std::wstring& playlistQuery, bool randomOrder) const
+{
+    return !slides.empty() && NormalizedPathKey(this->folder) == NormalizedPathKey(folder) && this->includeSubfolders == includeSubfolders &&
+           this->playlistQuery == playlistQuery && this->randomOrder == randomOrder;
+}
+
+ImageCatalog SessionSnapshot::Restore(std::vector<std::shared_ptr<const ImageData>>& data, std::vector<size_t>& first) const
+{
+    ImageCatalog catalog;
+    data.clear();
+    first.clear();
+    for (const SnapshotSlide& slide : slides) {
+        if (!Unchanged(slide.entry)) continue;
+        if (slide.output >= first.size()) first.resize(slide.output + 1, ImageCatalog::npos);
+        if (first[slide.output] == ImageCatalog::npos) first[slide.output] = catalog.Size();
+        catalog.Add(slide.entry);
+        data.push_back(slide.data);
+    }
+    return catalog;
+}
+
+ImageCatalog SessionSnapshot::Extend(const ImageCatalog& restored, const ImageCatalog& listing, std::vector<size_t>& positions)
+{
+    ImageCatalog extended = restored;
+    for (const CatalogEntry& entry : listing.Entries()) extended.Add(entry);
+    // One pass over the listing with the few restored paths in a map, rather than a Find each
+    std::unordered_map<std::wstring, size_t> keys;
+    for (size_t i = 0; i < restored.Size(); ++i) keys.emplace(NormalizedPathKey(restored[i].path), i);
+    positions.assign(restored.Size(), ImageCatalog::npos);
+    size_t found = 0;
+    for (size_t j = 0; j < listing.Size() && found < keys.size(); ++j) {
+        auto it = keys.find(NormalizedPathKey(listing[j].path));
+        if (it == keys.end() || positions[it->second] != ImageCatalog::npos) continue;
+        positions[it->second] = restored.Size() + j;
+        ++found;
+    }
+    return extended;
+}
+
+void SessionSnapshot::CopyRestored(ImageCache& cache, const std::vector<size_t>& positions)
+{
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (positions[i] == ImageCatalog::npos || !cache.Contains(i)) continue;
+        if (auto data = cache.Get(i)) cache.Put(positions[i], std::move(data));
+    }
+}
+
+bool SessionSnapshot::Save(const std::filesystem::path& path) const
+{
+    std::vector<uint8_t> header(std::begin(kSnapshotMagic), std::end(kSnapshotMagic));
+    PutString(header, folder);
+    header.push_back(static_cast<uint8_t>((includeSubfolders ? 1 : 0) | (randomOrder ? 2 : 0)));
+    PutString(header, playlistQuery);
+    PutVarint(header, slides.size());
+    return WriteFileAtomically(path, [this, &header](std::ofstream& file) {
+        if (!file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()))) return false;
+        // Slide bytes go straight from the cached images to the file
+        for (const SnapshotSlide& slide : slides) {
+            std::vector<uint8_t> record;
+            PutVarint(record, slide.output);
+            PutString(record, slide.entry.path);
+            PutVarint(record, slide.entry.fileSize);
+            for (int shift = 0; shift < 64; shift += 8) record.push_back(static_cast<uint8_t>(static_cast<uint64_t>(slide.entry.modified) >> shift));
+            PutVarint(record, slide.data ? slide.data->bytes.size() : 0);
+            if (!file.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size()))) return false;
+            if (slide.data && !file.write(reinterpret_cast<const char*>(slide.data->bytes.data()), static_cast<std::streamsize>(slide.data->bytes.size()))) return false;
+        }
+        return true;
+    });
+}
+
+bool SessionSnapshot::Load(const std::filesystem::path& path)
+{
+    *this = SessionSnapshot();
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kSnapshotMagic) || std::memcmp(data.data(), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) return false;
+    const uint8_t* p = data.data() + sizeof(kSnapshotMagic);
+    const uint8_t* end = data.data() + data.size();
+    auto fail = [this] {
+        *this = SessionSnapshot();
+        return false;
+    };
+
+    uint64_t count = 0;
+    if (!GetString(p, end, folder) || p >= end) return fail();
+    const uint8_t flags = *p++;
+    includeSubfolders = (flags & 1) != 0;
+    randomOrder = (flags & 2) != 0;
+    if (!GetString(p, end, playlistQuery) || !GetVarint(p, end, count) || count > data.size()) return fail();
+    slides.resize(static_cast<size_t>(count));
+    for (SnapshotSlide& slide : slides) {
+        uint64_t output = 0, size = 0;
+        if (!GetVarint(p, end, output) || output > 64 || !GetString(p, end, slide.entry.path) || !GetVarint(p, end, slide.entry.fileSize) || end - p < 8) {
+            return fail();
+        }
+        uint64_t modified = 0;
+        for (int shift = 0; shift < 64; shift += 8) modified |= static_cast<uint64_t>(*p++) << shift;
+        if (!GetVarint(p, end, size) || size > static_cast<uint64_t>(end - p)) return fail();
+        slide.output = static_cast<size_t>(output);
+        slide.entry.modified = static_cast<int64_t>(modified);
+        if (size > 0) {
+            auto image = std::make_shared<ImageData>();
+            image->bytes.assign(p, p + size);
+            slide.data = std::move(image);
+            p += size;
+        }
+    }
+    return true;
+}
@@ -128,10 +128,23 @@ ScreenSaverSettings LoadSettingsFromRegistry() {
     DWORD len = sizeof(buf);
     s.imageFolder = L"";
     s.displaySeconds = 15;
+    s.maxCacheMB = 512;
+    s.enableCaching = true;
+    s.renditionFolder = L"";
+    s.playlistQuery = L"";
+    s.tracePath = L"";
     s.logEnabled = true;
     s.logPath = L"";
+    s.logLevel = 2; // LogLevel::Info
+    s.logBinary = false;
+    s.metricsTarget = L"";
+    s.metricsFormat = 0;
+    s.metricsIntervalSeconds = 60;
     s.includeSubfolders = true;
     s.randomizeOrder = false;
+    s.selectionWeighting = 0;
+    s.selectionBoost = L"";
+    s.selectionBoostFactor = 4;
     if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\HDRScreenSaver", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
         if (RegQueryValueExW(hKey, L"ImageFolder", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
             s.imageFolder = buf;
@@ -147,9 +160,48 @@ ScreenSaverSettings LoadSettingsFromRegistry() {
         sz = sizeof(val);
         if (RegQueryValueExW(hKey, L"RandomizeOrder", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS)
             s.randomizeOrder = (val != 0);
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"SelectionWeighting", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS && val <= 2)
+            s.selectionWeighting = (int)val;
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"SelectionBoostFactor", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS && val > 0 && val <= 1000)
+            s.selectionBoostFactor = (int)val;
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"LogLevel", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS && val <= 5)
+            s.logLevel = (int)val;
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"LogBinary", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS)
+            s.logBinary = (val != 0);
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"MaxCacheMB", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS)
+            s.maxCacheMB = (int)val;
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"EnableCaching", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS)
+            s.enableCaching = (val != 0);
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"MetricsFormat", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS && val <= 1)
+            s.metricsFormat = (int)val;
+        sz = sizeof(val);
+        if (RegQueryValueExW(hKey, L"MetricsIntervalSeconds", nullptr, nullptr, (LPBYTE)&val, &sz) == ERROR_SUCCESS && val > 0)
+            s.metricsIntervalSeconds = (int)val;
         len = sizeof(buf);
         if (RegQueryValueExW(hKey, L"LogPath", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
             s.logPath = buf;
+        len = sizeof(buf);
+        if (RegQueryValueExW(hKey, L"MetricsTarget", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
+            s.metricsTarget = buf;
+        len = sizeof(buf);
+        if (RegQueryValueExW(hKey, L"RenditionFolder", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
+            s.renditionFolder = buf;
+        len = sizeof(buf);
+        if (RegQueryValueExW(hKey, L"PlaylistQuery", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
+            s.playlistQuery = buf;
+        len = sizeof(buf);
+        if (RegQueryValueExW(hKey, L"SelectionBoost", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
+            s.selectionBoost = buf;
+        len = sizeof(buf);
+        if (RegQueryValueExW(hKey, L"TracePath", nullptr, nullptr, (LPBYTE)buf, &len) == ERROR_SUCCESS && wcslen(buf) > 0)
+            s.tracePath = buf;
         RegCloseKey(hKey);
     }
     if (s.imageFolder.empty()) {
@@ -177,7 +229,28 @@ void SaveSettingsToRegistry(const ScreenSaverSettings& s) {
         RegSetValueExW(hKey, L"IncludeSubfolders", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
         val = (DWORD)(s.randomizeOrder ? 1 : 0);
         RegSetValueExW(hKey, L"RandomizeOrder", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)s.selectionWeighting;
+        RegSetValueExW(hKey, L"SelectionWeighting", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)s.selectionBoostFactor;
+        RegSetValueExW(hKey, L"SelectionBoostFactor", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)s.logLevel;
+        RegSetValueExW(hKey, L"LogLevel", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)(s.logBinary ? 1 : 0);
+        RegSetValueExW(hKey, L"LogBinary", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
         RegSetValueExW(hKey, L"LogPath", 0, REG_SZ, (const BYTE*)s.logPath.c_str(), (DWORD)((s.logPath.size()+1)*sizeof(wchar_t)));
+        val = (DWORD)s.maxCacheMB;
+        RegSetValueExW(hKey, L"MaxCacheMB", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)(s.enableCaching ? 1 : 0);
+        RegSetValueExW(hKey, L"EnableCaching", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)s.metricsFormat;
+        RegSetValueExW(hKey, L"MetricsFormat", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        val = (DWORD)s.metricsIntervalSeconds;
+        RegSetValueExW(hKey, L"MetricsIntervalSeconds", 0, REG_DWORD, (const BYTE*)&val, sizeof(val));
+        RegSetValueExW(hKey, L"MetricsTarget", 0, REG_SZ, (const BYTE*)s.metricsTarget.c_str(), (DWORD)((s.metricsTarget.size()+1)*sizeof(wchar_t)));
+        RegSetValueExW(hKey, L"RenditionFolder", 0, REG_SZ, (const BYTE*)s.renditionFolder.c_str(), (DWORD)((s.renditionFolder.size()+1)*sizeof(wchar_t)));
+        RegSetValueExW(hKey, L"PlaylistQuery", 0, REG_SZ, (const BYTE*)s.playlistQuery.c_str(), (DWORD)((s.playlistQuery.size()+1)*sizeof(wchar_t)));
+        RegSetValueExW(hKey, L"SelectionBoost", 0, REG_SZ, (const BYTE*)s.selectionBoost.c_str(), (DWORD)((s.selectionBoost.size()+1)*sizeof(wchar_t)));
+        RegSetValueExW(hKey, L"TracePath", 0, REG_SZ, (const BYTE*)s.tracePath.c_str(), (DWORD)((s.tracePath.size()+1)*sizeof(wchar_t)));
         RegCloseKey(hKey);
     }
 }
@@ -0,0 +1,126 @@
+// ShowHistory.cpp - persisted show counts and selection weights
+#include "ShowHistory.h"
+#include "BinaryFileUtils.h"
+#include "ImageFileUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+const char kHistoryMagic[8] = { 'H', 'D', 'R', 'S', 'H', 'O', 'W', 1 };
+
+// A never shown image counts as shown this long ago, and older shows count no more than this
+const uint32_t kRecencyCapHours = 90 * 24;
+// LeastOften weight of a never shown image; kept well above the sampler's resolution
+const double kFrequencyScale = 64.0;
+
+} // namespace
+
+std::filesystem::path ShowHistory::DefaultPath()
+{
+    return AppCacheFolder() / L"show-history.bin";
+}
+
+uint64_t ShowHistory::KeyOf(const std::wstring& path)
+{
+    // FNV-1a over the lower-cased UTF-16 code units, separators unified
+    uint64_t hash = 14695981039346656037ull;
+    for (wchar_t c : path) {
+        uint32_t unit = static_cast<uint32_t>(std::towlower(c));
+        if (unit == L'\\') unit = L'/';
+        hash = (hash ^ (unit & 0xFF)) * 1099511628211ull;
+        hash = (hash ^ ((unit >> 8) & 0xFF)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint32_t ShowHistory::MinutesNow()
+{
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::minutes>(now).count());
+}
+
+bool ShowHistory::Load(const std::filesystem::path& path)
+{
+    records_.clear();
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kHistoryMagic) + 4 || std::memcmp(data.data(), kHistoryMagic, sizeof(kHistoryMagic)) != 0) return false;
+    const uint8_t* p = data.data() + sizeof(kHistoryMagic);
+    const uint8_t* end = data.data() + data.size();
+    const uint32_t savedAt = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    p += 4;
+    uint64_t count = 0;
+    if (!GetVarint(p, end, count) || count > data.size()) return false;
+    records_.reserve(static_cast<size_t>(count));
+    uint64_t key = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta = 0, shows = 0, age = 0;
+        if (!GetVarint(p, end, delta) || !GetVarint(p, end, shows) || !GetVarint(p, end, age)) {
+            records_.clear();
+            return false;
+        }
+        key += delta;
+        ShowRecord& record = records_[key];
+        record.count = static_cast<uint32_t>(std::min<uint64_t>(shows, UINT32_MAX));
+        record.lastShown = age >= savedAt ? 0 : savedAt - static_cast<uint32_t>(age);
+    }
+    return true;
+}
+
+bool ShowHistory::Save(const std::filesystem::path& path) const
+{
+    std::vector<std::pair<uint64_t, ShowRecord>> sorted(records_.begin(), records_.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    const uint32_t savedAt = MinutesNow();
+    std::vector<uint8_t> out(std::begin(kHistoryMagic), std::end(kHistoryMagic));
+    for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<uint8_t>(savedAt >> shift));
+    PutVarint(out, sorted.size());
+    // Sorted keys are spread evenly, so the deltas need about log2(2^64 / n) bits each; ages
+    // relative to the save time are small for recently shown images
+    uint64_t previous = 0;
+    for (const auto& [key, record] : sorted) {
+        PutVarint(out, key - previous);
+        PutVarint(out, record.count);
+        PutVarint(out, record.lastShown <= savedAt ? savedAt - record.lastShown : 0);
+        previous = key;
+    }
+    return WriteFileAtomically(path, out);
+}
+
+const ShowRecord* ShowHistory::Find(uint64_t key) const
+{
+    auto it = records_.find(key);
+    return it == records_.end() ? nullptr : &it->second;
+}
+
+void ShowHistory::RecordShow(uint64_t key, uint32_t minute)
+{
+    ShowRecord& record = records_[key];
+    if (record.count < UINT32_MAX) ++record.count;
+    record.lastShown = minute;
+}
+
+double SelectionWeight(const ShowRecord* record, uint32_t nowMinute, SelectionWeighting weighting)
+{
+    switch (weighting) {
+    case SelectionWeighting::LeastRecent: {
+        if (!record || record->count == 0) return 1.0 + kRecencyCapHours;
+        const uint32_t hours = record->lastShown < nowMinute ? (nowMinute - record->lastShown) / 60 : 0;
+        return 1.0 + std::min(hours, kRecencyCapHours);
+    }
+    case SelectionWeighting::LeastOften:
+        return kFrequencyScale / (1.0 + (record ? record->count : 0));
+    case SelectionWeighting::Uniform:
+        break;
+    }
+    return 1.0;
+}
@@ -0,0 +1,516 @@
+// Slideshow.cpp - multi-output slideshow scheduling
+
+#include "Slideshow.h"
+#include "ImageProbe.h"
+#include "JpegFile.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "WeightedSampler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+static const size_t kMaxHistorySize = 1000;
+
+Slideshow::Slideshow(const ImageCatalog& catalog, ImageCache& cache, WorkerPool& pool, LoadFunction load)
+    : catalog_(&catalog), cache_(cache), pool_(pool), load_(std::move(load)),
+      lateSlides_(Metrics::Instance().GetCounter("hdr_slides_late_total", "Slides shown later than scheduled because they were not loaded")),
+      missedSlides_(Metrics::Instance().GetCounter("hdr_prefetch_deadline_misses_total", "Slides not loaded by the time they had to go on screen")),
+      lateness_(Metrics::Instance().GetHistogram("hdr_slide_lateness_us", "Delay of late slides behind their schedule (microseconds)")),
+      loadTime_(Metrics::Instance().GetHistogram("hdr_image_load_worker_us", "Loading one image into the cache (microseconds)"))
+{
+}
+
+Slideshow::~Slideshow()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    loaded_.wait(lock, [this] { return outstanding_ == 0; });
+}
+
+std::shared_ptr<const ImageData> Slideshow::LoadImageFile(const CatalogEntry& entry)
+{
+    static Counter& bytesRead = Metrics::Instance().GetCounter("hdr_bytes_read_total", "Image file bytes read from disk");
+    std::ifstream in(std::filesystem::path(entry.path), std::ios::in | std::ios::binary);
+    if (!in) return nullptr;
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    if (size < 0) return nullptr;
+    in.seekg(0, std::ios::beg);
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(static_cast<size_t>(size));
+    if (!in.read(reinterpret_cast<char*>(data->bytes.data()), size)) return nullptr;
+    bytesRead.Add(static_cast<uint64_t>(size));
+    return data;
+}
+
+std::shared_ptr<const ImageData> Slideshow::LoadImageFileForHeadroom(const CatalogEntry& entry, float headroom)
+{
+    if (headroom < 0) return LoadImageFile(entry);
+    static Counter& bytesRead = Metrics::Instance().GetCounter("hdr_bytes_read_total", "Image file bytes read from disk");
+    static Counter& omitted = Metrics::Instance().GetCounter("hdr_gain_maps_omitted_total", "Gain maps left unread because the display headroom gives them no weight");
+    static Counter& bytesSaved = Metrics::Instance().GetCounter("hdr_gain_map_bytes_saved_total", "File bytes left unread with the gain maps the display headroom gives no weight");
+    std::ifstream in(std::filesystem::path(entry.path), std::ios::in | std::ios::binary);
+    if (!in) return nullptr;
+    in.seekg(0, std::ios::end);
+    const std::streamoff end = in.tellg();
+    if (end < 0) return nullptr;
+    const size_t size = static_cast<size_t>(end);
+    uint64_t read = 0;
+    auto readAt = [&](size_t offset, uint8_t* out, size_t length) {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        if (!in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(length))) return false;
+        read += length;
+        return true;
+    };
+
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(std::min(size, kProbeHeadBytes));
+    if (!readAt(0, data->bytes.data(), data->bytes.size())) return nullptr;
+    // The gain map's metadata is in its own headers, behind the primary image
+    size_t keep = size;
+    std::vector<MpfImage> images;
+    if (ReadMpfImages(data->bytes.data(), data->bytes.size(), images, size) && images.size() >= 2 && images[0].offset == 0) {
+        std::vector<uint8_t> header;
+        for (size_t i = 1; i < images.size() && keep == size; ++i) {
+            if (images[i].offset < images[0].size) break;
+            header.resize(std::min(images[i].size, kGainMapHeadBytes));
+            GainMapMetadata metadata;
+            if (images[i].offset + header.size() <= data->bytes.size()) {
+                std::copy_n(data->bytes.begin() + static_cast<ptrdiff_t>(images[i].offset), header.size(), header.begin());
+            } else if (!readAt(images[i].offset, header.data(), header.size())) {
+                break;
+            }
+            if (ReadGainMapImageMetadata(header.data(), header.size(), metadata) && GainMapWeight(metadata, headroom) <= 0) keep = images[0].size;
+        }
+    }
+
+    const size_t head = data->bytes.size();
+    data->bytes.resize(keep);
+    if (keep > head && !readAt(head, data->bytes.data() + head, keep - head)) return nullptr;
+    if (keep < size) {
+        // Without the MPF directory the renderer does not go looking for the missing gain map
+        std::vector<JpegSegment> segments;
+        ReadJpegSegments(data->bytes.data(), data->bytes.size(), segments);
+        for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+            if (!IsMpfSegment(data->bytes.data(), *it)) continue;
+            const auto first = data->bytes.begin() + static_cast<ptrdiff_t>(it->offset);
+            data->bytes.erase(first, first + static_cast<ptrdiff_t>(it->length));
+        }
+        data->gainMapOmitted = true;
+        omitted.Add();
+        bytesSaved.Add(size - read);
+    }
+    bytesRead.Add(read);
+    return data;
+}
+
+size_t Slideshow::AddOutput(const SlideOutputConfig& config)
+{
+    OutputState& out = outputs_.emplace_back();
+    out.config = config;
+    out.current = Catalog().Empty() ? 0 : std::min(config.startIndex, Catalog().Size() - 1);
+    out.rng.seed(config.seed != 0 ? config.seed : std::random_device{}());
+    return outputs_.size() - 1;
+}
+
+void Slideshow::ExtendCatalog(const ImageCatalog& catalog, Clock::time_point now)
+{
+    // Workers still loading from the old catalog read the same entries at the same indices
+    catalog_.store(&catalog);
+    for (OutputState& out : outputs_) {
+        if (!out.started) continue;
+        // Plans made for the smaller catalog repeat its few slides
+        ClearUpcoming(out);
+        PlanUpcoming(out);
+        RequestLoads(out, now);
+    }
+}
+
+std::vector<SlideChange> Slideshow::Tick(Clock::time_point now)
+{
+    std::vector<SlideChange> changes;
+    if (Catalog().Empty()) return changes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ReleaseLocked(now);
+    }
+    for (size_t o = 0; o < outputs_.size(); ++o) {
+        OutputState& out = outputs_[o];
+        if (!out.started) {
+            out.started = true;
+            cache_.Pin(out.current);
+            Request(out.current, now, now);
+            out.switchAt = now + out.config.interval;
+            Shown(out);
+            PlanUpcoming(out);
+            RequestLoads(out, now);
+            changes.push_back({ o, out.current, false });
+            continue;
+        }
+        if (!out.config.autoAdvance) continue;
+        // Reported ahead by the time the renderer is expected to take, within kMaxRenderLead
+        Clock::duration lead{ 0 };
+        if (!out.upcoming.empty()) {
+            lead = std::min({ SlideshowTime(costModel_.Estimate(Catalog()[out.upcoming.front()], LoadStage::Render)), SlideshowTime(kMaxRenderLead),
+                              Clock::duration(out.config.interval / 4) });
+        }
+        if (now < out.switchAt - lead) continue;
+        if (!out.upcoming.empty() && !IsReady(out.upcoming.front())) {
+            if (!out.missed) {
+                out.missed = true;
+                ++out.stats.missed;
+                missedSlides_.Add();
+                LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"Slideshow: output {} slide {} not loaded by its deadline", o, out.upcoming.front());
+            }
+            // Hold the current slide while the next one is still loading, but not forever
+            const auto wait = std::min<Clock::duration>(out.config.interval, kMaxWait);
+            if (now - out.switchAt < wait) continue;
+        }
+        changes.push_back(Advance(o, now, true));
+    }
+    return changes;
+}
+
+std::vector<size_t> Slideshow::Upcoming(size_t output) const
+{
+    const std::deque<size_t>& upcoming = outputs_[output].upcoming;
+    return std::vector<size_t>(upcoming.begin(), upcoming.end());
+}
+
+void Slideshow::Resume(size_t output, size_t index, Clock::time_point now)
+{
+    OutputState& out = outputs_[output];
+    if (index >= Catalog().Size() || index == out.current) return;
+    if (!out.started) {
+        out.current = index;
+        return;
+    }
+    // The renderer may fetch the slide on screen again (after a WebView reinit)
+    if (cache_.Contains(out.current) && !cache_.Contains(index)) {
+        if (auto data = cache_.Get(out.current)) cache_.Put(index, std::move(data));
+    }
+    cache_.Pin(index);
+    cache_.Unpin(out.current);
+    out.current = index;
+    ClearUpcoming(out);
+    PlanUpcoming(out);
+    RequestLoads(out, now);
+}
+
+SlideChange Slideshow::Next(size_t output, Clock::time_point now)
+{
+    return Advance(output, now, false);
+}
+
+SlideChange Slideshow::Previous(size_t output, Clock::time_point now)
+{
+    OutputState& out = outputs_[output];
+    size_t previous = out.current;
+    if (out.config.order == SlideOrder::Random) {
+        if (out.historyPosition > 0) previous = out.history[--out.historyPosition];
+    } else if (!Catalog().Empty()) {
+        previous = (out.current + Catalog().Size() - 1) % Catalog().Size();
+        // The planned slides followed the old position
+        ClearUpcoming(out);
+    }
+    cache_.Pin(previous);
+    cache_.Unpin(out.current);
+    out.current = previous;
+    out.switchAt = now + out.config.interval;
+    out.missed = false;
+    Shown(out);
+    Request(out.current, now, now);
+    PlanUpcoming(out);
+    RequestLoads(out, now);
+    return { output, out.current, false };
+}
+
+SlideChange Slideshow::Advance(size_t output, Clock::time_point now, bool scheduled)
+{
+    OutputState& out = outputs_[output];
+    if (out.upcoming.empty()) PlanUpcoming(out);
+    if (out.upcoming.empty()) return { output, out.current, false };
+
+    if (out.config.order == SlideOrder::Random) {
+        // Going forward after going back starts a new branch, like a browser history
+        if (out.historyPosition < out.history.size()) out.history.resize(out.historyPosition);
+        out.history.push_back(out.current);
+        if (out.history.size() > kMaxHistorySize) out.history.erase(out.history.begin());
+        out.historyPosition = out.history.size();
+    }
+    // The pin of the planned slide carries over to the current one
+    cache_.Unpin(out.current);
+    out.current = out.upcoming.front();
+    out.upcoming.pop_front();
+
+    bool late = false;
+    if (scheduled && now - out.switchAt > kLateTolerance) {
+        late = true;
+        const auto behind = std::chrono::duration_cast<std::chrono::microseconds>(now - out.switchAt);
+        ++out.stats.late;
+        out.stats.worstLateness = std::max(out.stats.worstLateness, behind);
+        lateSlides_.Add();
+        lateness_.Record(static_cast<uint64_t>(behind.count()));
+        LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"Slideshow: output {} showed slide {} {} ms late", output, out.current,
+                std::chrono::duration_cast<std::chrono::milliseconds>(behind).count());
+    }
+    Shown(out);
+    // An advance reported ahead of its time keeps the timeline
+    out.switchAt = (scheduled ? std::max(now, out.switchAt) : now) + out.config.interval;
+    out.missed = false;
+    if (!scheduled) Request(out.current, now, now);
+    PlanUpcoming(out);
+    RequestLoads(out, now);
+    return { output, out.current, late };
+}
+
+void Slideshow::PlanUpcoming(OutputState& out)
+{
+    const size_t count = Catalog().Size();
+    if (count == 0) return;
+    while (out.upcoming.size() < kPrefetchDepth) {
+        const size_t last = out.upcoming.empty() ? out.current : out.upcoming.back();
+        const size_t next = out.config.order == SlideOrder::Random ? PickRandom(out, last) : (last + 1) % count;
+        cache_.Pin(next);
+        out.upcoming.push_back(next);
+    }
+}
+
+void Slideshow::Shown(OutputState& out)
+{
+    ++out.stats.shown;
+    if (onShow_) onShow_(out.current);
+}
+
+size_t Slideshow::PickRandom(OutputState& out, size_t previous)
+{
+    const size_t count = Catalog().Size();
+    std::uniform_int_distribution<size_t> dist(0, count - 1);
+    const bool weighted = sampler_ && sampler_->Size() == count && !sampler_->Empty();
+    auto draw = [&] { return weighted ? sampler_->Draw(out.rng) : dist(out.rng); };
+    size_t pick = draw();
+    // Avoid repeating the previous slide and showing the same image on two outputs at once;
+    // small catalogs make that impossible, so only a few draws are tried
+    for (int attempt = 0; attempt < 8 && count > 1; ++attempt) {
+        bool clash = pick == previous;
+        for (const OutputState& other : outputs_) {
+            if (&other != &out && other.started && other.current == pick) clash = true;
+        }
+        if (!clash) break;
+        pick = draw();
+    }
+    return pick;
+}
+
+void Slideshow::ClearUpcoming(OutputState& out)
+{
+    for (size_t index : out.upcoming) cache_.Unpin(index);
+    out.upcoming.clear();
+}
+
+void Slideshow::RequestLoads(OutputState& out, Clock::time_point now)
+{
+    // Slide k of the plan is due k intervals after the next switch; manual outputs get the same
+    // spacing so their loads still queue behind the automatic outputs' due slides
+    Clock::time_point deadline = out.config.autoAdvance ? out.switchAt : now + out.config.interval;
+    for (size_t index : out.upcoming) {
+        Request(index, deadline, now);
+        deadline += out.config.interval;
+    }
+}
+
+void Slideshow::Request(size_t index, Clock::time_point deadline, Clock::time_point now)
+{
+    if (cache_.Contains(index)) return;
+    const Clock::duration cost = SlideshowTime(costModel_.Estimate(Catalog()[index]) + kStartMargin);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_.count(index)) return;
+    auto it = pending_.find(index);
+    // Already planned for an earlier time or being loaded right now
+    if (it != pending_.end() && (it->second.loading || it->second.deadline <= deadline)) return;
+    PendingLoad& load = pending_[index];
+    load.deadline = deadline;
+    load.start = deadline - cost;
+    load.cost = cost;
+    // Planned with the other loads not yet started, so one that is due now moves those due before
+    // it forward. A job queued earlier for a later start stays in the queue and finds the work done.
+    deferred_.emplace(load.start, index);
+    PlanStartsLocked();
+    ReleaseLocked(now);
+}
+
+void Slideshow::SubmitLocked(size_t index, WorkerLane lane, Clock::time_point start)
+{
+    const bool early = lane == WorkerLane::Background;
+    if (early) {
+        pending_[index].early = true;
+        ++earlyLoads_;
+    }
+    ++outstanding_;
+    pool_.Submit(lane, start, [this, index, early] { RunLoad(index, early); });
+}
+
+void Slideshow::PlanStartsLocked()
+{
+    std::vector<std::pair<Clock::time_point, size_t>> loads;   // deadline, index
+    for (const auto& [start, index] : deferred_) {
+        auto it = pending_.find(index);
+        if (it != pending_.end() && !it->second.loading && it->second.start == start) loads.emplace_back(it->second.deadline, index);
+    }
+    // Backwards from the last deadline, every load goes to the worker that is free the latest and
+    // ends by its deadline or by the start of that worker's next load, whichever is sooner
+    std::sort(loads.begin(), loads.end(), std::greater<>());
+    std::vector<Clock::time_point> freeUntil(std::max(1u, pool_.ThreadCount()), Clock::time_point::max());
+    deferred_.clear();
+    for (const auto& [deadline, index] : loads) {
+        auto worker = std::max_element(freeUntil.begin(), freeUntil.end());
+        PendingLoad& load = pending_[index];
+        load.start = std::min(deadline, *worker) - load.cost;
+        *worker = load.start;
+        deferred_.emplace(load.start, index);
+    }
+}
+
+void Slideshow::ReleaseLocked(Clock::time_point now)
+{
+    while (!deferred_.empty() && deferred_.begin()->first <= now) {
+        const auto [start, index] = *deferred_.begin();
+        deferred_.erase(deferred_.begin());
+        // Entries of loads done, running, or planned again for an earlier start are stale
+        auto it = pending_.find(index);
+        if (it == pending_.end() || it->second.loading || it->second.start != start) continue;
+        SubmitLocked(index, WorkerLane::Display, start);
+    }
+    ReleaseEarlyLocked();
+}
+
+void Slideshow::ReleaseEarlyLocked()
+{
+    // Early loads stay in deferred_, so one stuck behind other background work still goes to
+    // the display lane at its latest start
+    for (auto entry = deferred_.begin(); entry != deferred_.end() && earlyLoads_ < kMaxEarlyLoads;) {
+        auto it = pending_.find(entry->second);
+        if (it == pending_.end() || it->second.loading || it->second.start != entry->first) {
+            entry = deferred_.erase(entry);
+            continue;
+        }
+        if (!it->second.early) SubmitLocked(entry->second, WorkerLane::Background, entry->first);
+        ++entry;
+    }
+}
+
+void Slideshow::RunLoad(size_t index, bool early)
+{
+    bool load = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_.find(index);
+        if (it != pending_.end() && !it->second.loading) {
+            if (cache_.Contains(index)) pending_.erase(it);
+            else load = it->second.loading = true;
+        }
+    }
+    std::shared_ptr<const ImageData> data;
+    if (load) {
+        data = Load(index);
+        cache_.Put(index, data);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (load) {
+        pending_.erase(index);
+        if (!data) failed_.insert(index);
+    }
+    --outstanding_;
+    if (early) {
+        --earlyLoads_;
+        ReleaseEarlyLocked();
+    }
+    loaded_.notify_all();
+}
+
+void Slideshow::AcquireAsync(size_t index, std::function<void(std::shared_ptr<const ImageData>)> done)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++outstanding_;
+    }
+    pool_.Submit(WorkerLane::Display, Clock::now(), [this, index, done = std::move(done)] {
+        done(Acquire(index));
+        std::lock_guard<std::mutex> lock(mutex_);
+        --outstanding_;
+        loaded_.notify_all();
+    });
+}
+
+std::shared_ptr<const ImageData> Slideshow::Load(size_t index)
+{
+    ScopedTimer timer(loadTime_);
+    const CatalogEntry& entry = Catalog()[index];
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const ImageData> data = load_(entry);
+    if (!data) LOG_FMT(LogLevel::Warn, LogCategory::Navigation, L"Slideshow: failed to load {}", entry.path);
+    else costModel_.Record(entry, LoadStage::Read, std::chrono::duration_cast<LoadCostModel::Duration>(std::chrono::steady_clock::now() - start));
+    return data;
+}
+
+void Slideshow::Reload(const std::function<bool(const ImageData&)>& stale, Clock::time_point now)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        loaded_.wait(lock, [this] {
+            return std::none_of(pending_.begin(), pending_.end(), [](const auto& load) { return load.second.loading; });
+        });
+    }
+    const std::vector<uint64_t> erased = cache_.EraseIf(stale);
+    if (erased.empty()) return;
+    LOG_FMT(LogLevel::Info, LogCategory::Navigation, L"Slideshow: reloading {} cached images", erased.size());
+    for (OutputState& out : outputs_) {
+        if (!out.started) continue;
+        Request(out.current, now, now);
+        RequestLoads(out, now);
+    }
+}
+
+Slideshow::Clock::duration Slideshow::SlideshowTime(LoadCostModel::Duration duration) const
+{
+    return std::chrono::duration_cast<Clock::duration>(duration * clockRate_);
+}
+
+bool Slideshow::IsReady(size_t index)
+{
+    if (cache_.Contains(index)) return true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_.count(index) != 0;
+}
+
+std::shared_ptr<const ImageData> Slideshow::Acquire(size_t index)
+{
+    if (index >= Catalog().Size()) return nullptr;
+    if (auto data = cache_.Get(index)) return data;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Wait for a worker that is already reading the file rather than reading it twice
+        loaded_.wait(lock, [&] {
+            auto it = pending_.find(index);
+            return it == pending_.end() || !it->second.loading;
+        });
+        if (failed_.count(index)) return nullptr;
+        if (cache_.Contains(index)) {
+            lock.unlock();
+            if (auto data = cache_.Get(index)) return data;
+            lock.lock();
+        }
+        // Queued jobs for this index see it loading and skip it
+        pending_[index].loading = true;
+    }
+    std::shared_ptr<const ImageData> data = Load(index);
+    cache_.Put(index, data);
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.erase(index);
+    if (!data) failed_.insert(index);
+    loaded_.notify_all();
+    return data;
+}
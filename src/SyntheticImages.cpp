@@ -0,0 +1,1053 @@
+// SyntheticImages.cpp - test image builders and the corpus writer
+#include "SyntheticImages.h"
+#include "HdrRender.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace {
+
+const char* const kKindNames[kSyntheticKinds] = { "ultrahdr", "jpeg", "png", "pq-png", "gif", "bmp", "webp", "svg",
+                                                  "avif", "jxl", "tiff", "truncated", "bad-header", "empty", "misnamed", "sidecar" };
+const char* const kKindExtensions[kSyntheticKinds] = { ".jpg", ".jpg", ".png", ".png", ".gif", ".bmp", ".webp", ".svg",
+                                                       ".avif", ".jxl", ".tif", ".jpg", ".jpg", ".jpg", ".jpg", ".xmp" };
+
+// What a stamp holds until StampSyntheticImage writes the file number
+const char kStampPlaceholder[] = "0000000000000000";
+static_assert(sizeof(kStampPlaceholder) - 1 == SyntheticImage::kStampDigits, "stamp size");
+
+// SplitMix64: every file draws from its own hash of (seed, index), so files can be decided in
+// any order and on any thread
+uint64_t Mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+double Unit(uint64_t hash)
+{
+    return static_cast<double>(hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void Put16BE(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void Put32BE(std::vector<uint8_t>& out, uint32_t v)
+{
+    Put16BE(out, v >> 16);
+    Put16BE(out, v & 0xFFFF);
+}
+
+void Put16LE(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void Put32LE(std::vector<uint8_t>& out, uint32_t v)
+{
+    Put16LE(out, v & 0xFFFF);
+    Put16LE(out, v >> 16);
+}
+
+void PutText(std::vector<uint8_t>& out, const std::string& text)
+{
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+void Append(std::vector<uint8_t>& out, const std::vector<uint8_t>& part)
+{
+    out.insert(out.end(), part.begin(), part.end());
+}
+
+// Appends the placeholder and records where it is
+void PutStamp(SyntheticImage& image)
+{
+    image.stamp = image.bytes.size();
+    image.stamped = true;
+    PutText(image.bytes, kStampPlaceholder);
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// zlib stream of stored deflate blocks
+std::vector<uint8_t> StoredZlib(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> out = { 0x78, 0x01 };
+    size_t pos = 0;
+    do {
+        const size_t length = std::min<size_t>(data.size() - pos, 65535);
+        out.push_back(pos + length == data.size() ? 1 : 0);
+        Put16LE(out, static_cast<uint32_t>(length));
+        Put16LE(out, static_cast<uint32_t>(~length & 0xFFFF));
+        out.insert(out.end(), data.begin() + static_cast<std::ptrdiff_t>(pos), data.begin() + static_cast<std::ptrdiff_t>(pos + length));
+        pos += length;
+    } while (pos < data.size());
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : data) {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    Put32BE(out, (b << 16) | a);
+    return out;
+}
+
+// PNG chunk; returns the offset of its data
+size_t PutPngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+    Put32BE(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    Append(out, data);
+    Put32BE(out, Crc32(out.data() + start, out.size() - start));
+    return start + 4;
+}
+
+std::vector<uint8_t> Box(const char* type, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> box;
+    Put32BE(box, static_cast<uint32_t>(8 + payload.size()));
+    box.insert(box.end(), type, type + 4);
+    Append(box, payload);
+    return box;
+}
+
+std::vector<uint8_t> FullBox(const char* type, uint8_t version, uint32_t flags, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> body;
+    Put32BE(body, (uint32_t(version) << 24) | flags);
+    Append(body, payload);
+    return Box(type, body);
+}
+
+// Top-level ISOBMFF 'free' box holding the stamp
+void PutFreeBoxStamp(SyntheticImage& image)
+{
+    Put32BE(image.bytes, static_cast<uint32_t>(8 + SyntheticImage::kStampDigits));
+    PutText(image.bytes, "free");
+    PutStamp(image);
+}
+
+std::string Number(float value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%g", static_cast<double>(value));
+    return text;
+}
+
+// Smooth color gradients, a bright sun-like spot and fine noise, all placed by the seed. RGB,
+// 8 bits, row after row.
+struct Scene {
+    int width, height;
+    double fx, fy, px, py;
+    double sunX, sunY, sunRadius;
+    uint64_t seed;
+
+    Scene(int w, int h, uint64_t s) : width(w), height(h), seed(Mix(s)) {
+        uint64_t r = seed;
+        auto next = [&r] { r = Mix(r); return Unit(r); };
+        fx = (2 + 6 * next()) * 3.14159265 / w;
+        fy = (2 + 6 * next()) * 3.14159265 / h;
+        px = 6.2831853 * next();
+        py = 6.2831853 * next();
+        sunX = w * (0.2 + 0.6 * next());
+        sunY = h * (0.15 + 0.4 * next());
+        sunRadius = std::max(4.0, std::min(w, h) * (0.08 + 0.1 * next()));
+    }
+
+    // 0..1 brightness of the sun at a pixel
+    double Sun(int x, int y) const {
+        const double dx = (x - sunX) / sunRadius, dy = (y - sunY) / sunRadius;
+        return std::exp(-(dx * dx + dy * dy));
+    }
+
+    void Row(int y, uint8_t* rgb) const {
+        uint32_t noise = static_cast<uint32_t>(seed) ^ static_cast<uint32_t>(y * 2654435761u);
+        const double cy = std::cos(y * fy + py);
+        for (int x = 0; x < width; ++x) {
+            noise = noise * 1664525u + 1013904223u;
+            const double sun = Sun(x, y);
+            const double base = 0.5 + 0.35 * std::sin(x * fx + px) * cy;
+            const double grain = static_cast<double>(noise >> 28) - 7.5;
+            const double r = 255 * (base * 0.9 + 0.1) + grain;
+            const double g = 255 * (0.3 + 0.4 * (static_cast<double>(y) / height)) + grain;
+            const double b = 255 * (1.0 - base * 0.8) + grain;
+            rgb[3 * x + 0] = static_cast<uint8_t>(std::clamp(r + (255 - r) * sun, 0.0, 255.0));
+            rgb[3 * x + 1] = static_cast<uint8_t>(std::clamp(g + (255 - g) * sun, 0.0, 255.0));
+            rgb[3 * x + 2] = static_cast<uint8_t>(std::clamp(b + (255 - b) * sun, 0.0, 255.0));
+        }
+    }
+
+    std::vector<uint8_t> Rgb() const {
+        std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+        for (int y = 0; y < height; ++y) Row(y, rgb.data() + static_cast<size_t>(y) * width * 3);
+        return rgb;
+    }
+};
+
+PlanarImage YCbCrImage(const Scene& scene)
+{
+    PlanarImage image;
+    image.Allocate(scene.width, scene.height, 3);
+    std::vector<uint8_t> row(static_cast<size_t>(scene.width) * 3);
+    for (int y = 0; y < scene.height; ++y) {
+        scene.Row(y, row.data());
+        const size_t base = static_cast<size_t>(y) * scene.width;
+        for (int x = 0; x < scene.width; ++x) {
+            const double r = row[3 * x], g = row[3 * x + 1], b = row[3 * x + 2];
+            image.planes[0][base + x] = static_cast<uint8_t>(std::clamp(0.299 * r + 0.587 * g + 0.114 * b + 0.5, 0.0, 255.0));
+            image.planes[1][base + x] = static_cast<uint8_t>(std::clamp(128 - 0.168736 * r - 0.331264 * g + 0.5 * b + 0.5, 0.0, 255.0));
+            image.planes[2][base + x] = static_cast<uint8_t>(std::clamp(128 + 0.5 * r - 0.418688 * g - 0.081312 * b + 0.5, 0.0, 255.0));
+        }
+    }
+    return image;
+}
+
+// s15Fixed16Number
+void PutFixed(std::vector<uint8_t>& out, double value)
+{
+    Put32BE(out, static_cast<uint32_t>(static_cast<int32_t>(std::lround(value * 65536.0))));
+}
+
+// ICC v4 display profile "Display P3": D50-adapted P3 colorants, sRGB tone curve
+const std::vector<uint8_t>& DisplayP3Profile()
+{
+    static const std::vector<uint8_t> profile = [] {
+        const auto xyz = [](double x, double y, double z) {
+            std::vector<uint8_t> tag;
+            PutText(tag, "XYZ ");
+            Put32BE(tag, 0);
+            PutFixed(tag, x);
+            PutFixed(tag, y);
+            PutFixed(tag, z);
+            return tag;
+        };
+        std::vector<uint8_t> desc;
+        PutText(desc, "mluc");
+        Put32BE(desc, 0);
+        Put32BE(desc, 1);                          // one record
+        Put32BE(desc, 12);                         // record size
+        PutText(desc, "enUS");
+        const std::string name = "Display P3";
+        Put32BE(desc, static_cast<uint32_t>(name.size() * 2));
+        Put32BE(desc, 28);
+        for (char c : name) Put16BE(desc, static_cast<uint8_t>(c));
+        std::vector<uint8_t> trc;
+        PutText(trc, "para");
+        Put32BE(trc, 0);
+        Put16BE(trc, 3);                           // Y = (aX + b)^g for X >= d, else cX
+        Put16BE(trc, 0);
+        PutFixed(trc, 2.4);
+        PutFixed(trc, 1 / 1.055);
+        PutFixed(trc, 0.055 / 1.055);
+        PutFixed(trc, 1 / 12.92);
+        PutFixed(trc, 0.04045);
+
+        struct Tag { const char* signature; std::vector<uint8_t> data; };
+        const Tag tags[] = {
+            { "desc", desc }, { "wtpt", xyz(0.9642, 1.0, 0.8249) },
+            { "rXYZ", xyz(0.515121, 0.241196, -0.001053) }, { "gXYZ", xyz(0.291977, 0.692245, 0.041885) },
+            { "bXYZ", xyz(0.157104, 0.066574, 0.784073) }, { "rTRC", trc }, { "gTRC", trc }, { "bTRC", trc },
+        };
+        const size_t count = std::size(tags);
+        std::vector<uint8_t> table, data;
+        size_t offset = 128 + 4 + count * 12;
+        size_t trcOffset = 0;
+        for (const Tag& tag : tags) {
+            const bool sharedTrc = std::strcmp(tag.signature + 1, "TRC") == 0 && trcOffset != 0;
+            table.insert(table.end(), tag.signature, tag.signature + 4);
+            Put32BE(table, static_cast<uint32_t>(sharedTrc ? trcOffset : offset));
+            Put32BE(table, static_cast<uint32_t>(tag.data.size()));
+            if (sharedTrc) continue;
+            if (std::strcmp(tag.signature + 1, "TRC") == 0) trcOffset = offset;
+            Append(data, tag.data);
+            while (data.size() % 4) data.push_back(0);
+            offset = 128 + 4 + count * 12 + data.size();
+        }
+
+        std::vector<uint8_t> icc;
+        Put32BE(icc, static_cast<uint32_t>(offset));
+        Put32BE(icc, 0);                           // preferred CMM
+        Put32BE(icc, 0x04300000);                  // version 4.3
+        PutText(icc, "mntrRGB XYZ ");
+        Put16BE(icc, 2024); Put16BE(icc, 1); Put16BE(icc, 1);
+        Put16BE(icc, 0); Put16BE(icc, 0); Put16BE(icc, 0);
+        PutText(icc, "acsp");
+        icc.resize(icc.size() + 24, 0);            // platform, flags, manufacturer, model, attributes
+        Put32BE(icc, 0);                           // perceptual intent
+        PutFixed(icc, 0.9642);                     // PCS illuminant D50
+        PutFixed(icc, 1.0);
+        PutFixed(icc, 0.8249);
+        icc.resize(128, 0);                        // creator, profile ID, reserved
+        Put32BE(icc, static_cast<uint32_t>(count));
+        Append(icc, table);
+        Append(icc, data);
+        return icc;
+    }();
+    return profile;
+}
+
+std::vector<uint8_t> IccSegment()
+{
+    const std::vector<uint8_t>& profile = DisplayP3Profile();
+    std::vector<uint8_t> segment = { 0xFF, 0xE2 };
+    Put16BE(segment, static_cast<uint32_t>(2 + 14 + profile.size()));
+    PutText(segment, std::string("ICC_PROFILE", 12));
+    segment.push_back(1);                          // chunk 1 of 1
+    segment.push_back(1);
+    Append(segment, profile);
+    return segment;
+}
+
+// COM segment with the stamp, so it sits in the first bytes of the file
+std::vector<uint8_t> StampSegment()
+{
+    std::vector<uint8_t> segment = { 0xFF, 0xFE };
+    const std::string text = std::string("hdrgen ") + kStampPlaceholder;
+    Put16BE(segment, static_cast<uint32_t>(2 + text.size()));
+    PutText(segment, text);
+    return segment;
+}
+
+std::string GainMapXmp(const SyntheticImageOptions& options)
+{
+    return "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"><rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+           "<rdf:Description xmlns:hdrgm=\"http://ns.adobe.com/hdr-gain-map/1.0/\" hdrgm:Version=\"1.0\" hdrgm:GainMapMin=\"0\" "
+           "hdrgm:GainMapMax=\"" + Number(options.gainMapMax) + "\" hdrgm:Gamma=\"1\" hdrgm:OffsetSDR=\"0.015625\" hdrgm:OffsetHDR=\"0.015625\" "
+           "hdrgm:HDRCapacityMin=\"0\" hdrgm:HDRCapacityMax=\"" + Number(options.hdrCapacityMax) + "\" hdrgm:BaseRenditionIsHDR=\"False\"/>"
+           "</rdf:RDF></x:xmpmeta>";
+}
+
+// Primary image XMP: hdrgm version and the GContainer directory Ultra HDR readers locate the
+// gain map with
+std::string PrimaryXmp(size_t gainMapLength)
+{
+    return "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"><rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+           "<rdf:Description xmlns:hdrgm=\"http://ns.adobe.com/hdr-gain-map/1.0/\" xmlns:Container=\"http://ns.google.com/photos/1.0/container/\" "
+           "xmlns:Item=\"http://ns.google.com/photos/1.0/container/item/\" hdrgm:Version=\"1.0\"><Container:Directory><rdf:Seq>"
+           "<rdf:li rdf:parseType=\"Resource\"><Container:Item Item:Semantic=\"Primary\" Item:Mime=\"image/jpeg\"/></rdf:li>"
+           "<rdf:li rdf:parseType=\"Resource\"><Container:Item Item:Semantic=\"GainMap\" Item:Mime=\"image/jpeg\" Item:Length=\"" +
+           std::to_string(gainMapLength) + "\"/></rdf:li></rdf:Seq></Container:Directory></rdf:Description></rdf:RDF></x:xmpmeta>";
+}
+
+// Locates the stamp of a JPEG built with StampSegment
+void FindJpegStamp(SyntheticImage& image)
+{
+    std::vector<JpegSegment> segments;
+    ReadJpegSegments(image.bytes.data(), image.bytes.size(), segments);
+    for (const JpegSegment& segment : segments) {
+        if (segment.marker != 0xFE) continue;
+        image.stamp = segment.PayloadOffset() + 7;
+        image.stamped = true;
+        return;
+    }
+}
+
+bool BuildJpeg(const Scene& scene, const SyntheticImageOptions& options, bool gainMap, SyntheticImage& image, std::string* error)
+{
+    std::vector<uint8_t> gainMapJpeg;
+    if (gainMap) {
+        // Gain follows the sun: full boost in its core, none in the shadows
+        const int scale = std::max(1, options.gainMapScale);
+        PlanarImage map;
+        map.Allocate(std::max(1, scene.width / scale), std::max(1, scene.height / scale), 1);
+        for (int y = 0; y < map.height; ++y) {
+            for (int x = 0; x < map.width; ++x) {
+                const double sun = scene.Sun(x * scale + scale / 2, y * scale + scale / 2);
+                map.planes[0][static_cast<size_t>(y) * map.width + x] = static_cast<uint8_t>(std::lround(40 + 215 * sun));
+            }
+        }
+        JpegEncodeOptions mapOptions;
+        mapOptions.quality = options.quality;
+        mapOptions.subsampleChroma = false;
+        mapOptions.segments.push_back(BuildXmpSegment(GainMapXmp(options)));
+        if (!EncodeJpeg(map, mapOptions, gainMapJpeg)) {
+            if (error) *error = "gain map encode failed";
+            return false;
+        }
+    }
+
+    JpegEncodeOptions primaryOptions;
+    primaryOptions.quality = options.quality;
+    primaryOptions.restartInterval = options.restartInterval;
+    size_t mpfOffset = 2;
+    if (gainMap) primaryOptions.segments.push_back(BuildXmpSegment(PrimaryXmp(gainMapJpeg.size())));
+    if (options.icc) primaryOptions.segments.push_back(IccSegment());
+    for (const auto& segment : primaryOptions.segments) mpfOffset += segment.size();
+    if (gainMap) primaryOptions.segments.push_back(BuildMpfSegment(0, 0, 0));
+    primaryOptions.segments.push_back(StampSegment());
+    if (!EncodeJpeg(YCbCrImage(scene), primaryOptions, image.bytes)) {
+        if (error) *error = "encode failed";
+        return false;
+    }
+    if (gainMap) {
+        const size_t primaryLength = image.bytes.size();
+        const std::vector<uint8_t> mpf = BuildMpfSegment(static_cast<uint32_t>(primaryLength), static_cast<uint32_t>(gainMapJpeg.size()),
+                                                         static_cast<uint32_t>(primaryLength - (mpfOffset + kMpfTiffHeaderOffset)));
+        std::copy(mpf.begin(), mpf.end(), image.bytes.begin() + static_cast<std::ptrdiff_t>(mpfOffset));
+        Append(image.bytes, gainMapJpeg);
+    }
+    FindJpegStamp(image);
+    return true;
+}
+
+void BuildPng(const Scene& scene, const SyntheticImageOptions& options, SyntheticImage& image)
+{
+    std::vector<uint8_t>& out = image.bytes;
+    out.assign({ 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A });
+    std::vector<uint8_t> ihdr;
+    Put32BE(ihdr, static_cast<uint32_t>(scene.width));
+    Put32BE(ihdr, static_cast<uint32_t>(scene.height));
+    ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });
+    PutPngChunk(out, "IHDR", ihdr);
+    if (options.icc) {
+        std::vector<uint8_t> iccp;
+        PutText(iccp, std::string("Display P3", 11));
+        iccp.push_back(0);                         // deflate
+        Append(iccp, StoredZlib(DisplayP3Profile()));
+        PutPngChunk(out, "iCCP", iccp);
+    }
+    std::vector<uint8_t> text;
+    PutText(text, std::string("hdrgen", 7));
+    PutText(text, kStampPlaceholder);
+    const size_t data = PutPngChunk(out, "tEXt", text);
+    image.stamp = data + 7;
+    image.stamped = true;
+    image.crcStart = data - 4;
+    image.crcEnd = data + text.size();
+
+    const size_t rowBytes = 1 + static_cast<size_t>(scene.width) * 3;
+    std::vector<uint8_t> raw(rowBytes * scene.height);
+    for (int y = 0; y < scene.height; ++y) {
+        raw[y * rowBytes] = 0;                     // filter: none
+        scene.Row(y, raw.data() + y * rowBytes + 1);
+    }
+    PutPngChunk(out, "IDAT", StoredZlib(raw));
+    PutPngChunk(out, "IEND", {});
+}
+
+void BuildPqPng(const Scene& scene, SyntheticImage& image)
+{
+    // Linear light with SDR white at 1: the scene below white, the sun up to 4x (two stops) above
+    HdrImage hdr;
+    hdr.Allocate(scene.width, scene.height);
+    std::vector<uint8_t> row(static_cast<size_t>(scene.width) * 3);
+    for (int y = 0; y < scene.height; ++y) {
+        scene.Row(y, row.data());
+        float* dst = hdr.rgb.data() + static_cast<size_t>(y) * scene.width * 3;
+        for (int x = 0; x < scene.width; ++x) {
+            const float boost = 1.0f + 3.0f * static_cast<float>(scene.Sun(x, y));
+            for (int c = 0; c < 3; ++c) dst[3 * x + c] = std::pow(row[3 * x + c] / 255.0f, 2.2f) * boost;
+        }
+    }
+    EncodePqPng(hdr, 203.0f, image.bytes);
+    // The stamp goes in a tEXt chunk in front of IEND
+    std::vector<uint8_t> iend(image.bytes.end() - 12, image.bytes.end());
+    image.bytes.erase(image.bytes.end() - 12, image.bytes.end());
+    std::vector<uint8_t> text;
+    PutText(text, std::string("hdrgen", 7));
+    PutText(text, kStampPlaceholder);
+    const size_t data = PutPngChunk(image.bytes, "tEXt", text);
+    image.stamp = data + 7;
+    image.stamped = true;
+    image.crcStart = data - 4;
+    image.crcEnd = data + text.size();
+    Append(image.bytes, iend);
+}
+
+void BuildGif(const Scene& scene, SyntheticImage& image)
+{
+    std::vector<uint8_t>& out = image.bytes;
+    PutText(out, "GIF89a");
+    Put16LE(out, static_cast<uint32_t>(scene.width));
+    Put16LE(out, static_cast<uint32_t>(scene.height));
+    out.insert(out.end(), { 0xF7, 0, 0 });        // global color table of 256 entries
+    for (int i = 0; i < 256; ++i) out.insert(out.end(), { static_cast<uint8_t>(i), static_cast<uint8_t>(i), static_cast<uint8_t>(i) });
+    out.insert(out.end(), { 0x21, 0xFE, 7 + SyntheticImage::kStampDigits });   // comment extension
+    PutText(out, "hdrgen ");
+    PutStamp(image);
+    out.push_back(0);
+    out.push_back(0x2C);
+    Put32LE(out, 0);
+    Put16LE(out, static_cast<uint32_t>(scene.width));
+    Put16LE(out, static_cast<uint32_t>(scene.height));
+    out.push_back(0);
+    out.push_back(8);                              // LZW minimum code size
+
+    // Literal codes only, with a clear code before the table would need 10-bit codes
+    std::vector<uint8_t> lzw;
+    uint32_t acc = 0;
+    int bits = 0;
+    auto code = [&](uint32_t c) {
+        acc |= c << bits;
+        for (bits += 9; bits >= 8; bits -= 8, acc >>= 8) lzw.push_back(static_cast<uint8_t>(acc));
+    };
+    std::vector<uint8_t> row(static_cast<size_t>(scene.width) * 3);
+    int run = 0;
+    for (int y = 0; y < scene.height; ++y) {
+        scene.Row(y, row.data());
+        for (int x = 0; x < scene.width; ++x) {
+            if (run == 0) code(256);
+            code((row[3 * x] * 77u + row[3 * x + 1] * 150u + row[3 * x + 2] * 29u) >> 8);
+            if (++run == 252) run = 0;
+        }
+    }
+    code(257);
+    if (bits > 0) lzw.push_back(static_cast<uint8_t>(acc));
+    for (size_t pos = 0; pos < lzw.size(); pos += 255) {
+        const size_t n = std::min<size_t>(255, lzw.size() - pos);
+        out.push_back(static_cast<uint8_t>(n));
+        out.insert(out.end(), lzw.begin() + static_cast<std::ptrdiff_t>(pos), lzw.begin() + static_cast<std::ptrdiff_t>(pos + n));
+    }
+    out.push_back(0);
+    out.push_back(0x3B);
+}
+
+void BuildBmp(const Scene& scene, SyntheticImage& image)
+{
+    std::vector<uint8_t>& out = image.bytes;
+    const size_t rowBytes = (static_cast<size_t>(scene.width) * 3 + 3) & ~size_t(3);
+    const size_t pixels = 14 + 40 + SyntheticImage::kStampDigits;
+    PutText(out, "BM");
+    Put32LE(out, static_cast<uint32_t>(pixels + rowBytes * scene.height));
+    Put32LE(out, 0);
+    Put32LE(out, static_cast<uint32_t>(pixels));
+    Put32LE(out, 40);
+    Put32LE(out, static_cast<uint32_t>(scene.width));
+    Put32LE(out, static_cast<uint32_t>(scene.height));          // positive: bottom-up
+    Put16LE(out, 1);
+    Put16LE(out, 24);
+    Put32LE(out, 0);                                             // BI_RGB
+    Put32LE(out, static_cast<uint32_t>(rowBytes * scene.height));
+    Put32LE(out, 2835);
+    Put32LE(out, 2835);
+    Put32LE(out, 0);
+    Put32LE(out, 0);
+    PutStamp(image);                                             // gap before the pixel data
+    out.resize(pixels + rowBytes * scene.height, 0);
+    std::vector<uint8_t> row(static_cast<size_t>(scene.width) * 3);
+    for (int y = 0; y < scene.height; ++y) {
+        scene.Row(y, row.data());
+        uint8_t* dst = out.data() + pixels + (scene.height - 1 - y) * rowBytes;
+        for (int x = 0; x < scene.width; ++x) {
+            dst[3 * x] = row[3 * x + 2];
+            dst[3 * x + 1] = row[3 * x + 1];
+            dst[3 * x + 2] = row[3 * x];
+        }
+    }
+}
+
+// Least significant bit first, as VP8L and JPEG XL are written
+struct BitWriter {
+    std::vector<uint8_t> bytes;
+    size_t bit = 0;
+
+    void Bits(uint32_t value, int n) {
+        for (int i = 0; i < n; ++i, ++bit) {
+            if ((bit >> 3) >= bytes.size()) bytes.push_back(0);
+            bytes[bit >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (bit & 7));
+        }
+    }
+};
+
+void BuildWebP(const Scene& scene, SyntheticImage& image)
+{
+    // Lossless bitstream without transforms or color cache. Every channel has a "simple" prefix
+    // code of two symbols (a 1-bit code each: a dark and a light value), alpha and distance one
+    // symbol (no bits), so every pixel takes three bits.
+    const uint8_t low[3] = { 40, 50, 70 }, high[3] = { 235, 215, 190 };
+    BitWriter w;
+    w.Bits(0x2F, 8);
+    w.Bits(static_cast<uint32_t>(scene.width - 1), 14);
+    w.Bits(static_cast<uint32_t>(scene.height - 1), 14);
+    w.Bits(0, 1);                                  // alpha unused
+    w.Bits(0, 3);                                  // version
+    w.Bits(0, 1);                                  // no transform
+    w.Bits(0, 1);                                  // no color cache
+    w.Bits(0, 1);                                  // no meta prefix codes
+    const int order[3] = { 1, 0, 2 };              // green, red, blue
+    for (int c : order) {
+        w.Bits(1, 1); w.Bits(1, 1); w.Bits(1, 1);  // simple code, two symbols, 8-bit first symbol
+        w.Bits(low[c], 8);
+        w.Bits(high[c], 8);
+    }
+    w.Bits(1, 1); w.Bits(0, 1); w.Bits(1, 1); w.Bits(255, 8);   // alpha: 255
+    w.Bits(1, 1); w.Bits(0, 1); w.Bits(0, 1); w.Bits(0, 1);     // distance: symbol 0
+    std::vector<uint8_t> row(static_cast<size_t>(scene.width) * 3);
+    for (int y = 0; y < scene.height; ++y) {
+        scene.Row(y, row.data());
+        for (int x = 0; x < scene.width; ++x) {
+            for (int c : order) w.Bits(row[3 * x + c] > 128 ? 1 : 0, 1);
+        }
+    }
+
+    std::vector<uint8_t>& out = image.bytes;
+    const size_t chunk = w.bytes.size() + (w.bytes.size() & 1);
+    PutText(out, "RIFF");
+    Put32LE(out, static_cast<uint32_t>(4 + 8 + chunk + 8 + SyntheticImage::kStampDigits));
+    PutText(out, "WEBPVP8L");
+    Put32LE(out, static_cast<uint32_t>(w.bytes.size()));
+    Append(out, w.bytes);
+    if (w.bytes.size() & 1) out.push_back(0);
+    // Unknown chunks after the image data are skipped by readers
+    PutText(out, "HGEN");
+    Put32LE(out, static_cast<uint32_t>(SyntheticImage::kStampDigits));
+    PutStamp(image);
+}
+
+void BuildSvg(const Scene& scene, SyntheticImage& image)
+{
+    std::vector<uint8_t> top(static_cast<size_t>(scene.width) * 3), bottom(top.size());
+    scene.Row(0, top.data());
+    scene.Row(scene.height - 1, bottom.data());
+    char color[2][8];
+    std::snprintf(color[0], sizeof(color[0]), "#%02x%02x%02x", top[0], top[1], top[2]);
+    std::snprintf(color[1], sizeof(color[1]), "#%02x%02x%02x", bottom[0], bottom[1], bottom[2]);
+    const std::string w = std::to_string(scene.width), h = std::to_string(scene.height);
+    PutText(image.bytes, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" + w + "\" height=\"" + h + "\" viewBox=\"0 0 " + w + " " + h + "\">\n<!-- hdrgen ");
+    PutStamp(image);
+    PutText(image.bytes, " -->\n<defs><linearGradient id=\"sky\" x1=\"0\" y1=\"0\" x2=\"0\" y2=\"1\"><stop offset=\"0\" stop-color=\"" +
+                             std::string(color[0]) + "\"/><stop offset=\"1\" stop-color=\"" + color[1] + "\"/></linearGradient></defs>\n"
+                             "<rect width=\"" + w + "\" height=\"" + h + "\" fill=\"url(#sky)\"/>\n<circle cx=\"" +
+                             std::to_string(std::lround(scene.sunX)) + "\" cy=\"" + std::to_string(std::lround(scene.sunY)) + "\" r=\"" +
+                             std::to_string(std::lround(scene.sunRadius)) + "\" fill=\"#fffbe8\"/>\n</svg>\n");
+}
+
+void BuildAvif(const Scene& scene, SyntheticImage& image)
+{
+    std::vector<uint8_t> ftypBody;
+    PutText(ftypBody, "avif");
+    Put32BE(ftypBody, 0);
+    PutText(ftypBody, "avifmif1miaf");
+    const std::vector<uint8_t> ftyp = Box("ftyp", ftypBody);
+
+    // Filler of about what an AV1 encoder writes for a photo at this size
+    std::vector<uint8_t> payload(static_cast<size_t>(scene.width) * scene.height / 10 + 64);
+    uint64_t r = scene.seed;
+    for (uint8_t& v : payload) v = static_cast<uint8_t>((r = r * 6364136223846793005ull + 1442695040888963407ull) >> 56);
+
+    const auto buildMeta = [&](uint32_t dataOffset) {
+        std::vector<uint8_t> hdlr(21, 0);
+        std::memcpy(hdlr.data() + 4, "pict", 4);
+        std::vector<uint8_t> pitm;
+        Put16BE(pitm, 1);
+        std::vector<uint8_t> iloc = { 0x44, 0x00 };
+        Put16BE(iloc, 1);
+        Put16BE(iloc, 1);
+        Put16BE(iloc, 0);
+        Put16BE(iloc, 1);
+        Put32BE(iloc, dataOffset);
+        Put32BE(iloc, static_cast<uint32_t>(payload.size()));
+        std::vector<uint8_t> infe;
+        Put16BE(infe, 1);
+        Put16BE(infe, 0);
+        PutText(infe, "av01");
+        infe.push_back(0);
+        std::vector<uint8_t> iinf;
+        Put16BE(iinf, 1);
+        Append(iinf, FullBox("infe", 2, 0, infe));
+
+        std::vector<uint8_t> ispe;
+        Put32BE(ispe, static_cast<uint32_t>(scene.width));
+        Put32BE(ispe, static_cast<uint32_t>(scene.height));
+        std::vector<uint8_t> ipco = FullBox("ispe", 0, 0, ispe);
+        Append(ipco, FullBox("pixi", 0, 0, { 3, 8, 8, 8 }));
+        std::vector<uint8_t> nclx;
+        PutText(nclx, "nclx");
+        Put16BE(nclx, 1); Put16BE(nclx, 13); Put16BE(nclx, 6);    // BT.709 primaries, sRGB transfer, BT.601 matrix
+        nclx.push_back(0x80);                                      // full range
+        Append(ipco, Box("colr", nclx));
+        Append(ipco, Box("av1C", { 0x81, 0x00, 0x0C, 0x00 }));    // main profile, 8-bit 4:2:0
+        std::vector<uint8_t> ipma;
+        Put32BE(ipma, 1);
+        Put16BE(ipma, 1);
+        ipma.insert(ipma.end(), { 4, 1, 2, 3, 0x84 });             // av1C is essential
+        std::vector<uint8_t> iprp = Box("ipco", ipco);
+        Append(iprp, FullBox("ipma", 0, 0, ipma));
+
+        std::vector<uint8_t> meta = FullBox("hdlr", 0, 0, hdlr);
+        Append(meta, FullBox("pitm", 0, 0, pitm));
+        Append(meta, FullBox("iloc", 0, 0, iloc));
+        Append(meta, FullBox("iinf", 0, 0, iinf));
+        Append(meta, Box("iprp", iprp));
+        return FullBox("meta", 0, 0, meta);
+    };
+    // The meta box size does not depend on the offset, so it is built twice
+    const size_t metaSize = buildMeta(0).size();
+    image.bytes = ftyp;
+    Append(image.bytes, buildMeta(static_cast<uint32_t>(ftyp.size() + metaSize + 8)));
+    Append(image.bytes, Box("mdat", payload));
+    PutFreeBoxStamp(image);
+}
+
+void PutJxlSize(BitWriter& w, int size)
+{
+    const uint32_t v = static_cast<uint32_t>(size - 1);
+    if (v < (1u << 9)) { w.Bits(0, 2); w.Bits(v, 9); }
+    else if (v < (1u << 13)) { w.Bits(1, 2); w.Bits(v, 13); }
+    else if (v < (1u << 18)) { w.Bits(2, 2); w.Bits(v, 18); }
+    else { w.Bits(3, 2); w.Bits(v, 30); }
+}
+
+void BuildJxl(const Scene& scene, SyntheticImage& image)
+{
+    BitWriter w;
+    w.Bits(0, 1);                                  // SizeHeader: not small
+    PutJxlSize(w, scene.height);
+    w.Bits(0, 3);                                  // no ratio
+    PutJxlSize(w, scene.width);
+    w.Bits(1, 1);                                  // ImageMetadata: all default (8-bit sRGB)
+    std::vector<uint8_t> codestream = { 0xFF, 0x0A };
+    Append(codestream, w.bytes);
+    codestream.resize(codestream.size() + static_cast<size_t>(scene.width) * scene.height / 12, 0);
+
+    image.bytes = { 0, 0, 0, 12, 'J', 'X', 'L', ' ', 0x0D, 0x0A, 0x87, 0x0A };
+    std::vector<uint8_t> ftyp;
+    PutText(ftyp, "jxl ");
+    Put32BE(ftyp, 0);
+    PutText(ftyp, "jxl ");
+    Append(image.bytes, Box("ftyp", ftyp));
+    Append(image.bytes, Box("jxlc", codestream));
+    PutFreeBoxStamp(image);
+}
+
+void BuildTiff(const Scene& scene, SyntheticImage& image)
+{
+    // Little-endian, one IFD of 11 entries, then BitsPerSample, ImageDescription and one strip
+    const uint32_t entries = 11;
+    const uint32_t bitsOffset = 8 + 2 + entries * 12 + 4;
+    const uint32_t descriptionOffset = bitsOffset + 6;
+    const uint32_t descriptionLength = 7 + SyntheticImage::kStampDigits + 1;
+    const uint32_t stripOffset = descriptionOffset + descriptionLength + (descriptionLength & 1);
+    const uint32_t stripBytes = static_cast<uint32_t>(scene.width) * scene.height * 3;
+    std::vector<uint8_t>& out = image.bytes;
+    PutText(out, std::string("II*\0", 4));
+    Put32LE(out, 8);
+    Put16LE(out, entries);
+    const auto entry = [&out](uint32_t tag, uint32_t type, uint32_t count, uint32_t value) {
+        Put16LE(out, tag);
+        Put16LE(out, type);
+        Put32LE(out, count);
+        if (type == 3 && count == 1) { Put16LE(out, value); Put16LE(out, 0); }
+        else Put32LE(out, value);
+    };
+    entry(256, 4, 1, static_cast<uint32_t>(scene.width));
+    entry(257, 4, 1, static_cast<uint32_t>(scene.height));
+    entry(258, 3, 3, bitsOffset);
+    entry(259, 3, 1, 1);                           // no compression
+    entry(262, 3, 1, 2);                           // RGB
+    entry(270, 2, descriptionLength, descriptionOffset);
+    entry(273, 4, 1, stripOffset);
+    entry(277, 3, 1, 3);
+    entry(278, 4, 1, static_cast<uint32_t>(scene.height));
+    entry(279, 4, 1, stripBytes);
+    entry(284, 3, 1, 1);                           // chunky
+    Put32LE(out, 0);
+    for (int i = 0; i < 3; ++i) Put16LE(out, 8);
+    PutText(out, "hdrgen ");
+    PutStamp(image);
+    out.push_back(0);
+    if (descriptionLength & 1) out.push_back(0);
+    const size_t start = out.size();
+    out.resize(start + stripBytes);
+    for (int y = 0; y < scene.height; ++y) scene.Row(y, out.data() + start + static_cast<size_t>(y) * scene.width * 3);
+}
+
+void BuildSidecar(const SyntheticImageOptions& options, SyntheticImage& image)
+{
+    PutText(image.bytes, "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">\n"
+                         "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
+                         "<rdf:Description xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\" xmp:Rating=\"" + std::to_string(Mix(options.seed) % 6) +
+                         "\" xmp:CreatorTool=\"hdrgen ");
+    PutStamp(image);
+    PutText(image.bytes, "\"/>\n</rdf:RDF>\n</x:xmpmeta>\n<?xpacket end=\"w\"?>\n");
+}
+
+} // namespace
+
+const char* SyntheticKindName(SyntheticKind kind)
+{
+    const size_t k = static_cast<size_t>(kind);
+    return k < kSyntheticKinds ? kKindNames[k] : "unknown";
+}
+
+const char* SyntheticKindExtension(SyntheticKind kind)
+{
+    const size_t k = static_cast<size_t>(kind);
+    return k < kSyntheticKinds ? kKindExtensions[k] : "";
+}
+
+bool ParseSyntheticKind(const std::string& name, SyntheticKind& kind)
+{
+    for (size_t k = 0; k < kSyntheticKinds; ++k) {
+        if (name == kKindNames[k]) {
+            kind = static_cast<SyntheticKind>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BuildSyntheticImage(SyntheticKind kind, const SyntheticImageOptions& options, SyntheticImage& image, std::string* error)
+{
+    image = SyntheticImage();
+    if (options.width < 1 || options.height < 1 || options.width > 16383 || options.height > 16383) {
+        if (error) *error = "image size out of range (1..16383)";
+        return false;
+    }
+    const Scene scene(options.width, options.height, options.seed);
+    switch (kind) {
+    case SyntheticKind::UltraHdr:
+        return BuildJpeg(scene, options, true, image, error);
+    case SyntheticKind::Jpeg:
+        return BuildJpeg(scene, options, false, image, error);
+    case SyntheticKind::Png:
+    case SyntheticKind::Misnamed:
+        BuildPng(scene, options, image);
+        return true;
+    case SyntheticKind::PqPng:
+        BuildPqPng(scene, image);
+        return true;
+    case SyntheticKind::Gif:
+        BuildGif(scene, image);
+        return true;
+    case SyntheticKind::Bmp:
+        BuildBmp(scene, image);
+        return true;
+    case SyntheticKind::WebP:
+        BuildWebP(scene, image);
+        return true;
+    case SyntheticKind::Svg:
+        BuildSvg(scene, image);
+        return true;
+    case SyntheticKind::Avif:
+        BuildAvif(scene, image);
+        return true;
+    case SyntheticKind::Jxl:
+        BuildJxl(scene, image);
+        return true;
+    case SyntheticKind::Tiff:
+        BuildTiff(scene, image);
+        return true;
+    case SyntheticKind::Truncated: {
+        if (!BuildJpeg(scene, options, true, image, error)) return false;
+        // Cut two thirds into the primary image's entropy-coded data
+        std::vector<MpfImage> images;
+        const size_t primary = ReadMpfImages(image.bytes.data(), image.bytes.size(), images) ? images[0].size : image.bytes.size();
+        std::vector<JpegSegment> segments;
+        ReadJpegSegments(image.bytes.data(), image.bytes.size(), segments);
+        const size_t scan = segments.empty() ? 0 : segments.back().offset + segments.back().length;
+        image.bytes.resize(scan + (primary - scan) * 2 / 3);
+        return true;
+    }
+    case SyntheticKind::BadHeader: {
+        if (!BuildJpeg(scene, options, false, image, error)) return false;
+        // Zero width and height in the frame header
+        std::vector<JpegSegment> segments;
+        ReadJpegSegments(image.bytes.data(), image.bytes.size(), segments);
+        for (const JpegSegment& segment : segments) {
+            if (segment.marker == 0xC0) std::fill_n(image.bytes.begin() + static_cast<std::ptrdiff_t>(segment.PayloadOffset() + 1), 4, 0);
+        }
+        return true;
+    }
+    case SyntheticKind::Empty:
+        return true;
+    case SyntheticKind::Sidecar:
+        BuildSidecar(options, image);
+        return true;
+    }
+    if (error) *error = "unknown kind";
+    return false;
+}
+
+void StampSyntheticImage(SyntheticImage& image, uint64_t number)
+{
+    if (!image.stamped) return;
+    static const char kHex[] = "0123456789abcdef";
+    for (size_t i = 0; i < SyntheticImage::kStampDigits; ++i) {
+        image.bytes[image.stamp + SyntheticImage::kStampDigits - 1 - i] = static_cast<uint8_t>(kHex[(number >> (4 * i)) & 0xF]);
+    }
+    if (image.crcEnd != 0) {
+        const uint32_t crc = Crc32(image.bytes.data() + image.crcStart, image.crcEnd - image.crcStart);
+        for (int i = 0; i < 4; ++i) image.bytes[image.crcEnd + i] = static_cast<uint8_t>(crc >> (24 - 8 * i));
+    }
+}
+
+std::array<double, kSyntheticKinds> SyntheticCorpusOptions::DefaultMix()
+{
+    std::array<double, kSyntheticKinds> mix{};
+    mix[static_cast<size_t>(SyntheticKind::UltraHdr)] = 28;
+    mix[static_cast<size_t>(SyntheticKind::Jpeg)] = 45;
+    mix[static_cast<size_t>(SyntheticKind::Png)] = 4;
+    mix[static_cast<size_t>(SyntheticKind::PqPng)] = 1;
+    mix[static_cast<size_t>(SyntheticKind::Gif)] = 1;
+    mix[static_cast<size_t>(SyntheticKind::Bmp)] = 0.5;
+    mix[static_cast<size_t>(SyntheticKind::WebP)] = 3;
+    mix[static_cast<size_t>(SyntheticKind::Svg)] = 0.5;
+    mix[static_cast<size_t>(SyntheticKind::Avif)] = 4;
+    mix[static_cast<size_t>(SyntheticKind::Jxl)] = 1;
+    mix[static_cast<size_t>(SyntheticKind::Tiff)] = 1;
+    mix[static_cast<size_t>(SyntheticKind::Truncated)] = 1;
+    mix[static_cast<size_t>(SyntheticKind::BadHeader)] = 0.5;
+    mix[static_cast<size_t>(SyntheticKind::Empty)] = 0.5;
+    mix[static_cast<size_t>(SyntheticKind::Misnamed)] = 0.5;
+    mix[static_cast<size_t>(SyntheticKind::Sidecar)] = 8;
+    return mix;
+}
+
+SyntheticFile SyntheticCorpusFile(const SyntheticCorpusOptions& options, size_t index)
+{
+    SyntheticFile file;
+    const uint64_t hash = Mix(Mix(options.seed) ^ index);
+
+    double total = 0;
+    for (double share : options.mix) total += std::max(share, 0.0);
+    double pick = Unit(hash) * total;
+    for (size_t k = 0; k < kSyntheticKinds; ++k) {
+        const double share = std::max(options.mix[k], 0.0);
+        if (share <= 0) continue;
+        file.kind = static_cast<SyntheticKind>(k);
+        if (pick < share) break;
+        pick -= share;
+    }
+    const uint64_t second = Mix(hash);
+    file.variant = static_cast<size_t>(second % std::max<size_t>(options.variants, 1));
+    // Seconds back from 2025-01-01
+    const int64_t span = static_cast<int64_t>(std::max(options.years, 1)) * 365 * 86400;
+    file.modified = 1735689600 - static_cast<int64_t>(Mix(second) % static_cast<uint64_t>(span));
+
+    // Folder digits in base fanOut, as many levels as the folder count needs
+    const size_t perFolder = std::max<size_t>(options.filesPerFolder, 1);
+    const size_t fanOut = std::max<size_t>(options.fanOut, 2);
+    const size_t folders = (options.files + perFolder - 1) / perFolder;
+    size_t levels = 0;
+    for (size_t capacity = 1; capacity < folders; capacity *= fanOut) ++levels;
+    const size_t folder = index / perFolder;
+    size_t divisor = 1;
+    for (size_t l = 1; l < levels; ++l) divisor *= fanOut;
+    char name[32];
+    for (size_t l = 0; l < levels; ++l, divisor /= fanOut) {
+        std::snprintf(name, sizeof(name), "folder-%02zu/", (folder / divisor) % fanOut);
+        file.path += name;
+    }
+    std::snprintf(name, sizeof(name), "IMG_%07zu", index);
+    file.path += name;
+    file.path += SyntheticKindExtension(file.kind);
+    return file;
+}
+
+bool WriteSyntheticCorpus(const std::filesystem::path& root, const SyntheticCorpusOptions& options, SyntheticCorpusResult& result, WorkerPool* pool,
+                          std::string* error)
+{
+    result = SyntheticCorpusResult();
+    std::mutex mutex;
+    std::atomic<bool> failed{ false };
+    auto fail = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failed.exchange(true) && error) *error = message;
+    };
+    auto run = [pool](std::vector<std::function<void()>>& jobs) {
+        if (pool) {
+            for (auto& job : jobs) pool->Submit(WorkerLane::Background, WorkerPool::Clock::now(), std::move(job));
+            pool->WaitIdle();
+        } else {
+            for (auto& job : jobs) job();
+        }
+        jobs.clear();
+    };
+
+    // The variants of every kind in the mix: odd ones portrait, each with its own content
+    const size_t variants = std::max<size_t>(options.variants, 1);
+    std::vector<std::unique_ptr<SyntheticImage>> images(kSyntheticKinds * variants);
+    std::vector<std::function<void()>> jobs;
+    for (size_t k = 0; k < kSyntheticKinds; ++k) {
+        if (!(options.mix[k] > 0)) continue;
+        for (size_t v = 0; v < variants; ++v) {
+            jobs.push_back([&, k, v] {
+                SyntheticImageOptions image = options.image;
+                if (v & 1) std::swap(image.width, image.height);
+                image.seed = Mix(options.image.seed + v);
+                auto built = std::make_unique<SyntheticImage>();
+                std::string message;
+                if (!BuildSyntheticImage(static_cast<SyntheticKind>(k), image, *built, &message)) fail(std::string(SyntheticKindName(static_cast<SyntheticKind>(k))) + ": " + message);
+                images[k * variants + v] = std::move(built);
+            });
+        }
+    }
+    run(jobs);
+    if (failed) return false;
+
+    // One job per folder; files of a folder are consecutive
+    const size_t perFolder = std::max<size_t>(options.filesPerFolder, 1);
+    std::set<std::string> folders;
+    for (size_t first = 0; first < options.files; first += perFolder) {
+        jobs.push_back([&, first] {
+            SyntheticCorpusResult local;
+            SyntheticImage copy;
+            const size_t end = std::min(options.files, first + perFolder);
+            for (size_t i = first; i < end && !failed; ++i) {
+                const SyntheticFile file = SyntheticCorpusFile(options, i);
+                const std::filesystem::path path = root / std::filesystem::path(std::u8string(file.path.begin(), file.path.end()));
+                if (i == first) {
+                    std::error_code ec;
+                    std::filesystem::create_directories(path.parent_path(), ec);
+                    if (ec) { fail("cannot create " + path.parent_path().string()); return; }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    folders.insert(path.parent_path().generic_string());
+                }
+                copy = *images[static_cast<size_t>(file.kind) * variants + file.variant];
+                StampSyntheticImage(copy, i);
+                {
+                    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+                    if (!out.write(reinterpret_cast<const char*>(copy.bytes.data()), static_cast<std::streamsize>(copy.bytes.size()))) {
+                        fail("cannot write " + path.string());
+                        return;
+                    }
+                }
+                std::error_code ec;
+                const auto modified = std::chrono::sys_seconds(std::chrono::seconds(file.modified));
+                std::filesystem::last_write_time(path, std::chrono::file_clock::from_sys(modified), ec);
+                ++local.files;
+                local.bytes += copy.bytes.size();
+                ++local.kinds[static_cast<size_t>(file.kind)];
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            result.files += local.files;
+            result.bytes += local.bytes;
+            for (size_t k = 0; k < kSyntheticKinds; ++k) result.kinds[k] += local.kinds[k];
+        });
+    }
+    run(jobs);
+    result.folders = folders.size();
+    return !failed;
+}
@@ -0,0 +1,156 @@
+// TaskGraph.cpp - dependency counting over a shared ready queue
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+struct TaskGraph::Shared {
+    struct Node {
+        TaskTiming timing;
+        std::function<bool()> run;
+        std::vector<TaskId> after;
+        std::vector<TaskId> dependents;
+        size_t waiting = 0;              // dependencies not finished yet
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Node> nodes;
+    std::deque<TaskId> ready;
+    size_t running = 0;
+    size_t succeeded = 0;
+    bool failed = false;
+    bool cancelled = false;
+    WorkerPool* pool = nullptr;
+    WorkerPool::Clock::time_point deadline{};
+    const std::atomic<bool>* cancel = nullptr;
+    std::chrono::steady_clock::time_point start{};
+
+    // Queues a task whose dependencies are done and offers it to the pool. Pool jobs hold the
+    // shared state, not the task: one that runs after its task was taken (by the calling thread)
+    // or after Run returned finds the queue empty and does nothing.
+    void MakeReady(const std::shared_ptr<Shared>& self, TaskId id) {
+        ready.push_back(id);
+        if (pool) {
+            pool->Submit(deadline, [self] {
+                std::unique_lock<std::mutex> lock(self->mutex);
+                self->RunReady(lock, self);
+            });
+        }
+    }
+
+    // Runs the next ready task with the lock released. Returns false if none is ready.
+    bool RunReady(std::unique_lock<std::mutex>& lock, const std::shared_ptr<Shared>& self) {
+        if (ready.empty()) return false;
+        if (failed || cancelled || (cancel && cancel->load(std::memory_order_relaxed))) {
+            cancelled = cancelled || !failed;
+            ready.clear();
+            changed.notify_all();
+            return true;
+        }
+        const TaskId id = ready.front();
+        ready.pop_front();
+        Node& node = nodes[id];
+        ++running;
+        lock.unlock();
+        node.timing.startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const bool ok = node.run();
+        node.timing.endMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+        --running;
+        node.timing.ran = true;
+        if (ok) {
+            ++succeeded;
+            for (TaskId dependent : node.dependents) {
+                if (--nodes[dependent].waiting == 0) MakeReady(self, dependent);
+            }
+        } else {
+            failed = true;
+        }
+        changed.notify_all();
+        return true;
+    }
+};
+
+TaskGraph::TaskGraph() : shared_(std::make_shared<Shared>())
+{
+}
+
+TaskGraph::~TaskGraph() = default;
+
+TaskGraph::TaskId TaskGraph::Add(std::string name, std::function<bool()> run, std::initializer_list<TaskId> after)
+{
+    std::vector<Shared::Node>& nodes = shared_->nodes;
+    const TaskId id = nodes.size();
+    Shared::Node& node = nodes.emplace_back();
+    node.timing.name = std::move(name);
+    node.run = std::move(run);
+    for (TaskId dependency : after) {
+        if (dependency >= id) continue;    // not added yet, so it cannot come first
+        node.after.push_back(dependency);
+        nodes[dependency].dependents.push_back(id);
+        ++node.waiting;
+    }
+    return id;
+}
+
+bool TaskGraph::Run(WorkerPool* pool, WorkerPool::Clock::time_point deadline, const std::atomic<bool>* cancel)
+{
+    Shared& s = *shared_;
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.pool = pool;
+    s.deadline = deadline;
+    s.cancel = cancel;
+    s.start = std::chrono::steady_clock::now();
+    for (TaskId id = 0; id < s.nodes.size(); ++id) {
+        if (s.nodes[id].waiting == 0) s.MakeReady(shared_, id);
+    }
+    while (true) {
+        if (s.RunReady(lock, shared_)) continue;
+        if (s.running == 0) break;
+        s.changed.wait(lock);
+    }
+    return s.succeeded == s.nodes.size();
+}
+
+bool TaskGraph::Cancelled() const
+{
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    return shared_->cancelled;
+}
+
+std::vector<TaskGraph::TaskTiming> TaskGraph::Timings() const
+{
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    std::vector<TaskTiming> timings;
+    timings.reserve(shared_->nodes.size());
+    for (const Shared::Node& node : shared_->nodes) timings.push_back(node.timing);
+    return timings;
+}
+
+double TaskGraph::SerialMs() const
+{
+    double total = 0;
+    for (const TaskTiming& t : Timings()) total += t.endMs - t.startMs;
+    return total;
+}
+
+double TaskGraph::CriticalPathMs() const
+{
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    const std::vector<Shared::Node>& nodes = shared_->nodes;
+    // Dependencies always come first, so one pass in order sees every chain
+    std::vector<double> finish(nodes.size(), 0.0);
+    double longest = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        double begin = 0;
+        for (TaskId dependency : nodes[i].after) begin = std::max(begin, finish[dependency]);
+        finish[i] = begin + (nodes[i].timing.endMs - nodes[i].timing.startMs);
+        longest = std::max(longest, finish[i]);
+    }
+    return longest;
+}
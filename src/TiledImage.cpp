@@ -0,0 +1,240 @@
+// TiledImage.cpp - viewport tiles of large images, decoded by region and cached
+
+#include "TiledImage.h"
+#include "JpegFile.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+uint64_t TileBytes(const ImageTile& tile)
+{
+    uint64_t bytes = 0;
+    for (const PixelPlane& plane : tile.pixels.planes) bytes += plane.size();
+    return bytes;
+}
+
+} // namespace
+
+TiledImage::TiledImage(uint64_t budgetBytes, WorkerPool* pool) : pool_(pool), budget_(budgetBytes)
+{
+}
+
+TiledImage::~TiledImage()
+{
+    WaitPrefetch();
+}
+
+bool TiledImage::Open(std::shared_ptr<const std::vector<uint8_t>> file, std::string* error)
+{
+    WaitPrefetch();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lru_.clear();
+        tiles_.clear();
+        stats_ = TiledImageStats();
+    }
+    image_ = JpegRegionDecoder();
+    gainMap_ = JpegRegionDecoder();
+    file_ = std::move(file);
+    if (!file_) return false;
+    const uint8_t* data = file_->data();
+    const size_t size = file_->size();
+
+    // The primary image ends where the MPF directory says; the gain map is the secondary image
+    // that carries gain map metadata
+    size_t primarySize = size;
+    std::vector<MpfImage> images;
+    if (ReadMpfImages(data, size, images)) {
+        primarySize = images[0].size;
+        for (size_t i = 1; i < images.size() && !gainMap_.IsOpen(); ++i) {
+            const uint8_t* image = data + images[i].offset;
+            std::vector<JpegSegment> segments;
+            if (!ReadJpegSegments(image, images[i].size, segments)) continue;
+            for (const JpegSegment& segment : segments) {
+                if (IsGainMapMetadataSegment(image, segment)) {
+                    // A gain map that cannot be region decoded is left out; the image still shows
+                    gainMap_.Open(image, images[i].size);
+                    break;
+                }
+            }
+        }
+    }
+    if (!image_.Open(data, primarySize, error)) {
+        gainMap_ = JpegRegionDecoder();
+        return false;
+    }
+    if (gainMap_.IsOpen()) {
+        gainMapScaleX_ = static_cast<double>(gainMap_.Width()) / image_.Width();
+        gainMapScaleY_ = static_cast<double>(gainMap_.Height()) / image_.Height();
+    }
+    return true;
+}
+
+int TiledImage::ScaleFor(double zoom)
+{
+    if (!(zoom > 0) || zoom >= 1) return 0;
+    return std::clamp(static_cast<int>(std::floor(std::log2(1.0 / zoom))), 0, JpegRegionDecoder::kMaxScaleLog2);
+}
+
+bool TiledImage::RangeFor(TileLayer layer, const Viewport& viewport, TileRange& range) const
+{
+    const JpegRegionDecoder& decoder = Decoder(layer);
+    if (!decoder.IsOpen() || viewport.width <= 0 || viewport.height <= 0) return false;
+    const double scaleX = layer == TileLayer::Image ? 1.0 : gainMapScaleX_;
+    const double scaleY = layer == TileLayer::Image ? 1.0 : gainMapScaleY_;
+    range.layer = layer;
+    range.scaleLog2 = ScaleFor(viewport.zoom / std::max(scaleX, scaleY));
+    const double level = std::ldexp(1.0, -range.scaleLog2);
+    const int levelW = JpegRegionDecoder::ScaledSize(decoder.Width(), range.scaleLog2);
+    const int levelH = JpegRegionDecoder::ScaledSize(decoder.Height(), range.scaleLog2);
+    const double x0 = std::max(0.0, viewport.x * scaleX * level);
+    const double y0 = std::max(0.0, viewport.y * scaleY * level);
+    const double x1 = std::min<double>(levelW, (viewport.x + viewport.width) * scaleX * level);
+    const double y1 = std::min<double>(levelH, (viewport.y + viewport.height) * scaleY * level);
+    if (x1 <= x0 || y1 <= y0) return false;
+    range.column0 = static_cast<int>(x0) / kTileSize;
+    range.row0 = static_cast<int>(y0) / kTileSize;
+    range.column1 = static_cast<int>(std::ceil(x1) - 1) / kTileSize;
+    range.row1 = static_cast<int>(std::ceil(y1) - 1) / kTileSize;
+    return true;
+}
+
+uint64_t TiledImage::Key(TileLayer layer, int scaleLog2, int column, int row)
+{
+    return (static_cast<uint64_t>(layer) << 63) | (static_cast<uint64_t>(scaleLog2) << 60) |
+           (static_cast<uint64_t>(row) << 30) | static_cast<uint64_t>(column);
+}
+
+std::shared_ptr<const ImageTile> TiledImage::Decode(TileLayer layer, int scaleLog2, int column, int row) const
+{
+    auto tile = std::make_shared<ImageTile>();
+    tile->layer = layer;
+    tile->scaleLog2 = scaleLog2;
+    tile->column = column;
+    tile->row = row;
+    tile->x = column * kTileSize;
+    tile->y = row * kTileSize;
+    if (!Decoder(layer).DecodeRegion(tile->x, tile->y, kTileSize, kTileSize, scaleLog2, tile->pixels)) return nullptr;
+    return tile;
+}
+
+std::vector<std::shared_ptr<const ImageTile>> TiledImage::Visible(const Viewport& viewport)
+{
+    std::vector<std::shared_ptr<const ImageTile>> visible;
+    for (TileLayer layer : { TileLayer::Image, TileLayer::GainMap }) {
+        TileRange range;
+        if (!RangeFor(layer, viewport, range)) continue;
+        for (int row = range.row0; row <= range.row1; ++row) {
+            for (int column = range.column0; column <= range.column1; ++column) {
+                const uint64_t key = Key(layer, range.scaleLog2, column, row);
+                std::shared_ptr<const ImageTile> tile = Find(key, true);
+                if (!tile) {
+                    tile = Decode(layer, range.scaleLog2, column, row);
+                    if (!tile) continue;
+                    Insert(key, tile);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ++stats_.decoded;
+                }
+                visible.push_back(std::move(tile));
+            }
+        }
+    }
+    return visible;
+}
+
+void TiledImage::Prefetch(const Viewport& viewport, double dx, double dy)
+{
+    if (!pool_ || (dx == 0 && dy == 0)) return;
+    for (TileLayer layer : { TileLayer::Image, TileLayer::GainMap }) {
+        TileRange current, ahead;
+        if (!RangeFor(layer, viewport, current)) continue;
+        // The viewport moved on by one tile of this layer's scale
+        const double tileX = std::ldexp(static_cast<double>(kTileSize), current.scaleLog2) / (layer == TileLayer::Image ? 1.0 : gainMapScaleX_);
+        const double tileY = std::ldexp(static_cast<double>(kTileSize), current.scaleLog2) / (layer == TileLayer::Image ? 1.0 : gainMapScaleY_);
+        Viewport next = viewport;
+        next.x += dx > 0 ? tileX : dx < 0 ? -tileX : 0;
+        next.y += dy > 0 ? tileY : dy < 0 ? -tileY : 0;
+        if (!RangeFor(layer, next, ahead) || ahead.scaleLog2 != current.scaleLog2) continue;
+        for (int row = ahead.row0; row <= ahead.row1; ++row) {
+            for (int column = ahead.column0; column <= ahead.column1; ++column) {
+                if (row >= current.row0 && row <= current.row1 && column >= current.column0 && column <= current.column1) continue;
+                const uint64_t key = Key(layer, ahead.scaleLog2, column, row);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (tiles_.count(key) || !pending_.insert(key).second) continue;
+                }
+                const int scaleLog2 = ahead.scaleLog2;
+                pool_->Submit(WorkerPool::Clock::now(), [this, key, layer, scaleLog2, column, row] {
+                    // The viewport may have caught up and decoded the tile meanwhile
+                    std::shared_ptr<const ImageTile> tile = Find(key, false) ? nullptr : Decode(layer, scaleLog2, column, row);
+                    if (tile) Insert(key, std::move(tile));
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_.erase(key);
+                    ++stats_.prefetched;
+                    prefetchDone_.notify_all();
+                });
+            }
+        }
+    }
+}
+
+void TiledImage::WaitPrefetch()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    prefetchDone_.wait(lock, [this] { return pending_.empty(); });
+}
+
+std::shared_ptr<const ImageTile> TiledImage::Find(uint64_t key, bool countHit)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tiles_.find(key);
+    if (it == tiles_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    if (countHit) ++stats_.hits;
+    return it->second.tile;
+}
+
+void TiledImage::Insert(uint64_t key, std::shared_ptr<const ImageTile> tile)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tiles_.find(key);
+    if (it != tiles_.end()) {
+        stats_.bytes -= TileBytes(*it->second.tile);
+        it->second.tile = std::move(tile);
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        stats_.bytes += TileBytes(*it->second.tile);
+    } else {
+        lru_.push_front(key);
+        stats_.bytes += TileBytes(*tile);
+        tiles_.emplace(key, Entry{ std::move(tile), lru_.begin() });
+    }
+    stats_.peakBytes = std::max(stats_.peakBytes, stats_.bytes);
+    EvictLocked();
+}
+
+void TiledImage::EvictLocked()
+{
+    // The most recent tile stays even over budget; callers hold the visible ones anyway
+    while (stats_.bytes > budget_ && lru_.size() > 1) {
+        auto it = tiles_.find(lru_.back());
+        stats_.bytes -= TileBytes(*it->second.tile);
+        tiles_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+void TiledImage::SetBudget(uint64_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budgetBytes;
+    EvictLocked();
+}
+
+TiledImageStats TiledImage::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
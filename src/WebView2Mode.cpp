@@ -3,37 +3,67 @@
 #include <windows.h>
 #include <shlwapi.h>
 #include <wrl.h>
+#include <dxgi1_6.h>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <filesystem>
-#include <random>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
 #include <chrono>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <cmath>
 
 #include <webview2.h>
 
 #include "Logger.h"
+#include "Metrics.h"
 #include "SettingsDialog.h"
 #include "WebView2Mode.h"
 #include "ImageFileUtils.h"
+#include "CatalogIndex.h"
+#include "CatalogTable.h"
+#include "CompletionChannel.h"
+#include "ImageCatalog.h"
+#include "ImageCache.h"
+#include "InputTrace.h"
+#include "MemoryGovernor.h"
+#include "PixelBufferPool.h"
+#include "Rendition.h"
+#include "SessionSnapshot.h"
+#include "ShowHistory.h"
+#include "Slideshow.h"
+#include "WeightedSampler.h"
+#include "WorkerPool.h"
 
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "user32.lib")
 #pragma comment(lib, "gdi32.lib")
 #pragma comment(lib, "shlwapi.lib")
+#pragma comment(lib, "dxgi.lib")
 
 using Microsoft::WRL::ComPtr;
 
 // Globals for the low-level keyboard hook used to forward hotkeys while WebView2 has focus
 static HHOOK g_wv2_kbHook = nullptr;
-static HWND g_wv2_host_hwnd = nullptr;
-// Thread id for the RunWebView2Mode message loop so the hook can forward messages
-static DWORD g_wv2_thread_id = 0;
-
-// Custom message to forward keys from the low-level hook into the RunWebView2Mode loop
-static const UINT WM_APP_HOTKEY = WM_APP + 1;
-// Custom message to forward mouse movement from low-level hook into the RunWebView2Mode loop
-static const UINT WM_APP_MOUSEMOVE = WM_APP + 2;
+// Host windows of all outputs (one per monitor in screensaver mode)
+static std::vector<HWND> g_wv2_host_hwnds;
+// Input forwarded from the low-level hooks and WebView2 callbacks, and work finished on the
+// worker pool, for the RunWebView2Mode loop
+struct WV2Event {
+    enum class Kind { Hotkey, MouseMove, Completion };
+    Kind kind = Kind::Hotkey;
+    UINT key = 0;
+    size_t target = 0;                   // output + 1 to address a single output, 0 for all
+    std::function<void()> completion;    // runs on the loop's thread
+};
+// The loop's channel while RunWebView2Mode runs
+static CompletionChannel<WV2Event>* g_wv2_events = nullptr;
+// Posted to the loop's thread when the channel goes from empty to holding events
+static const UINT WM_APP_EVENTS = WM_APP + 1;
 
 // Globals for the low-level mouse hook
 static HHOOK g_wv2_mouseHook = nullptr;
@@ -46,6 +76,15 @@ static void SetLastNavKey(UINT vk)
     InterlockedExchange(&g_wv2_last_nav_key, (LONG)vk);
 }
 
+// True if hwnd is one of the host windows or a child of one (the WebView2 windows are children)
+static bool IsHostOrChildWindow(HWND hwnd)
+{
+    for (HWND host : g_wv2_host_hwnds) {
+        if (hwnd == host || IsChild(host, hwnd)) return true;
+    }
+    return false;
+}
+
 // Low-level keyboard proc: forwards specified keys to the saver host window when the host or one of
 // its child windows is the foreground window. Returns 1 to swallow the event when handled.
 static LRESULT CALLBACK WV2_LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
@@ -56,8 +95,8 @@ static LRESULT CALLBACK WV2_LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARA
         HWND fg = GetForegroundWindow();
         if (!fg) return CallNextHookEx(g_wv2_kbHook, nCode, wParam, lParam);
 
-        // Only intercept when the foreground window is our saver host or a child of it
-        if (!g_wv2_host_hwnd || !(fg == g_wv2_host_hwnd || IsChild(g_wv2_host_hwnd, fg))) {
+        // Only intercept when the foreground window is one of our saver hosts or a child of it
+        if (!IsHostOrChildWindow(fg)) {
             return CallNextHookEx(g_wv2_kbHook, nCode, wParam, lParam);
         }
 
@@ -74,13 +113,11 @@ static LRESULT CALLBACK WV2_LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARA
         }
 
         if (shouldHandle) {
-            // Forward to the RunWebView2Mode thread if known, otherwise post WM_KEY messages to host window
-            if (g_wv2_thread_id != 0) {
-                if (!PostThreadMessageW(g_wv2_thread_id, WM_APP_HOTKEY, (WPARAM)postKey, 0)) {
-                    LOG_MSG(L"WebView2Mode Hook: PostThreadMessageW failed to post hotkey");
-                }
+            // Forward to the RunWebView2Mode loop if running, otherwise post WM_KEY messages to host window
+            if (g_wv2_events) {
+                g_wv2_events->Post({ WV2Event::Kind::Hotkey, static_cast<UINT>(postKey), 0, {} });
             } else {
-                HWND target = g_wv2_host_hwnd ? g_wv2_host_hwnd : fg;
+                HWND target = g_wv2_host_hwnds.empty() ? fg : g_wv2_host_hwnds.front();
                 PostMessageW(target, WM_KEYDOWN, (WPARAM)postKey, 0);
                 PostMessageW(target, WM_KEYUP, (WPARAM)postKey, 0);
             }
@@ -98,20 +135,22 @@ static LRESULT CALLBACK WV2_LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM l
         if (!ms) return CallNextHookEx(g_wv2_mouseHook, nCode, wParam, lParam);
 
         // If we don't have a host window recorded, skip
-        if (!g_wv2_host_hwnd) return CallNextHookEx(g_wv2_mouseHook, nCode, wParam, lParam);
+        if (g_wv2_host_hwnds.empty()) return CallNextHookEx(g_wv2_mouseHook, nCode, wParam, lParam);
 
-        // Check whether the mouse is inside our host window rect (screen coords)
-        RECT hostRect; GetWindowRect(g_wv2_host_hwnd, &hostRect);
+        // Check whether the mouse is inside one of our host window rects (screen coords)
         POINT pt = ms->pt;
-        if (PtInRect(&hostRect, pt)) {
+        bool insideHost = false;
+        for (HWND host : g_wv2_host_hwnds) {
+            RECT hostRect; GetWindowRect(host, &hostRect);
+            if (PtInRect(&hostRect, pt)) insideHost = true;
+        }
+        if (insideHost) {
             // If the cursor moved from the recorded initial position, forward a message
             if (pt.x != g_wv2_initial_mouse_pos.x || pt.y != g_wv2_initial_mouse_pos.y) {
-                if (g_wv2_thread_id != 0) {
-                    if (!PostThreadMessageW(g_wv2_thread_id, WM_APP_MOUSEMOVE, 0, 0)) {
-                        LOG_MSG(L"WebView2Mode Hook: PostThreadMessageW failed to post mouse-move");
-                    }
+                if (g_wv2_events) {
+                    g_wv2_events->Post({ WV2Event::Kind::MouseMove, 0, 0, {} });
                 } else {
-                    PostMessageW(g_wv2_host_hwnd, WM_MOUSEMOVE, 0, MAKELPARAM(pt.x, pt.y));
+                    PostMessageW(g_wv2_host_hwnds.front(), WM_MOUSEMOVE, 0, MAKELPARAM(pt.x, pt.y));
                 }
             }
         }
@@ -119,28 +158,82 @@ static LRESULT CALLBACK WV2_LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM l
     return CallNextHookEx(g_wv2_mouseHook, nCode, wParam, lParam);
 }
 
+// One host window + WebView2 per slideshow output
 struct WV2State {
     HWND hwnd = nullptr;
+    size_t output = 0;                 // Slideshow output index
+    RECT bounds{};                     // monitor rectangle (fullscreen) in virtual screen coordinates
+    Slideshow* slideshow = nullptr;    // serves slide bytes to the WebView
+    ComPtr<ICoreWebView2Environment> environment;
     ComPtr<ICoreWebView2Controller> controller;
     ComPtr<ICoreWebView2> webview;
     bool requestReinit = false;
     bool sdrMode = false;
-    HHOOK kbHook = nullptr; // low-level keyboard hook handle
     EventRegistrationToken accelToken{};
     EventRegistrationToken downloadToken{};
+    EventRegistrationToken resourceToken{};
+    std::chrono::steady_clock::time_point initStart{};  // InitWebView2 called
+    std::chrono::steady_clock::time_point navStart{};   // last Navigate() issued
+    size_t navIndex = 0;                                // catalog index of that navigation
+    bool rendered = false;                              // a navigation completed since InitWebView2 (the first also starts the renderer)
 };
 
+// Metrics of the WebView2 slideshow, registered once on first use
+struct WV2Metrics {
+    Metrics& registry = Metrics::Instance();
+    Counter& imagesShown = registry.GetCounter("hdr_images_shown_total", "Images navigated to");
+    Counter& bytesShown = registry.GetCounter("hdr_bytes_shown_total", "File bytes of images navigated to");
+    Counter& navigationsFailed = registry.GetCounter("hdr_navigations_failed_total", "Navigations that completed with an error");
+    Histogram& initTime = registry.GetHistogram("hdr_webview2_init_us", "InitWebView2 until the controller is ready (microseconds)");
+    Histogram& loadTime = registry.GetHistogram("hdr_image_load_us", "Navigate until NavigationCompleted (microseconds)");
+    Histogram& enumerationTime = registry.GetHistogram("hdr_enumeration_us", "Image folder enumeration (microseconds)");
+    Gauge& catalogImages = registry.GetGauge("hdr_catalog_images", "Images in the current slideshow");
+    Gauge& firstSlide = registry.GetGauge("hdr_activation_first_slide_ms", "Process start until the first slide finished loading (milliseconds)");
+    Gauge& warmStart = registry.GetGauge("hdr_activation_warm_start", "1 if the session started from the last session's snapshot");
+
+    static WV2Metrics& Get() {
+        static WV2Metrics metrics;
+        return metrics;
+    }
+    // Skips are counted per file extension so unsupported formats stand out
+    static void CountSkip(const std::wstring& uri) {
+        std::string ext;
+        for (wchar_t c : std::filesystem::path(uri).extension().wstring()) ext += static_cast<char>(c < 0x80 ? towlower(c) : '?');
+        Metrics::Instance().GetCounter("hdr_images_skipped_total", "Images skipped because WebView2 cannot display them",
+                                       { { "format", ext.empty() ? "none" : ext } }).Add();
+    }
+};
+
+static uint64_t MicrosSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Milliseconds since the process was created, i.e. since Windows activated the screensaver
+static int64_t MillisSinceProcessStart()
+{
+    FILETIME creation{}, exitTime{}, kernelTime{}, userTime{}, now{};
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernelTime, &userTime)) return -1;
+    GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER start{}, end{};
+    start.LowPart = creation.dwLowDateTime;
+    start.HighPart = creation.dwHighDateTime;
+    end.LowPart = now.dwLowDateTime;
+    end.HighPart = now.dwHighDateTime;
+    return static_cast<int64_t>((end.QuadPart - start.QuadPart) / 10000);
+}
+// Set once the first slide of the session has loaded
+static bool g_wv2_first_slide_shown = false;
+
 // Helper: install low-level hooks and initialize globals
-static void InstallLowLevelHooks(WV2State& s, const POINT& initialMousePos)
+static void InstallLowLevelHooks(const std::vector<HWND>& hosts, const POINT& initialMousePos)
 {
-    g_wv2_host_hwnd = s.hwnd;
-    g_wv2_thread_id = GetCurrentThreadId();
+    g_wv2_host_hwnds = hosts;
     g_wv2_initial_mouse_pos = initialMousePos;
 
     if (!g_wv2_kbHook) {
         g_wv2_kbHook = SetWindowsHookExW(WH_KEYBOARD_LL, WV2_LowLevelKeyboardProc, GetModuleHandle(nullptr), 0);
-        if (g_wv2_kbHook) s.kbHook = g_wv2_kbHook;
-        else LOG_MSG(L"WebView2Mode: Failed to install keyboard hook");
+        if (!g_wv2_kbHook) LOG_MSG(L"WebView2Mode: Failed to install keyboard hook");
     }
 
     if (!g_wv2_mouseHook) {
@@ -150,19 +243,17 @@ static void InstallLowLevelHooks(WV2State& s, const POINT& initialMousePos)
 }
 
 // Helper: remove low-level hooks and clear globals
-static void UninstallLowLevelHooks(WV2State& s)
+static void UninstallLowLevelHooks()
 {
     if (g_wv2_kbHook) {
         UnhookWindowsHookEx(g_wv2_kbHook);
         g_wv2_kbHook = nullptr;
-        s.kbHook = nullptr;
     }
     if (g_wv2_mouseHook) {
         UnhookWindowsHookEx(g_wv2_mouseHook);
         g_wv2_mouseHook = nullptr;
     }
-    g_wv2_host_hwnd = nullptr;
-    g_wv2_thread_id = 0;
+    g_wv2_host_hwnds.clear();
 }
 
 static void RemoveAcceleratorIfAny(WV2State& s)
@@ -184,16 +275,107 @@ static void RemoveDownloadHandlerIfAny(WV2State& s)
     }
 }
 
-static std::wstring ToFileUri(const std::wstring& path)
+static void RemoveResourceHandlerIfAny(WV2State& s)
+{
+    if (s.webview && s.resourceToken.value != 0) {
+        s.webview->remove_WebResourceRequested(s.resourceToken);
+        s.resourceToken = {};
+    }
+}
+
+// Slides are served from the shared cache under this virtual origin instead of file:// URIs, so
+// all outputs read each file at most once and prefetched bytes are used directly.
+static const wchar_t kSlideOrigin[] = L"https://hdrslides.example/";
+
+// https://hdrslides.example/<catalog index>/<file name>. The file name is only informational
+// (it shows up in download URIs and logs); the index selects the image.
+static std::wstring BuildSlideUri(size_t index, const std::wstring& path)
+{
+    static const wchar_t kHex[] = L"0123456789ABCDEF";
+    std::wstring uri = kSlideOrigin + std::to_wstring(index) + L"/";
+    const std::u8string name = std::filesystem::path(path).filename().u8string();
+    for (char8_t c : name) {
+        if ((c >= u8'a' && c <= u8'z') || (c >= u8'A' && c <= u8'Z') || (c >= u8'0' && c <= u8'9') || c == u8'-' || c == u8'_' || c == u8'.') {
+            uri += static_cast<wchar_t>(c);
+        } else {
+            uri += L'%';
+            uri += kHex[c >> 4];
+            uri += kHex[c & 0xF];
+        }
+    }
+    return uri;
+}
+
+// Parses the catalog index of a slide URI; returns false for other URIs
+static bool ParseSlideUri(const std::wstring& uri, size_t& index)
+{
+    const size_t originLength = ARRAYSIZE(kSlideOrigin) - 1;
+    if (uri.compare(0, originLength, kSlideOrigin) != 0) return false;
+    size_t pos = originLength;
+    if (pos >= uri.size() || uri[pos] < L'0' || uri[pos] > L'9') return false;
+    index = 0;
+    for (; pos < uri.size() && uri[pos] >= L'0' && uri[pos] <= L'9'; ++pos) index = index * 10 + (uri[pos] - L'0');
+    return true;
+}
+
+// Answers a slide request with the image, or 404 if it could not be read
+static void RespondWithSlide(ICoreWebView2Environment* environment, ICoreWebView2WebResourceRequestedEventArgs* args, const std::wstring& uri, const ImageData* data)
+{
+    ComPtr<ICoreWebView2WebResourceResponse> response;
+    if (!data) {
+        environment->CreateWebResourceResponse(nullptr, 404, L"Not Found", L"", &response);
+    } else {
+        // The stream gets its own copy, so the cache may evict the image right away
+        ComPtr<IStream> stream;
+        stream.Attach(SHCreateMemStream(data->bytes.data(), static_cast<UINT>(data->bytes.size())));
+        const std::wstring headers = std::wstring(L"Content-Type: ") + ContentTypeForPath(uri) + L"\r\nCache-Control: no-store";
+        environment->CreateWebResourceResponse(stream.Get(), 200, L"OK", headers.c_str(), &response);
+    }
+    if (response) args->put_Response(response.Get());
+}
+
+// HDR headroom of a monitor: peak luminance relative to SDR reference white (203 nits, ITU-R BT.2408),
+// or 1 when the monitor is not in HDR mode or DXGI cannot tell.
+static float QueryMonitorHeadroom(HMONITOR monitor)
+{
+    ComPtr<IDXGIFactory1> factory;
+    if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) || !factory) return 1.0f;
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT a = 0; factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a) {
+        ComPtr<IDXGIOutput> output;
+        for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; ++o) {
+            ComPtr<IDXGIOutput6> output6;
+            DXGI_OUTPUT_DESC1 desc{};
+            if (FAILED(output.As(&output6)) || !output6 || FAILED(output6->GetDesc1(&desc)) || desc.Monitor != monitor) continue;
+            if (desc.ColorSpace != DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020) return 1.0f;
+            return std::max(1.0f, desc.MaxLuminance / 203.0f);
+        }
+    }
+    return 1.0f;
+}
+
+struct MonitorOutput {
+    std::wstring device;
+    RECT rect{};
+    bool primary = false;
+    float headroom = 1.0f;
+};
+
+// All monitors of the desktop, primary first
+static std::vector<MonitorOutput> EnumerateMonitors()
 {
-    wchar_t buf[32768];
-    DWORD len = ARRAYSIZE(buf);
-    if (SUCCEEDED(UrlCreateFromPathW(path.c_str(), buf, &len, 0))) {
-        return std::wstring(buf, len);
-    }
-    std::wstring p = path;
-    for (auto& ch : p) if (ch == L'\\') ch = L'/';
-    return L"file:///" + p;
+    std::vector<MonitorOutput> monitors;
+    EnumDisplayMonitors(nullptr, nullptr, [](HMONITOR monitor, HDC, LPRECT, LPARAM param) -> BOOL {
+        auto& list = *reinterpret_cast<std::vector<MonitorOutput>*>(param);
+        MONITORINFOEXW info{};
+        info.cbSize = sizeof(info);
+        if (GetMonitorInfoW(monitor, reinterpret_cast<MONITORINFO*>(&info))) {
+            list.push_back({ info.szDevice, info.rcMonitor, (info.dwFlags & MONITORINFOF_PRIMARY) != 0, QueryMonitorHeadroom(monitor) });
+        }
+        return TRUE;
+    }, reinterpret_cast<LPARAM>(&monitors));
+    std::stable_partition(monitors.begin(), monitors.end(), [](const MonitorOutput& m) { return m.primary; });
+    return monitors;
 }
 
 // Helper: build an ANSI window title from a wide path, prefixed with "HDRScreenSaver - "
@@ -268,9 +450,10 @@ static void SetHostFocus(WV2State& s)
      DWORD style = fullscreen ? (WS_POPUP | WS_VISIBLE) : (WS_OVERLAPPEDWINDOW | WS_VISIBLE);
      int x = CW_USEDEFAULT, y = CW_USEDEFAULT, w = 1280, h = 800;
      if (fullscreen) {
-         x = 0; y = 0;
-         w = GetSystemMetrics(SM_CXSCREEN);
-         h = GetSystemMetrics(SM_CYSCREEN);
+         // Cover the output's monitor (s.bounds, virtual screen coordinates)
+         x = s.bounds.left; y = s.bounds.top;
+         w = s.bounds.right - s.bounds.left;
+         h = s.bounds.bottom - s.bounds.top;
      }
      s.hwnd = CreateWindowEx(fullscreen ? WS_EX_TOPMOST : 0, kClassName, title, style,
                              x, y, w, h,
@@ -281,14 +464,14 @@ static void SetHostFocus(WV2State& s)
     }
     SetWindowLongPtr(s.hwnd, GWLP_USERDATA, (LONG_PTR)&s);
      if (fullscreen) {
-         SetWindowPos(s.hwnd, HWND_TOPMOST, 0, 0, w, h, SWP_SHOWWINDOW);
-         ShowCursor(FALSE);
+         SetWindowPos(s.hwnd, HWND_TOPMOST, x, y, w, h, SWP_SHOWWINDOW);
      }
     return true;
 }
 
 static bool InitWebView2(WV2State& s)
 {
+    s.rendered = false;
     // Provide browser args via environment var to support older SDKs.
     // Set flags to disable HDR display if requested.
     // Set conservative flags to disable telemetry, background/networking,
@@ -314,33 +497,36 @@ static bool InitWebView2(WV2State& s)
     std::wstring userDataDir = std::wstring(localAppData) + L"\\HDRScreenSaverWV2\\" + (s.sdrMode ? L"SDR" : L"HDR");
     std::filesystem::create_directories(userDataDir);
 
-    LOG_MSG(L"WebView2Mode: InitWebView2 with userDataDir=" + userDataDir + L", mode=" + std::wstring(s.sdrMode ? L"SDR" : L"HDR"));
+    LOG_FMT(LogLevel::Info, LogCategory::WebView, L"WebView2Mode: InitWebView2 with userDataDir={}, mode={}", userDataDir, s.sdrMode ? L"SDR" : L"HDR");
+    s.initStart = std::chrono::steady_clock::now();
 
     HRESULT hr = CreateCoreWebView2EnvironmentWithOptions(
         nullptr, userDataDir.c_str(), nullptr,
         Microsoft::WRL::Callback<ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler>(
             [&s](HRESULT result, ICoreWebView2Environment* env) -> HRESULT {
                 if (FAILED(result) || !env) {
-                    LOG_MSG(L"WebView2Mode: Environment creation failed");
+                    LOG_AT(LogLevel::Error, LogCategory::WebView, L"WebView2Mode: Environment creation failed");
                     PostQuitMessage(1);
                     return S_OK;
                 }
+                s.environment = env;
                 env->CreateCoreWebView2Controller(
                     s.hwnd,
                     Microsoft::WRL::Callback<ICoreWebView2CreateCoreWebView2ControllerCompletedHandler>(
                         [&s](HRESULT result2, ICoreWebView2Controller* controller) -> HRESULT {
                             if (FAILED(result2) || !controller) {
-                                LOG_MSG(L"WebView2Mode: Controller creation failed");
+                                LOG_AT(LogLevel::Error, LogCategory::WebView, L"WebView2Mode: Controller creation failed");
                                 PostQuitMessage(1);
                                 return S_OK;
                             }
                             s.controller = controller;
                             if (FAILED(s.controller->get_CoreWebView2(&s.webview)) || !s.webview) {
-                                LOG_MSG(L"WebView2Mode: Failed to get CoreWebView2");
+                                LOG_AT(LogLevel::Error, LogCategory::WebView, L"WebView2Mode: Failed to get CoreWebView2");
                                 PostQuitMessage(1);
                                 return S_OK;
                             }
-                            LOG_MSG(L"WebView2Mode: Controller and WebView created");
+                            WV2Metrics::Get().initTime.Record(MicrosSince(s.initStart));
+                            LOG_AT(LogLevel::Info, LogCategory::WebView, L"WebView2Mode: Controller and WebView created");
                             RECT rc; GetClientRect(s.hwnd, &rc);
                             s.controller->put_Bounds(rc);
                             ComPtr<ICoreWebView2Settings> settings;
@@ -374,12 +560,12 @@ static bool InitWebView2(WV2State& s)
                                                     // Decide direction based on last navigation
                                                     UINT advanceKey = (g_wv2_last_nav_key == VK_LEFT) ? VK_LEFT : VK_RIGHT;
                                                     // Log the skip action (URI and direction)
-                                                    LOG_MSG(L"WebView2Mode: Skipping unsupported image: " , uri , L" -> direction=" , (advanceKey == VK_LEFT ? L"LEFT" : L"RIGHT"));
-                                                    // Immediately advance by posting a hotkey message with the chosen direction
-                                                    if (g_wv2_thread_id != 0) {
-                                                        if (!PostThreadMessageW(g_wv2_thread_id, WM_APP_HOTKEY, (WPARAM)advanceKey, 0)) {
-                                                            LOG_MSG(L"WebView2Mode: Skipping unsupported image: failed to advance to next image");
-                                                        }
+                                                    LOG_FMT(LogLevel::Info, LogCategory::Navigation, L"WebView2Mode: Skipping unsupported image: {} -> direction={}", uri, advanceKey == VK_LEFT ? L"LEFT" : L"RIGHT");
+                                                    WV2Metrics::CountSkip(uri);
+                                                    // Immediately advance this output by posting a hotkey event with the chosen
+                                                    // direction (target = output + 1; 0 would advance every output)
+                                                    if (g_wv2_events) {
+                                                        g_wv2_events->Post({ WV2Event::Kind::Hotkey, advanceKey, s.output + 1, {} });
                                                     } else {
                                                         if (s.hwnd) {
                                                             PostMessageW(s.hwnd, WM_KEYDOWN, (WPARAM)advanceKey, 0);
@@ -402,11 +588,11 @@ static bool InitWebView2(WV2State& s)
                                         LPWSTR uri = nullptr;
                                         if (SUCCEEDED(args->get_Uri(&uri)) && uri) {
                                             std::wstring u(uri);
-                                            LOG_MSG(std::wstring(L"WebView2Mode: NavigationStarting -> ") + u);
-                                            // Allow only file:// URIs
-                                            if (u.rfind(L"file://", 0) != 0) {
+                                            LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"WebView2Mode: NavigationStarting -> {}", u);
+                                            // Allow only slides served from the cache and file:// URIs
+                                            if (u.rfind(kSlideOrigin, 0) != 0 && u.rfind(L"file://", 0) != 0) {
                                                 args->put_Cancel(TRUE);
-                                                LOG_MSG(L"WebView2Mode: Navigation canceled for non-file URI: ", u.c_str());
+                                                LOG_FMT(LogLevel::Warn, LogCategory::Navigation, L"WebView2Mode: Navigation canceled for non-slide URI: {}", u);
                                             }
                                             CoTaskMemFree(uri);
                                         }
@@ -414,14 +600,70 @@ static bool InitWebView2(WV2State& s)
                                     }).Get(),
                                 &navStartToken);
 
+                            // Serve slide URIs from the shared slideshow cache
+                            const std::wstring slideFilter = std::wstring(kSlideOrigin) + L"*";
+                            s.webview->AddWebResourceRequestedFilter(slideFilter.c_str(), COREWEBVIEW2_WEB_RESOURCE_CONTEXT_ALL);
+                            s.webview->add_WebResourceRequested(
+                                Microsoft::WRL::Callback<ICoreWebView2WebResourceRequestedEventHandler>(
+                                    [&s](ICoreWebView2*, ICoreWebView2WebResourceRequestedEventArgs* args) -> HRESULT {
+                                        ComPtr<ICoreWebView2WebResourceRequest> request;
+                                        LPWSTR uriRaw = nullptr;
+                                        if (FAILED(args->get_Request(&request)) || !request || FAILED(request->get_Uri(&uriRaw)) || !uriRaw) return S_OK;
+                                        const std::wstring uri(uriRaw);
+                                        CoTaskMemFree(uriRaw);
+                                        size_t index = 0;
+                                        if (!s.slideshow || !s.environment || !ParseSlideUri(uri, index)) return S_OK;
+                                        // A slide not cached yet is read on the pool: this thread also runs the
+                                        // low-level hooks, which must not wait for a slow or network read
+                                        ComPtr<ICoreWebView2Environment> environment = s.environment;
+                                        std::shared_ptr<const ImageData> data = s.slideshow->Cached(index);
+                                        ComPtr<ICoreWebView2Deferral> deferral;
+                                        if (!data && g_wv2_events && SUCCEEDED(args->GetDeferral(&deferral)) && deferral) {
+                                            ComPtr<ICoreWebView2WebResourceRequestedEventArgs> pending(args);
+                                            CompletionChannel<WV2Event>* events = g_wv2_events;
+                                            // The COM pointers are moved on to the completion, so they are only used
+                                            // and released on this thread
+                                            s.slideshow->AcquireAsync(index, [events, environment, pending, deferral, uri](std::shared_ptr<const ImageData> loaded) mutable {
+                                                events->Post({ WV2Event::Kind::Completion, 0, 0,
+                                                               [environment = std::move(environment), pending = std::move(pending), deferral = std::move(deferral), uri, loaded] {
+                                                                   RespondWithSlide(environment.Get(), pending.Get(), uri, loaded.get());
+                                                                   deferral->Complete();
+                                                               } });
+                                            });
+                                            return S_OK;
+                                        }
+                                        if (!data) data = s.slideshow->Acquire(index);
+                                        RespondWithSlide(environment.Get(), args, uri, data.get());
+                                        return S_OK;
+                                    }).Get(),
+                                &s.resourceToken);
+
                             EventRegistrationToken navCompletedToken{};
                             s.webview->add_NavigationCompleted(
                                 Microsoft::WRL::Callback<ICoreWebView2NavigationCompletedEventHandler>(
-                                    [](ICoreWebView2*, ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
+                                    [&s](ICoreWebView2*, ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
                                         BOOL isSuccess = FALSE; args->get_IsSuccess(&isSuccess);
                                         COREWEBVIEW2_WEB_ERROR_STATUS status = COREWEBVIEW2_WEB_ERROR_STATUS_UNKNOWN;
                                         args->get_WebErrorStatus(&status);
-                                        LOG_MSG(std::wstring(L"WebView2Mode: NavigationCompleted -> ") + (isSuccess ? L"success" : L"failure") + L", status=" + std::to_wstring((int)status));
+                                        if (isSuccess) {
+                                            const uint64_t micros = MicrosSince(s.navStart);
+                                            WV2Metrics::Get().loadTime.Record(micros);
+                                            // Teaches the slideshow how far ahead of its time to show a slide
+                                            if (s.rendered && s.slideshow && s.navIndex < s.slideshow->Catalog().Size()) {
+                                                s.slideshow->CostModel().Record(s.slideshow->Catalog()[s.navIndex], LoadStage::Render,
+                                                                                std::chrono::microseconds(micros));
+                                            }
+                                            s.rendered = true;
+                                        } else {
+                                            WV2Metrics::Get().navigationsFailed.Add();
+                                        }
+                                        if (isSuccess && !g_wv2_first_slide_shown) {
+                                            g_wv2_first_slide_shown = true;
+                                            const int64_t ms = MillisSinceProcessStart();
+                                            WV2Metrics::Get().firstSlide.Set(ms);
+                                            LOG_FMT(LogLevel::Info, LogCategory::WebView, L"WebView2Mode: First slide on screen {} ms after activation", ms);
+                                        }
+                                        LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"WebView2Mode: NavigationCompleted -> {}, status={}", isSuccess ? L"success" : L"failure", (int)status);
                                         return S_OK;
                                     }).Get(),
                                 &navCompletedToken);
@@ -433,10 +675,47 @@ static bool InitWebView2(WV2State& s)
     return SUCCEEDED(hr);
 }
 
+// The library as the settings select it: from a current index written by "hdrscan --warm",
+// which replaces the folder walk and leaves out files the scan found unsupported or broken, or
+// from the folder, narrowed by the playlist query if there is one
+static ImageCatalog ListLibrary(const ScreenSaverSettings& settings, const CatalogQuery* playlist, CatalogIndex& index, bool& indexed)
+{
+    ImageCatalog catalog;
+    {
+        ScopedTimer timer(WV2Metrics::Get().enumerationTime);
+        indexed = index.Load(CatalogIndex::DefaultPath()) && index.Matches(settings.imageFolder, settings.includeSubfolders) && index.IsCurrent();
+        if (indexed) {
+            catalog = index.ToCatalog(true);
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Catalog of {} images from the scan index ({} indexed)", catalog.Size(), index.Entries().size());
+        } else {
+            catalog = ImageCatalog::FromFolder(settings.imageFolder, settings.includeSubfolders);
+        }
+    }
+    if (catalog.Empty() || !playlist) return catalog;
+    // Gain map, dimension and headroom terms need the scan index; without it only
+    // date, size, format and folder terms can match
+    const CatalogTable table = indexed ? CatalogTable::FromIndex(index) : CatalogTable::FromCatalog(catalog, settings.imageFolder);
+    CatalogQuery query = *playlist;
+    query.flagsMask |= kCatalogDisplays;
+    query.flagsValue |= kCatalogDisplays;
+    catalog = table.ToCatalog(table.Select(query));
+    LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Playlist query '{}' selected {} of {} images", settings.playlistQuery, catalog.Size(), table.Size());
+    return catalog;
+}
+
 int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings& settings, const std::wstring& singleImagePath /*= L""*/, bool disableAutoAdvance /*= false*/)
 {
-    std::vector<std::wstring> imageFiles;
+    ImageCatalog catalog;
+    CatalogIndex index;
+    bool indexed = false;
     std::wstring startingImage = L"";
+    CatalogQuery playlist;
+    const CatalogQuery* playlistQuery = nullptr;
+    // Warm start: the slides the last session would have shown next, and their bytes
+    const bool tracing = !settings.tracePath.empty();
+    bool restored = false;
+    std::vector<std::shared_ptr<const ImageData>> restoredData;
+    std::vector<size_t> restoredFirst;
 
     if (!singleImagePath.empty()) {
         if (!std::filesystem::exists(singleImagePath) || !std::filesystem::is_regular_file(singleImagePath)) {
@@ -444,82 +723,355 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
             return 1;
         }
         startingImage = singleImagePath;
-        // Try to load all images from the same folder as the provided image so arrow keys can navigate
-        try {
-            std::filesystem::path p(singleImagePath);
-            std::filesystem::path parent = p.parent_path();
-            if (!parent.empty() && std::filesystem::exists(parent)) {
-                imageFiles = GetImageFilesInFolder(parent.wstring(), settings.includeSubfolders);
-            }
-        } catch (...) {
-            // Fall back to single image only
-        }
-        if (imageFiles.empty()) {
-            // Fallback: show only the provided file
-            imageFiles.push_back(singleImagePath);
-        }
+        // Show the file right away; the rest of its folder is listed in the background below
+        catalog = ImageCatalog({ singleImagePath });
     } else {
         if (!std::filesystem::exists(settings.imageFolder)) {
             MessageBoxW(nullptr, (L"HDRScreenSaver: Image folder not found:\n" + settings.imageFolder).c_str(), L"HDRScreenSaver", MB_OK);
             return 1;
         }
-        imageFiles = GetImageFilesInFolder(settings.imageFolder, settings.includeSubfolders);
-        if (imageFiles.empty()) {
-            LOG_MSG(L"No images found in folder: " + settings.imageFolder);
-            return 1;
+        if (!settings.playlistQuery.empty()) {
+            std::wstring error;
+            if (!CatalogQuery::Parse(settings.playlistQuery, playlist, &error)) {
+                MessageBoxW(nullptr, (L"HDRScreenSaver: Invalid playlist query\n" + error).c_str(), L"HDRScreenSaver", MB_OK);
+                return 1;
+            }
+            playlistQuery = &playlist;
+        }
+        // The last session's next slides go on screen while the library is listed in the
+        // background. Not while tracing: a replay starts from the listing.
+        SessionSnapshot snapshot;
+        if (!tracing && snapshot.Load(SessionSnapshot::DefaultPath()) &&
+            snapshot.Matches(settings.imageFolder, settings.includeSubfolders, settings.playlistQuery, settings.randomizeOrder)) {
+            catalog = snapshot.Restore(restoredData, restoredFirst);
+            restored = !catalog.Empty();
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Restored {} of {} slides from the session snapshot", catalog.Size(), snapshot.slides.size());
+        }
+        if (!restored) {
+            catalog = ListLibrary(settings, playlistQuery, index, indexed);
+            if (catalog.Empty()) {
+                LOG_MSG(playlistQuery ? L"No images match the playlist query: " + settings.playlistQuery : L"No images found in folder: " + settings.imageFolder);
+                return 1;
+            }
         }
     }
+    WV2Metrics::Get().warmStart.Set(restored ? 1 : 0);
+
+    WV2Metrics::Get().catalogImages.Set(static_cast<int64_t>(catalog.Size()));
 
     // Determine start index if a starting image was provided
     size_t startIndex = 0;
     if (!startingImage.empty()) {
-        for (size_t i = 0; i < imageFiles.size(); ++i) {
-            bool matched = false;
+        size_t found = catalog.Find(startingImage);
+        if (found != ImageCatalog::npos) startIndex = found;
+    }
+
+    const bool fullscreen = shutdownOnAnyUnhandledInput; // fullscreen for screensaver mode
+
+    // One output per monitor in screensaver mode; a single window otherwise
+    std::vector<MonitorOutput> monitors;
+    if (fullscreen) monitors = EnumerateMonitors();
+    if (monitors.empty()) {
+        MonitorOutput window;
+        window.rect = { 0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN) };
+        window.primary = true;
+        monitors.push_back(window);
+    }
+
+    // Hooks, WebView2 callbacks and pool jobs hand their results to the loop below through one
+    // lock-free channel; the first event after a drain wakes the loop with a single message.
+    // Declared before the pool, so jobs still running at shutdown can post to it.
+    const DWORD loopThread = GetCurrentThreadId();
+    CompletionChannel<WV2Event> events([loopThread] {
+        if (!PostThreadMessageW(loopThread, WM_APP_EVENTS, 0, 0)) {
+            LOG_AT(LogLevel::Warn, LogCategory::Input, L"WebView2Mode: PostThreadMessageW failed to wake the message loop");
+        }
+    });
+    g_wv2_events = &events;
+    struct ClearEvents {
+        ~ClearEvents() { g_wv2_events = nullptr; }
+    } clearEvents;
+
+    // The next activation's snapshot is saved every few minutes on the background lane and on
+    // exit; declared before the pool, so a save still running at shutdown can finish
+    const bool snapshotting = singleImagePath.empty() && !tracing;
+    std::mutex snapshotMutex;
+    std::atomic<bool> snapshotBusy{ false };
+    // Headroom in stops the loads read for, so gain maps the display cannot show are never read;
+    // set once the outputs are known. Declared before the pool, which runs the loads.
+    std::atomic<float> loadHeadroom{ -1.0f };
+
+    // All outputs share the catalog, one byte-budgeted cache and one pool for loads (display
+    // lane) and folder scans (background lane)
+    WorkerPool pool;
+    ImageCache cache(settings.enableCaching ? static_cast<uint64_t>(settings.maxCacheMB) << 20 : 0);
+    // Restored bytes stay pinned until the outputs have started, even with caching off
+    for (size_t i = 0; i < restoredData.size(); ++i) {
+        cache.Pin(i);
+        if (restoredData[i]) cache.Put(i, std::move(restoredData[i]));
+    }
+    // MaxCacheMB covers everything the session keeps, not just the encoded images: the catalog
+    // and decoded pixel buffers are counted first, idle pixel buffers give way before the cache
+    MemoryGovernor governor(static_cast<uint64_t>(settings.maxCacheMB) << 20);
+    size_t catalogBytes = catalog.MemoryBytes();
+    governor.Register({ "catalog", MemoryPriority::Working, 0, 0, UINT64_MAX, [&catalogBytes] { return static_cast<uint64_t>(catalogBytes); }, nullptr });
+    governor.Register({ "pixel-buffers", MemoryPriority::Working, 0, 0, UINT64_MAX, [] { return PixelBufferPool::Instance().Stats().inUseBytes; }, nullptr });
+    governor.Register({ "image-cache", MemoryPriority::Prefetch, 20.0, 0, settings.enableCaching ? UINT64_MAX : 0,
+                        [&cache] { return cache.BytesUsed(); }, [&cache](uint64_t bytes) { cache.SetBudget(bytes); } });
+    governor.Register({ "idle-pixel-buffers", MemoryPriority::Idle, 0.5, 0, PixelBufferPool::Instance().IdleBudget(),
+                        [] { return PixelBufferPool::Instance().Stats().idleBytes; }, [](uint64_t bytes) { PixelBufferPool::Instance().SetIdleBudget(bytes); } });
+    MemoryPressure lastPressure = governor.Pressure();
+    // Prefer the display-size renditions baked by hdrbake, where they are current
+    RenditionStore renditions(settings.imageFolder, settings.renditionFolder);
+    Slideshow::LoadFunction load = [&loadHeadroom](const CatalogEntry& entry) {
+        return Slideshow::LoadImageFileForHeadroom(entry, loadHeadroom.load(std::memory_order_relaxed));
+    };
+    if (!settings.renditionFolder.empty()) {
+        if (renditions.Load()) {
+            load = renditions.Loader(&loadHeadroom);
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Using {} rendition records from {}", renditions.Size(), settings.renditionFolder);
+        } else {
+            LOG_FMT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: No rendition manifest in {}", settings.renditionFolder);
+        }
+    }
+    // Shows are counted across sessions. Random order can favour the images shown least recently
+    // or least often, and those matching the boost query; each show updates only its own weight.
+    ShowHistory history;
+    std::vector<uint64_t> showKeys;
+    std::vector<double> boosts;
+    WeightedSampler sampler;
+    const SelectionWeighting weighting = static_cast<SelectionWeighting>(settings.selectionWeighting);
+    // History keys and boost factors of a catalog's entries; returns whether any image is
+    // boosted. Touches no shared state, so a background listing can call it too.
+    auto selectionKeys = [&settings](const ImageCatalog& c, const CatalogIndex& idx, bool idxd, std::vector<uint64_t>& keys, std::vector<double>& factors) {
+        keys.clear();
+        keys.reserve(c.Size());
+        for (const CatalogEntry& entry : c.Entries()) keys.push_back(ShowHistory::KeyOf(entry.path));
+        factors.assign(c.Size(), 1.0);
+        bool boosting = false;
+        if (!settings.selectionBoost.empty()) {
+            CatalogQuery query;
+            std::wstring error;
+            if (CatalogQuery::Parse(settings.selectionBoost, query, &error)) {
+                const CatalogTable table = idxd ? CatalogTable::FromIndex(idx) : CatalogTable::FromCatalog(c, settings.imageFolder);
+                std::unordered_set<uint64_t> matches;
+                for (uint32_t row : table.Select(query)) matches.insert(ShowHistory::KeyOf(table.Path(row)));
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    if (matches.count(keys[i])) {
+                        factors[i] = settings.selectionBoostFactor;
+                        boosting = true;
+                    }
+                }
+            } else {
+                LOG_FMT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: Ignoring invalid selection boost query: {}", error);
+            }
+        }
+        return boosting;
+    };
+    auto assignWeights = [&](bool boosting) {
+        if (settings.randomizeOrder && (weighting != SelectionWeighting::Uniform || boosting)) {
+            const uint32_t now = ShowHistory::MinutesNow();
+            std::vector<double> weights(showKeys.size());
+            for (size_t i = 0; i < weights.size(); ++i) weights[i] = SelectionWeight(history.Find(showKeys[i]), now, weighting) * boosts[i];
+            sampler.Assign(weights);
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Weighted random order ({} shows on record)", history.Size());
+        }
+    };
+    if (singleImagePath.empty()) {
+        history.Load(ShowHistory::DefaultPath());
+        assignWeights(selectionKeys(catalog, index, indexed, showKeys, boosts));
+    }
+    // With TracePath set, every slide change is recorded for hdrreplay, along with what it takes
+    // to rebuild the session: catalog source, outputs and their random order seeds
+    InputTrace trace;
+    if (tracing) {
+        trace.root = singleImagePath.empty() ? settings.imageFolder : std::filesystem::absolute(singleImagePath).wstring();
+        trace.openedFile = !singleImagePath.empty();
+        trace.includeSubfolders = settings.includeSubfolders;
+        if (singleImagePath.empty()) trace.playlistQuery = settings.playlistQuery;
+        trace.weighted = sampler.Size() == catalog.Size();
+        trace.cacheBytes = settings.enableCaching ? static_cast<uint64_t>(settings.maxCacheMB) << 20 : 0;
+        trace.catalogSize = catalog.Size();
+        trace.catalogHash = InputTrace::CatalogHash(catalog, catalog.Size(), trace.CatalogRoot());
+    }
+    auto record = [&](TraceEventKind kind, size_t output, size_t index) {
+        if (tracing) trace.Record(kind, output, index, std::chrono::steady_clock::now());
+    };
+
+    // Catalogs the slideshow switches to later; declared before it, so they outlive it
+    std::vector<std::shared_ptr<const ImageCatalog>> laterCatalogs;
+    Slideshow slideshow(catalog, cache, pool, load);
+    // Open-with: list the file's folder in the background so the arrow keys can navigate once it
+    // is known. The folder order is rotated to start at the file, so the file keeps index 0 and
+    // nothing shown or cached so far changes index. The result reaches the loop as a completion.
+    if (!singleImagePath.empty()) {
+        pool.Submit(WorkerLane::Background, WorkerPool::Clock::now(), [&events, &slideshow, &record, &laterCatalogs, &catalogBytes, path = singleImagePath, includeSubfolders = settings.includeSubfolders] {
+            ImageCatalog siblings;
             try {
-                if (std::filesystem::equivalent(imageFiles[i], startingImage))
-                    matched = true;
+                const std::filesystem::path parent = std::filesystem::absolute(path).parent_path();
+                ImageCatalog folder = ImageCatalog::FromFolder(parent.wstring(), includeSubfolders);
+                const size_t found = folder.Find(path);
+                if (found != ImageCatalog::npos && folder.Size() > 1) {
+                    folder.RotateTo(found);
+                    siblings = std::move(folder);
+                }
             } catch (...) {
-                // fall back to string compare
-                if (imageFiles[i] == startingImage)
-                    matched = true;
+                // Stay with the single image
             }
-            if (matched) {
-                startIndex = i;
-                break;
+            if (siblings.Empty()) return;
+            auto scanned = std::make_shared<ImageCatalog>(std::move(siblings));
+            events.Post({ WV2Event::Kind::Completion, 0, 0, [&slideshow, &record, &laterCatalogs, &catalogBytes, scanned] {
+                laterCatalogs.push_back(scanned);
+                catalogBytes += scanned->MemoryBytes();
+                slideshow.ExtendCatalog(*scanned, std::chrono::steady_clock::now());
+                record(TraceEventKind::Extend, 0, scanned->Size());
+                WV2Metrics::Get().catalogImages.Set(static_cast<int64_t>(scanned->Size()));
+                LOG_FMT(LogLevel::Info, LogCategory::Navigation, L"WebView2Mode: {} images in the folder of the opened file", scanned->Size());
+            } });
+        });
+    }
+    // The slideshow ignores a sampler that does not cover its catalog, so it is set either way
+    slideshow.SetSampler(&sampler);
+    if (singleImagePath.empty()) {
+        slideshow.SetShowCallback([&](size_t index) {
+            if (index >= showKeys.size()) return;
+            const uint32_t now = ShowHistory::MinutesNow();
+            history.RecordShow(showKeys[index], now);
+            if (sampler.Size() == slideshow.Catalog().Size()) sampler.Set(index, SelectionWeight(history.Find(showKeys[index]), now, weighting) * boosts[index]);
+        });
+    }
+    // Warm start: list the library in the background and switch to it once known. The listing
+    // is appended to the restored slides, so nothing shown or cached so far changes index;
+    // sequential outputs then continue from their slide's place in the listing.
+    if (restored) {
+        struct Listing {
+            ImageCatalog catalog;
+            CatalogIndex index;
+            bool indexed = false;
+            std::vector<size_t> positions;
+            std::vector<uint64_t> keys;
+            std::vector<double> boosts;
+            bool boosting = false;
+        };
+        // The job itself touches nothing declared after the pool; the completion runs on this
+        // thread, if at all
+        pool.Submit(WorkerLane::Background, WorkerPool::Clock::now(), [&settings, &events, &slideshow, &cache, &laterCatalogs, &catalogBytes, &showKeys, &boosts,
+                                                                       &assignWeights, playlistQuery, selectionKeys, restoredCatalog = catalog] {
+            auto listed = std::make_shared<Listing>();
+            ImageCatalog listing;
+            try {
+                listing = ListLibrary(settings, playlistQuery, listed->index, listed->indexed);
+            } catch (...) {
+                // Stay with the restored slides
             }
-        }
+            if (listing.Empty()) return;
+            listed->catalog = SessionSnapshot::Extend(restoredCatalog, listing, listed->positions);
+            listed->boosting = selectionKeys(listed->catalog, listed->index, listed->indexed, listed->keys, listed->boosts);
+            events.Post({ WV2Event::Kind::Completion, 0, 0, [&slideshow, &cache, &laterCatalogs, &catalogBytes, &showKeys, &boosts, &assignWeights, listed] {
+                const auto now = std::chrono::steady_clock::now();
+                laterCatalogs.push_back(std::shared_ptr<const ImageCatalog>(listed, &listed->catalog));
+                catalogBytes += listed->catalog.MemoryBytes();
+                SessionSnapshot::CopyRestored(cache, listed->positions);
+                showKeys = std::move(listed->keys);
+                boosts = std::move(listed->boosts);
+                assignWeights(listed->boosting);
+                slideshow.ExtendCatalog(listed->catalog, now);
+                for (size_t o = 0; o < slideshow.OutputCount(); ++o) {
+                    if (slideshow.OutputConfig(o).order != SlideOrder::Sequential) continue;
+                    const size_t current = slideshow.CurrentIndex(o);
+                    if (current < listed->positions.size() && listed->positions[current] != ImageCatalog::npos) {
+                        slideshow.Resume(o, listed->positions[current], now);
+                    }
+                }
+                WV2Metrics::Get().catalogImages.Set(static_cast<int64_t>(listed->catalog.Size()));
+                LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Library listed behind the warm start, {} images", listed->catalog.Size());
+            } });
+        });
     }
+    // If disableAutoAdvance is requested (open-with single file), we'll skip the automatic advancement.
+    const bool autoAdvanceEnabled = !disableAutoAdvance;
 
-    WV2State s;
-    const bool fullscreen = shutdownOnAnyUnhandledInput; // fullscreen for screensaver mode
+    std::vector<std::unique_ptr<WV2State>> states;
+    for (const MonitorOutput& monitor : monitors) {
+        SlideOutputConfig config;
+        config.name = monitor.device;
+        config.width = monitor.rect.right - monitor.rect.left;
+        config.height = monitor.rect.bottom - monitor.rect.top;
+        config.headroom = monitor.headroom;
+        config.interval = std::chrono::seconds(settings.displaySeconds);
+        config.autoAdvance = autoAdvanceEnabled;
+        config.order = settings.randomizeOrder ? SlideOrder::Random : SlideOrder::Sequential;
+        // A replay needs the seed the order was drawn with
+        if (tracing && config.order == SlideOrder::Random) {
+            std::random_device device;
+            config.seed = (static_cast<uint64_t>(device()) << 32 | device()) | 1;
+        }
+        // Sequential outputs start spread over the catalog instead of showing the same image;
+        // restored ones where they left off
+        config.startIndex = (startIndex + states.size() * catalog.Size() / monitors.size()) % catalog.Size();
+        if (states.size() < restoredFirst.size() && restoredFirst[states.size()] != ImageCatalog::npos) config.startIndex = restoredFirst[states.size()];
+
+        auto state = std::make_unique<WV2State>();
+        state->output = slideshow.AddOutput(config);
+        if (tracing) trace.outputs.push_back(config);
+        state->bounds = monitor.rect;
+        state->slideshow = &slideshow;
+        LOG_FMT(LogLevel::Info, LogCategory::WebView, L"WebView2Mode: Output {} on {} ({}x{}, headroom {})",
+                state->output, monitor.device, config.width, config.height, static_cast<double>(config.headroom));
+        states.push_back(std::move(state));
+    }
+    WV2State& primary = *states.front();
+    // In SDR mode WebView2 shows no gain map. In HDR mode it uses its own headroom, peak over the
+    // SDR white level set in Windows, which can be as low as 80 nits: only the highest that gives
+    // is a safe limit, and only when every monitor reported its peak.
+    auto servedHeadroom = [&] {
+        if (primary.sdrMode) return 0.0f;
+        float peak = 0.0f;
+        for (const auto& state : states) {
+            const float headroom = slideshow.OutputConfig(state->output).headroom;
+            if (headroom <= 1.0f) return -1.0f;
+            peak = std::max(peak, headroom);
+        }
+        return std::log2(peak * 203.0f / 80.0f);
+    };
+    loadHeadroom.store(servedHeadroom(), std::memory_order_relaxed);
 
     // Build a window title. In windowed mode include the current file name for easier identification.
     std::string windowTitle = "HDRScreenSaver";
-    if (!fullscreen && !imageFiles.empty()) {
-        std::wstring wname = std::filesystem::path(imageFiles[startIndex]).wstring();
+    if (!fullscreen) {
+        std::wstring wname = std::filesystem::path(catalog[startIndex].path).wstring();
         windowTitle = BuildWindowTitleA(wname);
     }
 
-    if (!CreateHostWindow(s, windowTitle.c_str(), fullscreen)) return 1;
-
-    // (no interactive debug popup here) ensure thread id recorded for hook forwarding
-    g_wv2_thread_id = GetCurrentThreadId();
+    std::vector<HWND> hosts;
+    for (auto& state : states) {
+        if (!CreateHostWindow(*state, windowTitle.c_str(), fullscreen)) return 1;
+        hosts.push_back(state->hwnd);
+    }
+    if (fullscreen) ShowCursor(FALSE);
 
     HRESULT hrCo = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
     bool needUninit = SUCCEEDED(hrCo);
 
-    if (!InitWebView2(s)) {
-        if (needUninit) CoUninitialize();
-        return 1;
+    for (auto& state : states) {
+        if (!InitWebView2(*state)) {
+            if (needUninit) CoUninitialize();
+            return 1;
+        }
     }
 
+    auto allReady = [&]() {
+        for (const auto& state : states) {
+            if (!state->webview || !state->controller) return false;
+        }
+        return true;
+    };
+
     // Wait for asynchronous WebView2 initialization to complete
     {
         const auto waitStart = std::chrono::steady_clock::now();
         const auto maxWait = std::chrono::seconds(10);
-        // Record our thread id so the keyboard hook can forward messages here
-        g_wv2_thread_id = GetCurrentThreadId();
-        while (!s.webview || !s.controller) {
+        while (!allReady()) {
             MSG m;
             while (PeekMessage(&m, nullptr, 0, 0, PM_REMOVE)) {
                 if (m.message == WM_QUIT) {
@@ -540,72 +1092,71 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
     }
 
     // Navigation helpers
-    auto navigateTo = [&](size_t index) {
+    auto navigateTo = [&](WV2State& s, size_t index) {
         if (!s.webview) {
-            LOG_MSG(L"WebView2Mode: navigateTo called before webview ready");
+            LOG_AT(LogLevel::Warn, LogCategory::Navigation, L"WebView2Mode: navigateTo called before webview ready");
             return;
         }
-        const std::wstring uri = ToFileUri(imageFiles[index]);
+        const CatalogEntry& entry = slideshow.Catalog()[index];
+        const std::wstring uri = BuildSlideUri(index, entry.path);
+        s.navStart = std::chrono::steady_clock::now();
+        s.navIndex = index;
         s.webview->Navigate(uri.c_str());
-        LOG_MSG(L"WebView2Mode: Showing " + imageFiles[index]);
+        WV2Metrics& metrics = WV2Metrics::Get();
+        metrics.imagesShown.Add();
+        metrics.bytesShown.Add(entry.fileSize);
+        LOG_FMT(LogLevel::Info, LogCategory::Navigation, L"WebView2Mode: Output {} showing {}", s.output, entry.path);
         // Update window title to reflect the currently shown image (full path) when not fullscreen
         if (!fullscreen && s.hwnd) {
-            std::wstring wpath = std::filesystem::path(imageFiles[index]).wstring();
+            std::wstring wpath = std::filesystem::path(entry.path).wstring();
             std::string title = BuildWindowTitleA(wpath);
             SetWindowTextA(s.hwnd, title.c_str());
         }
     };
 
-    // State for navigation
-    size_t currentIndex = startIndex;
-    std::vector<size_t> history; history.reserve(1024);
-    size_t historyPosition = 0;
-    const size_t maxHistorySize = 1000;
-    std::random_device rd; std::mt19937 gen(rd());
-    std::uniform_int_distribution<size_t> dist(0, imageFiles.size() - 1);
-
-    auto getNextRandomIndex = [&]() -> size_t {
-        size_t nextIndex = dist(gen);
-        if (historyPosition < history.size()) history.resize(historyPosition);
-        history.push_back(currentIndex);
-        if (history.size() > maxHistorySize) history.erase(history.begin());
-        historyPosition = history.size();
-        return nextIndex;
-    };
-
     // Ensure focus is on our host and WebView for immediate keyboard handling
-    SetHostFocus(s);
+    SetHostFocus(primary);
 
-    // First navigation once ready
-    navigateTo(currentIndex);
+    // First navigation of every output once ready
+    trace.Start(std::chrono::steady_clock::now());
+    for (const SlideChange& change : slideshow.Tick(std::chrono::steady_clock::now())) {
+        record(TraceEventKind::Advance, change.output, change.index);
+        navigateTo(*states[change.output], change.index);
+    }
+    // The outputs hold their own pins now; the rest of the restored bytes may be evicted
+    for (size_t i = 0; i < restoredData.size(); ++i) cache.Unpin(i);
 
-    // Consolidated key handler used by accelerator callback and forwarded hotkey messages
-    auto handleKey = [&](UINT key, WV2State& state) -> bool {
+    // Consolidated key handler used by accelerator callback and forwarded hotkey messages.
+    // Navigation keys move every output, or only `target` (used when one output skips an image).
+    const size_t kAllOutputs = static_cast<size_t>(-1);
+    auto handleKey = [&](UINT key, size_t target) -> bool {
         bool handled = false;
         if (key == VK_ESCAPE) {
             PostQuitMessage(0);
             handled = true;
-        } else if (key == VK_RIGHT) {
-            // record navigation direction so DownloadStarting knows user intent
-            SetLastNavKey(VK_RIGHT);
-            if (settings.randomizeOrder) currentIndex = getNextRandomIndex();
-            else currentIndex = (currentIndex + 1) % imageFiles.size();
-            navigateTo(currentIndex);
-            handled = true;
-        } else if (key == VK_LEFT) {
+        } else if (key == VK_RIGHT || key == VK_LEFT) {
+            // Until the folder of an opened file is listed there is nothing to move to
+            if (slideshow.Catalog().Size() < 2) return true;
             // record navigation direction so DownloadStarting knows user intent
-            SetLastNavKey(VK_LEFT);
-            if (settings.randomizeOrder) {
-                if (historyPosition > 0) { historyPosition--; currentIndex = history[historyPosition]; }
-            } else {
-                currentIndex = (currentIndex + imageFiles.size() - 1) % imageFiles.size();
+            SetLastNavKey(key);
+            const auto now = std::chrono::steady_clock::now();
+            for (auto& state : states) {
+                if (target != kAllOutputs && state->output != target) continue;
+                SlideChange change = key == VK_RIGHT ? slideshow.Next(state->output, now) : slideshow.Previous(state->output, now);
+                if (target == kAllOutputs) record(key == VK_RIGHT ? TraceEventKind::Next : TraceEventKind::Previous, change.output, change.index);
+                else record(key == VK_RIGHT ? TraceEventKind::SkipNext : TraceEventKind::SkipPrevious, change.output, change.index);
+                navigateTo(*state, change.index);
             }
-            navigateTo(currentIndex);
             handled = true;
         } else if (key == VK_DOWN || key == 'H' || key == 'h' || key == 'S' || key == 's') {
-            state.sdrMode = !state.sdrMode;
-            state.requestReinit = true;
-            LOG_MSG(std::wstring(L"WebView2Mode: Hotkey H/S toggled. New mode: ") + (state.sdrMode ? L"SDR" : L"HDR"));
+            for (auto& state : states) {
+                state->sdrMode = !state->sdrMode;
+                state->requestReinit = true;
+            }
+            loadHeadroom.store(servedHeadroom(), std::memory_order_relaxed);
+            // Back in HDR, the images loaded for SDR need their gain maps again
+            if (!primary.sdrMode) slideshow.Reload([](const ImageData& data) { return data.gainMapOmitted; }, std::chrono::steady_clock::now());
+            LOG_FMT(LogLevel::Info, LogCategory::Input, L"WebView2Mode: Hotkey H/S toggled. New mode: {}", primary.sdrMode ? L"SDR" : L"HDR");
             handled = true;
         } else if (shutdownOnAnyUnhandledInput) {
             PostQuitMessage(0);
@@ -632,7 +1183,7 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
                 COREWEBVIEW2_KEY_EVENT_KIND kind{}; args->get_KeyEventKind(&kind);
                 UINT key = 0; args->get_VirtualKey(&key);
                 if (kind == COREWEBVIEW2_KEY_EVENT_KIND_KEY_DOWN || kind == COREWEBVIEW2_KEY_EVENT_KIND_SYSTEM_KEY_DOWN) {
-                    bool handled = handleKey(key, state);
+                    bool handled = handleKey(key, kAllOutputs);
                     if (handled) args->put_Handled(TRUE);
                 }
                 return S_OK;
@@ -641,36 +1192,58 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
     };
 
     // Attach for the first time
-    attachAccelerator(s);
+    for (auto& state : states) attachAccelerator(*state);
 
     // Mouse movement exit like existing saver
     POINT initialMousePos{0,0}; GetCursorPos(&initialMousePos);
     bool mouseMoved = false;
 
-    const auto advanceInterval = std::chrono::seconds(settings.displaySeconds);
-    // If disableAutoAdvance is requested (open-with single file), we'll skip the automatic advancement.
-    const bool autoAdvanceEnabled = !disableAutoAdvance;
-    auto lastAdvance = std::chrono::steady_clock::now();
+    // Everything posted to the channel, in order. Also run once per loop pass, so an event whose
+    // wake-up message was lost (a full thread queue) waits one pass at most.
+    auto drainEvents = [&] {
+        events.Drain([&](WV2Event& e) {
+            switch (e.kind) {
+            case WV2Event::Kind::Hotkey:
+                handleKey(e.key, e.target > 0 ? e.target - 1 : kAllOutputs);
+                break;
+            case WV2Event::Kind::MouseMove:
+                // Mouse moved according to low-level hook; perform same shutdown logic as WM_MOUSEMOVE
+                if (shutdownOnAnyUnhandledInput) {
+                    PostQuitMessage(0);
+                    mouseMoved = true;
+                }
+                break;
+            case WV2Event::Kind::Completion:
+                e.completion();
+                break;
+            }
+        });
+    };
+
+    // What the next activation restores: the upcoming slides as of now, under the settings shown
+    auto captureSnapshot = [&] {
+        auto snapshot = std::make_shared<SessionSnapshot>(SessionSnapshot::Capture(slideshow, cache));
+        snapshot->folder = settings.imageFolder;
+        snapshot->includeSubfolders = settings.includeSubfolders;
+        snapshot->playlistQuery = settings.playlistQuery;
+        snapshot->randomOrder = settings.randomizeOrder;
+        return snapshot;
+    };
+    const auto kSnapshotInterval = std::chrono::minutes(2);
+    auto nextSnapshot = std::chrono::steady_clock::now() + kSnapshotInterval;
 
     MSG msg;
     bool running = true;
     // Install low-level keyboard and mouse hooks
-    InstallLowLevelHooks(s, initialMousePos);
+    InstallLowLevelHooks(hosts, initialMousePos);
     while (running)
     {
         while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
             if (msg.message == WM_QUIT) { running = false; break; }
 
-            // Forwarded hotkey from low-level hook
-            if (msg.message == WM_APP_HOTKEY) {
-                WPARAM key = msg.wParam;
-                if (handleKey((UINT)key, s)) continue;
-            }
-
-            if (msg.message == WM_APP_MOUSEMOVE && shutdownOnAnyUnhandledInput) {
-                // Mouse moved according to low-level hook; perform same shutdown logic as WM_MOUSEMOVE
-                PostQuitMessage(0);
-                mouseMoved = true;
+            // Hotkeys and mouse movement from the low-level hooks, and finished pool work
+            if (msg.message == WM_APP_EVENTS) {
+                drainEvents();
                 continue;
             }
             if (msg.message == WM_MOUSEMOVE && shutdownOnAnyUnhandledInput) {
@@ -686,28 +1259,38 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
         }
 
         if (!running) break;
+        if (!events.Empty()) drainEvents();
 
         // Handle SDR/HDR reinit request
-        if (s.requestReinit) {
-            s.requestReinit = false;
-            LOG_MSG(std::wstring(L"WebView2Mode: Reinitializing WebView2 for mode: ") + (s.sdrMode ? L"SDR" : L"HDR"));
-            // Save current bounds
-            RECT curBounds{0,0,0,0};
-            if (s.controller) s.controller->get_Bounds(&curBounds);
-            LOG_MSG(L"WebView2Mode: Current bounds before reinit: left=" + std::to_wstring(curBounds.left) + L", top=" + std::to_wstring(curBounds.top) + L", right=" + std::to_wstring(curBounds.right) + L", bottom=" + std::to_wstring(curBounds.bottom));
-            // Tear down existing controller/webview and unregister handlers
-            RemoveAcceleratorIfAny(s);
-            RemoveDownloadHandlerIfAny(s);
-            s.webview.Reset();
-            s.controller.Reset();
+        if (primary.requestReinit) {
+            LOG_FMT(LogLevel::Info, LogCategory::WebView, L"WebView2Mode: Reinitializing WebView2 for mode: {}", primary.sdrMode ? L"SDR" : L"HDR");
             // Uninstall low-level hooks prior to reinit
-            UninstallLowLevelHooks(s);
-            // Recreate with requested mode
-            if (!InitWebView2(s)) { running = false; break; }
+            UninstallLowLevelHooks();
+            std::vector<RECT> savedBounds;
+            for (auto& state : states) {
+                WV2State& s = *state;
+                s.requestReinit = false;
+                // Save current bounds
+                RECT curBounds{0,0,0,0};
+                if (s.controller) s.controller->get_Bounds(&curBounds);
+                LOG_FMT(LogLevel::Debug, LogCategory::WebView, L"WebView2Mode: Output {} bounds before reinit: left={}, top={}, right={}, bottom={}",
+                        s.output, curBounds.left, curBounds.top, curBounds.right, curBounds.bottom);
+                savedBounds.push_back(curBounds);
+                // Tear down existing controller/webview and unregister handlers
+                RemoveAcceleratorIfAny(s);
+                RemoveDownloadHandlerIfAny(s);
+                RemoveResourceHandlerIfAny(s);
+                s.webview.Reset();
+                s.controller.Reset();
+                s.environment.Reset();
+                // Recreate with requested mode
+                if (!InitWebView2(s)) { running = false; break; }
+            }
+            if (!running) break;
             // Wait until ready
             {
                 const auto t0 = std::chrono::steady_clock::now();
-                while (!s.webview || !s.controller) {
+                while (!allReady()) {
                     MSG m; while (PeekMessage(&m, nullptr, 0, 0, PM_REMOVE)) { TranslateMessage(&m); DispatchMessage(&m); }
                     if (std::chrono::steady_clock::now() - t0 > std::chrono::seconds(5)) break;
                     Sleep(5);
@@ -715,39 +1298,86 @@ int RunWebView2Mode(bool shutdownOnAnyUnhandledInput, const ScreenSaverSettings&
             }
 
             // Ensure focus is on our host and WebView for immediate keyboard handling
-            SetHostFocus(s);
-            if (s.controller) s.controller->put_Bounds(curBounds);
-            LOG_MSG(L"WebView2Mode: Reinit complete. Restored bounds and reattached handlers. Navigating to current image.");
-
-            // Reattach accelerator handler
-            attachAccelerator(s);
-
-            // Navigate to current image again
-            navigateTo(currentIndex);
+            SetHostFocus(primary);
+            for (size_t i = 0; i < states.size(); ++i) {
+                WV2State& s = *states[i];
+                if (s.controller) s.controller->put_Bounds(savedBounds[i]);
+                // Reattach accelerator handler
+                attachAccelerator(s);
+                // Navigate to current image again
+                navigateTo(s, slideshow.CurrentIndex(s.output));
+            }
+            LOG_AT(LogLevel::Debug, LogCategory::WebView, L"WebView2Mode: Reinit complete. Restored bounds and reattached handlers. Navigated to current images.");
 
             // Reinstall low-level hooks after reinit
             POINT curPos{0,0}; GetCursorPos(&curPos);
-            InstallLowLevelHooks(s, curPos);
+            InstallLowLevelHooks(hosts, curPos);
         }
 
-        if (autoAdvanceEnabled && std::chrono::steady_clock::now() - lastAdvance >= advanceInterval) {
-            lastAdvance = std::chrono::steady_clock::now();
+        // Automatic advancing of every output whose next slide is due
+        const auto changes = slideshow.Tick(std::chrono::steady_clock::now());
+        if (!changes.empty()) {
             // record automatic forward navigation
             SetLastNavKey(VK_RIGHT);
-            if (settings.randomizeOrder) currentIndex = getNextRandomIndex();
-            else currentIndex = (currentIndex + 1) % imageFiles.size();
-            navigateTo(currentIndex);
+        }
+        for (const SlideChange& change : changes) {
+            record(TraceEventKind::Advance, change.output, change.index);
+            navigateTo(*states[change.output], change.index);
+        }
+
+        // Budget shares follow the catalog growing and the system running short of memory
+        governor.Poll(std::chrono::steady_clock::now());
+        if (governor.Pressure() != lastPressure) {
+            lastPressure = governor.Pressure();
+            governor.LogAccounting(LogLevel::Info);
+        }
+
+        // Captured here, where the slideshow lives; written on the background lane
+        if (snapshotting && std::chrono::steady_clock::now() >= nextSnapshot && !snapshotBusy.exchange(true)) {
+            nextSnapshot = std::chrono::steady_clock::now() + kSnapshotInterval;
+            pool.Submit(WorkerLane::Background, WorkerPool::Clock::now(), [&snapshotMutex, &snapshotBusy, snapshot = captureSnapshot()] {
+                {
+                    std::lock_guard<std::mutex> lock(snapshotMutex);
+                    if (!snapshot->Save(SessionSnapshot::DefaultPath())) {
+                        LOG_AT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: Could not save the session snapshot");
+                    }
+                }
+                snapshotBusy = false;
+            });
         }
 
         Sleep(10);
     }
 
+    governor.LogAccounting(LogLevel::Info);
+
+    if (snapshotting) {
+        const auto snapshot = captureSnapshot();
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        if (!snapshot->Save(SessionSnapshot::DefaultPath())) {
+            LOG_AT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: Could not save the session snapshot");
+        }
+    }
+
+    if (!showKeys.empty() && !history.Save(ShowHistory::DefaultPath())) {
+        LOG_AT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: Could not save the show history");
+    }
+    if (tracing) {
+        if (trace.Save(settings.tracePath)) {
+            LOG_FMT(LogLevel::Info, LogCategory::General, L"WebView2Mode: Wrote {} trace events to {}", trace.events.size(), settings.tracePath);
+        } else {
+            LOG_FMT(LogLevel::Warn, LogCategory::General, L"WebView2Mode: Could not write the trace {}", settings.tracePath);
+        }
+    }
     if (needUninit) CoUninitialize();
     // Ensure hooks are removed on exit
-    UninstallLowLevelHooks(s);
-    // Remove accelerator registration if present
-    RemoveAcceleratorIfAny(s);
-    // Remove download handler if present
-    RemoveDownloadHandlerIfAny(s);
+    UninstallLowLevelHooks();
+    for (auto& state : states) {
+        // Remove accelerator registration if present
+        RemoveAcceleratorIfAny(*state);
+        // Remove download and resource handlers if present
+        RemoveDownloadHandlerIfAny(*state);
+        RemoveResourceHandlerIfAny(*state);
+    }
     return 0;
 }
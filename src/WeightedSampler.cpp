@@ -0,0 +1,90 @@
+// WeightedSampler.cpp - power-of-two bucketed weighted sampling
+#include "WeightedSampler.h"
+
+#include <bit>
+#include <cmath>
+
+uint64_t WeightedSampler::ToFixed(double weight)
+{
+    if (!(weight > 0)) return 0;
+    const double scaled = std::round(weight * kUnit);
+    if (scaled >= static_cast<double>(kMaxFixed)) return kMaxFixed;
+    // Tiny positive weights stay drawable
+    return scaled < 1 ? 1 : static_cast<uint64_t>(scaled);
+}
+
+void WeightedSampler::Assign(const std::vector<double>& weights)
+{
+    weights_.assign(weights.size(), 0);
+    slots_.assign(weights.size(), 0);
+    for (auto& bucket : buckets_) bucket.clear();
+    levelTotals_.fill(0);
+    levelMask_ = 0;
+    total_ = 0;
+    for (size_t i = 0; i < weights.size(); ++i) Insert(static_cast<uint32_t>(i), ToFixed(weights[i]));
+}
+
+void WeightedSampler::Set(size_t item, double weight)
+{
+    const uint64_t fixed = ToFixed(weight);
+    if (fixed == weights_[item]) return;
+    Remove(static_cast<uint32_t>(item));
+    Insert(static_cast<uint32_t>(item), fixed);
+}
+
+double WeightedSampler::Weight(size_t item) const
+{
+    return static_cast<double>(weights_[item]) / kUnit;
+}
+
+void WeightedSampler::Insert(uint32_t item, uint64_t fixed)
+{
+    weights_[item] = fixed;
+    if (fixed == 0) return;
+    const int level = std::bit_width(fixed) - 1;
+    std::vector<Slot>& bucket = buckets_[level];
+    slots_[item] = static_cast<uint32_t>(bucket.size());
+    bucket.push_back({ fixed, item });
+    levelTotals_[level] += fixed;
+    levelMask_ |= uint64_t(1) << level;
+    total_ += fixed;
+}
+
+void WeightedSampler::Remove(uint32_t item)
+{
+    const uint64_t fixed = weights_[item];
+    if (fixed == 0) return;
+    const int level = std::bit_width(fixed) - 1;
+    std::vector<Slot>& bucket = buckets_[level];
+    // Swap with the last item of the bucket so removal is O(1)
+    const Slot last = bucket.back();
+    bucket[slots_[item]] = last;
+    slots_[last.item] = slots_[item];
+    bucket.pop_back();
+    levelTotals_[level] -= fixed;
+    if (bucket.empty()) levelMask_ &= ~(uint64_t(1) << level);
+    total_ -= fixed;
+    weights_[item] = 0;
+}
+
+size_t WeightedSampler::Draw(std::mt19937_64& rng) const
+{
+    if (total_ == 0) return npos;
+    // Pick a level in proportion to its total; modulo bias is negligible against 2^64
+    uint64_t r = rng() % total_;
+    int level = 0;
+    for (uint64_t mask = levelMask_; mask; mask &= mask - 1) {
+        level = std::countr_zero(mask);
+        if (r < levelTotals_[level]) break;
+        r -= levelTotals_[level];
+    }
+    // Weights in the level lie in [2^level, 2^(level+1)), so each try succeeds with p >= 1/2
+    const std::vector<Slot>& bucket = buckets_[level];
+    for (;;) {
+        // The high half of a 32 x 32 bit product picks the slot without a division
+        const uint64_t bits = rng();
+        const Slot& slot = bucket[((bits >> 32) * bucket.size()) >> 32];
+        const uint64_t ceiling = rng() >> (63 - level);             // uniform in [0, 2^(level+1))
+        if (ceiling < slot.fixed) return slot.item;
+    }
+}
@@ -0,0 +1,198 @@
+// WorkerPool.cpp - work-stealing worker threads with a display and a background lane
+
+#include "WorkerPool.h"
+#include "Metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool and index of the worker running on this thread, so jobs submitted from a job stay
+// on their worker's deque
+thread_local const WorkerPool* t_pool = nullptr;
+thread_local size_t t_worker = 0;
+
+} // namespace
+
+WorkerPool::WorkerPool(unsigned threadCount)
+    : queueDepth_(Metrics::Instance().GetGauge("hdr_worker_queue_depth", "Jobs waiting for a worker thread")),
+      stealsTotal_(Metrics::Instance().GetCounter("hdr_worker_steals_total", "Jobs a worker took from another worker's deque")),
+      cancelledTotal_(Metrics::Instance().GetCounter("hdr_worker_jobs_cancelled_total", "Jobs dropped because they were cancelled before they ran"))
+{
+    if (threadCount == 0) threadCount = std::max(2u, std::thread::hardware_concurrency());
+    workers_.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) workers_.push_back(std::make_unique<Worker>());
+    threads_.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) threads_.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_) t.join();
+    queueDepth_.Add(-static_cast<int64_t>(queued_.load()));
+}
+
+void WorkerPool::Submit(Clock::time_point deadline, std::function<void()> job)
+{
+    Submit(WorkerLane::Display, deadline, std::move(job));
+}
+
+void WorkerPool::Submit(WorkerLane lane, Clock::time_point deadline, std::function<void()> job, const std::atomic<bool>* cancel)
+{
+    const size_t l = static_cast<size_t>(lane);
+    Job entry{ deadline, nextSequence_.fetch_add(1, std::memory_order_relaxed), std::move(job), cancel };
+    unfinished_.fetch_add(1);
+    // Counted before the job is visible, so a worker that takes it never decrements queued_
+    // below zero. A worker that sees the count first retries until the push lands.
+    queued_.fetch_add(1);
+    queueDepth_.Add(1);
+    if (t_pool == this && deadline == kNoDeadline) {
+        Worker& worker = *workers_[t_worker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs[l].push_back(std::move(entry));
+    } else {
+        std::lock_guard<std::mutex> lock(lanes_[l].mutex);
+        lanes_[l].queue.push(std::move(entry));
+    }
+    // queued_ and sleeping_ are sequentially consistent: either this sees the sleeper, or the
+    // sleeper sees the job before it waits. The empty lock section orders the notify after a
+    // sleeper that was between its check and its wait.
+    if (sleeping_.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex_); }
+        wake_.notify_one();
+    }
+}
+
+void WorkerPool::RunShared(unsigned helpers, const std::function<void()>& work)
+{
+    // Jobs hold the shared state, not the work, which lives only until this returns
+    struct Shared {
+        std::mutex mutex;
+        std::condition_variable done;
+        const std::function<void()>* work = nullptr;
+        unsigned running = 0;
+        bool closed = false;
+    };
+    auto shared = std::make_shared<Shared>();
+    shared->work = &work;
+    const Clock::time_point deadline = t_pool == this ? kNoDeadline : Clock::now();
+    for (unsigned h = 0; h < helpers; ++h) {
+        Submit(WorkerLane::Display, deadline, [shared] {
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                if (shared->closed) return;
+                ++shared->running;
+            }
+            (*shared->work)();
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (--shared->running == 0) shared->done.notify_all();
+        });
+    }
+    work();
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->closed = true;
+    shared->done.wait(lock, [&] { return shared->running == 0; });
+}
+
+void WorkerPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    idle_.wait(lock, [this] { return unfinished_.load() == 0; });
+}
+
+size_t WorkerPool::QueueDepth() const
+{
+    return queued_.load(std::memory_order_relaxed);
+}
+
+uint64_t WorkerPool::Steals() const
+{
+    return steals_.load(std::memory_order_relaxed);
+}
+
+uint64_t WorkerPool::CancelledJobs() const
+{
+    return cancelledJobs_.load(std::memory_order_relaxed);
+}
+
+bool WorkerPool::TakeJob(size_t index, Job& job)
+{
+    if (queued_.load(std::memory_order_relaxed) == 0) return false;
+    const size_t count = workers_.size();
+    for (size_t l = 0; l < kLanes; ++l) {
+        {
+            Worker& own = *workers_[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs[l].empty()) {
+                job = std::move(own.jobs[l].back());
+                own.jobs[l].pop_back();
+                break;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(lanes_[l].mutex);
+            if (!lanes_[l].queue.empty()) {
+                // priority_queue::top is const; the job is moved out right before pop
+                job = std::move(const_cast<Job&>(lanes_[l].queue.top()));
+                lanes_[l].queue.pop();
+                break;
+            }
+        }
+        bool stolen = false;
+        for (size_t k = 1; k < count && !stolen; ++k) {
+            Worker& victim = *workers_[(index + k) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs[l].empty()) {
+                job = std::move(victim.jobs[l].front());
+                victim.jobs[l].pop_front();
+                stolen = true;
+            }
+        }
+        if (stolen) {
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            stealsTotal_.Add();
+            break;
+        }
+        if (l + 1 == kLanes) return false;
+    }
+    queued_.fetch_sub(1);
+    queueDepth_.Add(-1);
+    return true;
+}
+
+void WorkerPool::Finish()
+{
+    if (unfinished_.fetch_sub(1) == 1) {
+        { std::lock_guard<std::mutex> lock(sleepMutex_); }
+        idle_.notify_all();
+    }
+}
+
+void WorkerPool::WorkerLoop(size_t index)
+{
+    t_pool = this;
+    t_worker = index;
+    while (!stop_.load(std::memory_order_relaxed)) {
+        Job job;
+        if (TakeJob(index, job)) {
+            if (job.cancel && job.cancel->load(std::memory_order_relaxed)) {
+                cancelledJobs_.fetch_add(1, std::memory_order_relaxed);
+                cancelledTotal_.Add();
+            } else {
+                job.run();
+            }
+            job.run = nullptr;    // release what the job holds before WaitIdle can return
+            Finish();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleeping_.fetch_add(1);
+        wake_.wait(lock, [this] { return stop_.load() || queued_.load() > 0; });
+        sleeping_.fetch_sub(1);
+    }
+}
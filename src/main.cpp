@@ -10,6 +10,7 @@
 
 // Project includes
 #include "Logger.h"
+#include "Metrics.h"
 #include "SettingsDialog.h"
 #include "WebView2Mode.h"
 
@@ -111,18 +112,36 @@ static void ShowHelpMessage() {
     helpMessage += L"  HDRScreenSaver.scr /x          - Standalone mode (for testing)\n\n";
     helpMessage += L"Options:\n";
     helpMessage += L"  /r                             - Enable random order\n";
-    helpMessage += L"  /f <path>                      - Override image folder path\n\n";
+    helpMessage += L"  /f <path>                      - Override image folder path\n";
+    helpMessage += L"  /q <query>                     - Playlist query, e.g. \"hdr headroom>=2 date:2023 sort:date\"\n";
+    helpMessage += L"  /t <file>                      - Record a navigation trace for hdrreplay\n\n";
     helpMessage += L"Examples:\n";
     helpMessage += L"  HDRScreenSaver.scr /x          - Run in standalone mode\n";
     helpMessage += L"  HDRScreenSaver.scr /s /r       - Run screensaver with random order\n";
-    helpMessage += L"  HDRScreenSaver.scr /x /f \"C:\\Photos\" - Run with custom folder\n\n";
+    helpMessage += L"  HDRScreenSaver.scr /x /f \"C:\\Photos\" - Run with custom folder\n";
+    helpMessage += L"  HDRScreenSaver.scr /x /q \"folder:Trips sort:-date\" - Newest trip photos first\n\n";
     helpMessage += L"For more information, see the README.md file.";
     MessageBoxW(nullptr, helpMessage.c_str(), L"HDRScreenSaver - Help", MB_OK | MB_ICONINFORMATION);
 }
 
+// Writes periodic metrics snapshots while the slideshow runs (off unless MetricsTarget is set).
+struct MetricsExport {
+    explicit MetricsExport(const ScreenSaverSettings& settings) {
+        MetricsExportConfig config;
+        config.target = settings.metricsTarget;
+        config.format = static_cast<MetricsFormat>(settings.metricsFormat);
+        config.intervalSeconds = settings.metricsIntervalSeconds;
+        Metrics::Instance().StartExporter(config);
+    }
+    ~MetricsExport() { Metrics::Instance().StopExporter(); }
+};
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int x) {
     // Register signal handler for Ctrl+C
     std::signal(SIGINT, SignalHandler);
+    // Without an attached console (GUI subsystem) console logging is wasted work
+    HANDLE hStdOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    Logger::Instance().SetConsoleEnabled(hStdOut != nullptr && hStdOut != INVALID_HANDLE_VALUE);
     LOG_MSG(L"HDRScreenSaver starting. Command line: '", ToWString(lpCmdLine), L"'");
 
     // Initialize COM so we can use WIC (Windows Imaging Component) for color space conversions.
@@ -137,6 +156,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int x) {
     std::wstring imagePathOverride;
     bool randomizeOrderOverride = false;
     std::wstring imageFolderOverride;
+    std::wstring playlistQueryOverride;
+    std::wstring tracePathOverride;
     {
         int argc = 0;
         LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
@@ -200,6 +221,34 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int x) {
                     return 1;
                 }
                 LOG_MSG(L"Command line flag -f detected: overriding image folder to: " + imageFolderOverride);
+            } else if (arg.substr(0, 2) == L"-q" || arg.substr(0, 2) == L"/q") {
+                // Playlist query: -q "query" or /q "query" (see CatalogTable.h for the syntax)
+                if (arg.length() > 2 && arg[2] == L'=') {
+                    playlistQueryOverride = arg.substr(3);
+                } else if (i + 1 < argc) {
+                    playlistQueryOverride = argv[i + 1];
+                    i++;
+                } else {
+                    LOG_MSG(L"Error: -q flag requires a query");
+                    MessageBoxW(nullptr, L"Error: -q flag requires a query", L"HDRScreenSaver - Error", MB_OK | MB_ICONERROR);
+                    LocalFree(argv);
+                    return 1;
+                }
+                LOG_MSG(L"Command line flag -q detected: playlist query: " + playlistQueryOverride);
+            } else if (arg.substr(0, 2) == L"-t" || arg.substr(0, 2) == L"/t") {
+                // Navigation trace: -t "file" or /t "file", replayed with tools/hdrreplay
+                if (arg.length() > 2 && arg[2] == L'=') {
+                    tracePathOverride = arg.substr(3);
+                } else if (i + 1 < argc) {
+                    tracePathOverride = argv[i + 1];
+                    i++;
+                } else {
+                    LOG_MSG(L"Error: -t flag requires a file path");
+                    MessageBoxW(nullptr, L"Error: -t flag requires a file path", L"HDRScreenSaver - Error", MB_OK | MB_ICONERROR);
+                    LocalFree(argv);
+                    return 1;
+                }
+                LOG_MSG(L"Command line flag -t detected: recording a trace to: " + tracePathOverride);
             }
         }
 
@@ -218,13 +267,22 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int x) {
         settings.imageFolder = imageFolderOverride;
         LOG_MSG(L"Command line override: image folder set to: " + settings.imageFolder);
     }
+    if (!playlistQueryOverride.empty()) {
+        settings.playlistQuery = playlistQueryOverride;
+        LOG_MSG(L"Command line override: playlist query set to: " + settings.playlistQuery);
+    }
+    if (!tracePathOverride.empty()) {
+        settings.tracePath = tracePathOverride;
+        LOG_MSG(L"Command line override: trace path set to: " + settings.tracePath);
+    }
 
     // If Open With supplied an image path, remember it and request no auto-advance.
     if (!imagePathOverride.empty()) {
         LOG_MSG(L"Open-with image path detected: " + imagePathOverride);
     }
 
-    Logger::Instance().Configure(settings.logEnabled, settings.logPath);
+    Logger::Instance().SetLevel(static_cast<LogLevel>(settings.logLevel));
+    Logger::Instance().Configure(settings.logEnabled, settings.logPath, settings.logBinary);
 
     // --- Determine mode: screensaver, preview, or standalone ---
     switch (mode) {
@@ -248,11 +306,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int x) {
 
         case L's': {
             LOG_MSG(L"Screensaver mode requested.");
+            MetricsExport metricsExport(settings);
             return RunWebView2Mode(true /*shutdownOnAnyUnhandledInput*/, settings);
         }
 
         case L'x': {
             LOG_MSG(L"Standalone mode requested.");
+            MetricsExport metricsExport(settings);
             // If an image path was passed (Open With), show that image but keep navigation in the same folder.
             // Also disable automatic advancing when launched via Open With.
             const bool disableAutoAdvance = !imagePathOverride.empty();
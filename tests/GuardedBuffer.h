@@ -0,0 +1,65 @@
+// GuardedBuffer.h - test data that ends where an inaccessible page begins, so a parser that
+// reads past the end crashes the test even without a sanitizer
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Memory followed by a page that faults when touched
+class GuardedBuffer {
+public:
+    explicit GuardedBuffer(size_t capacity) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_ = info.dwPageSize;
+#else
+        page_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        usable_ = (capacity + page_ - 1) / page_ * page_;
+#ifdef _WIN32
+        base_ = static_cast<uint8_t*>(VirtualAlloc(nullptr, usable_ + page_, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        DWORD previous;
+        if (base_) VirtualProtect(base_ + usable_, page_, PAGE_NOACCESS, &previous);
+#else
+        void* memory = mmap(nullptr, usable_ + page_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        base_ = memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(memory);
+        if (base_) mprotect(base_ + usable_, page_, PROT_NONE);
+#endif
+    }
+    ~GuardedBuffer() {
+#ifdef _WIN32
+        if (base_) VirtualFree(base_, 0, MEM_RELEASE);
+#else
+        if (base_) munmap(base_, usable_ + page_);
+#endif
+    }
+    GuardedBuffer(const GuardedBuffer&) = delete;
+    GuardedBuffer& operator=(const GuardedBuffer&) = delete;
+
+    bool Valid() const { return base_ != nullptr; }
+    size_t Capacity() const { return usable_; }
+
+    // Copies `size` bytes so they end at the guard page; returns where they start
+    uint8_t* Place(const uint8_t* data, size_t size) {
+        uint8_t* start = base_ + usable_ - size;
+        if (size) std::memcpy(start, data, size);
+        return start;
+    }
+
+private:
+    size_t page_ = 4096;
+    size_t usable_ = 0;
+    uint8_t* base_ = nullptr;
+};
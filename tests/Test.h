@@ -0,0 +1,69 @@
+// Test.h - minimal test registry used by hdrtest
+//
+// A test checks its results with HDR_CHECK and HDR_CHECK_LE. A failed check is reported with
+// its file and line and fails the test, which keeps running, so one run shows every failed check.
+//
+//   HDR_TEST("catalog/query/bad-number") {
+//       CatalogQuery query;
+//       HDR_CHECK(!CatalogQuery::Parse(L"width>=1e20", query));
+//   }
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TestState {
+public:
+    bool Check(bool ok, const char* expression, const char* file, int line) {
+        if (!ok) Fail(file, line, expression);
+        return ok;
+    }
+    bool CheckLessEqual(double value, double bound, const char* expression, const char* file, int line) {
+        if (value <= bound) return true;
+        char detail[96];
+        std::snprintf(detail, sizeof(detail), " (%.4g > %.4g)", value, bound);
+        Fail(file, line, std::string(expression) + detail);
+        return false;
+    }
+    // Context printed with the failures that follow (the case or input being checked)
+    void SetContext(std::string context) { context_ = std::move(context); }
+
+    bool Failed() const { return failures_ > 0; }
+
+private:
+    void Fail(const char* file, int line, const std::string& what) {
+        ++failures_;
+        std::fprintf(stderr, "  %s:%d: check failed: %s%s%s\n", std::filesystem::path(file).filename().string().c_str(), line, what.c_str(),
+                     context_.empty() ? "" : " in ", context_.c_str());
+    }
+
+    int failures_ = 0;
+    std::string context_;
+};
+
+using TestFunction = std::function<void(TestState&)>;
+
+struct TestCase {
+    std::string name;
+    TestFunction run;
+};
+
+std::vector<TestCase>& TestRegistry();
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, TestFunction run) { TestRegistry().push_back({ name, std::move(run) }); }
+};
+
+#define HDR_TEST_CONCAT2(a, b) a##b
+#define HDR_TEST_CONCAT(a, b) HDR_TEST_CONCAT2(a, b)
+#define HDR_TEST(name) \
+    static void HDR_TEST_CONCAT(HdrTest_, __LINE__)(TestState& test); \
+    static TestRegistrar HDR_TEST_CONCAT(hdrTestRegistrar_, __LINE__)(name, HDR_TEST_CONCAT(HdrTest_, __LINE__)); \
+    static void HDR_TEST_CONCAT(HdrTest_, __LINE__)(TestState& test)
+
+#define HDR_CHECK(condition) test.Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+#define HDR_CHECK_LE(value, bound) test.CheckLessEqual(static_cast<double>(value), static_cast<double>(bound), #value " <= " #bound, __FILE__, __LINE__)
@@ -0,0 +1,216 @@
+// TestCacheFiles.cpp - the cache files (session snapshot, catalog index, rendition manifest, input
+// trace) read
+// back damaged: Load returns false (or what it could read) instead of throwing or running past
+// the data
+
+#include "Test.h"
+#include "BinaryFileUtils.h"
+#include "CatalogIndex.h"
+#include "InputTrace.h"
+#include "Rendition.h"
+#include "SessionSnapshot.h"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> ReadAll(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void WriteAll(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+SessionSnapshot SampleSnapshot()
+{
+    SessionSnapshot snapshot;
+    snapshot.folder = L"/photos/2024";
+    snapshot.playlistQuery = L"hdr width>=3000";
+    snapshot.randomOrder = true;
+    for (size_t i = 0; i < 3; ++i) {
+        SnapshotSlide slide;
+        slide.output = i % 2;
+        slide.entry.path = L"/photos/2024/slide " + std::to_wstring(i) + L".jpg";
+        slide.entry.fileSize = 1000 + i;
+        slide.entry.modified = 1700000000 + static_cast<int64_t>(i);
+        auto data = std::make_shared<ImageData>();
+        data->bytes.assign(64, static_cast<uint8_t>(i));
+        slide.data = std::move(data);
+        snapshot.slides.push_back(std::move(slide));
+    }
+    return snapshot;
+}
+
+} // namespace
+
+HDR_TEST("cachefiles/utf8")
+{
+    std::wstring text;
+    HDR_CHECK(WideFromUtf8("", text) && text.empty());
+    HDR_CHECK(WideFromUtf8("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80", text));
+    HDR_CHECK(text == L"caf\u00E9 \u20AC \U0001F600");
+    HDR_CHECK(!WideFromUtf8("\xFF", text));
+    HDR_CHECK(!WideFromUtf8("caf\xC3", text));                 // cut short
+    HDR_CHECK(!WideFromUtf8("\xC0\xAF", text));                // overlong '/'
+    HDR_CHECK(!WideFromUtf8("\xE0\x80\xAF", text));
+    HDR_CHECK(!WideFromUtf8("\xED\xA0\x80", text));            // surrogate
+    HDR_CHECK(!WideFromUtf8("\xF4\x90\x80\x80", text));        // past U+10FFFF
+    HDR_CHECK(!WideFromUtf8("\xE2\x28\xA1", text));            // bad continuation byte
+}
+
+// Every byte of a snapshot set to 0xFF and flipped in its top bit in turn
+HDR_TEST("cachefiles/snapshot-damaged")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "hdrtest-snapshot.bin";
+    const SessionSnapshot original = SampleSnapshot();
+    if (!HDR_CHECK(original.Save(path))) return;
+    const std::vector<uint8_t> bytes = ReadAll(path);
+    SessionSnapshot loaded;
+    HDR_CHECK(loaded.Load(path));
+    HDR_CHECK(loaded.folder == original.folder && loaded.slides.size() == original.slides.size());
+
+    size_t thrown = 0, rejected = 0;
+    for (size_t i = 8; i < bytes.size(); ++i) {
+        for (uint8_t value : { uint8_t(0xFF), uint8_t(bytes[i] ^ 0x80) }) {
+            std::vector<uint8_t> damaged = bytes;
+            damaged[i] = value;
+            WriteAll(path, damaged);
+            try {
+                if (!loaded.Load(path)) {
+                    ++rejected;
+                    HDR_CHECK(loaded.slides.empty() && loaded.folder.empty());
+                }
+            } catch (...) {
+                if (thrown++ == 0) {
+                    test.SetContext("byte " + std::to_string(i) + " = " + std::to_string(value));
+                    HDR_CHECK(thrown == 0);
+                }
+            }
+        }
+    }
+    test.SetContext("");
+    HDR_CHECK(thrown == 0);
+    // The folder's first byte is the length; the next is text, which 0xFF makes invalid UTF-8
+    HDR_CHECK(rejected > 0);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+// A damaged path byte in the catalog index fails the load, which then rescans the library
+HDR_TEST("cachefiles/index-damaged")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "hdrtest-index.tsv";
+    CatalogIndex index;
+    index.SetRoot(L"/photos", true);
+    index.SetFolders({ { L"/photos", 1700000000 }, { L"/photos/2024", 1700000001 } });
+    for (int i = 0; i < 3; ++i) {
+        CatalogIndexEntry entry;
+        entry.path = L"/photos/2024/img" + std::to_wstring(i) + L".jpg";
+        entry.fileSize = 1000;
+        entry.container = ImageContainer::Jpeg;
+        entry.renderability = Renderability::Displays;
+        index.Add(std::move(entry));
+    }
+    if (!HDR_CHECK(index.Save(path))) return;
+    const std::vector<uint8_t> bytes = ReadAll(path);
+    CatalogIndex loaded;
+    HDR_CHECK(loaded.Load(path) && loaded.Entries().size() == 3 && loaded.Folders().size() == 2);
+
+    size_t thrown = 0, rejected = 0, separators = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        if (bytes[i] != '/') continue;    // a separator of one of the paths
+        ++separators;
+        std::vector<uint8_t> damaged = bytes;
+        damaged[i] = 0xFF;
+        WriteAll(path, damaged);
+        try {
+            if (!loaded.Load(path)) ++rejected;
+            HDR_CHECK(loaded.Root().empty() == loaded.Entries().empty());
+        } catch (...) {
+            ++thrown;
+        }
+    }
+    HDR_CHECK(thrown == 0);
+    HDR_CHECK(separators > 0 && rejected == separators);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+HDR_TEST("cachefiles/rendition-manifest-damaged")
+{
+    const std::filesystem::path mirror = std::filesystem::temp_directory_path() / "hdrtest-renditions";
+    RenditionStore store(L"/photos", mirror);
+    RenditionRecord record;
+    record.status = RenditionStatus::Baked;
+    record.renditionSize = 5000;
+    store.Set(L"/photos/2024/img.jpg", record);
+    if (!HDR_CHECK(store.Save())) return;
+    const std::filesystem::path manifest = mirror / RenditionStore::kManifestName;
+    const std::vector<uint8_t> bytes = ReadAll(manifest);
+    HDR_CHECK(store.Load() && store.Find(L"/photos/2024/img.jpg"));
+
+    std::vector<uint8_t> damaged = bytes;
+    damaged[damaged.size() - 6] = 0xC0;    // "img.jpg": an overlong form in place of the '.'
+    WriteAll(manifest, damaged);
+    try {
+        HDR_CHECK(!store.Load());
+        HDR_CHECK(!store.Find(L"/photos/2024/img.jpg"));
+    } catch (...) {
+        HDR_CHECK(!"Load threw");
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(mirror, ec);
+}
+
+// Event times are delta coded; deltas that add up past the longest possible session fail the load
+// rather than overflow
+HDR_TEST("cachefiles/trace-damaged")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "hdrtest-trace.bin";
+    InputTrace trace;
+    trace.root = L"/photos";
+    trace.outputs.resize(1);
+    for (int i = 0; i < 4; ++i) trace.events.push_back({ std::chrono::microseconds(1000 * i), TraceEventKind::Next, 0, static_cast<uint64_t>(i) });
+    InputTrace loaded;
+    if (!HDR_CHECK(trace.Save(path))) return;
+    HDR_CHECK(loaded.Load(path) && loaded.events.size() == 4 && loaded.events.back().time == std::chrono::microseconds(3000));
+
+    trace.events[2].time = std::chrono::microseconds(INT64_MAX - 10);    // one huge delta
+    trace.events[3].time = std::chrono::microseconds(20);                // and one that wraps back
+    HDR_CHECK(trace.Save(path));
+    HDR_CHECK(!loaded.Load(path) && loaded.events.empty());
+
+    // Every byte set to 0xFF and flipped in its top bit in turn
+    trace.events[2].time = std::chrono::microseconds(2000);
+    trace.events[3].time = std::chrono::microseconds(3000);
+    HDR_CHECK(trace.Save(path));
+    const std::vector<uint8_t> bytes = ReadAll(path);
+    size_t thrown = 0;
+    for (size_t i = 8; i < bytes.size(); ++i) {
+        for (uint8_t value : { uint8_t(0xFF), uint8_t(bytes[i] ^ 0x80) }) {
+            std::vector<uint8_t> damaged = bytes;
+            damaged[i] = value;
+            WriteAll(path, damaged);
+            try {
+                if (loaded.Load(path)) {
+                    for (const TraceEvent& event : loaded.events) HDR_CHECK(event.time.count() >= 0);
+                }
+            } catch (...) {
+                ++thrown;
+            }
+        }
+    }
+    HDR_CHECK(thrown == 0);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
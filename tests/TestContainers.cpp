@@ -0,0 +1,186 @@
+// TestContainers.cpp - header probing of AVIF, HEIF, JPEG XL, PNG and JPEG (with and without an
+// MPF gain map directory) files cut short and with damaged bytes: every probe either rejects the
+// file or reports its dimensions, and none reads past the end of the data
+//
+// The data is placed in a GuardedBuffer, so a read past it crashes the test even without a
+// sanitizer.
+
+#include "Test.h"
+#include "GuardedBuffer.h"
+#include "ImageProbe.h"
+#include "JpegFile.h"
+#include "SyntheticImages.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kWidth = 640;
+const int kHeight = 427;
+// Largest dimension a probe may report for a damaged file; JPEG XL allows up to 2^30
+const int kMaxDimension = 1 << 30;
+
+struct ContainerCase {
+    std::string name;
+    ImageContainer container;
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<uint8_t> Build(SyntheticKind kind)
+{
+    SyntheticImageOptions options;
+    options.width = kWidth;
+    options.height = kHeight;
+    SyntheticImage image;
+    if (!BuildSyntheticImage(kind, options, image)) return {};
+    return image.bytes;
+}
+
+// The synthetic AVIF, JPEG XL, PNG and JPEG files, the AVIF relabeled as HEIF, and the JPEG XL
+// codestream without its container
+const std::vector<ContainerCase>& Cases()
+{
+    static const std::vector<ContainerCase> cases = [] {
+        std::vector<ContainerCase> list;
+        list.push_back({ "avif", ImageContainer::Avif, Build(SyntheticKind::Avif) });
+        ContainerCase heif{ "heif", ImageContainer::Heif, list.back().bytes };
+        // ftyp: major brand at 8, compatible brands from 16 to the end of the box
+        const size_t ftypEnd = std::min<size_t>(heif.bytes.size(), (size_t(heif.bytes[2]) << 8) | heif.bytes[3]);
+        for (size_t at = 8; at + 4 <= ftypEnd; at += at == 8 ? 8 : 4) {
+            if (std::memcmp(heif.bytes.data() + at, "avif", 4) == 0) std::memcpy(heif.bytes.data() + at, "heic", 4);
+        }
+        list.push_back(std::move(heif));
+        list.push_back({ "jxl", ImageContainer::Jxl, Build(SyntheticKind::Jxl) });
+        // Signature box (12 bytes), ftyp box (20), then the jxlc box header (8)
+        const std::vector<uint8_t>& container = list.back().bytes;
+        if (container.size() > 40) list.push_back({ "jxl-codestream", ImageContainer::Jxl, std::vector<uint8_t>(container.begin() + 40, container.end()) });
+        list.push_back({ "png", ImageContainer::Png, Build(SyntheticKind::Png) });
+        list.push_back({ "pq-png", ImageContainer::Png, Build(SyntheticKind::PqPng) });
+        list.push_back({ "jpeg", ImageContainer::Jpeg, Build(SyntheticKind::Jpeg) });
+        list.push_back({ "ultrahdr", ImageContainer::Jpeg, Build(SyntheticKind::UltraHdr) });
+        return list;
+    }();
+    return cases;
+}
+
+// Rejected (no dimensions) or within bounds, never one dimension without the other
+bool Sane(const ImageProbe& probe)
+{
+    if (probe.width == 0 || probe.height == 0) return probe.width == 0 && probe.height == 0;
+    return probe.width > 0 && probe.height > 0 && probe.width <= kMaxDimension && probe.height <= kMaxDimension;
+}
+
+} // namespace
+
+HDR_TEST("containers/intact")
+{
+    for (const ContainerCase& c : Cases()) {
+        test.SetContext(c.name);
+        if (!HDR_CHECK(!c.bytes.empty())) continue;
+        GuardedBuffer buffer(c.bytes.size());
+        if (!HDR_CHECK(buffer.Valid())) return;
+        ImageProbe probe;
+        ProbeImageData(buffer.Place(c.bytes.data(), c.bytes.size()), c.bytes.size(), probe);
+        HDR_CHECK(probe.container == c.container);
+        HDR_CHECK(probe.width == kWidth);
+        HDR_CHECK(probe.height == kHeight);
+        HDR_CHECK(probe.renderability != Renderability::Broken);
+    }
+}
+
+// Every length of the headers, then of the rest in steps: the dimensions are the real ones or none
+HDR_TEST("containers/truncated")
+{
+    for (const ContainerCase& c : Cases()) {
+        GuardedBuffer buffer(c.bytes.size());
+        if (!HDR_CHECK(buffer.Valid())) return;
+        size_t bad = 0;
+        for (size_t cut = 0; cut < c.bytes.size(); cut += cut < 4096 ? 1 : 509) {
+            ImageProbe probe;
+            ProbeImageData(buffer.Place(c.bytes.data(), cut), cut, probe);
+            const bool ok = (probe.width == 0 && probe.height == 0) || (probe.width == kWidth && probe.height == kHeight);
+            if (!ok && bad++ == 0) {
+                test.SetContext(c.name + " cut at " + std::to_string(cut) + ", probed " + std::to_string(probe.width) + "x" + std::to_string(probe.height));
+                HDR_CHECK(ok);
+            }
+        }
+        test.SetContext(c.name);
+        HDR_CHECK(bad == 0);
+    }
+}
+
+// Each header byte set to 0x00, 0xFF and flipped in its top bit in turn
+HDR_TEST("containers/mutated")
+{
+    for (const ContainerCase& c : Cases()) {
+        GuardedBuffer buffer(c.bytes.size());
+        if (!HDR_CHECK(buffer.Valid())) return;
+        uint8_t* data = buffer.Place(c.bytes.data(), c.bytes.size());
+        const size_t span = std::min<size_t>(c.bytes.size(), 2048);
+        size_t bad = 0;
+        for (size_t i = 0; i < span; ++i) {
+            for (uint8_t value : { uint8_t(0x00), uint8_t(0xFF), uint8_t(c.bytes[i] ^ 0x80) }) {
+                data[i] = value;
+                ImageProbe probe;
+                ProbeImageData(data, c.bytes.size(), probe);
+                if (!Sane(probe) && bad++ == 0) {
+                    test.SetContext(c.name + " byte " + std::to_string(i) + " = " + std::to_string(value) + ", probed " + std::to_string(probe.width) + "x" +
+                                    std::to_string(probe.height));
+                    HDR_CHECK(Sane(probe));
+                }
+            }
+            data[i] = c.bytes[i];
+        }
+        test.SetContext(c.name);
+        HDR_CHECK(bad == 0);
+    }
+}
+
+// Every 32-bit word of the MPF segment set to offsets near and past 4 GB, in both byte orders:
+// the IFD offset, entry count and MP Entry offsets must not wrap the bounds checks
+HDR_TEST("containers/mpf-offsets")
+{
+    const ContainerCase* ultraHdr = nullptr;
+    for (const ContainerCase& c : Cases()) {
+        if (c.name == "ultrahdr") ultraHdr = &c;
+    }
+    if (!HDR_CHECK(ultraHdr && !ultraHdr->bytes.empty())) return;
+    const std::vector<uint8_t>& bytes = ultraHdr->bytes;
+    std::vector<JpegSegment> segments;
+    ReadJpegSegments(bytes.data(), bytes.size(), segments);
+    const JpegSegment* mpf = nullptr;
+    for (const JpegSegment& segment : segments) {
+        if (IsMpfSegment(bytes.data(), segment)) mpf = &segment;
+    }
+    if (!HDR_CHECK(mpf != nullptr)) return;
+    std::vector<MpfImage> images;
+    HDR_CHECK(ReadMpfImages(bytes.data(), bytes.size(), images) && images.size() == 2);
+
+    GuardedBuffer buffer(bytes.size());
+    if (!HDR_CHECK(buffer.Valid())) return;
+    uint8_t* data = buffer.Place(bytes.data(), bytes.size());
+    const size_t end = mpf->offset + mpf->length;
+    size_t bad = 0;
+    for (size_t at = mpf->PayloadOffset(); at + 4 <= end; ++at) {
+        for (uint32_t value : { 0xFFFFFFFFu, 0xFFFFFFFEu, 0xFFFFFFF8u, 0x80000000u, 0x7FFFFFFFu }) {
+            for (int i = 0; i < 4; ++i) data[at + i] = static_cast<uint8_t>(value >> (8 * i));
+            for (int order = 0; order < 2; ++order) {
+                ReadMpfImages(data, bytes.size(), images);
+                ImageProbe probe;
+                ProbeImageData(data, bytes.size(), probe);
+                const bool ok = Sane(probe) && images.size() <= 0xFFFF;
+                if (!ok && bad++ == 0) {
+                    test.SetContext("ultrahdr MPF byte " + std::to_string(at - mpf->offset) + " = " + std::to_string(value));
+                    HDR_CHECK(ok);
+                }
+                std::reverse(data + at, data + at + 4);
+            }
+        }
+        std::memcpy(data + at, bytes.data() + at, 4);
+    }
+    test.SetContext("ultrahdr");
+    HDR_CHECK(bad == 0);
+}
@@ -0,0 +1,55 @@
+// TestIdentity.cpp - file fingerprints agree whether the bytes come from memory, read-ahead
+// ranges or the file on disk, down to an empty file
+
+#include "Test.h"
+#include "FileIdentity.h"
+
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> Pattern(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    uint32_t state = 0x9E3779B9u;
+    for (uint8_t& b : bytes) {
+        state = state * 1664525u + 1013904223u;
+        b = static_cast<uint8_t>(state >> 24);
+    }
+    return bytes;
+}
+
+} // namespace
+
+HDR_TEST("identity/sources-agree")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "hdrtest-identity.bin";
+    // Empty, hashed whole, and sampled
+    for (size_t size : { size_t(0), size_t(1), size_t(40000), size_t(3u << 20) }) {
+        test.SetContext(std::to_string(size) + " bytes");
+        const std::vector<uint8_t> bytes = Pattern(size);
+        const ContentHash fromData = FingerprintData(size ? bytes.data() : nullptr, size);
+        HDR_CHECK(!fromData.Empty());
+
+        std::vector<ProbeRange> ranges;
+        for (const FileSpan& span : FingerprintSpans(size)) {
+            if (span.size) ranges.push_back({ span.offset, bytes.data() + span.offset, static_cast<size_t>(span.size) });
+        }
+        ContentHash fromRanges;
+        HDR_CHECK(FingerprintRanges(size, ranges, fromRanges));
+        HDR_CHECK(fromRanges == fromData);
+
+        {
+            std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+        ContentHash fromFile;
+        HDR_CHECK(FingerprintFile(path, size, fromFile));
+        HDR_CHECK(fromFile == fromData);
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
@@ -0,0 +1,118 @@
+// TestJpeg.cpp - the JPEG decoder on damaged headers: Huffman tables with more codes than their
+// lengths allow are rejected, and no damaged header byte makes the decoder read past the file
+
+#include "Test.h"
+#include "GuardedBuffer.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "SyntheticImages.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kWidth = 64;
+const int kHeight = 48;
+
+std::vector<uint8_t> SmallJpeg()
+{
+    SyntheticImageOptions options;
+    options.width = kWidth;
+    options.height = kHeight;
+    SyntheticImage image;
+    if (!BuildSyntheticImage(SyntheticKind::Jpeg, options, image)) return {};
+    return image.bytes;
+}
+
+// Offsets of the 16 code counts of every table in every DHT segment
+std::vector<size_t> HuffmanCountOffsets(const std::vector<uint8_t>& jpeg)
+{
+    std::vector<JpegSegment> segments;
+    ReadJpegSegments(jpeg.data(), jpeg.size(), segments);
+    std::vector<size_t> offsets;
+    for (const JpegSegment& segment : segments) {
+        if (segment.marker != 0xC4) continue;
+        size_t p = segment.PayloadOffset();
+        const size_t end = segment.offset + segment.length;
+        while (p + 17 <= end) {
+            offsets.push_back(p + 1);
+            size_t total = 0;
+            for (int i = 0; i < 16; ++i) total += jpeg[p + 1 + i];
+            p += 17 + total;
+        }
+    }
+    return offsets;
+}
+
+// Decodes from a copy placed in front of the guard page
+bool DecodeGuarded(const std::vector<uint8_t>& jpeg, GuardedBuffer& buffer, PlanarImage& image)
+{
+    const uint8_t* data = buffer.Place(jpeg.data(), jpeg.size());
+    return DecodeJpeg(data, jpeg.size(), image);
+}
+
+} // namespace
+
+HDR_TEST("jpeg/oversubscribed-huffman-table")
+{
+    const std::vector<uint8_t> jpeg = SmallJpeg();
+    if (!HDR_CHECK(!jpeg.empty())) return;
+    GuardedBuffer buffer(jpeg.size());
+    if (!HDR_CHECK(buffer.Valid())) return;
+    PlanarImage image;
+    if (!HDR_CHECK(DecodeGuarded(jpeg, buffer, image))) return;
+
+    const std::vector<size_t> tables = HuffmanCountOffsets(jpeg);
+    HDR_CHECK(tables.size() >= 2);
+    for (size_t t = 0; t < tables.size(); ++t) {
+        size_t total = 0;
+        for (int i = 0; i < 16; ++i) total += jpeg[tables[t] + i];
+        // The same symbols, all given codes of one short length: far more than 2^length of them
+        for (int length : { 1, 2, 5, 9 }) {
+            if (total <= (size_t(1) << length)) continue;
+            test.SetContext("table " + std::to_string(t) + ", " + std::to_string(total) + " codes of length " + std::to_string(length));
+            std::vector<uint8_t> damaged = jpeg;
+            for (int i = 0; i < 16; ++i) damaged[tables[t] + i] = 0;
+            damaged[tables[t] + length - 1] = static_cast<uint8_t>(total);
+            HDR_CHECK(!DecodeGuarded(damaged, buffer, image));
+        }
+    }
+}
+
+// Each header byte up to the scan set to 0x00, 0xFF and flipped in its top bit in turn: the
+// whole-image and the region decoder either fail or return a complete image, and neither hangs
+// nor reads past the file
+HDR_TEST("jpeg/mutated-headers")
+{
+    const std::vector<uint8_t> jpeg = SmallJpeg();
+    if (!HDR_CHECK(!jpeg.empty())) return;
+    std::vector<JpegSegment> segments;
+    HDR_CHECK(ReadJpegSegments(jpeg.data(), jpeg.size(), segments));
+    const size_t headerEnd = segments.empty() ? 0 : segments.back().offset + segments.back().length;
+    GuardedBuffer buffer(jpeg.size());
+    if (!HDR_CHECK(buffer.Valid())) return;
+    uint8_t* data = buffer.Place(jpeg.data(), jpeg.size());
+    auto complete = [](const PlanarImage& image) {
+        return image.width > 0 && image.height > 0 && image.channels >= 1 && image.channels <= 3 &&
+               image.planes[0].size() >= static_cast<size_t>(image.width) * image.height;
+    };
+    size_t bad = 0;
+    for (size_t i = 0; i < headerEnd; ++i) {
+        for (uint8_t value : { uint8_t(0x00), uint8_t(0xFF), uint8_t(jpeg[i] ^ 0x80) }) {
+            data[i] = value;
+            PlanarImage image, region;
+            const bool decoded = DecodeJpeg(data, jpeg.size(), image);
+            JpegRegionDecoder decoder;
+            const bool regionDecoded = decoder.Open(data, jpeg.size()) && decoder.DecodeRegion(0, 0, kWidth, kHeight, 0, region);
+            const bool ok = (!decoded || complete(image)) && (!regionDecoded || complete(region));
+            if (!ok && bad++ == 0) {
+                test.SetContext("byte " + std::to_string(i) + " = " + std::to_string(value));
+                HDR_CHECK(ok);
+            }
+        }
+        data[i] = jpeg[i];
+    }
+    test.SetContext("");
+    HDR_CHECK(bad == 0);
+}
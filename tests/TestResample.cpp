@@ -0,0 +1,155 @@
+// TestResample.cpp - the SIMD resampling kernels against the scalar reference, and each filter's
+// passband and stopband
+
+#include "Test.h"
+#include "ImageResize.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+const double kPi = 3.14159265358979;
+
+// Smooth shading with fine detail and highlights far above SDR white, as BenchResample uses
+HdrImage LinearPhoto(int width, int height)
+{
+    HdrImage im;
+    im.Allocate(width, height);
+    for (int y = 0; y < im.height; ++y) {
+        float* row = im.rgb.data() + static_cast<size_t>(y) * im.width * 3;
+        for (int x = 0; x < im.width; ++x) {
+            const float base = 0.4f + 0.3f * std::sin(x * 0.011f) * std::cos(y * 0.017f);
+            const float detail = ((x * 7 + y * 13) % 17) * 0.01f;
+            const float highlight = (x % 250 < 4 && y % 200 < 4) ? 8.0f : 0.0f;
+            row[x * 3] = base + detail + highlight;
+            row[x * 3 + 1] = base * 0.9f + highlight;
+            row[x * 3 + 2] = base * 0.7f + detail + highlight;
+        }
+    }
+    return im;
+}
+
+// Largest difference between the SIMD and the scalar kernels' output, relative to the peak
+double SimdDeviation(const HdrImage& src, int width, int height, ResampleFilter filter, int threads)
+{
+    ResampleOptions options;
+    options.filter = filter;
+    options.threads = threads;
+    WorkerPool pool;
+    options.pool = &pool;
+    HdrImage simd, scalar;
+    ResampleHdrImage(src, width, height, options, simd);
+    options.simd = false;
+    ResampleHdrImage(src, width, height, options, scalar);
+    if (simd.width != scalar.width || simd.height != scalar.height) return INFINITY;
+    double difference = 0, peak = 0;
+    for (size_t i = 0; i < simd.rgb.size(); ++i) {
+        difference = std::max(difference, static_cast<double>(std::fabs(simd.rgb[i] - scalar.rgb[i])));
+        peak = std::max(peak, static_cast<double>(scalar.rgb[i]));
+    }
+    return peak > 0 ? difference / peak : difference;
+}
+
+// Output amplitude of a horizontal sine of `period` source pixels, 6000 -> 3840 wide, relative
+// to the input's: 1 in the passband, 0 for frequencies the output cannot hold. The output's
+// Nyquist period is 2 * 6000 / 3840 = 3.125 source pixels.
+double Response(ResampleFilter filter, double period, bool simd)
+{
+    HdrImage src;
+    src.Allocate(6000, 4);
+    for (int y = 0; y < src.height; ++y) {
+        for (int x = 0; x < src.width; ++x) {
+            const float v = 1.0f + 0.5f * static_cast<float>(std::sin(2 * kPi * x / period));
+            for (int c = 0; c < 3; ++c) src.rgb[(static_cast<size_t>(y) * src.width + x) * 3 + c] = v;
+        }
+    }
+    ResampleOptions options;
+    options.filter = filter;
+    options.simd = simd;
+    HdrImage dst;
+    ResampleHdrImage(src, 3840, 4, options, dst);
+    double sum = 0;
+    const int margin = 16;    // away from the clamped edges
+    for (int x = margin; x < dst.width - margin; ++x) sum += (dst.rgb[static_cast<size_t>(x) * 3] - 1.0) * (dst.rgb[static_cast<size_t>(x) * 3] - 1.0);
+    return std::sqrt(sum / (dst.width - 2 * margin)) / (0.5 / std::sqrt(2.0));
+}
+
+struct FilterBounds {
+    ResampleFilter filter;
+    double passMin;         // response to a period of 16 source pixels
+    double alias;           // largest response to a period of 2.5 source pixels
+};
+
+// Measured 1.00 / 0.12, 0.98 / 0.17 and 0.97 / 0.22, with some room
+const FilterBounds kFilters[] = {
+    { ResampleFilter::Lanczos3, 0.98, 0.15 },
+    { ResampleFilter::Mitchell, 0.95, 0.20 },
+    { ResampleFilter::Bilinear, 0.94, 0.25 },
+};
+
+} // namespace
+
+HDR_TEST("resample/simd-matches-scalar")
+{
+    const HdrImage photo = LinearPhoto(1500, 1000);
+    for (const FilterBounds& bounds : kFilters) {
+        test.SetContext(std::string(ResampleFilterName(bounds.filter)) + " on " + ResampleKernelName());
+        HDR_CHECK_LE(SimdDeviation(photo, 960, 540, bounds.filter, 1), 1e-5);
+        HDR_CHECK_LE(SimdDeviation(photo, 640, 427, bounds.filter, 3), 1e-5);
+        // Up: a zoom
+        HDR_CHECK_LE(SimdDeviation(photo, 3750, 2500, bounds.filter, 0), 1e-5);
+        // Widths that leave a remainder after the 8 and 16 wide kernels
+        HDR_CHECK_LE(SimdDeviation(photo, 1001, 77, bounds.filter, 1), 1e-5);
+    }
+}
+
+HDR_TEST("resample/passband-and-stopband")
+{
+    for (const FilterBounds& bounds : kFilters) {
+        for (bool simd : { false, true }) {
+            test.SetContext(std::string(ResampleFilterName(bounds.filter)) + (simd ? " simd" : " scalar"));
+            const double pass = Response(bounds.filter, 16.0, simd);
+            HDR_CHECK_LE(bounds.passMin, pass);
+            HDR_CHECK_LE(pass, 1.02);
+            HDR_CHECK_LE(Response(bounds.filter, 2.5, simd), bounds.alias);
+        }
+    }
+}
+
+HDR_TEST("resample/constant-stays-constant")
+{
+    HdrImage src;
+    src.Allocate(333, 222);
+    std::fill(src.rgb.begin(), src.rgb.end(), 4.0f);
+    for (const FilterBounds& bounds : kFilters) {
+        test.SetContext(ResampleFilterName(bounds.filter));
+        ResampleOptions options;
+        options.filter = bounds.filter;
+        HdrImage dst;
+        for (int width : { 100, 1000 }) {
+            ResampleHdrImage(src, width, width * 2 / 3, options, dst);
+            double error = 0;
+            for (float v : dst.rgb) error = std::max(error, std::fabs(v - 4.0) / 4.0);
+            HDR_CHECK_LE(error, 1e-5);
+        }
+    }
+}
+
+// The header promises the exp2 polynomial within 2e-7 relative of std::exp2
+HDR_TEST("resample/gainmap-upsample-matches-exp2")
+{
+    const int mapWidth = 1500, width = 6000;
+    std::vector<float> log(static_cast<size_t>(mapWidth));
+    for (int x = 0; x < mapWidth; ++x) log[static_cast<size_t>(x)] = 3.0f * std::sin(x * 0.01f) - 0.5f;
+    const LinearTaps columns = BuildLinearTaps(mapWidth, width);
+    std::vector<float> boost(static_cast<size_t>(width)), reference(static_cast<size_t>(width));
+    UpsampleExp2Row(columns, log.data(), boost.data(), true);
+    UpsampleExp2Row(columns, log.data(), reference.data(), false);
+    double error = 0;
+    for (int x = 0; x < width; ++x) error = std::max(error, std::fabs(boost[static_cast<size_t>(x)] / reference[static_cast<size_t>(x)] - 1.0));
+    HDR_CHECK_LE(error, 2e-7);
+}
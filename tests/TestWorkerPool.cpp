@@ -0,0 +1,100 @@
+// TestWorkerPool.cpp - deadline order of jobs submitted from inside the pool, and the queue depth
+// while jobs are submitted and taken at once
+
+#include "Test.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HDR_TEST("pool/nested-deadline-order")
+{
+    WorkerPool pool(1);
+    const WorkerPool::Clock::time_point now = WorkerPool::Clock::now();
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&](int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(id);
+    };
+    pool.Submit(now, [&] {
+        pool.Submit(now + std::chrono::milliseconds(3), [&] { record(3); });
+        pool.Submit(now + std::chrono::milliseconds(1), [&] { record(1); });
+        pool.Submit(now + std::chrono::milliseconds(2), [&] { record(2); });
+    });
+    pool.WaitIdle();
+    HDR_CHECK((order == std::vector<int>{ 1, 2, 3 }));
+}
+
+// Jobs without a deadline stay on their worker's deque, newest first
+HDR_TEST("pool/nested-no-deadline-is-lifo")
+{
+    WorkerPool pool(1);
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&](int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(id);
+    };
+    pool.Submit(WorkerPool::Clock::now(), [&] {
+        for (int id = 1; id <= 3; ++id) pool.Submit(WorkerPool::kNoDeadline, [&record, id] { record(id); });
+    });
+    pool.WaitIdle();
+    HDR_CHECK((order == std::vector<int>{ 3, 2, 1 }));
+}
+
+// Work shared out from inside the only worker: the calling job does all of it rather than wait
+// for its helper, which is queued behind it
+HDR_TEST("pool/run-shared-from-job")
+{
+    WorkerPool pool(1);
+    std::atomic<int> next{ 0 };
+    std::atomic<int> done{ 0 };
+    bool returned = false;
+    pool.Submit(WorkerPool::Clock::now(), [&] {
+        pool.RunShared(3, [&] {
+            for (int i = next++; i < 1000; i = next++) ++done;
+        });
+        returned = true;
+    });
+    pool.WaitIdle();
+    HDR_CHECK(returned);
+    HDR_CHECK(done.load() == 1000);
+
+    // From outside the pool the helpers join in
+    WorkerPool wide(4);
+    next = 0;
+    done = 0;
+    wide.RunShared(4, [&] {
+        for (int i = next++; i < 100000; i = next++) ++done;
+    });
+    HDR_CHECK(done.load() == 100000);
+    wide.WaitIdle();
+}
+
+// Never more jobs queued than submitted: a job taken before it was counted would wrap the count
+HDR_TEST("pool/queue-depth-in-range")
+{
+    WorkerPool pool(4);
+    const size_t perThread = 20000;
+    std::vector<std::thread> submitters;
+    std::atomic<size_t> submitted{ 0 };
+    std::atomic<size_t> worst{ 0 };
+    for (int t = 0; t < 4; ++t) {
+        submitters.emplace_back([&] {
+            for (size_t i = 0; i < perThread; ++i) {
+                submitted.fetch_add(1);
+                pool.Submit(WorkerPool::Clock::now(), [] {});
+                const size_t depth = pool.QueueDepth();
+                if (depth > worst.load()) worst.store(depth);
+            }
+        });
+    }
+    for (std::thread& t : submitters) t.join();
+    pool.WaitIdle();
+    HDR_CHECK_LE(worst.load(), submitted.load());
+    HDR_CHECK(pool.QueueDepth() == 0);
+}
@@ -0,0 +1,49 @@
+# RenderGolden.cmake - golden image regression test of the CPU renderer, run by ctest
+#
+#   cmake -DHDRGEN=<hdrgen> -DHDRRENDER=<hdrrender> -DGOLDEN_DIR=<tests/golden> -DWORK_DIR=<scratch>
+#         [-DUPDATE=ON] -P RenderGolden.cmake
+#
+# Writes small hdrgen --single fixtures (Ultra HDR with and without restart markers, plain JPEG),
+# renders them with hdrrender once per case and compares each render against
+# GOLDEN_DIR/<case>/<file>.pfm with --golden. With UPDATE=ON the renders replace the golden files
+# instead, after a deliberate change of the rendering.
+
+cmake_minimum_required(VERSION 3.15)
+
+foreach(VAR HDRGEN HDRRENDER GOLDEN_DIR WORK_DIR)
+  if(NOT DEFINED ${VAR})
+    message(FATAL_ERROR "${VAR} is not set")
+  endif()
+endforeach()
+
+set(FIXTURES "${WORK_DIR}/fixtures")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${FIXTURES}")
+
+function(run)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${ARGN} failed (${result}):\n${output}")
+  endif()
+endfunction()
+
+run("${HDRGEN}" --single ultrahdr "${FIXTURES}/ultrahdr.jpg" --size 64x48)
+run("${HDRGEN}" --single ultrahdr "${FIXTURES}/ultrahdr-restart.jpg" --size 64x48 --restart 2)
+run("${HDRGEN}" --single jpeg "${FIXTURES}/jpeg.jpg" --size 64x48)
+
+# The cases and their hdrrender options
+set(CASES full 1-stop fit)
+set(OPTIONS_full)
+set(OPTIONS_1-stop --headroom 1)
+set(OPTIONS_fit --fit 40x30 --filter lanczos3)
+
+foreach(NAME ${CASES})
+  set(PARTS ${OPTIONS_${NAME}})
+  if(UPDATE)
+    file(REMOVE_RECURSE "${GOLDEN_DIR}/${NAME}")
+    run("${HDRRENDER}" "${FIXTURES}" "${GOLDEN_DIR}/${NAME}" --formats pfm --threads 4 ${PARTS})
+    message(STATUS "Updated ${GOLDEN_DIR}/${NAME}")
+  else()
+    run("${HDRRENDER}" "${FIXTURES}" "${WORK_DIR}/${NAME}" --formats pfm --threads 4 --golden "${GOLDEN_DIR}/${NAME}" ${PARTS})
+  endif()
+endforeach()
@@ -0,0 +1,57 @@
+// hdrtest - checks of the portable core, run by ctest
+//
+// Usage: hdrtest [<prefix>...] [--list]
+//   <prefix>   run only tests whose name starts with it (default: all)
+//   --list     print the test names
+//
+// The exit code is 1 if any check failed or a prefix matched no test.
+
+#include "Test.h"
+
+#include <chrono>
+#include <cstring>
+
+std::vector<TestCase>& TestRegistry()
+{
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> prefixes;
+    bool list = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--list") == 0) list = true;
+        else prefixes.push_back(argv[i]);
+    }
+    auto selected = [&prefixes](const TestCase& test) {
+        if (prefixes.empty()) return true;
+        for (const std::string& prefix : prefixes) {
+            if (test.name.compare(0, prefix.size(), prefix) == 0) return true;
+        }
+        return false;
+    };
+
+    size_t run = 0, failed = 0;
+    for (const TestCase& test : TestRegistry()) {
+        if (!selected(test)) continue;
+        ++run;
+        if (list) {
+            std::printf("%s\n", test.name.c_str());
+            continue;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        TestState state;
+        test.run(state);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (state.Failed()) ++failed;
+        std::printf("%-4s %-56s %8.1f ms\n", state.Failed() ? "FAIL" : "ok", test.name.c_str(), ms);
+    }
+    if (run == 0) {
+        std::fprintf(stderr, "No test matches\n");
+        return 1;
+    }
+    if (!list) std::printf("%zu of %zu tests passed\n", run - failed, run);
+    return failed ? 1 : 0;
+}
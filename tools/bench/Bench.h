@@ -0,0 +1,107 @@
+// Bench.h - minimal benchmark registry used by hdrbench
+//
+// A benchmark is a function that does its setup, then runs the measured work inside
+// `while (state.Run()) { ... }`. The runner picks the iteration count so one sample takes at
+// least --min-time, repeats that for --samples samples and reports the median time per iteration.
+//
+//   HDR_BENCH("files/IsImagePath") {
+//       std::vector<std::filesystem::path> paths = ...;
+//       while (state.Run()) { for (auto& p : paths) DoNotOptimize(IsImagePath(p)); }
+//       state.SetItemsPerIteration(paths.size());
+//   }
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class BenchState {
+public:
+    explicit BenchState(uint64_t iterations) : iterations_(iterations) {}
+
+    // Returns true `iterations` times; the time between the first and the last call is measured
+    bool Run() {
+        if (done_ == 0 && !started_) {
+            started_ = true;
+            start_ = std::chrono::steady_clock::now();
+        }
+        if (done_ < iterations_) { ++done_; return true; }
+        end_ = std::chrono::steady_clock::now();
+        return false;
+    }
+
+    // Work units (files, messages, pixels, ...) and bytes processed by one iteration, for throughput
+    void SetItemsPerIteration(uint64_t items) { itemsPerIteration_ = items; }
+    void SetBytesPerIteration(uint64_t bytes) { bytesPerIteration_ = bytes; }
+    // Extra per-iteration figure shown next to the timings (page faults, reuses, ...)
+    void SetCounter(const std::string& name, double valuePerIteration) { counters_.emplace_back(name, valuePerIteration); }
+    // Marks the case as not runnable here (missing input, unsupported platform)
+    void Skip(const std::string& reason) { skipReason_ = reason; }
+
+    uint64_t Iterations() const { return iterations_; }
+    double ElapsedNs() const { return std::chrono::duration<double, std::nano>(end_ - start_).count(); }
+    uint64_t ItemsPerIteration() const { return itemsPerIteration_; }
+    uint64_t BytesPerIteration() const { return bytesPerIteration_; }
+    const std::string& SkipReason() const { return skipReason_; }
+    const std::vector<std::pair<std::string, double>>& Counters() const { return counters_; }
+
+private:
+    uint64_t iterations_;
+    uint64_t done_ = 0;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_{}, end_{};
+    uint64_t itemsPerIteration_ = 0;
+    uint64_t bytesPerIteration_ = 0;
+    std::string skipReason_;
+    std::vector<std::pair<std::string, double>> counters_;
+};
+
+using BenchFunction = std::function<void(BenchState&)>;
+
+struct BenchCase {
+    std::string name;
+    BenchFunction run;
+};
+
+std::vector<BenchCase>& BenchRegistry();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char* name, BenchFunction run) { BenchRegistry().push_back({ name, std::move(run) }); }
+};
+
+#define HDR_BENCH_CONCAT2(a, b) a##b
+#define HDR_BENCH_CONCAT(a, b) HDR_BENCH_CONCAT2(a, b)
+#define HDR_BENCH(name) \
+    static void HDR_BENCH_CONCAT(HdrBench_, __LINE__)(BenchState& state); \
+    static BenchRegistrar HDR_BENCH_CONCAT(hdrBenchRegistrar_, __LINE__)(name, HDR_BENCH_CONCAT(HdrBench_, __LINE__)); \
+    static void HDR_BENCH_CONCAT(HdrBench_, __LINE__)(BenchState& state)
+
+// Keeps the compiler from optimizing away a computed value
+template<typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Page faults (minor and major) the process has taken so far; 0 where the system does not tell
+uint64_t BenchPageFaults();
+
+// Resident memory of the process, and its high-water mark since BenchResetPeakMemory() (since
+// start on Windows, where it cannot be reset); 0 where the system does not tell
+uint64_t BenchResidentBytes();
+uint64_t BenchPeakResidentBytes();
+void BenchResetPeakMemory();
+
+// Scratch directory for generated inputs; removed when hdrbench exits
+const std::filesystem::path& BenchScratchDir();
+
+// Directory of real images passed with --corpus (empty if none)
+const std::filesystem::path& BenchCorpusDir();
@@ -0,0 +1,88 @@
+// BenchCatalog.cpp - playlist queries over a million-image catalog table
+
+#include "Bench.h"
+#include "CatalogTable.h"
+
+#include <chrono>
+
+namespace {
+
+const size_t kRows = 1000000;
+const size_t kFolders = 1000;
+
+// One million images in 1000 folders over ten years; a third carry a gain map
+const CatalogTable& MillionImages()
+{
+    static const CatalogTable table = [] {
+        using namespace std::chrono;
+        CatalogTable table(L"lib");
+        table.Reserve(kRows);
+        const sys_days first = year{ 2015 } / January / 1;
+        uint32_t noise = 1;
+        for (size_t i = 0; i < kRows; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            const size_t folder = i * kFolders / kRows;
+            CatalogIndexEntry entry;
+            entry.path = L"lib/" + std::to_wstring(2015 + folder / 100) + L"/event-" + std::to_wstring(folder) + L"/IMG_" + std::to_wstring(i) + L".jpg";
+            entry.fileSize = 2000000 + (noise >> 10);
+            const sys_days day = first + days(static_cast<int>(folder * 3650 / kFolders + (noise >> 29)));
+            entry.modified = static_cast<int64_t>(file_clock::from_sys(sys_time<seconds>(day)).time_since_epoch().count());
+            entry.container = ImageContainer::Jpeg;
+            entry.width = (noise & 1) ? 6000 : 4000;
+            entry.height = (noise & 1) ? 4000 : 3000;
+            entry.gainMap = noise % 3 == 0;
+            entry.hdrCapacityMax = entry.gainMap ? static_cast<float>((noise >> 8) % 40) / 10.0f : 0.0f;
+            entry.renderability = entry.gainMap ? Renderability::Hdr : Renderability::Displays;
+            table.Add(entry);
+        }
+        return table;
+    }();
+    return table;
+}
+
+void RunQuery(BenchState& state, const wchar_t* text)
+{
+    const CatalogTable& table = MillionImages();
+    CatalogQuery query;
+    CatalogQuery::Parse(text, query);
+    size_t matched = 0;
+    while (state.Run()) {
+        const std::vector<uint32_t> rows = table.Select(query);
+        matched = rows.size();
+        DoNotOptimize(rows.data());
+    }
+    DoNotOptimize(matched);
+    state.SetItemsPerIteration(table.Size());
+}
+
+} // namespace
+
+HDR_BENCH("catalog/Select/1M-filter")
+{
+    RunQuery(state, L"hdr headroom>=2 date:2019 size>3MB");
+}
+
+HDR_BENCH("catalog/Select/1M-filter-folders")
+{
+    RunQuery(state, L"hdr folder:2018 folder:2021/event-650 width>=6000");
+}
+
+HDR_BENCH("catalog/Select/1M-sort-date")
+{
+    RunQuery(state, L"sort:-date");
+}
+
+HDR_BENCH("catalog/Select/1M-filter-sort-headroom")
+{
+    RunQuery(state, L"hdr date:2016..2022 sort:-headroom");
+}
+
+HDR_BENCH("catalog/CatalogQuery/Parse")
+{
+    CatalogQuery query;
+    while (state.Run()) {
+        CatalogQuery::Parse(L"hdr headroom>=2 date:2023 folder:Trips folder:\"Family/Summer 2023\" format:jpeg,avif sort:date", query);
+        DoNotOptimize(query.folders.data());
+    }
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,393 @@
+// BenchContainers.cpp - header probing of AVIF, JPEG XL and PNG files, and the parsers on damaged
+// headers
+//
+// The files are built here: a 24 MP HDR AVIF with an alpha plane and an ISO 21496-1 gain map
+// (tmap item), a 10-bit PQ JPEG XL in a container with the jhgm box after the codestream, the
+// same codestream bare, and a 16-bit PNG with cICP, cLLi and iCCP. Compressed payloads are filler;
+// nothing here decodes pixels. Each case checks the probe result once and skips itself if the
+// parser no longer reads what was written.
+
+#include "Bench.h"
+#include "ContainerMetadata.h"
+#include "ImageProbe.h"
+
+#include <cstring>
+
+namespace {
+
+void Put16(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void Put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    Put16(out, v >> 16);
+    Put16(out, v & 0xFFFF);
+}
+
+void PutType(std::vector<uint8_t>& out, const char* type)
+{
+    out.insert(out.end(), type, type + 4);
+}
+
+void Append(std::vector<uint8_t>& out, const std::vector<uint8_t>& part)
+{
+    out.insert(out.end(), part.begin(), part.end());
+}
+
+std::vector<uint8_t> Box(const char* type, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> box;
+    Put32(box, static_cast<uint32_t>(8 + payload.size()));
+    PutType(box, type);
+    Append(box, payload);
+    return box;
+}
+
+std::vector<uint8_t> FullBox(const char* type, uint8_t version, uint32_t flags, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> body;
+    Put32(body, (uint32_t(version) << 24) | flags);
+    Append(body, payload);
+    return Box(type, body);
+}
+
+std::vector<uint8_t> Filler(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (uint8_t& v : data) {
+        seed = seed * 1664525u + 1013904223u;
+        v = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+// ISO 21496-1 metadata: SDR base, 3 stops of alternate headroom, one channel
+std::vector<uint8_t> IsoGainMapMetadata()
+{
+    std::vector<uint8_t> m;
+    Put16(m, 0);                                   // minimum_version
+    Put16(m, 0);                                   // writer_version
+    m.push_back(0);                                // single channel, alternate colour space
+    const uint32_t fractions[][2] = { { 0, 1 }, { 3, 1 }, { 0, 1 }, { 3, 1 }, { 1, 1 }, { 1, 64 }, { 1, 64 } };
+    for (const auto& f : fractions) { Put32(m, f[0]); Put32(m, f[1]); }
+    return m;
+}
+
+// 6000x4000 10-bit BT.2020 PQ AVIF: primary (item 1) with alpha (2), tmap (3) combining the
+// primary and the gain map image (4)
+std::vector<uint8_t> HdrAvif()
+{
+    std::vector<uint8_t> ftypBody;
+    PutType(ftypBody, "avif");
+    Put32(ftypBody, 0);
+    PutType(ftypBody, "avif"); PutType(ftypBody, "mif1"); PutType(ftypBody, "miaf"); PutType(ftypBody, "tmap");
+    const std::vector<uint8_t> ftyp = Box("ftyp", ftypBody);
+
+    std::vector<uint8_t> tmap = { 0 };             // tmap version
+    Append(tmap, IsoGainMapMetadata());
+    const std::vector<uint8_t> items[4] = { Filler(1024 * 1024, 1), Filler(64 * 1024, 2), tmap, Filler(128 * 1024, 3) };
+
+    const auto buildMeta = [&](uint32_t mdatData) {
+        std::vector<uint8_t> hdlr(21, 0);              // pre_defined, handler, reserved, empty name
+        std::memcpy(hdlr.data() + 4, "pict", 4);
+        std::vector<uint8_t> pitm;
+        Put16(pitm, 1);
+        std::vector<uint8_t> iloc = { 0x44, 0x00 };    // 4-byte offsets and lengths, no base offset
+        Put16(iloc, 4);
+        for (uint32_t i = 0; i < 4; ++i) {
+            Put16(iloc, i + 1);
+            Put16(iloc, 0);
+            Put16(iloc, 1);
+            Put32(iloc, mdatData);
+            Put32(iloc, static_cast<uint32_t>(items[i].size()));
+            mdatData += static_cast<uint32_t>(items[i].size());
+        }
+        std::vector<uint8_t> iinf;
+        Put16(iinf, 4);
+        const char* types[4] = { "av01", "av01", "tmap", "av01" };
+        for (uint32_t i = 0; i < 4; ++i) {
+            std::vector<uint8_t> infe;
+            Put16(infe, i + 1);
+            Put16(infe, 0);
+            PutType(infe, types[i]);
+            infe.push_back(0);
+            Append(iinf, FullBox("infe", 2, 0, infe));
+        }
+        std::vector<uint8_t> auxl, dimg;
+        Put16(auxl, 2); Put16(auxl, 1); Put16(auxl, 1);
+        Put16(dimg, 3); Put16(dimg, 2); Put16(dimg, 1); Put16(dimg, 4);
+        std::vector<uint8_t> iref = Box("auxl", auxl);
+        Append(iref, Box("dimg", dimg));
+
+        const auto ispe = [](uint32_t w, uint32_t h) {
+            std::vector<uint8_t> p;
+            Put32(p, w);
+            Put32(p, h);
+            return FullBox("ispe", 0, 0, p);
+        };
+        std::vector<uint8_t> ipco = ispe(6000, 4000);
+        Append(ipco, FullBox("pixi", 0, 0, { 3, 10, 10, 10 }));
+        std::vector<uint8_t> nclx;
+        PutType(nclx, "nclx");
+        Put16(nclx, 9); Put16(nclx, 16); Put16(nclx, 9);
+        nclx.push_back(0x80);
+        Append(ipco, Box("colr", nclx));
+        Append(ipco, Box("av1C", { 0x81, 0x08, 0x4C, 0x00 }));
+        std::vector<uint8_t> clli;
+        Put16(clli, 1000); Put16(clli, 400);
+        Append(ipco, Box("clli", clli));
+        const char urn[] = "urn:mpeg:mpegB:cicp:systems:auxiliary:alpha";
+        Append(ipco, FullBox("auxC", 0, 0, std::vector<uint8_t>(urn, urn + sizeof(urn))));
+        Append(ipco, ispe(1500, 1000));
+        Append(ipco, FullBox("pixi", 0, 0, { 1, 8 }));
+        std::vector<uint8_t> ipma;
+        Put32(ipma, 4);
+        const std::vector<uint8_t> associations[4] = { { 1, 2, 3, 0x84, 5 }, { 1, 0x86 }, { 1 }, { 7, 8, 0x84 } };
+        for (uint32_t i = 0; i < 4; ++i) {
+            Put16(ipma, i + 1);
+            ipma.push_back(static_cast<uint8_t>(associations[i].size()));
+            Append(ipma, associations[i]);
+        }
+        std::vector<uint8_t> iprp = Box("ipco", ipco);
+        Append(iprp, FullBox("ipma", 0, 0, ipma));
+
+        std::vector<uint8_t> meta = FullBox("hdlr", 0, 0, hdlr);
+        Append(meta, FullBox("pitm", 0, 0, pitm));
+        Append(meta, FullBox("iloc", 0, 0, iloc));
+        Append(meta, FullBox("iinf", 0, 0, iinf));
+        Append(meta, FullBox("iref", 0, 0, iref));
+        Append(meta, Box("iprp", iprp));
+        return FullBox("meta", 0, 0, meta);
+    };
+    // The meta box size does not depend on the offsets, so it is built twice
+    const size_t metaSize = buildMeta(0).size();
+    std::vector<uint8_t> file = ftyp;
+    Append(file, buildMeta(static_cast<uint32_t>(ftyp.size() + metaSize + 8)));
+    std::vector<uint8_t> mdat;
+    for (const auto& item : items) Append(mdat, item);
+    Append(file, Box("mdat", mdat));
+    return file;
+}
+
+// Least significant bit first, as JPEG XL codestreams are written
+struct BitWriter {
+    std::vector<uint8_t> bytes;
+    size_t bit = 0;
+
+    void Bits(uint32_t value, int n) {
+        for (int i = 0; i < n; ++i, ++bit) {
+            if ((bit >> 3) >= bytes.size()) bytes.push_back(0);
+            bytes[bit >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (bit & 7));
+        }
+    }
+};
+
+// 6000x4000, 10-bit, one alpha channel, BT.2020 PQ with a 4000 cd/m2 intensity target
+std::vector<uint8_t> PqJxlCodestream()
+{
+    BitWriter w;
+    w.Bits(0, 1);                                  // SizeHeader: not small
+    w.Bits(1, 2); w.Bits(3999, 13);                // height: U32 selector 1, 13 bits + 1
+    w.Bits(4, 3);                                  // ratio 3:2
+    w.Bits(0, 1);                                  // ImageMetadata: not all default
+    w.Bits(1, 1);                                  // extra fields
+    w.Bits(0, 3);                                  // orientation 1
+    w.Bits(0, 1); w.Bits(0, 1); w.Bits(0, 1);      // no intrinsic size, preview, animation
+    w.Bits(0, 1); w.Bits(1, 2);                    // integer samples, 10 bits
+    w.Bits(1, 1);                                  // modular_16_bit_buffers
+    w.Bits(1, 2);                                  // one extra channel
+    w.Bits(1, 1);                                  // default alpha
+    w.Bits(1, 1);                                  // xyb_encoded
+    w.Bits(0, 1); w.Bits(0, 1);                    // ColourEncoding: not default, no ICC
+    w.Bits(0, 2);                                  // RGB
+    w.Bits(1, 2);                                  // D65
+    w.Bits(2, 2); w.Bits(9 - 2, 4);                // BT.2100 primaries
+    w.Bits(0, 1); w.Bits(2, 2); w.Bits(16 - 2, 4); // PQ
+    w.Bits(1, 2);                                  // relative intent
+    w.Bits(0, 1); w.Bits(0x6BD0, 16);              // ToneMapping: intensity target 4000
+    w.Bits(0, 16); w.Bits(0, 1); w.Bits(0, 16);
+    w.Bits(0, 2);                                  // no extensions
+    std::vector<uint8_t> codestream = { 0xFF, 0x0A };
+    Append(codestream, w.bytes);
+    Append(codestream, Filler(1024 * 1024, 4));
+    return codestream;
+}
+
+std::vector<uint8_t> HdrJxlContainer()
+{
+    std::vector<uint8_t> file = { 0, 0, 0, 12, 'J', 'X', 'L', ' ', 0x0D, 0x0A, 0x87, 0x0A };
+    std::vector<uint8_t> ftyp;
+    PutType(ftyp, "jxl ");
+    Put32(ftyp, 0);
+    PutType(ftyp, "jxl ");
+    Append(file, Box("ftyp", ftyp));
+    Append(file, Box("jxlc", PqJxlCodestream()));
+    std::vector<uint8_t> jhgm = { 0 };
+    const std::vector<uint8_t> metadata = IsoGainMapMetadata();
+    Put16(jhgm, static_cast<uint32_t>(metadata.size()));
+    Append(jhgm, metadata);
+    jhgm.push_back(0);                             // no color encoding
+    Put32(jhgm, 0);                                // no alternate ICC
+    Append(jhgm, Filler(64 * 1024, 5));            // gain map codestream
+    Append(file, Box("jhgm", jhgm));
+    return file;
+}
+
+void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+    Put32(out, static_cast<uint32_t>(data.size()));
+    PutType(out, type);
+    Append(out, data);
+    Put32(out, 0);                                 // CRC, not checked by the probe
+}
+
+// 8000x6000 16-bit RGB, BT.2020 PQ by cICP
+std::vector<uint8_t> PqPng()
+{
+    std::vector<uint8_t> file = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    std::vector<uint8_t> ihdr;
+    Put32(ihdr, 8000); Put32(ihdr, 6000);
+    ihdr.insert(ihdr.end(), { 16, 2, 0, 0, 0 });
+    PutChunk(file, "IHDR", ihdr);
+    const char name[] = "Rec2100 PQ";
+    std::vector<uint8_t> iccp(name, name + sizeof(name));
+    iccp.push_back(0);
+    Append(iccp, Filler(3000, 6));
+    PutChunk(file, "iCCP", iccp);
+    PutChunk(file, "cICP", { 9, 16, 0, 1 });
+    std::vector<uint8_t> clli;
+    Put32(clli, 1000 * 10000); Put32(clli, 400 * 10000);
+    PutChunk(file, "cLLi", clli);
+    PutChunk(file, "IDAT", Filler(512 * 1024, 7));
+    PutChunk(file, "IEND", {});
+    return file;
+}
+
+struct ContainerFile {
+    const char* name;
+    std::vector<uint8_t> data;
+    ImageContainer container;
+    int width, height, components;
+    bool gainMap;
+};
+
+const std::vector<ContainerFile>& ContainerFiles()
+{
+    static const std::vector<ContainerFile> files = {
+        { "avif-pq-gainmap", HdrAvif(), ImageContainer::Avif, 6000, 4000, 4, true },
+        { "jxl-container-gainmap", HdrJxlContainer(), ImageContainer::Jxl, 6000, 4000, 4, true },
+        { "jxl-codestream", PqJxlCodestream(), ImageContainer::Jxl, 6000, 4000, 4, false },
+        { "png-cicp", PqPng(), ImageContainer::Png, 8000, 6000, 3, false },
+    };
+    return files;
+}
+
+bool ProbesAsWritten(const ContainerFile& file, const ImageProbe& p)
+{
+    return p.container == file.container && p.width == file.width && p.height == file.height && p.components == file.components &&
+           p.gainMap == file.gainMap && (!file.gainMap || (p.hasHdrgm && p.hdrgm.hdrCapacityMax == 3.0f)) && p.color.present &&
+           p.color.transfer == kCicpTransferPq && p.color.primaries == 9 && p.color.maxCll > 0;
+}
+
+void ProbeContainerFile(BenchState& state, const char* name)
+{
+    for (const ContainerFile& file : ContainerFiles()) {
+        if (std::strcmp(file.name, name) != 0) continue;
+        ImageProbe probe;
+        ProbeImageData(file.data.data(), file.data.size(), probe);
+        if (!ProbesAsWritten(file, probe)) { state.Skip("probe does not match the written headers"); return; }
+        while (state.Run()) {
+            ProbeImageData(file.data.data(), file.data.size(), probe);
+            DoNotOptimize(probe.color.transfer);
+        }
+        state.SetItemsPerIteration(1);
+    }
+}
+
+} // namespace
+
+HDR_BENCH("probe/ProbeImageData/avif-pq-gainmap")
+{
+    ProbeContainerFile(state, "avif-pq-gainmap");
+}
+
+HDR_BENCH("probe/ProbeImageData/jxl-container-gainmap")
+{
+    ProbeContainerFile(state, "jxl-container-gainmap");
+}
+
+HDR_BENCH("probe/ProbeImageData/jxl-codestream")
+{
+    ProbeContainerFile(state, "jxl-codestream");
+}
+
+HDR_BENCH("probe/ProbeImageData/png-cicp")
+{
+    ProbeContainerFile(state, "png-cicp");
+}
+
+// The parsers alone, in place on the file head; ProbeImageData adds the copy of the head
+HDR_BENCH("probe/ParseIsobmffInfo/avif-pq-gainmap")
+{
+    const std::vector<uint8_t>& file = ContainerFiles()[0].data;
+    const size_t head = std::min(file.size(), kProbeHeadBytes);
+    ContainerInfo info;
+    while (state.Run()) {
+        ParseIsobmffInfo(file.data(), head, file.size(), info);
+        DoNotOptimize(info.width);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("probe/ParseJxlInfo/jxl-codestream")
+{
+    const std::vector<uint8_t>& file = ContainerFiles()[2].data;
+    ContainerInfo info;
+    while (state.Run()) {
+        ParseJxlInfo(file.data(), kProbeHeadBytes, file.size(), info);
+        DoNotOptimize(info.width);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("probe/ParsePngInfo/png-cicp")
+{
+    const std::vector<uint8_t>& file = ContainerFiles()[3].data;
+    ContainerInfo info;
+    while (state.Run()) {
+        ParsePngInfo(file.data(), kProbeHeadBytes, info);
+        DoNotOptimize(info.width);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+// Robustness: every file cut short at each of its first 2048 bytes, and every one of those bytes
+// replaced by three values in turn; tests/TestContainers.cpp checks what the parsers return.
+HDR_BENCH("probe/containers/damaged-headers")
+{
+    size_t probes = 0;
+    ImageProbe probe;
+    std::vector<uint8_t> damaged;
+    while (state.Run()) {
+        probes = 0;
+        for (const ContainerFile& file : ContainerFiles()) {
+            const size_t span = std::min<size_t>(file.data.size(), 2048);
+            for (size_t cut = 0; cut < span; ++cut, ++probes) ProbeImageData(file.data.data(), cut, probe);
+            damaged.assign(file.data.begin(), file.data.begin() + static_cast<std::ptrdiff_t>(std::min(file.data.size(), kProbeHeadBytes)));
+            for (size_t i = 0; i < span; ++i) {
+                const uint8_t original = damaged[i];
+                for (uint8_t value : { uint8_t(0x00), uint8_t(0xFF), uint8_t(original ^ 0x80) }) {
+                    damaged[i] = value;
+                    ProbeImageData(damaged.data(), damaged.size(), probe);
+                    ++probes;
+                }
+                damaged[i] = original;
+            }
+        }
+        DoNotOptimize(probe.width);
+    }
+    state.SetItemsPerIteration(probes);
+}
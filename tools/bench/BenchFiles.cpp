@@ -0,0 +1,94 @@
+// BenchFiles.cpp - directory enumeration and file classification
+
+#include "Bench.h"
+#include "ImageCatalog.h"
+#include "ImageFileUtils.h"
+
+#include <fstream>
+
+namespace {
+
+const size_t kTreeFolders = 40;
+const size_t kFilesPerFolder = 50;
+
+// Typical export folder: mostly JPEGs plus the sidecars and raw files photo tools leave behind
+const wchar_t* const kTreeExtensions[] = { L".jpg", L".jpg", L".jpg", L".JPG", L".jpeg", L".png", L".avif", L".xmp", L".CR3", L".txt" };
+
+const std::filesystem::path& EnumerationTree()
+{
+    static const std::filesystem::path root = [] {
+        std::filesystem::path dir = BenchScratchDir() / "tree";
+        for (size_t f = 0; f < kTreeFolders; ++f) {
+            std::filesystem::path folder = dir / ("2024-" + std::to_string(f));
+            std::filesystem::create_directories(folder);
+            for (size_t i = 0; i < kFilesPerFolder; ++i) {
+                std::filesystem::path file = folder / (L"IMG_" + std::to_wstring(i) + kTreeExtensions[i % std::size(kTreeExtensions)]);
+                std::ofstream(file, std::ios::binary) << "x";
+            }
+        }
+        return dir;
+    }();
+    return root;
+}
+
+} // namespace
+
+HDR_BENCH("files/GetImageFilesInFolder/recursive")
+{
+    const std::wstring root = EnumerationTree().wstring();
+    while (state.Run()) {
+        auto files = GetImageFilesInFolder(root, true);
+        DoNotOptimize(files.size());
+    }
+    state.SetItemsPerIteration(kTreeFolders * kFilesPerFolder);
+}
+
+HDR_BENCH("files/ImageCatalog::FromFolder/recursive")
+{
+    const std::wstring root = EnumerationTree().wstring();
+    while (state.Run()) {
+        ImageCatalog catalog = ImageCatalog::FromFolder(root, true);
+        DoNotOptimize(catalog.Size());
+    }
+    state.SetItemsPerIteration(kTreeFolders * kFilesPerFolder);
+}
+
+// Open-with lookup of the starting file when the shell spells its path differently from the
+// folder listing; the last entry is the worst case
+HDR_BENCH("files/ImageCatalog::Find/other-spelling")
+{
+    const ImageCatalog catalog = ImageCatalog::FromFolder(EnumerationTree().wstring(), true);
+    std::wstring path = catalog[catalog.Size() - 1].path;
+    std::transform(path.begin(), path.end(), path.begin(), ::towupper);
+    size_t found = 0;
+    while (state.Run()) {
+        found = catalog.Find(path);
+        DoNotOptimize(found);
+    }
+    state.SetItemsPerIteration(catalog.Size());
+}
+
+HDR_BENCH("files/ImageCatalog::FromFolder/corpus")
+{
+    if (BenchCorpusDir().empty()) { state.Skip("needs --corpus"); return; }
+    const std::wstring root = BenchCorpusDir().wstring();
+    size_t count = 0;
+    while (state.Run()) {
+        ImageCatalog catalog = ImageCatalog::FromFolder(root, true);
+        count = catalog.Size();
+        DoNotOptimize(count);
+    }
+    state.SetItemsPerIteration(count);
+}
+
+HDR_BENCH("files/IsImagePath")
+{
+    std::vector<std::filesystem::path> paths;
+    for (size_t i = 0; i < 1000; ++i) {
+        paths.emplace_back(L"C:/Photos/2024/IMG_" + std::to_wstring(i) + kTreeExtensions[i % std::size(kTreeExtensions)]);
+    }
+    while (state.Run()) {
+        for (const auto& p : paths) DoNotOptimize(IsImagePath(p));
+    }
+    state.SetItemsPerIteration(paths.size());
+}
@@ -0,0 +1,115 @@
+// BenchGainMap.cpp - what a display headroom saves on a mixed Ultra HDR / SDR JPEG library:
+// gain maps left unread by the slideshow loader, and gain map work skipped by the CPU renderer
+
+#include "Bench.h"
+#include "HdrRender.h"
+#include "Slideshow.h"
+#include "SyntheticImages.h"
+
+namespace {
+
+// Half Ultra HDR (HDRCapacityMin 0, HDRCapacityMax 2 stops), half plain JPEG; gain maps at
+// half the image size, as phones write them
+SyntheticCorpusOptions MixedLibrary()
+{
+    SyntheticCorpusOptions options;
+    options.files = 200;
+    options.image.gainMapScale = 2;
+    options.mix.fill(0);
+    options.mix[static_cast<size_t>(SyntheticKind::UltraHdr)] = 1;
+    options.mix[static_cast<size_t>(SyntheticKind::Jpeg)] = 1;
+    return options;
+}
+
+const std::vector<CatalogEntry>& Library()
+{
+    static const std::vector<CatalogEntry> entries = [] {
+        const SyntheticCorpusOptions options = MixedLibrary();
+        const std::filesystem::path root = BenchScratchDir() / "mixed-library";
+        SyntheticCorpusResult result;
+        WriteSyntheticCorpus(root, options, result);
+        std::vector<CatalogEntry> list;
+        for (size_t i = 0; i < options.files; ++i) {
+            const std::filesystem::path path = root / SyntheticCorpusFile(options, i).path;
+            list.push_back({ path.wstring(), static_cast<uint64_t>(std::filesystem::file_size(path)), 0 });
+        }
+        return list;
+    }();
+    return entries;
+}
+
+// Loads the library for a display of `headroom` stops; the counters give the share of the file
+// bytes read and the gain maps left out
+void LoadLibrary(BenchState& state, float headroom)
+{
+    const std::vector<CatalogEntry>& entries = Library();
+    uint64_t total = 0, read = 0, omitted = 0;
+    for (const CatalogEntry& entry : entries) total += entry.fileSize;
+    while (state.Run()) {
+        read = omitted = 0;
+        for (const CatalogEntry& entry : entries) {
+            auto data = Slideshow::LoadImageFileForHeadroom(entry, headroom);
+            read += data->bytes.size();
+            if (data->gainMapOmitted) ++omitted;
+        }
+    }
+    state.SetItemsPerIteration(entries.size());
+    state.SetBytesPerIteration(read);
+    state.SetCounter("read-%", 100.0 * static_cast<double>(read) / static_cast<double>(total));
+    state.SetCounter("gain-maps-omitted", static_cast<double>(omitted));
+}
+
+// Renders the whole files at `headroom` stops; the counter gives the gain map share of the time
+void RenderLibrary(BenchState& state, float headroom)
+{
+    std::vector<std::shared_ptr<const ImageData>> files;
+    for (const CatalogEntry& entry : Library()) files.push_back(Slideshow::LoadImageFile(entry));
+    HdrRenderOptions options;
+    options.headroom = headroom;
+    HdrImage image;
+    double gainMapMs = 0, totalMs = 0;
+    while (state.Run()) {
+        gainMapMs = totalMs = 0;
+        for (const auto& file : files) {
+            HdrRenderInfo info;
+            RenderHdrImage(file->bytes.data(), file->bytes.size(), options, image, &info);
+            gainMapMs += info.timings.gainMapMs;
+            totalMs += info.timings.totalMs;
+            DoNotOptimize(image.rgb.data());
+        }
+    }
+    state.SetItemsPerIteration(files.size());
+    state.SetCounter("gain-map-%", totalMs > 0 ? 100.0 * gainMapMs / totalMs : 0.0);
+}
+
+} // namespace
+
+HDR_BENCH("files/LoadImageFileForHeadroom/mixed-library/unknown")
+{
+    LoadLibrary(state, -1.0f);
+}
+
+HDR_BENCH("files/LoadImageFileForHeadroom/mixed-library/sdr")
+{
+    LoadLibrary(state, 0.0f);
+}
+
+HDR_BENCH("files/LoadImageFileForHeadroom/mixed-library/2-stops")
+{
+    LoadLibrary(state, 2.0f);
+}
+
+HDR_BENCH("render/RenderHdrImage/mixed-library/sdr")
+{
+    RenderLibrary(state, 0.0f);
+}
+
+HDR_BENCH("render/RenderHdrImage/mixed-library/1-stop")
+{
+    RenderLibrary(state, 1.0f);
+}
+
+HDR_BENCH("render/RenderHdrImage/mixed-library/2-stops")
+{
+    RenderLibrary(state, 2.0f);
+}
@@ -0,0 +1,181 @@
+// BenchIdentity.cpp - content hash throughput, fingerprints of camera-sized files and the hash's
+// collision and avalanche behaviour on structured inputs
+
+#include "Bench.h"
+#include "FileIdentity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 16 MB of random bytes, the largest input any case hashes
+const std::vector<uint8_t>& RandomBytes()
+{
+    static const std::vector<uint8_t> bytes = [] {
+        std::mt19937_64 rng(11);
+        std::vector<uint8_t> bytes(16 << 20);
+        for (size_t i = 0; i < bytes.size(); i += 8) {
+            const uint64_t v = rng();
+            std::memcpy(bytes.data() + i, &v, 8);
+        }
+        return bytes;
+    }();
+    return bytes;
+}
+
+void HashThroughput(BenchState& state, size_t size)
+{
+    const std::vector<uint8_t>& bytes = RandomBytes();
+    while (state.Run()) DoNotOptimize(HashBytes(bytes.data(), size).lo);
+    state.SetBytesPerIteration(size);
+    state.SetItemsPerIteration(1);
+}
+
+// Number of equal neighbours after sorting
+template<typename T>
+size_t Collisions(std::vector<T>& values)
+{
+    std::sort(values.begin(), values.end());
+    size_t collisions = 0;
+    for (size_t i = 1; i < values.size(); ++i) collisions += values[i] == values[i - 1] ? 1 : 0;
+    return collisions;
+}
+
+struct CollisionReport {
+    double inputs = 0;
+    double collisions64 = 0;     // of the low 64 bits
+    double collisions32 = 0;     // of the low 32 bits, against the birthday expectation below
+    double expected32 = 0;
+    double avalancheMean = 0;    // share of output bits a one-bit input change flips (ideal 0.5)
+    double avalancheWorst = 0;   // largest deviation of a single output bit from 0.5
+};
+
+// Four structured input families a library throws at it: counters, one-bit variations of a
+// 4 KB block, paths that differ in a few digits and buffers of a growing run of zeros
+const CollisionReport& Report()
+{
+    static const CollisionReport report = [] {
+        const size_t perFamily = 1 << 20;
+        std::vector<uint64_t> low;
+        low.reserve(perFamily * 4);
+        for (uint64_t i = 1; i <= perFamily; ++i) low.push_back(HashBytes(&i, sizeof(i)).lo);    // 0 would repeat 8 zeros
+        std::vector<uint8_t> block(RandomBytes().begin(), RandomBytes().begin() + 4096);
+        for (size_t i = 0; i < perFamily; ++i) {
+            const size_t bit = i % (4096 * 8);
+            block[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+            low.push_back(HashBytes(block.data(), block.size(), i / (4096 * 8)).lo);
+            block[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+        }
+        for (size_t i = 0; i < perFamily; ++i) {
+            const std::string path = "D:/Photos/" + std::to_string(2000 + i % 25) + "/IMG_" + std::to_string(i) + ".jpg";
+            low.push_back(HashBytes(path.data(), path.size()).lo);
+        }
+        const std::vector<uint8_t> zeros(perFamily, 0);
+        for (size_t i = 0; i < perFamily; ++i) low.push_back(HashBytes(zeros.data(), i).lo);
+
+        CollisionReport r;
+        r.inputs = static_cast<double>(low.size());
+        std::vector<uint32_t> truncated(low.size());
+        for (size_t i = 0; i < low.size(); ++i) truncated[i] = static_cast<uint32_t>(low[i]);
+        r.collisions64 = static_cast<double>(Collisions(low));
+        r.collisions32 = static_cast<double>(Collisions(truncated));
+        r.expected32 = r.inputs * (r.inputs - 1) / 2 / 4294967296.0;
+
+        // Avalanche over 256-byte inputs, every input bit of the first and last stripes flipped
+        std::mt19937_64 rng(5);
+        std::vector<double> flips(128, 0.0);
+        double trials = 0;
+        for (int n = 0; n < 64; ++n) {
+            uint8_t input[256];
+            for (uint8_t& b : input) b = static_cast<uint8_t>(rng());
+            const ContentHash base = HashBytes(input, sizeof(input));
+            for (int bit = 0; bit < 256 * 8; bit += (bit < 512 || bit >= 1536) ? 1 : 61) {
+                input[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                const ContentHash h = HashBytes(input, sizeof(input));
+                input[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                for (int o = 0; o < 64; ++o) {
+                    flips[o] += ((h.lo ^ base.lo) >> o) & 1;
+                    flips[64 + o] += ((h.hi ^ base.hi) >> o) & 1;
+                }
+                ++trials;
+            }
+        }
+        double sum = 0;
+        for (double f : flips) {
+            sum += f / trials;
+            r.avalancheWorst = std::max(r.avalancheWorst, std::fabs(f / trials - 0.5));
+        }
+        r.avalancheMean = sum / 128;
+        return r;
+    }();
+    return report;
+}
+
+} // namespace
+
+HDR_BENCH("identity/HashBytes/64B")
+{
+    HashThroughput(state, 64);
+}
+
+HDR_BENCH("identity/HashBytes/4KB")
+{
+    HashThroughput(state, 4096);
+}
+
+HDR_BENCH("identity/HashBytes/256KB")
+{
+    HashThroughput(state, 256 * 1024);
+}
+
+HDR_BENCH("identity/HashBytes/16MB")
+{
+    HashThroughput(state, 16 << 20);
+}
+
+// Paths of a million-image library, with the collision and avalanche results of the hash
+HDR_BENCH("identity/HashBytes/collisions-4M")
+{
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < 100000; ++i) paths.push_back("D:/Photos/" + std::to_string(2000 + i % 25) + "/IMG_" + std::to_string(i) + ".jpg");
+    while (state.Run()) {
+        for (const std::string& path : paths) DoNotOptimize(HashBytes(path.data(), path.size()).lo);
+    }
+    state.SetItemsPerIteration(paths.size());
+    const CollisionReport& r = Report();
+    state.SetCounter("inputs", r.inputs);
+    state.SetCounter("coll64", r.collisions64);
+    state.SetCounter("coll32", r.collisions32);
+    state.SetCounter("expected32", r.expected32);
+    state.SetCounter("avalanche", r.avalancheMean);
+    state.SetCounter("worst_bias", r.avalancheWorst);
+}
+
+// Fingerprint of a 12 MB camera file already in memory (hdrbake) and on disk (page cache warm)
+HDR_BENCH("identity/FingerprintData/12MB")
+{
+    const std::vector<uint8_t>& bytes = RandomBytes();
+    while (state.Run()) DoNotOptimize(FingerprintData(bytes.data(), 12 << 20).lo);
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("identity/FingerprintFile/12MB")
+{
+    const std::filesystem::path path = BenchScratchDir() / "fingerprint.jpg";
+    if (!std::filesystem::exists(path)) {
+        const std::vector<uint8_t>& bytes = RandomBytes();
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), 12 << 20);
+    }
+    ContentHash hash;
+    while (state.Run()) {
+        FingerprintFile(path, 12 << 20, hash);
+        DoNotOptimize(hash.lo);
+    }
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,188 @@
+// BenchIo.cpp - header probing throughput: sequential std::ifstream reads versus AsyncFileReader
+//
+// The files are freshly written, so the plain cases run from the page cache and measure
+// per-request overhead. The cold cases (Linux) drop the files from the page cache before every
+// pass, so reads go to the device and queue depth pays off; the same holds for network shares,
+// which --corpus can point at.
+
+#include "AsyncFileReader.h"
+#include "Bench.h"
+#include "ImageCatalog.h"
+#include "ImageProbe.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+
+#include <fstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kProbeFiles = 256;
+
+// A folder of 1200x800 JPEGs with an XMP packet, each followed by a copy of the image so the
+// files are larger than the probe head and the truncation check reads the tail separately
+const std::vector<CatalogEntry>& ProbeFolder()
+{
+    static const std::vector<CatalogEntry> files = [] {
+        PlanarImage image;
+        image.Allocate(1200, 800, 3);
+        uint32_t noise = 1;
+        for (auto& plane : image.planes) {
+            for (uint8_t& v : plane) {
+                noise = noise * 1664525u + 1013904223u;
+                v = static_cast<uint8_t>(noise >> 24);
+            }
+        }
+        JpegEncodeOptions options;
+        options.segments.push_back(BuildXmpSegment("<x:xmpmeta><rdf:Description hdrgm:Version=\"1.0\" hdrgm:GainMapMax=\"2.0\"/></x:xmpmeta>"));
+        std::vector<uint8_t> jpeg;
+        EncodeJpeg(image, options, jpeg);
+        const std::filesystem::path dir = BenchScratchDir() / "probe";
+        std::filesystem::create_directories(dir);
+        std::vector<CatalogEntry> files;
+        for (size_t i = 0; i < kProbeFiles; ++i) {
+            const std::filesystem::path path = dir / ("IMG_" + std::to_string(i) + ".jpg");
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(jpeg.data()), static_cast<std::streamsize>(jpeg.size()));
+            out.write(reinterpret_cast<const char*>(jpeg.data()), static_cast<std::streamsize>(jpeg.size()));
+            files.push_back({ path.wstring(), 2 * jpeg.size(), 0 });
+        }
+        return files;
+    }();
+    return files;
+}
+
+std::vector<CatalogEntry> CorpusFiles()
+{
+    if (BenchCorpusDir().empty()) return {};
+    return ImageCatalog::FromFolder(BenchCorpusDir().wstring(), true).Entries();
+}
+
+// Part of every timed pass in both variants, so the comparison stays fair
+void EvictFromPageCache(const std::vector<CatalogEntry>& files)
+{
+#ifdef __linux__
+    for (const CatalogEntry& entry : files) {
+        const int fd = open(std::filesystem::path(entry.path).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)files;
+#endif
+}
+
+void ProbeSequential(BenchState& state, const std::vector<CatalogEntry>& files, bool cold = false)
+{
+    ImageProbe probe;
+    while (state.Run()) {
+        if (cold) EvictFromPageCache(files);
+        for (const CatalogEntry& entry : files) ProbeImageFile(entry.path, probe);
+        DoNotOptimize(probe.width);
+    }
+    state.SetItemsPerIteration(files.size());
+}
+
+// Head and tail reads in flight together; parsing on the completing thread, like hdrscan does
+// on its pool. Depth 8 already keeps a local drive busy; deeper queues only pay off on shares.
+void ProbeAsync(BenchState& state, const std::vector<CatalogEntry>& files, AsyncIoBackend backend, bool cold = false)
+{
+    AsyncFileReader reader(8, static_cast<uint32_t>(kProbeHeadBytes), backend);
+    if (backend != AsyncIoBackend::Auto && reader.Backend() != backend) {
+        state.Skip(std::string(AsyncIoBackendName(backend)) + " not available");
+        return;
+    }
+    std::vector<AsyncReadRequest> requests;
+    for (size_t i = 0; i < files.size(); ++i) {
+        requests.push_back({ files[i].path, 0, static_cast<uint32_t>(kProbeHeadBytes), 2 * i });
+        if (files[i].fileSize > kProbeHeadBytes) requests.push_back({ files[i].path, files[i].fileSize - 2, 2, 2 * i + 1 });
+    }
+    struct ReadAhead {
+        std::vector<uint8_t> head;
+        uint8_t tail[2] = {};
+        uint32_t tailSize = 0;
+        int parts = 0;
+    };
+    std::vector<ReadAhead> ahead(files.size());
+    ImageProbe probe;
+    while (state.Run()) {
+        if (cold) EvictFromPageCache(files);
+        for (size_t i = 0; i < files.size(); ++i) ahead[i].parts = files[i].fileSize > kProbeHeadBytes ? 2 : 1;
+        reader.ReadAll(requests, [&](const AsyncReadResult& result) {
+            const size_t i = result.tag / 2;
+            ReadAhead& a = ahead[i];
+            if (result.tag & 1) {
+                a.tailSize = std::min<uint32_t>(result.size, 2);
+                std::copy(result.data, result.data + a.tailSize, a.tail);
+            } else {
+                a.head.assign(result.data, result.data + result.size);
+            }
+            if (--a.parts > 0) return;
+            std::vector<ProbeRange> tail;
+            if (a.tailSize == 2) tail.push_back({ files[i].fileSize - 2, a.tail, 2 });
+            ProbeImageHead(files[i].path, files[i].fileSize, std::move(a.head), tail, probe);
+        });
+        DoNotOptimize(probe.width);
+    }
+    state.SetItemsPerIteration(files.size());
+}
+
+} // namespace
+
+HDR_BENCH("io/probe-headers/ifstream-sequential")
+{
+    ProbeSequential(state, ProbeFolder());
+}
+
+HDR_BENCH("io/probe-headers/async-threads")
+{
+    ProbeAsync(state, ProbeFolder(), AsyncIoBackend::Threads);
+}
+
+#ifdef __linux__
+HDR_BENCH("io/probe-headers/async-io_uring")
+{
+    ProbeAsync(state, ProbeFolder(), AsyncIoBackend::IoUring);
+}
+
+HDR_BENCH("io/probe-headers/cold-ifstream-sequential")
+{
+    ProbeSequential(state, ProbeFolder(), true);
+}
+
+HDR_BENCH("io/probe-headers/cold-async-threads")
+{
+    ProbeAsync(state, ProbeFolder(), AsyncIoBackend::Threads, true);
+}
+
+HDR_BENCH("io/probe-headers/cold-async-io_uring")
+{
+    ProbeAsync(state, ProbeFolder(), AsyncIoBackend::IoUring, true);
+}
+#endif
+
+#ifdef _WIN32
+HDR_BENCH("io/probe-headers/async-overlapped")
+{
+    ProbeAsync(state, ProbeFolder(), AsyncIoBackend::Overlapped);
+}
+#endif
+
+HDR_BENCH("io/probe-headers/corpus-ifstream-sequential")
+{
+    const std::vector<CatalogEntry> files = CorpusFiles();
+    if (files.empty()) { state.Skip("needs --corpus"); return; }
+    ProbeSequential(state, files);
+}
+
+HDR_BENCH("io/probe-headers/corpus-async")
+{
+    const std::vector<CatalogEntry> files = CorpusFiles();
+    if (files.empty()) { state.Skip("needs --corpus"); return; }
+    ProbeAsync(state, files, AsyncIoBackend::Auto);
+}
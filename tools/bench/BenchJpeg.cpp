@@ -0,0 +1,291 @@
+// BenchJpeg.cpp - JPEG decode (serial and across restart intervals) / encode, MPF parsing, header
+// probing, downscaling, rendition baking and HDR rendering (serial and as a task graph)
+
+#include "Bench.h"
+#include "HdrRender.h"
+#include "ImageProbe.h"
+#include "ImageResize.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "PixelBufferPool.h"
+#include "Rendition.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+// Smooth gradients plus fine texture, roughly the coefficient density of a photo
+PlanarImage SyntheticPhoto(int width, int height)
+{
+    PlanarImage image;
+    image.Allocate(width, height, 3);
+    uint32_t noise = 1;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            noise = noise * 1664525u + 1013904223u;
+            const size_t i = static_cast<size_t>(y) * width + x;
+            image.planes[0][i] = static_cast<uint8_t>(128 + 90 * std::sin(x * 0.011) * std::cos(y * 0.017) + static_cast<int>(noise >> 29) - 4);
+            image.planes[1][i] = static_cast<uint8_t>(128 + 40 * std::sin(x * 0.003 + y * 0.002));
+            image.planes[2][i] = static_cast<uint8_t>(128 + 40 * std::cos(y * 0.004));
+        }
+    }
+    return image;
+}
+
+std::vector<uint8_t> EncodeSynthetic(int width, int height, int quality)
+{
+    JpegEncodeOptions options;
+    options.quality = quality;
+    std::vector<uint8_t> out;
+    EncodeJpeg(SyntheticPhoto(width, height), options, out);
+    return out;
+}
+
+// A 24 MP camera export with a quarter resolution gain map, laid out like an Ultra HDR file
+const std::vector<uint8_t>& UltraHdr24MP()
+{
+    static const std::vector<uint8_t> file = [] {
+        PlanarImage map;
+        map.Allocate(1500, 1000, 1);
+        for (size_t i = 0; i < map.planes[0].size(); ++i) map.planes[0][i] = static_cast<uint8_t>(i * 7);
+        JpegEncodeOptions mapOptions;
+        mapOptions.subsampleChroma = false;
+        mapOptions.segments.push_back(BuildXmpSegment("<x:xmpmeta><rdf:Description hdrgm:Version=\"1.0\" hdrgm:GainMapMax=\"2.0\"/></x:xmpmeta>"));
+        std::vector<uint8_t> gainMap;
+        EncodeJpeg(map, mapOptions, gainMap);
+
+        JpegEncodeOptions options;
+        options.quality = 95;
+        options.segments.push_back(BuildMpfSegment(0, 0, 0));
+        std::vector<uint8_t> out;
+        EncodeJpeg(SyntheticPhoto(6000, 4000), options, out);
+        const std::vector<uint8_t> mpf = BuildMpfSegment(static_cast<uint32_t>(out.size()), static_cast<uint32_t>(gainMap.size()),
+                                                         static_cast<uint32_t>(out.size() - (2 + kMpfTiffHeaderOffset)));
+        std::copy(mpf.begin(), mpf.end(), out.begin() + 2);
+        out.insert(out.end(), gainMap.begin(), gainMap.end());
+        return out;
+    }();
+    return file;
+}
+
+// A 24 MP export with a restart marker after every MCU row, as Lightroom writes them
+const std::vector<uint8_t>& Restart24MP()
+{
+    static const std::vector<uint8_t> file = [] {
+        JpegEncodeOptions options;
+        options.quality = 95;
+        options.restartInterval = 6000 / 16;
+        std::vector<uint8_t> out;
+        EncodeJpeg(SyntheticPhoto(6000, 4000), options, out);
+        return out;
+    }();
+    return file;
+}
+
+// Latency of one decode against the thread count; without restart markers it stays serial
+void DecodeThreads(BenchState& state, const std::vector<uint8_t>& file, int threads)
+{
+    // The calling thread decodes one share
+    WorkerPool pool(static_cast<unsigned>(std::max(1, threads - 1)));
+    JpegDecodeOptions options;
+    options.threads = threads;
+    options.pool = &pool;
+    PlanarImage image;
+    while (state.Run()) {
+        DecodeJpeg(file.data(), file.size(), options, image);
+        DoNotOptimize(image.planes[0].data());
+    }
+    state.SetBytesPerIteration(file.size());
+    state.SetItemsPerIteration(1);
+}
+
+} // namespace
+
+HDR_BENCH("jpeg/DecodeJpeg/4k-420")
+{
+    static const std::vector<uint8_t> file = EncodeSynthetic(3840, 2160, 90);
+    PlanarImage image;
+    while (state.Run()) {
+        DecodeJpeg(file.data(), file.size(), image);
+        DoNotOptimize(image.planes[0].data());
+    }
+    state.SetBytesPerIteration(file.size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("jpeg/DecodeJpeg/24MP-restart/threads:1")
+{
+    DecodeThreads(state, Restart24MP(), 1);
+}
+
+HDR_BENCH("jpeg/DecodeJpeg/24MP-restart/threads:2")
+{
+    DecodeThreads(state, Restart24MP(), 2);
+}
+
+HDR_BENCH("jpeg/DecodeJpeg/24MP-restart/threads:4")
+{
+    DecodeThreads(state, Restart24MP(), 4);
+}
+
+HDR_BENCH("jpeg/DecodeJpeg/24MP-restart/threads:8")
+{
+    DecodeThreads(state, Restart24MP(), 8);
+}
+
+HDR_BENCH("jpeg/DecodeJpeg/24MP-ultrahdr/threads:4")
+{
+    DecodeThreads(state, UltraHdr24MP(), 4);
+}
+
+HDR_BENCH("jpeg/EncodeJpeg/4k-420")
+{
+    static const PlanarImage image = SyntheticPhoto(3840, 2160);
+    JpegEncodeOptions options;
+    std::vector<uint8_t> out;
+    while (state.Run()) {
+        EncodeJpeg(image, options, out);
+        DoNotOptimize(out.data());
+    }
+    state.SetBytesPerIteration(out.size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("jpeg/ReadMpfImages")
+{
+    const std::vector<uint8_t>& file = UltraHdr24MP();
+    std::vector<MpfImage> images;
+    while (state.Run()) {
+        ReadMpfImages(file.data(), file.size(), images);
+        DoNotOptimize(images.data());
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("probe/ProbeImageData/24MP-ultrahdr")
+{
+    const std::vector<uint8_t>& file = UltraHdr24MP();
+    ImageProbe probe;
+    while (state.Run()) {
+        ProbeImageData(file.data(), file.size(), probe);
+        DoNotOptimize(probe.gainMap);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("resize/area/24MP-to-4k")
+{
+    static const PlanarImage source = SyntheticPhoto(6000, 4000);
+    std::vector<uint8_t> out(3240 * 2160);
+    while (state.Run()) {
+        ResizePlaneArea(source.planes[0].data(), source.width, source.height, out.data(), 3240, 2160);
+        DoNotOptimize(out.data());
+    }
+    state.SetBytesPerIteration(source.planes[0].size());
+}
+
+// Page faults per bake show what the pixel buffer pool saves: without it every decoded plane
+// is fresh memory
+static void BakeUltraHdr24MP(BenchState& state, bool pooled)
+{
+    const std::vector<uint8_t>& file = UltraHdr24MP();
+    PixelBufferPool::Instance().SetEnabled(pooled);
+    std::vector<uint8_t> out;
+    const uint64_t faults = BenchPageFaults();
+    while (state.Run()) {
+        DoNotOptimize(BakeRendition(file.data(), file.size(), BakeOptions(), out).status);
+    }
+    state.SetCounter("faults", static_cast<double>(BenchPageFaults() - faults) / static_cast<double>(state.Iterations()));
+    PixelBufferPool::Instance().SetEnabled(true);
+    state.SetBytesPerIteration(file.size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("rendition/BakeRendition/24MP-ultrahdr")
+{
+    BakeUltraHdr24MP(state, true);
+}
+
+HDR_BENCH("rendition/BakeRendition/24MP-ultrahdr-no-pool")
+{
+    BakeUltraHdr24MP(state, false);
+}
+
+// Serial stages against the task graph on a pool. critical_ms is the graph's longest chain of
+// dependent stages, the latency once there are enough cores; stages_ms their serial sum.
+static void RenderUltraHdr24MP(BenchState& state, WorkerPool* pool)
+{
+    const std::vector<uint8_t>& file = UltraHdr24MP();
+    HdrRenderOptions options;
+    options.pool = pool;
+    HdrImage image;
+    HdrRenderInfo info;
+    while (state.Run()) {
+        DoNotOptimize(RenderHdrImage(file.data(), file.size(), options, image, &info));
+    }
+    const HdrRenderTimings& t = info.timings;
+    state.SetCounter("decode_ms", t.decodeMs);
+    state.SetCounter("color_ms", t.colorMs);
+    state.SetCounter("gainmap_ms", t.gainMapMs);
+    state.SetCounter("stages_ms", t.parseMs + t.decodeMs + t.colorMs + t.gainMapMs);
+    state.SetCounter("critical_ms", t.criticalPathMs);
+    state.SetBytesPerIteration(file.size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("render/RenderHdrImage/24MP-ultrahdr")
+{
+    RenderUltraHdr24MP(state, nullptr);
+}
+
+HDR_BENCH("render/RenderHdrImage/24MP-ultrahdr/graph-4")
+{
+    WorkerPool pool(3);
+    RenderUltraHdr24MP(state, &pool);
+}
+
+// Time from the cancel flag (the viewer skipped ahead) to RenderHdrImage returning, with the
+// flag set 20 ms in, during the base image decode
+HDR_BENCH("render/RenderHdrImage/24MP-ultrahdr/cancel")
+{
+    const std::vector<uint8_t>& file = UltraHdr24MP();
+    double cancelMs = 0;
+    while (state.Run()) {
+        std::atomic<bool> cancel{ false };
+        HdrRenderOptions options;
+        options.cancel = &cancel;
+        std::chrono::steady_clock::time_point done;
+        std::thread render([&] {
+            HdrImage image;
+            DoNotOptimize(RenderHdrImage(file.data(), file.size(), options, image));
+            done = std::chrono::steady_clock::now();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const auto set = std::chrono::steady_clock::now();
+        cancel = true;
+        render.join();
+        cancelMs = std::max(cancelMs, std::chrono::duration<double, std::milli>(done - set).count());
+    }
+    state.SetCounter("worst_cancel_ms", cancelMs);
+}
+
+HDR_BENCH("render/EncodePqPng/24MP")
+{
+    HdrImage image;
+    if (!RenderHdrImage(UltraHdr24MP().data(), UltraHdr24MP().size(), HdrRenderOptions(), image)) {
+        state.Skip("render failed");
+        return;
+    }
+    std::vector<uint8_t> out;
+    while (state.Run()) {
+        EncodePqPng(image, 203.0f, out);
+        DoNotOptimize(out.data());
+    }
+    state.SetBytesPerIteration(image.rgb.size() * sizeof(float));
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,83 @@
+// BenchLogging.cpp - cost of log call sites and metric updates on hot paths
+
+#include "Bench.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+namespace {
+
+// Points the logger at a scratch file for one benchmark and turns file logging off afterwards
+struct ScopedLogFile {
+    ScopedLogFile(const char* name, bool binary, LogLevel level) {
+        Logger::Instance().SetLevel(level);
+        Logger::Instance().Configure(true, (BenchScratchDir() / name).wstring(), binary);
+    }
+    ~ScopedLogFile() {
+        Logger::Instance().Configure(false, L"");
+        Logger::Instance().SetLevel(LogLevel::Info);
+    }
+};
+
+} // namespace
+
+HDR_BENCH("log/LOG_FMT/filtered")
+{
+    ScopedLogFile log("filtered.log", false, LogLevel::Info);
+    const std::wstring path = L"C:/Photos/2024/IMG_0001.jpg";
+    int i = 0;
+    while (state.Run()) {
+        LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"WebView2Mode: NavigationStarting -> {} ({})", path, ++i);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("log/LOG_FMT/binary")
+{
+    ScopedLogFile log("bench.hdrlog", true, LogLevel::Debug);
+    const std::wstring path = L"C:/Photos/2024/IMG_0001.jpg";
+    int i = 0;
+    while (state.Run()) {
+        LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"WebView2Mode: NavigationStarting -> {} ({})", path, ++i);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("log/LOG_FMT/text")
+{
+    ScopedLogFile log("bench.log", false, LogLevel::Debug);
+    const std::wstring path = L"C:/Photos/2024/IMG_0001.jpg";
+    int i = 0;
+    while (state.Run()) {
+        LOG_FMT(LogLevel::Debug, LogCategory::Navigation, L"WebView2Mode: NavigationStarting -> {} ({})", path, ++i);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("log/LOG_MSG/text")
+{
+    ScopedLogFile log("bench-msg.log", false, LogLevel::Info);
+    const std::wstring path = L"C:/Photos/2024/IMG_0001.jpg";
+    while (state.Run()) {
+        LOG_MSG(L"WebView2Mode: Showing ", path);
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("metrics/Counter::Add")
+{
+    Counter& counter = Metrics::Instance().GetCounter("hdrbench_counter_total", "Benchmark counter");
+    while (state.Run()) counter.Add();
+    DoNotOptimize(counter.Value());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("metrics/Histogram::Record")
+{
+    Histogram& histogram = Metrics::Instance().GetHistogram("hdrbench_latency_us", "Benchmark histogram");
+    uint64_t value = 1;
+    while (state.Run()) {
+        histogram.Record(value);
+        value = (value * 7 + 13) & 0xFFFFF;
+    }
+    state.SetItemsPerIteration(1);
+}
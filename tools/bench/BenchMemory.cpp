@@ -0,0 +1,88 @@
+// BenchMemory.cpp - the memory governor splitting one budget between an encoded image cache, a
+// decoded frame cache and a catalog, and reacting to memory pressure read from a PSI file
+
+#include "Bench.h"
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "MemoryGovernor.h"
+
+#include <fstream>
+
+namespace {
+
+const uint64_t kBudget = uint64_t(64) << 20;
+const size_t kImages = 96;
+
+void WritePsi(const std::filesystem::path& path, double some, double full)
+{
+    std::ofstream out(path, std::ios::trunc);
+    out << "some avg10=" << some << " avg60=0.00 avg300=0.00 total=0\n"
+        << "full avg10=" << full << " avg60=0.00 avg300=0.00 total=0\n";
+}
+
+// Both caches offered every image, 1 MB each; the bytes are shared, the caches count them apart
+void Fill(ImageCache& encoded, ImageCache& decoded, const std::vector<std::shared_ptr<const ImageData>>& images)
+{
+    for (size_t i = 0; i < kImages; ++i) {
+        encoded.Put(i, images[i % images.size()]);
+        decoded.Put(i, images[i % images.size()]);
+    }
+}
+
+double Megabytes(uint64_t bytes)
+{
+    return bytes / 1048576.0;
+}
+
+} // namespace
+
+// One pressure episode: critical, then relieved, with the caches refilled. The counters give
+// the memory held: two caches each sized to the budget on their own, then under the governor
+// without pressure, under moderate and under critical pressure.
+HDR_BENCH("memory/MemoryGovernor/pressure-cycle")
+{
+    const std::filesystem::path psi = BenchScratchDir() / "memory-pressure";
+    WritePsi(psi, 0, 0);
+    std::vector<std::shared_ptr<const ImageData>> images;
+    for (int i = 0; i < 8; ++i) {
+        auto image = std::make_shared<ImageData>();
+        image->bytes.assign(size_t(1) << 20, static_cast<uint8_t>(i));
+        images.push_back(std::move(image));
+    }
+    std::vector<std::wstring> paths;
+    for (size_t i = 0; i < 100000; ++i) paths.push_back(L"D:/Photos/2024/event-" + std::to_wstring(i / 500) + L"/IMG_" + std::to_wstring(i) + L".jpg");
+    const ImageCatalog catalog(paths);
+
+    ImageCache encoded(kBudget), decoded(kBudget);
+    Fill(encoded, decoded, images);
+    const uint64_t ungoverned = encoded.BytesUsed() + decoded.BytesUsed() + catalog.MemoryBytes();
+
+    MemoryGovernor governor(kBudget);
+    governor.SetPollInterval(std::chrono::milliseconds(0));
+    governor.SetPressureSource([&psi] { return MemoryGovernor::ReadPsi(psi); });
+    governor.Register({ "catalog", MemoryPriority::Working, 0, 0, UINT64_MAX, [&catalog] { return static_cast<uint64_t>(catalog.MemoryBytes()); }, nullptr });
+    governor.Register({ "encoded", MemoryPriority::Prefetch, 20.0, uint64_t(4) << 20, UINT64_MAX, [&encoded] { return encoded.BytesUsed(); },
+                        [&encoded](uint64_t bytes) { encoded.SetBudget(bytes); } });
+    governor.Register({ "decoded", MemoryPriority::Idle, 2.0, 0, UINT64_MAX, [&decoded] { return decoded.BytesUsed(); },
+                        [&decoded](uint64_t bytes) { decoded.SetBudget(bytes); } });
+    auto settle = [&](double some, double full) {
+        WritePsi(psi, some, full);
+        governor.Poll(MemoryGovernor::Clock::now());
+        Fill(encoded, decoded, images);
+        governor.Poll(MemoryGovernor::Clock::now());
+        return governor.UsedBytes();
+    };
+    const uint64_t governed = settle(0, 0);
+    const uint64_t moderate = settle(25, 0);
+    const uint64_t critical = settle(60, 30);
+    settle(0, 0);
+
+    while (state.Run()) {
+        DoNotOptimize(settle(60, 30));
+        DoNotOptimize(settle(0, 0));
+    }
+    state.SetCounter("ungoverned-MB", Megabytes(ungoverned));
+    state.SetCounter("governed-MB", Megabytes(governed));
+    state.SetCounter("moderate-MB", Megabytes(moderate));
+    state.SetCounter("critical-MB", Megabytes(critical));
+}
@@ -0,0 +1,62 @@
+// BenchPool.cpp - the buffers of one full resolution slide, from the heap and from PixelBufferPool
+
+#include "Bench.h"
+#include "PixelBufferPool.h"
+
+namespace {
+
+// A 24 MP slide on the gain-map path: the decoded Y, Cb and Cr planes, the quarter resolution
+// gain map and the RGBA16F frame they are composed into
+const size_t kPixels = 6000 * 4000;
+const size_t kSlideBuffers[] = { kPixels, kPixels, kPixels, kPixels / 16, kPixels * 8 };
+
+// Acquires the buffers, writes one byte per page the way the first pass of a decoder would
+// fault them in, and releases them again. The counters tell page faults and the time per slide
+// that went to allocation and faulting rather than pixels.
+void SlideBuffers(BenchState& state, bool pooled)
+{
+    PixelBufferPool::Instance().SetEnabled(pooled);
+    uint64_t total = 0;
+    for (size_t bytes : kSlideBuffers) total += bytes;
+    const uint64_t faults = BenchPageFaults();
+    while (state.Run()) {
+        PixelPlane buffers[std::size(kSlideBuffers)];
+        for (size_t i = 0; i < std::size(kSlideBuffers); ++i) {
+            PixelPlane(kSlideBuffers[i]).swap(buffers[i]);
+            uint8_t* data = buffers[i].data();
+            for (size_t offset = 0; offset < kSlideBuffers[i]; offset += 4096) data[offset] = static_cast<uint8_t>(offset);
+            DoNotOptimize(data);
+        }
+    }
+    state.SetCounter("faults", static_cast<double>(BenchPageFaults() - faults) / static_cast<double>(state.Iterations()));
+    const PixelPoolStats stats = PixelBufferPool::Instance().Stats();
+    if (pooled) state.SetCounter("pool-MB", static_cast<double>(stats.mappedBytes) / (1024.0 * 1024.0));
+    PixelBufferPool::Instance().SetEnabled(true);
+    state.SetBytesPerIteration(total);
+    state.SetItemsPerIteration(1);
+}
+
+} // namespace
+
+HDR_BENCH("pixelpool/slide-buffers/24MP-gainmap-heap")
+{
+    SlideBuffers(state, false);
+}
+
+HDR_BENCH("pixelpool/slide-buffers/24MP-gainmap-pooled")
+{
+    SlideBuffers(state, true);
+}
+
+// Releasing and reacquiring a class that is idle; the cost every pooled plane pays per slide
+HDR_BENCH("pixelpool/PixelBufferPool/reuse-24MB")
+{
+    PixelBufferPool& pool = PixelBufferPool::Instance();
+    pool.Release(pool.Acquire(kPixels), kPixels);
+    while (state.Run()) {
+        void* data = pool.Acquire(kPixels);
+        DoNotOptimize(data);
+        pool.Release(data, kPixels);
+    }
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,169 @@
+// BenchRegion.cpp - zoom and pan over a 200 MP Ultra HDR panorama: full decode against region
+// decoded tiles, with peak memory and the latency of each pan step
+//
+// The primary image has no restart markers (the usual stitcher output), so its index takes an
+// entropy decoding pass; the gain map has one restart marker per MCU row and is indexed from them.
+
+#include "Bench.h"
+#include "JpegCodec.h"
+#include "JpegFile.h"
+#include "PixelBufferPool.h"
+#include "TiledImage.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const int kWidth = 20000;
+const int kHeight = 10000;
+const uint64_t kTileBudget = 256ull * 1024 * 1024;
+
+// Smooth gradients plus fine texture, as in the JPEG cases, built from row and column tables so
+// that 200 MP stay quick to generate
+PlanarImage SyntheticPanorama(int width, int height, int channels)
+{
+    std::vector<float> columns(static_cast<size_t>(width)), rows(static_cast<size_t>(height));
+    for (int x = 0; x < width; ++x) columns[x] = static_cast<float>(std::sin(x * 0.011));
+    for (int y = 0; y < height; ++y) rows[y] = static_cast<float>(std::cos(y * 0.017));
+    PlanarImage image;
+    image.Allocate(width, height, channels);
+    uint32_t noise = 1;
+    for (int y = 0; y < height; ++y) {
+        uint8_t* luma = image.planes[0].data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            noise = noise * 1664525u + 1013904223u;
+            luma[x] = static_cast<uint8_t>(128 + 90 * columns[x] * rows[y] + static_cast<int>(noise >> 29) - 4);
+        }
+        for (int c = 1; c < channels; ++c) {
+            uint8_t* chroma = image.planes[c].data() + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; ++x) chroma[x] = static_cast<uint8_t>(128 + 40 * (c == 1 ? columns[x / 4] : rows[y / 4]));
+        }
+    }
+    return image;
+}
+
+const std::shared_ptr<const std::vector<uint8_t>>& Panorama200MP()
+{
+    static const std::shared_ptr<const std::vector<uint8_t>> file = [] {
+        JpegEncodeOptions mapOptions;
+        mapOptions.restartInterval = kWidth / 4 / 8;
+        mapOptions.segments.push_back(BuildXmpSegment("<x:xmpmeta><rdf:Description hdrgm:Version=\"1.0\" hdrgm:GainMapMax=\"2.0\"/></x:xmpmeta>"));
+        std::vector<uint8_t> gainMap;
+        EncodeJpeg(SyntheticPanorama(kWidth / 4, kHeight / 4, 1), mapOptions, gainMap);
+
+        JpegEncodeOptions options;
+        options.segments.push_back(BuildMpfSegment(0, 0, 0));
+        auto out = std::make_shared<std::vector<uint8_t>>();
+        EncodeJpeg(SyntheticPanorama(kWidth, kHeight, 3), options, *out);
+        const std::vector<uint8_t> mpf = BuildMpfSegment(static_cast<uint32_t>(out->size()), static_cast<uint32_t>(gainMap.size()),
+                                                         static_cast<uint32_t>(out->size() - (2 + kMpfTiffHeaderOffset)));
+        std::copy(mpf.begin(), mpf.end(), out->begin() + 2);
+        out->insert(out->end(), gainMap.begin(), gainMap.end());
+        PixelBufferPool::Instance().Trim();
+        return out;
+    }();
+    return file;
+}
+
+// Memory the measured work added on top of what the process held before it
+struct PeakMemory {
+    uint64_t before;
+    PeakMemory() {
+        PixelBufferPool::Instance().Trim();
+        BenchResetPeakMemory();
+        before = BenchResidentBytes();
+    }
+    void Report(BenchState& state) const {
+        const uint64_t peak = BenchPeakResidentBytes();
+        if (peak > before) state.SetCounter("peak-MB", static_cast<double>(peak - before) / (1024.0 * 1024.0));
+    }
+};
+
+// Pans a 1920x1080 window in raster order, `step` screen pixels per frame. Each iteration is
+// one frame: the visible tiles are fetched (the latency the viewer sees) and, with a pool, the
+// tiles ahead are decoded before the next frame.
+void Pan(BenchState& state, double zoom, bool prefetch)
+{
+    const std::shared_ptr<const std::vector<uint8_t>>& file = Panorama200MP();
+    WorkerPool pool(1);
+    PeakMemory memory;
+    TiledImage tiles(kTileBudget, prefetch ? &pool : nullptr);
+    if (!tiles.Open(file)) { state.Skip("cannot open the panorama"); return; }
+    Viewport view;
+    view.width = std::min<double>(kWidth, 1920 / zoom);
+    view.height = std::min<double>(kHeight, 1080 / zoom);
+    view.zoom = zoom;
+    const double step = 64 / zoom;
+    tiles.Visible(view);
+    const TiledImageStats start = tiles.Stats();
+    double visibleNs = 0;
+    while (state.Run()) {
+        double dx = step, dy = 0;
+        if (view.x + view.width + step > kWidth) {
+            dx = -view.x;
+            dy = view.y + 2 * view.height > kHeight ? -view.y : view.height;
+        }
+        view.x += dx;
+        view.y += dy;
+        const auto begin = std::chrono::steady_clock::now();
+        DoNotOptimize(tiles.Visible(view).size());
+        visibleNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        tiles.Prefetch(view, dx, dy);
+        tiles.WaitPrefetch();
+    }
+    const TiledImageStats stats = tiles.Stats();
+    const double frames = static_cast<double>(state.Iterations());
+    state.SetCounter("visible-ms", visibleNs / frames / 1e6);
+    state.SetCounter("missed-tiles", static_cast<double>(stats.decoded - start.decoded) / frames);
+    memory.Report(state);
+    state.SetItemsPerIteration(1);
+}
+
+} // namespace
+
+// What zooming costs without region decoding: both layers decoded whole
+HDR_BENCH("region/200MP-ultrahdr/DecodeJpeg-full")
+{
+    const std::shared_ptr<const std::vector<uint8_t>>& file = Panorama200MP();
+    std::vector<MpfImage> images;
+    ReadMpfImages(file->data(), file->size(), images);
+    PeakMemory memory;
+    {
+        PlanarImage image, gainMap;
+        while (state.Run()) {
+            DecodeJpeg(file->data(), images[0].size, image);
+            DecodeJpeg(file->data() + images[1].offset, images[1].size, gainMap);
+        }
+        memory.Report(state);
+    }
+    PixelBufferPool::Instance().Trim();
+    state.SetBytesPerIteration(file->size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("region/200MP-ultrahdr/TiledImage::Open")
+{
+    const std::shared_ptr<const std::vector<uint8_t>>& file = Panorama200MP();
+    TiledImage tiles(kTileBudget);
+    while (state.Run()) DoNotOptimize(tiles.Open(file));
+    state.SetCounter("index-KB", static_cast<double>(tiles.IndexBytes()) / 1024.0);
+    state.SetBytesPerIteration(file->size());
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("region/200MP-ultrahdr/pan-1080p-100%")
+{
+    Pan(state, 1.0, false);
+}
+
+HDR_BENCH("region/200MP-ultrahdr/pan-1080p-100%-prefetch")
+{
+    Pan(state, 1.0, true);
+}
+
+HDR_BENCH("region/200MP-ultrahdr/pan-1080p-fit-height")
+{
+    Pan(state, 1080.0 / kHeight, true);
+}
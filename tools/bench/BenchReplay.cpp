@@ -0,0 +1,84 @@
+// BenchReplay.cpp - replays a navigation trace: ten seconds of a held right arrow through a
+// catalog whose images take a few milliseconds each to load
+
+#include "Bench.h"
+#include "InputTrace.h"
+
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+// Key repeat at about 30 per second, the way a held arrow key arrives, on one 4k output
+InputTrace HeldArrowTrace(std::chrono::seconds duration, size_t catalogSize)
+{
+    InputTrace trace;
+    trace.root = L"bench";
+    trace.cacheBytes = uint64_t(256) << 20;
+    trace.catalogSize = catalogSize;
+    SlideOutputConfig config;
+    config.name = L"virtual0";
+    config.width = 3840;
+    config.height = 2160;
+    trace.outputs.push_back(config);
+    trace.events.push_back({ std::chrono::microseconds(0), TraceEventKind::Advance, 0, 0 });
+    const auto repeat = std::chrono::microseconds(33333);
+    for (uint64_t i = 1; repeat * i <= duration; ++i) {
+        trace.events.push_back({ repeat * i, TraceEventKind::Next, 0, i % catalogSize });
+    }
+    return trace;
+}
+
+void Replay(BenchState& state, double speed)
+{
+    const InputTrace trace = HeldArrowTrace(std::chrono::seconds(10), 1000);
+    ImageCatalog catalog;
+    for (size_t i = 0; i < trace.catalogSize; ++i) catalog.Add({ L"bench/IMG_" + std::to_wstring(i) + L".jpg", 4 << 20 });
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(64 * 1024);
+    // A load that waits like a read plus decode, without using the CPU the replay measures on
+    Slideshow::LoadFunction load = [data](const CatalogEntry&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return std::shared_ptr<const ImageData>(data);
+    };
+    ReplayOptions options;
+    options.speed = speed;
+    ReplayResult result;
+    while (state.Run()) {
+        WorkerPool pool(2);
+        ImageCache cache(trace.cacheBytes);
+        ReplayInputTrace(trace, catalog, cache, pool, load, options, result);
+    }
+    state.SetItemsPerIteration(trace.events.size());
+    state.SetCounter("p50_ms", result.Percentile(TraceEventKind::Next, 0.5).count() / 1000.0);
+    state.SetCounter("p99_ms", result.Percentile(TraceEventKind::Next, 0.99).count() / 1000.0);
+    state.SetCounter("diverged", static_cast<double>(result.divergences));
+}
+
+} // namespace
+
+// Back to back: every press waits for its slide's load, prefetching never gets ahead
+HDR_BENCH("replay/held-arrow-10s/virtual")
+{
+    Replay(state, 0);
+}
+
+// Recorded pacing at 10x, a press every 3.3 ms: prefetch keeps up only part of the time
+HDR_BENCH("replay/held-arrow-10s/paced-10x")
+{
+    Replay(state, 10);
+}
+
+HDR_BENCH("replay/trace/Save+Load")
+{
+    const InputTrace trace = HeldArrowTrace(std::chrono::seconds(10), 1000);
+    const std::filesystem::path path = BenchScratchDir() / "held-arrow.hdrtrace";
+    InputTrace loaded;
+    while (state.Run()) {
+        trace.Save(path);
+        loaded.Load(path);
+        DoNotOptimize(loaded.events.data());
+    }
+    state.SetItemsPerIteration(trace.events.size());
+    state.SetCounter("bytes_per_event", static_cast<double>(std::filesystem::file_size(path)) / static_cast<double>(trace.events.size()));
+}
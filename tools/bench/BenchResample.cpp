@@ -0,0 +1,186 @@
+// BenchResample.cpp - linear light resampling to display size: SIMD kernels against the scalar
+// reference, thread strips, the gain map upsample, and each filter's passband and aliasing
+
+#include "Bench.h"
+#include "ImageResize.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Smooth shading with fine detail and a few highlights far above SDR white
+const HdrImage& LinearPhoto24MP()
+{
+    static const HdrImage image = [] {
+        HdrImage im;
+        im.Allocate(6000, 4000);
+        for (int y = 0; y < im.height; ++y) {
+            float* row = im.rgb.data() + static_cast<size_t>(y) * im.width * 3;
+            for (int x = 0; x < im.width; ++x) {
+                const float base = 0.4f + 0.3f * std::sin(x * 0.011f) * std::cos(y * 0.017f);
+                const float detail = ((x * 7 + y * 13) % 17) * 0.01f;
+                const float highlight = (x % 500 < 8 && y % 400 < 8) ? 8.0f : 0.0f;
+                row[x * 3] = base + detail + highlight;
+                row[x * 3 + 1] = base * 0.9f + highlight;
+                row[x * 3 + 2] = base * 0.7f + detail + highlight;
+            }
+        }
+        return im;
+    }();
+    return image;
+}
+
+void Resample(BenchState& state, const HdrImage& src, int width, int height, ResampleFilter filter, bool simd, int threads)
+{
+    ResampleOptions options;
+    options.filter = filter;
+    options.simd = simd;
+    options.threads = threads;
+    // The calling thread resamples one strip
+    WorkerPool pool(static_cast<unsigned>(std::max(1, threads - 1)));
+    options.pool = &pool;
+    HdrImage dst;
+    while (state.Run()) {
+        ResampleHdrImage(src, width, height, options, dst);
+        DoNotOptimize(dst.rgb.data());
+    }
+    state.SetItemsPerIteration(static_cast<uint64_t>(width) * height);    // output pixels
+    state.SetBytesPerIteration(src.rgb.size() * sizeof(float));
+}
+
+// Output amplitude of a horizontal sine of `period` source pixels, 6000 -> 3840 wide, relative
+// to the input's: 1 in the passband, 0 for frequencies the output cannot hold
+double Response(ResampleFilter filter, double period)
+{
+    HdrImage src;
+    src.Allocate(6000, 4);
+    for (int y = 0; y < src.height; ++y) {
+        for (int x = 0; x < src.width; ++x) {
+            const float v = 1.0f + 0.5f * static_cast<float>(std::sin(2 * 3.14159265358979 * x / period));
+            for (int c = 0; c < 3; ++c) src.rgb[(static_cast<size_t>(y) * src.width + x) * 3 + c] = v;
+        }
+    }
+    ResampleOptions options;
+    options.filter = filter;
+    HdrImage dst;
+    ResampleHdrImage(src, 3840, 4, options, dst);
+    double sum = 0;
+    const int margin = 16;    // away from the clamped edges
+    for (int x = margin; x < dst.width - margin; ++x) sum += (dst.rgb[static_cast<size_t>(x) * 3] - 1.0) * (dst.rgb[static_cast<size_t>(x) * 3] - 1.0);
+    return std::sqrt(sum / (dst.width - 2 * margin)) / (0.5 / std::sqrt(2.0));
+}
+
+void Quality(BenchState& state, ResampleFilter filter)
+{
+    const HdrImage& src = LinearPhoto24MP();
+    ResampleOptions options;
+    options.filter = filter;
+    HdrImage simd, scalar;
+    while (state.Run()) {
+        ResampleHdrImage(src, 3840, 2160, options, simd);
+        DoNotOptimize(simd.rgb.data());
+    }
+    options.simd = false;
+    ResampleHdrImage(src, 3840, 2160, options, scalar);
+    double difference = 0, peak = 0;
+    for (size_t i = 0; i < simd.rgb.size(); ++i) {
+        difference = std::max(difference, static_cast<double>(std::fabs(simd.rgb[i] - scalar.rgb[i])));
+        peak = std::max(peak, static_cast<double>(scalar.rgb[i]));
+    }
+    // The output's Nyquist period is 2 * 6000 / 3840 = 3.125 source pixels
+    state.SetCounter("vs_scalar", difference / peak);
+    state.SetCounter("pass_16px", Response(filter, 16.0));
+    state.SetCounter("alias_2.5px", Response(filter, 2.5));
+    state.SetItemsPerIteration(3840ull * 2160);
+}
+
+// A quarter resolution gain map's log boosts raised to multipliers for a 6000 x 4000 image,
+// row by row as ApplyGainMap does; rel_error is the largest relative deviation from std::exp2
+void GainMapUpsample(BenchState& state, bool simd)
+{
+    const int mapWidth = 1500, width = 6000, height = 4000;
+    std::vector<float> log(static_cast<size_t>(mapWidth));
+    for (int x = 0; x < mapWidth; ++x) log[static_cast<size_t>(x)] = 3.0f * std::sin(x * 0.01f) - 0.5f;
+    const LinearTaps columns = BuildLinearTaps(mapWidth, width);
+    std::vector<float> boost(static_cast<size_t>(width)), reference(static_cast<size_t>(width));
+    while (state.Run()) {
+        for (int y = 0; y < height; ++y) UpsampleExp2Row(columns, log.data(), boost.data(), simd);
+        DoNotOptimize(boost.data());
+    }
+    UpsampleExp2Row(columns, log.data(), reference.data(), false);
+    double error = 0;
+    for (int x = 0; x < width; ++x) error = std::max(error, std::fabs(boost[static_cast<size_t>(x)] / reference[static_cast<size_t>(x)] - 1.0));
+    state.SetCounter("rel_error", error);
+    state.SetItemsPerIteration(static_cast<uint64_t>(width) * height);
+}
+
+} // namespace
+
+HDR_BENCH("resample/lanczos3/24MP-to-4k/scalar")
+{
+    Resample(state, LinearPhoto24MP(), 3840, 2160, ResampleFilter::Lanczos3, false, 1);
+}
+
+HDR_BENCH("resample/lanczos3/24MP-to-4k/simd")
+{
+    Resample(state, LinearPhoto24MP(), 3840, 2160, ResampleFilter::Lanczos3, true, 1);
+}
+
+HDR_BENCH("resample/lanczos3/24MP-to-4k/simd-4-threads")
+{
+    Resample(state, LinearPhoto24MP(), 3840, 2160, ResampleFilter::Lanczos3, true, 4);
+}
+
+HDR_BENCH("resample/mitchell/24MP-to-4k/scalar")
+{
+    Resample(state, LinearPhoto24MP(), 3840, 2160, ResampleFilter::Mitchell, false, 1);
+}
+
+HDR_BENCH("resample/mitchell/24MP-to-4k/simd")
+{
+    Resample(state, LinearPhoto24MP(), 3840, 2160, ResampleFilter::Mitchell, true, 1);
+}
+
+// A zoom level: 2.5x up on a 1.5 MP crop
+HDR_BENCH("resample/lanczos3/zoom-2.5x/simd")
+{
+    static const HdrImage crop = [] {
+        const HdrImage& photo = LinearPhoto24MP();
+        HdrImage im;
+        im.Allocate(1536, 1024);
+        for (int y = 0; y < im.height; ++y) {
+            std::copy_n(photo.rgb.data() + (static_cast<size_t>(y) * photo.width) * 3, static_cast<size_t>(im.width) * 3,
+                        im.rgb.data() + static_cast<size_t>(y) * im.width * 3);
+        }
+        return im;
+    }();
+    Resample(state, crop, 3840, 2560, ResampleFilter::Lanczos3, true, 1);
+}
+
+HDR_BENCH("resample/gainmap-x4/scalar")
+{
+    GainMapUpsample(state, false);
+}
+
+HDR_BENCH("resample/gainmap-x4/simd")
+{
+    GainMapUpsample(state, true);
+}
+
+HDR_BENCH("resample/quality/lanczos3")
+{
+    Quality(state, ResampleFilter::Lanczos3);
+}
+
+HDR_BENCH("resample/quality/mitchell")
+{
+    Quality(state, ResampleFilter::Mitchell);
+}
+
+HDR_BENCH("resample/quality/bilinear")
+{
+    Quality(state, ResampleFilter::Bilinear);
+}
@@ -0,0 +1,130 @@
+// BenchSampler.cpp - weighted random order over a million images and the show history behind it
+
+#include "Bench.h"
+#include "ShowHistory.h"
+#include "WeightedSampler.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t kItems = 1000000;
+const size_t kDrawsPerIteration = 1024;
+
+// Least recently shown weights of a library where 90% of the images were shown at some point in
+// the last 90 days, plus a boost of 4 on every 16th image
+const std::vector<double>& MillionWeights()
+{
+    static const std::vector<double> weights = [] {
+        std::vector<double> weights(kItems);
+        const uint32_t now = 60 * 24 * 365 * 50;
+        std::mt19937 rng(7);
+        for (size_t i = 0; i < kItems; ++i) {
+            ShowRecord record;
+            record.count = 1 + rng() % 20;
+            record.lastShown = now - rng() % (60 * 24 * 90);
+            const bool shown = rng() % 10 != 0;
+            weights[i] = SelectionWeight(shown ? &record : nullptr, now, SelectionWeighting::LeastRecent) * (i % 16 == 0 ? 4.0 : 1.0);
+        }
+        return weights;
+    }();
+    return weights;
+}
+
+// One million records, filled the way a long running slideshow would
+const ShowHistory& MillionShows()
+{
+    static const ShowHistory history = [] {
+        ShowHistory history;
+        const uint32_t now = ShowHistory::MinutesNow();
+        std::mt19937 rng(11);
+        for (size_t i = 0; i < kItems; ++i) {
+            const uint64_t key = ShowHistory::KeyOf(L"C:\\Pictures\\event-" + std::to_wstring(i / 1000) + L"\\IMG_" + std::to_wstring(i) + L".jpg");
+            const uint32_t shows = 1 + rng() % 4;
+            for (uint32_t s = 0; s < shows; ++s) history.RecordShow(key, now - rng() % (60 * 24 * 365));
+        }
+        return history;
+    }();
+    return history;
+}
+
+} // namespace
+
+// What random order costs without weights, for comparison
+HDR_BENCH("sampler/Draw/1M-uniform-baseline")
+{
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<size_t> dist(0, kItems - 1);
+    size_t sum = 0;
+    while (state.Run()) {
+        for (size_t i = 0; i < kDrawsPerIteration; ++i) sum += dist(rng);
+    }
+    DoNotOptimize(sum);
+    state.SetItemsPerIteration(kDrawsPerIteration);
+}
+
+HDR_BENCH("sampler/Draw/1M-least-recent")
+{
+    const WeightedSampler sampler(MillionWeights());
+    std::mt19937_64 rng(1);
+    size_t sum = 0;
+    while (state.Run()) {
+        for (size_t i = 0; i < kDrawsPerIteration; ++i) sum += sampler.Draw(rng);
+    }
+    DoNotOptimize(sum);
+    state.SetItemsPerIteration(kDrawsPerIteration);
+}
+
+// The update after each show: the drawn image drops to the lowest weight, and a random other
+// image takes over its old weight so the distribution stays about the same over iterations
+HDR_BENCH("sampler/Set/1M-draw-and-update")
+{
+    WeightedSampler sampler(MillionWeights());
+    std::mt19937_64 rng(1);
+    while (state.Run()) {
+        for (size_t i = 0; i < kDrawsPerIteration; ++i) {
+            const size_t item = sampler.Draw(rng);
+            sampler.Set(item, 1.0);
+            sampler.Set(rng() % kItems, MillionWeights()[item]);
+        }
+    }
+    DoNotOptimize(sampler.Weight(0));
+    state.SetItemsPerIteration(kDrawsPerIteration);
+}
+
+HDR_BENCH("sampler/Assign/1M")
+{
+    const std::vector<double>& weights = MillionWeights();
+    WeightedSampler sampler;
+    while (state.Run()) {
+        sampler.Assign(weights);
+        DoNotOptimize(sampler.Size());
+    }
+    state.SetItemsPerIteration(kItems);
+}
+
+HDR_BENCH("history/Save/1M")
+{
+    const ShowHistory& history = MillionShows();
+    const std::filesystem::path path = BenchScratchDir() / "show-history.bin";
+    while (state.Run()) {
+        const bool saved = history.Save(path);
+        DoNotOptimize(saved);
+    }
+    state.SetItemsPerIteration(history.Size());
+    state.SetBytesPerIteration(std::filesystem::file_size(path));
+}
+
+HDR_BENCH("history/Load/1M")
+{
+    const std::filesystem::path path = BenchScratchDir() / "show-history-load.bin";
+    MillionShows().Save(path);
+    ShowHistory history;
+    while (state.Run()) {
+        const bool loaded = history.Load(path);
+        DoNotOptimize(loaded);
+    }
+    state.SetItemsPerIteration(history.Size());
+    state.SetBytesPerIteration(std::filesystem::file_size(path));
+}
@@ -0,0 +1,151 @@
+// BenchScheduler.cpp - worker pool scheduling overhead, work stealing, display latency under a
+// background flood and the completion channel back to the UI loop
+
+#include "Bench.h"
+#include "CompletionChannel.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void Spin(std::chrono::microseconds duration)
+{
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+// Time from submitting a display job to it starting while a feeder thread keeps eight 200 us
+// jobs queued on `floodLane`, the way a catalog scan keeps the pool busy. On the background lane
+// the display job waits for one running job at most; on its own lane, behind the whole queue.
+// jobs_ahead counts the flood jobs that started in between, which unlike the latency does not
+// depend on how many cores share the threads.
+void DisplayLatency(BenchState& state, WorkerLane floodLane)
+{
+    WorkerPool pool;
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> floodStarted{ 0 };
+    std::thread feeder([&] {
+        while (!stop.load()) {
+            if (pool.QueueDepth() < 8) {
+                pool.Submit(floodLane, WorkerPool::Clock::now(), [&floodStarted] {
+                    floodStarted.fetch_add(1);
+                    Spin(std::chrono::microseconds(200));
+                });
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    });
+    std::vector<double> latencies;
+    uint64_t ahead = 0;
+    while (state.Run()) {
+        std::atomic<bool> started{ false };
+        uint64_t startedAt = 0;
+        const uint64_t submittedAt = floodStarted.load();
+        const auto submitted = std::chrono::steady_clock::now();
+        pool.Submit(WorkerPool::Clock::now(), [&] {
+            startedAt = floodStarted.load();
+            started.store(true);
+        });
+        while (!started.load()) std::this_thread::yield();
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - submitted).count());
+        ahead += startedAt - submittedAt;
+    }
+    stop = true;
+    feeder.join();
+    pool.WaitIdle();
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) { return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))]; };
+    state.SetCounter("p50_us", at(0.5));
+    state.SetCounter("p99_us", at(0.99));
+    state.SetCounter("max_us", latencies.empty() ? 0.0 : latencies.back());
+    state.SetCounter("jobs_ahead", static_cast<double>(ahead) / static_cast<double>(std::max<uint64_t>(1, state.Iterations())));
+    state.SetItemsPerIteration(1);
+}
+
+} // namespace
+
+// Jobs that submit jobs without a deadline: they stay on their worker's deque unless an idle
+// worker steals them
+HDR_BENCH("pool/nested-fanout/1365")
+{
+    WorkerPool pool;
+    std::atomic<uint64_t> done{ 0 };
+    std::function<void(int)> spawn = [&](int depth) {
+        done.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) return;
+        for (int i = 0; i < 4; ++i) pool.Submit(WorkerPool::kNoDeadline, [&spawn, depth] { spawn(depth - 1); });
+    };
+    const uint64_t steals = pool.Steals();
+    while (state.Run()) {
+        pool.Submit(WorkerPool::Clock::now(), [&] { spawn(5); });    // 1 + 4 + ... + 4^5 jobs
+        pool.WaitIdle();
+    }
+    DoNotOptimize(done.load());
+    state.SetItemsPerIteration(1365);
+    state.SetCounter("steals", static_cast<double>(pool.Steals() - steals) / static_cast<double>(state.Iterations()));
+}
+
+HDR_BENCH("pool/display-latency/background-flood")
+{
+    DisplayLatency(state, WorkerLane::Background);
+}
+
+HDR_BENCH("pool/display-latency/same-lane-flood")
+{
+    DisplayLatency(state, WorkerLane::Display);
+}
+
+// Cancelled jobs are dropped when taken, without running
+HDR_BENCH("pool/cancelled/64")
+{
+    WorkerPool pool;
+    std::atomic<bool> cancel{ true };
+    while (state.Run()) {
+        for (int i = 0; i < 64; ++i) pool.Submit(WorkerLane::Background, WorkerPool::Clock::now(), [] { Spin(std::chrono::microseconds(100)); }, &cancel);
+        pool.WaitIdle();
+    }
+    state.SetItemsPerIteration(64);
+}
+
+// Four threads posting results while the UI thread drains; wakes_per_1k is how many wake-up
+// messages the loop would get per thousand posts
+HDR_BENCH("channel/Post+Drain/4-threads")
+{
+    std::atomic<uint64_t> wakes{ 0 };
+    CompletionChannel<uint64_t> channel([&] { wakes.fetch_add(1, std::memory_order_relaxed); });
+    const int perThread = 4096;
+    uint64_t sum = 0;
+    while (state.Run()) {
+        std::vector<std::thread> posters;
+        for (int t = 0; t < 4; ++t) {
+            posters.emplace_back([&channel, t] {
+                for (int i = 0; i < perThread; ++i) channel.Post(static_cast<uint64_t>(t * perThread + i));
+            });
+        }
+        size_t drained = 0;
+        while (drained < 4u * perThread) drained += channel.Drain([&](uint64_t& v) { sum += v; });
+        for (std::thread& t : posters) t.join();
+    }
+    DoNotOptimize(sum);
+    state.SetItemsPerIteration(4 * perThread);
+    state.SetCounter("wakes_per_1k", static_cast<double>(wakes.load()) * 1000.0 / (4.0 * perThread * static_cast<double>(state.Iterations())));
+}
+
+HDR_BENCH("channel/Post+Drain/same-thread")
+{
+    CompletionChannel<uint64_t> channel;
+    uint64_t sum = 0;
+    while (state.Run()) {
+        for (uint64_t i = 0; i < 64; ++i) channel.Post(i);
+        channel.Drain([&](uint64_t& v) { sum += v; });
+    }
+    DoNotOptimize(sum);
+    state.SetItemsPerIteration(64);
+}
@@ -0,0 +1,114 @@
+// BenchSlideshow.cpp - cache, worker pool and end-to-end headless slide advance
+
+#include "Bench.h"
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+
+namespace {
+
+ImageCatalog SyntheticCatalog(size_t count, uint64_t fileSize)
+{
+    ImageCatalog catalog;
+    for (size_t i = 0; i < count; ++i) catalog.Add({ L"bench/IMG_" + std::to_wstring(i) + L".jpg", fileSize });
+    return catalog;
+}
+
+// Loader that hands out one shared buffer, so only scheduling and cache overhead is measured
+Slideshow::LoadFunction InstantLoader()
+{
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(64 * 1024);
+    return [data](const CatalogEntry&) { return std::shared_ptr<const ImageData>(data); };
+}
+
+} // namespace
+
+HDR_BENCH("cache/Get/hit")
+{
+    ImageCache cache(uint64_t(1) << 30);
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(1024);
+    for (uint64_t key = 0; key < 256; ++key) cache.Put(key, data);
+    uint64_t key = 0;
+    while (state.Run()) {
+        DoNotOptimize(cache.Get(key).get());
+        key = (key + 1) & 255;
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("cache/Put/evicting")
+{
+    // Budget for 64 entries, so every Put past the first 64 evicts one
+    ImageCache cache(64 * 1024);
+    auto data = std::make_shared<ImageData>();
+    data->bytes.resize(1024);
+    uint64_t key = 0;
+    while (state.Run()) cache.Put(key++, data);
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("pool/Submit+WaitIdle/64")
+{
+    WorkerPool pool;
+    std::atomic<uint64_t> sum{ 0 };
+    while (state.Run()) {
+        const auto now = WorkerPool::Clock::now();
+        for (int i = 0; i < 64; ++i) {
+            pool.Submit(now + std::chrono::milliseconds(64 - i), [&sum, i] { sum.fetch_add(static_cast<uint64_t>(i), std::memory_order_relaxed); });
+        }
+        pool.WaitIdle();
+    }
+    DoNotOptimize(sum.load());
+    state.SetItemsPerIteration(64);
+}
+
+HDR_BENCH("slideshow/advance/2-outputs")
+{
+    // Two outputs (one sequential, one random) stepping through a 10k image library; every step
+    // is the manual "next" path plus the renderer fetching the new slide
+    const ImageCatalog catalog = SyntheticCatalog(10000, 13 << 20);
+    WorkerPool pool(2);
+    ImageCache cache(uint64_t(256) << 20);
+    Slideshow slideshow(catalog, cache, pool, InstantLoader());
+    SlideOutputConfig config;
+    config.interval = std::chrono::seconds(15);
+    slideshow.AddOutput(config);
+    config.order = SlideOrder::Random;
+    config.seed = 42;
+    slideshow.AddOutput(config);
+    auto now = Slideshow::Clock::now();
+    slideshow.Tick(now);
+    while (state.Run()) {
+        now += std::chrono::milliseconds(10);
+        for (size_t o = 0; o < slideshow.OutputCount(); ++o) {
+            SlideChange change = slideshow.Next(o, now);
+            DoNotOptimize(slideshow.Acquire(change.index).get());
+        }
+    }
+    pool.WaitIdle();
+    state.SetItemsPerIteration(slideshow.OutputCount());
+}
+
+HDR_BENCH("slideshow/tick/idle-4-outputs")
+{
+    // The steady-state cost of the 10 ms message-loop tick when no slide is due
+    const ImageCatalog catalog = SyntheticCatalog(10000, 13 << 20);
+    WorkerPool pool(2);
+    ImageCache cache(uint64_t(256) << 20);
+    Slideshow slideshow(catalog, cache, pool, InstantLoader());
+    SlideOutputConfig config;
+    for (int i = 0; i < 4; ++i) slideshow.AddOutput(config);
+    auto now = Slideshow::Clock::now();
+    slideshow.Tick(now);
+    while (state.Run()) {
+        DoNotOptimize(slideshow.Tick(now + std::chrono::milliseconds(10)).size());
+    }
+    pool.WaitIdle();
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,97 @@
+// BenchSnapshot.cpp - time to the first slide's bytes on activation, listing a 2000 image folder
+// first or restoring the last session's snapshot. The page cache is warm in both, so the cold
+// case is a lower bound of what a real activation pays for the folder walk.
+
+#include "Bench.h"
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "SessionSnapshot.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <fstream>
+
+namespace {
+
+const size_t kImages = 2000;
+
+// 2000 small JPEG-named files in 20 folders, written once
+const std::filesystem::path& Library()
+{
+    static const std::filesystem::path root = [] {
+        const std::filesystem::path dir = BenchScratchDir() / "snapshot-library";
+        std::filesystem::create_directories(dir);
+        const std::string bytes(16 * 1024, 'x');
+        for (size_t i = 0; i < kImages; ++i) {
+            const std::filesystem::path folder = dir / ("event-" + std::to_string(i / 100));
+            std::filesystem::create_directories(folder);
+            std::ofstream(folder / ("IMG_" + std::to_string(i) + ".jpg"), std::ios::binary) << bytes;
+        }
+        return dir;
+    }();
+    return root;
+}
+
+SlideOutputConfig OneOutput()
+{
+    SlideOutputConfig config;
+    config.width = 3840;
+    config.height = 2160;
+    return config;
+}
+
+// What activation does once it has a catalog: start an output and fetch its first slide
+size_t FirstSlide(const ImageCatalog& catalog, ImageCache& cache, WorkerPool& pool)
+{
+    Slideshow slideshow(catalog, cache, pool, Slideshow::LoadImageFile);
+    slideshow.AddOutput(OneOutput());
+    const std::vector<SlideChange> changes = slideshow.Tick(Slideshow::Clock::now());
+    const std::shared_ptr<const ImageData> data = slideshow.Acquire(changes.front().index);
+    return data ? data->bytes.size() : 0;
+}
+
+} // namespace
+
+HDR_BENCH("session/first-slide/cold")
+{
+    const std::wstring root = Library().wstring();
+    WorkerPool pool(2);
+    while (state.Run()) {
+        ImageCache cache(uint64_t(256) << 20);
+        const ImageCatalog catalog = ImageCatalog::FromFolder(root, true);
+        DoNotOptimize(FirstSlide(catalog, cache, pool));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+HDR_BENCH("session/first-slide/snapshot")
+{
+    const std::wstring root = Library().wstring();
+    const std::filesystem::path path = BenchScratchDir() / "session-snapshot.bin";
+    WorkerPool pool(2);
+    {
+        // The snapshot a session over the library leaves behind
+        ImageCache cache(uint64_t(256) << 20);
+        const ImageCatalog catalog = ImageCatalog::FromFolder(root, true);
+        Slideshow slideshow(catalog, cache, pool, Slideshow::LoadImageFile);
+        slideshow.AddOutput(OneOutput());
+        slideshow.Tick(Slideshow::Clock::now());
+        pool.WaitIdle();
+        SessionSnapshot snapshot = SessionSnapshot::Capture(slideshow, cache);
+        snapshot.folder = root;
+        snapshot.Save(path);
+    }
+    while (state.Run()) {
+        ImageCache cache(uint64_t(256) << 20);
+        SessionSnapshot snapshot;
+        std::vector<std::shared_ptr<const ImageData>> data;
+        std::vector<size_t> first;
+        ImageCatalog catalog;
+        if (snapshot.Load(path) && snapshot.Matches(root, true, L"", false)) catalog = snapshot.Restore(data, first);
+        for (size_t i = 0; i < data.size(); ++i) {
+            if (data[i]) cache.Put(i, std::move(data[i]));
+        }
+        DoNotOptimize(FirstSlide(catalog, cache, pool));
+    }
+    state.SetItemsPerIteration(1);
+}
@@ -0,0 +1,96 @@
+// BenchSynthetic.cpp - writing a synthetic library, and probing one against the kinds it was
+// generated with
+
+#include "Bench.h"
+#include "ImageProbe.h"
+#include "SyntheticImages.h"
+#include "WorkerPool.h"
+
+namespace {
+
+SyntheticCorpusOptions SmallLibrary()
+{
+    SyntheticCorpusOptions options;
+    options.files = 2000;
+    options.image.width = 256;
+    options.image.height = 171;
+    return options;
+}
+
+// What the probe has to report for a file of each kind
+Renderability Expected(SyntheticKind kind)
+{
+    switch (kind) {
+    case SyntheticKind::UltraHdr:
+    case SyntheticKind::PqPng:
+        return Renderability::Hdr;
+    case SyntheticKind::Jxl:
+    case SyntheticKind::Tiff:
+        return Renderability::Unsupported;
+    case SyntheticKind::BadHeader:
+    case SyntheticKind::Empty:
+        return Renderability::Broken;
+    default:
+        return Renderability::Displays;    // a truncated JPEG shows its top part, with a warning
+    }
+}
+
+const std::filesystem::path& Library()
+{
+    static const std::filesystem::path root = [] {
+        const std::filesystem::path dir = BenchScratchDir() / "synthetic-library";
+        SyntheticCorpusResult result;
+        WriteSyntheticCorpus(dir, SmallLibrary(), result);
+        return dir;
+    }();
+    return root;
+}
+
+} // namespace
+
+HDR_BENCH("synthetic/BuildSyntheticImage/ultrahdr-1024x683")
+{
+    SyntheticImageOptions options;
+    SyntheticImage image;
+    while (state.Run()) {
+        BuildSyntheticImage(SyntheticKind::UltraHdr, options, image);
+        DoNotOptimize(image.bytes.data());
+    }
+    state.SetBytesPerIteration(image.bytes.size());
+}
+
+HDR_BENCH("synthetic/WriteSyntheticCorpus/2000-files")
+{
+    const SyntheticCorpusOptions options = SmallLibrary();
+    const std::filesystem::path root = BenchScratchDir() / "synthetic-write";
+    WorkerPool pool;
+    SyntheticCorpusResult result;
+    while (state.Run()) {
+        WriteSyntheticCorpus(root, options, result, &pool);
+        DoNotOptimize(result.bytes);
+    }
+    state.SetItemsPerIteration(result.files);
+    state.SetBytesPerIteration(result.bytes);
+}
+
+HDR_BENCH("files/ProbeImageFile/synthetic-library")
+{
+    const SyntheticCorpusOptions options = SmallLibrary();
+    const std::filesystem::path& root = Library();
+    std::vector<std::pair<std::filesystem::path, SyntheticKind>> files;
+    for (size_t i = 0; i < options.files; ++i) {
+        const SyntheticFile file = SyntheticCorpusFile(options, i);
+        if (file.kind != SyntheticKind::Sidecar) files.emplace_back(root / file.path, file.kind);
+    }
+    size_t mismatches = 0;
+    while (state.Run()) {
+        mismatches = 0;
+        for (const auto& [path, kind] : files) {
+            ImageProbe probe;
+            ProbeImageFile(path, probe);
+            if (probe.renderability != Expected(kind)) ++mismatches;
+        }
+    }
+    state.SetItemsPerIteration(files.size());
+    state.SetCounter("mismatches", static_cast<double>(mismatches));
+}
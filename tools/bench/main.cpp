@@ -0,0 +1,335 @@
+// hdrbench - benchmarks of the enumeration, parsing, decode and slideshow pipeline stages
+//
+// Usage: hdrbench [--filter <text>] [--min-time <seconds>] [--samples <n>] [--corpus <dir>]
+//                 [--json <file>] [--baseline <file>] [--threshold <percent>] [--fail-on-regression] [--list]
+//   --filter     run only benchmarks whose name contains <text> (repeatable)
+//   --min-time   minimum duration of one sample (default 0.2)
+//   --samples    samples per benchmark; the median is reported (default 5)
+//   --corpus     folder of real images for the cases that need them
+//   --json       write the results as JSON (use as a later --baseline)
+//   --baseline   compare against a previous --json result and mark regressions
+//   --threshold  slowdown in percent that counts as a regression (default 10)
+
+#include "Bench.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+std::vector<BenchCase>& BenchRegistry()
+{
+    static std::vector<BenchCase> registry;
+    return registry;
+}
+
+static std::filesystem::path g_corpusDir;
+
+const std::filesystem::path& BenchCorpusDir()
+{
+    return g_corpusDir;
+}
+
+namespace {
+
+struct ScratchDir {
+    std::filesystem::path path;
+    ~ScratchDir() {
+        std::error_code ec;
+        if (!path.empty()) std::filesystem::remove_all(path, ec);
+    }
+};
+
+ScratchDir g_scratch;
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0;
+    double nsPerOp = 0, nsMin = 0, nsMax = 0;
+    double itemsPerSecond = 0, bytesPerSecond = 0;
+    std::vector<std::pair<std::string, double>> counters;   // from the median sample
+    std::string skipped;
+};
+
+BenchResult RunCase(const BenchCase& bench, double minTime, int samples)
+{
+    BenchResult result;
+    result.name = bench.name;
+
+    // Grow the iteration count until one sample takes at least minTime
+    uint64_t iterations = 1;
+    while (true) {
+        BenchState state(iterations);
+        bench.run(state);
+        if (!state.SkipReason().empty()) { result.skipped = state.SkipReason(); return result; }
+        const double ns = state.ElapsedNs();
+        if (ns >= minTime * 1e9 || iterations >= (uint64_t(1) << 40)) break;
+        const double factor = ns > 0 ? std::min(10.0, std::max(1.5, 1.2 * minTime * 1e9 / ns)) : 10.0;
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * factor) + 1;
+    }
+
+    std::vector<std::pair<double, std::vector<std::pair<std::string, double>>>> perOp;
+    uint64_t items = 0, bytes = 0;
+    for (int i = 0; i < samples; ++i) {
+        BenchState state(iterations);
+        bench.run(state);
+        perOp.emplace_back(state.ElapsedNs() / static_cast<double>(iterations), state.Counters());
+        items = state.ItemsPerIteration();
+        bytes = state.BytesPerIteration();
+    }
+    std::sort(perOp.begin(), perOp.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    result.iterations = iterations;
+    result.nsPerOp = perOp[perOp.size() / 2].first;
+    result.counters = perOp[perOp.size() / 2].second;
+    result.nsMin = perOp.front().first;
+    result.nsMax = perOp.back().first;
+    if (result.nsPerOp > 0) {
+        result.itemsPerSecond = static_cast<double>(items) * 1e9 / result.nsPerOp;
+        result.bytesPerSecond = static_cast<double>(bytes) * 1e9 / result.nsPerOp;
+    }
+    return result;
+}
+
+std::string JsonEscape(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+std::string ToJson(const std::vector<BenchResult>& results)
+{
+    std::ostringstream out;
+    out << "{\n  \"version\": 1,\n  \"timestamp_unix\": " << static_cast<long long>(std::time(nullptr))
+        << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n  \"benchmarks\": [";
+    bool first = true;
+    for (const BenchResult& r : results) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"name\": \"" << JsonEscape(r.name) << "\"";
+        if (!r.skipped.empty()) {
+            out << ", \"skipped\": \"" << JsonEscape(r.skipped) << "\"}";
+            continue;
+        }
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), ", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ns_min\": %.3f, \"ns_max\": %.3f, \"items_per_second\": %.1f, \"bytes_per_second\": %.1f",
+                      static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.nsMin, r.nsMax, r.itemsPerSecond, r.bytesPerSecond);
+        out << buf;
+        if (!r.counters.empty()) {
+            out << ", \"counters\": {";
+            for (size_t i = 0; i < r.counters.size(); ++i) {
+                std::snprintf(buf, sizeof(buf), "%s\"%s\": %.3f", i ? ", " : "", JsonEscape(r.counters[i].first).c_str(), r.counters[i].second);
+                out << buf;
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+// Reads name -> ns_per_op from a file written by --json (one benchmark object per line)
+std::map<std::string, double> LoadBaseline(const std::string& path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t ns = line.find("\"ns_per_op\": ");
+        if (name == std::string::npos || ns == std::string::npos) continue;
+        name += 9;
+        size_t nameEnd = line.find('"', name);
+        if (nameEnd == std::string::npos) continue;
+        baseline[line.substr(name, nameEnd - name)] = std::atof(line.c_str() + ns + 13);
+    }
+    return baseline;
+}
+
+std::string FormatTime(double ns)
+{
+    char buf[32];
+    if (ns < 1e3) std::snprintf(buf, sizeof(buf), "%.1f ns", ns);
+    else if (ns < 1e6) std::snprintf(buf, sizeof(buf), "%.2f us", ns / 1e3);
+    else if (ns < 1e9) std::snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+    else std::snprintf(buf, sizeof(buf), "%.2f s", ns / 1e9);
+    return buf;
+}
+
+std::string FormatRate(double perSecond, const char* unit)
+{
+    if (perSecond <= 0) return "";
+    char buf[32];
+    if (perSecond >= 1e9) std::snprintf(buf, sizeof(buf), "%.2f G%s/s", perSecond / 1e9, unit);
+    else if (perSecond >= 1e6) std::snprintf(buf, sizeof(buf), "%.2f M%s/s", perSecond / 1e6, unit);
+    else if (perSecond >= 1e3) std::snprintf(buf, sizeof(buf), "%.2f k%s/s", perSecond / 1e3, unit);
+    else std::snprintf(buf, sizeof(buf), "%.2f %s/s", perSecond, unit);
+    return buf;
+}
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrbench [--filter <text>] [--min-time <seconds>] [--samples <n>] [--corpus <dir>]\n"
+                         "                [--json <file>] [--baseline <file>] [--threshold <percent>] [--fail-on-regression] [--list]\n");
+}
+
+} // namespace
+
+uint64_t BenchPageFaults()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PageFaultCount;
+#else
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<uint64_t>(usage.ru_minflt) + static_cast<uint64_t>(usage.ru_majflt);
+#endif
+}
+
+#ifndef _WIN32
+static uint64_t ProcStatusBytes(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+            return std::strtoull(line.c_str() + length + 1, nullptr, 10) * 1024;   // kB
+    }
+    return 0;
+}
+#endif
+
+uint64_t BenchResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+    return ProcStatusBytes("VmRSS");
+#endif
+}
+
+uint64_t BenchPeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    return ProcStatusBytes("VmHWM");
+#endif
+}
+
+void BenchResetPeakMemory()
+{
+#ifndef _WIN32
+    std::ofstream("/proc/self/clear_refs") << "5";   // resets VmHWM to the current VmRSS
+#endif
+}
+
+const std::filesystem::path& BenchScratchDir()
+{
+    if (g_scratch.path.empty()) {
+        g_scratch.path = std::filesystem::temp_directory_path() /
+                         ("hdrbench-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+        std::filesystem::create_directories(g_scratch.path);
+    }
+    return g_scratch.path;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> filters;
+    double minTime = 0.2;
+    int samples = 5;
+    std::string jsonPath, baselinePath;
+    double threshold = 10;
+    bool failOnRegression = false, list = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--filter") filters.push_back(value());
+        else if (arg == "--min-time") minTime = std::atof(value().c_str());
+        else if (arg == "--samples") samples = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--corpus") g_corpusDir = value();
+        else if (arg == "--json") jsonPath = value();
+        else if (arg == "--baseline") baselinePath = value();
+        else if (arg == "--threshold") threshold = std::atof(value().c_str());
+        else if (arg == "--fail-on-regression") failOnRegression = true;
+        else if (arg == "--list") list = true;
+        else { Usage(); return 2; }
+    }
+
+    // Benchmarks that log configure the sinks themselves; keep the console quiet
+    Logger::Instance().SetConsoleEnabled(false);
+
+    std::vector<BenchCase> cases = BenchRegistry();
+    std::sort(cases.begin(), cases.end(), [](const BenchCase& a, const BenchCase& b) { return a.name < b.name; });
+    if (!filters.empty()) {
+        cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const BenchCase& c) {
+            for (const std::string& f : filters) if (c.name.find(f) != std::string::npos) return false;
+            return true;
+        }), cases.end());
+    }
+    if (list) {
+        for (const BenchCase& c : cases) std::printf("%s\n", c.name.c_str());
+        return 0;
+    }
+
+    const std::map<std::string, double> baseline = baselinePath.empty() ? std::map<std::string, double>() : LoadBaseline(baselinePath);
+    if (!baselinePath.empty() && baseline.empty()) std::fprintf(stderr, "Warning: no results found in baseline %s\n", baselinePath.c_str());
+
+    std::vector<BenchResult> results;
+    int regressions = 0;
+    std::printf("%-48s %12s %12s %14s %14s\n", "benchmark", "time/op", "min", "items", "bytes");
+    for (const BenchCase& c : cases) {
+        BenchResult r = RunCase(c, minTime, samples);
+        results.push_back(r);
+        if (!r.skipped.empty()) {
+            std::printf("%-48s skipped: %s\n", r.name.c_str(), r.skipped.c_str());
+            continue;
+        }
+        std::printf("%-48s %12s %12s %14s %14s", r.name.c_str(), FormatTime(r.nsPerOp).c_str(), FormatTime(r.nsMin).c_str(),
+                    FormatRate(r.itemsPerSecond, "").c_str(), FormatRate(r.bytesPerSecond, "B").c_str());
+        auto base = baseline.find(r.name);
+        if (base != baseline.end() && base->second > 0) {
+            const double change = (r.nsPerOp / base->second - 1.0) * 100.0;
+            const bool regressed = change > threshold;
+            if (regressed) ++regressions;
+            std::printf("  %+6.1f%%%s", change, regressed ? "  REGRESSION" : (change < -threshold ? "  faster" : ""));
+        }
+        for (const auto& [name, value] : r.counters) std::printf("  %s=%.4g", name.c_str(), value);
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath, std::ios::out | std::ios::trunc);
+        out << ToJson(results);
+        if (!out) { std::fprintf(stderr, "Cannot write %s\n", jsonPath.c_str()); return 1; }
+    }
+    if (!baseline.empty()) std::printf("%d regression(s) above %.0f%% against %s\n", regressions, threshold, baselinePath.c_str());
+    return failOnRegression && regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+// hdrbake - pre-bakes display-resolution renditions of a photo library into a mirror folder
+//
+// Usage: hdrbake <library> <mirror> [options]
+//   --max <w>x<h>          display size the renditions must fit (default 3840x2160)
+//   --quality <n>          JPEG quality of the primary image (default 90)
+//   --gainmap-quality <n>  JPEG quality of the gain map (default 85)
+//   --threads <n>          worker threads (default: one per core)
+//   --no-subfolders        only the top level of the library
+//   --force                re-bake everything, even renditions that are current
+//   --measure <n>          time reading + decoding <n> sources against their renditions (default 8)
+//
+// JPEG and Ultra HDR (JPEG + gain map MPF) files larger than the display are downscaled, gain
+// map included, and written to the same relative path below <mirror>. A manifest records the
+// size and modification time of every source, so later runs only bake new and changed files, and
+// a fingerprint of its content, so renamed and moved files keep their renditions.
+// Point the screensaver's RenditionFolder setting at <mirror> to have it prefer the renditions.
+
+#include "FileIdentity.h"
+#include "ImageCatalog.h"
+#include "JpegCodec.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "PixelBufferPool.h"
+#include "Rendition.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwctype>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool IsJpegPath(const std::filesystem::path& path)
+{
+    std::wstring ext = path.extension().wstring();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+    return ext == L".jpg" || ext == L".jpeg";
+}
+
+bool WriteFileAtomic(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    return !ec;
+}
+
+std::string MB(uint64_t bytes)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f MB", static_cast<double>(bytes) / (1 << 20));
+    return buf;
+}
+
+// Milliseconds to read and decode one file, as a stand-in for the time a slide takes to display
+double TimeToDecode(const std::wstring& path, uint64_t size)
+{
+    const auto start = Clock::now();
+    auto data = Slideshow::LoadImageFile({ path, size });
+    if (!data) return -1;
+    PlanarImage image;
+    if (!DecodeJpeg(data->bytes.data(), data->bytes.size(), image)) return -1;
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrbake <library> <mirror> [--max WxH] [--quality n] [--gainmap-quality n] [--threads n]\n"
+                         "               [--no-subfolders] [--force] [--measure n]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    BakeOptions options;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool subfolders = true, force = false;
+    size_t measure = 8;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--max") {
+            std::string v = value();
+            if (std::sscanf(v.c_str(), "%dx%d", &options.maxWidth, &options.maxHeight) != 2 || options.maxWidth <= 0 || options.maxHeight <= 0) {
+                std::fprintf(stderr, "Bad size: %s\n", v.c_str());
+                return 2;
+            }
+        } else if (arg == "--quality") options.quality = std::clamp(std::atoi(value().c_str()), 1, 100);
+        else if (arg == "--gainmap-quality") options.gainMapQuality = std::clamp(std::atoi(value().c_str()), 1, 100);
+        else if (arg == "--threads") threads = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--no-subfolders") subfolders = false;
+        else if (arg == "--force") force = true;
+        else if (arg == "--measure") measure = std::strtoull(value().c_str(), nullptr, 10);
+        else if (!arg.empty() && arg[0] == '-') { Usage(); return 2; }
+        else positional.push_back(arg);
+    }
+    if (positional.size() != 2) { Usage(); return 2; }
+    Logger::Instance().SetConsoleEnabled(false);
+
+    const std::filesystem::path library = std::filesystem::absolute(positional[0]);
+    const std::filesystem::path mirror = std::filesystem::absolute(positional[1]);
+    if (!std::filesystem::is_directory(library)) {
+        std::fprintf(stderr, "Not a folder: %s\n", positional[0].c_str());
+        return 1;
+    }
+
+    RenditionStore store(library, mirror);
+    const bool loaded = store.Load();
+    const BakeOptions previous = store.Options();
+    if (force || (loaded && (previous.maxWidth != options.maxWidth || previous.maxHeight != options.maxHeight ||
+                             previous.quality != options.quality || previous.gainMapQuality != options.gainMapQuality))) {
+        if (loaded && !force) std::printf("Rendition settings changed, re-baking everything\n");
+        store.Clear();
+    }
+    store.SetOptions(options);
+
+    const auto scanStart = Clock::now();
+    const ImageCatalog catalog = ImageCatalog::FromFolder(library.wstring(), subfolders);
+    std::printf("%zu images in %s (%.0f ms)\n", catalog.Size(), library.string().c_str(),
+                std::chrono::duration<double, std::milli>(Clock::now() - scanStart).count());
+
+    std::vector<std::filesystem::path> sources;
+    sources.reserve(catalog.Size());
+    for (const CatalogEntry& entry : catalog.Entries()) sources.emplace_back(entry.path);
+
+    // Records whose source left the library may belong to files that were renamed or moved: the
+    // files without a record are fingerprinted and take over a record with the same content.
+    // Current records from bakes before fingerprints existed get theirs on the way.
+    size_t relinked = 0;
+    {
+        size_t known = 0;
+        for (const std::filesystem::path& path : sources) known += store.Find(path) ? 1 : 0;
+        const bool orphans = known < store.Size();
+        std::vector<std::pair<std::filesystem::path, RenditionRecord>> fingerprinted(sources.size());
+        WorkerPool pool(threads);
+        const auto now = WorkerPool::Clock::now();
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const RenditionRecord* existing = store.Find(sources[i]);
+            if (existing ? !existing->content.Empty() : !orphans) continue;
+            pool.Submit(now, [&, i] {
+                RenditionRecord& record = fingerprinted[i].second;
+                if (SourceIdentity::Of(sources[i], record.source) && FingerprintFile(sources[i], record.source.size, record.content)) {
+                    fingerprinted[i].first = sources[i];
+                }
+            });
+        }
+        pool.WaitIdle();
+        std::vector<std::pair<std::filesystem::path, RenditionRecord>> candidates;
+        for (auto& [path, record] : fingerprinted) {
+            if (path.empty()) continue;
+            const RenditionRecord* existing = store.Find(path);
+            if (!existing) {
+                candidates.emplace_back(std::move(path), record);
+            } else if (existing->source == record.source) {
+                RenditionRecord updated = *existing;
+                updated.content = record.content;
+                store.Set(path, updated);
+            }
+        }
+        relinked = store.Relink(sources, candidates);
+    }
+
+    std::mutex mutex;    // guards store and the counters below
+    size_t counts[4] = {}, current = 0;
+    uint64_t bytesRead = 0;
+    Histogram& bakeTime = Metrics::Instance().GetHistogram("hdr_bake_us", "Time to bake one rendition");
+
+    const auto bakeStart = Clock::now();
+    {
+        WorkerPool pool(threads);
+        const auto now = WorkerPool::Clock::now();
+        for (size_t i = 0; i < catalog.Size(); ++i) {
+            const CatalogEntry& entry = catalog[i];
+            SourceIdentity identity;
+            if (!SourceIdentity::Of(entry.path, identity)) continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            const RenditionRecord* existing = store.Find(entry.path);
+            if (existing && existing->source == identity && existing->status != RenditionStatus::Failed &&
+                (existing->status != RenditionStatus::Baked || std::filesystem::exists(store.RenditionPath(entry.path)))) {
+                ++current;
+                continue;
+            }
+            if (!IsJpegPath(entry.path)) {
+                RenditionRecord record;
+                record.status = RenditionStatus::Unsupported;
+                record.source = identity;
+                store.Set(entry.path, record);
+                ++counts[static_cast<int>(RenditionStatus::Unsupported)];
+                continue;
+            }
+            // Submission order is the deadline order, so the pool works through the library in order
+            pool.Submit(now + std::chrono::microseconds(i), [&, i, identity] {
+                const CatalogEntry& source = catalog[i];
+                const auto start = Clock::now();
+                RenditionRecord record;
+                record.source = identity;
+                std::vector<uint8_t> rendition;
+                BakeResult result;
+                auto data = Slideshow::LoadImageFile(source);
+                if (!data) {
+                    result.error = "cannot read file";
+                } else {
+                    result = BakeRendition(data->bytes.data(), data->bytes.size(), options, rendition);
+                    record.content = FingerprintData(data->bytes.data(), data->bytes.size());
+                }
+                if (result.status == RenditionStatus::Baked && !WriteFileAtomic(store.RenditionPath(source.path), rendition)) {
+                    result.status = RenditionStatus::Failed;
+                    result.error = "cannot write rendition";
+                }
+                record.status = result.status;
+                record.width = result.width;
+                record.height = result.height;
+                record.renditionSize = result.status == RenditionStatus::Baked ? rendition.size() : 0;
+                bakeTime.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+
+                std::lock_guard<std::mutex> lock(mutex);
+                store.Set(source.path, record);
+                ++counts[static_cast<int>(record.status)];
+                if (data) bytesRead += data->bytes.size();
+                if (result.status == RenditionStatus::Failed || (result.status == RenditionStatus::Unsupported && !result.error.empty())) {
+                    std::fprintf(stderr, "%s: %s: %s\n", std::filesystem::path(source.path).string().c_str(),
+                                 RenditionStatusName(result.status), result.error.c_str());
+                }
+            });
+        }
+        pool.WaitIdle();
+    }
+    const double bakeSeconds = std::chrono::duration<double>(Clock::now() - bakeStart).count();
+
+    const size_t pruned = store.Prune(sources);
+    if (!store.Save()) {
+        std::fprintf(stderr, "Cannot write the manifest in %s\n", mirror.string().c_str());
+        return 1;
+    }
+
+    const size_t baked = counts[static_cast<int>(RenditionStatus::Baked)];
+    std::printf("Baked %zu, already current %zu, original size %zu, unsupported %zu, failed %zu, removed %zu in %.1f s (%u threads, %s read)\n",
+                baked, current, counts[static_cast<int>(RenditionStatus::Original)], counts[static_cast<int>(RenditionStatus::Unsupported)],
+                counts[static_cast<int>(RenditionStatus::Failed)], pruned, bakeSeconds, threads, MB(bytesRead).c_str());
+    if (relinked > 0) std::printf("Kept %zu renditions of renamed or moved files\n", relinked);
+    const PixelPoolStats buffers = PixelBufferPool::Instance().Stats();
+    if (buffers.maps > 0) {
+        std::printf("Pixel buffers: %s peak, %llu mapped, %llu reused\n", MB(buffers.peakMappedBytes).c_str(),
+                    static_cast<unsigned long long>(buffers.maps), static_cast<unsigned long long>(buffers.reuses));
+    }
+    PixelBufferPool::Instance().Trim();
+
+    // What the slideshow reads per slide with the mirror, across the whole library
+    uint64_t sourceBytes = 0, shownBytes = 0;
+    size_t renditions = 0;
+    std::vector<size_t> bakedIndices;
+    for (size_t i = 0; i < catalog.Size(); ++i) {
+        const CatalogEntry& entry = catalog[i];
+        sourceBytes += entry.fileSize;
+        const CatalogEntry resolved = store.Resolve(entry);
+        shownBytes += resolved.fileSize;
+        if (resolved.path != entry.path) {
+            ++renditions;
+            bakedIndices.push_back(i);
+        }
+    }
+    if (catalog.Size() > 0) {
+        std::printf("Bytes read per slide: %s -> %s (%.0f%% less, %zu of %zu images use a rendition)\n",
+                    MB(sourceBytes / catalog.Size()).c_str(), MB(shownBytes / catalog.Size()).c_str(),
+                    sourceBytes ? 100.0 * (1.0 - static_cast<double>(shownBytes) / static_cast<double>(sourceBytes)) : 0.0, renditions, catalog.Size());
+    }
+
+    // Time to display: read + decode of evenly spaced samples, source against rendition
+    const size_t samples = std::min(measure, bakedIndices.size());
+    if (samples > 0) {
+        double sourceMs = 0, renditionMs = 0;
+        size_t measured = 0;
+        for (size_t s = 0; s < samples; ++s) {
+            const CatalogEntry& entry = catalog[bakedIndices[s * bakedIndices.size() / samples]];
+            const CatalogEntry resolved = store.Resolve(entry);
+            const double a = TimeToDecode(entry.path, entry.fileSize);
+            const double b = TimeToDecode(resolved.path, resolved.fileSize);
+            if (a < 0 || b < 0) continue;
+            sourceMs += a;
+            renditionMs += b;
+            ++measured;
+        }
+        if (measured > 0) {
+            std::printf("Read + decode per slide (%zu samples): %.1f ms -> %.1f ms (%.1fx faster)\n", measured,
+                        sourceMs / measured, renditionMs / measured, renditionMs > 0 ? sourceMs / renditionMs : 0.0);
+        }
+    }
+    return counts[static_cast<int>(RenditionStatus::Failed)] ? 1 : 0;
+}
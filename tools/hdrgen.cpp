@@ -0,0 +1,143 @@
+// hdrgen - writes a deterministic synthetic image library for tests and benchmarks
+//
+// Usage: hdrgen <folder> [options]
+//   --files <n>              files to write (default 1000)
+//   --per-folder <n>         files per folder (default 100)
+//   --fanout <n>             subfolders per folder (default 10)
+//   --seed <n>               kind, variant and date of every file (default 1)
+//   --size <w>x<h>           image size (default 1024x683; odd variants are portrait)
+//   --gain-map-scale <n>     gain map downscale factor (default 4)
+//   --restart <n>            restart interval of the primary JPEG in MCUs (default 0 = none)
+//   --quality <n>            JPEG quality (default 85)
+//   --no-icc                 leave out the Display P3 profile
+//   --kinds <kind[=w],...>   only these kinds, with relative weights (default weight 1)
+//   --variants <n>           distinct images per kind (default 4)
+//   --threads <n>            worker threads (default: one per core)
+//   --single <kind> <file>   write one image of a kind instead of a library
+//   --list                   print the kinds and the default mix
+//
+// The same options give the same files, byte for byte, on every machine: each file is a stamped
+// copy of one of a few images per kind, so a 100000 file library takes seconds to write. Kinds:
+// ultrahdr jpeg png pq-png gif bmp webp svg avif jxl tiff truncated bad-header empty misnamed
+// sidecar; see SyntheticImages.h for what each one is.
+
+#include "Logger.h"
+#include "SyntheticImages.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace {
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrgen <folder> [--files n] [--per-folder n] [--fanout n] [--seed n] [--size WxH] [--gain-map-scale n] [--restart n]\n"
+                         "              [--quality n] [--no-icc] [--kinds kind[=weight],...] [--variants n] [--threads n]\n"
+                         "       hdrgen --single <kind> <file> [image options]\n"
+                         "       hdrgen --list\n");
+}
+
+// "ultrahdr=3,jpeg,png=0.5"
+bool ParseKinds(const std::string& text, std::array<double, kSyntheticKinds>& mix)
+{
+    mix.fill(0);
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        const size_t comma = std::min(text.find(',', pos), text.size());
+        const std::string item = text.substr(pos, comma - pos);
+        const size_t equals = item.find('=');
+        SyntheticKind kind;
+        if (!ParseSyntheticKind(item.substr(0, equals), kind)) {
+            std::fprintf(stderr, "Unknown kind '%s'\n", item.substr(0, equals).c_str());
+            return false;
+        }
+        mix[static_cast<size_t>(kind)] = equals == std::string::npos ? 1.0 : std::atof(item.c_str() + equals + 1);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    SyntheticCorpusOptions options;
+    std::string folder, singleKind, singlePath;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--files") options.files = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--per-folder") options.filesPerFolder = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--fanout") options.fanOut = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--seed") options.seed = options.image.seed = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--size") {
+            if (std::sscanf(value().c_str(), "%dx%d", &options.image.width, &options.image.height) != 2) { Usage(); return 2; }
+        }
+        else if (arg == "--gain-map-scale") options.image.gainMapScale = std::atoi(value().c_str());
+        else if (arg == "--restart") options.image.restartInterval = std::atoi(value().c_str());
+        else if (arg == "--quality") options.image.quality = std::atoi(value().c_str());
+        else if (arg == "--no-icc") options.image.icc = false;
+        else if (arg == "--kinds") {
+            if (!ParseKinds(value(), options.mix)) return 2;
+        }
+        else if (arg == "--variants") options.variants = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--threads") threads = static_cast<unsigned>(std::atoi(value().c_str()));
+        else if (arg == "--single") { singleKind = value(); singlePath = value(); }
+        else if (arg == "--list") {
+            const auto mix = SyntheticCorpusOptions::DefaultMix();
+            double total = 0;
+            for (double share : mix) total += share;
+            for (size_t k = 0; k < kSyntheticKinds; ++k) {
+                const SyntheticKind kind = static_cast<SyntheticKind>(k);
+                std::printf("%-12s %-6s %5.1f%%\n", SyntheticKindName(kind), SyntheticKindExtension(kind), 100.0 * mix[k] / total);
+            }
+            return 0;
+        }
+        else if (folder.empty() && arg[0] != '-') folder = arg;
+        else { Usage(); return 2; }
+    }
+
+    Logger::Instance().SetLevel(LogLevel::Warn);
+
+    if (!singleKind.empty()) {
+        SyntheticKind kind;
+        if (!ParseSyntheticKind(singleKind, kind)) { std::fprintf(stderr, "Unknown kind '%s'\n", singleKind.c_str()); return 2; }
+        SyntheticImage image;
+        std::string error;
+        if (!BuildSyntheticImage(kind, options.image, image, &error)) { std::fprintf(stderr, "%s\n", error.c_str()); return 1; }
+        std::ofstream out(singlePath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char*>(image.bytes.data()), static_cast<std::streamsize>(image.bytes.size()))) {
+            std::fprintf(stderr, "Cannot write %s\n", singlePath.c_str());
+            return 1;
+        }
+        std::printf("%s: %s, %zu bytes\n", singlePath.c_str(), SyntheticKindName(kind), image.bytes.size());
+        return 0;
+    }
+    if (folder.empty()) { Usage(); return 2; }
+
+    const auto start = std::chrono::steady_clock::now();
+    WorkerPool pool(threads);
+    SyntheticCorpusResult result;
+    std::string error;
+    if (!WriteSyntheticCorpus(folder, options, result, &pool, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu files in %zu folders, %.1f MB, %.2f s\n", result.files, result.folders, result.bytes / 1048576.0, seconds);
+    for (size_t k = 0; k < kSyntheticKinds; ++k) {
+        if (result.kinds[k] > 0) std::printf("  %-12s %8zu\n", SyntheticKindName(static_cast<SyntheticKind>(k)), result.kinds[k]);
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+// hdrlogdecode - converts a binary HDRScreenSaver log (.hdrlog) to text
+//
+// Usage: hdrlogdecode <file.hdrlog> [--level trace|debug|info|warn|error] [--formats]
+//   --level    only print messages at or above the given level
+//   --formats  print the table of registered call sites instead of the messages
+
+#include "Logger.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Reader {
+    const std::vector<uint8_t>& data;
+    size_t pos = 0;
+    bool ok = true;
+
+    template<typename T>
+    T Get() {
+        T value{};
+        if (pos + sizeof(T) > data.size()) { ok = false; pos = data.size(); return value; }
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    std::string GetBytes(size_t n) {
+        if (pos + n > data.size()) { ok = false; pos = data.size(); return {}; }
+        std::string s(reinterpret_cast<const char*>(data.data() + pos), n);
+        pos += n;
+        return s;
+    }
+};
+
+struct FormatDef {
+    uint8_t level = 0;
+    uint8_t category = 0;
+    uint32_t line = 0;
+    std::string file;
+    std::string format;
+};
+
+void AppendUtf8(std::string& out, uint32_t c)
+{
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+// Reads a WString payload written by a process with the given wchar_t size (2 = UTF-16, 4 = UTF-32).
+std::string ReadWide(Reader& r, uint8_t wcharSize)
+{
+    uint32_t count = r.Get<uint32_t>();
+    std::string raw = r.GetBytes(static_cast<size_t>(count) * wcharSize);
+    std::string out;
+    for (uint32_t i = 0; i < count && r.ok; ++i) {
+        uint32_t c = 0;
+        std::memcpy(&c, raw.data() + static_cast<size_t>(i) * wcharSize, wcharSize);
+        if (wcharSize == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < count) {
+            uint32_t lo = 0;
+            std::memcpy(&lo, raw.data() + static_cast<size_t>(i + 1) * wcharSize, wcharSize);
+            if (lo >= 0xDC00 && lo < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                ++i;
+            }
+        }
+        AppendUtf8(out, c);
+    }
+    return out;
+}
+
+std::string ReadArg(Reader& r, uint8_t wcharSize)
+{
+    uint8_t type = r.Get<uint8_t>();
+    switch (type) {
+    case LogBinary::Int: return std::to_string(r.Get<int64_t>());
+    case LogBinary::UInt: return std::to_string(r.Get<uint64_t>());
+    case LogBinary::Double: {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%g", r.Get<double>());
+        return buf;
+    }
+    case LogBinary::String: return r.GetBytes(r.Get<uint32_t>());
+    case LogBinary::WString: return ReadWide(r, wcharSize);
+    default:
+        r.ok = false;
+        return "?";
+    }
+}
+
+// Same substitution rules as FormatLogText() in Logger.h
+std::string FormatMessage(const std::string& format, const std::vector<std::string>& args)
+{
+    std::string out;
+    size_t pos = 0;
+    for (const std::string& arg : args) {
+        size_t p = format.find("{}", pos);
+        if (p == std::string::npos) {
+            out.append(format, pos, std::string::npos);
+            pos = format.size();
+            out += ' ';
+        } else {
+            out.append(format, pos, p - pos);
+            pos = p + 2;
+        }
+        out += arg;
+    }
+    if (pos < format.size()) out.append(format, pos, std::string::npos);
+    return out;
+}
+
+std::string Narrow(const wchar_t* s)
+{
+    std::string out;
+    for (; *s; ++s) out += static_cast<char>(*s);
+    return out;
+}
+
+std::string FormatTimestamp(int64_t startUnixMicros, uint64_t offsetMicros)
+{
+    int64_t t = startUnixMicros + static_cast<int64_t>(offsetMicros);
+    std::time_t seconds = static_cast<std::time_t>(t / 1000000);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &seconds);
+#else
+    localtime_r(&seconds, &tm);
+#endif
+    char buf[64];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    char out[80];
+    std::snprintf(out, sizeof(out), "%s.%06d", buf, static_cast<int>(t % 1000000));
+    return out;
+}
+
+void PrintLine(int64_t startUnixMicros, uint64_t time, uint32_t thread, uint8_t level, uint8_t category, const std::string& text)
+{
+    std::printf("%s [%u] %-5s %-10s %s\n", FormatTimestamp(startUnixMicros, time).c_str(), thread,
+                Narrow(LogLevelName(static_cast<LogLevel>(level))).c_str(),
+                Narrow(LogCategoryName(static_cast<LogCategory>(category))).c_str(), text.c_str());
+}
+
+int ParseLevel(const std::string& s)
+{
+    const char* names[] = { "trace", "debug", "info", "warn", "error" };
+    for (int i = 0; i < 5; ++i) if (s == names[i]) return i;
+    return -1;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    int minLevel = 0;
+    bool listFormats = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--level" && i + 1 < argc) {
+            minLevel = ParseLevel(argv[++i]);
+            if (minLevel < 0) { std::fprintf(stderr, "Unknown level: %s\n", argv[i]); return 2; }
+        } else if (arg == "--formats") {
+            listFormats = true;
+        } else if (path.empty()) {
+            path = arg;
+        } else {
+            std::fprintf(stderr, "Unexpected argument: %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "Usage: hdrlogdecode <file.hdrlog> [--level trace|debug|info|warn|error] [--formats]\n");
+        return 2;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { std::fprintf(stderr, "Cannot open %s\n", path.c_str()); return 1; }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Reader r{ data };
+    std::string magic = r.GetBytes(sizeof(LogBinary::kMagic));
+    uint16_t version = r.Get<uint16_t>();
+    uint8_t wcharSize = r.Get<uint8_t>();
+    r.Get<uint8_t>();
+    int64_t startUnixMicros = r.Get<int64_t>();
+    if (!r.ok || std::memcmp(magic.data(), LogBinary::kMagic, sizeof(LogBinary::kMagic)) != 0 ||
+        version != LogBinary::kVersion || (wcharSize != 2 && wcharSize != 4)) {
+        std::fprintf(stderr, "%s is not a binary HDRScreenSaver log (version %u)\n", path.c_str(), LogBinary::kVersion);
+        return 1;
+    }
+
+    std::vector<FormatDef> formats(1);
+    size_t messages = 0;
+    while (r.ok && r.pos < data.size()) {
+        uint8_t type = r.Get<uint8_t>();
+        if (type == LogBinary::FormatDef) {
+            uint16_t id = r.Get<uint16_t>();
+            FormatDef def;
+            def.level = r.Get<uint8_t>();
+            def.category = r.Get<uint8_t>();
+            def.line = r.Get<uint32_t>();
+            def.file = r.GetBytes(r.Get<uint16_t>());
+            def.format = r.GetBytes(r.Get<uint32_t>());
+            if (formats.size() <= id) formats.resize(id + 1);
+            if (listFormats) {
+                std::printf("%5u %-5s %-10s %s:%u  %s\n", id, Narrow(LogLevelName(static_cast<LogLevel>(def.level))).c_str(),
+                            Narrow(LogCategoryName(static_cast<LogCategory>(def.category))).c_str(),
+                            def.file.c_str(), def.line, def.format.c_str());
+            }
+            formats[id] = std::move(def);
+        } else if (type == LogBinary::Message) {
+            uint16_t id = r.Get<uint16_t>();
+            uint64_t time = r.Get<uint64_t>();
+            uint32_t thread = r.Get<uint32_t>();
+            uint8_t argCount = r.Get<uint8_t>();
+            std::vector<std::string> args;
+            for (uint8_t i = 0; i < argCount && r.ok; ++i) args.push_back(ReadArg(r, wcharSize));
+            if (id >= formats.size()) { std::fprintf(stderr, "Record references unknown format id %u\n", id); return 1; }
+            const FormatDef& def = formats[id];
+            ++messages;
+            if (!listFormats && def.level >= minLevel) {
+                PrintLine(startUnixMicros, time, thread, def.level, def.category, FormatMessage(def.format, args));
+            }
+        } else if (type == LogBinary::Text) {
+            uint8_t level = r.Get<uint8_t>();
+            uint8_t category = r.Get<uint8_t>();
+            uint64_t time = r.Get<uint64_t>();
+            uint32_t thread = r.Get<uint32_t>();
+            std::string text = ReadWide(r, wcharSize);
+            ++messages;
+            if (!listFormats && level >= minLevel) PrintLine(startUnixMicros, time, thread, level, category, text);
+        } else {
+            std::fprintf(stderr, "Corrupt record type %u at offset %zu\n", type, r.pos - 1);
+            return 1;
+        }
+    }
+    if (!r.ok) {
+        // The writer may have been killed mid-record; everything before it was decoded
+        std::fprintf(stderr, "Truncated record at end of file after %zu messages\n", messages);
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+// hdrplay - runs the slideshow scheduler headless with virtual outputs
+//
+// Usage: hdrplay (<folder> | --synthetic <count>[:<kb>[,<kb>...]]) [options]
+//   --output <w>x<h>@<seconds>[:random][:hdr<headroom>]  add a virtual output (repeatable, default 3840x2160@15)
+//   --duration <seconds>   simulated run time (default 300)
+//   --speed <factor>       simulated seconds per real second (default 60)
+//   --threads <n>          worker threads (default: one per core)
+//   --cache-mb <n>         cache budget (default 512, 0 = only slides on screen and planned)
+//   --load-ms <ms>         synthetic catalog: time one load takes (default 20)
+//   --read-mbps <n>        synthetic catalog: plus the file size read at this rate (default 0 = none)
+//   --seed <n>             random order seed (default 1, outputs use seed + index)
+//   --json                 print the result as JSON
+//   --metrics              append the metrics registry snapshot (JSON)
+//
+// Loads run on real worker threads while the slideshow clock runs <speed> times faster, so a
+// slow disk or a small pool shows up as late slides exactly as it would on screen. Synthetic
+// files cycle through the listed sizes (default 4096 KB); with --read-mbps a large file takes
+// longer than a small one, as on a network share. Missed slides were not loaded by the time they
+// were due, late ones went on screen late.
+
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool ParseOutput(const std::string& spec, SlideOutputConfig& config)
+{
+    int w = 0, h = 0;
+    double seconds = 0;
+    int consumed = 0;
+    if (std::sscanf(spec.c_str(), "%dx%d@%lf%n", &w, &h, &seconds, &consumed) != 3 || w <= 0 || h <= 0 || seconds <= 0) return false;
+    config.width = w;
+    config.height = h;
+    config.interval = std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000));
+    std::string rest = spec.substr(consumed);
+    while (!rest.empty()) {
+        if (rest[0] != ':') return false;
+        size_t end = rest.find(':', 1);
+        std::string option = rest.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+        if (option == "random") config.order = SlideOrder::Random;
+        else if (option.rfind("hdr", 0) == 0) config.headroom = std::strtof(option.c_str() + 3, nullptr);
+        else return false;
+        rest = end == std::string::npos ? std::string() : rest.substr(end);
+    }
+    return true;
+}
+
+void Usage()
+{
+    std::fprintf(stderr,
+        "Usage: hdrplay (<folder> | --synthetic <count>[:<kb>[,<kb>...]]) [--output WxH@seconds[:random][:hdrN]]...\n"
+        "               [--duration s] [--speed x] [--threads n] [--cache-mb n] [--load-ms ms] [--read-mbps n] [--seed n] [--json] [--metrics]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string folder;
+    size_t syntheticCount = 0;
+    std::vector<uint64_t> syntheticBytes = { 4 << 20 };
+    std::vector<SlideOutputConfig> outputs;
+    double duration = 300, speed = 60;
+    unsigned threads = 0;
+    uint64_t cacheMB = 512;
+    int loadMs = 20;
+    double readMbps = 0;
+    uint64_t seed = 1;
+    bool json = false, metrics = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--synthetic") {
+            std::string v = value();
+            syntheticCount = std::strtoull(v.c_str(), nullptr, 10);
+            size_t colon = v.find(':');
+            if (colon != std::string::npos) {
+                syntheticBytes.clear();
+                for (size_t pos = colon; pos != std::string::npos; pos = v.find(',', pos + 1)) {
+                    syntheticBytes.push_back(std::strtoull(v.c_str() + pos + 1, nullptr, 10) * 1024);
+                }
+            }
+        } else if (arg == "--output") {
+            SlideOutputConfig config;
+            std::string spec = value();
+            if (!ParseOutput(spec, config)) { std::fprintf(stderr, "Bad output spec: %s\n", spec.c_str()); return 2; }
+            outputs.push_back(config);
+        } else if (arg == "--duration") duration = std::atof(value().c_str());
+        else if (arg == "--speed") speed = std::atof(value().c_str());
+        else if (arg == "--threads") threads = static_cast<unsigned>(std::atoi(value().c_str()));
+        else if (arg == "--cache-mb") cacheMB = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--load-ms") loadMs = std::atoi(value().c_str());
+        else if (arg == "--read-mbps") readMbps = std::atof(value().c_str());
+        else if (arg == "--seed") seed = std::strtoull(value().c_str(), nullptr, 10);
+        else if (arg == "--json") json = true;
+        else if (arg == "--metrics") metrics = true;
+        else if (folder.empty() && arg[0] != '-') folder = arg;
+        else { Usage(); return 2; }
+    }
+    if ((folder.empty() && syntheticCount == 0) || speed <= 0) { Usage(); return 2; }
+    if (outputs.empty()) {
+        SlideOutputConfig config;
+        ParseOutput("3840x2160@15", config);
+        outputs.push_back(config);
+    }
+
+    Logger::Instance().SetLevel(LogLevel::Warn);
+
+    ImageCatalog catalog;
+    Slideshow::LoadFunction load = Slideshow::LoadImageFile;
+    if (syntheticCount > 0) {
+        for (size_t i = 0; i < syntheticCount; ++i) {
+            catalog.Add({ L"synthetic/" + std::to_wstring(i) + L".jpg", syntheticBytes[i % syntheticBytes.size()] });
+        }
+        load = [loadMs, readMbps](const CatalogEntry& entry) {
+            const double readMs = readMbps > 0 ? entry.fileSize / (readMbps * 1048576.0) * 1000.0 : 0.0;
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(loadMs + readMs));
+            auto data = std::make_shared<ImageData>();
+            data->bytes.resize(static_cast<size_t>(entry.fileSize));
+            return std::shared_ptr<const ImageData>(std::move(data));
+        };
+    } else {
+        catalog = ImageCatalog::FromFolder(std::filesystem::path(folder).wstring(), true);
+    }
+    if (catalog.Empty()) { std::fprintf(stderr, "No images found\n"); return 1; }
+
+    WorkerPool pool(threads);
+    ImageCache cache(cacheMB << 20);
+    Slideshow slideshow(catalog, cache, pool, load);
+    slideshow.SetClockRate(speed);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        outputs[i].name = L"virtual" + std::to_wstring(i);
+        outputs[i].seed = seed + i;
+        slideshow.AddOutput(outputs[i]);
+    }
+
+    // Simulated clock: starts now and runs <speed> times faster than real time
+    const auto realStart = std::chrono::steady_clock::now();
+    auto simulatedNow = [&] {
+        const auto real = std::chrono::steady_clock::now() - realStart;
+        return realStart + std::chrono::duration_cast<Slideshow::Clock::duration>(real * speed);
+    };
+    const auto end = realStart + std::chrono::duration_cast<Slideshow::Clock::duration>(std::chrono::duration<double>(duration));
+    size_t changes = 0;
+    for (auto now = simulatedNow(); now < end; now = simulatedNow()) {
+        for (const SlideChange& change : slideshow.Tick(now)) {
+            // The renderer fetches the image as soon as it is told to show it
+            slideshow.Acquire(change.index);
+            ++changes;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    pool.WaitIdle();
+
+    const double realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+    const uint64_t hits = Metrics::Instance().GetCounter("hdr_cache_hits_total", "").Value();
+    const uint64_t misses = Metrics::Instance().GetCounter("hdr_cache_misses_total", "").Value();
+    if (json) {
+        std::printf("{\n  \"catalog_images\": %zu,\n  \"worker_threads\": %u,\n  \"simulated_seconds\": %.1f,\n  \"real_seconds\": %.3f,\n",
+                    catalog.Size(), pool.ThreadCount(), duration, realSeconds);
+        std::printf("  \"cache_hits\": %llu,\n  \"cache_misses\": %llu,\n  \"cache_bytes\": %llu,\n  \"outputs\": [",
+                    static_cast<unsigned long long>(hits), static_cast<unsigned long long>(misses),
+                    static_cast<unsigned long long>(cache.BytesUsed()));
+        for (size_t i = 0; i < slideshow.OutputCount(); ++i) {
+            const SlideOutputConfig& c = slideshow.OutputConfig(i);
+            const SlideOutputStats& s = slideshow.Stats(i);
+            std::printf("%s\n    {\"width\": %d, \"height\": %d, \"headroom\": %.2f, \"interval_ms\": %lld, \"order\": \"%s\", "
+                        "\"shown\": %llu, \"missed\": %llu, \"late\": %llu, \"worst_lateness_ms\": %.1f}",
+                        i ? "," : "", c.width, c.height, c.headroom, static_cast<long long>(c.interval.count()),
+                        c.order == SlideOrder::Random ? "random" : "sequential", static_cast<unsigned long long>(s.shown),
+                        static_cast<unsigned long long>(s.missed), static_cast<unsigned long long>(s.late), s.worstLateness.count() / 1000.0);
+        }
+        std::printf("\n  ]\n}\n");
+    } else {
+        std::printf("%zu images, %u worker threads, %.0f s simulated in %.2f s, %zu slide changes\n",
+                    catalog.Size(), pool.ThreadCount(), duration, realSeconds, changes);
+        std::printf("cache: %llu hits, %llu misses, %llu bytes held\n", static_cast<unsigned long long>(hits),
+                    static_cast<unsigned long long>(misses), static_cast<unsigned long long>(cache.BytesUsed()));
+        for (size_t i = 0; i < slideshow.OutputCount(); ++i) {
+            const SlideOutputConfig& c = slideshow.OutputConfig(i);
+            const SlideOutputStats& s = slideshow.Stats(i);
+            std::printf("output %zu: %dx%d headroom %.2f every %.1f s %s: %llu shown, %llu missed, %llu late (worst %.1f ms)\n", i,
+                        c.width, c.height, c.headroom, c.interval.count() / 1000.0,
+                        c.order == SlideOrder::Random ? "random" : "sequential", static_cast<unsigned long long>(s.shown),
+                        static_cast<unsigned long long>(s.missed), static_cast<unsigned long long>(s.late), s.worstLateness.count() / 1000.0);
+        }
+    }
+    if (metrics) std::printf("%s", Metrics::Instance().SnapshotJson().c_str());
+    return 0;
+}
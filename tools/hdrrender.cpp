@@ -0,0 +1,310 @@
+// hdrrender - headless CPU render of a photo library: decode, gain map at a chosen headroom and
+// color conversion, written as linear HDR files for inspection and regression checks
+//
+// Usage: hdrrender <input file|folder> <output folder> [options]
+//   --headroom <stops>     display headroom the gain map is applied for (default: the full HDR
+//                          rendition of each image; 0 renders the SDR base image)
+//   --fit <W>x<H>          fit each render within W x H (3840x2160 for a 4K display), resampled
+//                          in linear light; never upscales
+//   --filter <name>        lanczos3 (default), mitchell or bilinear for --fit
+//   --formats <list>       comma-separated pfm, exr, png (default pfm,png)
+//   --sdr-white <nits>     luminance of SDR white in the PQ PNG (default 203, BT.2408)
+//   --threads <n>          worker threads (default: one per core); with fewer images than
+//                          threads each decode is split across restart intervals
+//   --no-subfolders        only the top level of the folder
+//   --timings <file>       per-image stage timings as tab-separated values
+//   --golden <folder>      compare each render against <folder>/<relative path>.pfm
+//   --tolerance <codes>    allowed difference in 10-bit PQ code values (default 1)
+//
+// Each image is written below <output folder> at its relative path with the format's extension
+// appended (IMG_0001.jpg.pfm). The PFM and EXR files hold linear BT.2020 with 1.0 = SDR white;
+// the PNG is 16-bit BT.2020 PQ, tagged with cICP. Files the CPU decoder cannot read (anything
+// but baseline JPEG) are reported and skipped. With --golden the exit code is 1 if any image
+// differs by more than the tolerance or has no golden file.
+
+#include "HdrRender.h"
+#include "ImageCatalog.h"
+#include "ImageResize.h"
+#include "Logger.h"
+#include "PixelBufferPool.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Formats {
+    bool pfm = false;
+    bool exr = false;
+    bool png = false;
+};
+
+bool ParseFormats(const std::string& list, Formats& formats)
+{
+    formats = Formats();
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "pfm") formats.pfm = true;
+        else if (name == "exr") formats.exr = true;
+        else if (name == "png") formats.png = true;
+        else return false;
+    }
+    return formats.pfm || formats.exr || formats.png;
+}
+
+bool WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    return static_cast<bool>(out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+}
+
+bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& bytes)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::filesystem::path WithSuffix(std::filesystem::path path, const char* suffix)
+{
+    path += suffix;
+    return path;
+}
+
+// Largest difference between two renders in 10-bit PQ code values, the precision of an HDR10
+// signal; -1 if the sizes differ. Linear differences would weigh highlights far above shadows.
+double PqCodeDifference(const HdrImage& a, const HdrImage& b, float sdrWhiteNits)
+{
+    if (a.width != b.width || a.height != b.height) return -1;
+    double worst = 0;
+    for (size_t i = 0; i < a.rgb.size(); ++i) {
+        if (a.rgb[i] == b.rgb[i]) continue;
+        const float pa = PqEncode(std::max(a.rgb[i], 0.0f) * sdrWhiteNits);
+        const float pb = PqEncode(std::max(b.rgb[i], 0.0f) * sdrWhiteNits);
+        worst = std::max(worst, std::fabs(static_cast<double>(pa) - pb) * 1023.0);
+    }
+    return worst;
+}
+
+struct Totals {
+    size_t rendered = 0, gainMaps = 0, skipped = 0, failed = 0, mismatched = 0;
+    uint64_t pixels = 0;
+    double parseMs = 0, decodeMs = 0, colorMs = 0, gainMapMs = 0, resampleMs = 0, writeMs = 0, criticalPathMs = 0;
+};
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrrender <input file|folder> <output folder> [--headroom stops] [--fit WxH]\n"
+                         "                 [--filter lanczos3|mitchell|bilinear] [--formats pfm,exr,png] [--sdr-white nits]\n"
+                         "                 [--threads n] [--no-subfolders] [--timings file]\n"
+                         "                 [--golden folder] [--tolerance codes]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    HdrRenderOptions options;
+    Formats formats;
+    formats.pfm = formats.png = true;
+    float sdrWhite = 203.0f;
+    double tolerance = 1.0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool subfolders = true;
+    std::string timingsPath, goldenPath;
+    int fitWidth = 0, fitHeight = 0;
+    ResampleOptions resample;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--headroom") options.headroom = std::max(0.0f, static_cast<float>(std::atof(value().c_str())));
+        else if (arg == "--fit") {
+            const std::string v = value();
+            if (std::sscanf(v.c_str(), "%dx%d", &fitWidth, &fitHeight) != 2 || fitWidth <= 0 || fitHeight <= 0) {
+                std::fprintf(stderr, "Bad size: %s\n", v.c_str());
+                return 2;
+            }
+        } else if (arg == "--filter") {
+            const std::string v = value();
+            if (!ParseResampleFilter(v, resample.filter)) {
+                std::fprintf(stderr, "Bad filter: %s\n", v.c_str());
+                return 2;
+            }
+        } else if (arg == "--formats") {
+            std::string v = value();
+            if (!ParseFormats(v, formats)) {
+                std::fprintf(stderr, "Bad formats: %s\n", v.c_str());
+                return 2;
+            }
+        } else if (arg == "--sdr-white") sdrWhite = std::clamp(static_cast<float>(std::atof(value().c_str())), 1.0f, 10000.0f);
+        else if (arg == "--threads") threads = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--no-subfolders") subfolders = false;
+        else if (arg == "--timings") timingsPath = value();
+        else if (arg == "--golden") goldenPath = value();
+        else if (arg == "--tolerance") tolerance = std::max(0.0, std::atof(value().c_str()));
+        else if (!arg.empty() && arg[0] == '-') { Usage(); return 2; }
+        else positional.push_back(arg);
+    }
+    if (positional.size() != 2) { Usage(); return 2; }
+    Logger::Instance().SetConsoleEnabled(false);
+
+    const std::filesystem::path input = std::filesystem::absolute(positional[0]);
+    const std::filesystem::path output = std::filesystem::absolute(positional[1]);
+    const std::filesystem::path golden = goldenPath.empty() ? std::filesystem::path() : std::filesystem::absolute(goldenPath);
+    std::error_code ec;
+    std::vector<CatalogEntry> entries;
+    std::filesystem::path root = input;
+    if (std::filesystem::is_regular_file(input, ec)) {
+        entries.push_back({ input.wstring(), std::filesystem::file_size(input, ec) });
+        root = input.parent_path();
+    } else if (std::filesystem::is_directory(input, ec)) {
+        const ImageCatalog catalog = ImageCatalog::FromFolder(input.wstring(), subfolders);
+        entries = catalog.Entries();
+    } else {
+        std::fprintf(stderr, "Not a file or folder: %s\n", positional[0].c_str());
+        return 1;
+    }
+    options.decodeThreads = static_cast<int>(std::max<size_t>(1, threads / std::max<size_t>(1, entries.size())));
+    resample.threads = options.decodeThreads;
+    std::printf("%zu images in %s\n", entries.size(), input.string().c_str());
+    std::fflush(stdout);
+
+    std::mutex mutex;    // guards totals, timings and the console
+    Totals totals;
+    std::vector<std::string> timings(entries.size());
+    const auto start = Clock::now();
+    {
+        WorkerPool pool(threads);
+        // Stages of an image run as tasks on the same pool, ahead of images not started yet, and
+        // so do the shares of decodes and resizes split over several threads
+        options.pool = &pool;
+        resample.pool = &pool;
+        const auto now = WorkerPool::Clock::now();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            pool.Submit(now + std::chrono::microseconds(i), [&, i] {
+                const auto imageStart = Clock::now();
+                const std::filesystem::path path(entries[i].path);
+                const std::filesystem::path relative = path.lexically_relative(root);
+                HdrImage image;
+                HdrRenderInfo info;
+                std::string error;
+                auto data = Slideshow::LoadImageFile(entries[i]);
+                const bool rendered = data && RenderHdrImage(data->bytes.data(), data->bytes.size(), options, image, &info, &error);
+                if (!rendered) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++totals.skipped;
+                    std::fprintf(stderr, "%s: skipped: %s\n", relative.string().c_str(), data ? error.c_str() : "cannot read file");
+                    return;
+                }
+
+                double resampleMs = 0;
+                int width = 0, height = 0;
+                FitWithin(image.width, image.height, fitWidth, fitHeight, width, height);
+                if (width != image.width || height != image.height) {
+                    const auto resampleStart = Clock::now();
+                    HdrImage fitted;
+                    ResampleHdrImage(image, width, height, resample, fitted);
+                    image = std::move(fitted);
+                    resampleMs = std::chrono::duration<double, std::milli>(Clock::now() - resampleStart).count();
+                }
+
+                const auto writeStart = Clock::now();
+                bool written = true;
+                std::vector<uint8_t> bytes;
+                if (formats.pfm) {
+                    EncodePfm(image, bytes);
+                    written &= WriteFile(WithSuffix(output / relative, ".pfm"), bytes);
+                }
+                if (formats.exr) {
+                    EncodeExr(image, bytes);
+                    written &= WriteFile(WithSuffix(output / relative, ".exr"), bytes);
+                }
+                if (formats.png) {
+                    EncodePqPng(image, sdrWhite, bytes);
+                    written &= WriteFile(WithSuffix(output / relative, ".png"), bytes);
+                }
+                const double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - writeStart).count();
+                const double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - imageStart).count();
+
+                double difference = 0;
+                bool mismatch = false;
+                if (!golden.empty()) {
+                    HdrImage reference;
+                    if (!ReadFile(WithSuffix(golden / relative, ".pfm"), bytes) || !DecodePfm(bytes.data(), bytes.size(), reference)) difference = -1;
+                    else difference = PqCodeDifference(image, reference, sdrWhite);
+                    mismatch = difference < 0 || difference > tolerance;
+                }
+
+                const HdrRenderTimings& t = info.timings;
+                char line[512];
+                std::snprintf(line, sizeof(line), "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", relative.generic_string().c_str(), image.width,
+                              image.height, info.gainMap ? 1 : 0, t.parseMs, t.decodeMs, t.colorMs, t.gainMapMs, resampleMs, writeMs, totalMs);
+                std::lock_guard<std::mutex> lock(mutex);
+                timings[i] = line;
+                ++(written ? totals.rendered : totals.failed);
+                if (!written) std::fprintf(stderr, "%s: cannot write output\n", relative.string().c_str());
+                if (info.gainMap) ++totals.gainMaps;
+                totals.pixels += static_cast<uint64_t>(image.width) * image.height;
+                totals.parseMs += t.parseMs;
+                totals.decodeMs += t.decodeMs;
+                totals.colorMs += t.colorMs;
+                totals.gainMapMs += t.gainMapMs;
+                totals.criticalPathMs += t.criticalPathMs;
+                totals.resampleMs += resampleMs;
+                totals.writeMs += writeMs;
+                if (mismatch) {
+                    ++totals.mismatched;
+                    if (difference < 0) std::fprintf(stderr, "%s: no matching golden render\n", relative.string().c_str());
+                    else std::fprintf(stderr, "%s: differs from golden by %.2f PQ codes\n", relative.string().c_str(), difference);
+                }
+            });
+        }
+        pool.WaitIdle();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (!timingsPath.empty()) {
+        std::ofstream out(timingsPath, std::ios::out | std::ios::trunc);
+        out << "path\twidth\theight\tgain_map\tparse_ms\tdecode_ms\tcolor_ms\tgain_map_ms\tresample_ms\twrite_ms\ttotal_ms\n";
+        for (const std::string& line : timings) out << line;
+        if (!out) std::fprintf(stderr, "Cannot write %s\n", timingsPath.c_str());
+    }
+
+    const size_t done = totals.rendered + totals.failed;
+    std::printf("Rendered %zu (%zu with a gain map), skipped %zu, failed %zu in %.2f s (%u threads): %.2f images/s, %.1f MP/s\n",
+                totals.rendered, totals.gainMaps, totals.skipped, totals.failed, seconds, threads, seconds > 0 ? done / seconds : 0.0,
+                seconds > 0 ? totals.pixels / 1e6 / seconds : 0.0);
+    if (done > 0) {
+        std::printf("Per image: parse %.2f ms, decode %.1f ms, color %.1f ms, gain map %.1f ms, resample %.1f ms, write %.1f ms\n",
+                    totals.parseMs / done, totals.decodeMs / done, totals.colorMs / done, totals.gainMapMs / done, totals.resampleMs / done,
+                    totals.writeMs / done);
+        std::printf("Render critical path %.1f ms of %.1f ms in stages\n", totals.criticalPathMs / done,
+                    (totals.parseMs + totals.decodeMs + totals.colorMs + totals.gainMapMs) / done);
+    }
+    if (!golden.empty()) {
+        std::printf("Golden: %zu of %zu within %.2f PQ codes\n", done - std::min(done, totals.mismatched), done, tolerance);
+    }
+    PixelBufferPool::Instance().Trim();
+    return totals.failed || totals.mismatched ? 1 : 0;
+}
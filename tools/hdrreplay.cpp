@@ -0,0 +1,161 @@
+// hdrreplay - replays a recorded navigation trace against a folder and reports step latencies
+//
+// Usage: hdrreplay <trace> [<folder>] [options]
+//   <folder>               image folder (default: the folder the trace was recorded in)
+//   --synthetic <load-ms>  replay against generated catalog entries that each take <load-ms> to load
+//   --speed <factor>       recorded seconds per real second (default 0 = virtual time, back to back)
+//   --threads <n>          worker threads (default: one per core)
+//   --cache-mb <n>         cache budget (default: the recorded one)
+//   --json                 print the result as JSON
+//
+// A trace is written by the screensaver when TracePath is set (registry, or /t <file>). The
+// catalog is rebuilt the way the slideshow built it: the scan index if it is current, the
+// playlist query, and for an opened file its folder starting at the file. Latencies run from the
+// input to the new slide's image being in memory; run a replay before and after a change to
+// compare.
+
+#include "CatalogIndex.h"
+#include "CatalogTable.h"
+#include "ImageCache.h"
+#include "ImageCatalog.h"
+#include "InputTrace.h"
+#include "Logger.h"
+#include "Slideshow.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace {
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrreplay <trace> [<folder>] [--synthetic load-ms] [--speed x] [--threads n] [--cache-mb n] [--json]\n");
+}
+
+double Milliseconds(std::chrono::microseconds us)
+{
+    return us.count() / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string tracePath, folder;
+    int syntheticLoadMs = -1;
+    double speed = 0;
+    unsigned threads = 0;
+    int64_t cacheMB = -1;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--synthetic") syntheticLoadMs = std::atoi(value().c_str());
+        else if (arg == "--speed") speed = std::atof(value().c_str());
+        else if (arg == "--threads") threads = static_cast<unsigned>(std::atoi(value().c_str()));
+        else if (arg == "--cache-mb") cacheMB = std::atoll(value().c_str());
+        else if (arg == "--json") json = true;
+        else if (tracePath.empty() && arg[0] != '-') tracePath = arg;
+        else if (folder.empty() && arg[0] != '-') folder = arg;
+        else { Usage(); return 2; }
+    }
+    if (tracePath.empty() || speed < 0) { Usage(); return 2; }
+
+    Logger::Instance().SetLevel(LogLevel::Warn);
+
+    InputTrace trace;
+    if (!trace.Load(tracePath)) { std::fprintf(stderr, "Cannot read trace %s\n", tracePath.c_str()); return 1; }
+    uint64_t largest = trace.catalogSize;
+    for (const TraceEvent& event : trace.events) {
+        if (event.kind == TraceEventKind::Extend) largest = std::max(largest, event.index);
+    }
+
+    ImageCatalog catalog;
+    Slideshow::LoadFunction load = Slideshow::LoadImageFile;
+    if (syntheticLoadMs >= 0) {
+        for (uint64_t i = 0; i < largest; ++i) catalog.Add({ L"synthetic/" + std::to_wstring(i) + L".jpg", 4 << 20 });
+        load = [syntheticLoadMs](const CatalogEntry& entry) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(syntheticLoadMs));
+            auto data = std::make_shared<ImageData>();
+            data->bytes.resize(static_cast<size_t>(entry.fileSize));
+            return std::shared_ptr<const ImageData>(std::move(data));
+        };
+    } else {
+        const std::wstring root = folder.empty() ? trace.CatalogRoot() : std::filesystem::path(folder).wstring();
+        CatalogIndex index;
+        const bool indexed = !trace.openedFile && index.Load(CatalogIndex::DefaultPath()) && index.Matches(root, trace.includeSubfolders) && index.IsCurrent();
+        catalog = indexed ? index.ToCatalog(true) : ImageCatalog::FromFolder(root, trace.includeSubfolders);
+        if (trace.openedFile) {
+            const size_t found = catalog.Find((std::filesystem::path(root) / std::filesystem::path(trace.root).filename()).wstring());
+            if (found != ImageCatalog::npos) catalog.RotateTo(found);
+        } else if (!trace.playlistQuery.empty()) {
+            CatalogQuery query;
+            std::wstring error;
+            if (!CatalogQuery::Parse(trace.playlistQuery, query, &error)) {
+                std::fprintf(stderr, "Invalid playlist query in the trace: %s\n", std::filesystem::path(error).string().c_str());
+                return 1;
+            }
+            const CatalogTable table = indexed ? CatalogTable::FromIndex(index) : CatalogTable::FromCatalog(catalog, root);
+            query.flagsMask |= kCatalogDisplays;
+            query.flagsValue |= kCatalogDisplays;
+            catalog = table.ToCatalog(table.Select(query));
+        }
+        if (InputTrace::CatalogHash(catalog, static_cast<size_t>(trace.catalogSize), root) != trace.catalogHash) {
+            std::fprintf(stderr, "Warning: the catalog differs from the recorded one; slides will not match\n");
+        }
+    }
+    if (trace.weighted) std::fprintf(stderr, "Warning: the trace used weighted random order, which replays as uniform\n");
+
+    WorkerPool pool(threads);
+    ImageCache cache(cacheMB >= 0 ? static_cast<uint64_t>(cacheMB) << 20 : trace.cacheBytes);
+    ReplayOptions options;
+    options.speed = speed;
+    ReplayResult result;
+    std::string error;
+    if (!ReplayInputTrace(trace, catalog, cache, pool, load, options, result, &error)) {
+        std::fprintf(stderr, "Cannot replay %s: %s\n", tracePath.c_str(), error.c_str());
+        return 1;
+    }
+
+    const double recorded = trace.events.empty() ? 0.0 : trace.events.back().time.count() / 1e6;
+    if (json) {
+        std::printf("{\n  \"catalog_images\": %zu,\n  \"outputs\": %zu,\n  \"worker_threads\": %u,\n  \"recorded_seconds\": %.3f,\n"
+                    "  \"real_seconds\": %.3f,\n  \"steps\": %llu,\n  \"divergences\": %llu,\n  \"kinds\": [",
+                    catalog.Size(), trace.outputs.size(), pool.ThreadCount(), recorded, result.seconds,
+                    static_cast<unsigned long long>(result.steps), static_cast<unsigned long long>(result.divergences));
+        bool first = true;
+        for (size_t k = 0; k < kTraceEventKinds; ++k) {
+            const TraceEventKind kind = static_cast<TraceEventKind>(k);
+            if (result.latencies[k].empty()) continue;
+            std::printf("%s\n    {\"kind\": \"%s\", \"steps\": %zu, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}", first ? "" : ",",
+                        TraceEventKindName(kind), result.latencies[k].size(), Milliseconds(result.Percentile(kind, 0.5)),
+                        Milliseconds(result.Percentile(kind, 0.99)), Milliseconds(result.latencies[k].back()));
+            first = false;
+        }
+        std::printf("\n  ]\n}\n");
+    } else {
+        std::printf("%zu images, %zu outputs, %u worker threads: %llu steps over %.1f s recorded, replayed in %.2f s (%s)\n",
+                    catalog.Size(), trace.outputs.size(), pool.ThreadCount(), static_cast<unsigned long long>(result.steps), recorded,
+                    result.seconds, speed > 0 ? "recorded pacing" : "virtual time");
+        for (size_t k = 0; k < kTraceEventKinds; ++k) {
+            const TraceEventKind kind = static_cast<TraceEventKind>(k);
+            if (result.latencies[k].empty()) continue;
+            std::printf("%-14s %6zu steps  p50 %8.2f ms  p99 %8.2f ms  max %8.2f ms\n", TraceEventKindName(kind), result.latencies[k].size(),
+                        Milliseconds(result.Percentile(kind, 0.5)), Milliseconds(result.Percentile(kind, 0.99)), Milliseconds(result.latencies[k].back()));
+        }
+        if (result.divergences > 0) {
+            std::printf("%llu steps showed a different slide than recorded\n", static_cast<unsigned long long>(result.divergences));
+        }
+    }
+    return 0;
+}
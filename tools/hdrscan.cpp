@@ -0,0 +1,499 @@
+// hdrscan - audits a photo library without decoding any pixels
+//
+// Usage: hdrscan <folder> [options]
+//   --threads <n>       worker threads (default: one per core)
+//   --io <backend>      how file heads are read: auto (default), uring, overlapped, threads, or
+//                       sync (every worker opens and reads its own files)
+//   --io-depth <n>      files read at once by the asynchronous backends (default 32)
+//   --no-subfolders     only the top level of the folder
+//   --json <file|->     per-file report as JSON
+//   --csv <file|->      per-file report as CSV
+//   --index <file>      write the catalog index to <file>
+//   --warm              write the catalog index where the screensaver looks for it
+//   --query <query>     only report the files that match a playlist query (see CatalogTable.h)
+//   --no-fingerprint    skip the content fingerprints (FileIdentity.h) in the index and reports
+//   --quiet             no summary
+//
+// Every image the screensaver would pick up is probed with the same enumeration and parsers the
+// app uses: container, dimensions, MPF / gain map presence, hdrgm parameters, ICC profile name
+// and whether WebView2 is expected to show it (hdr / displays / unsupported / broken). With
+// --warm, the next screensaver start takes its catalog from the index instead of walking the
+// library, as long as no folder changed since, and skips files that would not display.
+// Fingerprints of files whose size and modification time match the previous index are reused.
+
+#include "AsyncFileReader.h"
+#include "CatalogIndex.h"
+#include "CatalogTable.h"
+#include "FileIdentity.h"
+#include "ImageCatalog.h"
+#include "ImageFileUtils.h"
+#include "ImageProbe.h"
+#include "Logger.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <semaphore>
+#include <unordered_map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Scanned {
+    CatalogEntry entry;
+    ImageProbe probe;
+    ContentHash content;
+    bool contentReused = false;      // taken from the previous index
+    double fingerprintMs = 0;        // hashing, excluding the reads
+};
+
+std::string JsonString(const std::string& s)
+{
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += static_cast<char>(c); }
+        else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20) { char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+        else out += static_cast<char>(c);
+    }
+    return out + "\"";
+}
+
+std::string CsvField(const std::string& s)
+{
+    if (s.find_first_of(",\"\r\n") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// stdout for "-", otherwise a new file; null (with a message) on failure
+FILE* OpenReport(const std::string& name)
+{
+    if (name == "-") return stdout;
+    FILE* f = std::fopen(name.c_str(), "wb");
+    if (!f) std::fprintf(stderr, "Cannot write %s\n", name.c_str());
+    return f;
+}
+
+void WriteJson(FILE* f, const std::vector<Scanned>& files)
+{
+    std::fprintf(f, "[\n");
+    for (size_t i = 0; i < files.size(); ++i) {
+        const ImageProbe& p = files[i].probe;
+        std::fprintf(f, "  {\"path\": %s, \"size\": %llu, \"container\": \"%s\", \"width\": %d, \"height\": %d, \"components\": %d, "
+                        "\"bitDepth\": %d, \"progressive\": %s, \"animated\": %s, \"mpfImages\": %d, \"gainMap\": %s, \"isoGainMap\": %s",
+                     JsonString(Utf8FromPath(files[i].entry.path)).c_str(), static_cast<unsigned long long>(p.fileSize),
+                     ImageContainerName(p.container), p.width, p.height, p.components, p.bitDepth, p.progressive ? "true" : "false",
+                     p.animated ? "true" : "false", p.mpfImages, p.gainMap ? "true" : "false", p.isoGainMap ? "true" : "false");
+        if (p.color.present) {
+            std::fprintf(f, ", \"cicp\": {\"primaries\": \"%s\", \"transfer\": \"%s\", \"matrix\": %d, \"fullRange\": %s, \"maxCll\": %u}",
+                         CicpPrimariesName(p.color.primaries).c_str(), CicpTransferName(p.color.transfer).c_str(), p.color.matrix,
+                         p.color.fullRange ? "true" : "false", p.color.maxCll);
+        }
+        if (p.hasHdrgm) {
+            const GainMapMetadata& m = p.hdrgm;
+            std::fprintf(f, ", \"hdrgm\": {\"version\": %s, \"gainMapMin\": %g, \"gainMapMax\": %g, \"gamma\": %g, \"offsetSdr\": %g, "
+                            "\"offsetHdr\": %g, \"hdrCapacityMin\": %g, \"hdrCapacityMax\": %g, \"baseRenditionIsHdr\": %s}",
+                         JsonString(m.version).c_str(), m.gainMapMin, m.gainMapMax, m.gamma, m.offsetSdr, m.offsetHdr, m.hdrCapacityMin,
+                         m.hdrCapacityMax, m.baseRenditionIsHdr ? "true" : "false");
+        }
+        if (!files[i].content.Empty()) std::fprintf(f, ", \"content\": \"%s\"", files[i].content.ToHex().c_str());
+        std::fprintf(f, ", \"icc\": %s, \"renderability\": \"%s\", \"problem\": %s}%s\n", JsonString(p.iccDescription).c_str(),
+                     RenderabilityName(p.renderability), JsonString(p.problem).c_str(), i + 1 < files.size() ? "," : "");
+    }
+    std::fprintf(f, "]\n");
+}
+
+void WriteCsv(FILE* f, const std::vector<Scanned>& files)
+{
+    std::fprintf(f, "path,size,container,width,height,components,bit_depth,progressive,animated,mpf_images,gain_map,iso_gain_map,"
+                    "hdrgm_version,gain_map_min,gain_map_max,gamma,hdr_capacity_min,hdr_capacity_max,primaries,transfer,max_cll,icc,"
+                    "renderability,problem,content\n");
+    for (const Scanned& s : files) {
+        const ImageProbe& p = s.probe;
+        std::fprintf(f, "%s,%llu,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,", CsvField(Utf8FromPath(s.entry.path)).c_str(),
+                     static_cast<unsigned long long>(p.fileSize), ImageContainerName(p.container), p.width, p.height, p.components,
+                     p.bitDepth, p.progressive ? 1 : 0, p.animated ? 1 : 0, p.mpfImages, p.gainMap ? 1 : 0, p.isoGainMap ? 1 : 0);
+        if (p.hasHdrgm) {
+            std::fprintf(f, "%s,%g,%g,%g,%g,%g,", CsvField(p.hdrgm.version).c_str(), p.hdrgm.gainMapMin, p.hdrgm.gainMapMax, p.hdrgm.gamma,
+                         p.hdrgm.hdrCapacityMin, p.hdrgm.hdrCapacityMax);
+        } else {
+            std::fprintf(f, ",,,,,,");
+        }
+        if (p.color.present) {
+            std::fprintf(f, "%s,%s,%u,", CicpPrimariesName(p.color.primaries).c_str(), CicpTransferName(p.color.transfer).c_str(), p.color.maxCll);
+        } else {
+            std::fprintf(f, ",,,");
+        }
+        std::fprintf(f, "%s,%s,%s,%s\n", CsvField(p.iccDescription).c_str(), RenderabilityName(p.renderability), CsvField(p.problem).c_str(),
+                     s.content.Empty() ? "" : s.content.ToHex().c_str());
+    }
+}
+
+std::string MB(uint64_t bytes)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f MB", static_cast<double>(bytes) / (1 << 20));
+    return buf;
+}
+
+void PrintSummary(const std::vector<Scanned>& files, double scanMs, double probeMs, unsigned threads, const char* io)
+{
+    std::map<std::string, std::pair<size_t, uint64_t>> containers;    // count, bytes
+    std::map<std::string, size_t> iccProfiles, problems;
+    size_t renderability[4] = {}, mpf = 0, gainMaps = 0, isoGainMaps = 0, progressive = 0, pq = 0, hlg = 0;
+    uint64_t bytes = 0;
+    double capacitySum = 0;
+    size_t capacityCount = 0;
+    for (const Scanned& s : files) {
+        const ImageProbe& p = s.probe;
+        auto& c = containers[ImageContainerName(p.container)];
+        ++c.first;
+        c.second += p.fileSize;
+        bytes += p.fileSize;
+        ++renderability[static_cast<int>(p.renderability)];
+        if (p.mpfImages > 0) ++mpf;
+        if (p.gainMap) ++gainMaps;
+        if (p.isoGainMap) ++isoGainMaps;
+        if (p.progressive) ++progressive;
+        if (p.color.present && p.color.transfer == kCicpTransferPq) ++pq;
+        if (p.color.present && p.color.transfer == kCicpTransferHlg) ++hlg;
+        if (p.hasHdrgm) { capacitySum += p.hdrgm.hdrCapacityMax; ++capacityCount; }
+        if (!p.iccDescription.empty()) ++iccProfiles[p.iccDescription];
+        if (!p.problem.empty()) ++problems[p.problem];
+    }
+    std::printf("%zu images, %s (listed in %.0f ms, probed in %.0f ms on %u threads with %s reads, %.0f files/s)\n", files.size(),
+                MB(bytes).c_str(), scanMs, probeMs, threads, io, probeMs > 0 ? files.size() * 1000.0 / probeMs : 0.0);
+    std::printf("Renderability: hdr %zu, displays %zu, unsupported %zu, broken %zu\n", renderability[0], renderability[1],
+                renderability[2], renderability[3]);
+    std::printf("Gain maps: %zu (%zu with ISO 21496-1 metadata), MPF files %zu, progressive JPEGs %zu\n", gainMaps, isoGainMaps, mpf, progressive);
+    if (pq + hlg > 0) std::printf("HDR transfer: PQ %zu, HLG %zu\n", pq, hlg);
+    if (capacityCount > 0) std::printf("Mean hdrgm HDRCapacityMax: %.2f stops\n", capacitySum / capacityCount);
+    std::printf("Containers:\n");
+    for (const auto& [name, c] : containers) std::printf("  %-8s %8zu  %s\n", name.c_str(), c.first, MB(c.second).c_str());
+    if (!iccProfiles.empty()) {
+        std::printf("ICC profiles:\n");
+        for (const auto& [name, n] : iccProfiles) std::printf("  %8zu  %s\n", n, name.c_str());
+    }
+    if (!problems.empty()) {
+        std::printf("Problems:\n");
+        for (const auto& [name, n] : problems) std::printf("  %8zu  %s\n", n, name.c_str());
+    }
+
+    // Files with the same fingerprint are copies of one another (or a collision, at 2^-128)
+    std::unordered_map<ContentHash, size_t, ContentHashHasher> contents;
+    size_t computed = 0, reused = 0, duplicates = 0;
+    uint64_t hashedBytes = 0;
+    double hashMs = 0;
+    for (const Scanned& s : files) {
+        if (s.content.Empty()) continue;
+        if (s.contentReused) {
+            ++reused;
+        } else {
+            ++computed;
+            hashMs += s.fingerprintMs;
+            for (const FileSpan& span : FingerprintSpans(s.entry.fileSize)) hashedBytes += span.size;
+        }
+        if (contents[s.content]++ > 0) ++duplicates;
+    }
+    if (computed + reused > 0) {
+        // Hashing is timed apart from the reads only when the reads are asynchronous
+        char rate[48] = "";
+        if (hashMs > 0) std::snprintf(rate, sizeof(rate), ", hashed at %.1f GB/s", hashedBytes / hashMs / 1e6);
+        std::printf("Fingerprints: %zu computed (%s sampled%s), %zu reused from the index; %zu files duplicate another\n", computed,
+                    MB(hashedBytes).c_str(), rate, reused, duplicates);
+    }
+}
+
+std::wstring WideFromUtf8(const std::string& s)
+{
+    return std::filesystem::path(std::u8string(s.begin(), s.end())).wstring();
+}
+
+void Usage()
+{
+    std::fprintf(stderr, "Usage: hdrscan <folder> [--threads n] [--no-subfolders] [--json file|-] [--csv file|-] [--index file] [--warm]\n"
+                         "               [--query text] [--io auto|uring|overlapped|threads|sync] [--io-depth n] [--no-fingerprint] [--quiet]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned ioDepth = 32;
+    bool subfolders = true, warm = false, quiet = false, fingerprint = true;
+    std::string jsonPath, csvPath, indexPath, queryText, io = "auto";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) { Usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "--threads") threads = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--no-subfolders") subfolders = false;
+        else if (arg == "--json") jsonPath = value();
+        else if (arg == "--csv") csvPath = value();
+        else if (arg == "--index") indexPath = value();
+        else if (arg == "--warm") warm = true;
+        else if (arg == "--query") queryText = value();
+        else if (arg == "--io") io = value();
+        else if (arg == "--io-depth") ioDepth = std::max(1, std::atoi(value().c_str()));
+        else if (arg == "--no-fingerprint") fingerprint = false;
+        else if (arg == "--quiet") quiet = true;
+        else if (arg.size() > 1 && arg[0] == '-') { Usage(); return 2; }
+        else positional.push_back(arg);
+    }
+    if (positional.size() != 1) { Usage(); return 2; }
+    const std::map<std::string, AsyncIoBackend> backends = { { "auto", AsyncIoBackend::Auto }, { "uring", AsyncIoBackend::IoUring },
+                                                             { "overlapped", AsyncIoBackend::Overlapped }, { "threads", AsyncIoBackend::Threads } };
+    if (io != "sync" && !backends.count(io)) { Usage(); return 2; }
+    CatalogQuery query;
+    std::wstring queryError;
+    if (!CatalogQuery::Parse(WideFromUtf8(queryText), query, &queryError)) {
+        std::fprintf(stderr, "Bad query: %s\n", Utf8FromPath(queryError).c_str());
+        return 2;
+    }
+    // Reports written to stdout must not be interleaved with the summary
+    if (jsonPath == "-" || csvPath == "-") quiet = true;
+    Logger::Instance().SetConsoleEnabled(false);
+
+    std::filesystem::path root = std::filesystem::absolute(positional[0]).lexically_normal();
+    if (!root.has_filename() && root.has_relative_path()) root = root.parent_path();    // "Photos/" or "Photos/."
+    if (!std::filesystem::is_directory(root)) {
+        std::fprintf(stderr, "Not a folder: %s\n", positional[0].c_str());
+        return 1;
+    }
+
+    if (warm && indexPath.empty()) indexPath = Utf8FromPath(CatalogIndex::DefaultPath());
+    // Fingerprints of unchanged files come from the index this scan replaces
+    CatalogIndex previous;
+    if (fingerprint && !indexPath.empty()) previous.Load(PathFromUtf8(indexPath));
+
+    std::mutex mutex;    // guards files and folders while the pool runs
+    std::vector<Scanned> files;
+    std::vector<FolderStamp> folders;
+    WorkerPool pool(threads);
+
+    // Enumerate: each top-level subfolder is walked on its own worker, the root's files here
+    const auto scanStart = Clock::now();
+    {
+        std::vector<FolderStamp> rootStamp;
+        const ImageCatalog top = ImageCatalog::FromFolder(root.wstring(), false, &rootStamp);
+        folders.insert(folders.end(), rootStamp.begin(), rootStamp.end());
+        for (const CatalogEntry& entry : top.Entries()) files.emplace_back().entry = entry;
+        if (subfolders) {
+            std::error_code ec;
+            const auto now = WorkerPool::Clock::now();
+            for (const auto& entry : std::filesystem::directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, ec)) {
+                std::error_code dirEc;
+                if (!entry.is_directory(dirEc)) continue;
+                pool.Submit(now, [&, path = entry.path().wstring()] {
+                    std::vector<FolderStamp> stamps;
+                    ImageCatalog sub;
+                    try {
+                        sub = ImageCatalog::FromFolder(path, true, &stamps);
+                    } catch (const std::filesystem::filesystem_error& e) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        std::fprintf(stderr, "%s\n", e.what());
+                        return;
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    folders.insert(folders.end(), stamps.begin(), stamps.end());
+                    for (const CatalogEntry& e : sub.Entries()) files.emplace_back().entry = e;
+                });
+            }
+            pool.WaitIdle();
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const Scanned& a, const Scanned& b) { return a.entry.path < b.entry.path; });
+    const double scanMs = std::chrono::duration<double, std::milli>(Clock::now() - scanStart).count();
+
+    // Probe: every file on the pool, results land in their own slot so no lock is needed
+    const auto probeStart = Clock::now();
+    std::vector<char> needFingerprint(files.size(), 0);
+    if (fingerprint) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            const CatalogEntry& entry = files[i].entry;
+            if (const ContentHash* known = previous.FindContent(entry.path, entry.fileSize, entry.modified)) {
+                files[i].content = *known;
+                files[i].contentReused = true;
+            } else {
+                needFingerprint[i] = 1;
+            }
+        }
+    }
+    const char* ioName = "sync";
+    if (io == "sync") {
+        const auto now = WorkerPool::Clock::now();
+        for (size_t i = 0; i < files.size(); ++i) {
+            pool.Submit(now, [&, i] {
+                Scanned& s = files[i];
+                ProbeImageFile(s.entry.path, s.probe);
+                if (needFingerprint[i]) FingerprintFile(s.entry.path, s.entry.fileSize, s.content);
+            });
+        }
+        pool.WaitIdle();
+    } else {
+        // The reader keeps ioDepth files in flight, fetching each head and, for files longer than
+        // that, the last two bytes the truncation check needs plus the fingerprint samples past
+        // the head (the last of which covers those two bytes). Heads are parsed on the pool; the
+        // semaphore bounds how many wait there, so memory stays flat if parsing falls behind.
+        AsyncFileReader reader(ioDepth, static_cast<uint32_t>(kProbeHeadBytes), backends.at(io));
+        ioName = AsyncIoBackendName(reader.Backend());
+        struct ReadAhead {
+            std::vector<uint8_t> head;
+            uint8_t tail[2] = {};
+            uint32_t tailSize = 0;
+            std::vector<std::pair<uint64_t, std::vector<uint8_t>>> samples;    // offset, bytes
+            int error = 0;
+            int parts = 1;
+        };
+        // Tags: file index times kParts, plus 0 for the head, 1 for the tail, 2... for samples
+        const size_t kParts = 2 + kFingerprintSamples + 1;
+        std::vector<ReadAhead> ahead(files.size());
+        std::vector<AsyncReadRequest> requests;
+        requests.reserve(files.size() * 2);
+        for (size_t i = 0; i < files.size(); ++i) {
+            const CatalogEntry& entry = files[i].entry;
+            requests.push_back({ entry.path, 0, static_cast<uint32_t>(kProbeHeadBytes), kParts * i });
+            bool tailCovered = false;
+            if (needFingerprint[i]) {
+                for (const FileSpan& span : FingerprintSpans(entry.fileSize)) {
+                    if (span.offset + span.size <= kProbeHeadBytes) continue;
+                    requests.push_back({ entry.path, span.offset, static_cast<uint32_t>(span.size), kParts * i + 2 + ahead[i].samples.size() });
+                    ahead[i].samples.emplace_back(span.offset, std::vector<uint8_t>());
+                    ++ahead[i].parts;
+                    tailCovered = tailCovered || span.offset + span.size == entry.fileSize;
+                }
+            }
+            if (entry.fileSize > kProbeHeadBytes && !tailCovered) {
+                requests.push_back({ entry.path, entry.fileSize - 2, 2, kParts * i + 1 });
+                ++ahead[i].parts;
+            }
+        }
+        std::counting_semaphore<> parsing(2 * threads + ioDepth);
+        const auto now = WorkerPool::Clock::now();
+        reader.ReadAll(requests, [&](const AsyncReadResult& result) {
+            const size_t i = result.tag / kParts;
+            const size_t part = result.tag % kParts;
+            ReadAhead& a = ahead[i];
+            if (result.error != 0) a.error = result.error;
+            if (part == 0) {
+                a.head.assign(result.data, result.data + result.size);
+            } else if (part == 1) {
+                a.tailSize = std::min<uint32_t>(result.size, 2);
+                std::copy(result.data, result.data + a.tailSize, a.tail);
+            } else {
+                auto& [offset, bytes] = a.samples[part - 2];
+                bytes.assign(result.data, result.data + result.size);
+                if (offset + result.size == files[i].entry.fileSize && result.size >= 2) {
+                    a.tailSize = 2;
+                    std::copy(result.data + result.size - 2, result.data + result.size, a.tail);
+                }
+            }
+            if (--a.parts > 0) return;
+            parsing.acquire();
+            pool.Submit(now, [&, i] {
+                Scanned& s = files[i];
+                ReadAhead& a = ahead[i];
+                if (a.error != 0) {
+                    // Let the plain probe describe what is wrong with the file
+                    ProbeImageFile(s.entry.path, s.probe);
+                } else {
+                    if (needFingerprint[i]) {
+                        const auto hashStart = Clock::now();
+                        std::vector<ProbeRange> ranges = { { 0, a.head.data(), a.head.size() } };
+                        for (const auto& [offset, bytes] : a.samples) ranges.push_back({ offset, bytes.data(), bytes.size() });
+                        FingerprintRanges(s.entry.fileSize, ranges, s.content);
+                        s.fingerprintMs = std::chrono::duration<double, std::milli>(Clock::now() - hashStart).count();
+                        a.samples.clear();
+                    }
+                    std::vector<ProbeRange> tail;
+                    if (a.tailSize == 2) tail.push_back({ s.entry.fileSize - 2, a.tail, 2 });
+                    ProbeImageHead(s.entry.path, s.entry.fileSize, std::move(a.head), tail, s.probe);
+                }
+                parsing.release();
+            });
+        });
+        pool.WaitIdle();
+    }
+    const double probeMs = std::chrono::duration<double, std::milli>(Clock::now() - probeStart).count();
+
+    CatalogIndex index;
+    index.SetRoot(root.wstring(), subfolders);
+    index.SetFolders(std::move(folders));
+    for (const Scanned& s : files) {
+        CatalogIndexEntry e;
+        e.path = s.entry.path;
+        e.fileSize = s.entry.fileSize;
+        e.modified = s.entry.modified;
+        e.container = s.probe.container;
+        e.width = s.probe.width;
+        e.height = s.probe.height;
+        e.gainMap = s.probe.gainMap;
+        e.hdrCapacityMax = ProbeHeadroom(s.probe);
+        e.renderability = s.probe.renderability;
+        e.content = s.content;
+        index.Add(std::move(e));
+    }
+
+    // The query narrows and orders what is reported; the index always covers the whole library
+    std::vector<Scanned> reported;
+    if (!queryText.empty()) {
+        const auto queryStart = Clock::now();
+        const CatalogTable table = CatalogTable::FromIndex(index);
+        const std::vector<uint32_t> rows = table.Select(query);
+        const double queryMs = std::chrono::duration<double, std::milli>(Clock::now() - queryStart).count();
+        reported.reserve(rows.size());
+        for (uint32_t row : rows) reported.push_back(files[row]);
+        if (!quiet) std::printf("Query matched %zu of %zu images (%.2f ms)\n", rows.size(), files.size(), queryMs);
+    } else {
+        reported = std::move(files);
+    }
+
+    if (!quiet) PrintSummary(reported, scanMs, probeMs, threads, ioName);
+    int status = 0;
+    if (!jsonPath.empty()) {
+        if (FILE* f = OpenReport(jsonPath)) {
+            WriteJson(f, reported);
+            if (f != stdout) std::fclose(f);
+        } else {
+            status = 1;
+        }
+    }
+    if (!csvPath.empty()) {
+        if (FILE* f = OpenReport(csvPath)) {
+            WriteCsv(f, reported);
+            if (f != stdout) std::fclose(f);
+        } else {
+            status = 1;
+        }
+    }
+
+    if (!indexPath.empty()) {
+        const std::filesystem::path path = PathFromUtf8(indexPath);
+        if (!index.Save(path)) {
+            std::fprintf(stderr, "Cannot write the catalog index %s\n", indexPath.c_str());
+            status = 1;
+        } else if (!quiet) {
+            std::printf("Catalog index written to %s\n", indexPath.c_str());
+        }
+    }
+    return status;
+}